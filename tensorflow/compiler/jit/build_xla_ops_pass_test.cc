@@ -15,13 +15,17 @@ limitations under the License.
 
 #include "tensorflow/compiler/jit/build_xla_ops_pass.h"
 
+#include <functional>
+
 #include "tensorflow/cc/framework/ops.h"
 #include "tensorflow/cc/ops/array_ops.h"
 #include "tensorflow/cc/ops/resource_variable_ops.h"
 #include "tensorflow/cc/ops/standard_ops.h"
 #include "tensorflow/compiler/jit/defs.h"
 #include "tensorflow/compiler/jit/encapsulate_subgraphs_pass.h"
+#include "tensorflow/compiler/jit/mark_for_compilation_pass_test_helper.h"
 #include "tensorflow/compiler/jit/node_matchers.h"
+#include "tensorflow/compiler/jit/xla_shape_bucketing.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/grappler/optimizers/data/graph_utils.h"
@@ -230,5 +234,95 @@ TEST_F(BuildXlaOpsTest, OnXlaDevice) {
   ASSERT_NE(write_op_new, nullptr);
   EXPECT_THAT(write_op_new, assign_var);
 }
+
+// Clusters `graph` and rewrites the clusters into XLA ops, as the optimization
+// passes do with auto-clustering enabled.
+Status CompileClusters(std::unique_ptr<Graph>* graph) {
+  FunctionLibraryDefinition flib_def(OpRegistry::Global(),
+                                     FunctionDefLibrary());
+  SessionOptions session_options;
+  session_options.config.mutable_graph_options()
+      ->mutable_optimizer_options()
+      ->set_global_jit_level(OptimizerOptions::ON_2);
+  TF_RETURN_IF_ERROR(MarkForCompilationPassTestHelper::MarkForCompilation(
+      graph, &flib_def, &session_options));
+
+  GraphOptimizationPassOptions opt_options;
+  opt_options.graph = graph;
+  opt_options.flib_def = &flib_def;
+  opt_options.session_options = &session_options;
+  TF_RETURN_IF_ERROR(EncapsulateSubgraphsPass().Run(opt_options));
+
+  static const char* kCpuDevice = "/job:localhost/replica:0/task:0/cpu:0";
+  for (Node* n : (*graph)->nodes()) {
+    if (n->assigned_device_name().empty()) {
+      n->set_assigned_device_name(kCpuDevice);
+    }
+  }
+  BuildXlaOpsPass pass(/*enable_lazy_compilation=*/true);
+  return pass.Run(opt_options);
+}
+
+// Reads the bucketed arguments of the function compiled by the single
+// _XlaCompile node of `graph`.
+Status GetCompiledBucketedArgs(const Graph& graph, XlaBucketedArgs* result) {
+  for (Node* n : graph.op_nodes()) {
+    if (n->type_string() == "_XlaCompile") {
+      NameAttrList function;
+      TF_RETURN_IF_ERROR(GetNodeAttr(n->attrs(), "function", &function));
+      return XlaBucketedArgs::FromAttrs(AttrSlice(&function.attr()), result);
+    }
+  }
+  return errors::NotFound("No _XlaCompile node in the graph");
+}
+
+// Returns a graph that feeds `x` to a cluster computing `f(x)` and reads the
+// result outside of the cluster.
+std::unique_ptr<Graph> MakeClusterGraph(
+    const std::function<Output(const Scope&, Output)>& f) {
+  Scope root = Scope::NewRootScope().ExitOnError();
+  auto x = ops::Placeholder(root.WithOpName("x"), DT_FLOAT,
+                            ops::Placeholder::Shape({-1, 4}));
+  auto out = ops::Identity(root.WithOpName("out"), f(root, x));
+
+  auto graph = absl::make_unique<Graph>(OpRegistry::Global());
+  TF_CHECK_OK(root.ToGraph(graph.get()));
+  FindNodeByName(graph.get(), "out")->AddAttr(kXlaCompileAttr, false);
+  return graph;
+}
+
+TEST_F(BuildXlaOpsTest, BucketsBatchMajorClusterArguments) {
+  std::unique_ptr<Graph> graph =
+      MakeClusterGraph([](const Scope& s, Output x) -> Output {
+        auto w = ops::Const(s.WithOpName("w"), 1.0f, {4, 3});
+        auto b = ops::Const(s.WithOpName("b"), 1.0f, {3});
+        auto matmul = ops::MatMul(s.WithOpName("matmul"), x, w);
+        auto bias_add = ops::BiasAdd(s.WithOpName("bias_add"), matmul, b);
+        return ops::Relu(s.WithOpName("relu"), bias_add);
+      });
+  TF_ASSERT_OK(CompileClusters(&graph));
+
+  XlaBucketedArgs bucketed_args;
+  TF_ASSERT_OK(GetCompiledBucketedArgs(*graph, &bucketed_args));
+  EXPECT_EQ(bucketed_args.args, std::vector<int>({0}));
+  EXPECT_EQ(bucketed_args.outputs, std::vector<int>({0}));
+}
+
+TEST_F(BuildXlaOpsTest, DoesNotBucketClustersThatReduceRows) {
+  std::unique_ptr<Graph> graph =
+      MakeClusterGraph([](const Scope& s, Output x) -> Output {
+        auto w = ops::Const(s.WithOpName("w"), 1.0f, {4, 3});
+        auto matmul = ops::MatMul(s.WithOpName("matmul"), x, w);
+        auto relu = ops::Relu(s.WithOpName("relu"), matmul);
+        return ops::Sum(s.WithOpName("sum"), relu,
+                        ops::Const(s.WithOpName("axis"), 0));
+      });
+  TF_ASSERT_OK(CompileClusters(&graph));
+
+  XlaBucketedArgs bucketed_args;
+  TF_ASSERT_OK(GetCompiledBucketedArgs(*graph, &bucketed_args));
+  EXPECT_TRUE(bucketed_args.empty());
+  EXPECT_TRUE(bucketed_args.outputs.empty());
+}
 }  // namespace
 }  // namespace tensorflow
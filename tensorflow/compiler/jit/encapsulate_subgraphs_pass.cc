@@ -28,6 +28,7 @@ limitations under the License.
 #include "tensorflow/compiler/jit/graphcycles/graphcycles.h"
 #include "tensorflow/compiler/jit/mark_for_compilation_pass.h"
 #include "tensorflow/compiler/jit/shape_inference_helpers.h"
+#include "tensorflow/compiler/jit/xla_shape_bucketing.h"
 #include "tensorflow/compiler/tf2xla/const_analysis.h"
 #include "tensorflow/compiler/tf2xla/dump_graph.h"
 #include "tensorflow/compiler/xla/status_macros.h"
@@ -2577,6 +2578,13 @@ Status EncapsulateSubgraphsPass::Run(
         AddNodeAttr(kXlaCompiledKernelAttr, true, node);
         AddNodeAttr(kXlaNumConstantArgsAttr, num_consts, node);
         AddNodeAttr(kXlaNumResourceArgsAttr, num_resources, node);
+
+        // Record which arguments and results may have their leading
+        // dimension bucketed by the compilation cache.
+        XlaBucketedArgs bucketed_args;
+        TF_RETURN_IF_ERROR(XlaBucketedArgs::FromGraph(**subgraph, num_consts,
+                                                      &bucketed_args));
+        bucketed_args.AddAttrs(node);
         return Status::OK();
       };
 
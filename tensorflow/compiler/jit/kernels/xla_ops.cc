@@ -19,6 +19,7 @@ limitations under the License.
 #include "absl/memory/memory.h"
 #include "tensorflow/compiler/jit/defs.h"
 #include "tensorflow/compiler/jit/legacy_flags/xla_ops_common_flags.h"
+#include "tensorflow/compiler/jit/xla_shape_bucketing.h"
 #include "tensorflow/compiler/tf2xla/shape_util.h"
 #include "tensorflow/compiler/tf2xla/tf2xla_util.h"
 #include "tensorflow/compiler/tf2xla/xla_compiler.h"
@@ -100,11 +101,13 @@ class XlaExecutableClosure {
   explicit XlaExecutableClosure(
       xla::LocalClient* client, xla::LocalExecutable* executable,
       const XlaCompiler::CompilationResult* compilation_result,
+      XlaCompilationCache::EntryRef entry_ref,
       std::map<int, OptionalTensor> resource_var_snapshots,
       int num_constant_args)
       : client_(client),
         executable_(executable),
         compilation_result_(compilation_result),
+        entry_ref_(std::move(entry_ref)),
         resource_var_snapshots_(std::move(resource_var_snapshots)),
         num_constant_args_(num_constant_args) {}
 
@@ -120,11 +123,17 @@ class XlaExecutableClosure {
     return resource_var_snapshots_;
   }
   int num_constant_args() const { return num_constant_args_; }
+  const XlaBucketedArgs& bucketed_args() const {
+    return entry_ref_->bucketed_args;
+  }
 
  private:
   xla::LocalClient* client_;
   xla::LocalExecutable* executable_;
   const XlaCompiler::CompilationResult* compilation_result_;
+  // Keeps `executable_` and `compilation_result_` alive if the compilation
+  // cache evicts them before the closure is consumed.
+  XlaCompilationCache::EntryRef entry_ref_;
   std::map<int, OptionalTensor> resource_var_snapshots_;
   int num_constant_args_;
 
@@ -212,8 +221,14 @@ static Status BuildCompilationCache(OpKernelContext* ctx,
     return errors::InvalidArgument("No JIT device registered for ",
                                    platform_info.device_type().type());
   }
+  const legacy_flags::XlaOpsCommonFlags& flags =
+      legacy_flags::GetXlaOpsCommonFlags();
+  XlaShapeBucketingPolicy bucketing_policy;
+  TF_RETURN_IF_ERROR(XlaShapeBucketingPolicy::Parse(flags.tf_xla_shape_buckets,
+                                                    &bucketing_policy));
   *cache = new XlaCompilationCache(
-      client.ValueOrDie(), DeviceType(registration->compilation_device_name));
+      client.ValueOrDie(), DeviceType(registration->compilation_device_name),
+      flags.tf_xla_compilation_cache_capacity, std::move(bucketing_policy));
   return Status::OK();
 }
 
@@ -223,7 +238,8 @@ static Status CompileToLocalExecutable(
     absl::Span<const int> constants, bool lazy, xla::LocalClient** client,
     std::map<int, OptionalTensor>* variables,
     const XlaCompiler::CompilationResult** kernel,
-    xla::LocalExecutable** executable) {
+    xla::LocalExecutable** executable,
+    XlaCompilationCache::EntryRef* entry_ref) {
   // We store information about the JIT-compiled XLA computation
   // in the ResourceMgr.
   ResourceMgr* rm = ctx->resource_manager();
@@ -281,7 +297,7 @@ static Status CompileToLocalExecutable(
                         compile_options,
                         lazy ? XlaCompilationCache::CompileMode::kLazy
                              : XlaCompilationCache::CompileMode::kStrict,
-                        kernel, executable);
+                        kernel, executable, entry_ref);
 }
 
 void XlaLocalLaunchBase::Compute(OpKernelContext* ctx) {
@@ -291,12 +307,14 @@ void XlaLocalLaunchBase::Compute(OpKernelContext* ctx) {
   xla::LocalClient* client;
   const XlaCompiler::CompilationResult* kernel;
   xla::LocalExecutable* executable;
+  XlaCompilationCache::EntryRef entry_ref;
   std::map<int, OptionalTensor> variables;
 
   OP_REQUIRES_OK(
       ctx, CompileToLocalExecutable(ctx, function_, platform_info_, resources_,
                                     constants_, /*lazy=*/false, &client,
-                                    &variables, &kernel, &executable));
+                                    &variables, &kernel, &executable,
+                                    &entry_ref));
 
   se::Stream* stream =
       ctx->op_device_context() ? ctx->op_device_context()->stream() : nullptr;
@@ -307,6 +325,9 @@ void XlaLocalLaunchBase::Compute(OpKernelContext* ctx) {
       client, platform_info_.allocator(),
       /*allocate_xla_tensors=*/platform_info_.is_on_xla_device(),
       platform_info_.UseMultipleStreams());
+  OP_REQUIRES_OK(ctx, launch_context.PadBucketedInputs(
+                          ctx, kernel, entry_ref->bucketed_args,
+                          /*missing_ctx_input_prefix=*/0));
   launch_context.PopulateInputs(ctx, kernel, variables,
                                 /*missing_ctx_input_prefix=*/0);
 
@@ -407,6 +428,7 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
   xla::LocalClient* client;
   const XlaCompiler::CompilationResult* kernel;
   xla::LocalExecutable* executable;
+  XlaCompilationCache::EntryRef entry_ref;
   std::map<int, OptionalTensor> variables;
 
   if (legacy_flags::GetXlaOpsCommonFlags().tf_xla_always_defer_compilation) {
@@ -415,7 +437,7 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
     OP_REQUIRES_OK(ctx, CompileToLocalExecutable(
                             ctx, function_, platform_info_, resources_,
                             constants_, /*lazy=*/!must_compile_, &client,
-                            &variables, &kernel, &executable));
+                            &variables, &kernel, &executable, &entry_ref));
   }
 
   AllocatorAttributes host_alloc_attrs;
@@ -440,7 +462,8 @@ void XlaCompileOp::Compute(OpKernelContext* ctx) {
   // variables.
   XlaExecutableClosureStore::KeyT key =
       XlaExecutableClosureStore::Global()->Produce(XlaExecutableClosure(
-          client, executable, kernel, std::move(variables), constants_.size()));
+          client, executable, kernel, std::move(entry_ref),
+          std::move(variables), constants_.size()));
 
   Tensor compilation_key(cpu_allocator, DT_STRING, TensorShape({}));
   compilation_key.flat<string>()(0) = key;
@@ -472,6 +495,10 @@ void XlaRunOp::Compute(OpKernelContext* ctx) {
   // We're missing the must-be-constant inputs, tell `PopulateInputs`
   // about this.  We don't actually need these inputs because they've
   // already been baked into the compiled kernel.
+  OP_REQUIRES_OK(
+      ctx, launch_context.PadBucketedInputs(
+               ctx, closure.compilation_result(), closure.bucketed_args(),
+               /*missing_ctx_input_prefix=*/closure.num_constant_args()));
   launch_context.PopulateInputs(
       ctx, closure.compilation_result(), closure.resource_var_snapshots(),
       /*missing_ctx_input_prefix=*/closure.num_constant_args());
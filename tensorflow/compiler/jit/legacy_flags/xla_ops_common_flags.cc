@@ -31,9 +31,21 @@ std::once_flag flags_init;
 void AllocateAndParseFlags() {
   flags = new XlaOpsCommonFlags;
   flags->tf_xla_always_defer_compilation = false;
+  flags->tf_xla_compilation_cache_capacity = 0;
   flag_list = new std::vector<Flag>({
       Flag("tf_xla_always_defer_compilation",
            &flags->tf_xla_always_defer_compilation, ""),
+      Flag("tf_xla_compilation_cache_capacity",
+           &flags->tf_xla_compilation_cache_capacity,
+           "Maximum number of compilations kept per XLA JIT compilation "
+           "cache; least recently used entries are evicted beyond this. 0 "
+           "means unbounded."),
+      Flag("tf_xla_shape_buckets", &flags->tf_xla_shape_buckets,
+           "Round the leading dimension of the XLA JIT cluster arguments "
+           "listed in the cluster's _XlaBucketedArgs attribute up to a "
+           "bucket to avoid recompilations: empty (disabled), \"pow2\", or "
+           "a comma-separated list of sizes. The outputs listed in "
+           "_XlaBucketedOutputs are sliced back to the unpadded size."),
   });
   xla::legacy_flags::ParseFlagsFromEnv(*flag_list);
 }
@@ -15,6 +15,8 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_JIT_LEGACY_FLAGS_XLA_OPS_COMMON_FLAGS_H_
 #define TENSORFLOW_COMPILER_JIT_LEGACY_FLAGS_XLA_OPS_COMMON_FLAGS_H_
 
+#include "tensorflow/core/platform/types.h"
+
 namespace tensorflow {
 namespace legacy_flags {
 
@@ -23,6 +25,17 @@ struct XlaOpsCommonFlags {
   // If true, _XlaCompile always refuses to compile the cluster, which means the
   // XLA clusters always run in the TF executor.  Defaults to false.
   bool tf_xla_always_defer_compilation;
+
+  // Maximum number of compilations kept in each XLA JIT compilation cache.
+  // Least recently used entries are evicted beyond this.  0 (the default) means
+  // unbounded.
+  int64 tf_xla_compilation_cache_capacity;
+
+  // Shape bucketing policy for the leading dimension of batch-major JIT cluster
+  // arguments (see XlaBucketedArgs), in the format accepted by
+  // XlaShapeBucketingPolicy::Parse: empty (the default, disabled), "pow2", or a
+  // comma-separated list of bucket sizes.
+  string tf_xla_shape_buckets;
 };
 
 // Parses the flags in XlaOpsCommonFlags from the TF_XLA_FLAGS environment
@@ -39,7 +39,16 @@ namespace tensorflow {
 
 XlaCompilationCache::XlaCompilationCache(xla::LocalClient* client,
                                          DeviceType device_type)
-    : client_(client), device_type_(std::move(device_type)) {}
+    : XlaCompilationCache(client, std::move(device_type), /*capacity=*/0,
+                          XlaShapeBucketingPolicy()) {}
+
+XlaCompilationCache::XlaCompilationCache(
+    xla::LocalClient* client, DeviceType device_type, int64 capacity,
+    XlaShapeBucketingPolicy bucketing_policy)
+    : client_(client),
+      device_type_(std::move(device_type)),
+      capacity_(capacity),
+      bucketing_policy_(std::move(bucketing_policy)) {}
 
 XlaCompilationCache::~XlaCompilationCache() {
   // Ensure any use of our programs have completed by waiting for all stream
@@ -60,7 +69,11 @@ XlaCompilationCache::~XlaCompilationCache() {
 }
 
 string XlaCompilationCache::DebugString() {
-  return "XLA JIT compilation cache";
+  mutex_lock lock(compile_cache_mu_);
+  return absl::StrCat("XLA JIT compilation cache (", cache_.size(),
+                      " entries, capacity ", capacity_, ", ", eviction_count_,
+                      " evictions, shape bucketing ",
+                      bucketing_policy_.DebugString(), ")");
 }
 
 // Compute a string signature which encodes the shapes of the
@@ -110,7 +123,8 @@ uint64 XlaCompilationCache::Signature::Hash::operator()(
 
 Status XlaCompilationCache::BuildSignature(
     const NameAttrList& function, const std::map<int, Tensor>& constant_args,
-    const std::map<int, OptionalTensor>& variable_args, OpKernelContext* ctx,
+    const std::map<int, OptionalTensor>& variable_args,
+    const XlaBucketedArgs& bucketed_args, OpKernelContext* ctx,
     Signature* signature) {
   signature->name = Canonicalize(function.name(), AttrSlice(&function.attr()));
   signature->arg_values.reserve(constant_args.size());
@@ -130,8 +144,60 @@ Status XlaCompilationCache::BuildSignature(
         signature->arg_types.emplace_back(DT_INVALID, TensorShape());
       }
     } else {
-      signature->arg_types.emplace_back(ctx->input_dtype(i),
-                                        ctx->input(i).shape());
+      const TensorShape& shape = ctx->input(i).shape();
+      signature->arg_types.emplace_back(
+          ctx->input_dtype(i), bucketed_args.IsBucketedArg(i)
+                                   ? bucketing_policy_.BucketShape(shape)
+                                   : shape);
+    }
+  }
+  return Status::OK();
+}
+
+void XlaCompilationCache::EvictLeastRecentlyUsed(const Entry* keep) {
+  if (capacity_ <= 0) return;
+  while (static_cast<int64>(cache_.size()) > capacity_) {
+    auto victim = cache_.find(*lru_.back());
+    if (victim->second.entry.get() == keep) return;
+    VLOG(1) << "Evicting compilation cache entry for signature: "
+            << SignatureDebugString(victim->first);
+    // The entry itself is destroyed once the last EntryRef to it is released.
+    lru_.pop_back();
+    cache_.erase(victim);
+    ++eviction_count_;
+  }
+}
+
+/*static*/ Status XlaCompilationCache::CheckBucketedArgs(
+    const XlaBucketedArgs& bucketed_args,
+    const std::map<int, Tensor>& constant_args,
+    const std::map<int, OptionalTensor>& variable_args, OpKernelContext* ctx) {
+  int64 rows = -1;
+  for (int i : bucketed_args.args) {
+    if (i >= ctx->num_inputs() || constant_args.count(i) > 0 ||
+        variable_args.count(i) > 0) {
+      return errors::InvalidArgument(
+          "Argument ", i, " listed in ", kXlaBucketedArgsAttr,
+          " is not a non-constant, non-resource argument of the cluster");
+    }
+    const Tensor& input = ctx->input(i);
+    if (input.dims() == 0) {
+      return errors::InvalidArgument("Batch-major argument ", i,
+                                     " is a scalar");
+    }
+    if (rows != -1 && input.dim_size(0) != rows) {
+      return errors::InvalidArgument(
+          "Batch-major arguments must have the same leading dimension, got ",
+          rows, " and ", input.dim_size(0), " for argument ", i);
+    }
+    rows = input.dim_size(0);
+  }
+  for (int i : bucketed_args.outputs) {
+    if (i >= ctx->num_outputs() ||
+        ctx->expected_output_dtype(i) == DT_RESOURCE) {
+      return errors::InvalidArgument(
+          "Output ", i, " listed in ", kXlaBucketedOutputsAttr,
+          " is not a non-resource output of the cluster");
     }
   }
   return Status::OK();
@@ -140,8 +206,12 @@ Status XlaCompilationCache::BuildSignature(
 namespace {
 
 // Builds a XlaCompiler::Argument vector from the arguments to the XlaLaunch op.
+// The leading dimension of the parameters in `bucketed_args` is rounded up by
+// `bucketing_policy`.
 Status BuildArguments(const std::map<int, Tensor>& constant_args,
                       const std::map<int, OptionalTensor>& variable_args,
+                      const XlaShapeBucketingPolicy& bucketing_policy,
+                      const XlaBucketedArgs& bucketed_args,
                       OpKernelContext* ctx,
                       std::vector<XlaCompiler::Argument>* args) {
   args->resize(ctx->num_inputs());
@@ -162,12 +232,15 @@ Status BuildArguments(const std::map<int, Tensor>& constant_args,
       TF_RET_CHECK(input.dtype() != DT_RESOURCE);
       if (input.NumElements() > 0) {
         arg.kind = XlaCompiler::Argument::kParameter;
+        arg.shape = bucketed_args.IsBucketedArg(input_num)
+                        ? bucketing_policy.BucketShape(input.shape())
+                        : input.shape();
       } else {
         arg.kind = XlaCompiler::Argument::kConstant;
         arg.constant_value = input;
+        arg.shape = input.shape();
       }
       arg.type = input.dtype();
-      arg.shape = input.shape();
     } else {
       // Handles resource variables.
       const Tensor& input = ctx->input(input_num);
@@ -232,14 +305,14 @@ Status XlaCompilationCache::Compile(
     const XlaCompiler::CompileOptions& compile_options,
     CompileMode compile_mode,
     const XlaCompiler::CompilationResult** out_compilation_result,
-    xla::LocalExecutable** out_executable) {
+    xla::LocalExecutable** out_executable, EntryRef* out_entry_ref) {
   // Set the compile threshold to 1 to implement CompileMode::kStrict.
   int64 compile_threshold =
       compile_mode == CompileMode::kLazy ? kDefaultCompilationThreshold : 1;
   return CompileImpl(options, function, constant_args, variable_args, ctx,
                      compile_options, /*compile_single_op=*/false,
                      /*compile_threshold=*/compile_threshold,
-                     out_compilation_result, out_executable);
+                     out_compilation_result, out_executable, out_entry_ref);
 }
 
 Status XlaCompilationCache::CompileSingleOp(
@@ -248,7 +321,7 @@ Status XlaCompilationCache::CompileSingleOp(
     const std::map<int, OptionalTensor>& variable_args, OpKernelContext* ctx,
     const XlaCompiler::CompileOptions& compile_options,
     const XlaCompiler::CompilationResult** out_compilation_result,
-    xla::LocalExecutable** out_executable) {
+    xla::LocalExecutable** out_executable, EntryRef* out_entry_ref) {
   const NodeDef& def = ctx->op_kernel().def();
   NameAttrList name;
   name.set_name(def.op());
@@ -256,7 +329,7 @@ Status XlaCompilationCache::CompileSingleOp(
   return CompileImpl(options, name, constant_args, variable_args, ctx,
                      compile_options,
                      /*compile_single_op=*/true, /*compile_threshold=*/1,
-                     out_compilation_result, out_executable);
+                     out_compilation_result, out_executable, out_entry_ref);
 }
 
 Status XlaCompilationCache::CompileImpl(
@@ -266,8 +339,9 @@ Status XlaCompilationCache::CompileImpl(
     const XlaCompiler::CompileOptions& compile_options, bool compile_single_op,
     int64 compile_threshold,
     const XlaCompiler::CompilationResult** out_compilation_result,
-    xla::LocalExecutable** out_executable) {
+    xla::LocalExecutable** out_executable, EntryRef* out_entry_ref) {
   DCHECK_NE(out_executable, nullptr);
+  DCHECK_NE(out_entry_ref, nullptr);
   VLOG(2) << "XlaCompilationCache::Compile " << DebugString();
 
   if (VLOG_IS_ON(2)) {
@@ -296,22 +370,40 @@ Status XlaCompilationCache::CompileImpl(
   TF_RET_CHECK(constant_args.size() + variable_args.size() <=
                ctx->num_inputs());
 
+  // Only the arguments the cluster marks as batch-major are bucketed. Single
+  // ops may depend on the exact shapes of their inputs, so they never are.
+  XlaBucketedArgs bucketed_args;
+  if (bucketing_policy_.enabled() && !compile_single_op) {
+    TF_RETURN_IF_ERROR(XlaBucketedArgs::FromAttrs(AttrSlice(&function.attr()),
+                                                  &bucketed_args));
+    TF_RETURN_IF_ERROR(CheckBucketedArgs(bucketed_args, constant_args,
+                                         variable_args, ctx));
+  }
+
   Signature signature;
-  TF_RETURN_IF_ERROR(
-      BuildSignature(function, constant_args, variable_args, ctx, &signature));
+  TF_RETURN_IF_ERROR(BuildSignature(function, constant_args, variable_args,
+                                    bucketed_args, ctx, &signature));
 
   VLOG(2) << "Signature: " << SignatureDebugString(signature);
   // The outer lock protects the existence of the cache entry. It does not
   // protect the contents of the cache entry.
-  Entry* entry;
+  std::shared_ptr<Entry> entry;
   {
     mutex_lock lock(compile_cache_mu_);
     // Find or create a cache entry.
-    std::unique_ptr<Entry>& e = cache_[signature];
-    if (!e) {
-      e.reset(new Entry);
+    auto it = cache_.try_emplace(signature).first;
+    CacheValue& value = it->second;
+    if (!value.entry) {
+      lru_.push_front(&it->first);
+      value.lru_position = lru_.begin();
+      value.entry = std::make_shared<Entry>();
+      value.entry->bucketed_args = std::move(bucketed_args);
+      entry = value.entry;
+      EvictLeastRecentlyUsed(entry.get());
+    } else {
+      lru_.splice(lru_.begin(), lru_, value.lru_position);
+      entry = value.entry;
     }
-    entry = e.get();
   }
 
   // We always compile a cluster the very first time it is executed.  This is an
@@ -327,9 +419,8 @@ Status XlaCompilationCache::CompileImpl(
     return it->second.execution_count++ == 0;
   }();
 
-  // Acquire the cache entry lock and compile, if necessary.
-  // TODO(phawkins): this locking will need to be restructured when we implement
-  // cache eviction.
+  // Acquire the cache entry lock and compile, if necessary. Holding `entry`
+  // keeps it alive even if it is concurrently evicted from the cache.
   mutex_lock entry_lock(entry->mu);
   int64 current_request_count = ++entry->request_count;
   if (!entry->compiled) {
@@ -348,8 +439,9 @@ Status XlaCompilationCache::CompileImpl(
     // Do the actual JIT compilation without holding the lock (it can take
     // a long time.)
     std::vector<XlaCompiler::Argument> args;
-    TF_RETURN_IF_ERROR(
-        BuildArguments(constant_args, variable_args, ctx, &args));
+    TF_RETURN_IF_ERROR(BuildArguments(constant_args, variable_args,
+                                      bucketing_policy_, entry->bucketed_args,
+                                      ctx, &args));
 
     XlaCompiler compiler(options);
     entry->compiled = true;
@@ -390,6 +482,7 @@ Status XlaCompilationCache::CompileImpl(
   TF_RETURN_IF_ERROR(entry->compilation_status);
   *out_compilation_result = &entry->compilation_result;
   *out_executable = entry->executable.get();
+  *out_entry_ref = entry;
   return Status::OK();
 }
 
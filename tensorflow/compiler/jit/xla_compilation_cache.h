@@ -16,7 +16,12 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_JIT_XLA_COMPILATION_CACHE_H_
 #define TENSORFLOW_COMPILER_JIT_XLA_COMPILATION_CACHE_H_
 
+#include <list>
+#include <memory>
+
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/node_hash_map.h"
+#include "tensorflow/compiler/jit/xla_shape_bucketing.h"
 #include "tensorflow/compiler/tf2xla/xla_compiler.h"
 #include "tensorflow/compiler/tf2xla/xla_context.h"
 #include "tensorflow/compiler/xla/client/local_client.h"
@@ -43,11 +48,21 @@ struct OptionalTensor {
 // Since XLA computations must have static shapes, the cache generates a new
 // XLA computation for each new set of input shapes.
 //
-// Currently no cache eviction policy is implemented and the cache grows without
-// bound.
+// To bound the number of compilations for clusters with dynamically shaped
+// inputs, the cache can optionally round the leading dimension of the
+// arguments a cluster marks as batch-major up to a fixed set of buckets (see
+// XlaShapeBucketingPolicy and XlaBucketedArgs), and evict the least recently
+// used entries once it holds more than `capacity` compilations. By default
+// neither is enabled and the cache grows without bound.
 class XlaCompilationCache : public ResourceBase {
  public:
   XlaCompilationCache(xla::LocalClient* client, DeviceType device_type);
+
+  // `capacity` is the maximum number of cached compilations; 0 means
+  // unbounded. `bucketing_policy` is applied to the argument shapes of
+  // functions compiled with Compile() (but not CompileSingleOp()).
+  XlaCompilationCache(xla::LocalClient* client, DeviceType device_type,
+                      int64 capacity, XlaShapeBucketingPolicy bucketing_policy);
   ~XlaCompilationCache() override;
 
   enum class CompileMode {
@@ -55,6 +70,14 @@ class XlaCompilationCache : public ResourceBase {
     kStrict,
   };
 
+  struct Entry;
+
+  // A reference to a cache entry. The compilation result and executable
+  // returned by Compile() point into the entry; they remain valid for as long
+  // as the EntryRef is alive, even if the entry is evicted from the cache in
+  // the meantime.
+  using EntryRef = std::shared_ptr<const Entry>;
+
   // Compiles a function into a XlaCompiler::CompilationResult that can be used
   // to execute an XLA Computation. Compilation results are cached.
   // `function` is the name of a Tensorflow function to compile.
@@ -75,7 +98,14 @@ class XlaCompilationCache : public ResourceBase {
   // be non-null. If `executable` is non-null, also builds an
   // xla::LocalExecutable and sets `executable` to point to it. The resulting
   // executable pointer may be null if the computation has no non-constant
-  // outputs.
+  // outputs. `*out_entry_ref` keeps both alive; callers must hold on to it for
+  // as long as they use either.
+  //
+  // If a bucketing policy is set, the batch-major arguments listed in the
+  // kXlaBucketedArgsAttr attribute of `function` may have been compiled for a
+  // larger leading dimension than that of the inputs in `ctx`; the entry's
+  // `bucketed_args` lists them. See
+  // XlaComputationLaunchContext::PadBucketedInputs.
   Status Compile(const XlaCompiler::Options& options,
                  const NameAttrList& function,
                  const std::map<int, Tensor>& constant_args,
@@ -84,7 +114,8 @@ class XlaCompilationCache : public ResourceBase {
                  const XlaCompiler::CompileOptions& compile_options,
                  CompileMode compile_mode,
                  const XlaCompiler::CompilationResult** out_compilation_result,
-                 xla::LocalExecutable** out_executable);
+                 xla::LocalExecutable** out_executable,
+                 EntryRef* out_entry_ref);
 
   // As above, but calls XlaCompiler::CompileSingleOp instead of
   // XlaCompiler::CompileFunction.
@@ -94,10 +125,40 @@ class XlaCompilationCache : public ResourceBase {
       const std::map<int, OptionalTensor>& variable_args, OpKernelContext* ctx,
       const XlaCompiler::CompileOptions& compile_options,
       const XlaCompiler::CompilationResult** out_compilation_result,
-      xla::LocalExecutable** out_executable);
+      xla::LocalExecutable** out_executable, EntryRef* out_entry_ref);
 
   xla::LocalClient* client() const { return client_; }
   const DeviceType& device_type() const { return device_type_; }
+  int64 capacity() const { return capacity_; }
+  const XlaShapeBucketingPolicy& bucketing_policy() const {
+    return bucketing_policy_;
+  }
+
+  // The value associated with a cache entry.
+  struct Entry {
+    mutex mu;
+
+    // The batch-major arguments and outputs whose leading dimension was
+    // bucketed for this compilation. Empty if nothing was bucketed. Set when
+    // the entry is created and immutable afterwards.
+    XlaBucketedArgs bucketed_args;
+
+    // Have we tried compiling this entry?
+    bool compiled = false;
+
+    // The number of times a compilation with this signature has been requested.
+    int64 request_count = 0;
+
+    // Did compilation succeed?
+    Status compilation_status GUARDED_BY(mu);
+
+    // Output of the XlaCompiler.
+    XlaCompiler::CompilationResult compilation_result GUARDED_BY(mu);
+
+    // The XLA executable compiled from <computation>. May be null if no
+    // executable has been built.
+    std::unique_ptr<xla::LocalExecutable> executable GUARDED_BY(mu);
+  };
 
   string DebugString() override;
 
@@ -110,7 +171,7 @@ class XlaCompilationCache : public ResourceBase {
       const XlaCompiler::CompileOptions& compile_options,
       bool compile_single_op, int64 compile_threshold,
       const XlaCompiler::CompilationResult** out_compilation_result,
-      xla::LocalExecutable** out_executable);
+      xla::LocalExecutable** out_executable, EntryRef* out_entry_ref);
 
   // Takes `result` which has been compiled from a Tensorflow subgraph to a
   // XLA computation already, and generates an XLA LocalExecutable `executable`.
@@ -120,6 +181,8 @@ class XlaCompilationCache : public ResourceBase {
 
   xla::LocalClient* const client_;
   const DeviceType device_type_;
+  const int64 capacity_;
+  const XlaShapeBucketingPolicy bucketing_policy_;
 
   // Describes the types, shapes and any compile-time constant arguments
   // to a kernel. Key that uniquely identifies a compilation output.
@@ -140,36 +203,45 @@ class XlaCompilationCache : public ResourceBase {
   };
   static string SignatureDebugString(const Signature& sig);
 
-  // Builds the signature for a compilation.
+  // Builds the signature for a compilation. The leading dimension of the
+  // parameters in `bucketed_args` is rounded up by `bucketing_policy_`.
   Status BuildSignature(const NameAttrList& function,
                         const std::map<int, Tensor>& constant_args,
                         const std::map<int, OptionalTensor>& variable_args,
+                        const XlaBucketedArgs& bucketed_args,
                         OpKernelContext* ctx, Signature* signature);
 
-  // The value associated with a cache entry.
-  struct Entry {
-    mutex mu;
-
-    // Have we tried compiling this entry?
-    bool compiled = false;
+  // Checks that `bucketed_args` only lists non-constant, non-resource
+  // arguments and outputs of the kernel in `ctx`, and that the listed
+  // arguments have a common leading dimension.
+  static Status CheckBucketedArgs(
+      const XlaBucketedArgs& bucketed_args,
+      const std::map<int, Tensor>& constant_args,
+      const std::map<int, OptionalTensor>& variable_args, OpKernelContext* ctx);
 
-    // The number of times a compilation with this signature has been requested.
-    int64 request_count = 0;
+  // Evicts least recently used entries until at most `capacity_` remain.
+  // `keep` is never evicted.
+  void EvictLeastRecentlyUsed(const Entry* keep)
+      EXCLUSIVE_LOCKS_REQUIRED(compile_cache_mu_);
 
-    // Did compilation succeed?
-    Status compilation_status GUARDED_BY(mu);
+  // Signatures of the entries in `cache_`, most recently used first. The
+  // signatures are owned by `cache_`, whose keys do not move.
+  using LruList = std::list<const Signature*>;
 
-    // Output of the XlaCompiler.
-    XlaCompiler::CompilationResult compilation_result GUARDED_BY(mu);
+  struct CacheValue {
+    std::shared_ptr<Entry> entry;
 
-    // The XLA executable compiled from <computation>. May be null if no
-    // executable has been built.
-    std::unique_ptr<xla::LocalExecutable> executable GUARDED_BY(mu);
+    // Position of this entry's signature in `lru_`.
+    LruList::iterator lru_position;
   };
 
   mutex compile_cache_mu_;
-  absl::flat_hash_map<Signature, std::unique_ptr<Entry>, Signature::Hash> cache_
+  absl::node_hash_map<Signature, CacheValue, Signature::Hash> cache_
       GUARDED_BY(compile_cache_mu_);
+  LruList lru_ GUARDED_BY(compile_cache_mu_);
+
+  // Number of entries evicted so far.
+  int64 eviction_count_ GUARDED_BY(compile_cache_mu_) = 0;
 
   struct ClusterCompileStats {
     // Number of times the cluster has been (re-)compiled.
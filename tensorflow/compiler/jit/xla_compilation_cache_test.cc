@@ -0,0 +1,379 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/jit/xla_compilation_cache.h"
+
+#include "absl/memory/memory.h"
+#include "absl/strings/match.h"
+#include "tensorflow/compiler/jit/create_xla_launch_op.h"
+#include "tensorflow/compiler/jit/xla_launch_util.h"
+#include "tensorflow/compiler/jit/xla_shape_bucketing.h"
+#include "tensorflow/compiler/tf2xla/xla_op_registry.h"
+#include "tensorflow/compiler/xla/client/client_library.h"
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/function.h"
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/framework/function_testlib.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+// y = x + b, where x is batch-major and b is a bias that is not.
+// bb = b * b does not depend on the batch.
+// z = zeros_like(x) is batch-major and compiles to a constant output.
+FunctionDef AddBias() {
+  FunctionDef fdef = FunctionDefHelper::Define(
+      // Name
+      "AddBias",
+      // Args
+      {"x: float", "b: float"},
+      // Return values
+      {"y: float", "bb: float", "z: float"},
+      // Attr def
+      {},
+      // Nodes
+      {
+          {{"y"}, "Add", {"x", "b"}, {{"T", DT_FLOAT}}},
+          {{"bb"}, "Mul", {"b", "b"}, {{"T", DT_FLOAT}}},
+          {{"z"}, "ZerosLike", {"x"}, {{"T", DT_FLOAT}}},
+      });
+  AttrValue compile;
+  compile.set_b(true);
+  (*fdef.mutable_attr())["_XlaCompile"] = compile;
+  return fdef;
+}
+
+class XlaCompilationCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    SessionOptions options;
+    auto* device_count = options.config.mutable_device_count();
+    device_count->insert({"CPU", 1});
+    TF_CHECK_OK(DeviceFactory::AddDevices(
+        options, "/job:localhost/replica:0/task:0", &devices_));
+    device_ = devices_[0];
+
+    FunctionDefLibrary proto;
+    *proto.add_function() = AddBias();
+    lib_def_ = absl::make_unique<FunctionLibraryDefinition>(
+        OpRegistry::Global(), proto);
+    OptimizerOptions opts;
+    device_mgr_ = absl::make_unique<DeviceMgr>(devices_);
+    pflr_ = absl::make_unique<ProcessFunctionLibraryRuntime>(
+        device_mgr_.get(), Env::Default(), TF_GRAPH_DEF_VERSION, lib_def_.get(),
+        opts, /*default_thread_pool=*/nullptr, /*cluster_flr=*/nullptr);
+    flr_ = pflr_->GetFLR("/job:localhost/replica:0/task:0/cpu:0");
+
+    // The XlaLaunch kernel only provides the input and output types of the
+    // OpKernelContexts below; the tests drive the cache directly.
+    NodeDef node_def;
+    node_def.set_name("AddBias");
+    node_def.set_op("AddBias");
+    node_def.add_input("x");
+    node_def.add_input("b");
+    TF_ASSERT_OK(CreateXlaLaunchOp(flr_, node_def, &kernel_));
+
+    function_.set_name("AddBias");
+    SetAttrValue(std::vector<int>{0},
+                 &(*function_.mutable_attr())[kXlaBucketedArgsAttr]);
+    SetAttrValue(std::vector<int>{0, 2},
+                 &(*function_.mutable_attr())[kXlaBucketedOutputsAttr]);
+
+    client_ = xla::ClientLibrary::LocalClientOrDie();
+    xla_allocator_ = absl::make_unique<XlaAllocator>(
+        client_->platform(), device_->GetAllocator({}));
+  }
+
+  // Returns a new cache that the caller must Unref().
+  XlaCompilationCache* NewCache(int64 capacity, const string& buckets) {
+    XlaShapeBucketingPolicy policy;
+    TF_CHECK_OK(XlaShapeBucketingPolicy::Parse(buckets, &policy));
+    return new XlaCompilationCache(client_, DeviceType(DEVICE_CPU_XLA_JIT),
+                                   capacity, std::move(policy));
+  }
+
+  // An OpKernelContext for the AddBias kernel with inputs `x` and `b`.
+  class Context {
+   public:
+    Context(XlaCompilationCacheTest* test, const Tensor& x, const Tensor& b)
+        : x_(x), b_(b), output_attrs_(3) {
+      inputs_ = {TensorValue(&x_), TensorValue(&b_)};
+      params_.device = test->device_;
+      params_.op_kernel = test->kernel_.get();
+      params_.inputs = &inputs_;
+      params_.output_attr_array = output_attrs_.data();
+      params_.function_library = test->flr_;
+      ctx_ = absl::make_unique<OpKernelContext>(&params_, /*num_outputs=*/3);
+    }
+
+    OpKernelContext* get() { return ctx_.get(); }
+
+   private:
+    Tensor x_;
+    Tensor b_;
+    gtl::InlinedVector<TensorValue, 4> inputs_;
+    std::vector<AllocatorAttributes> output_attrs_;
+    OpKernelContext::Params params_;
+    std::unique_ptr<OpKernelContext> ctx_;
+  };
+
+  // Compiles AddBias for `x` and `b`.
+  Status Compile(XlaCompilationCache* cache, const NameAttrList& function,
+                 const Tensor& x, const Tensor& b,
+                 const XlaCompiler::CompilationResult** result,
+                 xla::LocalExecutable** executable,
+                 XlaCompilationCache::EntryRef* entry_ref) {
+    Context ctx(this, x, b);
+    XlaCompiler::Options options;
+    options.client = client_;
+    options.device_type = cache->device_type();
+    options.flib_def = flr_->GetFunctionLibraryDefinition();
+    options.graph_def_version = flr_->graph_def_version();
+    options.allow_cpu_custom_calls = true;
+    options.device_allocator = xla_allocator_.get();
+
+    XlaCompiler::CompileOptions compile_options;
+    compile_options.is_entry_computation = true;
+    compile_options.resolve_compile_time_constants = true;
+    compile_options.always_return_tuple = false;
+    return cache->Compile(options, function, /*constant_args=*/{},
+                          /*variable_args=*/{}, ctx.get(), compile_options,
+                          XlaCompilationCache::CompileMode::kStrict, result,
+                          executable, entry_ref);
+  }
+
+  // Runs a compilation of AddBias on `x` and `b` the way XlaLaunch does, and
+  // returns its outputs.
+  Status Run(const XlaCompiler::CompilationResult* result,
+             xla::LocalExecutable* executable,
+             const XlaCompilationCache::EntryRef& entry_ref, const Tensor& x,
+             const Tensor& b, std::vector<Tensor>* outputs) {
+    Context ctx(this, x, b);
+    XlaComputationLaunchContext launch_context(
+        client_, xla_allocator_.get(), /*allocate_xla_tensors=*/false,
+        /*use_multiple_streams=*/false);
+    TF_RETURN_IF_ERROR(launch_context.PadBucketedInputs(
+        ctx.get(), result, entry_ref->bucketed_args,
+        /*missing_ctx_input_prefix=*/0));
+    launch_context.PopulateInputs(ctx.get(), result, /*variables=*/{},
+                                  /*missing_ctx_input_prefix=*/0);
+
+    xla::ExecutableRunOptions run_options;
+    run_options.set_allocator(xla_allocator_.get());
+    run_options.set_intra_op_thread_pool(device_->eigen_cpu_device());
+    auto run_result = executable->Run(launch_context.arguments(), run_options);
+    TF_RETURN_IF_ERROR(run_result.status());
+    TF_RETURN_IF_ERROR(launch_context.PopulateOutputs(
+        ctx.get(), result, run_result.ConsumeValueOrDie(),
+        /*missing_ctx_input_prefix=*/0));
+
+    outputs->clear();
+    for (int i = 0; i < ctx.get()->num_outputs(); ++i) {
+      outputs->push_back(*ctx.get()->mutable_output(i));
+    }
+    return Status::OK();
+  }
+
+  // Compiles and runs AddBias on `x` and `b` and checks its outputs.
+  void CompileRunAndCheck(XlaCompilationCache* cache, const Tensor& x,
+                          const Tensor& b) {
+    const XlaCompiler::CompilationResult* result;
+    xla::LocalExecutable* executable;
+    XlaCompilationCache::EntryRef entry_ref;
+    TF_ASSERT_OK(
+        Compile(cache, function_, x, b, &result, &executable, &entry_ref));
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(Run(result, executable, entry_ref, x, b, &outputs));
+    CheckOutputs(x, b, outputs);
+  }
+
+  static void CheckOutputs(const Tensor& x, const Tensor& b,
+                           const std::vector<Tensor>& outputs) {
+    ASSERT_EQ(3, outputs.size());
+    Tensor y(DT_FLOAT, x.shape());
+    Tensor bb(DT_FLOAT, b.shape());
+    const int64 cols = b.NumElements();
+    for (int64 i = 0; i < x.NumElements(); ++i) {
+      y.flat<float>()(i) = x.flat<float>()(i) + b.flat<float>()(i % cols);
+    }
+    for (int64 i = 0; i < cols; ++i) {
+      bb.flat<float>()(i) = b.flat<float>()(i) * b.flat<float>()(i);
+    }
+    Tensor z(DT_FLOAT, x.shape());
+    z.flat<float>().setZero();
+    test::ExpectTensorEqual<float>(y, outputs[0]);
+    test::ExpectTensorEqual<float>(bb, outputs[1]);
+    test::ExpectTensorEqual<float>(z, outputs[2]);
+  }
+
+  static Tensor Iota(const TensorShape& shape) {
+    Tensor t(DT_FLOAT, shape);
+    for (int64 i = 0; i < t.NumElements(); ++i) {
+      t.flat<float>()(i) = i + 1;
+    }
+    return t;
+  }
+
+  std::vector<Device*> devices_;
+  Device* device_;
+  std::unique_ptr<DeviceMgr> device_mgr_;
+  std::unique_ptr<FunctionLibraryDefinition> lib_def_;
+  std::unique_ptr<ProcessFunctionLibraryRuntime> pflr_;
+  FunctionLibraryRuntime* flr_;
+  std::unique_ptr<OpKernel> kernel_;
+  NameAttrList function_;
+  xla::LocalClient* client_;
+  std::unique_ptr<XlaAllocator> xla_allocator_;
+};
+
+TEST_F(XlaCompilationCacheTest, PadsAndSlicesOnlyBatchMajorArguments) {
+  XlaCompilationCache* cache = NewCache(/*capacity=*/0, "4,8");
+  core::ScopedUnref cache_ref(cache);
+
+  // The bias has the same leading dimension as the padded batch, but is not
+  // batch-major, so neither it nor `bb` may be padded or sliced.
+  const Tensor b = Iota(TensorShape({4}));
+  const XlaCompiler::CompilationResult* result;
+  xla::LocalExecutable* executable;
+  XlaCompilationCache::EntryRef entry_ref;
+  TF_ASSERT_OK(Compile(cache, function_, Iota(TensorShape({3, 4})), b, &result,
+                       &executable, &entry_ref));
+  ASSERT_EQ(2, result->xla_input_shapes.size());
+  EXPECT_EQ(4, result->xla_input_shapes[0].dimensions(0));
+  EXPECT_EQ(4, result->xla_input_shapes[1].dimensions(0));
+
+  for (int64 rows : {1, 3, 4}) {
+    SCOPED_TRACE(rows);
+    CompileRunAndCheck(cache, Iota(TensorShape({rows, 4})), b);
+  }
+  // Sizes within the same bucket share a compilation.
+  XlaCompilationCache::EntryRef other_entry_ref;
+  TF_ASSERT_OK(Compile(cache, function_, Iota(TensorShape({1, 4})), b, &result,
+                       &executable, &other_entry_ref));
+  EXPECT_EQ(entry_ref.get(), other_entry_ref.get());
+
+  // Beyond the largest bucket the shapes are compiled for exactly.
+  CompileRunAndCheck(cache, Iota(TensorShape({9, 4})), b);
+}
+
+TEST_F(XlaCompilationCacheTest, NothingIsBucketedWithoutAttributes) {
+  XlaCompilationCache* cache = NewCache(/*capacity=*/0, "pow2");
+  core::ScopedUnref cache_ref(cache);
+
+  NameAttrList function;
+  function.set_name("AddBias");
+  const XlaCompiler::CompilationResult* result;
+  xla::LocalExecutable* executable;
+  XlaCompilationCache::EntryRef entry_ref;
+  TF_ASSERT_OK(Compile(cache, function, Iota(TensorShape({3, 2})),
+                       Iota(TensorShape({2})), &result, &executable,
+                       &entry_ref));
+  EXPECT_TRUE(entry_ref->bucketed_args.empty());
+  ASSERT_EQ(2, result->xla_input_shapes.size());
+  EXPECT_EQ(3, result->xla_input_shapes[0].dimensions(0));
+  EXPECT_EQ(2, result->xla_input_shapes[1].dimensions(0));
+}
+
+TEST_F(XlaCompilationCacheTest, RejectsInvalidBucketedArgs) {
+  XlaCompilationCache* cache = NewCache(/*capacity=*/0, "pow2");
+  core::ScopedUnref cache_ref(cache);
+
+  NameAttrList function = function_;
+  SetAttrValue(std::vector<int>{0, 2},
+               &(*function.mutable_attr())[kXlaBucketedArgsAttr]);
+  const XlaCompiler::CompilationResult* result;
+  xla::LocalExecutable* executable;
+  XlaCompilationCache::EntryRef entry_ref;
+  Status status =
+      Compile(cache, function, Iota(TensorShape({3, 2})),
+              Iota(TensorShape({2})), &result, &executable, &entry_ref);
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+
+  // Batch-major arguments must agree on the batch size.
+  SetAttrValue(std::vector<int>{0, 1},
+               &(*function.mutable_attr())[kXlaBucketedArgsAttr]);
+  status = Compile(cache, function, Iota(TensorShape({3, 2})),
+                   Iota(TensorShape({2})), &result, &executable, &entry_ref);
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+}
+
+TEST_F(XlaCompilationCacheTest, EvictsLeastRecentlyUsedEntries) {
+  XlaCompilationCache* cache = NewCache(/*capacity=*/2, "");
+  core::ScopedUnref cache_ref(cache);
+
+  const Tensor b = Iota(TensorShape({2}));
+  const XlaCompiler::CompilationResult* result;
+  xla::LocalExecutable* executable;
+  std::vector<XlaCompilationCache::EntryRef> entry_refs(3);
+  for (int64 rows : {1, 2}) {
+    TF_ASSERT_OK(Compile(cache, function_, Iota(TensorShape({rows, 2})), b,
+                         &result, &executable, &entry_refs[rows - 1]));
+  }
+  // Use the first entry again, so that the second one is evicted next.
+  XlaCompilationCache::EntryRef entry_ref;
+  TF_ASSERT_OK(Compile(cache, function_, Iota(TensorShape({1, 2})), b, &result,
+                       &executable, &entry_ref));
+  EXPECT_EQ(entry_refs[0].get(), entry_ref.get());
+  TF_ASSERT_OK(Compile(cache, function_, Iota(TensorShape({3, 2})), b, &result,
+                       &executable, &entry_refs[2]));
+  EXPECT_TRUE(absl::StrContains(cache->DebugString(), "1 evictions"));
+
+  TF_ASSERT_OK(Compile(cache, function_, Iota(TensorShape({1, 2})), b, &result,
+                       &executable, &entry_ref));
+  EXPECT_EQ(entry_refs[0].get(), entry_ref.get());
+  TF_ASSERT_OK(Compile(cache, function_, Iota(TensorShape({2, 2})), b, &result,
+                       &executable, &entry_ref));
+  EXPECT_NE(entry_refs[1].get(), entry_ref.get());
+}
+
+TEST_F(XlaCompilationCacheTest, EntryRefOutlivesEviction) {
+  XlaCompilationCache* cache = NewCache(/*capacity=*/1, "4");
+  core::ScopedUnref cache_ref(cache);
+
+  const Tensor x = Iota(TensorShape({3, 2}));
+  const Tensor b = Iota(TensorShape({2}));
+  const XlaCompiler::CompilationResult* result;
+  xla::LocalExecutable* executable;
+  XlaCompilationCache::EntryRef entry_ref;
+  TF_ASSERT_OK(
+      Compile(cache, function_, x, b, &result, &executable, &entry_ref));
+
+  // Evict the entry; `entry_ref` keeps its result and executable alive.
+  const XlaCompiler::CompilationResult* other_result;
+  xla::LocalExecutable* other_executable;
+  XlaCompilationCache::EntryRef other_entry_ref;
+  TF_ASSERT_OK(Compile(cache, function_, Iota(TensorShape({7, 2})), b,
+                       &other_result, &other_executable, &other_entry_ref));
+  EXPECT_TRUE(absl::StrContains(cache->DebugString(), "1 evictions"));
+  other_entry_ref.reset();
+
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(Run(result, executable, entry_ref, x, b, &outputs));
+  CheckOutputs(x, b, outputs);
+
+  // The last reference to an evicted entry frees it.
+  std::weak_ptr<const XlaCompilationCache::Entry> weak_entry = entry_ref;
+  entry_ref.reset();
+  EXPECT_TRUE(weak_entry.expired());
+}
+
+}  // namespace
+}  // namespace tensorflow
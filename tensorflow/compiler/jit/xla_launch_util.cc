@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/jit/xla_launch_util.h"
 
+#include <algorithm>
 #include <memory>
 
 #include "absl/algorithm/container.h"
@@ -238,6 +239,88 @@ XlaComputationLaunchContext::XlaComputationLaunchContext(
   }
 }
 
+Status XlaComputationLaunchContext::PadBucketedInputs(
+    OpKernelContext* ctx, const XlaCompiler::CompilationResult* kernel,
+    const XlaBucketedArgs& bucketed_args, int missing_ctx_input_prefix) {
+  se::Stream* stream =
+      ctx->op_device_context() ? ctx->op_device_context()->stream() : nullptr;
+  for (int i = 0; i < kernel->xla_input_shapes.size(); ++i) {
+    int arg_num = kernel->input_mapping[i];
+    if (!bucketed_args.IsBucketedArg(arg_num)) continue;
+    const xla::Shape& shape = kernel->xla_input_shapes[i];
+    TF_RET_CHECK(xla::ShapeUtil::IsArray(shape) &&
+                 xla::ShapeUtil::Rank(shape) > 0);
+    const Tensor& input = ctx->input(arg_num - missing_ctx_input_prefix);
+    TF_RET_CHECK(input.dims() == xla::ShapeUtil::Rank(shape));
+    const int64 rows = input.dim_size(0);
+    const int64 padded_rows = shape.dimensions(0);
+    TF_RET_CHECK(rows <= padded_rows);
+    if (unpadded_rows_ == -1) {
+      unpadded_rows_ = rows;
+      padded_rows_ = padded_rows;
+    } else if (rows != unpadded_rows_ || padded_rows != padded_rows_) {
+      return errors::InvalidArgument(
+          "Shape bucketing requires all batch-major arguments to have the "
+          "same leading dimension, got ",
+          unpadded_rows_, " and ", rows);
+    }
+    if (rows == padded_rows) continue;
+
+    if (allocate_xla_tensors_) {
+      return errors::Unimplemented(
+          "Shape bucketing is not supported on XLA devices");
+    }
+    TF_RET_CHECK(DataTypeCanUseMemcpy(input.dtype()));
+
+    TensorShape padded_shape = input.shape();
+    padded_shape.set_dim(0, padded_rows);
+    Tensor padded;
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_temp(input.dtype(), padded_shape, &padded));
+
+    // Padding the leading dimension appends whole rows, so the input occupies
+    // a prefix of the padded buffer.
+    const uint64 input_bytes = input.TotalBytes();
+    const uint64 pad_bytes = padded.TotalBytes() - input_bytes;
+    if (stream) {
+      se::DeviceMemoryBase src = XlaTensor::DeviceMemoryFromTensor(input);
+      se::DeviceMemoryBase dst = XlaTensor::DeviceMemoryFromTensor(padded);
+      se::DeviceMemoryBase dst_tail(
+          static_cast<char*>(dst.opaque()) + input_bytes, pad_bytes);
+      stream->ThenMemcpy(&dst, src, input_bytes);
+      stream->ThenMemZero(&dst_tail, pad_bytes);
+    } else {
+      char* dst = const_cast<char*>(padded.tensor_data().data());
+      memcpy(dst, input.tensor_data().data(), input_bytes);
+      memset(dst + input_bytes, 0, pad_bytes);
+    }
+    VLOG(2) << "Padded argument " << i << " from " << rows << " to "
+            << padded_rows << " rows";
+    padded_inputs_[i] = std::move(padded);
+  }
+  if (!padded_inputs_.empty()) {
+    bucketed_outputs_ = bucketed_args.outputs;
+  }
+  return Status::OK();
+}
+
+Status XlaComputationLaunchContext::UnpadBucketedOutput(int i,
+                                                        Tensor* output) const {
+  if (!std::binary_search(bucketed_outputs_.begin(), bucketed_outputs_.end(),
+                          i)) {
+    return Status::OK();
+  }
+  if (output->dims() == 0 || output->dim_size(0) != padded_rows_) {
+    return errors::InvalidArgument(
+        "Batch-major output ", i, " has shape ", output->shape().DebugString(),
+        ", expected a leading dimension of ", padded_rows_);
+  }
+  // Drop the rows computed from padding. Slicing the leading dimension shares
+  // the underlying buffer.
+  *output = output->Slice(0, unpadded_rows_);
+  return Status::OK();
+}
+
 void XlaComputationLaunchContext::PopulateInputs(
     OpKernelContext* ctx, const XlaCompiler::CompilationResult* kernel,
     const std::map<int, OptionalTensor>& variables,
@@ -258,6 +341,8 @@ void XlaComputationLaunchContext::PopulateInputs(
     if (variables.count(arg_num)) {
       t = &(variables.at(arg_num).value);
       CHECK(t);
+    } else if (padded_inputs_.count(i)) {
+      t = &padded_inputs_.at(i);
     } else {
       t = &(ctx->input(arg_num - missing_ctx_input_prefix));
     }
@@ -335,7 +420,8 @@ Status XlaComputationLaunchContext::PopulateOutputs(
     Allocator* allocator = ctx->device()->GetAllocator({});
     if (kernel->outputs[i].is_constant) {
       // Output is a constant.
-      const Tensor& const_tensor = kernel->outputs[i].constant_value;
+      Tensor const_tensor = kernel->outputs[i].constant_value;
+      TF_RETURN_IF_ERROR(UnpadBucketedOutput(i, &const_tensor));
       Tensor* output_tensor;
       const size_t total_bytes = const_tensor.TotalBytes();
       if (stream && total_bytes > 0) {
@@ -387,6 +473,8 @@ Status XlaComputationLaunchContext::PopulateOutputs(
       } else {
         se::DeviceMemoryBase buffer = output.buffer({output_num});
         if (allocate_xla_tensors_) {
+          // PadBucketedInputs() never pads on XLA devices.
+          TF_RET_CHECK(bucketed_outputs_.empty());
           Tensor* output_tensor;
           TF_RETURN_IF_ERROR(ctx->allocate_output(i, shape, &output_tensor));
           XlaTensor* xla_tensor = XlaTensor::FromTensor(output_tensor);
@@ -405,6 +493,7 @@ Status XlaComputationLaunchContext::PopulateOutputs(
           Tensor output_tensor = XlaTensorBuffer::MakeTensor(
               ctx->expected_output_dtype(i), shape, buffer, allocator);
           output.set_buffer(xla::OwningDeviceMemory(), {output_num});
+          TF_RETURN_IF_ERROR(UnpadBucketedOutput(i, &output_tensor));
           ctx->set_output(i, output_tensor);
         }
         ++output_num;
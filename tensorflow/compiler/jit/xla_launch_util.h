@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "absl/base/thread_annotations.h"
 #include "tensorflow/compiler/jit/xla_compilation_cache.h"
+#include "tensorflow/compiler/jit/xla_shape_bucketing.h"
 #include "tensorflow/compiler/jit/xla_tensor.h"
 #include "tensorflow/compiler/tf2xla/xla_compiler.h"
 #include "tensorflow/compiler/xla/client/local_client.h"
@@ -139,6 +140,19 @@ class XlaComputationLaunchContext {
                               bool allocate_xla_tensors,
                               bool use_multiple_streams);
 
+  // Pads the batch-major inputs within `ctx` listed in `bucketed_args` whose
+  // leading dimension is smaller than the one `kernel` was compiled for, which
+  // happens when the compilation cache applies an XlaShapeBucketingPolicy. The
+  // padded rows are zeroed. All batch-major inputs must share the same leading
+  // dimension, which PopulateOutputs() restores on the batch-major outputs
+  // listed in `bucketed_args`. Must be called before PopulateInputs(); a no-op
+  // if no input needs padding. Padding is not supported when
+  // `allocate_xla_tensors` is true.
+  Status PadBucketedInputs(OpKernelContext* ctx,
+                           const XlaCompiler::CompilationResult* kernel,
+                           const XlaBucketedArgs& bucketed_args,
+                           int missing_ctx_input_prefix);
+
   // Add all inputs within `ctx` as XLA arguments (returned by arguments()).
   // `variables` is a map from TensorFlow argument number to resource variable.
   //
@@ -161,6 +175,9 @@ class XlaComputationLaunchContext {
   //
   // Assumes that the first `missing_ctx_input_prefix` inputs to the kernel are
   // missing and adjusts input indices accordingly.
+  //
+  // If inputs were padded by PadBucketedInputs(), the batch-major outputs,
+  // including constant ones, are sliced back to the unpadded size.
   Status PopulateOutputs(OpKernelContext* ctx,
                          const XlaCompiler::CompilationResult* kernel,
                          xla::ScopedShapedBuffer output,
@@ -177,6 +194,22 @@ class XlaComputationLaunchContext {
   bool use_multiple_streams_;
   std::vector<std::unique_ptr<xla::ShapedBuffer>> arg_buffers_;
   std::vector<xla::ShapedBuffer*> arg_ptrs_;
+
+  // Padded copies of bucketed inputs, keyed by XLA argument number.
+  std::map<int, Tensor> padded_inputs_;
+
+  // Leading dimension of the batch-major inputs before and after padding, or
+  // -1 if there are none.
+  int64 unpadded_rows_ = -1;
+  int64 padded_rows_ = -1;
+
+  // Sorted indices of the outputs to slice back to `unpadded_rows_`. Empty if
+  // no input was padded.
+  std::vector<int> bucketed_outputs_;
+
+  // Slices output `i` back to `unpadded_rows_` if it is in
+  // `bucketed_outputs_`.
+  Status UnpadBucketedOutput(int i, Tensor* output) const;
 };
 
 // A simple TensorBuffer implementation that allows us to create Tensors that
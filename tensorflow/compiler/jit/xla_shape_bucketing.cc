@@ -0,0 +1,259 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/jit/xla_shape_bucketing.h"
+
+#include <algorithm>
+#include <set>
+#include <unordered_set>
+#include <utility>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "tensorflow/core/graph/algorithm.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+
+namespace tensorflow {
+
+const char* const kXlaBucketedArgsAttr = "_XlaBucketedArgs";
+const char* const kXlaBucketedOutputsAttr = "_XlaBucketedOutputs";
+
+namespace {
+
+// Reads the list of indices in attribute `name` of `attrs` into `indices`,
+// leaving it empty if the attribute is absent.
+Status GetIndexListAttr(AttrSlice attrs, const char* name,
+                        std::vector<int>* indices) {
+  indices->clear();
+  if (attrs.Find(name) == nullptr) {
+    return Status::OK();
+  }
+  TF_RETURN_IF_ERROR(GetNodeAttr(attrs, name, indices));
+  for (int index : *indices) {
+    if (index < 0) {
+      return errors::InvalidArgument("Invalid index ", index, " in ", name);
+    }
+  }
+  std::sort(indices->begin(), indices->end());
+  indices->erase(std::unique(indices->begin(), indices->end()),
+                 indices->end());
+  return Status::OK();
+}
+
+// Returns true if row i of the outputs of `n` only depends on row i of its
+// inputs, given which of them are batch-major (`batch_inputs[i]` >= 0).
+bool PreservesRows(const Node& n, const std::vector<int>& batch_inputs) {
+  static const auto* const kElementwiseOps = new std::unordered_set<string>{
+      "Abs",      "Add",        "AddV2",    "Cast",      "Ceil",
+      "Div",      "Elu",        "Exp",      "Floor",     "Identity",
+      "Log",      "Log1p",      "Maximum",  "Minimum",   "Mul",
+      "Neg",      "OnesLike",   "Pow",      "RealDiv",   "Reciprocal",
+      "Relu",     "Relu6",      "Round",    "Rsqrt",     "Selu",
+      "Sigmoid",  "Sign",       "Softplus", "Softsign",  "Sqrt",
+      "Square",   "SquaredDifference",      "Sub",       "Tanh",
+      "ZerosLike"};
+  const string& op = n.type_string();
+  if (kElementwiseOps->count(op) > 0) {
+    return true;
+  }
+  if (op == "BiasAdd") {
+    return batch_inputs.size() == 2 && batch_inputs[1] < 0;
+  }
+  if (op == "MatMul") {
+    bool transpose_a;
+    return batch_inputs.size() == 2 && batch_inputs[1] < 0 &&
+           GetNodeAttr(n.attrs(), "transpose_a", &transpose_a).ok() &&
+           !transpose_a;
+  }
+  return false;
+}
+
+}  // namespace
+
+bool XlaBucketedArgs::IsBucketedArg(int index) const {
+  return std::binary_search(args.begin(), args.end(), index);
+}
+
+bool XlaBucketedArgs::IsBucketedOutput(int index) const {
+  return std::binary_search(outputs.begin(), outputs.end(), index);
+}
+
+/*static*/ Status XlaBucketedArgs::FromAttrs(AttrSlice attrs,
+                                             XlaBucketedArgs* result) {
+  TF_RETURN_IF_ERROR(
+      GetIndexListAttr(attrs, kXlaBucketedArgsAttr, &result->args));
+  TF_RETURN_IF_ERROR(
+      GetIndexListAttr(attrs, kXlaBucketedOutputsAttr, &result->outputs));
+  if (result->args.empty() && !result->outputs.empty()) {
+    return errors::InvalidArgument(kXlaBucketedOutputsAttr,
+                                   " is set but no argument is listed in ",
+                                   kXlaBucketedArgsAttr);
+  }
+  return Status::OK();
+}
+
+/*static*/ Status XlaBucketedArgs::FromGraph(const Graph& graph,
+                                             int num_constant_args,
+                                             XlaBucketedArgs* result) {
+  result->args.clear();
+  result->outputs.clear();
+
+  // The argument the outputs of each node derive from, or -1 if none.
+  std::vector<int> arg_of(graph.num_node_ids(), -1);
+  // Arguments that reach a MatMul or BiasAdd, and hence are not scalars.
+  std::set<int> matrix_args;
+  // Arguments that flow into an op that does not keep rows apart.
+  std::set<int> excluded_args;
+  // Pairs of result index and the argument the result derives from.
+  std::vector<std::pair<int, int>> retvals;
+
+  std::vector<Node*> order;
+  GetReversePostOrder(graph, &order);
+  for (Node* n : order) {
+    if (n->type_string() == "_Arg") {
+      int index;
+      DataType type;
+      TF_RETURN_IF_ERROR(GetNodeAttr(n->attrs(), "index", &index));
+      TF_RETURN_IF_ERROR(GetNodeAttr(n->attrs(), "T", &type));
+      if (index >= num_constant_args && type != DT_RESOURCE) {
+        arg_of[n->id()] = index;
+      }
+      continue;
+    }
+
+    std::vector<int> batch_inputs(n->num_inputs(), -1);
+    for (const Edge* e : n->in_edges()) {
+      if (!e->IsControlEdge()) {
+        batch_inputs[e->dst_input()] = arg_of[e->src()->id()];
+      }
+    }
+    int arg = -1;
+    bool mixes_args = false;
+    for (int input_arg : batch_inputs) {
+      if (input_arg < 0) continue;
+      if (arg < 0) {
+        arg = input_arg;
+      } else if (input_arg != arg) {
+        mixes_args = true;
+      }
+    }
+    if (arg < 0) {
+      continue;
+    }
+    arg_of[n->id()] = arg;
+
+    if (n->type_string() == "_Retval") {
+      int index;
+      TF_RETURN_IF_ERROR(GetNodeAttr(n->attrs(), "index", &index));
+      retvals.emplace_back(index, arg);
+    } else if (mixes_args || !PreservesRows(*n, batch_inputs)) {
+      for (int input_arg : batch_inputs) {
+        if (input_arg >= 0) excluded_args.insert(input_arg);
+      }
+    } else if (n->type_string() == "MatMul" || n->type_string() == "BiasAdd") {
+      matrix_args.insert(arg);
+    }
+  }
+
+  // Arguments that are never combined need not have the same number of rows,
+  // which the compilation cache requires of listed arguments, so at most one
+  // is listed.
+  for (int arg : matrix_args) {
+    if (excluded_args.count(arg) == 0) {
+      result->args.push_back(arg);
+      break;
+    }
+  }
+  for (const auto& retval : retvals) {
+    if (result->IsBucketedArg(retval.second)) {
+      result->outputs.push_back(retval.first);
+    }
+  }
+  std::sort(result->outputs.begin(), result->outputs.end());
+  return Status::OK();
+}
+
+void XlaBucketedArgs::AddAttrs(NodeDef* node_def) const {
+  if (empty()) {
+    return;
+  }
+  AddNodeAttr(kXlaBucketedArgsAttr, args, node_def);
+  AddNodeAttr(kXlaBucketedOutputsAttr, outputs, node_def);
+}
+
+/*static*/ Status XlaShapeBucketingPolicy::Parse(
+    absl::string_view spec, XlaShapeBucketingPolicy* policy) {
+  *policy = XlaShapeBucketingPolicy();
+  if (spec.empty()) {
+    return Status::OK();
+  }
+  if (spec == "pow2") {
+    policy->pow2_ = true;
+    return Status::OK();
+  }
+  for (absl::string_view piece :
+       absl::StrSplit(spec, ',', absl::SkipWhitespace())) {
+    int64 size;
+    if (!strings::safe_strto64(piece, &size) || size <= 0) {
+      return errors::InvalidArgument("Invalid shape bucket size '", piece,
+                                     "' in bucketing spec '", spec, "'");
+    }
+    policy->buckets_.push_back(size);
+  }
+  std::sort(policy->buckets_.begin(), policy->buckets_.end());
+  policy->buckets_.erase(
+      std::unique(policy->buckets_.begin(), policy->buckets_.end()),
+      policy->buckets_.end());
+  return Status::OK();
+}
+
+int64 XlaShapeBucketingPolicy::BucketSize(int64 size) const {
+  if (size <= 0) {
+    return size;
+  }
+  if (pow2_) {
+    int64 bucket = 1;
+    while (bucket < size) {
+      bucket <<= 1;
+    }
+    return bucket;
+  }
+  auto it = std::lower_bound(buckets_.begin(), buckets_.end(), size);
+  return it == buckets_.end() ? size : *it;
+}
+
+TensorShape XlaShapeBucketingPolicy::BucketShape(
+    const TensorShape& shape) const {
+  if (!enabled() || shape.dims() == 0 || shape.num_elements() == 0) {
+    return shape;
+  }
+  TensorShape result = shape;
+  result.set_dim(0, BucketSize(shape.dim_size(0)));
+  return result;
+}
+
+string XlaShapeBucketingPolicy::DebugString() const {
+  if (pow2_) {
+    return "pow2";
+  }
+  if (buckets_.empty()) {
+    return "disabled";
+  }
+  return absl::StrJoin(buckets_, ",");
+}
+
+}  // namespace tensorflow
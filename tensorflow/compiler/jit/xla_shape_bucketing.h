@@ -0,0 +1,127 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Contains the shape bucketing policy used by the XLA JIT to bound the number
+// of distinct shapes a cluster is compiled for.
+
+#ifndef TENSORFLOW_COMPILER_JIT_XLA_SHAPE_BUCKETING_H_
+#define TENSORFLOW_COMPILER_JIT_XLA_SHAPE_BUCKETING_H_
+
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Attributes of a JIT cluster that list which of its inputs and outputs are
+// batch-major, i.e. have the batch as their leading dimension. Both are lists
+// of indices into the inputs and outputs of the cluster node (and hence of the
+// XlaLaunch and _XlaCompile ops built from it). EncapsulateSubgraphsPass sets
+// them on the clusters it creates, see XlaBucketedArgs::FromGraph.
+extern const char* const kXlaBucketedArgsAttr;     // "_XlaBucketedArgs"
+extern const char* const kXlaBucketedOutputsAttr;  // "_XlaBucketedOutputs"
+
+// The batch-major inputs and outputs of a JIT cluster. Only these are padded
+// and sliced when shape bucketing is enabled; all other arguments and results
+// keep their exact shapes.
+struct XlaBucketedArgs {
+  // Sorted, deduplicated input indices.
+  std::vector<int> args;
+
+  // Sorted, deduplicated output indices.
+  std::vector<int> outputs;
+
+  bool empty() const { return args.empty(); }
+  bool IsBucketedArg(int index) const;
+  bool IsBucketedOutput(int index) const;
+
+  // Reads the kXlaBucketedArgsAttr and kXlaBucketedOutputsAttr attributes
+  // from `attrs`. Either may be absent; outputs may only be listed if some
+  // argument is.
+  static Status FromAttrs(AttrSlice attrs, XlaBucketedArgs* result);
+
+  // Finds the batch-major arguments and results of the function body `graph`
+  // of a JIT cluster whose first `num_constant_args` arguments are
+  // compile-time constants.
+  //
+  // An argument is listed only if every op it flows into keeps row i of its
+  // output a function of row i of that argument alone: elementwise ops,
+  // BiasAdd of the value and MatMul of the (untransposed) left operand. Ops
+  // that combine two different arguments, or that are not known to keep
+  // rows apart (reductions, reshapes, ...), exclude the arguments they read.
+  // To rule out scalars, an argument is also only listed if it reaches a
+  // MatMul or BiasAdd, and since the cache requires all listed arguments to
+  // have the same number of rows, at most one argument is listed. Operands
+  // that do not derive from an argument are assumed to broadcast against the
+  // trailing dimensions, as biases and weights do. A result is listed if it
+  // derives from the listed argument.
+  static Status FromGraph(const Graph& graph, int num_constant_args,
+                          XlaBucketedArgs* result);
+
+  // Sets the kXlaBucketedArgsAttr and kXlaBucketedOutputsAttr attributes of
+  // `node_def`, unless no argument is listed.
+  void AddAttrs(NodeDef* node_def) const;
+};
+
+// Rounds the leading dimension of batch-major JIT cluster arguments (see
+// XlaBucketedArgs) up to one of a fixed set of bucket sizes, so that inputs
+// with e.g. variable batch sizes share a single compilation per bucket instead
+// of triggering one per distinct size.
+//
+// Only the leading dimension is bucketed: padding it is a contiguous append of
+// zeroed rows to the argument buffer, and un-padding the results is a zero-copy
+// Tensor::Slice. Bucketing is only correct for clusters whose outputs are
+// row-wise independent along that dimension, i.e. padded rows must not affect
+// the values of the unpadded rows (no reductions across the leading dimension,
+// no ops that observe the argument shapes). It is therefore opt-in.
+class XlaShapeBucketingPolicy {
+ public:
+  // Creates a disabled policy.
+  XlaShapeBucketingPolicy() = default;
+
+  // Parses a policy from `spec`, which is one of:
+  //   ""            : bucketing disabled.
+  //   "pow2"        : round up to the next power of two.
+  //   "8,32,128,..." : round up to the smallest listed size that is at least as
+  //                   large; sizes beyond the largest bucket are not padded.
+  static Status Parse(absl::string_view spec, XlaShapeBucketingPolicy* policy);
+
+  bool enabled() const { return pow2_ || !buckets_.empty(); }
+
+  // Returns the bucketed size for a leading dimension of `size`. Returns
+  // `size` itself if the policy is disabled or no bucket is large enough.
+  int64 BucketSize(int64 size) const;
+
+  // Returns `shape` with its leading dimension rounded up by BucketSize().
+  // Scalars and empty shapes are returned unchanged.
+  TensorShape BucketShape(const TensorShape& shape) const;
+
+  string DebugString() const;
+
+ private:
+  bool pow2_ = false;
+
+  // Sorted, deduplicated list of bucket sizes.
+  std::vector<int64> buckets_;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_COMPILER_JIT_XLA_SHAPE_BUCKETING_H_
@@ -0,0 +1,192 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/compiler/jit/xla_shape_bucketing.h"
+
+#include "tensorflow/cc/framework/scope.h"
+#include "tensorflow/cc/ops/function_ops.h"
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(XlaShapeBucketingPolicyTest, DisabledByDefault) {
+  XlaShapeBucketingPolicy policy;
+  TF_ASSERT_OK(XlaShapeBucketingPolicy::Parse("", &policy));
+  EXPECT_FALSE(policy.enabled());
+  EXPECT_EQ(7, policy.BucketSize(7));
+  EXPECT_EQ(TensorShape({7, 3}), policy.BucketShape(TensorShape({7, 3})));
+}
+
+TEST(XlaShapeBucketingPolicyTest, PowersOfTwo) {
+  XlaShapeBucketingPolicy policy;
+  TF_ASSERT_OK(XlaShapeBucketingPolicy::Parse("pow2", &policy));
+  EXPECT_TRUE(policy.enabled());
+  EXPECT_EQ(1, policy.BucketSize(1));
+  EXPECT_EQ(2, policy.BucketSize(2));
+  EXPECT_EQ(8, policy.BucketSize(5));
+  EXPECT_EQ(1024, policy.BucketSize(1000));
+  EXPECT_EQ(0, policy.BucketSize(0));
+}
+
+TEST(XlaShapeBucketingPolicyTest, ExplicitBuckets) {
+  XlaShapeBucketingPolicy policy;
+  TF_ASSERT_OK(XlaShapeBucketingPolicy::Parse("128, 8,32,8", &policy));
+  EXPECT_TRUE(policy.enabled());
+  EXPECT_EQ("8,32,128", policy.DebugString());
+  EXPECT_EQ(8, policy.BucketSize(1));
+  EXPECT_EQ(8, policy.BucketSize(8));
+  EXPECT_EQ(32, policy.BucketSize(9));
+  EXPECT_EQ(128, policy.BucketSize(100));
+  // Sizes beyond the largest bucket are left alone.
+  EXPECT_EQ(300, policy.BucketSize(300));
+}
+
+TEST(XlaShapeBucketingPolicyTest, OnlyLeadingDimensionIsBucketed) {
+  XlaShapeBucketingPolicy policy;
+  TF_ASSERT_OK(XlaShapeBucketingPolicy::Parse("pow2", &policy));
+  EXPECT_EQ(TensorShape({16, 3, 5}),
+            policy.BucketShape(TensorShape({13, 3, 5})));
+  EXPECT_EQ(TensorShape({}), policy.BucketShape(TensorShape({})));
+  EXPECT_EQ(TensorShape({13, 0}), policy.BucketShape(TensorShape({13, 0})));
+}
+
+TEST(XlaShapeBucketingPolicyTest, InvalidSpec) {
+  XlaShapeBucketingPolicy policy;
+  EXPECT_FALSE(XlaShapeBucketingPolicy::Parse("8,x", &policy).ok());
+  EXPECT_FALSE(XlaShapeBucketingPolicy::Parse("0", &policy).ok());
+  EXPECT_FALSE(XlaShapeBucketingPolicy::Parse("-4", &policy).ok());
+}
+
+TEST(XlaBucketedArgsTest, AbsentAttributes) {
+  AttrValueMap attrs;
+  XlaBucketedArgs bucketed;
+  TF_ASSERT_OK(XlaBucketedArgs::FromAttrs(AttrSlice(&attrs), &bucketed));
+  EXPECT_TRUE(bucketed.empty());
+  EXPECT_FALSE(bucketed.IsBucketedArg(0));
+  EXPECT_FALSE(bucketed.IsBucketedOutput(0));
+}
+
+TEST(XlaBucketedArgsTest, OnlyListedIndicesAreBucketed) {
+  AttrValueMap attrs;
+  SetAttrValue(std::vector<int>{3, 1, 3}, &attrs[kXlaBucketedArgsAttr]);
+  SetAttrValue(std::vector<int>{0}, &attrs[kXlaBucketedOutputsAttr]);
+  XlaBucketedArgs bucketed;
+  TF_ASSERT_OK(XlaBucketedArgs::FromAttrs(AttrSlice(&attrs), &bucketed));
+  EXPECT_EQ(std::vector<int>({1, 3}), bucketed.args);
+  EXPECT_EQ(std::vector<int>({0}), bucketed.outputs);
+  EXPECT_FALSE(bucketed.IsBucketedArg(0));
+  EXPECT_TRUE(bucketed.IsBucketedArg(1));
+  EXPECT_FALSE(bucketed.IsBucketedArg(2));
+  EXPECT_TRUE(bucketed.IsBucketedArg(3));
+  EXPECT_TRUE(bucketed.IsBucketedOutput(0));
+  EXPECT_FALSE(bucketed.IsBucketedOutput(1));
+}
+
+TEST(XlaBucketedArgsTest, InvalidAttributes) {
+  XlaBucketedArgs bucketed;
+  {
+    AttrValueMap attrs;
+    SetAttrValue(std::vector<int>{0, -1}, &attrs[kXlaBucketedArgsAttr]);
+    EXPECT_FALSE(XlaBucketedArgs::FromAttrs(AttrSlice(&attrs), &bucketed).ok());
+  }
+  {
+    // Outputs can only be bucketed if some argument is.
+    AttrValueMap attrs;
+    SetAttrValue(std::vector<int>{0}, &attrs[kXlaBucketedOutputsAttr]);
+    EXPECT_FALSE(XlaBucketedArgs::FromAttrs(AttrSlice(&attrs), &bucketed).ok());
+  }
+  {
+    AttrValueMap attrs;
+    SetAttrValue(true, &attrs[kXlaBucketedArgsAttr]);
+    EXPECT_FALSE(XlaBucketedArgs::FromAttrs(AttrSlice(&attrs), &bucketed).ok());
+  }
+}
+
+XlaBucketedArgs FindBucketedArgs(const Scope& scope, int num_constant_args) {
+  Graph graph(OpRegistry::Global());
+  TF_CHECK_OK(scope.ToGraph(&graph));
+  XlaBucketedArgs bucketed;
+  TF_CHECK_OK(XlaBucketedArgs::FromGraph(graph, num_constant_args, &bucketed));
+  return bucketed;
+}
+
+TEST(XlaBucketedArgsTest, FromGraphFollowsRowWiseOps) {
+  Scope scope = Scope::NewRootScope().ExitOnError();
+  auto shape = ops::_Arg(scope.WithOpName("shape"), DT_INT32, 0);
+  auto x = ops::_Arg(scope.WithOpName("x"), DT_FLOAT, 1);
+  auto w = ops::Const(scope.WithOpName("w"), 1.0f, {4, 3});
+  auto b = ops::Const(scope.WithOpName("b"), 1.0f, {3});
+  auto matmul = ops::MatMul(scope.WithOpName("matmul"), x, w);
+  auto bias_add = ops::BiasAdd(scope.WithOpName("bias_add"), matmul, b);
+  auto relu = ops::Relu(scope.WithOpName("relu"), bias_add);
+  auto square = ops::Square(scope.WithOpName("square"), relu);
+  ops::_Retval(scope.WithOpName("out_0"), square, 0);
+  ops::_Retval(scope.WithOpName("out_1"),
+               ops::Reshape(scope.WithOpName("reshape"), w, shape), 1);
+  ops::_Retval(scope.WithOpName("out_2"), relu, 2);
+
+  XlaBucketedArgs bucketed = FindBucketedArgs(scope, /*num_constant_args=*/1);
+  EXPECT_EQ(bucketed.args, std::vector<int>({1}));
+  EXPECT_EQ(bucketed.outputs, std::vector<int>({0, 2}));
+}
+
+TEST(XlaBucketedArgsTest, FromGraphExcludesCombinedArgs) {
+  // A bias that is an argument may not have the batch as leading dimension.
+  Scope scope = Scope::NewRootScope().ExitOnError();
+  auto x = ops::_Arg(scope.WithOpName("x"), DT_FLOAT, 0);
+  auto bias = ops::_Arg(scope.WithOpName("bias"), DT_FLOAT, 1);
+  auto w = ops::Const(scope.WithOpName("w"), 1.0f, {4, 3});
+  auto matmul = ops::MatMul(scope.WithOpName("matmul"), x, w);
+  auto add = ops::Add(scope.WithOpName("add"), matmul, bias);
+  ops::_Retval(scope.WithOpName("out_0"), add, 0);
+
+  EXPECT_TRUE(FindBucketedArgs(scope, /*num_constant_args=*/0).empty());
+}
+
+TEST(XlaBucketedArgsTest, FromGraphExcludesArgsReducedOverRows) {
+  Scope scope = Scope::NewRootScope().ExitOnError();
+  auto x = ops::_Arg(scope.WithOpName("x"), DT_FLOAT, 0);
+  auto w = ops::Const(scope.WithOpName("w"), 1.0f, {4, 3});
+  auto matmul = ops::MatMul(scope.WithOpName("matmul"), x, w);
+  auto sum = ops::Sum(scope.WithOpName("sum"), matmul,
+                      ops::Const(scope.WithOpName("axis"), 0));
+  ops::_Retval(scope.WithOpName("out_0"), sum, 0);
+
+  EXPECT_TRUE(FindBucketedArgs(scope, /*num_constant_args=*/0).empty());
+}
+
+TEST(XlaBucketedArgsTest, FromGraphListsAtMostOneArg) {
+  // `x` and `y` need not have the same number of rows.
+  Scope scope = Scope::NewRootScope().ExitOnError();
+  auto w = ops::Const(scope.WithOpName("w"), 1.0f, {4, 3});
+  auto x = ops::_Arg(scope.WithOpName("x"), DT_FLOAT, 0);
+  auto y = ops::_Arg(scope.WithOpName("y"), DT_FLOAT, 1);
+  ops::_Retval(scope.WithOpName("out_0"),
+               ops::MatMul(scope.WithOpName("matmul_y"), y, w), 0);
+  ops::_Retval(scope.WithOpName("out_1"),
+               ops::MatMul(scope.WithOpName("matmul_x"), x, w), 1);
+
+  XlaBucketedArgs bucketed = FindBucketedArgs(scope, /*num_constant_args=*/0);
+  EXPECT_EQ(bucketed.args, std::vector<int>({0}));
+  EXPECT_EQ(bucketed.outputs, std::vector<int>({1}));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -18,6 +18,7 @@ from __future__ import absolute_import
 from __future__ import division
 from __future__ import print_function
 
+from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import function
 from tensorflow.python.framework import ops
 from tensorflow.python.ops import gen_batch_ops
@@ -58,7 +59,9 @@ def batch_function(num_batch_threads,
                    max_batch_size,
                    batch_timeout_micros,
                    allowed_batch_sizes=None,
-                   max_enqueued_batches=10):
+                   max_enqueued_batches=10,
+                   enable_ragged_batching=False,
+                   ragged_length_buckets=None):
   """Batches the computation done by the decorated function.
 
   So, for example, in the following code
@@ -82,6 +85,12 @@ def batch_function(num_batch_threads,
   SparseTensor is not supported. The return value of the decorated function
   must be a Tensor or a list/tuple of Tensors.
 
+  With `enable_ragged_batching`, each call supplies one variable-length row
+  instead, and the rows are concatenated without padding. The decorated
+  function then receives the `row_splits` of the batch as an additional last
+  argument, and each of its outputs must have one entry per row or one entry
+  per value.
+
   Args:
     num_batch_threads: Number of scheduling threads for processing batches
      of work. Determines the number of batches processed in parallel.
@@ -93,6 +102,12 @@ def batch_function(num_batch_threads,
      to pad batches up to one of those sizes. The entries must increase
      monotonically, and the final entry must equal max_batch_size.
     max_enqueued_batches: The maximum depth of the batch queue. Defaults to 10.
+    enable_ragged_batching: If True, the arguments of each call are a single
+     row whose length is their first dimension, batched without padding.
+     Cannot be combined with `allowed_batch_sizes`.
+    ragged_length_buckets: Optional list of increasing row lengths, used with
+     `enable_ragged_batching`. Rows are batched only with rows falling in the
+     same bucket, so that batches are made of rows of similar lengths.
 
   Returns:
     The decorated function will return the unbatched computation output Tensors.
@@ -102,6 +117,8 @@ def batch_function(num_batch_threads,
 
     def decorated(*args):  # pylint: disable=missing-docstring
       types = [arg.dtype for arg in args]
+      if enable_ragged_batching:
+        types.append(dtypes.int64)
 
       @function.Defun(*types)
       def computation(*computation_args):
@@ -119,6 +136,8 @@ def batch_function(num_batch_threads,
             batch_timeout_micros=batch_timeout_micros,
             allowed_batch_sizes=allowed_batch_sizes,
             max_enqueued_batches=max_enqueued_batches,
+            enable_ragged_batching=enable_ragged_batching,
+            ragged_length_buckets=ragged_length_buckets,
             shared_name=name,
             f=computation,
             in_tensors=list(args),
@@ -259,6 +259,47 @@ class BatchOpsTest(test.TestCase):
       self.assertEqual(thread_results[0], [2])
       self.assertEqual(main_results[0], [3])
 
+  def testRaggedBatchDecorated(self):
+    """Tests that the batch_function decorator works with ragged rows."""
+    with self.cached_session() as sess:
+
+      @batch_ops.batch_function(1, 10, 100000, enable_ragged_batching=True)
+      def computation(values, row_splits):
+        # One output per value and one per row.
+        return values * 2, row_splits[1:] - row_splits[:-1]
+
+      inp = array_ops.placeholder(dtype=dtypes.int32, shape=[None])
+      result = computation(inp)
+      thread_results = []
+
+      def worker():
+        thread_results.extend(sess.run(result, feed_dict={inp: [1, 2, 3]}))
+
+      worker_thread = threading.Thread(target=worker)
+      worker_thread.start()
+      main_results = sess.run(result, feed_dict={inp: [4, 5]})
+      worker_thread.join()
+      self.assertAllEqual(thread_results[0], [2, 4, 6])
+      self.assertAllEqual(thread_results[1], [3])
+      self.assertAllEqual(main_results[0], [8, 10])
+      self.assertAllEqual(main_results[1], [2])
+
+  def testRaggedBatchWithAllowedBatchSizes(self):
+    """Tests that ragged batches cannot be padded."""
+    with self.cached_session() as sess:
+
+      @batch_ops.batch_function(
+          1, 10, 100000, allowed_batch_sizes=[5, 10],
+          enable_ragged_batching=True)
+      def computation(values, row_splits):  # pylint: disable=unused-argument
+        return values + 1
+
+      inp = array_ops.placeholder(dtype=dtypes.int32, shape=[None])
+      result = computation(inp)
+      with self.assertRaisesRegexp(InvalidArgumentError,
+                                   "allowed_batch_sizes cannot be used"):
+        sess.run(result, feed_dict={inp: [1, 2]})
+
   def testBatchFunctionOp(self):
     """Tests that the batch_function op works."""
     with self.cached_session() as sess:
@@ -322,6 +363,45 @@ class BatchOpsTest(test.TestCase):
       self.assertEqual(thread_results[0], [2])
       self.assertEqual(main_results[0], [3])
 
+  def testBatchFunctionOpWithMultiRowInputs(self):
+    """Tests batch_function with multi-row inputs, padding and many callers."""
+    with self.cached_session() as sess:
+
+      @function.Defun(dtypes.float32)
+      def computation(in_t):
+        return in_t * 2
+
+      # Rows of 3 floats, so that most batches don't start at aligned offsets.
+      inp = array_ops.placeholder(dtype=dtypes.float32, shape=[None, 3])
+      result = gen_batch_ops.batch_function(
+          [inp],
+          num_batch_threads=2,
+          max_batch_size=8,
+          batch_timeout_micros=10000,  # 10ms
+          allowed_batch_sizes=[4, 8],
+          Tout=[dtypes.float32],
+          f=computation,
+          captured_tensors=computation.captured_inputs)
+
+      def task_input(i):
+        return [[i, i + 0.25, i + 0.5]] * (i % 3 + 1)
+
+      results = [None] * 12
+
+      def worker(i):
+        results[i] = sess.run(result, feed_dict={inp: task_input(i)})
+
+      threads = [
+          threading.Thread(target=worker, args=(i,)) for i in range(12)
+      ]
+      for thread in threads:
+        thread.start()
+      for thread in threads:
+        thread.join()
+      for i in range(12):
+        self.assertAllEqual(results[i][0], [[2 * x for x in row]
+                                            for row in task_input(i)])
+
   def testBatchFunctionOpWithInputError(self):
     """Tests that batch_function op works with error in the inputs."""
     with self.cached_session() as sess:
@@ -13,10 +13,24 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 #include "tensorflow/contrib/lite/arena_planner.h"
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <queue>
 #include <utility>
 
 namespace tflite {
 
+namespace {
+
+// Returns the smallest multiple of 'alignment' that is at least 'offset'.
+int64_t AlignTo(int64_t alignment, int64_t offset) {
+  return offset % alignment == 0 ? offset
+                                 : offset + (alignment - offset % alignment);
+}
+
+}  // namespace
+
 struct AllocationInfo {
   // The node index requesting this allocation.
   int node;
@@ -50,6 +64,29 @@ int64_t ArenaPlanner::BasePointer(TfLiteAllocationType type) {
   return 0;
 }
 
+void ArenaPlanner::SetConcurrentNodeGroups(const std::vector<int>& group_ends) {
+  offline_plan_checked_ = false;
+  group_start_.clear();
+  int start = 0;
+  for (int end : group_ends) {
+    for (int i = start; i < end; ++i) {
+      group_start_.push_back(start);
+    }
+    start = end;
+  }
+}
+
+int ArenaPlanner::GroupStart(int node_index) const {
+  if (node_index < group_start_.size()) {
+    return group_start_[node_index];
+  }
+  return node_index;
+}
+
+bool ArenaPlanner::IsLastNodeOfGroup(int node_index) const {
+  return GroupStart(node_index + 1) == node_index + 1;
+}
+
 TfLiteStatus ArenaPlanner::ResetAllocations() {
   TF_LITE_ENSURE_STATUS(arena_.Clear());
   TF_LITE_ENSURE_STATUS(persistent_arena_.Clear());
@@ -61,6 +98,7 @@ TfLiteStatus ArenaPlanner::ResetAllocations() {
 TfLiteStatus ArenaPlanner::PlanAllocations() {
   // Invalidate any existing data.
   TF_LITE_ENSURE_STATUS(ResetAllocations());
+  offline_plan_checked_ = false;
 
   // Keeps track of references to each tensor.
   std::vector<int> refcounts(graph_info_->num_tensors(), 0);
@@ -147,6 +185,11 @@ TfLiteStatus ArenaPlanner::PlanAllocations() {
       TF_LITE_ENSURE_STATUS(allocate(0, tensor_index));
     }
   }
+  // Deallocations are deferred until the end of the group of concurrently
+  // executed nodes, so that no node of the group can reuse memory that another
+  // node of the group is still reading.
+  std::vector<int> pending_deallocations;
+
   // Go through the graph in execution order.
   for (int i = 0; i < graph_info_->num_nodes(); ++i) {
     const TfLiteNode& node = graph_info_->node(i);
@@ -167,11 +210,18 @@ TfLiteStatus ArenaPlanner::PlanAllocations() {
         if (tensor_index != kOptionalTensor) {
           refcounts[tensor_index]--;
           if (refcounts[tensor_index] == 0) {
-            TF_LITE_ENSURE_STATUS(deallocate(i, tensor_index));
+            pending_deallocations.push_back(tensor_index);
           }
         }
       }
     }
+
+    if (IsLastNodeOfGroup(i)) {
+      for (int tensor_index : pending_deallocations) {
+        TF_LITE_ENSURE_STATUS(deallocate(i, tensor_index));
+      }
+      pending_deallocations.clear();
+    }
   }
 
   // Note that graph outputs will never be scheduled for deallocation. We
@@ -185,7 +235,16 @@ TfLiteStatus ArenaPlanner::ExecuteAllocations(int first_node, int last_node) {
   TF_LITE_ENSURE(context_, graph_info_->num_tensors() >= allocs_.size());
   allocs_.resize(graph_info_->num_tensors());
 
+  // The offline plan places all tensors at once, so it can't be used when
+  // nodes are allocated incrementally because of dynamic tensors.
+  used_offline_plan_ = offline_plan_ != nullptr && first_node == 0 &&
+                       last_node + 1 >= graph_info_->num_nodes() &&
+                       OfflinePlanIsValid();
+
   TF_LITE_ENSURE_STATUS(CalculateAllocations(first_node, last_node));
+  if (used_offline_plan_) {
+    arena_.ReserveAtLeast(offline_plan_->arena_size);
+  }
   TF_LITE_ENSURE_STATUS(Commit());
 
   for (int i = 0; i < graph_info_->num_tensors(); ++i) {
@@ -217,9 +276,13 @@ TfLiteStatus ArenaPlanner::CalculateAllocations(int first_node, int last_node) {
     if (alloc_info.node == active_node) {
       // This is the first allocation/deallocation for a given node.  It is
       // time to deallocate the previous temporaries and allocate new ones.
-      if (active_node != first_node) {
-        TF_LITE_ENSURE_STATUS(
-            CalculateDeallocationOfInternalTensors(active_node - 1));
+      // Temporaries of concurrently executed nodes are only deallocated once
+      // their whole group is done.
+      if (active_node != first_node && IsLastNodeOfGroup(active_node - 1)) {
+        for (int i = std::max(first_node, GroupStart(active_node - 1));
+             i < active_node; ++i) {
+          TF_LITE_ENSURE_STATUS(CalculateDeallocationOfInternalTensors(i));
+        }
       }
       TF_LITE_ENSURE_STATUS(CalculateAllocationOfInternalTensors(active_node));
       ++active_node;
@@ -232,9 +295,11 @@ TfLiteStatus ArenaPlanner::CalculateAllocations(int first_node, int last_node) {
     }
   }
 
-  // Don't forget to deallocate temporaries of last node.
-  TF_LITE_ENSURE_STATUS(
-      CalculateDeallocationOfInternalTensors(active_node - 1));
+  // Don't forget to deallocate temporaries of the last group.
+  for (int i = std::max(first_node, GroupStart(active_node - 1));
+       i < active_node; ++i) {
+    TF_LITE_ENSURE_STATUS(CalculateDeallocationOfInternalTensors(i));
+  }
 
   return kTfLiteOk;
 }
@@ -258,6 +323,13 @@ TfLiteStatus ArenaPlanner::ResolveTensorAllocation(int tensor_index) {
 
 TfLiteStatus ArenaPlanner::CalculateTensorAllocation(int tensor_index) {
   TfLiteTensor& tensor = *graph_info_->tensor(tensor_index);
+  if (tensor.allocation_type == kTfLiteArenaRw && used_offline_plan_) {
+    // Empty tensors may have no place in the plan, but don't need one.
+    allocs_[tensor_index].offset =
+        tensor.bytes > 0 ? offline_plan_->offsets[tensor_index] : 0;
+    allocs_[tensor_index].size = tensor.bytes;
+    return kTfLiteOk;
+  }
   if (tensor.allocation_type == kTfLiteArenaRw) {
     TF_LITE_ENSURE_STATUS(arena_.Allocate(
         context_, tensor_alignment_, tensor.bytes, &allocs_[tensor_index]));
@@ -271,7 +343,7 @@ TfLiteStatus ArenaPlanner::CalculateTensorAllocation(int tensor_index) {
 
 TfLiteStatus ArenaPlanner::CalculateTensorDeallocation(int tensor_index) {
   TfLiteTensor& tensor = *graph_info_->tensor(tensor_index);
-  if (tensor.allocation_type == kTfLiteArenaRw) {
+  if (tensor.allocation_type == kTfLiteArenaRw && !used_offline_plan_) {
     TF_LITE_ENSURE_STATUS(arena_.Deallocate(context_, allocs_[tensor_index]));
   }
   return kTfLiteOk;
@@ -303,4 +375,197 @@ TfLiteStatus ArenaPlanner::CalculateDeallocationOfInternalTensors(
   return kTfLiteOk;
 }
 
+void ArenaPlanner::CalculateLifetimes(std::vector<int>* first_use,
+                                      std::vector<int>* last_use) const {
+  const int num_nodes = graph_info_->num_nodes();
+  first_use->assign(graph_info_->num_tensors(), -1);
+  last_use->assign(graph_info_->num_tensors(), -1);
+  auto is_arena_tensor = [this](int tensor_index) {
+    return graph_info_->tensor(tensor_index)->allocation_type ==
+           kTfLiteArenaRw;
+  };
+
+  // Tensors that are never deallocated stay live until the end.
+  for (const auto& alloc_info : alloc_queue_) {
+    if (!is_arena_tensor(alloc_info.tensor)) continue;
+    if (alloc_info.type == AllocationInfo::ALLOC) {
+      (*first_use)[alloc_info.tensor] = alloc_info.node;
+      (*last_use)[alloc_info.tensor] = num_nodes - 1;
+    } else {
+      (*last_use)[alloc_info.tensor] = alloc_info.node;
+    }
+  }
+
+  // Temporaries are live while any node of their group is executing.
+  std::vector<int> group_last_node(num_nodes);
+  for (int i = num_nodes - 1; i >= 0; --i) {
+    group_last_node[i] = IsLastNodeOfGroup(i) ? i : group_last_node[i + 1];
+  }
+  for (int i = 0; i < num_nodes; ++i) {
+    TfLiteIntArray* node_temporaries = graph_info_->node(i).temporaries;
+    for (int j = 0; j < node_temporaries->size; ++j) {
+      int tensor_index = node_temporaries->data[j];
+      if (!is_arena_tensor(tensor_index)) continue;
+      const int first = GroupStart(i);
+      const int last = group_last_node[i];
+      int& tensor_first_use = (*first_use)[tensor_index];
+      int& tensor_last_use = (*last_use)[tensor_index];
+      tensor_first_use =
+          tensor_first_use == -1 ? first : std::min(tensor_first_use, first);
+      tensor_last_use = std::max(tensor_last_use, last);
+    }
+  }
+}
+
+bool ArenaPlanner::OfflinePlanIsValid() {
+  const OfflineMemoryPlan& plan = *offline_plan_;
+  const int num_tensors = graph_info_->num_tensors();
+  if (plan.offsets.size() != num_tensors || plan.sizes.size() != num_tensors) {
+    return false;
+  }
+
+  // Lifetimes don't change between calls unless tensors stop or start being
+  // allocated in the arena, so the layout is only checked again then.
+  bool layout_checked = offline_plan_checked_ &&
+                        offline_plan_arena_tensors_.size() == num_tensors;
+  for (int i = 0; layout_checked && i < num_tensors; ++i) {
+    const bool is_arena_tensor =
+        graph_info_->tensor(i)->allocation_type == kTfLiteArenaRw;
+    layout_checked = offline_plan_arena_tensors_[i] == is_arena_tensor;
+  }
+  if (!layout_checked) CheckOfflinePlanLayout();
+  if (!offline_plan_layout_valid_) return false;
+
+  // A tensor fits as long as it is no bigger than the place reserved for it.
+  for (int i = 0; i < num_tensors; ++i) {
+    const int64_t bytes = graph_info_->tensor(i)->bytes;
+    if (!offline_plan_live_tensors_[i] || bytes == 0) continue;
+    if (plan.offsets[i] < 0 || bytes > plan.sizes[i]) return false;
+  }
+  return true;
+}
+
+void ArenaPlanner::CheckOfflinePlanLayout() {
+  const OfflineMemoryPlan& plan = *offline_plan_;
+  const int num_tensors = graph_info_->num_tensors();
+  offline_plan_checked_ = true;
+  offline_plan_layout_valid_ = false;
+  offline_plan_arena_tensors_.resize(num_tensors);
+  offline_plan_live_tensors_.resize(num_tensors);
+
+  std::vector<int> first_use, last_use;
+  CalculateLifetimes(&first_use, &last_use);
+  std::vector<int> tensors;
+  for (int i = 0; i < num_tensors; ++i) {
+    offline_plan_arena_tensors_[i] =
+        graph_info_->tensor(i)->allocation_type == kTfLiteArenaRw;
+    offline_plan_live_tensors_[i] = first_use[i] != -1;
+    const int64_t offset = plan.offsets[i];
+    const int64_t size = plan.sizes[i];
+    // Tensors without a place are only rejected if they aren't empty.
+    if (first_use[i] == -1 || offset < 0 || size <= 0) continue;
+    if (offset % tensor_alignment_ != 0 || offset > plan.arena_size ||
+        size > plan.arena_size - offset) {
+      return;
+    }
+    tensors.push_back(i);
+  }
+  std::sort(tensors.begin(), tensors.end(), [&first_use](int a, int b) {
+    return first_use[a] < first_use[b];
+  });
+
+  // Sweep over the nodes, keeping the tensors that are live ordered by
+  // offset. Since these never overlap each other, a new tensor only needs to
+  // be checked against its neighbours.
+  std::map<int64_t, int> live_by_offset;
+  using LastUse = std::pair<int, int>;
+  std::priority_queue<LastUse, std::vector<LastUse>, std::greater<LastUse>>
+      live_by_last_use;
+  auto end_of = [&plan](int tensor_index) {
+    return plan.offsets[tensor_index] + plan.sizes[tensor_index];
+  };
+  for (int tensor_index : tensors) {
+    while (!live_by_last_use.empty() &&
+           live_by_last_use.top().first < first_use[tensor_index]) {
+      live_by_offset.erase(plan.offsets[live_by_last_use.top().second]);
+      live_by_last_use.pop();
+    }
+    const int64_t offset = plan.offsets[tensor_index];
+    auto next = live_by_offset.lower_bound(offset);
+    if (next != live_by_offset.end() && next->first < end_of(tensor_index)) {
+      return;
+    }
+    if (next != live_by_offset.begin() &&
+        end_of(std::prev(next)->second) > offset) {
+      return;
+    }
+    live_by_offset.emplace(offset, tensor_index);
+    live_by_last_use.emplace(last_use[tensor_index], tensor_index);
+  }
+  offline_plan_layout_valid_ = true;
+}
+
+TfLiteStatus ArenaPlanner::CreateOfflinePlan(OfflineMemoryPlan* plan) {
+  std::vector<int> first_use, last_use;
+  CalculateLifetimes(&first_use, &last_use);
+
+  std::vector<int> tensors;
+  for (int i = 0; i < graph_info_->num_tensors(); ++i) {
+    if (first_use[i] != -1 && graph_info_->tensor(i)->bytes > 0) {
+      tensors.push_back(i);
+    }
+  }
+  auto bytes = [this](int tensor_index) -> int64_t {
+    return graph_info_->tensor(tensor_index)->bytes;
+  };
+  std::stable_sort(tensors.begin(), tensors.end(), [&bytes](int a, int b) {
+    return bytes(a) > bytes(b);
+  });
+
+  plan->arena_size = 0;
+  plan->offsets.assign(graph_info_->num_tensors(), -1);
+  plan->sizes.assign(graph_info_->num_tensors(), 0);
+  std::vector<int> placed;
+  std::vector<int> conflicts;
+  for (int tensor_index : tensors) {
+    // Find the tensors already placed that are live at the same time.
+    conflicts.clear();
+    for (int other : placed) {
+      if (first_use[other] <= last_use[tensor_index] &&
+          first_use[tensor_index] <= last_use[other]) {
+        conflicts.push_back(other);
+      }
+    }
+    std::sort(conflicts.begin(), conflicts.end(), [plan](int a, int b) {
+      return plan->offsets[a] < plan->offsets[b];
+    });
+
+    // Take the tightest gap between them, or go after all of them.
+    const int64_t size = bytes(tensor_index);
+    int64_t best_offset = -1;
+    int64_t best_gap = 0;
+    int64_t current_offset = 0;
+    for (int other : conflicts) {
+      const int64_t aligned_offset = AlignTo(tensor_alignment_, current_offset);
+      const int64_t gap = plan->offsets[other] - current_offset;
+      if (aligned_offset + size <= plan->offsets[other] &&
+          (best_offset == -1 || gap < best_gap)) {
+        best_offset = aligned_offset;
+        best_gap = gap;
+      }
+      current_offset =
+          std::max(current_offset, plan->offsets[other] + plan->sizes[other]);
+    }
+    if (best_offset == -1) {
+      best_offset = AlignTo(tensor_alignment_, current_offset);
+    }
+
+    plan->offsets[tensor_index] = best_offset;
+    plan->sizes[tensor_index] = size;
+    plan->arena_size = std::max(plan->arena_size, best_offset + size);
+    placed.push_back(tensor_index);
+  }
+  return kTfLiteOk;
+}
+
 }  // namespace tflite
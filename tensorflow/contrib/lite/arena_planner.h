@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/contrib/lite/c/c_api_internal.h"
 #include "tensorflow/contrib/lite/graph_info.h"
 #include "tensorflow/contrib/lite/memory_planner.h"
+#include "tensorflow/contrib/lite/offline_memory_plan.h"
 #include "tensorflow/contrib/lite/simple_memory_arena.h"
 
 namespace tflite {
@@ -44,6 +45,14 @@ struct AllocationInfo;
 // execution. Since dynamic tensors don't have sizes until after the
 // corresponding operation is executed, this class supports incremental
 // planning.
+//
+// Nodes may be declared to run concurrently in groups (see
+// SetConcurrentNodeGroups()), in which case no tensor written by a node in a
+// group shares memory with any tensor read or written by another node in the
+// same group.
+//
+// Instead of placing tensors one at a time, the planner can also use a layout
+// of the arena computed ahead of time (see SetOfflinePlan()).
 class ArenaPlanner : public MemoryPlanner {
  public:
   // Ownership of 'context' is not taken and it must remain util the
@@ -64,6 +73,35 @@ class ArenaPlanner : public MemoryPlanner {
   // Returns the base arena location for a given allocation type.
   int64_t BasePointer(TfLiteAllocationType type);
 
+  // Declares that consecutive nodes may be executed concurrently. The nodes
+  // are partitioned into groups of consecutive nodes, and `group_ends` holds,
+  // in increasing order, one past the index of the last node of each group.
+  // Tensors read by a group are only released after the whole group has
+  // executed, and the temporaries of all nodes in a group are live at the same
+  // time. An empty `group_ends` (the default) places every node in a group of
+  // its own. Must be called before PlanAllocations().
+  void SetConcurrentNodeGroups(const std::vector<int>& group_ends);
+
+  // Uses 'plan' to place kTfLiteArenaRw tensors whenever all nodes are
+  // allocated at once and the plan holds every tensor at its current size
+  // without overlapping any other tensor that is live at the same time.
+  // Otherwise tensors are placed as usual. Ownership of 'plan' is not taken
+  // and it may be null.
+  void SetOfflinePlan(const OfflineMemoryPlan* plan) {
+    offline_plan_ = plan;
+    offline_plan_checked_ = false;
+  }
+
+  // Whether the last call to ExecuteAllocations() used the offline plan.
+  bool UsedOfflinePlan() const { return used_offline_plan_; }
+
+  // Computes a layout of the arena for the current tensor sizes, placing the
+  // largest tensors first, each in the tightest gap left by the tensors
+  // already placed whose lifetimes overlap with its own. This usually needs a
+  // smaller arena than placing tensors in execution order. All nodes must
+  // have been allocated by ExecuteAllocations().
+  TfLiteStatus CreateOfflinePlan(OfflineMemoryPlan* plan);
+
  private:
   // Make sure all the arenas have reserved enough memory to store all their
   // tensors.
@@ -91,6 +129,27 @@ class ArenaPlanner : public MemoryPlanner {
   // 'node_index'.
   TfLiteStatus CalculateDeallocationOfInternalTensors(int node_index);
 
+  // Returns the index of the first node in the group that contains
+  // 'node_index'.
+  int GroupStart(int node_index) const;
+
+  // Returns whether 'node_index' is the last node of its group.
+  bool IsLastNodeOfGroup(int node_index) const;
+
+  // Fills 'first_use' and 'last_use' with the first and last node during
+  // which each kTfLiteArenaRw tensor must be live, or -1 for tensors that are
+  // never allocated in the arena.
+  void CalculateLifetimes(std::vector<int>* first_use,
+                          std::vector<int>* last_use) const;
+
+  // Returns whether the offline plan can be used for the current sizes and
+  // lifetimes of the tensors.
+  bool OfflinePlanIsValid();
+
+  // Checks that the places the offline plan reserves for tensors that are
+  // live together don't overlap, and records which tensors are live.
+  void CheckOfflinePlanLayout();
+
   TfLiteContext* context_;
   std::unique_ptr<GraphInfo> graph_info_;
 
@@ -120,6 +179,27 @@ class ArenaPlanner : public MemoryPlanner {
 
   // Number of bytes that tensor buffers should be aligned to.
   int tensor_alignment_;
+
+  // For each node, the index of the first node of its group of concurrently
+  // executed nodes. Empty if every node is in a group of its own.
+  std::vector<int> group_start_;
+
+  // Layout of the arena computed ahead of time, if any.
+  const OfflineMemoryPlan* offline_plan_ = nullptr;
+
+  // Whether kTfLiteArenaRw tensors are placed according to 'offline_plan_'
+  // by the ongoing or last call to ExecuteAllocations().
+  bool used_offline_plan_ = false;
+
+  // Whether the layout of 'offline_plan_' was checked since the plan or the
+  // graph last changed, and whether it was found valid. Tensors only need
+  // their sizes checked against the plan as long as this holds.
+  bool offline_plan_checked_ = false;
+  bool offline_plan_layout_valid_ = false;
+  // Which tensors were kTfLiteArenaRw, and which of those were live, when
+  // the layout of the plan was checked.
+  std::vector<bool> offline_plan_arena_tensors_;
+  std::vector<bool> offline_plan_live_tensors_;
 };
 
 }  // namespace tflite
@@ -15,6 +15,7 @@ limitations under the License.
 #include "tensorflow/contrib/lite/arena_planner.h"
 
 #include <cstdarg>
+#include <limits>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
@@ -153,12 +154,14 @@ void ReportError(TfLiteContext* context, const char* format, ...) {
 
 class ArenaPlannerTest : public ::testing::Test {
  protected:
-  void SetGraph(TestGraph* graph, bool preserve_inputs = false) {
+  void SetGraph(TestGraph* graph, bool preserve_inputs = false,
+                const std::vector<int>& group_ends = {}) {
     graph_ = graph;
     context_.ReportError = ReportError;
     planner_.reset(new ArenaPlanner(
         &context_, std::unique_ptr<GraphInfo>(new TestGraphInfo(graph)),
         preserve_inputs, /*preserve intermediates*/ false, kTensorAlignment));
+    planner_->SetConcurrentNodeGroups(group_ends);
     CHECK(planner_->ResetAllocations() == kTfLiteOk);
     CHECK(planner_->PlanAllocations() == kTfLiteOk);
   }
@@ -186,6 +189,18 @@ class ArenaPlannerTest : public ::testing::Test {
     return offset;
   };
 
+  // Returns the number of bytes of the arena used by kTfLiteArenaRw tensors.
+  int64_t GetArenaUsage() {
+    int64_t usage = 0;
+    for (int i = 0; i < graph_->tensors()->size(); ++i) {
+      const TfLiteTensor& tensor = (*graph_->tensors())[i];
+      if (tensor.allocation_type == kTfLiteArenaRw && tensor.data.raw) {
+        usage = std::max(usage, GetOffset(i) + int64_t(tensor.bytes));
+      }
+    }
+    return usage;
+  }
+
   TfLiteContext context_;
   TestGraph* graph_;
   std::unique_ptr<ArenaPlanner> planner_;
@@ -368,6 +383,42 @@ TEST_F(ArenaPlannerTest, SimpleGraphWithPersistentTensor) {
   EXPECT_EQ(GetOffset(3), 0);
 }
 
+TEST_F(ArenaPlannerTest, GraphWithConcurrentNodes) {
+  TestGraph graph({0},
+                  {
+                      /* in, out, tmp */
+                      {{0}, {1}, {}},      // First op
+                      {{1}, {2}, {5}},     // Second op, with temporary
+                      {{0}, {3}, {6}},     // Third op, with temporary
+                      {{2, 3}, {4}, {}},   // Fourth op
+                  },
+                  {4});
+  for (int i = 0; i < 7; ++i) {
+    (*graph.tensors())[i].bytes = 16;
+  }
+
+  // Without groups, #6 reuses the space of #1 and #3 reuses the space of #5.
+  // Alloc(+) and dealloc(-) order: +0 +1 +5 +2 -1 -5 +6 +3 -0 -6 +4 -2 -3
+  SetGraph(&graph);
+  Execute(0, 10);
+  EXPECT_EQ(GetOffset(6), GetOffset(1));
+  EXPECT_EQ(GetOffset(3), GetOffset(5));
+
+  // The second and third ops run concurrently, so none of #1, #5, #2, #6 and
+  // #3 may share memory.
+  // Alloc(+) and dealloc(-) order: +0 +1 +5 +2 +6 +3 -1 -0 -5 -6 +4 -2 -3
+  SetGraph(&graph, /*preserve_inputs=*/false, /*group_ends=*/{1, 3, 4});
+  Execute(0, 10);
+  EXPECT_EQ(GetOffset(0), 0);
+  EXPECT_EQ(GetOffset(1), GetOffsetAfter(0));
+  EXPECT_EQ(GetOffset(5), GetOffsetAfter(1));
+  EXPECT_EQ(GetOffset(2), GetOffsetAfter(5));
+  EXPECT_EQ(GetOffset(6), GetOffsetAfter(2));
+  EXPECT_EQ(GetOffset(3), GetOffsetAfter(6));
+  // #6 leaves the tightest gap.
+  EXPECT_EQ(GetOffset(4), GetOffsetAfter(2));
+}
+
 TEST_F(ArenaPlannerTest, SimpleGraphWithDynamicTensor) {
   TestGraph graph({0, -1, 1},
                   {
@@ -493,6 +544,98 @@ TEST_F(ArenaPlannerTest, LargerGraphAndStepwiseAllocation) {
   EXPECT_EQ(GetOffset(10), 0);
 }
 
+TEST_F(ArenaPlannerTest, OfflinePlan) {
+  TestGraph graph({0, 1},
+                  {
+                      /* in, out, tmp */
+                      {{0, 1}, {2, 3}, {}},
+                      {{2, 0}, {4, 5}, {6}},
+                      {{1, -1}, {7}, {}},
+                      {{7, 3}, {8}, {9}},
+                      {{4, 5, 8}, {10}, {}},
+                  },
+                  {10});
+  SetGraph(&graph);
+  Execute(0, 10);
+  EXPECT_FALSE(planner_->UsedOfflinePlan());
+  const int64_t online_usage = GetArenaUsage();
+
+  OfflineMemoryPlan plan;
+  ASSERT_EQ(planner_->CreateOfflinePlan(&plan), kTfLiteOk);
+  ASSERT_EQ(plan.offsets.size(), graph.tensors()->size());
+  EXPECT_LE(plan.arena_size, online_usage);
+
+  // A fresh planner places every tensor where the plan says.
+  SetGraph(&graph);
+  planner_->SetOfflinePlan(&plan);
+  Execute(0, 10);
+  EXPECT_TRUE(planner_->UsedOfflinePlan());
+  for (int i = 0; i < graph.tensors()->size(); ++i) {
+    EXPECT_EQ(GetOffset(i), plan.offsets[i]) << "tensor " << i;
+  }
+
+  // The plan is ignored when nodes are allocated incrementally.
+  planner_->ResetAllocations();
+  Execute(0, 2);
+  EXPECT_FALSE(planner_->UsedOfflinePlan());
+  Execute(3, 10);
+  EXPECT_FALSE(planner_->UsedOfflinePlan());
+
+  // The plan is ignored when a tensor outgrows its place.
+  (*graph.tensors())[4].bytes += 1;
+  planner_->ResetAllocations();
+  Execute(0, 10);
+  EXPECT_FALSE(planner_->UsedOfflinePlan());
+  (*graph.tensors())[4].bytes -= 1;
+
+  // The plan is ignored when a place runs past the end of the arena.
+  OfflineMemoryPlan overflowing_plan = plan;
+  overflowing_plan.sizes[4] = std::numeric_limits<int64_t>::max();
+  planner_->SetOfflinePlan(&overflowing_plan);
+  planner_->ResetAllocations();
+  Execute(0, 10);
+  EXPECT_FALSE(planner_->UsedOfflinePlan());
+
+  // The plan is ignored when it overlaps tensors that are live together.
+  OfflineMemoryPlan bad_plan = plan;
+  bad_plan.offsets[2] = bad_plan.offsets[0];
+  bad_plan.sizes[2] = std::max(bad_plan.sizes[0], bad_plan.sizes[2]);
+  planner_->SetOfflinePlan(&bad_plan);
+  planner_->ResetAllocations();
+  Execute(0, 10);
+  EXPECT_FALSE(planner_->UsedOfflinePlan());
+  EXPECT_NE(GetOffset(2), GetOffset(0));
+}
+
+TEST_F(ArenaPlannerTest, OfflinePlanWithConcurrentNodes) {
+  TestGraph graph({0},
+                  {
+                      /* in, out, tmp */
+                      {{0}, {1}, {}},
+                      {{1}, {2}, {5}},
+                      {{0}, {3}, {6}},
+                      {{2, 3}, {4}, {}},
+                  },
+                  {4});
+
+  // A plan made without groups may reuse memory within a group.
+  SetGraph(&graph);
+  Execute(0, 10);
+  OfflineMemoryPlan plan;
+  ASSERT_EQ(planner_->CreateOfflinePlan(&plan), kTfLiteOk);
+  SetGraph(&graph, /*preserve_inputs=*/false, /*group_ends=*/{1, 3, 4});
+  planner_->SetOfflinePlan(&plan);
+  Execute(0, 10);
+  EXPECT_FALSE(planner_->UsedOfflinePlan());
+
+  OfflineMemoryPlan concurrent_plan;
+  ASSERT_EQ(planner_->CreateOfflinePlan(&concurrent_plan), kTfLiteOk);
+  SetGraph(&graph, /*preserve_inputs=*/false, /*group_ends=*/{1, 3, 4});
+  planner_->SetOfflinePlan(&concurrent_plan);
+  Execute(0, 10);
+  EXPECT_TRUE(planner_->UsedOfflinePlan());
+}
+
 }  // namespace
 }  // namespace tflite
 
@@ -208,6 +208,23 @@ typedef enum {
 typedef int TfLiteBufferHandle;
 const TfLiteBufferHandle kTfLiteNullBufferHandle = -1;
 
+// Block-sparse (BSR) layout of a constant tensor. The tensor is viewed as a
+// matrix with dims[0] rows whose columns span all the other dimensions, split
+// into block_rows x block_cols blocks. The tensor data then only holds the
+// blocks with non-zero values, each stored row-major, in the order of
+// increasing block row and, within a block row, increasing block column.
+// The arrays aren't owned by the tensor and must outlive it.
+// WARNING: This is an experimental interface that is subject to change.
+typedef struct {
+  int block_rows;
+  int block_cols;
+  // The blocks of block row i are [row_ptr[i], row_ptr[i + 1]). Holds
+  // dims[0] / block_rows + 1 values.
+  const int* row_ptr;
+  // The block column of each stored block.
+  const int* col_indices;
+} TfLiteBlockSparsity;
+
 // An tensor in the interpreter system which is a wrapper around a buffer of
 // data including a dimensionality (or NULL if not currently defined).
 typedef struct {
@@ -259,6 +276,12 @@ typedef struct {
 
   // True if the tensor is a variable.
   bool is_variable;
+
+  // The block-sparse layout of `data`, or NULL if the tensor is dense. Only
+  // set on read-only tensors, and only kernels that check for it may be given
+  // such tensors.
+  // WARNING: This is an experimental interface that is subject to change.
+  const TfLiteBlockSparsity* sparsity;
 } TfLiteTensor;
 
 // Free data memory of tensor `t`;
@@ -0,0 +1,96 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/contrib/lite/inter_op_thread_pool.h"
+
+namespace tflite {
+
+InterOpThreadPool::InterOpThreadPool(int num_threads) {
+  for (int i = 1; i < num_threads; ++i) {
+    workers_.emplace_back([this]() { WorkerLoop(); });
+  }
+}
+
+InterOpThreadPool::~InterOpThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  work_available_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void InterOpThreadPool::ParallelFor(int num_tasks,
+                                    const std::function<void(int)>& fn) {
+  if (num_tasks <= 1 || workers_.empty()) {
+    for (int i = 0; i < num_tasks; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fn_ = &fn;
+    num_tasks_ = num_tasks;
+    next_task_ = 0;
+    num_busy_workers_ = workers_.size();
+    ++generation_;
+  }
+  work_available_.notify_all();
+
+  RunTasks(fn, num_tasks);
+
+  // Every worker must have seen this batch before the next one is posted, so
+  // wait for all of them and not just for the tasks to be done.
+  std::unique_lock<std::mutex> lock(mutex_);
+  work_done_.wait(lock, [this]() { return num_busy_workers_ == 0; });
+  fn_ = nullptr;
+}
+
+void InterOpThreadPool::WorkerLoop() {
+  int last_generation = 0;
+  while (true) {
+    const std::function<void(int)>* fn;
+    int num_tasks;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_available_.wait(lock, [this, last_generation]() {
+        return shutdown_ || generation_ != last_generation;
+      });
+      if (shutdown_) return;
+      last_generation = generation_;
+      fn = fn_;
+      num_tasks = num_tasks_;
+    }
+
+    RunTasks(*fn, num_tasks);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--num_busy_workers_ == 0) {
+      work_done_.notify_one();
+    }
+  }
+}
+
+void InterOpThreadPool::RunTasks(const std::function<void(int)>& fn,
+                                 int num_tasks) {
+  for (int i = next_task_++; i < num_tasks; i = next_task_++) {
+    fn(i);
+  }
+}
+
+}  // namespace tflite
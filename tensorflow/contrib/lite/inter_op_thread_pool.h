@@ -0,0 +1,74 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CONTRIB_LITE_INTER_OP_THREAD_POOL_H_
+#define TENSORFLOW_CONTRIB_LITE_INTER_OP_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tflite {
+
+// A minimal pool of threads used by the Interpreter to execute independent
+// nodes of the graph concurrently. The thread calling ParallelFor() takes part
+// in the work, so a pool of 'num_threads' only creates 'num_threads - 1'
+// threads of its own.
+// WARNING: This is an experimental interface that is subject to change.
+class InterOpThreadPool {
+ public:
+  explicit InterOpThreadPool(int num_threads);
+  ~InterOpThreadPool();
+
+  InterOpThreadPool(const InterOpThreadPool&) = delete;
+  InterOpThreadPool& operator=(const InterOpThreadPool&) = delete;
+
+  // Total number of threads executing tasks, including the caller's.
+  int num_threads() const { return workers_.size() + 1; }
+
+  // Calls 'fn(i)' for every i in [0, num_tasks), possibly concurrently, and
+  // returns once all calls have returned. Must not be called concurrently
+  // with itself.
+  void ParallelFor(int num_tasks, const std::function<void(int)>& fn);
+
+ private:
+  void WorkerLoop();
+  void RunTasks(const std::function<void(int)>& fn, int num_tasks);
+
+  std::vector<std::thread> workers_;
+
+  std::mutex mutex_;
+  // Signaled when a new batch of tasks is available, or on shutdown.
+  std::condition_variable work_available_;
+  // Signaled when the last worker is done with the current batch.
+  std::condition_variable work_done_;
+
+  // The current batch of tasks, guarded by 'mutex_'. 'generation_' is
+  // incremented for every batch so that workers never pick up a batch twice.
+  const std::function<void(int)>* fn_ = nullptr;
+  int num_tasks_ = 0;
+  int generation_ = 0;
+  int num_busy_workers_ = 0;
+  bool shutdown_ = false;
+
+  // Index of the next task of the current batch to be run.
+  std::atomic<int> next_task_{0};
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_CONTRIB_LITE_INTER_OP_THREAD_POOL_H_
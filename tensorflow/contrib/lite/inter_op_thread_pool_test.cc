@@ -0,0 +1,63 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/contrib/lite/inter_op_thread_pool.h"
+
+#include <atomic>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "tensorflow/contrib/lite/testing/util.h"
+
+namespace tflite {
+namespace {
+
+TEST(InterOpThreadPoolTest, SingleThread) {
+  InterOpThreadPool pool(1);
+  EXPECT_EQ(pool.num_threads(), 1);
+  std::vector<int> order;
+  pool.ParallelFor(4, [&order](int i) { order.push_back(i); });
+  EXPECT_EQ(order, std::vector<int>({0, 1, 2, 3}));
+}
+
+TEST(InterOpThreadPoolTest, RunsEveryTaskOnce) {
+  InterOpThreadPool pool(4);
+  EXPECT_EQ(pool.num_threads(), 4);
+  for (int num_tasks : {0, 1, 2, 3, 4, 5, 17, 100}) {
+    std::vector<std::atomic<int>> counts(num_tasks);
+    for (auto& count : counts) count = 0;
+    pool.ParallelFor(num_tasks, [&counts](int i) { ++counts[i]; });
+    for (int i = 0; i < num_tasks; ++i) {
+      EXPECT_EQ(counts[i], 1) << "task " << i << " of " << num_tasks;
+    }
+  }
+}
+
+TEST(InterOpThreadPoolTest, RepeatedCalls) {
+  InterOpThreadPool pool(3);
+  std::atomic<int> total(0);
+  for (int i = 0; i < 1000; ++i) {
+    pool.ParallelFor(3, [&total](int) { ++total; });
+  }
+  EXPECT_EQ(total, 3000);
+}
+
+}  // namespace
+}  // namespace tflite
+
+int main(int argc, char** argv) {
+  ::tflite::LogToStderr();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/contrib/lite/interpreter.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdarg>
 #include <cstdint>
@@ -77,6 +78,32 @@ bool HasDynamicTensorImpl(const TfLiteContext& context,
   return false;
 }
 
+// Block-sparse tensors hold only their stored blocks, so any kernel without a
+// block-sparse path would read them as dense data, past the end of the buffer.
+// Only the weights of FULLY_CONNECTED and CONV_2D may be block-sparse, and
+// delegates never see them.
+TfLiteStatus CheckBlockSparseInputs(TfLiteContext* context,
+                                    const TfLiteNode& node,
+                                    const TfLiteRegistration& registration,
+                                    int node_index) {
+  const bool has_sparse_kernel =
+      registration.custom_name == nullptr && node.delegate == nullptr &&
+      (registration.builtin_code == BuiltinOperator_FULLY_CONNECTED ||
+       registration.builtin_code == BuiltinOperator_CONV_2D);
+  for (int i = 0; i < node.inputs->size; ++i) {
+    const int tensor_index = node.inputs->data[i];
+    if (tensor_index == kOptionalTensor ||
+        context->tensors[tensor_index].sparsity == nullptr) {
+      continue;
+    }
+    // Input 1 holds the weights of both ops.
+    if (has_sparse_kernel && i == 1) continue;
+    return ReportOpError(context, node, registration, node_index,
+                         "doesn't support block-sparse inputs");
+  }
+  return kTfLiteOk;
+}
+
 }  // namespace
 
 // A trivial implementation of GraphInfo around the Interpreter.
@@ -258,6 +285,23 @@ TfLiteStatus Interpreter::ReplaceSubgraphsWithDelegateKernels(
   std::vector<Subgraph> subgraphs;
   PartitionGraphIntoIndependentSubgraphs(&info, nodes_to_replace, &subgraphs);
 
+  // Delegate kernels may read their constant inputs as soon as they are
+  // initialized, so block-sparse tensors are rejected before any of them is
+  // created, leaving the graph as it was.
+  for (const auto& subgraph : subgraphs) {
+    if (subgraph.type != Subgraph::kTfPartition) continue;
+    for (int tensor_index : subgraph.input_tensors) {
+      if (tensor_index != kOptionalTensor &&
+          tensors_[tensor_index].sparsity != nullptr) {
+        ReportError(&context_,
+                    "Delegates don't support block-sparse tensors (index %d "
+                    "name %s).",
+                    tensor_index, tensors_[tensor_index].name);
+        return kTfLiteError;
+      }
+    }
+  }
+
   execution_plan_.clear();
   for (auto& subgraph : subgraphs) {
     // Subgraphs calimed by the delegate should have a "macro" op created, the
@@ -440,6 +484,19 @@ TfLiteStatus Interpreter::AllocateTensors() {
     return kTfLiteOk;
   }
 
+  // Graph inputs and outputs are read and written as dense data by callers.
+  for (const std::vector<int>* io : {&inputs_, &outputs_}) {
+    for (int tensor_index : *io) {
+      if (tensor_index != kOptionalTensor &&
+          tensors_[tensor_index].sparsity != nullptr) {
+        ReportError(&context_,
+                    "Block-sparse tensor %d can't be a graph input or output.",
+                    tensor_index);
+        return kTfLiteError;
+      }
+    }
+  }
+
   next_execution_plan_index_to_prepare_ = 0;
   if (memory_planner_) {
     TF_LITE_ENSURE_STATUS(memory_planner_->ResetAllocations());
@@ -581,6 +638,8 @@ TfLiteStatus Interpreter::PrepareOpsStartingAt(
     const TfLiteRegistration& registration =
         nodes_and_registration_[node_index].second;
     EnsureTensorsVectorCapacity();
+    TF_LITE_ENSURE_STATUS(
+        CheckBlockSparseInputs(&context_, node, registration, node_index));
     if (OpPrepare(registration, &node) == kTfLiteError) {
       return ReportOpError(&context_, node, registration, node_index,
                            "failed to prepare");
@@ -598,11 +657,152 @@ TfLiteStatus Interpreter::PrepareOpsStartingAt(
   return kTfLiteOk;
 }
 
+void Interpreter::PlanConcurrentExecution() {
+  // The level of a node is one more than the highest level of the nodes it
+  // depends on, so nodes with the same level are independent. Besides reading
+  // a tensor written by an earlier node, a node depends on the earlier readers
+  // of the tensors it writes, including variable tensors, which are read and
+  // updated in place by the nodes that take them as inputs.
+  std::vector<int> last_write_level(tensors_.size(), -1);
+  std::vector<int> last_read_level(tensors_.size(), -1);
+  std::vector<int> levels(execution_plan_.size());
+  int num_levels = 0;
+  for (int i = 0; i < execution_plan_.size(); ++i) {
+    const TfLiteNode& node = nodes_and_registration_[execution_plan_[i]].first;
+    int level = 0;
+    for (int tensor_index : TfLiteIntArrayView(node.inputs)) {
+      if (tensor_index == kOptionalTensor) continue;
+      level = std::max(level, last_write_level[tensor_index] + 1);
+      if (tensors_[tensor_index].is_variable) {
+        level = std::max(level, last_read_level[tensor_index] + 1);
+      }
+    }
+    for (int tensor_index : TfLiteIntArrayView(node.outputs)) {
+      if (tensor_index == kOptionalTensor) continue;
+      level = std::max(level, last_write_level[tensor_index] + 1);
+      level = std::max(level, last_read_level[tensor_index] + 1);
+    }
+    for (int tensor_index : TfLiteIntArrayView(node.inputs)) {
+      if (tensor_index == kOptionalTensor) continue;
+      last_read_level[tensor_index] =
+          std::max(last_read_level[tensor_index], level);
+      if (tensors_[tensor_index].is_variable) {
+        last_write_level[tensor_index] = level;
+      }
+    }
+    for (int tensor_index : TfLiteIntArrayView(node.outputs)) {
+      if (tensor_index == kOptionalTensor) continue;
+      last_write_level[tensor_index] = level;
+    }
+    levels[i] = level;
+    num_levels = std::max(num_levels, level + 1);
+  }
+
+  // Stable counting sort by level. The result is still a valid topological
+  // order, so the plan can also be executed one node at a time.
+  std::vector<int> group_ends(num_levels, 0);
+  for (int level : levels) {
+    ++group_ends[level];
+  }
+  for (int level = 1; level < num_levels; ++level) {
+    group_ends[level] += group_ends[level - 1];
+  }
+  std::vector<int> new_plan(execution_plan_.size());
+  std::vector<int> next_position(num_levels, 0);
+  for (int level = 1; level < num_levels; ++level) {
+    next_position[level] = group_ends[level - 1];
+  }
+  for (int i = 0; i < execution_plan_.size(); ++i) {
+    new_plan[next_position[levels[i]]++] = execution_plan_[i];
+  }
+  execution_plan_ = new_plan;
+  concurrent_group_ends_ = group_ends;
+}
+
+bool Interpreter::CanInvokeConcurrently() const {
+#ifdef TFLITE_PROFILING_ENABLED
+  // Operator profiling records one operator at a time.
+  if (profiler_ != nullptr) {
+    return false;
+  }
+#endif
+  if (!inter_op_thread_pool_ || concurrent_group_ends_.empty() ||
+      concurrent_group_ends_.back() != execution_plan_.size() ||
+      next_execution_plan_index_to_prepare_ != execution_plan_.size()) {
+    return false;
+  }
+  // Dynamic tensors are allocated while nodes are executed and delegates
+  // may share state between nodes, so both require sequential execution.
+  for (int node_index : execution_plan_) {
+    const TfLiteNode& node = nodes_and_registration_[node_index].first;
+    if (node.delegate != nullptr ||
+        HasDynamicTensor(context_, node.outputs) ||
+        HasDynamicTensor(context_, node.temporaries)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TfLiteStatus Interpreter::InvokeConcurrently() {
+  TfLiteStatus status = kTfLiteOk;
+  std::vector<char> failed;
+  int group_start = 0;
+  for (int group_end : concurrent_group_ends_) {
+    // Copying data out of delegate buffers isn't thread-safe, so it is done
+    // for the whole group upfront.
+    for (int i = group_start; i < group_end; ++i) {
+      const TfLiteNode& node =
+          nodes_and_registration_[execution_plan_[i]].first;
+      for (int tensor_index : TfLiteIntArrayView(node.inputs)) {
+        if (tensor_index == kOptionalTensor) continue;
+        const TfLiteTensor& tensor = tensors_[tensor_index];
+        if (tensor.delegate && tensor.data_is_stale) {
+          EnsureTensorDataIsReadable(tensor_index);
+        }
+      }
+    }
+
+    EnsureTensorsVectorCapacity();
+    tensor_resized_since_op_invoke_ = false;
+    failed.assign(group_end - group_start, false);
+    inter_op_thread_pool_->ParallelFor(
+        group_end - group_start, [this, group_start, &failed](int i) {
+          int node_index = execution_plan_[group_start + i];
+          TfLiteNode& node = nodes_and_registration_[node_index].first;
+          const TfLiteRegistration& registration =
+              nodes_and_registration_[node_index].second;
+          failed[i] = OpInvoke(registration, &node) == kTfLiteError;
+        });
+
+    // Errors are reported from this thread, since the error reporter isn't
+    // required to be thread-safe.
+    for (int i = group_start; i < group_end; ++i) {
+      if (failed[i - group_start]) {
+        int node_index = execution_plan_[i];
+        status = ReportOpError(&context_,
+                               nodes_and_registration_[node_index].first,
+                               nodes_and_registration_[node_index].second,
+                               node_index, "failed to invoke");
+      }
+    }
+    group_start = group_end;
+  }
+  return status;
+}
+
 TfLiteStatus Interpreter::PrepareOpsAndTensors() {
   if (!memory_planner_) {
-    memory_planner_.reset(new ArenaPlanner(
+    concurrent_group_ends_.clear();
+    if (inter_op_thread_pool_) {
+      PlanConcurrentExecution();
+    }
+    std::unique_ptr<ArenaPlanner> planner(new ArenaPlanner(
         &context_, std::unique_ptr<GraphInfo>(new InterpreterInfo(this)),
         /*preserve_inputs=*/true, /*preserve_intermediates*/ false));
+    planner->SetConcurrentNodeGroups(concurrent_group_ends_);
+    planner->SetOfflinePlan(offline_memory_plan_.get());
+    memory_planner_ = std::move(planner);
     memory_planner_->PlanAllocations();
   }
 
@@ -642,54 +842,60 @@ TfLiteStatus Interpreter::Invoke() {
     }
   }
 
-  // Invocations are always done in node order.
+  // Invocations are always done in node order, or one group of independent
+  // nodes at a time when executing nodes concurrently.
   // Note that calling Invoke repeatedly will cause the original memory plan to
   // be reused, unless either ResizeInputTensor() or AllocateTensors() has been
   // called.
   // TODO(b/71913981): we should force recalculation in the presence of dynamic
   // tensors, because they may have new value which in turn may affect shapes
   // and allocations.
-  for (int execution_plan_index = 0;
-       execution_plan_index < execution_plan_.size(); execution_plan_index++) {
-    if (execution_plan_index == next_execution_plan_index_to_prepare_) {
-      TF_LITE_ENSURE_STATUS(PrepareOpsAndTensors());
-      TF_LITE_ENSURE(&context_, next_execution_plan_index_to_prepare_ >=
-                                    execution_plan_index);
-    }
-    int node_index = execution_plan_[execution_plan_index];
-    TfLiteNode& node = nodes_and_registration_[node_index].first;
-    const TfLiteRegistration& registration =
-        nodes_and_registration_[node_index].second;
-    SCOPED_OPERATOR_PROFILE(profiler_, node_index);
-
-    // TODO(ycling): This is an extra loop through inputs to check if the data
-    // need to be copied from Delegate buffer to raw memory, which is often not
-    // needed. We may want to cache this in prepare to know if this needs to be
-    // done for a node or not.
-    for (int i = 0; i < node.inputs->size; ++i) {
-      int tensor_index = node.inputs->data[i];
-      if (tensor_index == kOptionalTensor) {
-        continue;
+  if (CanInvokeConcurrently()) {
+    status = InvokeConcurrently();
+  } else {
+    for (int execution_plan_index = 0;
+         execution_plan_index < execution_plan_.size();
+         execution_plan_index++) {
+      if (execution_plan_index == next_execution_plan_index_to_prepare_) {
+        TF_LITE_ENSURE_STATUS(PrepareOpsAndTensors());
+        TF_LITE_ENSURE(&context_, next_execution_plan_index_to_prepare_ >=
+                                      execution_plan_index);
       }
-      TfLiteTensor* tensor = &tensors_[tensor_index];
-      if (tensor->delegate && tensor->delegate != node.delegate &&
-          tensor->data_is_stale) {
-        EnsureTensorDataIsReadable(tensor_index);
+      int node_index = execution_plan_[execution_plan_index];
+      TfLiteNode& node = nodes_and_registration_[node_index].first;
+      const TfLiteRegistration& registration =
+          nodes_and_registration_[node_index].second;
+      SCOPED_OPERATOR_PROFILE(profiler_, node_index);
+
+      // TODO(ycling): This is an extra loop through inputs to check if the
+      // data need to be copied from Delegate buffer to raw memory, which is
+      // often not needed. We may want to cache this in prepare to know if this
+      // needs to be done for a node or not.
+      for (int i = 0; i < node.inputs->size; ++i) {
+        int tensor_index = node.inputs->data[i];
+        if (tensor_index == kOptionalTensor) {
+          continue;
+        }
+        TfLiteTensor* tensor = &tensors_[tensor_index];
+        if (tensor->delegate && tensor->delegate != node.delegate &&
+            tensor->data_is_stale) {
+          EnsureTensorDataIsReadable(tensor_index);
+        }
       }
-    }
 
-    EnsureTensorsVectorCapacity();
-    tensor_resized_since_op_invoke_ = false;
-    if (OpInvoke(registration, &node) == kTfLiteError) {
-      status = ReportOpError(&context_, node, registration, node_index,
-                             "failed to invoke");
-    }
+      EnsureTensorsVectorCapacity();
+      tensor_resized_since_op_invoke_ = false;
+      if (OpInvoke(registration, &node) == kTfLiteError) {
+        status = ReportOpError(&context_, node, registration, node_index,
+                               "failed to invoke");
+      }
 
-    // Force execution prep for downstream ops if the latest op triggered the
-    // resize of a dynamic tensor.
-    if (tensor_resized_since_op_invoke_ &&
-        HasDynamicTensor(context_, node.outputs)) {
-      next_execution_plan_index_to_prepare_ = execution_plan_index + 1;
+      // Force execution prep for downstream ops if the latest op triggered the
+      // resize of a dynamic tensor.
+      if (tensor_resized_since_op_invoke_ &&
+          HasDynamicTensor(context_, node.outputs)) {
+        next_execution_plan_index_to_prepare_ = execution_plan_index + 1;
+      }
     }
   }
 
@@ -769,7 +975,8 @@ TfLiteStatus Interpreter::GetNodeAndRegistration(
 TfLiteStatus Interpreter::SetTensorParametersReadOnly(
     int tensor_index, TfLiteType type, const char* name, const size_t rank,
     const int* dims, TfLiteQuantizationParams quantization, const char* buffer,
-    size_t bytes, const Allocation* allocation) {
+    size_t bytes, const Allocation* allocation,
+    const TfLiteBlockSparsity* sparsity) {
   if (state_ == kStateInvokableAndImmutable) {
     ReportError(
         &context_,
@@ -782,7 +989,10 @@ TfLiteStatus Interpreter::SetTensorParametersReadOnly(
   // For most tensors we know exactly how much memory is necessary so we can
   // ensure the buffer is large enough. However, we need to skip string tensors
   // because their sizes change with the contents of the individual strings.
-  if (type != kTfLiteString) {
+  if (sparsity) {
+    TF_LITE_ENSURE_OK(&context_, CheckBlockSparsity(type, rank, dims, *sparsity,
+                                                    bytes));
+  } else if (type != kTfLiteString) {
     size_t required_bytes;
     TF_LITE_ENSURE_OK(&context_,
                       BytesRequired(type, dims, rank, &required_bytes));
@@ -805,6 +1015,53 @@ TfLiteStatus Interpreter::SetTensorParametersReadOnly(
                       quantization, const_cast<char*>(buffer), bytes,
                       kTfLiteMmapRo, allocation, false, &tensor);
   }
+  if (sparsity) {
+    tensor_sparsity_[tensor_index] = *sparsity;
+    tensor.sparsity = &tensor_sparsity_[tensor_index];
+  } else {
+    tensor_sparsity_.erase(tensor_index);
+    tensor.sparsity = nullptr;
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus Interpreter::CheckBlockSparsity(
+    TfLiteType type, const size_t rank, const int* dims,
+    const TfLiteBlockSparsity& sparsity, size_t bytes) {
+  TF_LITE_ENSURE(&context_, rank >= 1);
+  TF_LITE_ENSURE(&context_,
+                 sparsity.block_rows > 0 && sparsity.block_cols > 0);
+  TF_LITE_ENSURE(&context_,
+                 sparsity.row_ptr != nullptr && sparsity.col_indices != nullptr);
+  const int rows = dims[0];
+  int cols = 1;
+  for (int i = 1; i < rank; ++i) cols *= dims[i];
+  TF_LITE_ENSURE_EQ(&context_, rows % sparsity.block_rows, 0);
+  TF_LITE_ENSURE_EQ(&context_, cols % sparsity.block_cols, 0);
+  const int num_block_rows = rows / sparsity.block_rows;
+  const int num_block_cols = cols / sparsity.block_cols;
+
+  // Block columns must be in range and increasing within each block row.
+  TF_LITE_ENSURE_EQ(&context_, sparsity.row_ptr[0], 0);
+  for (int i = 0; i < num_block_rows; ++i) {
+    const int start = sparsity.row_ptr[i];
+    const int end = sparsity.row_ptr[i + 1];
+    TF_LITE_ENSURE(&context_, start <= end && end - start <= num_block_cols);
+    for (int k = start; k < end; ++k) {
+      const int block_col = sparsity.col_indices[k];
+      TF_LITE_ENSURE(&context_, block_col >= 0 && block_col < num_block_cols);
+      TF_LITE_ENSURE(&context_,
+                     k == start || block_col > sparsity.col_indices[k - 1]);
+    }
+  }
+
+  const int num_blocks = sparsity.row_ptr[num_block_rows];
+  const int block_dims[] = {num_blocks, sparsity.block_rows,
+                            sparsity.block_cols};
+  size_t required_bytes;
+  TF_LITE_ENSURE_OK(&context_,
+                    BytesRequired(type, block_dims, 3, &required_bytes));
+  TF_LITE_ENSURE_EQ(&context_, required_bytes, bytes);
   return kTfLiteOk;
 }
 
@@ -849,6 +1106,8 @@ TfLiteStatus Interpreter::SetTensorParametersReadWrite(
                     quantization,
                     /*buffer=*/nullptr, required_bytes, allocation_type,
                     nullptr, is_variable, &context_.tensors[tensor_index]);
+  tensor_sparsity_.erase(tensor_index);
+  context_.tensors[tensor_index].sparsity = nullptr;
   return kTfLiteOk;
 }
 
@@ -920,6 +1179,48 @@ void Interpreter::SetNumThreads(int num_threads) {
   }
 }
 
+TfLiteStatus Interpreter::SetNumInterOpThreads(int num_threads) {
+  if (state_ == kStateInvokableAndImmutable) {
+    ReportError(&context_,
+                "SetNumInterOpThreads is disallowed when graph is immutable.");
+    return kTfLiteError;
+  }
+  TF_LITE_ENSURE(&context_, num_threads >= 1);
+  int current_num_threads =
+      inter_op_thread_pool_ ? inter_op_thread_pool_->num_threads() : 1;
+  if (num_threads == current_num_threads) {
+    return kTfLiteOk;
+  }
+  inter_op_thread_pool_.reset(
+      num_threads > 1 ? new InterOpThreadPool(num_threads) : nullptr);
+
+  // Which nodes run concurrently determines both the execution order and the
+  // memory plan, so both are recomputed by the next AllocateTensors().
+  memory_planner_.reset();
+  concurrent_group_ends_.clear();
+  state_ = kStateUninvokable;
+  return kTfLiteOk;
+}
+
+void Interpreter::SetOfflineMemoryPlan(
+    std::unique_ptr<OfflineMemoryPlan> plan) {
+  offline_memory_plan_ = std::move(plan);
+  if (memory_planner_) {
+    memory_planner_->SetOfflinePlan(offline_memory_plan_.get());
+  }
+}
+
+TfLiteStatus Interpreter::CreateOfflineMemoryPlan(OfflineMemoryPlan* plan) {
+  if (!memory_planner_ ||
+      next_execution_plan_index_to_prepare_ != execution_plan_.size()) {
+    ReportError(&context_,
+                "AllocateTensors() must be called before creating an offline "
+                "memory plan.");
+    return kTfLiteError;
+  }
+  return memory_planner_->CreateOfflinePlan(plan);
+}
+
 void Interpreter::SwitchToDelegateContext() {
   context_.GetNodeAndRegistration = GetNodeAndRegistration;
   context_.ReplaceSubgraphsWithDelegateKernels =
@@ -20,12 +20,16 @@ limitations under the License.
 #include <complex>
 #include <cstdio>
 #include <cstdlib>
+#include <map>
+#include <memory>
 #include <vector>
 
 #include "tensorflow/contrib/lite/allocation.h"
 #include "tensorflow/contrib/lite/c/c_api_internal.h"
 #include "tensorflow/contrib/lite/core/api/error_reporter.h"
+#include "tensorflow/contrib/lite/inter_op_thread_pool.h"
 #include "tensorflow/contrib/lite/memory_planner.h"
+#include "tensorflow/contrib/lite/offline_memory_plan.h"
 #include "tensorflow/contrib/lite/profiling/profiler.h"
 #include "tensorflow/contrib/lite/stderr_reporter.h"
 
@@ -70,6 +74,7 @@ constexpr TfLiteType typeToTfLiteType<string>() {
 }
 
 // Forward declare since NNAPIDelegate uses Interpreter.
+class ArenaPlanner;
 class NNAPIDelegate;
 
 // An interpreter for a graph of nodes that input and output from tensors.
@@ -163,20 +168,25 @@ class Interpreter {
   // This variant assumes an external buffer has been allocated of size
   // bytes. The lifetime of buffer must be ensured to be greater or equal
   // to Interpreter.
+  // If `sparsity` is given, `buffer` only holds the non-zero blocks it
+  // describes. The arrays it points to must outlive the Interpreter too.
+  // Such a tensor may only be the weights of FULLY_CONNECTED or CONV_2D ops
+  // that aren't delegated; AllocateTensors() fails for any other use.
   inline TfLiteStatus SetTensorParametersReadOnly(
       int tensor_index, TfLiteType type, const char* name,
       const std::vector<int>& dims, TfLiteQuantizationParams quantization,
-      const char* buffer, size_t bytes,
-      const Allocation* allocation = nullptr) {
+      const char* buffer, size_t bytes, const Allocation* allocation = nullptr,
+      const TfLiteBlockSparsity* sparsity = nullptr) {
     return SetTensorParametersReadOnly(tensor_index, type, name, dims.size(),
                                        dims.data(), quantization, buffer, bytes,
-                                       allocation);
+                                       allocation, sparsity);
   }
 
   TfLiteStatus SetTensorParametersReadOnly(
       int tensor_index, TfLiteType type, const char* name, const size_t rank,
       const int* dims, TfLiteQuantizationParams quantization,
-      const char* buffer, size_t bytes, const Allocation* allocation = nullptr);
+      const char* buffer, size_t bytes, const Allocation* allocation = nullptr,
+      const TfLiteBlockSparsity* sparsity = nullptr);
 
   // Set description of inputs/outputs/data/fptrs for node `node_index`.
   // This variant assumes an external buffer has been allocated of size
@@ -336,6 +346,31 @@ class Interpreter {
   // Set the number of threads available to the interpreter.
   void SetNumThreads(int num_threads);
 
+  // Set the number of threads used to execute independent nodes of the graph
+  // concurrently. This is independent of SetNumThreads(), which controls the
+  // threads used within a single op. With more than one thread, the execution
+  // plan is reordered so that nodes that don't depend on each other are
+  // adjacent, and the memory plan keeps their tensors apart. Nodes are still
+  // executed one at a time if the graph has dynamic tensors or delegated
+  // nodes, or while operators are being profiled.
+  // AllocateTensors() must be called again after changing this value, which
+  // also resets the variable tensors.
+  // WARNING: This is an experimental API and subject to change.
+  TfLiteStatus SetNumInterOpThreads(int num_threads);
+
+  // Use a precomputed layout for the tensors allocated in the arena. The plan
+  // is checked against the lifetimes and sizes of the tensors when they are
+  // allocated, and is ignored if it doesn't fit them, for example after an
+  // input was resized. It takes effect at the next AllocateTensors().
+  // WARNING: This is an experimental API and subject to change.
+  void SetOfflineMemoryPlan(std::unique_ptr<OfflineMemoryPlan> plan);
+
+  // Compute a layout of the arena tensors that can be stored in the model and
+  // passed to SetOfflineMemoryPlan() later. AllocateTensors() must have been
+  // called first.
+  // WARNING: This is an experimental API and subject to change.
+  TfLiteStatus CreateOfflineMemoryPlan(OfflineMemoryPlan* plan);
+
   // Allow float16 precision for FP32 calculation when possible.
   // default: not allow.
   // WARNING: This is an experimental API and subject to change.
@@ -495,6 +530,18 @@ class Interpreter {
   TfLiteStatus PrepareOpsStartingAt(int first_execution_plan_index,
                                     int* last_execution_plan_index_prepared);
 
+  // Reorder `execution_plan_` by dependency level, so that nodes that may be
+  // executed concurrently are adjacent, and fill `concurrent_group_ends_`.
+  void PlanConcurrentExecution();
+
+  // Whether the next Invoke() can execute the groups in
+  // `concurrent_group_ends_` concurrently.
+  bool CanInvokeConcurrently() const;
+
+  // Invoke every node of the execution plan, one group of independent nodes
+  // at a time, using `inter_op_thread_pool_`.
+  TfLiteStatus InvokeConcurrently();
+
   // Tensors needed by the interpreter. Use `AddTensors` to add more blank
   // tensor entries. Note, `tensors_.data()` needs to be synchronized to the
   // `context_` whenever this std::vector is reallocated. Currently this
@@ -513,6 +560,13 @@ class Interpreter {
   TfLiteStatus BytesRequired(TfLiteType type, const int* dims, size_t dims_size,
                              size_t* bytes);
 
+  // Checks that `sparsity` is a valid block-sparse layout for a tensor of the
+  // given type and dimensions whose data takes `bytes`.
+  TfLiteStatus CheckBlockSparsity(TfLiteType type, const size_t rank,
+                                  const int* dims,
+                                  const TfLiteBlockSparsity& sparsity,
+                                  size_t bytes);
+
   // Request an tensor be resized implementation. If the given tensor is of
   // type kTfLiteDynamic it will also be allocated new memory.
   TfLiteStatus ResizeTensorImpl(TfLiteTensor* tensor, TfLiteIntArray* new_size);
@@ -675,7 +729,14 @@ class Interpreter {
   // TODO(b/116667551): Use TfLiteExternalContext for storing state.
   std::vector<TfLiteDelegatePtr> owned_delegates_;
 
-  std::unique_ptr<MemoryPlanner> memory_planner_;
+  std::unique_ptr<ArenaPlanner> memory_planner_;
+
+  // Layout used by `memory_planner_` for the arena tensors, if any.
+  std::unique_ptr<OfflineMemoryPlan> offline_memory_plan_;
+
+  // The block-sparse layouts of the read-only tensors that have one, by tensor
+  // index. TfLiteTensor::sparsity points into this map.
+  std::map<int, TfLiteBlockSparsity> tensor_sparsity_;
 
   bool allow_buffer_handle_output_ = false;
 
@@ -687,6 +748,15 @@ class Interpreter {
   // Profiler for this interpreter instance.
   profiling::Profiler* profiler_ = nullptr;
 
+  // Threads used to execute independent nodes concurrently. Null if
+  // SetNumInterOpThreads() was never called with more than one thread.
+  std::unique_ptr<InterOpThreadPool> inter_op_thread_pool_;
+
+  // Groups of consecutive nodes in `execution_plan_` that don't depend on each
+  // other, given as one past the execution plan index of the last node of each
+  // group. Empty unless nodes may be executed concurrently.
+  std::vector<int> concurrent_group_ends_;
+
   // List of active external contexts.
   TfLiteExternalContext* external_contexts_[kTfLiteMaxExternalContexts];
 };
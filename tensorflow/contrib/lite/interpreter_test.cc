@@ -218,6 +218,127 @@ TEST(BasicInterpreter, CheckResize) {
   }
 }
 
+TEST(BasicInterpreter, CheckBlockSparseReadOnly) {
+  Interpreter interpreter;
+  ASSERT_EQ(interpreter.AddTensors(1), kTfLiteOk);
+  interpreter.SetInputs({});
+  interpreter.SetOutputs({});
+  TfLiteQuantizationParams quant;
+
+  // A 4x8 matrix in 2x4 blocks, of which 3 out of 4 are stored.
+  int row_ptr[] = {0, 2, 3};
+  int col_indices[] = {0, 1, 1};
+  TfLiteBlockSparsity sparsity = {2, 4, row_ptr, col_indices};
+  float blocks[3 * 2 * 4] = {};
+  ASSERT_EQ(interpreter.SetTensorParametersReadOnly(
+                0, kTfLiteFloat32, "", {4, 8}, quant,
+                reinterpret_cast<const char*>(blocks), sizeof(blocks),
+                nullptr, &sparsity),
+            kTfLiteOk);
+  const TfLiteTensor* tensor = interpreter.tensor(0);
+  ASSERT_NE(tensor->sparsity, nullptr);
+  EXPECT_EQ(tensor->sparsity->block_rows, 2);
+  EXPECT_EQ(tensor->sparsity->block_cols, 4);
+  EXPECT_EQ(tensor->sparsity->row_ptr[2], 3);
+  ASSERT_EQ(interpreter.AllocateTensors(), kTfLiteOk);
+
+  // The buffer has to hold exactly the stored blocks.
+  EXPECT_NE(interpreter.SetTensorParametersReadOnly(
+                0, kTfLiteFloat32, "", {4, 8}, quant,
+                reinterpret_cast<const char*>(blocks), sizeof(blocks) / 3 * 2,
+                nullptr, &sparsity),
+            kTfLiteOk);
+  // Blocks have to tile the tensor.
+  TfLiteBlockSparsity bad_shape = {3, 4, row_ptr, col_indices};
+  EXPECT_NE(interpreter.SetTensorParametersReadOnly(
+                0, kTfLiteFloat32, "", {4, 8}, quant,
+                reinterpret_cast<const char*>(blocks), sizeof(blocks),
+                nullptr, &bad_shape),
+            kTfLiteOk);
+  // Column indices have to be in range and increasing within a block row.
+  int bad_col_indices[] = {1, 0, 1};
+  TfLiteBlockSparsity bad_order = {2, 4, row_ptr, bad_col_indices};
+  EXPECT_NE(interpreter.SetTensorParametersReadOnly(
+                0, kTfLiteFloat32, "", {4, 8}, quant,
+                reinterpret_cast<const char*>(blocks), sizeof(blocks),
+                nullptr, &bad_order),
+            kTfLiteOk);
+  int out_of_range[] = {0, 1, 2};
+  TfLiteBlockSparsity bad_range = {2, 4, row_ptr, out_of_range};
+  EXPECT_NE(interpreter.SetTensorParametersReadOnly(
+                0, kTfLiteFloat32, "", {4, 8}, quant,
+                reinterpret_cast<const char*>(blocks), sizeof(blocks),
+                nullptr, &bad_range),
+            kTfLiteOk);
+
+  // Setting dense parameters again drops the sparsity.
+  float dense[4 * 8] = {};
+  ASSERT_EQ(interpreter.SetTensorParametersReadOnly(
+                0, kTfLiteFloat32, "", {4, 8}, quant,
+                reinterpret_cast<const char*>(dense), sizeof(dense)),
+            kTfLiteOk);
+  EXPECT_EQ(interpreter.tensor(0)->sparsity, nullptr);
+}
+
+TEST(BasicInterpreter, CheckBlockSparseConsumers) {
+  // A 4x8 matrix with all of its 2x4 blocks stored.
+  int row_ptr[] = {0, 2, 4};
+  int col_indices[] = {0, 1, 0, 1};
+  TfLiteBlockSparsity sparsity = {2, 4, row_ptr, col_indices};
+  float blocks[4 * 8] = {};
+  TfLiteQuantizationParams quant;
+
+  auto build = [&](Interpreter* interpreter, TfLiteRegistration* reg,
+                   int weights_position) {
+    ASSERT_EQ(interpreter->AddTensors(3), kTfLiteOk);
+    interpreter->SetInputs({0});
+    interpreter->SetOutputs({2});
+    interpreter->SetTensorParametersReadWrite(0, kTfLiteFloat32, "", {1, 8},
+                                              quant);
+    ASSERT_EQ(interpreter->SetTensorParametersReadOnly(
+                  1, kTfLiteFloat32, "", {4, 8}, quant,
+                  reinterpret_cast<const char*>(blocks), sizeof(blocks),
+                  nullptr, &sparsity),
+              kTfLiteOk);
+    interpreter->SetTensorParametersReadWrite(2, kTfLiteFloat32, "", {1, 4},
+                                              quant);
+    std::vector<int> inputs = {0, 0};
+    inputs[weights_position] = 1;
+    ASSERT_EQ(interpreter->AddNodeWithParameters(inputs, {2}, nullptr, 0,
+                                                 nullptr, reg),
+              kTfLiteOk);
+  };
+
+  // Only the weights of ops with block-sparse kernels may be block-sparse.
+  TfLiteRegistration reg = {nullptr, nullptr, nullptr, nullptr};
+  reg.builtin_code = BuiltinOperator_FULLY_CONNECTED;
+  {
+    Interpreter interpreter;
+    build(&interpreter, &reg, 1);
+    EXPECT_EQ(interpreter.AllocateTensors(), kTfLiteOk);
+  }
+  {
+    Interpreter interpreter;
+    build(&interpreter, &reg, 0);
+    EXPECT_NE(interpreter.AllocateTensors(), kTfLiteOk);
+  }
+  reg.builtin_code = BuiltinOperator_ADD;
+  {
+    Interpreter interpreter;
+    build(&interpreter, &reg, 1);
+    EXPECT_NE(interpreter.AllocateTensors(), kTfLiteOk);
+  }
+
+  // Callers read graph outputs as dense data.
+  reg.builtin_code = BuiltinOperator_FULLY_CONNECTED;
+  {
+    Interpreter interpreter;
+    build(&interpreter, &reg, 1);
+    interpreter.SetOutputs({1, 2});
+    EXPECT_NE(interpreter.AllocateTensors(), kTfLiteOk);
+  }
+}
+
 TEST(BasicInterpreter, CheckAlignment) {
   struct {
     TfLiteType type;
@@ -1168,6 +1289,35 @@ TEST_F(TestDelegate, ComplexDeligate) {
             SimpleDelegate::FakeFusedRegistration().custom_name);
 }
 
+TEST_F(TestDelegate, RejectsBlockSparseInputs) {
+  // Make the second input of the last node a block-sparse constant.
+  int row_ptr[] = {0, 1};
+  int col_indices[] = {0};
+  TfLiteBlockSparsity sparsity = {1, 3, row_ptr, col_indices};
+  float block[3] = {};
+  TfLiteQuantizationParams quant;
+  interpreter_->SetInputs({0});
+  ASSERT_EQ(interpreter_->SetTensorParametersReadOnly(
+                1, kTfLiteFloat32, "", {1, 3}, quant,
+                reinterpret_cast<const char*>(block), sizeof(block), nullptr,
+                &sparsity),
+            kTfLiteOk);
+
+  // Dynamic tensors are allowed so that the graph isn't prepared before the
+  // delegate gets to see it.
+  delegate_ = std::unique_ptr<SimpleDelegate>(new SimpleDelegate({0, 1, 2}));
+  interpreter_->ModifyGraphWithDelegate(delegate_->get_tf_lite_delegate(),
+                                        /*allow_dynamic_tensors=*/true);
+
+  // The graph is left as it was, and the custom op can't run either.
+  ASSERT_EQ(interpreter_->execution_plan().size(), 3);
+  for (int node_index : interpreter_->execution_plan()) {
+    EXPECT_EQ(interpreter_->node_and_registration(node_index)->first.delegate,
+              nullptr);
+  }
+  EXPECT_NE(interpreter_->AllocateTensors(), kTfLiteOk);
+}
+
 TEST_F(TestDelegate, SetBufferHandleToInput) {
   delegate_ = std::unique_ptr<SimpleDelegate>(new SimpleDelegate({0, 1, 2}));
   TfLiteDelegate* delegate = delegate_->get_tf_lite_delegate();
@@ -1364,6 +1514,116 @@ TEST(TestDelegateOwnership, ProperlyDisposed) {
   EXPECT_TRUE(destroyed);
 }
 
+TEST(InterOpThreadsTest, InvokesIndependentNodesConcurrently) {
+  Interpreter interpreter;
+  ASSERT_EQ(interpreter.AddTensors(5), kTfLiteOk);
+  ASSERT_EQ(interpreter.SetInputs({0}), kTfLiteOk);
+  ASSERT_EQ(interpreter.SetOutputs({4}), kTfLiteOk);
+  TfLiteQuantizationParams quant;
+  for (int i = 0; i < 5; ++i) {
+    ASSERT_EQ(interpreter.SetTensorParametersReadWrite(i, kTfLiteFloat32, "",
+                                                       {3}, quant),
+              kTfLiteOk);
+  }
+
+  // Node #2 only depends on the input, so it can run alongside node #0.
+  TfLiteRegistration reg = AddOpRegistration();
+  ASSERT_EQ(interpreter.AddNodeWithParameters({0, 0}, {1}, nullptr, 0, nullptr,
+                                              &reg),
+            kTfLiteOk);
+  ASSERT_EQ(interpreter.AddNodeWithParameters({1, 1}, {2}, nullptr, 0, nullptr,
+                                              &reg),
+            kTfLiteOk);
+  ASSERT_EQ(interpreter.AddNodeWithParameters({0, 0}, {3}, nullptr, 0, nullptr,
+                                              &reg),
+            kTfLiteOk);
+  ASSERT_EQ(interpreter.AddNodeWithParameters({2, 3}, {4}, nullptr, 0, nullptr,
+                                              &reg),
+            kTfLiteOk);
+
+  ASSERT_NE(interpreter.SetNumInterOpThreads(0), kTfLiteOk);
+  ASSERT_EQ(interpreter.SetNumInterOpThreads(2), kTfLiteOk);
+  ASSERT_EQ(interpreter.AllocateTensors(), kTfLiteOk);
+  EXPECT_EQ(interpreter.execution_plan(), std::vector<int>({0, 2, 1, 3}));
+
+  // Nodes that may run at the same time must not share memory.
+  const float* input = interpreter.typed_tensor<float>(0);
+  EXPECT_NE(interpreter.typed_tensor<float>(3), input);
+  EXPECT_NE(interpreter.typed_tensor<float>(1),
+            interpreter.typed_tensor<float>(3));
+  EXPECT_NE(interpreter.typed_tensor<float>(2),
+            interpreter.typed_tensor<float>(3));
+
+  for (int run = 0; run < 3; ++run) {
+    float* in = interpreter.typed_tensor<float>(0);
+    for (int i = 0; i < 3; ++i) {
+      in[i] = i + run;
+    }
+    ASSERT_EQ(interpreter.Invoke(), kTfLiteOk);
+    const float* out = interpreter.typed_tensor<float>(4);
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_EQ(out[i], 6 * (i + run));
+    }
+  }
+
+  // Changing the number of threads requires reallocating the tensors.
+  ASSERT_EQ(interpreter.SetNumInterOpThreads(1), kTfLiteOk);
+  ASSERT_NE(interpreter.Invoke(), kTfLiteOk);
+  ASSERT_EQ(interpreter.AllocateTensors(), kTfLiteOk);
+  interpreter.typed_tensor<float>(0)[0] = 1;
+  ASSERT_EQ(interpreter.Invoke(), kTfLiteOk);
+  EXPECT_EQ(interpreter.typed_tensor<float>(4)[0], 6);
+}
+
+void BuildArenaTestGraph(Interpreter* interpreter) {
+  ASSERT_EQ(interpreter->AddTensors(10), kTfLiteOk);
+  TfLiteQuantizationParams quant;
+  TfLiteRegistration reg = {nullptr, nullptr, nullptr, nullptr};
+  std::vector<int> sizes{2048, 4096, 1023, 2047, 1021,
+                         2047, 1023, 2046, 0,    2048};
+  for (int i = 0; i < sizes.size(); ++i) {
+    interpreter->SetTensorParametersReadWrite(i, kTfLiteUInt8, "", {sizes[i]},
+                                              quant);
+  }
+  interpreter->SetInputs({0, 1});
+  interpreter->SetOutputs({9, 4});
+  interpreter->AddNodeWithParameters({0, 1}, {2, 3}, nullptr, 0, nullptr, &reg);
+  interpreter->AddNodeWithParameters({2, 1}, {4, 5}, nullptr, 0, nullptr, &reg);
+  interpreter->AddNodeWithParameters({4, 3}, {6, 7}, nullptr, 0, nullptr, &reg);
+  interpreter->AddNodeWithParameters({6, 5}, {8}, nullptr, 0, nullptr, &reg);
+  interpreter->AddNodeWithParameters({8, 7}, {9}, nullptr, 0, nullptr, &reg);
+}
+
+TEST(OfflineMemoryPlanTest, CreateAndUsePlan) {
+  Interpreter planning_interpreter;
+  BuildArenaTestGraph(&planning_interpreter);
+  OfflineMemoryPlan plan;
+  ASSERT_NE(planning_interpreter.CreateOfflineMemoryPlan(&plan), kTfLiteOk);
+  ASSERT_EQ(planning_interpreter.AllocateTensors(), kTfLiteOk);
+  ASSERT_EQ(planning_interpreter.CreateOfflineMemoryPlan(&plan), kTfLiteOk);
+  ASSERT_EQ(plan.offsets.size(), 10);
+  EXPECT_EQ(plan.offsets[8], -1);
+
+  Interpreter interpreter;
+  BuildArenaTestGraph(&interpreter);
+  interpreter.SetOfflineMemoryPlan(
+      std::unique_ptr<OfflineMemoryPlan>(new OfflineMemoryPlan(plan)));
+  ASSERT_EQ(interpreter.AllocateTensors(), kTfLiteOk);
+  const char* base = interpreter.tensor(0)->data.raw - plan.offsets[0];
+  for (int i = 0; i < 10; ++i) {
+    if (plan.offsets[i] < 0) {
+      EXPECT_EQ(interpreter.tensor(i)->data.raw, nullptr);
+    } else {
+      EXPECT_EQ(interpreter.tensor(i)->data.raw - base, plan.offsets[i]);
+    }
+  }
+
+  // The plan no longer fits once an input grows, and is ignored.
+  ASSERT_EQ(interpreter.ResizeInputTensor(0, {8192}), kTfLiteOk);
+  ASSERT_EQ(interpreter.AllocateTensors(), kTfLiteOk);
+  EXPECT_EQ(interpreter.tensor(0)->bytes, 8192);
+}
+
 }  // namespace
 }  // namespace tflite
 
@@ -19,6 +19,7 @@ limitations under the License.
 #include <cstdlib>
 #include <iostream>
 #include <limits>
+#include <vector>
 
 #include "tensorflow/contrib/lite/c/builtin_op_data.h"
 #include "tensorflow/contrib/lite/c/c_api_internal.h"
@@ -27,6 +28,7 @@ limitations under the License.
 #include "tensorflow/contrib/lite/kernels/internal/optimized/cblas_conv.h"
 #include "tensorflow/contrib/lite/kernels/internal/optimized/multithreaded_conv.h"
 #include "tensorflow/contrib/lite/kernels/internal/optimized/optimized_ops.h"
+#include "tensorflow/contrib/lite/kernels/internal/optimized/sparse_ops.h"
 #include "tensorflow/contrib/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/contrib/lite/kernels/internal/reference/reference_ops.h"
 #include "tensorflow/contrib/lite/kernels/internal/tensor.h"
@@ -84,6 +86,10 @@ struct OpData {
   bool need_im2col;
 
   bool run_multithreaded_kernel;
+
+  // For block-sparse filters, where each stored block applies in the filter
+  // window.
+  std::vector<optimized_ops::SparseConvBlockIndex> sparse_block_indices;
 };
 
 inline PaddingType RuntimePaddingType(TfLitePadding padding) {
@@ -144,6 +150,8 @@ static TfLiteStatus AllocateTemporaryTensorsIfRequired(TfLiteContext* context,
 
   const bool is_hybrid =
       (input->type == kTfLiteFloat32 && filter->type == kTfLiteUInt8);
+  // The sparse kernel reads the input in place.
+  const bool is_sparse = filter->sparsity != nullptr;
 
   int filter_width = filter->dims->data[2];
   int filter_height = filter->dims->data[1];
@@ -152,6 +160,7 @@ static TfLiteStatus AllocateTemporaryTensorsIfRequired(TfLiteContext* context,
   // of the optimized Conv. This test just mimics something that happens inside
   // optimized_ops.h, in order to avoid a DCHECK(!im2col_data).
   data->need_im2col =
+      !is_sparse &&
       (params->stride_width != 1 || params->stride_height != 1 ||
        params->dilation_width_factor != 1 ||
        params->dilation_height_factor != 1 || filter_width != 1 ||
@@ -166,7 +175,8 @@ static TfLiteStatus AllocateTemporaryTensorsIfRequired(TfLiteContext* context,
   // This path is only used for float processing, so only create the buffer if
   // we're running with that data type.
   data->need_hwcn_weights = (input->type == kTfLiteFloat32 &&
-                             data->run_multithreaded_kernel && !is_hybrid);
+                             data->run_multithreaded_kernel && !is_hybrid &&
+                             !is_sparse);
 
   int temporaries_count = 0;
   if (data->need_im2col) {
@@ -253,6 +263,19 @@ TfLiteStatus Prepare(TfLiteContext* context, TfLiteNode* node) {
   const bool is_hybrid =
       (input->type == kTfLiteFloat32 && filter->type == kTfLiteUInt8);
 
+  if (filter->sparsity) {
+    // Blocks must not span two filter positions, and hybrid sparse kernels
+    // aren't implemented.
+    TF_LITE_ENSURE_EQ(context, filter->type, input_type);
+    TF_LITE_ENSURE(context, filter->sparsity->block_rows <=
+                                optimized_ops::kMaxSparseBlockRows);
+    TF_LITE_ENSURE_EQ(context,
+                      filter->dims->data[3] % filter->sparsity->block_cols, 0);
+    optimized_ops::GetSparseConvBlockIndices(GetTensorShape(filter),
+                                             *filter->sparsity,
+                                             &data->sparse_block_indices);
+  }
+
   data->run_multithreaded_kernel = context->recommended_num_threads != 1;
   // Hybrid kernels don't support multithreading yet.
   if (is_hybrid) {
@@ -409,7 +432,8 @@ void EvalQuantized(TfLiteContext* context, TfLiteNode* node,
                    TfLiteTensor* filter, TfLiteTensor* bias,
                    TfLiteTensor* im2col, TfLiteTensor* hwcn_weights,
                    TfLiteTensor* output) {
-  gemmlowp::GemmContext* gemm_context = gemm_support::GetFromContext(context);
+  gemm_support::ScopedGemmContext scoped_gemm_context(context);
+  gemmlowp::GemmContext* gemm_context = scoped_gemm_context.get();
 
   auto input_offset = -input->params.zero_point;
   auto filter_offset = -filter->params.zero_point;
@@ -621,6 +645,53 @@ void EvalHybrid(TfLiteContext* context, TfLiteNode* node,
   }
 }
 
+TfLiteStatus EvalSparse(TfLiteContext* context, TfLiteConvParams* params,
+                        OpData* data, TfLiteTensor* input,
+                        TfLiteTensor* filter, TfLiteTensor* bias,
+                        TfLiteTensor* output) {
+  ConvParams op_params;
+  op_params.padding_type = PaddingType::kSame;
+  op_params.padding_values.width = data->padding.width;
+  op_params.padding_values.height = data->padding.height;
+  op_params.stride_width = params->stride_width;
+  op_params.stride_height = params->stride_height;
+  op_params.dilation_width_factor = params->dilation_width_factor;
+  op_params.dilation_height_factor = params->dilation_height_factor;
+  switch (input->type) {
+    case kTfLiteFloat32:
+      CalculateActivationRange(params->activation,
+                               &op_params.float_activation_min,
+                               &op_params.float_activation_max);
+      optimized_ops::SparseConv(
+          op_params, GetTensorShape(input), GetTensorData<float>(input),
+          GetTensorShape(filter), GetTensorData<float>(filter),
+          *filter->sparsity, data->sparse_block_indices.data(),
+          GetTensorShape(bias), GetTensorData<float>(bias),
+          GetTensorShape(output), GetTensorData<float>(output));
+      break;
+    case kTfLiteUInt8:
+      op_params.input_offset = -input->params.zero_point;
+      op_params.weights_offset = -filter->params.zero_point;
+      op_params.output_offset = output->params.zero_point;
+      op_params.output_multiplier = data->output_multiplier;
+      op_params.output_shift = -data->output_shift;
+      op_params.quantized_activation_min = data->output_activation_min;
+      op_params.quantized_activation_max = data->output_activation_max;
+      optimized_ops::SparseConv(
+          op_params, GetTensorShape(input), GetTensorData<uint8_t>(input),
+          GetTensorShape(filter), GetTensorData<uint8_t>(filter),
+          *filter->sparsity, data->sparse_block_indices.data(),
+          GetTensorShape(bias), GetTensorData<int32_t>(bias),
+          GetTensorShape(output), GetTensorData<uint8_t>(output));
+      break;
+    default:
+      context->ReportError(context, "Type %d not currently supported.",
+                           input->type);
+      return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
 template <KernelType kernel_type>
 TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
   auto* params = reinterpret_cast<TfLiteConvParams*>(node->builtin_data);
@@ -641,6 +712,10 @@ TfLiteStatus Eval(TfLiteContext* context, TfLiteNode* node) {
           ? &context->tensors[node->temporaries->data[data->hwcn_weights_index]]
           : nullptr;
 
+  if (filter->sparsity) {
+    return EvalSparse(context, params, data, input, filter, bias, output);
+  }
+
   if (data->need_hwcn_weights && !data->have_weights_been_transposed) {
     TransposeFloatTensor(filter, hwcn_weights);
     data->have_weights_been_transposed = true;
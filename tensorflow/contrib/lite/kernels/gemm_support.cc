@@ -24,6 +24,7 @@ namespace {
 
 struct RefCountedGemmContext : public TfLiteExternalContext {
   std::unique_ptr<gemmlowp::GemmContext> gemm_context;
+  std::mutex mutex;
   int num_references = 0;
 };
 
@@ -80,5 +81,16 @@ gemmlowp::GemmContext* GetFromContext(TfLiteContext* context) {
   return ptr->gemm_context.get();
 }
 
+ScopedGemmContext::ScopedGemmContext(TfLiteContext* context) {
+  auto* ptr = GetGemmLowpContext(context);
+  if (ptr == nullptr) {
+    TF_LITE_FATAL(
+        "Construction of ScopedGemmContext not preceded by "
+        "IncrementUsageCounter()");
+  }
+  lock_ = std::unique_lock<std::mutex>(ptr->mutex);
+  gemm_context_ = ptr->gemm_context.get();
+}
+
 }  // namespace gemm_support
 }  // namespace tflite
@@ -0,0 +1,118 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CONTRIB_LITE_KERNELS_INTERNAL_OPTIMIZED_AVX2_FIXEDPOINT_H_
+#define TENSORFLOW_CONTRIB_LITE_KERNELS_INTERNAL_OPTIMIZED_AVX2_FIXEDPOINT_H_
+
+#include <limits>
+
+#include "tensorflow/contrib/lite/kernels/internal/optimized/cpu_check.h"
+#include "tensorflow/contrib/lite/kernels/internal/types.h"
+
+#ifdef TFLITE_AVX2_DISPATCH
+
+#include <immintrin.h>
+
+namespace tflite {
+namespace optimized_ops {
+
+// AVX2 counterparts of the gemmlowp fixed-point helpers used by the quantized
+// kernels, operating on 8 int32 lanes. They return bit-exact results, so
+// kernels can mix them freely with the scalar versions for leftovers. They
+// must only be called after TestCPUFeatureAvx2() returned true.
+
+// gemmlowp::SaturatingRoundingDoublingHighMul().
+TFLITE_AVX2_TARGET inline __m256i SaturatingRoundingDoublingHighMulAvx2(
+    __m256i a, __m256i b) {
+  // The 64-bit products of the even and of the odd lanes.
+  const __m256i even_products = _mm256_mul_epi32(a, b);
+  const __m256i odd_products =
+      _mm256_mul_epi32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+  // gemmlowp nudges the product by 2^30 or 1 - 2^30 depending on its sign and
+  // then divides by 2^31 rounding towards zero. Both together amount to adding
+  // 2^30 and shifting right by 31, and only the low 32 bits of the result are
+  // kept, which a logical shift gets right for negative products too.
+  const __m256i nudge = _mm256_set1_epi64x(1ll << 30);
+  const __m256i even_high =
+      _mm256_srli_epi64(_mm256_add_epi64(even_products, nudge), 31);
+  const __m256i odd_high =
+      _mm256_slli_epi64(_mm256_add_epi64(odd_products, nudge), 1);
+  const __m256i result = _mm256_blend_epi32(even_high, odd_high, 0xAA);
+  // The only case that overflows is a == b == INT32_MIN.
+  const __m256i min = _mm256_set1_epi32(std::numeric_limits<int32>::min());
+  const __m256i overflow =
+      _mm256_and_si256(_mm256_cmpeq_epi32(a, min), _mm256_cmpeq_epi32(b, min));
+  return _mm256_blendv_epi8(
+      result, _mm256_set1_epi32(std::numeric_limits<int32>::max()), overflow);
+}
+
+// gemmlowp::RoundingDivideByPOT().
+TFLITE_AVX2_TARGET inline __m256i RoundingDivideByPOTAvx2(__m256i x,
+                                                          int exponent) {
+  const __m256i mask = _mm256_set1_epi32((1ll << exponent) - 1);
+  const __m256i one = _mm256_set1_epi32(1);
+  const __m256i remainder = _mm256_and_si256(x, mask);
+  const __m256i threshold =
+      _mm256_add_epi32(_mm256_srai_epi32(mask, 1),
+                       _mm256_and_si256(_mm256_srai_epi32(x, 31), one));
+  const __m256i round_up =
+      _mm256_and_si256(_mm256_cmpgt_epi32(remainder, threshold), one);
+  return _mm256_add_epi32(
+      _mm256_sra_epi32(x, _mm_cvtsi32_si128(exponent)), round_up);
+}
+
+// MultiplyByQuantizedMultiplier() from common.h.
+TFLITE_AVX2_TARGET inline __m256i MultiplyByQuantizedMultiplierAvx2(
+    __m256i x, int32 quantized_multiplier, int shift) {
+  const int left_shift = shift > 0 ? shift : 0;
+  const int right_shift = shift > 0 ? 0 : -shift;
+  return RoundingDivideByPOTAvx2(
+      SaturatingRoundingDoublingHighMulAvx2(
+          _mm256_sll_epi32(x, _mm_cvtsi32_si128(left_shift)),
+          _mm256_set1_epi32(quantized_multiplier)),
+      right_shift);
+}
+
+// MultiplyByQuantizedMultiplierSmallerThanOneExp() from common.h.
+TFLITE_AVX2_TARGET inline __m256i
+MultiplyByQuantizedMultiplierSmallerThanOneExpAvx2(__m256i x,
+                                                   int32 quantized_multiplier,
+                                                   int left_shift) {
+  return RoundingDivideByPOTAvx2(
+      SaturatingRoundingDoublingHighMulAvx2(
+          x, _mm256_set1_epi32(quantized_multiplier)),
+      -left_shift);
+}
+
+// Loads 8 uint8 values widened to int32.
+TFLITE_AVX2_TARGET inline __m256i LoadUint8x8Avx2(const uint8* data) {
+  return _mm256_cvtepu8_epi32(
+      _mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)));
+}
+
+// Stores 8 int32 values with unsigned saturation to uint8.
+TFLITE_AVX2_TARGET inline void SaturatingStoreUint8x8Avx2(__m256i values,
+                                                          uint8* data) {
+  const __m128i values_16 = _mm_packs_epi32(
+      _mm256_castsi256_si128(values), _mm256_extracti128_si256(values, 1));
+  _mm_storel_epi64(reinterpret_cast<__m128i*>(data),
+                   _mm_packus_epi16(values_16, values_16));
+}
+
+}  // namespace optimized_ops
+}  // namespace tflite
+
+#endif  // TFLITE_AVX2_DISPATCH
+
+#endif  // TENSORFLOW_CONTRIB_LITE_KERNELS_INTERNAL_OPTIMIZED_AVX2_FIXEDPOINT_H_
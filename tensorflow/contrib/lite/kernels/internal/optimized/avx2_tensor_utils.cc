@@ -0,0 +1,368 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+
+#include "tensorflow/contrib/lite/kernels/internal/optimized/cpu_check.h"
+#include "tensorflow/contrib/lite/kernels/internal/optimized/tensor_utils_impl.h"
+#include "tensorflow/contrib/lite/kernels/internal/round.h"
+
+#ifdef TFLITE_AVX2_DISPATCH
+
+#include <immintrin.h>
+
+// Every function in this file is compiled for AVX2 through a target
+// attribute, and must only be called after TestCPUFeatureAvx2() returned true.
+// Only the float dot products are also compiled for FMA: elsewhere the
+// compiler would contract multiplies and adds, and the results would no longer
+// match the portable kernels exactly.
+
+#define kFloatValuesPerAvx2Vector 8
+
+namespace tflite {
+namespace tensor_utils {
+namespace {
+
+TFLITE_AVX2_TARGET inline float HorizontalSum(__m256 v) {
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v),
+                          _mm256_extractf128_ps(v, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+  return _mm_cvtss_f32(sum);
+}
+
+TFLITE_AVX2_TARGET inline int32_t HorizontalSum(__m256i v) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(v),
+                              _mm256_extracti128_si256(v, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+  return _mm_cvtsi128_si32(sum);
+}
+
+// Dot product of two float vectors, with two independent accumulators to
+// hide the latency of the FMA.
+TFLITE_AVX2_FMA_TARGET inline float DotProduct(const float* vector1,
+                                               const float* vector2,
+                                               int v_size) {
+  __m256 acc0 = _mm256_setzero_ps();
+  __m256 acc1 = _mm256_setzero_ps();
+  int v = 0;
+  for (; v <= v_size - 2 * kFloatValuesPerAvx2Vector;
+       v += 2 * kFloatValuesPerAvx2Vector) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(vector1 + v),
+                           _mm256_loadu_ps(vector2 + v), acc0);
+    acc1 = _mm256_fmadd_ps(
+        _mm256_loadu_ps(vector1 + v + kFloatValuesPerAvx2Vector),
+        _mm256_loadu_ps(vector2 + v + kFloatValuesPerAvx2Vector), acc1);
+  }
+  for (; v <= v_size - kFloatValuesPerAvx2Vector;
+       v += kFloatValuesPerAvx2Vector) {
+    acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(vector1 + v),
+                           _mm256_loadu_ps(vector2 + v), acc0);
+  }
+  float result = HorizontalSum(_mm256_add_ps(acc0, acc1));
+  for (; v < v_size; v++) {
+    result += vector1[v] * vector2[v];
+  }
+  return result;
+}
+
+// Dot product of two int8 vectors. The products are widened to 16 bits and
+// pairwise summed into 32 bits, which can't overflow for int8 inputs.
+TFLITE_AVX2_TARGET inline int32_t DotProduct(const int8_t* vector1,
+                                             const int8_t* vector2,
+                                             int v_size) {
+  __m256i acc = _mm256_setzero_si256();
+  int v = 0;
+  for (; v <= v_size - 16; v += 16) {
+    const __m256i x = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(vector1 + v)));
+    const __m256i y = _mm256_cvtepi8_epi16(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(vector2 + v)));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(x, y));
+  }
+  int32_t result = HorizontalSum(acc);
+  for (; v < v_size; v++) {
+    result += vector1[v] * vector2[v];
+  }
+  return result;
+}
+
+}  // namespace
+
+TFLITE_AVX2_FMA_TARGET void Avx2MatrixBatchVectorMultiplyAccumulate(
+    const float* matrix, int m_rows, int m_cols, const float* vector,
+    int n_batch, float* result, int result_stride) {
+  float* result_in_batch = result;
+  for (int b = 0; b < n_batch; b++) {
+    const float* vector_in_batch = vector + b * m_cols;
+    const float* matrix_ptr = matrix;
+    for (int r = 0; r < m_rows; r++) {
+      *result_in_batch += DotProduct(matrix_ptr, vector_in_batch, m_cols);
+      matrix_ptr += m_cols;
+      result_in_batch += result_stride;
+    }
+  }
+}
+
+TFLITE_AVX2_TARGET void Avx2MatrixBatchVectorMultiplyAccumulate(
+    const int8_t* __restrict__ matrix, const int m_rows, const int m_cols,
+    const int8_t* __restrict__ vectors, const float* scaling_factors,
+    int n_batch, float* __restrict__ result, int result_stride) {
+  for (int batch = 0; batch < n_batch; ++batch, vectors += m_cols) {
+    const float batch_scaling_factor = scaling_factors[batch];
+    const int8_t* row_ptr = matrix;
+    for (int row = 0; row < m_rows; ++row, result += result_stride) {
+      const int32_t dotprod = DotProduct(row_ptr, vectors, m_cols);
+      *result += dotprod * batch_scaling_factor;
+      row_ptr += m_cols;
+    }
+  }
+}
+
+TFLITE_AVX2_TARGET void Avx2VectorVectorCwiseProduct(const float* vector1,
+                                                     const float* vector2,
+                                                     int v_size,
+                                                     float* result) {
+  int v = 0;
+  for (; v <= v_size - kFloatValuesPerAvx2Vector;
+       v += kFloatValuesPerAvx2Vector) {
+    _mm256_storeu_ps(result + v, _mm256_mul_ps(_mm256_loadu_ps(vector1 + v),
+                                               _mm256_loadu_ps(vector2 + v)));
+  }
+  for (; v < v_size; v++) {
+    result[v] = vector1[v] * vector2[v];
+  }
+}
+
+TFLITE_AVX2_TARGET void Avx2VectorVectorCwiseProductAccumulate(
+    const float* vector1, const float* vector2, int v_size, float* result) {
+  // Not fused, so that the results are the same as the portable kernel's.
+  int v = 0;
+  for (; v <= v_size - kFloatValuesPerAvx2Vector;
+       v += kFloatValuesPerAvx2Vector) {
+    const __m256 product = _mm256_mul_ps(_mm256_loadu_ps(vector1 + v),
+                                         _mm256_loadu_ps(vector2 + v));
+    _mm256_storeu_ps(result + v,
+                     _mm256_add_ps(_mm256_loadu_ps(result + v), product));
+  }
+  for (; v < v_size; v++) {
+    result[v] += vector1[v] * vector2[v];
+  }
+}
+
+TFLITE_AVX2_FMA_TARGET float Avx2VectorVectorDotProduct(
+    const float* vector1, const float* vector2, int v_size) {
+  return DotProduct(vector1, vector2, v_size);
+}
+
+TFLITE_AVX2_FMA_TARGET void Avx2BatchVectorBatchVectorDotProduct(
+    const float* vector1, const float* vector2, int v_size, int n_batch,
+    float* result, int result_stride) {
+  for (int b = 0; b < n_batch; b++) {
+    *result = DotProduct(vector1, vector2, v_size);
+    vector1 += v_size;
+    vector2 += v_size;
+    result += result_stride;
+  }
+}
+
+TFLITE_AVX2_TARGET void Avx2VectorBatchVectorCwiseProduct(
+    const float* vector, int v_size, const float* batch_vector, int n_batch,
+    float* result) {
+  for (int b = 0; b < n_batch; b++) {
+    Avx2VectorVectorCwiseProduct(vector, batch_vector, v_size, result);
+    batch_vector += v_size;
+    result += v_size;
+  }
+}
+
+TFLITE_AVX2_TARGET void Avx2VectorBatchVectorCwiseProductAccumulate(
+    const float* vector, int v_size, const float* batch_vector, int n_batch,
+    float* result) {
+  for (int b = 0; b < n_batch; b++) {
+    Avx2VectorVectorCwiseProductAccumulate(vector, batch_vector, v_size,
+                                           result);
+    batch_vector += v_size;
+    result += v_size;
+  }
+}
+
+TFLITE_AVX2_TARGET void Avx2Sub1Vector(const float* vector, int v_size,
+                                       float* result) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  int v = 0;
+  for (; v <= v_size - kFloatValuesPerAvx2Vector;
+       v += kFloatValuesPerAvx2Vector) {
+    _mm256_storeu_ps(result + v,
+                     _mm256_sub_ps(one, _mm256_loadu_ps(vector + v)));
+  }
+  for (; v < v_size; v++) {
+    result[v] = 1.0f - vector[v];
+  }
+}
+
+TFLITE_AVX2_TARGET void Avx2ClipVector(const float* vector, int v_size,
+                                       float abs_limit, float* result) {
+  // The operand order matches PortableClip(), so that NaNs are kept.
+  const __m256 pos_limit = _mm256_set1_ps(abs_limit);
+  const __m256 neg_limit = _mm256_set1_ps(-abs_limit);
+  int v = 0;
+  for (; v <= v_size - kFloatValuesPerAvx2Vector;
+       v += kFloatValuesPerAvx2Vector) {
+    const __m256 clipped_max =
+        _mm256_min_ps(pos_limit, _mm256_loadu_ps(vector + v));
+    _mm256_storeu_ps(result + v, _mm256_max_ps(neg_limit, clipped_max));
+  }
+  for (; v < v_size; v++) {
+    result[v] = PortableClip(vector[v], abs_limit);
+  }
+}
+
+TFLITE_AVX2_TARGET void Avx2VectorScalarMultiply(const int8_t* vector,
+                                                 int v_size, float scale,
+                                                 float* result) {
+  const __m256 scale_vector = _mm256_set1_ps(scale);
+  int v = 0;
+  for (; v <= v_size - kFloatValuesPerAvx2Vector;
+       v += kFloatValuesPerAvx2Vector) {
+    const __m256i values = _mm256_cvtepi8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(vector + v)));
+    _mm256_storeu_ps(result + v, _mm256_mul_ps(scale_vector,
+                                               _mm256_cvtepi32_ps(values)));
+  }
+  for (; v < v_size; v++) {
+    result[v] = scale * vector[v];
+  }
+}
+
+TFLITE_AVX2_TARGET bool Avx2IsZeroVector(const float* vector, int v_size) {
+  const __m256 zero = _mm256_setzero_ps();
+  int v = 0;
+  for (; v <= v_size - kFloatValuesPerAvx2Vector;
+       v += kFloatValuesPerAvx2Vector) {
+    const __m256 not_zero =
+        _mm256_cmp_ps(_mm256_loadu_ps(vector + v), zero, _CMP_NEQ_UQ);
+    if (_mm256_movemask_ps(not_zero) != 0) return false;
+  }
+  for (; v < v_size; v++) {
+    if (vector[v] != 0.0f) return false;
+  }
+  return true;
+}
+
+TFLITE_AVX2_TARGET void Avx2SymmetricQuantizeFloats(
+    const float* values, const int size, int8_t* quantized_values,
+    float* min_value, float* max_value, float* scaling_factor) {
+  if (size < kFloatValuesPerAvx2Vector) {
+    PortableSymmetricQuantizeFloats(values, size, quantized_values, min_value,
+                                    max_value, scaling_factor);
+    return;
+  }
+
+  __m256 min_vector = _mm256_loadu_ps(values);
+  __m256 max_vector = min_vector;
+  int i = kFloatValuesPerAvx2Vector;
+  for (; i <= size - kFloatValuesPerAvx2Vector;
+       i += kFloatValuesPerAvx2Vector) {
+    const __m256 v = _mm256_loadu_ps(values + i);
+    min_vector = _mm256_min_ps(min_vector, v);
+    max_vector = _mm256_max_ps(max_vector, v);
+  }
+  float mins[kFloatValuesPerAvx2Vector];
+  float maxs[kFloatValuesPerAvx2Vector];
+  _mm256_storeu_ps(mins, min_vector);
+  _mm256_storeu_ps(maxs, max_vector);
+  *min_value = *std::min_element(mins, mins + kFloatValuesPerAvx2Vector);
+  *max_value = *std::max_element(maxs, maxs + kFloatValuesPerAvx2Vector);
+  for (; i < size; ++i) {
+    *min_value = std::min(*min_value, values[i]);
+    *max_value = std::max(*max_value, values[i]);
+  }
+
+  const int kScale = 127;
+  const float range = std::max(std::abs(*min_value), std::abs(*max_value));
+  if (range == 0) {
+    memset(quantized_values, 0, size * sizeof(int8_t));
+    *scaling_factor = 1;
+    return;
+  }
+  *scaling_factor = range / kScale;
+  const float scaling_factor_inv = kScale / range;
+
+  // TfLiteRound() rounds halfway cases away from zero, which none of the AVX
+  // rounding modes do, so round towards zero and then fix up the halfway and
+  // larger remainders. Both steps are exact at this magnitude.
+  const __m256 scale_vector = _mm256_set1_ps(scaling_factor_inv);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 sign_mask = _mm256_set1_ps(-0.0f);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256i max_quantized = _mm256_set1_epi32(kScale);
+  const __m256i min_quantized = _mm256_set1_epi32(-kScale);
+  i = 0;
+  for (; i <= size - kFloatValuesPerAvx2Vector;
+       i += kFloatValuesPerAvx2Vector) {
+    const __m256 scaled =
+        _mm256_mul_ps(_mm256_loadu_ps(values + i), scale_vector);
+    const __m256 truncated =
+        _mm256_round_ps(scaled, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    const __m256 remainder = _mm256_sub_ps(scaled, truncated);
+    const __m256 round_away = _mm256_cmp_ps(
+        _mm256_andnot_ps(sign_mask, remainder), half, _CMP_GE_OQ);
+    const __m256 away_step =
+        _mm256_or_ps(_mm256_and_ps(scaled, sign_mask), one);
+    const __m256 rounded = _mm256_add_ps(
+        truncated, _mm256_and_ps(round_away, away_step));
+    __m256i quantized = _mm256_cvttps_epi32(rounded);
+    quantized = _mm256_min_epi32(max_quantized,
+                                 _mm256_max_epi32(min_quantized, quantized));
+    const __m128i quantized_16 =
+        _mm_packs_epi32(_mm256_castsi256_si128(quantized),
+                        _mm256_extracti128_si256(quantized, 1));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(quantized_values + i),
+                     _mm_packs_epi16(quantized_16, quantized_16));
+  }
+  for (; i < size; ++i) {
+    const int32_t quantized_value =
+        static_cast<int32_t>(TfLiteRound(values[i] * scaling_factor_inv));
+    quantized_values[i] = std::min(kScale, std::max(-kScale, quantized_value));
+  }
+}
+
+TFLITE_AVX2_TARGET void Avx2ReductionSumVector(const float* input_vector,
+                                               float* output_vector,
+                                               int output_size,
+                                               int reduction_size) {
+  for (int o = 0; o < output_size; o++) {
+    __m256 acc = _mm256_setzero_ps();
+    int r = 0;
+    for (; r <= reduction_size - kFloatValuesPerAvx2Vector;
+         r += kFloatValuesPerAvx2Vector) {
+      acc = _mm256_add_ps(acc, _mm256_loadu_ps(input_vector + r));
+    }
+    float sum = HorizontalSum(acc);
+    for (; r < reduction_size; r++) {
+      sum += input_vector[r];
+    }
+    output_vector[o] += sum;
+    input_vector += reduction_size;
+  }
+}
+
+}  // namespace tensor_utils
+}  // namespace tflite
+
+#endif  // TFLITE_AVX2_DISPATCH
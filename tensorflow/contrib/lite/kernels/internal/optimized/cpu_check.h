@@ -44,6 +44,28 @@ inline bool TestCPUFeatureNeon() { return false; }
 
 #endif
 
+// x86 builds compile AVX2 kernels alongside the portable ones, using function
+// attributes rather than global compiler flags, and pick one or the other at
+// runtime. MSVC has no equivalent of the target attribute.
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__)) && !defined(TFLITE_NO_AVX2)
+#define TFLITE_AVX2_DISPATCH
+#define TFLITE_AVX2_TARGET __attribute__((target("avx2")))
+#define TFLITE_AVX2_FMA_TARGET __attribute__((target("avx2,fma")))
+
+// Runtime check for AVX2 and FMA support.
+inline bool TestCPUFeatureAvx2() {
+  static const bool kUseAvx2 =
+      __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return kUseAvx2;
+}
+
+#else
+
+inline bool TestCPUFeatureAvx2() { return false; }
+
+#endif
+
 }  // namespace tflite
 
 // NEON_OR_PORTABLE(SomeFunc, arcs) calls NeonSomeFunc(args) if Neon is both
@@ -58,4 +80,15 @@ inline bool TestCPUFeatureNeon() { return false; }
                        : Portable##funcname(__VA_ARGS__)
 #endif
 
+// AVX2_OR_PORTABLE(SomeFunc, args) calls Avx2SomeFunc(args) if the AVX2
+// kernels are built and AVX2 is detected at runtime, or PortableSomeFunc(args)
+// otherwise.
+#ifdef TFLITE_AVX2_DISPATCH
+#define AVX2_OR_PORTABLE(funcname, ...)              \
+  TestCPUFeatureAvx2() ? Avx2##funcname(__VA_ARGS__) \
+                       : Portable##funcname(__VA_ARGS__)
+#else
+#define AVX2_OR_PORTABLE(funcname, ...) Portable##funcname(__VA_ARGS__)
+#endif
+
 #endif  // TENSORFLOW_CONTRIB_LITE_KERNELS_INTERNAL_OPTIMIZED_CPU_CHECK_H_
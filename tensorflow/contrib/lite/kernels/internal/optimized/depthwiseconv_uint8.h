@@ -18,6 +18,8 @@ limitations under the License.
 #include "fixedpoint/fixedpoint.h"
 #include "public/gemmlowp.h"
 #include "tensorflow/contrib/lite/kernels/internal/common.h"
+#include "tensorflow/contrib/lite/kernels/internal/optimized/avx2_fixedpoint.h"
+#include "tensorflow/contrib/lite/kernels/internal/optimized/cpu_check.h"
 #include "tensorflow/contrib/lite/kernels/internal/optimized/depthwiseconv_uint8_3x3_filter.h"
 #include "tensorflow/contrib/lite/kernels/internal/types.h"
 
@@ -1577,6 +1579,87 @@ inline void QuantizedDepthwiseConvAccumRowGeneric(
   }
 }
 
+#ifdef TFLITE_AVX2_DISPATCH
+// AVX2 variant of QuantizedDepthwiseConvAccumRowGeneric for a depth
+// multiplier of 1, handling 8 channels at a time. Any stride and dilation
+// factor is supported.
+TFLITE_AVX2_TARGET inline void QuantizedDepthwiseConvAccumRowAvx2(
+    int stride, int dilation_factor, int input_depth, int input_width,
+    const uint8* input_data, int16 input_offset, int pad_width,
+    int depth_multiplier, int filter_width, const uint8* filter_data,
+    int16 filter_offset, int out_x_buffer_start, int out_x_buffer_end,
+    int output_depth, int32* acc_buffer) {
+  gemmlowp::ScopedProfilingLabel label("DepthwiseConvAccumRowAvx2");
+  TFLITE_DCHECK_EQ(depth_multiplier, 1);
+  TFLITE_DCHECK_EQ(output_depth, input_depth);
+  const __m256i input_offset_vec = _mm256_set1_epi32(input_offset);
+  const __m256i filter_offset_vec = _mm256_set1_epi32(filter_offset);
+  const uint8* filter_base_ptr = filter_data;
+  for (int filter_x = 0; filter_x < filter_width; ++filter_x) {
+    const int out_x_loop_start = std::max(
+        out_x_buffer_start,
+        (pad_width - dilation_factor * filter_x + stride - 1) / stride);
+    const int out_x_loop_end = std::min(
+        out_x_buffer_end,
+        (pad_width + input_width - dilation_factor * filter_x + stride - 1) /
+            stride);
+
+    int32* acc_buffer_ptr =
+        acc_buffer + (out_x_loop_start - out_x_buffer_start) * output_depth;
+    const int in_x_origin =
+        (out_x_loop_start * stride) - pad_width + dilation_factor * filter_x;
+    const uint8* input_ptr = input_data + in_x_origin * input_depth;
+    for (int out_x = out_x_loop_start; out_x < out_x_loop_end; out_x++) {
+      int ic = 0;
+      for (; ic <= input_depth - 8; ic += 8) {
+        const __m256i input_val =
+            _mm256_add_epi32(LoadUint8x8Avx2(input_ptr + ic), input_offset_vec);
+        const __m256i filter_val = _mm256_add_epi32(
+            LoadUint8x8Avx2(filter_base_ptr + ic), filter_offset_vec);
+        __m256i* acc_ptr = reinterpret_cast<__m256i*>(acc_buffer_ptr + ic);
+        _mm256_storeu_si256(
+            acc_ptr, _mm256_add_epi32(_mm256_loadu_si256(acc_ptr),
+                                      _mm256_mullo_epi32(input_val,
+                                                         filter_val)));
+      }
+      for (; ic < input_depth; ++ic) {
+        const int16 input_val = input_ptr[ic] + input_offset;
+        const int16 filter_val = filter_base_ptr[ic] + filter_offset;
+        acc_buffer_ptr[ic] += static_cast<int32>(filter_val) * input_val;
+      }
+      input_ptr += stride * input_depth;
+      acc_buffer_ptr += output_depth;
+    }
+    filter_base_ptr += output_depth;
+  }
+}
+
+// Requantizes the int32 accumulators to uint8, 8 at a time. Returns the number
+// of values handled, leaving the leftovers to the caller.
+TFLITE_AVX2_TARGET inline int DepthwiseConvDownquantizeAvx2(
+    int num_output_values, const int32* acc_buffer, int32 output_multiplier,
+    int output_shift, int32 output_offset, int32 output_activation_min,
+    int32 output_activation_max, uint8* output_ptr) {
+  const __m256i output_offset_vec = _mm256_set1_epi32(output_offset);
+  const __m256i output_activation_min_vec =
+      _mm256_set1_epi32(output_activation_min);
+  const __m256i output_activation_max_vec =
+      _mm256_set1_epi32(output_activation_max);
+  int i = 0;
+  for (; i <= num_output_values - 8; i += 8) {
+    __m256i acc = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(acc_buffer + i));
+    acc = MultiplyByQuantizedMultiplierAvx2(acc, output_multiplier,
+                                            output_shift);
+    acc = _mm256_add_epi32(acc, output_offset_vec);
+    acc = _mm256_max_epi32(acc, output_activation_min_vec);
+    acc = _mm256_min_epi32(acc, output_activation_max_vec);
+    SaturatingStoreUint8x8Avx2(acc, output_ptr + i);
+  }
+  return i;
+}
+#endif  // TFLITE_AVX2_DISPATCH
+
 // Initializes the accumulator buffer with bias values.
 inline void DepthwiseConvInitAccBuffer(int num_output_pixels, int output_depth,
                                        const int32* bias_data,
@@ -1748,6 +1831,12 @@ inline void DepthwiseConvGeneral(
   TFMINI_USE_DEPTHWISECONV_KERNEL(true, 0, 3)
 #endif  // USE_NEON
 
+#ifdef TFLITE_AVX2_DISPATCH
+  if (!row_accum_func && depth_multiplier == 1 && TestCPUFeatureAvx2()) {
+    row_accum_func = QuantizedDepthwiseConvAccumRowAvx2;
+  }
+#endif  // TFLITE_AVX2_DISPATCH
+
   // No matching fast kernel found, use slow fallback.
   if (!row_accum_func) {
     row_accum_func = QuantizedDepthwiseConvAccumRowGeneric;
@@ -1924,6 +2013,14 @@ inline void DepthwiseConvGeneral(
           vst1_lane_u8(output_ptr + 3, res_u8, 3);
           output_ptr += 4;
         }
+#elif defined(TFLITE_AVX2_DISPATCH)
+        if (TestCPUFeatureAvx2()) {
+          i = DepthwiseConvDownquantizeAvx2(
+              num_output_values, acc_buffer, output_multiplier, output_shift,
+              output_offset, output_activation_min, output_activation_max,
+              output_ptr);
+          output_ptr += i;
+        }
 #endif  // USE_NEON
 
         // Handle leftover values, one by one. This is very slow.
@@ -30,6 +30,8 @@ limitations under the License.
 #include "fixedpoint/fixedpoint.h"
 #include "public/gemmlowp.h"
 #include "tensorflow/contrib/lite/kernels/internal/common.h"
+#include "tensorflow/contrib/lite/kernels/internal/optimized/avx2_fixedpoint.h"
+#include "tensorflow/contrib/lite/kernels/internal/optimized/cpu_check.h"
 #include "tensorflow/contrib/lite/kernels/internal/quantization_util.h"
 #include "tensorflow/contrib/lite/kernels/internal/reference/reference_ops.h"
 #include "tensorflow/contrib/lite/kernels/internal/round.h"
@@ -2308,6 +2310,50 @@ inline void Add(const ArithmeticParams& params,
   }
 }
 
+#ifdef TFLITE_AVX2_DISPATCH
+// AVX2 part of AddElementwise, 8 values at a time. Returns the number of values
+// handled, leaving the leftovers to the caller.
+TFLITE_AVX2_TARGET inline int AddElementwiseAvx2(int size,
+                                                 const ArithmeticParams& params,
+                                                 const uint8* input1_data,
+                                                 const uint8* input2_data,
+                                                 uint8* output_data) {
+  const __m256i input1_offset = _mm256_set1_epi32(params.input1_offset);
+  const __m256i input2_offset = _mm256_set1_epi32(params.input2_offset);
+  const __m256i output_offset = _mm256_set1_epi32(params.output_offset);
+  const __m256i output_activation_min =
+      _mm256_set1_epi32(params.quantized_activation_min);
+  const __m256i output_activation_max =
+      _mm256_set1_epi32(params.quantized_activation_max);
+  const __m128i left_shift = _mm_cvtsi32_si128(params.left_shift);
+  int i = 0;
+  for (; i <= size - 8; i += 8) {
+    const __m256i input1_val =
+        _mm256_add_epi32(LoadUint8x8Avx2(input1_data + i), input1_offset);
+    const __m256i input2_val =
+        _mm256_add_epi32(LoadUint8x8Avx2(input2_data + i), input2_offset);
+    const __m256i scaled_input1_val =
+        MultiplyByQuantizedMultiplierSmallerThanOneExpAvx2(
+            _mm256_sll_epi32(input1_val, left_shift), params.input1_multiplier,
+            params.input1_shift);
+    const __m256i scaled_input2_val =
+        MultiplyByQuantizedMultiplierSmallerThanOneExpAvx2(
+            _mm256_sll_epi32(input2_val, left_shift), params.input2_multiplier,
+            params.input2_shift);
+    const __m256i raw_sum = _mm256_add_epi32(scaled_input1_val,
+                                             scaled_input2_val);
+    __m256i raw_output = _mm256_add_epi32(
+        MultiplyByQuantizedMultiplierSmallerThanOneExpAvx2(
+            raw_sum, params.output_multiplier, params.output_shift),
+        output_offset);
+    raw_output = _mm256_max_epi32(raw_output, output_activation_min);
+    raw_output = _mm256_min_epi32(raw_output, output_activation_max);
+    SaturatingStoreUint8x8Avx2(raw_output, output_data + i);
+  }
+  return i;
+}
+#endif  // TFLITE_AVX2_DISPATCH
+
 // Element-wise add that can often be used for inner loop of broadcast add as
 // well as the non-broadcast add.
 inline void AddElementwise(int size, const ArithmeticParams& params,
@@ -2373,6 +2419,10 @@ inline void AddElementwise(int size, const ArithmeticParams& params,
                 vmin_u8(output_activation_max_vector, vqmovun_s16(s)));
     vst1_u8(output_data + i, clamped);
   }
+#elif defined(TFLITE_AVX2_DISPATCH)
+  if (TestCPUFeatureAvx2()) {
+    i = AddElementwiseAvx2(size, params, input1_data, input2_data, output_data);
+  }
 #endif  // NEON
 
   for (; i < size; ++i) {
@@ -2690,6 +2740,40 @@ inline void Mul(const ArithmeticParams& params,
   }
 }
 
+#ifdef TFLITE_AVX2_DISPATCH
+// AVX2 part of MulElementwise, 8 values at a time. Returns the number of values
+// handled, leaving the leftovers to the caller.
+TFLITE_AVX2_TARGET inline int MulElementwiseAvx2(int size,
+                                                 const ArithmeticParams& params,
+                                                 const uint8* input1_data,
+                                                 const uint8* input2_data,
+                                                 uint8* output_data) {
+  const __m256i input1_offset = _mm256_set1_epi32(params.input1_offset);
+  const __m256i input2_offset = _mm256_set1_epi32(params.input2_offset);
+  const __m256i output_offset = _mm256_set1_epi32(params.output_offset);
+  const __m256i output_activation_min =
+      _mm256_set1_epi32(params.quantized_activation_min);
+  const __m256i output_activation_max =
+      _mm256_set1_epi32(params.quantized_activation_max);
+  int i = 0;
+  for (; i <= size - 8; i += 8) {
+    const __m256i input1_val =
+        _mm256_add_epi32(LoadUint8x8Avx2(input1_data + i), input1_offset);
+    const __m256i input2_val =
+        _mm256_add_epi32(LoadUint8x8Avx2(input2_data + i), input2_offset);
+    __m256i result = _mm256_add_epi32(
+        MultiplyByQuantizedMultiplierSmallerThanOneExpAvx2(
+            _mm256_mullo_epi32(input1_val, input2_val),
+            params.output_multiplier, params.output_shift),
+        output_offset);
+    result = _mm256_max_epi32(result, output_activation_min);
+    result = _mm256_min_epi32(result, output_activation_max);
+    SaturatingStoreUint8x8Avx2(result, output_data + i);
+  }
+  return i;
+}
+#endif  // TFLITE_AVX2_DISPATCH
+
 // Element-wise mul that can often be used for inner loop of broadcast Mul as
 // well as the non-broadcast Mul.
 inline void MulElementwise(int size, const ArithmeticParams& params,
@@ -2744,6 +2828,10 @@ inline void MulElementwise(int size, const ArithmeticParams& params,
                 vmin_u8(output_activation_max_vector, vqmovun_s16(p)));
     vst1_u8(output_data + i, clamped);
   }
+#elif defined(TFLITE_AVX2_DISPATCH)
+  if (TestCPUFeatureAvx2()) {
+    i = MulElementwiseAvx2(size, params, input1_data, input2_data, output_data);
+  }
 #endif  // NEON
 
   for (; i < size; ++i) {
@@ -0,0 +1,399 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CONTRIB_LITE_KERNELS_INTERNAL_OPTIMIZED_SPARSE_OPS_H_
+#define TENSORFLOW_CONTRIB_LITE_KERNELS_INTERNAL_OPTIMIZED_SPARSE_OPS_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "public/gemmlowp.h"
+#include "tensorflow/contrib/lite/c/c_api_internal.h"
+#include "tensorflow/contrib/lite/kernels/internal/common.h"
+#include "tensorflow/contrib/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace optimized_ops {
+
+// Kernels for weights stored block-sparse (see TfLiteBlockSparsity). They only
+// visit the stored blocks, so their cost scales with the number of non-zero
+// blocks rather than with the dense size of the weights. For uint8, blocks
+// that were dropped must have held the weights zero point.
+
+// The largest block_rows supported, bounding the accumulators kept on stack.
+constexpr int kMaxSparseBlockRows = 16;
+
+namespace sparse_ops_internal {
+
+// Number of batches that share each load of a weight block.
+constexpr int kBatchTile = 4;
+
+// The kernels are instantiated for common block shapes so the block loops get
+// unrolled. A fixed size of 0 means the size is only known at runtime.
+template <int kFixedBlockRows, int kFixedBlockCols>
+inline void SparseFullyConnectedImpl(
+    const FullyConnectedParams& params, int batches, int accum_depth,
+    int output_depth, const float* input_data, const float* weights_data,
+    const TfLiteBlockSparsity& sparsity, const float* bias_data,
+    float* output_data) {
+  const int block_rows =
+      kFixedBlockRows ? kFixedBlockRows : sparsity.block_rows;
+  const int block_cols =
+      kFixedBlockCols ? kFixedBlockCols : sparsity.block_cols;
+  const int block_size = block_rows * block_cols;
+  const int num_block_rows = output_depth / block_rows;
+  // Accumulating each block column separately keeps the additions of
+  // consecutive blocks independent, so that they can be vectorized.
+  constexpr int kLanes = kFixedBlockCols ? kFixedBlockCols : 1;
+  float acc[kBatchTile][kMaxSparseBlockRows][kLanes];
+  for (int b0 = 0; b0 < batches; b0 += kBatchTile) {
+    const int tile = std::min(kBatchTile, batches - b0);
+    for (int block_row = 0; block_row < num_block_rows; ++block_row) {
+      const int out_c0 = block_row * block_rows;
+      for (int b = 0; b < tile; ++b) {
+        for (int r = 0; r < block_rows; ++r) {
+          for (int l = 0; l < kLanes; ++l) acc[b][r][l] = 0.0f;
+        }
+      }
+      for (int k = sparsity.row_ptr[block_row];
+           k < sparsity.row_ptr[block_row + 1]; ++k) {
+        const float* block = weights_data + k * block_size;
+        const int col = sparsity.col_indices[k] * block_cols;
+        for (int b = 0; b < tile; ++b) {
+          const float* input = input_data + (b0 + b) * accum_depth + col;
+          for (int r = 0; r < block_rows; ++r) {
+            for (int c = 0; c < block_cols; ++c) {
+              acc[b][r][c % kLanes] += block[r * block_cols + c] * input[c];
+            }
+          }
+        }
+      }
+      for (int b = 0; b < tile; ++b) {
+        float* output = output_data + (b0 + b) * output_depth + out_c0;
+        for (int r = 0; r < block_rows; ++r) {
+          float sum = bias_data ? bias_data[out_c0 + r] : 0.0f;
+          for (int l = 0; l < kLanes; ++l) sum += acc[b][r][l];
+          output[r] = ActivationFunctionWithMinMax(
+              sum, params.float_activation_min, params.float_activation_max);
+        }
+      }
+    }
+  }
+}
+
+template <int kFixedBlockRows, int kFixedBlockCols>
+inline void SparseFullyConnectedImpl(
+    const FullyConnectedParams& params, int batches, int accum_depth,
+    int output_depth, const uint8* input_data, const uint8* weights_data,
+    const TfLiteBlockSparsity& sparsity, const int32* bias_data,
+    uint8* output_data) {
+  const int block_rows =
+      kFixedBlockRows ? kFixedBlockRows : sparsity.block_rows;
+  const int block_cols =
+      kFixedBlockCols ? kFixedBlockCols : sparsity.block_cols;
+  const int block_size = block_rows * block_cols;
+  const int num_block_rows = output_depth / block_rows;
+  const int32 input_offset = params.input_offset;
+  const int32 weights_offset = params.weights_offset;
+  int32 acc[kBatchTile][kMaxSparseBlockRows];
+  for (int b0 = 0; b0 < batches; b0 += kBatchTile) {
+    const int tile = std::min(kBatchTile, batches - b0);
+    for (int block_row = 0; block_row < num_block_rows; ++block_row) {
+      const int out_c0 = block_row * block_rows;
+      for (int b = 0; b < tile; ++b) {
+        for (int r = 0; r < block_rows; ++r) {
+          acc[b][r] = bias_data ? bias_data[out_c0 + r] : 0;
+        }
+      }
+      for (int k = sparsity.row_ptr[block_row];
+           k < sparsity.row_ptr[block_row + 1]; ++k) {
+        const uint8* block = weights_data + k * block_size;
+        const int col = sparsity.col_indices[k] * block_cols;
+        for (int b = 0; b < tile; ++b) {
+          const uint8* input = input_data + (b0 + b) * accum_depth + col;
+          for (int r = 0; r < block_rows; ++r) {
+            int32 sum = 0;
+            for (int c = 0; c < block_cols; ++c) {
+              sum += (block[r * block_cols + c] + weights_offset) *
+                     (input[c] + input_offset);
+            }
+            acc[b][r] += sum;
+          }
+        }
+      }
+      for (int b = 0; b < tile; ++b) {
+        uint8* output = output_data + (b0 + b) * output_depth + out_c0;
+        for (int r = 0; r < block_rows; ++r) {
+          int32 value = MultiplyByQuantizedMultiplier(
+              acc[b][r], params.output_multiplier, params.output_shift);
+          value += params.output_offset;
+          value = std::max(value, params.quantized_activation_min);
+          value = std::min(value, params.quantized_activation_max);
+          output[r] = static_cast<uint8>(value);
+        }
+      }
+    }
+  }
+}
+
+template <typename T, typename BiasT>
+inline void SparseFullyConnectedDispatch(
+    const FullyConnectedParams& params, const RuntimeShape& input_shape,
+    const T* input_data, const RuntimeShape& weights_shape,
+    const T* weights_data, const TfLiteBlockSparsity& sparsity,
+    const BiasT* bias_data, const RuntimeShape& output_shape, T* output_data) {
+  const int output_dim_count = output_shape.DimensionsCount();
+  const int weights_dim_count = weights_shape.DimensionsCount();
+  const int batches = FlatSizeSkipDim(output_shape, output_dim_count - 1);
+  const int output_depth = MatchingDim(weights_shape, weights_dim_count - 2,
+                                       output_shape, output_dim_count - 1);
+  const int accum_depth = weights_shape.Dims(weights_dim_count - 1);
+  TFLITE_DCHECK_LE(sparsity.block_rows, kMaxSparseBlockRows);
+  if (sparsity.block_rows == 1 && sparsity.block_cols == 4) {
+    SparseFullyConnectedImpl<1, 4>(params, batches, accum_depth, output_depth,
+                                   input_data, weights_data, sparsity,
+                                   bias_data, output_data);
+  } else if (sparsity.block_rows == 4 && sparsity.block_cols == 4) {
+    SparseFullyConnectedImpl<4, 4>(params, batches, accum_depth, output_depth,
+                                   input_data, weights_data, sparsity,
+                                   bias_data, output_data);
+  } else {
+    SparseFullyConnectedImpl<0, 0>(params, batches, accum_depth, output_depth,
+                                   input_data, weights_data, sparsity,
+                                   bias_data, output_data);
+  }
+}
+
+}  // namespace sparse_ops_internal
+
+inline void SparseFullyConnected(
+    const FullyConnectedParams& params, const RuntimeShape& input_shape,
+    const float* input_data, const RuntimeShape& weights_shape,
+    const float* weights_data, const TfLiteBlockSparsity& sparsity,
+    const RuntimeShape& bias_shape, const float* bias_data,
+    const RuntimeShape& output_shape, float* output_data) {
+  gemmlowp::ScopedProfilingLabel label("SparseFullyConnected");
+  sparse_ops_internal::SparseFullyConnectedDispatch(
+      params, input_shape, input_data, weights_shape, weights_data, sparsity,
+      bias_data, output_shape, output_data);
+}
+
+inline void SparseFullyConnected(
+    const FullyConnectedParams& params, const RuntimeShape& input_shape,
+    const uint8* input_data, const RuntimeShape& weights_shape,
+    const uint8* weights_data, const TfLiteBlockSparsity& sparsity,
+    const RuntimeShape& bias_shape, const int32* bias_data,
+    const RuntimeShape& output_shape, uint8* output_data) {
+  gemmlowp::ScopedProfilingLabel label("SparseFullyConnected/8bit");
+  sparse_ops_internal::SparseFullyConnectedDispatch(
+      params, input_shape, input_data, weights_shape, weights_data, sparsity,
+      bias_data, output_shape, output_data);
+}
+
+// Where the columns of a stored block of a sparse conv filter start: the
+// filter position and the input channel. The filter being constant, these are
+// computed once with GetSparseConvBlockIndices() rather than on every Eval.
+struct SparseConvBlockIndex {
+  int filter_y;
+  int filter_x;
+  int in_channel;
+};
+
+// The filter is [output_depth, filter_height, filter_width, input_depth] and
+// its input_depth must be a multiple of block_cols, so that no block spans two
+// filter positions.
+inline void GetSparseConvBlockIndices(
+    const RuntimeShape& filter_shape, const TfLiteBlockSparsity& sparsity,
+    std::vector<SparseConvBlockIndex>* block_indices) {
+  const int filter_width = filter_shape.Dims(2);
+  const int input_depth = filter_shape.Dims(3);
+  TFLITE_DCHECK_EQ(input_depth % sparsity.block_cols, 0);
+  const int num_block_rows = filter_shape.Dims(0) / sparsity.block_rows;
+  const int num_blocks = sparsity.row_ptr[num_block_rows];
+  block_indices->resize(num_blocks);
+  for (int k = 0; k < num_blocks; ++k) {
+    const int col = sparsity.col_indices[k] * sparsity.block_cols;
+    SparseConvBlockIndex& index = (*block_indices)[k];
+    index.in_channel = col % input_depth;
+    index.filter_x = (col / input_depth) % filter_width;
+    index.filter_y = col / (input_depth * filter_width);
+  }
+}
+
+namespace sparse_ops_internal {
+
+// Computes, for each output pixel, the products of the stored filter blocks
+// with the input values under them, reading the input in place instead of
+// through an im2col buffer. Blocks falling in the padding are skipped: they
+// contribute 0 for float, and for uint8 the padding holds the input zero
+// point, which contributes 0 too.
+template <int kFixedBlockRows, int kFixedBlockCols, typename T,
+          typename AccT, typename BiasT, typename Finish>
+inline void SparseConvImpl(const ConvParams& params,
+                           const RuntimeShape& input_shape, const T* input_data,
+                           const RuntimeShape& filter_shape,
+                           const T* filter_data,
+                           const TfLiteBlockSparsity& sparsity,
+                           const SparseConvBlockIndex* block_indices,
+                           const BiasT* bias_data,
+                           const RuntimeShape& output_shape, T* output_data,
+                           AccT input_offset, AccT filter_offset,
+                           const Finish& finish) {
+  const int block_rows =
+      kFixedBlockRows ? kFixedBlockRows : sparsity.block_rows;
+  const int block_cols =
+      kFixedBlockCols ? kFixedBlockCols : sparsity.block_cols;
+  const int block_size = block_rows * block_cols;
+  const int batches = MatchingDim(input_shape, 0, output_shape, 0);
+  const int input_height = input_shape.Dims(1);
+  const int input_width = input_shape.Dims(2);
+  const int input_depth = MatchingDim(input_shape, 3, filter_shape, 3);
+  const int output_height = output_shape.Dims(1);
+  const int output_width = output_shape.Dims(2);
+  const int output_depth = MatchingDim(filter_shape, 0, output_shape, 3);
+  const int num_block_rows = output_depth / block_rows;
+  AccT acc[kMaxSparseBlockRows];
+  for (int batch = 0; batch < batches; ++batch) {
+    for (int out_y = 0; out_y < output_height; ++out_y) {
+      const int in_y_origin =
+          out_y * params.stride_height - params.padding_values.height;
+      for (int out_x = 0; out_x < output_width; ++out_x) {
+        const int in_x_origin =
+            out_x * params.stride_width - params.padding_values.width;
+        T* output =
+            output_data + Offset(output_shape, batch, out_y, out_x, 0);
+        for (int block_row = 0; block_row < num_block_rows; ++block_row) {
+          const int out_c0 = block_row * block_rows;
+          for (int r = 0; r < block_rows; ++r) {
+            acc[r] = bias_data ? bias_data[out_c0 + r] : 0;
+          }
+          for (int k = sparsity.row_ptr[block_row];
+               k < sparsity.row_ptr[block_row + 1]; ++k) {
+            const SparseConvBlockIndex& index = block_indices[k];
+            const int in_y =
+                in_y_origin + params.dilation_height_factor * index.filter_y;
+            const int in_x =
+                in_x_origin + params.dilation_width_factor * index.filter_x;
+            if (in_y < 0 || in_y >= input_height || in_x < 0 ||
+                in_x >= input_width) {
+              continue;
+            }
+            const T* input =
+                input_data +
+                ((batch * input_height + in_y) * input_width + in_x) *
+                    input_depth +
+                index.in_channel;
+            const T* block = filter_data + k * block_size;
+            for (int r = 0; r < block_rows; ++r) {
+              AccT sum = 0;
+              for (int c = 0; c < block_cols; ++c) {
+                sum += (block[r * block_cols + c] + filter_offset) *
+                       (input[c] + input_offset);
+              }
+              acc[r] += sum;
+            }
+          }
+          for (int r = 0; r < block_rows; ++r) {
+            output[out_c0 + r] = finish(acc[r]);
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename T, typename AccT, typename BiasT, typename Finish>
+inline void SparseConvDispatch(
+    const ConvParams& params, const RuntimeShape& input_shape,
+    const T* input_data, const RuntimeShape& filter_shape,
+    const T* filter_data, const TfLiteBlockSparsity& sparsity,
+    const SparseConvBlockIndex* block_indices, const BiasT* bias_data,
+    const RuntimeShape& output_shape, T* output_data, AccT input_offset,
+    AccT filter_offset, const Finish& finish) {
+  TFLITE_DCHECK_EQ(input_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(filter_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_EQ(output_shape.DimensionsCount(), 4);
+  TFLITE_DCHECK_LE(sparsity.block_rows, kMaxSparseBlockRows);
+  if (sparsity.block_rows == 1 && sparsity.block_cols == 4) {
+    SparseConvImpl<1, 4>(params, input_shape, input_data, filter_shape,
+                         filter_data, sparsity, block_indices, bias_data,
+                         output_shape, output_data, input_offset,
+                         filter_offset, finish);
+  } else if (sparsity.block_rows == 4 && sparsity.block_cols == 4) {
+    SparseConvImpl<4, 4>(params, input_shape, input_data, filter_shape,
+                         filter_data, sparsity, block_indices, bias_data,
+                         output_shape, output_data, input_offset,
+                         filter_offset, finish);
+  } else {
+    SparseConvImpl<0, 0>(params, input_shape, input_data, filter_shape,
+                         filter_data, sparsity, block_indices, bias_data,
+                         output_shape, output_data, input_offset,
+                         filter_offset, finish);
+  }
+}
+
+}  // namespace sparse_ops_internal
+
+// `block_indices` comes from GetSparseConvBlockIndices().
+inline void SparseConv(const ConvParams& params,
+                       const RuntimeShape& input_shape, const float* input_data,
+                       const RuntimeShape& filter_shape,
+                       const float* filter_data,
+                       const TfLiteBlockSparsity& sparsity,
+                       const SparseConvBlockIndex* block_indices,
+                       const RuntimeShape& bias_shape, const float* bias_data,
+                       const RuntimeShape& output_shape, float* output_data) {
+  gemmlowp::ScopedProfilingLabel label("SparseConv");
+  const float output_activation_min = params.float_activation_min;
+  const float output_activation_max = params.float_activation_max;
+  sparse_ops_internal::SparseConvDispatch(
+      params, input_shape, input_data, filter_shape, filter_data, sparsity,
+      block_indices, bias_data, output_shape, output_data,
+      /*input_offset=*/0.0f, /*filter_offset=*/0.0f, [=](float acc) {
+        return ActivationFunctionWithMinMax(acc, output_activation_min,
+                                            output_activation_max);
+      });
+}
+
+inline void SparseConv(const ConvParams& params,
+                       const RuntimeShape& input_shape, const uint8* input_data,
+                       const RuntimeShape& filter_shape,
+                       const uint8* filter_data,
+                       const TfLiteBlockSparsity& sparsity,
+                       const SparseConvBlockIndex* block_indices,
+                       const RuntimeShape& bias_shape, const int32* bias_data,
+                       const RuntimeShape& output_shape, uint8* output_data) {
+  gemmlowp::ScopedProfilingLabel label("SparseConv/8bit");
+  const int32 output_offset = params.output_offset;
+  const int32 output_multiplier = params.output_multiplier;
+  const int output_shift = params.output_shift;
+  const int32 output_activation_min = params.quantized_activation_min;
+  const int32 output_activation_max = params.quantized_activation_max;
+  sparse_ops_internal::SparseConvDispatch(
+      params, input_shape, input_data, filter_shape, filter_data, sparsity,
+      block_indices, bias_data, output_shape, output_data, params.input_offset,
+      params.weights_offset, [=](int32 acc) {
+        acc = MultiplyByQuantizedMultiplier(acc, output_multiplier,
+                                            output_shift);
+        acc += output_offset;
+        acc = std::max(acc, output_activation_min);
+        acc = std::min(acc, output_activation_max);
+        return static_cast<uint8>(acc);
+      });
+}
+
+}  // namespace optimized_ops
+}  // namespace tflite
+
+#endif  // TENSORFLOW_CONTRIB_LITE_KERNELS_INTERNAL_OPTIMIZED_SPARSE_OPS_H_
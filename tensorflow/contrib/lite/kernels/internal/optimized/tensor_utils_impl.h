@@ -43,6 +43,10 @@ void NeonMatrixBatchVectorMultiplyAccumulate(const float* matrix, int m_rows,
                                              int m_cols, const float* vector,
                                              int n_batch, float* result,
                                              int result_stride);
+void Avx2MatrixBatchVectorMultiplyAccumulate(const float* matrix, int m_rows,
+                                             int m_cols, const float* vector,
+                                             int n_batch, float* result,
+                                             int result_stride);
 
 // Matrix multiplication for quantized values using symmetric quantization.
 void PortableMatrixBatchVectorMultiplyAccumulate(
@@ -53,6 +57,10 @@ void NeonMatrixBatchVectorMultiplyAccumulate(
     const int8_t* __restrict__ matrix, const int m_rows, const int m_cols,
     const int8_t* __restrict__ vectors, const float* scaling_factors,
     int n_batch, float* __restrict__ result, int result_stride);
+void Avx2MatrixBatchVectorMultiplyAccumulate(
+    const int8_t* __restrict__ matrix, const int m_rows, const int m_cols,
+    const int8_t* __restrict__ vectors, const float* scaling_factors,
+    int n_batch, float* __restrict__ result, int result_stride);
 
 // Cwise product of two vectors.
 void PortableVectorVectorCwiseProduct(const float* vector1,
@@ -60,6 +68,8 @@ void PortableVectorVectorCwiseProduct(const float* vector1,
                                       float* result);
 void NeonVectorVectorCwiseProduct(const float* vector1, const float* vector2,
                                   int v_size, float* result);
+void Avx2VectorVectorCwiseProduct(const float* vector1, const float* vector2,
+                                  int v_size, float* result);
 
 // Cwise product and accumulate of two vectors. Since it's a MAC operation, the
 // assumption here is that result array is initialized to valid values.
@@ -69,12 +79,17 @@ void PortableVectorVectorCwiseProductAccumulate(const float* vector1,
 void NeonVectorVectorCwiseProductAccumulate(const float* vector1,
                                             const float* vector2, int v_size,
                                             float* result);
+void Avx2VectorVectorCwiseProductAccumulate(const float* vector1,
+                                            const float* vector2, int v_size,
+                                            float* result);
 
 // Dot product of two vectors.
 float PortableVectorVectorDotProduct(const float* vector1, const float* vector2,
                                      int v_size);
 float NeonVectorVectorDotProduct(const float* vector1, const float* vector2,
                                  int v_size);
+float Avx2VectorVectorDotProduct(const float* vector1, const float* vector2,
+                                 int v_size);
 
 // Dot product of two batch vectors.
 void PortableBatchVectorBatchVectorDotProduct(const float* vector1,
@@ -85,6 +100,10 @@ void NeonBatchVectorBatchVectorDotProduct(const float* vector1,
                                           const float* vector2, int v_size,
                                           int n_batch, float* result,
                                           int result_stride);
+void Avx2BatchVectorBatchVectorDotProduct(const float* vector1,
+                                          const float* vector2, int v_size,
+                                          int n_batch, float* result,
+                                          int result_stride);
 
 // Cwise product of a vector and a batch-vector.
 void PortableVectorBatchVectorCwiseProduct(const float* vector, int v_size,
@@ -93,6 +112,9 @@ void PortableVectorBatchVectorCwiseProduct(const float* vector, int v_size,
 void NeonVectorBatchVectorCwiseProduct(const float* vector, int v_size,
                                        const float* batch_vector, int n_batch,
                                        float* result);
+void Avx2VectorBatchVectorCwiseProduct(const float* vector, int v_size,
+                                       const float* batch_vector, int n_batch,
+                                       float* result);
 
 // Cwise product and accumulate of a vector and a batch-vector. Since it's a MAC
 // operation, the assumption here is that result array is initialized to valid
@@ -106,16 +128,23 @@ void NeonVectorBatchVectorCwiseProductAccumulate(const float* vector,
                                                  int v_size,
                                                  const float* batch_vector,
                                                  int n_batch, float* result);
+void Avx2VectorBatchVectorCwiseProductAccumulate(const float* vector,
+                                                 int v_size,
+                                                 const float* batch_vector,
+                                                 int n_batch, float* result);
 
 // Compute "1.0f - elements of vector" (used in CIFG).
 void PortableSub1Vector(const float* vector, int v_size, float* result);
 void NeonSub1Vector(const float* vector, int v_size, float* result);
+void Avx2Sub1Vector(const float* vector, int v_size, float* result);
 
 // Clip elements of a vector using a abs_limit value.
 void PortableClipVector(const float* vector, int v_size, float abs_limit,
                         float* result);
 void NeonClipVector(const float* vector, int v_size, float abs_limit,
                     float* result);
+void Avx2ClipVector(const float* vector, int v_size, float abs_limit,
+                    float* result);
 
 // Add another vector for each batch in the batch vector.
 void PortableVectorBatchVectorAdd(const float* vector, int v_size, int n_batch,
@@ -145,6 +174,8 @@ void PortableVectorScalarMultiply(const int8_t* vector, int v_size, float scale,
                                   float* result);
 void NeonVectorScalarMultiply(const int8_t* vector, int v_size, float scale,
                               float* result);
+void Avx2VectorScalarMultiply(const int8_t* vector, int v_size, float scale,
+                              float* result);
 
 // Limit a float input f between +abs_limit and -abs_limit.
 float PortableClip(float f, float abs_limit);
@@ -152,6 +183,7 @@ float PortableClip(float f, float abs_limit);
 // Check if all entries of a vector are zero.
 bool PortableIsZeroVector(const float* vector, int v_size);
 bool NeonIsZeroVector(const float* vector, int v_size);
+bool Avx2IsZeroVector(const float* vector, int v_size);
 
 // Symmetric quantizer.
 void PortableSymmetricQuantizeFloats(const float* values, const int size,
@@ -160,6 +192,9 @@ void PortableSymmetricQuantizeFloats(const float* values, const int size,
 void NeonSymmetricQuantizeFloats(const float* values, const int size,
                                  int8_t* quantized_values, float* min,
                                  float* max, float* scaling_factor);
+void Avx2SymmetricQuantizeFloats(const float* values, const int size,
+                                 int8_t* quantized_values, float* min,
+                                 float* max, float* scaling_factor);
 
 // Shift left a vector in place with v_size size.
 void PortableVectorShiftLeft(float* vector, int v_size, float shift_value);
@@ -175,6 +210,8 @@ void PortableReductionSumVector(const float* input_vector, float* output_vector,
                                 int output_size, int reduction_size);
 void NeonReductionSumVector(const float* input_vector, float* output_vector,
                             int output_size, int reduction_size);
+void Avx2ReductionSumVector(const float* input_vector, float* output_vector,
+                            int output_size, int reduction_size);
 
 void PortableMeanStddevNormalization(const float* input_vector,
                                      float* output_vector, int v_size,
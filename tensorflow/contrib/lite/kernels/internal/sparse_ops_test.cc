@@ -0,0 +1,306 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "tensorflow/contrib/lite/kernels/internal/optimized/sparse_ops.h"
+#include "tensorflow/contrib/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/contrib/lite/kernels/internal/reference/fully_connected.h"
+#include "tensorflow/contrib/lite/kernels/internal/reference/reference_ops.h"
+#include "tensorflow/contrib/lite/kernels/internal/test_util.h"
+#include "tensorflow/contrib/lite/kernels/internal/types.h"
+
+namespace tflite {
+namespace {
+
+// Weights as a [rows, cols] matrix, both dense and block-sparse.
+template <typename T>
+struct PrunedWeights {
+  std::vector<T> dense;
+  std::vector<T> blocks;
+  std::vector<int> row_ptr;
+  std::vector<int> col_indices;
+  TfLiteBlockSparsity sparsity;
+};
+
+// Fills random weights and sets each block to `zero` with probability
+// `pruned_fraction`, the way pruned models end up.
+template <typename T>
+void MakePrunedWeights(int rows, int cols, int block_rows, int block_cols,
+                       float pruned_fraction, T min, T max, T zero,
+                       PrunedWeights<T>* weights) {
+  weights->dense.resize(rows * cols);
+  FillRandom(&weights->dense, min, max);
+  weights->blocks.clear();
+  weights->row_ptr = {0};
+  weights->col_indices.clear();
+  for (int block_row = 0; block_row < rows / block_rows; ++block_row) {
+    for (int block_col = 0; block_col < cols / block_cols; ++block_col) {
+      const bool pruned = UniformRandomFloat(0, 1) < pruned_fraction;
+      for (int r = 0; r < block_rows; ++r) {
+        for (int c = 0; c < block_cols; ++c) {
+          T& value = weights->dense[(block_row * block_rows + r) * cols +
+                                    block_col * block_cols + c];
+          if (pruned) {
+            value = zero;
+          } else {
+            weights->blocks.push_back(value);
+          }
+        }
+      }
+      if (!pruned) weights->col_indices.push_back(block_col);
+    }
+    weights->row_ptr.push_back(weights->col_indices.size());
+  }
+  weights->sparsity.block_rows = block_rows;
+  weights->sparsity.block_cols = block_cols;
+  weights->sparsity.row_ptr = weights->row_ptr.data();
+  weights->sparsity.col_indices = weights->col_indices.data();
+}
+
+struct BlockShape {
+  int rows;
+  int cols;
+};
+
+// The shapes with a dedicated kernel, and one going through the generic one.
+const BlockShape kBlockShapes[] = {{1, 4}, {4, 4}, {2, 8}};
+
+void ExpectNear(const std::vector<float>& expected,
+                const std::vector<float>& actual) {
+  ASSERT_EQ(expected.size(), actual.size());
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_NEAR(expected[i], actual[i], 1e-4f * (1 + std::abs(expected[i])))
+        << "at " << i;
+  }
+}
+
+void SetQuantizedParams(FullyConnectedParams* params) {
+  params->input_offset = -127;
+  params->weights_offset = -131;
+  params->output_offset = 120;
+  int shift;
+  QuantizeMultiplier(0.0015, &params->output_multiplier, &shift);
+  params->output_shift = shift;
+  params->quantized_activation_min = 10;
+  params->quantized_activation_max = 250;
+}
+
+TEST(SparseOpsTest, FullyConnectedFloat) {
+  const int accum_depth = 64;
+  const int output_depth = 32;
+  for (const BlockShape& block : kBlockShapes) {
+    for (int batches : {1, 5}) {
+      PrunedWeights<float> weights;
+      MakePrunedWeights(output_depth, accum_depth, block.rows, block.cols,
+                        /*pruned_fraction=*/0.8f, -1.0f, 1.0f, 0.0f,
+                        &weights);
+      std::vector<float> input(batches * accum_depth);
+      FillRandom(&input, -1.0f, 1.0f);
+      std::vector<float> bias(output_depth);
+      FillRandom(&bias, -1.0f, 1.0f);
+
+      FullyConnectedParams params;
+      params.float_activation_min = -0.5f;
+      params.float_activation_max = 0.5f;
+      const RuntimeShape input_shape({batches, accum_depth});
+      const RuntimeShape weights_shape({output_depth, accum_depth});
+      const RuntimeShape bias_shape({output_depth});
+      const RuntimeShape output_shape({batches, output_depth});
+      std::vector<float> expected(batches * output_depth);
+      reference_ops::FullyConnected(
+          params, input_shape, input.data(), weights_shape,
+          weights.dense.data(), bias_shape, bias.data(), output_shape,
+          expected.data());
+      std::vector<float> output(batches * output_depth);
+      optimized_ops::SparseFullyConnected(
+          params, input_shape, input.data(), weights_shape,
+          weights.blocks.data(), weights.sparsity, bias_shape, bias.data(),
+          output_shape, output.data());
+      ExpectNear(expected, output);
+    }
+  }
+}
+
+TEST(SparseOpsTest, FullyConnectedUint8) {
+  const int accum_depth = 64;
+  const int output_depth = 32;
+  for (const BlockShape& block : kBlockShapes) {
+    for (int batches : {1, 5}) {
+      FullyConnectedParams params;
+      SetQuantizedParams(&params);
+      PrunedWeights<uint8> weights;
+      MakePrunedWeights<uint8>(output_depth, accum_depth, block.rows,
+                               block.cols, /*pruned_fraction=*/0.8f, 0, 255,
+                               -params.weights_offset, &weights);
+      std::vector<uint8> input(batches * accum_depth);
+      FillRandom(&input);
+      std::vector<int32> bias(output_depth);
+      FillRandom(&bias, -10000, 10000);
+
+      const RuntimeShape input_shape({batches, accum_depth});
+      const RuntimeShape weights_shape({output_depth, accum_depth});
+      const RuntimeShape bias_shape({output_depth});
+      const RuntimeShape output_shape({batches, output_depth});
+      std::vector<uint8> expected(batches * output_depth);
+      reference_ops::FullyConnected(
+          params, input_shape, input.data(), weights_shape,
+          weights.dense.data(), bias_shape, bias.data(), output_shape,
+          expected.data(), /*gemm_context=*/nullptr);
+      std::vector<uint8> output(batches * output_depth);
+      optimized_ops::SparseFullyConnected(
+          params, input_shape, input.data(), weights_shape,
+          weights.blocks.data(), weights.sparsity, bias_shape, bias.data(),
+          output_shape, output.data());
+      EXPECT_EQ(expected, output);
+    }
+  }
+}
+
+struct ConvCase {
+  int stride;
+  int dilation;
+  int padding;
+};
+
+// Covers windows partly in the padding, strides and dilations.
+const ConvCase kConvCases[] = {{1, 1, 1}, {2, 1, 1}, {1, 2, 2}};
+
+ConvParams MakeConvParams(const ConvCase& conv_case) {
+  ConvParams params;
+  params.padding_type = PaddingType::kSame;
+  params.padding_values.width = conv_case.padding;
+  params.padding_values.height = conv_case.padding;
+  params.stride_width = conv_case.stride;
+  params.stride_height = conv_case.stride;
+  params.dilation_width_factor = conv_case.dilation;
+  params.dilation_height_factor = conv_case.dilation;
+  return params;
+}
+
+RuntimeShape ConvOutputShape(const RuntimeShape& input_shape,
+                             const ConvCase& conv_case, int filter_size,
+                             int output_depth) {
+  const int effective_filter_size = (filter_size - 1) * conv_case.dilation + 1;
+  auto output_size = [&](int input_size) {
+    return (input_size + 2 * conv_case.padding - effective_filter_size) /
+               conv_case.stride +
+           1;
+  };
+  return RuntimeShape({input_shape.Dims(0), output_size(input_shape.Dims(1)),
+                       output_size(input_shape.Dims(2)), output_depth});
+}
+
+TEST(SparseOpsTest, ConvFloat) {
+  const int input_depth = 16;
+  const int output_depth = 8;
+  const int filter_size = 3;
+  const RuntimeShape input_shape({2, 9, 7, input_depth});
+  const RuntimeShape filter_shape(
+      {output_depth, filter_size, filter_size, input_depth});
+  const RuntimeShape bias_shape({output_depth});
+  for (const BlockShape& block : kBlockShapes) {
+    for (const ConvCase& conv_case : kConvCases) {
+      PrunedWeights<float> filter;
+      MakePrunedWeights(output_depth, filter_shape.FlatSize() / output_depth,
+                        block.rows, block.cols, /*pruned_fraction=*/0.8f,
+                        -1.0f, 1.0f, 0.0f, &filter);
+      std::vector<optimized_ops::SparseConvBlockIndex> block_indices;
+      optimized_ops::GetSparseConvBlockIndices(filter_shape, filter.sparsity,
+                                               &block_indices);
+      std::vector<float> input(input_shape.FlatSize());
+      FillRandom(&input, -1.0f, 1.0f);
+      std::vector<float> bias(output_depth);
+      FillRandom(&bias, -1.0f, 1.0f);
+
+      ConvParams params = MakeConvParams(conv_case);
+      params.float_activation_min = -1.0f;
+      params.float_activation_max = 1.0f;
+      const RuntimeShape output_shape = ConvOutputShape(
+          input_shape, conv_case, filter_size, output_depth);
+      std::vector<float> expected(output_shape.FlatSize());
+      reference_ops::Conv(params, input_shape, input.data(), filter_shape,
+                          filter.dense.data(), bias_shape, bias.data(),
+                          output_shape, expected.data(), RuntimeShape(),
+                          nullptr);
+      std::vector<float> output(output_shape.FlatSize());
+      optimized_ops::SparseConv(params, input_shape, input.data(),
+                                filter_shape, filter.blocks.data(),
+                                filter.sparsity, block_indices.data(),
+                                bias_shape, bias.data(), output_shape,
+                                output.data());
+      ExpectNear(expected, output);
+    }
+  }
+}
+
+TEST(SparseOpsTest, ConvUint8) {
+  const int input_depth = 16;
+  const int output_depth = 8;
+  const int filter_size = 3;
+  const RuntimeShape input_shape({2, 9, 7, input_depth});
+  const RuntimeShape filter_shape(
+      {output_depth, filter_size, filter_size, input_depth});
+  const RuntimeShape bias_shape({output_depth});
+  for (const BlockShape& block : kBlockShapes) {
+    for (const ConvCase& conv_case : kConvCases) {
+      FullyConnectedParams quantized_params;
+      SetQuantizedParams(&quantized_params);
+      ConvParams params = MakeConvParams(conv_case);
+      params.input_offset = quantized_params.input_offset;
+      params.weights_offset = quantized_params.weights_offset;
+      params.output_offset = quantized_params.output_offset;
+      params.output_multiplier = quantized_params.output_multiplier;
+      params.output_shift = quantized_params.output_shift;
+      params.quantized_activation_min =
+          quantized_params.quantized_activation_min;
+      params.quantized_activation_max =
+          quantized_params.quantized_activation_max;
+
+      PrunedWeights<uint8> filter;
+      MakePrunedWeights<uint8>(
+          output_depth, filter_shape.FlatSize() / output_depth, block.rows,
+          block.cols, /*pruned_fraction=*/0.8f, 0, 255,
+          -params.weights_offset, &filter);
+      std::vector<optimized_ops::SparseConvBlockIndex> block_indices;
+      optimized_ops::GetSparseConvBlockIndices(filter_shape, filter.sparsity,
+                                               &block_indices);
+      std::vector<uint8> input(input_shape.FlatSize());
+      FillRandom(&input);
+      std::vector<int32> bias(output_depth);
+      FillRandom(&bias, -10000, 10000);
+
+      const RuntimeShape output_shape = ConvOutputShape(
+          input_shape, conv_case, filter_size, output_depth);
+      std::vector<uint8> expected(output_shape.FlatSize());
+      reference_ops::Conv(params, input_shape, input.data(), filter_shape,
+                          filter.dense.data(), bias_shape, bias.data(),
+                          output_shape, expected.data(), RuntimeShape(),
+                          nullptr, /*gemm_context=*/nullptr);
+      std::vector<uint8> output(output_shape.FlatSize());
+      optimized_ops::SparseConv(params, input_shape, input.data(),
+                                filter_shape, filter.blocks.data(),
+                                filter.sparsity, block_indices.data(),
+                                bias_shape, bias.data(), output_shape,
+                                output.data());
+      EXPECT_EQ(expected, output);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace tflite
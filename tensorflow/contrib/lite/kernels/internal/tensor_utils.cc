@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/contrib/lite/kernels/internal/tensor_utils.h"
 #include "tensorflow/contrib/lite/kernels/internal/common.h"
+#include "tensorflow/contrib/lite/kernels/internal/optimized/cpu_check.h"
 
 #ifndef USE_NEON
 #if defined(__ARM_NEON__) || defined(__ARM_NEON)
@@ -23,6 +24,8 @@ limitations under the License.
 
 #ifdef USE_NEON
 #include "tensorflow/contrib/lite/kernels/internal/optimized/neon_tensor_utils.h"
+#elif defined(TFLITE_AVX2_DISPATCH)
+#include "tensorflow/contrib/lite/kernels/internal/optimized/avx2_tensor_utils.h"
 #else
 #include "tensorflow/contrib/lite/kernels/internal/reference/portable_tensor_utils.h"
-#endif  // USE_NEON
+#endif  // USE_NEON, TFLITE_AVX2_DISPATCH
@@ -117,6 +117,28 @@ TEST(uKernels, SymmetricQuantizeFloatsAllAlmostZeroTest) {
               testing::ElementsAreArray({-6, 19, -4, -57, 1, 25, 6, 127, 0}));
 }
 
+TEST(uKernels, SymmetricQuantizeFloatsRoundingTest) {
+  // With a range of 127 values are rounded as is, halfway cases away from
+  // zero. Use enough values to exercise the SIMD kernels and their leftovers.
+  constexpr int kVectorSize = 19;
+  static float input[kVectorSize] = {
+      127.0, -0.5,   0.5, 1.5,  -1.5, 2.5,  -2.5, 0.49999997, -0.49999997,
+      126.5, -126.5, 3.4, -3.6, 0.0,  -0.0, 10.5, 11.5,       -12.5,
+      13.25};
+
+  int8_t output[kVectorSize];
+  float min, max, scaling_factor;
+  SymmetricQuantizeFloats(input, kVectorSize, output, &min, &max,
+                          &scaling_factor);
+
+  EXPECT_EQ(min, -126.5);
+  EXPECT_EQ(max, 127);
+  EXPECT_EQ(scaling_factor, 1);
+  EXPECT_THAT(output,
+              testing::ElementsAreArray({127, -1, 1, 2, -2, 3, -3, 0, 0, 127,
+                                         -127, 3, -4, 0, 0, 11, 12, -13, 13}));
+}
+
 TEST(uKernels, MatrixBatchVectorMultiplyAccumulateTest) {
   constexpr int kRow = 3;
   constexpr int kCol = 4;
@@ -26,6 +26,7 @@ limitations under the License.
 #include "tensorflow/contrib/lite/model.h"
 #ifndef TFLITE_MCU
 #include "tensorflow/contrib/lite/nnapi_delegate.h"
+#include "tensorflow/contrib/lite/offline_memory_plan.h"
 #endif
 #include "tensorflow/contrib/lite/version.h"
 
@@ -363,14 +364,32 @@ TfLiteStatus InterpreterBuilder::ParseTensors(
         status = kTfLiteError;
       }
 
+      TfLiteBlockSparsity sparsity;
+      const TfLiteBlockSparsity* sparsity_ptr = nullptr;
+      if (tensor->sparsity()) {
+        if (ParseBlockSparsity(tensor->sparsity(), dims, &sparsity) !=
+            kTfLiteOk) {
+          error_reporter_->Report("Tensor %d has invalid sparsity.\n", i);
+          status = kTfLiteError;
+          continue;
+        }
+        sparsity_ptr = &sparsity;
+      }
+
       if (interpreter->SetTensorParametersReadOnly(
               i, type, get_name(tensor), dims, quantization, buffer_ptr,
-              buffer_size, allocation_) != kTfLiteOk) {
+              buffer_size, allocation_, sparsity_ptr) != kTfLiteOk) {
         error_reporter_->Report("Tensor %d is invalidly specified in schema.\n",
                                 i);
         status = kTfLiteError;
       }
     } else {
+      if (tensor->sparsity()) {
+        error_reporter_->Report(
+            "Tensor %d is block-sparse but has no buffer.\n", i);
+        status = kTfLiteError;
+        continue;
+      }
       if (interpreter->SetTensorParametersReadWrite(i, type, get_name(tensor),
                                                     dims, quantization,
                                                     is_variable) != kTfLiteOk) {
@@ -384,6 +403,69 @@ TfLiteStatus InterpreterBuilder::ParseTensors(
   return status;
 }
 
+TfLiteStatus InterpreterBuilder::ParseBlockSparsity(
+    const BlockSparsityParameters* parameters, const std::vector<int>& dims,
+    TfLiteBlockSparsity* sparsity) {
+  const auto* row_ptr = parameters->row_ptr();
+  const auto* col_indices = parameters->col_indices();
+  if (dims.empty() || parameters->block_rows() <= 0 || !row_ptr) {
+    return kTfLiteError;
+  }
+  // The interpreter checks the contents of the arrays, but can't tell how long
+  // they are.
+  const int num_block_rows = dims[0] / parameters->block_rows();
+  if (static_cast<int>(row_ptr->size()) != num_block_rows + 1) {
+    return kTfLiteError;
+  }
+  const int num_blocks = row_ptr->Get(num_block_rows);
+  const int num_col_indices =
+      col_indices ? static_cast<int>(col_indices->size()) : 0;
+  if (num_col_indices != num_blocks) return kTfLiteError;
+
+  // The index arrays are used in place, so they live as long as the model.
+  static const int kNoBlocks[] = {0};
+  sparsity->block_rows = parameters->block_rows();
+  sparsity->block_cols = parameters->block_cols();
+  sparsity->row_ptr = reinterpret_cast<const int*>(row_ptr->data());
+  sparsity->col_indices =
+      col_indices ? reinterpret_cast<const int*>(col_indices->data())
+                  : kNoBlocks;
+  return kTfLiteOk;
+}
+
+TfLiteStatus InterpreterBuilder::ParseOfflineMemoryPlan(
+    const flatbuffers::Vector<flatbuffers::Offset<Buffer>>* buffers,
+    Interpreter* interpreter) {
+  auto* metadata_buffers = model_->metadata_buffer();
+  if (!metadata_buffers) {
+    return kTfLiteOk;
+  }
+  for (int i = 0; i < metadata_buffers->Length(); ++i) {
+    int buffer_index = metadata_buffers->Get(i);
+    if (buffer_index < 0 || buffer_index >= buffers->size()) {
+      error_reporter_->Report("Invalid metadata buffer index %d.\n",
+                              buffer_index);
+      return kTfLiteError;
+    }
+    auto* data = (*buffers)[buffer_index]->data();
+    if (!data || !IsOfflineMemoryPlan(data->data(), data->size())) {
+      continue;
+    }
+    std::unique_ptr<OfflineMemoryPlan> plan(new OfflineMemoryPlan);
+    TF_LITE_ENSURE_STATUS(DeserializeOfflineMemoryPlan(
+        data->data(), data->size(), error_reporter_, plan.get()));
+    if (plan->offsets.size() != interpreter->tensors_size()) {
+      error_reporter_->Report(
+          "Offline memory plan has %d tensors but the graph has %d.\n",
+          static_cast<int>(plan->offsets.size()),
+          static_cast<int>(interpreter->tensors_size()));
+      return kTfLiteError;
+    }
+    interpreter->SetOfflineMemoryPlan(std::move(plan));
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus InterpreterBuilder::ApplyDelegates(Interpreter* interpreter) {
   // TODO(b/117561550): Move flex delegate application to the OpResolver.
   if (AcquireFlexDelegate == nullptr) {
@@ -493,6 +575,9 @@ TfLiteStatus InterpreterBuilder::operator()(
   }
   (**interpreter).SetVariables(std::move(variables));
 
+  if (ParseOfflineMemoryPlan(buffers, interpreter->get()) != kTfLiteOk)
+    return cleanup_and_error();
+
   if (ApplyDelegates(interpreter->get()) != kTfLiteOk)
     return cleanup_and_error();
 
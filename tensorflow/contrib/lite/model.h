@@ -173,6 +173,12 @@ class InterpreterBuilder {
       const flatbuffers::Vector<flatbuffers::Offset<Buffer>>* buffers,
       const flatbuffers::Vector<flatbuffers::Offset<Tensor>>* tensors,
       Interpreter* interpreter);
+  TfLiteStatus ParseBlockSparsity(const BlockSparsityParameters* parameters,
+                                  const std::vector<int>& dims,
+                                  TfLiteBlockSparsity* sparsity);
+  TfLiteStatus ParseOfflineMemoryPlan(
+      const flatbuffers::Vector<flatbuffers::Offset<Buffer>>* buffers,
+      Interpreter* interpreter);
   TfLiteStatus ApplyDelegates(Interpreter* interpreter);
 
   const ::tflite::Model* model_;
@@ -189,6 +189,11 @@ TfLiteStatus addTensorOperands(tflite::Interpreter* interpreter,
                i, tensor->name);
       return kTfLiteError;
     }
+    if (tensor->sparsity) {
+      logError("NNAPI doesn't support block-sparse tensors (index %d name %s)",
+               i, tensor->name);
+      return kTfLiteError;
+    }
     // TODO(aselle): Note, many of these are intermediate results. Do I need
     // to ever specify these sizes. I am currently below doing setValue
     // on all of them, but I shouldn't in the future.
@@ -0,0 +1,109 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/contrib/lite/offline_memory_plan.h"
+
+#include <cstring>
+
+namespace tflite {
+namespace {
+
+// A serialized plan is laid out as follows, with all integers little-endian:
+//   identifier    8 bytes
+//   num_tensors   uint32
+//   reserved      uint32, always 0
+//   arena_size    int64
+//   num_tensors x (offset int64, size int64)
+constexpr size_t kHeaderSize = kOfflineMemoryPlanIdentifierSize + 16;
+constexpr size_t kTensorEntrySize = 16;
+
+void AppendLittleEndian(uint64_t value, int num_bytes,
+                        std::vector<uint8_t>* buffer) {
+  for (int i = 0; i < num_bytes; ++i) {
+    buffer->push_back(static_cast<uint8_t>(value >> (8 * i)));
+  }
+}
+
+uint64_t ReadLittleEndian(const uint8_t* data, int num_bytes) {
+  uint64_t value = 0;
+  for (int i = 0; i < num_bytes; ++i) {
+    value |= static_cast<uint64_t>(data[i]) << (8 * i);
+  }
+  return value;
+}
+
+}  // namespace
+
+bool IsOfflineMemoryPlan(const uint8_t* data, size_t size) {
+  return data != nullptr && size >= kOfflineMemoryPlanIdentifierSize &&
+         std::memcmp(data, kOfflineMemoryPlanIdentifier,
+                     kOfflineMemoryPlanIdentifierSize) == 0;
+}
+
+TfLiteStatus DeserializeOfflineMemoryPlan(const uint8_t* data, size_t size,
+                                          ErrorReporter* error_reporter,
+                                          OfflineMemoryPlan* plan) {
+  if (!IsOfflineMemoryPlan(data, size) || size < kHeaderSize) {
+    error_reporter->Report("Buffer doesn't hold an offline memory plan.");
+    return kTfLiteError;
+  }
+  const uint8_t* header = data + kOfflineMemoryPlanIdentifierSize;
+  const uint64_t num_tensors = ReadLittleEndian(header, 4);
+  const uint64_t reserved = ReadLittleEndian(header + 4, 4);
+  const int64_t arena_size =
+      static_cast<int64_t>(ReadLittleEndian(header + 8, 8));
+  if (reserved != 0 || arena_size < 0 ||
+      size != kHeaderSize + num_tensors * kTensorEntrySize) {
+    error_reporter->Report("Malformed offline memory plan.");
+    return kTfLiteError;
+  }
+
+  plan->arena_size = arena_size;
+  plan->offsets.resize(num_tensors);
+  plan->sizes.resize(num_tensors);
+  const uint8_t* entry = data + kHeaderSize;
+  for (uint64_t i = 0; i < num_tensors; ++i, entry += kTensorEntrySize) {
+    const int64_t offset = static_cast<int64_t>(ReadLittleEndian(entry, 8));
+    const int64_t tensor_size =
+        static_cast<int64_t>(ReadLittleEndian(entry + 8, 8));
+    if (offset < -1 || tensor_size < 0 ||
+        (offset >= 0 &&
+         (offset > arena_size || tensor_size > arena_size - offset))) {
+      error_reporter->Report(
+          "Offline memory plan places tensor %d outside of the arena.",
+          static_cast<int>(i));
+      return kTfLiteError;
+    }
+    plan->offsets[i] = offset;
+    plan->sizes[i] = tensor_size;
+  }
+  return kTfLiteOk;
+}
+
+std::vector<uint8_t> SerializeOfflineMemoryPlan(const OfflineMemoryPlan& plan) {
+  std::vector<uint8_t> buffer(
+      kOfflineMemoryPlanIdentifier,
+      kOfflineMemoryPlanIdentifier + kOfflineMemoryPlanIdentifierSize);
+  buffer.reserve(kHeaderSize + plan.offsets.size() * kTensorEntrySize);
+  AppendLittleEndian(plan.offsets.size(), 4, &buffer);
+  AppendLittleEndian(0, 4, &buffer);
+  AppendLittleEndian(plan.arena_size, 8, &buffer);
+  for (size_t i = 0; i < plan.offsets.size(); ++i) {
+    AppendLittleEndian(plan.offsets[i], 8, &buffer);
+    AppendLittleEndian(plan.sizes[i], 8, &buffer);
+  }
+  return buffer;
+}
+
+}  // namespace tflite
@@ -0,0 +1,60 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CONTRIB_LITE_OFFLINE_MEMORY_PLAN_H_
+#define TENSORFLOW_CONTRIB_LITE_OFFLINE_MEMORY_PLAN_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "tensorflow/contrib/lite/c/c_api_internal.h"
+#include "tensorflow/contrib/lite/core/api/error_reporter.h"
+
+namespace tflite {
+
+// A layout of the kTfLiteArenaRw tensors of a graph, computed ahead of time
+// so that the ArenaPlanner doesn't have to place them one by one when
+// tensors are allocated. Plans are stored in the model as a metadata buffer.
+// WARNING: This is an experimental interface that is subject to change.
+struct OfflineMemoryPlan {
+  // Size in bytes of the arena holding the kTfLiteArenaRw tensors.
+  int64_t arena_size = 0;
+  // For each tensor of the graph, its offset in the arena and the number of
+  // bytes reserved for it there. Tensors that aren't placed in the arena have
+  // an offset of -1.
+  std::vector<int64_t> offsets;
+  std::vector<int64_t> sizes;
+};
+
+// Eight bytes at the start of a serialized OfflineMemoryPlan, distinguishing
+// it from other metadata buffers.
+constexpr char kOfflineMemoryPlanIdentifier[] = "TFLMPLN1";
+constexpr size_t kOfflineMemoryPlanIdentifierSize = 8;
+
+// Returns whether 'data' holds a serialized OfflineMemoryPlan.
+bool IsOfflineMemoryPlan(const uint8_t* data, size_t size);
+
+// Parses a plan serialized by SerializeOfflineMemoryPlan(). Returns an error
+// if 'data' is malformed.
+TfLiteStatus DeserializeOfflineMemoryPlan(const uint8_t* data, size_t size,
+                                          ErrorReporter* error_reporter,
+                                          OfflineMemoryPlan* plan);
+
+// Serializes 'plan' into a buffer that can be stored in the model.
+std::vector<uint8_t> SerializeOfflineMemoryPlan(const OfflineMemoryPlan& plan);
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_CONTRIB_LITE_OFFLINE_MEMORY_PLAN_H_
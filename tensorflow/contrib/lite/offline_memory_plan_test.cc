@@ -0,0 +1,106 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/contrib/lite/offline_memory_plan.h"
+
+#include <limits>
+
+#include <gtest/gtest.h>
+#include "tensorflow/contrib/lite/testing/util.h"
+
+namespace tflite {
+namespace {
+
+class TestErrorReporter : public ErrorReporter {
+ public:
+  int Report(const char* format, va_list args) override {
+    ++num_calls_;
+    return 0;
+  }
+  int num_calls() const { return num_calls_; }
+
+ private:
+  int num_calls_ = 0;
+};
+
+OfflineMemoryPlan MakePlan() {
+  OfflineMemoryPlan plan;
+  plan.arena_size = 1 << 20;
+  plan.offsets = {0, -1, 64, (1 << 20) - 4};
+  plan.sizes = {60, 0, 1000, 4};
+  return plan;
+}
+
+TEST(OfflineMemoryPlanTest, RoundTrip) {
+  const OfflineMemoryPlan plan = MakePlan();
+  std::vector<uint8_t> buffer = SerializeOfflineMemoryPlan(plan);
+  ASSERT_TRUE(IsOfflineMemoryPlan(buffer.data(), buffer.size()));
+
+  TestErrorReporter reporter;
+  OfflineMemoryPlan parsed;
+  ASSERT_EQ(DeserializeOfflineMemoryPlan(buffer.data(), buffer.size(),
+                                         &reporter, &parsed),
+            kTfLiteOk);
+  EXPECT_EQ(parsed.arena_size, plan.arena_size);
+  EXPECT_EQ(parsed.offsets, plan.offsets);
+  EXPECT_EQ(parsed.sizes, plan.sizes);
+  EXPECT_EQ(reporter.num_calls(), 0);
+}
+
+TEST(OfflineMemoryPlanTest, OtherMetadata) {
+  const std::string other = "min_runtime_version";
+  EXPECT_FALSE(IsOfflineMemoryPlan(
+      reinterpret_cast<const uint8_t*>(other.data()), other.size()));
+  EXPECT_FALSE(IsOfflineMemoryPlan(nullptr, 0));
+}
+
+TEST(OfflineMemoryPlanTest, Malformed) {
+  std::vector<uint8_t> buffer = SerializeOfflineMemoryPlan(MakePlan());
+  TestErrorReporter reporter;
+  OfflineMemoryPlan parsed;
+
+  // Truncated.
+  EXPECT_EQ(DeserializeOfflineMemoryPlan(buffer.data(), buffer.size() - 1,
+                                         &reporter, &parsed),
+            kTfLiteError);
+  EXPECT_EQ(DeserializeOfflineMemoryPlan(buffer.data(), 10, &reporter,
+                                         &parsed),
+            kTfLiteError);
+
+  // A tensor outside of the arena.
+  OfflineMemoryPlan plan = MakePlan();
+  plan.sizes[3] = 8;
+  buffer = SerializeOfflineMemoryPlan(plan);
+  EXPECT_EQ(DeserializeOfflineMemoryPlan(buffer.data(), buffer.size(),
+                                         &reporter, &parsed),
+            kTfLiteError);
+
+  // A tensor whose end doesn't fit in an int64_t.
+  plan = MakePlan();
+  plan.sizes[3] = std::numeric_limits<int64_t>::max();
+  buffer = SerializeOfflineMemoryPlan(plan);
+  EXPECT_EQ(DeserializeOfflineMemoryPlan(buffer.data(), buffer.size(),
+                                         &reporter, &parsed),
+            kTfLiteError);
+  EXPECT_EQ(reporter.num_calls(), 4);
+}
+
+}  // namespace
+}  // namespace tflite
+
+int main(int argc, char** argv) {
+  ::tflite::LogToStderr();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
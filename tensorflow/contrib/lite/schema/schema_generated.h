@@ -25,6 +25,9 @@ namespace tflite {
 struct QuantizationParameters;
 struct QuantizationParametersT;
 
+struct BlockSparsityParameters;
+struct BlockSparsityParametersT;
+
 struct Tensor;
 struct TensorT;
 
@@ -2128,6 +2131,110 @@ inline flatbuffers::Offset<QuantizationParameters> CreateQuantizationParametersD
 
 flatbuffers::Offset<QuantizationParameters> CreateQuantizationParameters(flatbuffers::FlatBufferBuilder &_fbb, const QuantizationParametersT *_o, const flatbuffers::rehasher_function_t *_rehasher = nullptr);
 
+struct BlockSparsityParametersT : public flatbuffers::NativeTable {
+  typedef BlockSparsityParameters TableType;
+  int32_t block_rows;
+  int32_t block_cols;
+  std::vector<int32_t> row_ptr;
+  std::vector<int32_t> col_indices;
+  BlockSparsityParametersT()
+      : block_rows(0),
+        block_cols(0) {
+  }
+};
+
+struct BlockSparsityParameters FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
+  typedef BlockSparsityParametersT NativeTableType;
+  enum {
+    VT_BLOCK_ROWS = 4,
+    VT_BLOCK_COLS = 6,
+    VT_ROW_PTR = 8,
+    VT_COL_INDICES = 10
+  };
+  int32_t block_rows() const {
+    return GetField<int32_t>(VT_BLOCK_ROWS, 0);
+  }
+  int32_t block_cols() const {
+    return GetField<int32_t>(VT_BLOCK_COLS, 0);
+  }
+  const flatbuffers::Vector<int32_t> *row_ptr() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_ROW_PTR);
+  }
+  const flatbuffers::Vector<int32_t> *col_indices() const {
+    return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_COL_INDICES);
+  }
+  bool Verify(flatbuffers::Verifier &verifier) const {
+    return VerifyTableStart(verifier) &&
+           VerifyField<int32_t>(verifier, VT_BLOCK_ROWS) &&
+           VerifyField<int32_t>(verifier, VT_BLOCK_COLS) &&
+           VerifyOffset(verifier, VT_ROW_PTR) &&
+           verifier.VerifyVector(row_ptr()) &&
+           VerifyOffset(verifier, VT_COL_INDICES) &&
+           verifier.VerifyVector(col_indices()) &&
+           verifier.EndTable();
+  }
+  BlockSparsityParametersT *UnPack(const flatbuffers::resolver_function_t *_resolver = nullptr) const;
+  void UnPackTo(BlockSparsityParametersT *_o, const flatbuffers::resolver_function_t *_resolver = nullptr) const;
+  static flatbuffers::Offset<BlockSparsityParameters> Pack(flatbuffers::FlatBufferBuilder &_fbb, const BlockSparsityParametersT* _o, const flatbuffers::rehasher_function_t *_rehasher = nullptr);
+};
+
+struct BlockSparsityParametersBuilder {
+  flatbuffers::FlatBufferBuilder &fbb_;
+  flatbuffers::uoffset_t start_;
+  void add_block_rows(int32_t block_rows) {
+    fbb_.AddElement<int32_t>(BlockSparsityParameters::VT_BLOCK_ROWS, block_rows, 0);
+  }
+  void add_block_cols(int32_t block_cols) {
+    fbb_.AddElement<int32_t>(BlockSparsityParameters::VT_BLOCK_COLS, block_cols, 0);
+  }
+  void add_row_ptr(flatbuffers::Offset<flatbuffers::Vector<int32_t>> row_ptr) {
+    fbb_.AddOffset(BlockSparsityParameters::VT_ROW_PTR, row_ptr);
+  }
+  void add_col_indices(flatbuffers::Offset<flatbuffers::Vector<int32_t>> col_indices) {
+    fbb_.AddOffset(BlockSparsityParameters::VT_COL_INDICES, col_indices);
+  }
+  explicit BlockSparsityParametersBuilder(flatbuffers::FlatBufferBuilder &_fbb)
+        : fbb_(_fbb) {
+    start_ = fbb_.StartTable();
+  }
+  BlockSparsityParametersBuilder &operator=(const BlockSparsityParametersBuilder &);
+  flatbuffers::Offset<BlockSparsityParameters> Finish() {
+    const auto end = fbb_.EndTable(start_);
+    auto o = flatbuffers::Offset<BlockSparsityParameters>(end);
+    return o;
+  }
+};
+
+inline flatbuffers::Offset<BlockSparsityParameters> CreateBlockSparsityParameters(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    int32_t block_rows = 0,
+    int32_t block_cols = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> row_ptr = 0,
+    flatbuffers::Offset<flatbuffers::Vector<int32_t>> col_indices = 0) {
+  BlockSparsityParametersBuilder builder_(_fbb);
+  builder_.add_col_indices(col_indices);
+  builder_.add_row_ptr(row_ptr);
+  builder_.add_block_cols(block_cols);
+  builder_.add_block_rows(block_rows);
+  return builder_.Finish();
+}
+
+inline flatbuffers::Offset<BlockSparsityParameters> CreateBlockSparsityParametersDirect(
+    flatbuffers::FlatBufferBuilder &_fbb,
+    int32_t block_rows = 0,
+    int32_t block_cols = 0,
+    const std::vector<int32_t> *row_ptr = nullptr,
+    const std::vector<int32_t> *col_indices = nullptr) {
+  return tflite::CreateBlockSparsityParameters(
+      _fbb,
+      block_rows,
+      block_cols,
+      row_ptr ? _fbb.CreateVector<int32_t>(*row_ptr) : 0,
+      col_indices ? _fbb.CreateVector<int32_t>(*col_indices) : 0);
+}
+
+flatbuffers::Offset<BlockSparsityParameters> CreateBlockSparsityParameters(flatbuffers::FlatBufferBuilder &_fbb, const BlockSparsityParametersT *_o, const flatbuffers::rehasher_function_t *_rehasher = nullptr);
+
 struct TensorT : public flatbuffers::NativeTable {
   typedef Tensor TableType;
   std::vector<int32_t> shape;
@@ -2136,6 +2243,7 @@ struct TensorT : public flatbuffers::NativeTable {
   std::string name;
   std::unique_ptr<QuantizationParametersT> quantization;
   bool is_variable;
+  std::unique_ptr<BlockSparsityParametersT> sparsity;
   TensorT()
       : type(TensorType_FLOAT32),
         buffer(0),
@@ -2151,7 +2259,8 @@ struct Tensor FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
     VT_BUFFER = 8,
     VT_NAME = 10,
     VT_QUANTIZATION = 12,
-    VT_IS_VARIABLE = 14
+    VT_IS_VARIABLE = 14,
+    VT_SPARSITY = 16
   };
   const flatbuffers::Vector<int32_t> *shape() const {
     return GetPointer<const flatbuffers::Vector<int32_t> *>(VT_SHAPE);
@@ -2171,6 +2280,9 @@ struct Tensor FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
   bool is_variable() const {
     return GetField<uint8_t>(VT_IS_VARIABLE, 0) != 0;
   }
+  const BlockSparsityParameters *sparsity() const {
+    return GetPointer<const BlockSparsityParameters *>(VT_SPARSITY);
+  }
   bool Verify(flatbuffers::Verifier &verifier) const {
     return VerifyTableStart(verifier) &&
            VerifyOffset(verifier, VT_SHAPE) &&
@@ -2182,6 +2294,8 @@ struct Tensor FLATBUFFERS_FINAL_CLASS : private flatbuffers::Table {
            VerifyOffset(verifier, VT_QUANTIZATION) &&
            verifier.VerifyTable(quantization()) &&
            VerifyField<uint8_t>(verifier, VT_IS_VARIABLE) &&
+           VerifyOffset(verifier, VT_SPARSITY) &&
+           verifier.VerifyTable(sparsity()) &&
            verifier.EndTable();
   }
   TensorT *UnPack(const flatbuffers::resolver_function_t *_resolver = nullptr) const;
@@ -2210,6 +2324,9 @@ struct TensorBuilder {
   void add_is_variable(bool is_variable) {
     fbb_.AddElement<uint8_t>(Tensor::VT_IS_VARIABLE, static_cast<uint8_t>(is_variable), 0);
   }
+  void add_sparsity(flatbuffers::Offset<BlockSparsityParameters> sparsity) {
+    fbb_.AddOffset(Tensor::VT_SPARSITY, sparsity);
+  }
   explicit TensorBuilder(flatbuffers::FlatBufferBuilder &_fbb)
         : fbb_(_fbb) {
     start_ = fbb_.StartTable();
@@ -2229,8 +2346,10 @@ inline flatbuffers::Offset<Tensor> CreateTensor(
     uint32_t buffer = 0,
     flatbuffers::Offset<flatbuffers::String> name = 0,
     flatbuffers::Offset<QuantizationParameters> quantization = 0,
-    bool is_variable = false) {
+    bool is_variable = false,
+    flatbuffers::Offset<BlockSparsityParameters> sparsity = 0) {
   TensorBuilder builder_(_fbb);
+  builder_.add_sparsity(sparsity);
   builder_.add_quantization(quantization);
   builder_.add_name(name);
   builder_.add_buffer(buffer);
@@ -2247,7 +2366,8 @@ inline flatbuffers::Offset<Tensor> CreateTensorDirect(
     uint32_t buffer = 0,
     const char *name = nullptr,
     flatbuffers::Offset<QuantizationParameters> quantization = 0,
-    bool is_variable = false) {
+    bool is_variable = false,
+    flatbuffers::Offset<BlockSparsityParameters> sparsity = 0) {
   return tflite::CreateTensor(
       _fbb,
       shape ? _fbb.CreateVector<int32_t>(*shape) : 0,
@@ -2255,7 +2375,8 @@ inline flatbuffers::Offset<Tensor> CreateTensorDirect(
       buffer,
       name ? _fbb.CreateString(name) : 0,
       quantization,
-      is_variable);
+      is_variable,
+      sparsity);
 }
 
 flatbuffers::Offset<Tensor> CreateTensor(flatbuffers::FlatBufferBuilder &_fbb, const TensorT *_o, const flatbuffers::rehasher_function_t *_rehasher = nullptr);
@@ -7569,6 +7690,41 @@ inline flatbuffers::Offset<QuantizationParameters> CreateQuantizationParameters(
       _zero_point);
 }
 
+inline BlockSparsityParametersT *BlockSparsityParameters::UnPack(const flatbuffers::resolver_function_t *_resolver) const {
+  auto _o = new BlockSparsityParametersT();
+  UnPackTo(_o, _resolver);
+  return _o;
+}
+
+inline void BlockSparsityParameters::UnPackTo(BlockSparsityParametersT *_o, const flatbuffers::resolver_function_t *_resolver) const {
+  (void)_o;
+  (void)_resolver;
+  { auto _e = block_rows(); _o->block_rows = _e; };
+  { auto _e = block_cols(); _o->block_cols = _e; };
+  { auto _e = row_ptr(); if (_e) { _o->row_ptr.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->row_ptr[_i] = _e->Get(_i); } } };
+  { auto _e = col_indices(); if (_e) { _o->col_indices.resize(_e->size()); for (flatbuffers::uoffset_t _i = 0; _i < _e->size(); _i++) { _o->col_indices[_i] = _e->Get(_i); } } };
+}
+
+inline flatbuffers::Offset<BlockSparsityParameters> BlockSparsityParameters::Pack(flatbuffers::FlatBufferBuilder &_fbb, const BlockSparsityParametersT* _o, const flatbuffers::rehasher_function_t *_rehasher) {
+  return CreateBlockSparsityParameters(_fbb, _o, _rehasher);
+}
+
+inline flatbuffers::Offset<BlockSparsityParameters> CreateBlockSparsityParameters(flatbuffers::FlatBufferBuilder &_fbb, const BlockSparsityParametersT *_o, const flatbuffers::rehasher_function_t *_rehasher) {
+  (void)_rehasher;
+  (void)_o;
+  struct _VectorArgs { flatbuffers::FlatBufferBuilder *__fbb; const BlockSparsityParametersT* __o; const flatbuffers::rehasher_function_t *__rehasher; } _va = { &_fbb, _o, _rehasher}; (void)_va;
+  auto _block_rows = _o->block_rows;
+  auto _block_cols = _o->block_cols;
+  auto _row_ptr = _o->row_ptr.size() ? _fbb.CreateVector(_o->row_ptr) : 0;
+  auto _col_indices = _o->col_indices.size() ? _fbb.CreateVector(_o->col_indices) : 0;
+  return tflite::CreateBlockSparsityParameters(
+      _fbb,
+      _block_rows,
+      _block_cols,
+      _row_ptr,
+      _col_indices);
+}
+
 inline TensorT *Tensor::UnPack(const flatbuffers::resolver_function_t *_resolver) const {
   auto _o = new TensorT();
   UnPackTo(_o, _resolver);
@@ -7584,6 +7740,7 @@ inline void Tensor::UnPackTo(TensorT *_o, const flatbuffers::resolver_function_t
   { auto _e = name(); if (_e) _o->name = _e->str(); };
   { auto _e = quantization(); if (_e) _o->quantization = std::unique_ptr<QuantizationParametersT>(_e->UnPack(_resolver)); };
   { auto _e = is_variable(); _o->is_variable = _e; };
+  { auto _e = sparsity(); if (_e) _o->sparsity = std::unique_ptr<BlockSparsityParametersT>(_e->UnPack(_resolver)); };
 }
 
 inline flatbuffers::Offset<Tensor> Tensor::Pack(flatbuffers::FlatBufferBuilder &_fbb, const TensorT* _o, const flatbuffers::rehasher_function_t *_rehasher) {
@@ -7600,6 +7757,7 @@ inline flatbuffers::Offset<Tensor> CreateTensor(flatbuffers::FlatBufferBuilder &
   auto _name = _o->name.empty() ? 0 : _fbb.CreateString(_o->name);
   auto _quantization = _o->quantization ? CreateQuantizationParameters(_fbb, _o->quantization.get(), _rehasher) : 0;
   auto _is_variable = _o->is_variable;
+  auto _sparsity = _o->sparsity ? CreateBlockSparsityParameters(_fbb, _o->sparsity.get(), _rehasher) : 0;
   return tflite::CreateTensor(
       _fbb,
       _shape,
@@ -7607,7 +7765,8 @@ inline flatbuffers::Offset<Tensor> CreateTensor(flatbuffers::FlatBufferBuilder &
       _buffer,
       _name,
       _quantization,
-      _is_variable);
+      _is_variable,
+      _sparsity);
 }
 
 inline Conv2DOptionsT *Conv2DOptions::UnPack(const flatbuffers::resolver_function_t *_resolver) const {
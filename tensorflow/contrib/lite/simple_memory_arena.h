@@ -15,6 +15,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CONTRIB_LITE_SIMPLE_MEMORY_ARENA_H_
 #define TENSORFLOW_CONTRIB_LITE_SIMPLE_MEMORY_ARENA_H_
 
+#include <algorithm>
 #include <list>
 #include <memory>
 #include "tensorflow/contrib/lite/c/c_api_internal.h"
@@ -55,6 +56,12 @@ class SimpleMemoryArena {
 
   TfLiteStatus Deallocate(TfLiteContext* context, const ArenaAlloc& alloc);
 
+  // Makes sure the arena spans at least 'size' bytes, for allocations that
+  // were placed ahead of time instead of by Allocate().
+  void ReserveAtLeast(size_t size) {
+    high_water_mark_ = std::max(high_water_mark_, size);
+  }
+
   inline size_t RequiredBufferSize() {
     // Add in a small amount of padding to reduce the chance of resize events
     // for small allocations.
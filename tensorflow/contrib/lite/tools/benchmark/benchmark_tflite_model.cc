@@ -170,6 +170,8 @@ BenchmarkParams GetDefaultParams() {
   default_params.AddParam("input_layer_shape",
                           BenchmarkParam::Create<std::string>(""));
   default_params.AddParam("use_nnapi", BenchmarkParam::Create<bool>(false));
+  default_params.AddParam("num_inter_op_threads",
+                          BenchmarkParam::Create<int32_t>(1));
   return default_params;
 }
 
@@ -192,7 +194,9 @@ std::vector<Flag> BenchmarkTfLiteModel::GetFlags() {
       CreateFlag<std::string>("input_layer", &params_, "input layer names"),
       CreateFlag<std::string>("input_layer_shape", &params_,
                               "input layer shape"),
-      CreateFlag<bool>("use_nnapi", &params_, "use nnapi api")};
+      CreateFlag<bool>("use_nnapi", &params_, "use nnapi api"),
+      CreateFlag<int32_t>("num_inter_op_threads", &params_,
+                          "number of threads running independent ops")};
 
   flags.insert(flags.end(), specific_flags.begin(), specific_flags.end());
   return flags;
@@ -206,6 +210,8 @@ void BenchmarkTfLiteModel::LogParams() {
   TFLITE_LOG(INFO) << "Input shapes: ["
                    << params_.Get<std::string>("input_layer_shape") << "]";
   TFLITE_LOG(INFO) << "Use nnapi : [" << params_.Get<bool>("use_nnapi") << "]";
+  TFLITE_LOG(INFO) << "Num inter-op threads: ["
+                   << params_.Get<int32_t>("num_inter_op_threads") << "]";
 }
 
 bool BenchmarkTfLiteModel::ValidateParams() {
@@ -298,6 +304,12 @@ void BenchmarkTfLiteModel::Init() {
     interpreter->SetNumThreads(num_threads);
   }
 
+  const int32_t num_inter_op_threads =
+      params_.Get<int32_t>("num_inter_op_threads");
+  if (interpreter->SetNumInterOpThreads(num_inter_op_threads) != kTfLiteOk) {
+    TFLITE_LOG(FATAL) << "Failed to set the number of inter-op threads";
+  }
+
   bool use_nnapi = params_.Get<bool>("use_nnapi");
 
   interpreter->UseNNAPI(use_nnapi);
@@ -333,6 +345,29 @@ void BenchmarkTfLiteModel::Init() {
   if (interpreter->AllocateTensors() != kTfLiteOk) {
     TFLITE_LOG(FATAL) << "Failed to allocate tensors!";
   }
+
+  // Report block-sparse weights, whose density bounds the speedup of the
+  // sparse kernels over the dense ones.
+  int num_sparse_tensors = 0;
+  int64_t stored_blocks = 0;
+  int64_t total_blocks = 0;
+  for (int i = 0; i < interpreter->tensors_size(); ++i) {
+    const TfLiteTensor* t = interpreter->tensor(i);
+    if (t->sparsity == nullptr) continue;
+    const TfLiteBlockSparsity& sparsity = *t->sparsity;
+    int64_t num_elements = 1;
+    for (int d = 0; d < t->dims->size; ++d) num_elements *= t->dims->data[d];
+    const int num_block_rows = t->dims->data[0] / sparsity.block_rows;
+    ++num_sparse_tensors;
+    stored_blocks += sparsity.row_ptr[num_block_rows];
+    total_blocks += num_elements / (sparsity.block_rows * sparsity.block_cols);
+  }
+  if (num_sparse_tensors > 0) {
+    TFLITE_LOG(INFO) << "Block-sparse tensors: " << num_sparse_tensors
+                     << ", stored blocks: " << stored_blocks << " of "
+                     << total_blocks << " ("
+                     << 100.0 * stored_blocks / total_blocks << "%)";
+  }
 }
 
 void BenchmarkTfLiteModel::RunImpl() {
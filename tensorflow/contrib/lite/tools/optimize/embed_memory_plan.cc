@@ -0,0 +1,73 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/contrib/lite/tools/optimize/embed_memory_plan.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/contrib/lite/interpreter.h"
+#include "tensorflow/contrib/lite/offline_memory_plan.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tflite {
+namespace optimize {
+
+TfLiteStatus EmbedMemoryPlan(flatbuffers::FlatBufferBuilder* builder,
+                             const Model* input_model,
+                             const OpResolver& op_resolver) {
+  std::unique_ptr<Interpreter> interpreter;
+  if (InterpreterBuilder(input_model, op_resolver)(&interpreter) !=
+      kTfLiteOk) {
+    LOG(ERROR) << "Failed to build the interpreter.";
+    return kTfLiteError;
+  }
+  // Plan the model as it is stored, not with a plan it may already hold.
+  interpreter->SetOfflineMemoryPlan(nullptr);
+  if (interpreter->AllocateTensors() != kTfLiteOk) {
+    LOG(ERROR) << "Failed to allocate tensors.";
+    return kTfLiteError;
+  }
+  OfflineMemoryPlan plan;
+  TF_LITE_ENSURE_STATUS(interpreter->CreateOfflineMemoryPlan(&plan));
+  LOG(INFO) << "Offline memory plan uses " << plan.arena_size
+            << " bytes for " << plan.offsets.size() << " tensors.";
+
+  std::unique_ptr<ModelT> model(input_model->UnPack());
+
+  // Replace a plan embedded earlier, if any.
+  int plan_buffer_index = -1;
+  for (int buffer_index : model->metadata_buffer) {
+    const std::vector<uint8_t>& data = model->buffers[buffer_index]->data;
+    if (IsOfflineMemoryPlan(data.data(), data.size())) {
+      plan_buffer_index = buffer_index;
+      break;
+    }
+  }
+  if (plan_buffer_index < 0) {
+    plan_buffer_index = model->buffers.size();
+    model->buffers.emplace_back(new BufferT);
+    model->metadata_buffer.push_back(plan_buffer_index);
+  }
+  model->buffers[plan_buffer_index]->data = SerializeOfflineMemoryPlan(plan);
+
+  flatbuffers::Offset<Model> output_model_location =
+      Model::Pack(*builder, model.get());
+  FinishModelBuffer(*builder, output_model_location);
+
+  return kTfLiteOk;
+}
+
+}  // namespace optimize
+}  // namespace tflite
@@ -0,0 +1,42 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CONTRIB_LITE_TOOLS_OPTIMIZE_EMBED_MEMORY_PLAN_H_
+#define TENSORFLOW_CONTRIB_LITE_TOOLS_OPTIMIZE_EMBED_MEMORY_PLAN_H_
+
+#include "tensorflow/contrib/lite/context.h"
+#include "tensorflow/contrib/lite/model.h"
+#include "tensorflow/contrib/lite/core/api/op_resolver.h"
+#include "tensorflow/contrib/lite/schema/schema_generated.h"
+
+namespace tflite {
+namespace optimize {
+
+// Computes a layout of the arena tensors of input_model ahead of time and
+// populates the provided builder with a copy of the model that holds it as a
+// metadata buffer. The InterpreterBuilder hands the layout to the
+// interpreter, which uses it instead of placing tensors one at a time as long
+// as the input shapes match the ones stored in the model.
+//
+// A tflite::Model can be obtained from the builder with:
+//   const uint8_t* buffer = builder->GetBufferPointer();
+//   tflite::Model* model = GetModel(buffer);
+TfLiteStatus EmbedMemoryPlan(flatbuffers::FlatBufferBuilder* builder,
+                             const Model* input_model,
+                             const OpResolver& op_resolver);
+
+}  // namespace optimize
+}  // namespace tflite
+
+#endif  // TENSORFLOW_CONTRIB_LITE_TOOLS_OPTIMIZE_EMBED_MEMORY_PLAN_H_
@@ -0,0 +1,187 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/contrib/lite/tools/optimize/embed_memory_plan.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "tensorflow/contrib/lite/interpreter.h"
+#include "tensorflow/contrib/lite/kernels/register.h"
+#include "tensorflow/contrib/lite/model.h"
+#include "tensorflow/contrib/lite/offline_memory_plan.h"
+#include "tensorflow/contrib/lite/schema/schema_generated.h"
+#include "tensorflow/contrib/lite/testing/util.h"
+
+namespace tflite {
+namespace optimize {
+namespace {
+
+constexpr int kNumTensors = 4;
+
+// Returns a model of three chained ADDs of a [1, 256] float input to itself,
+// so that its tensors have overlapping and disjoint lifetimes.
+std::unique_ptr<ModelT> CreateAddChainModel() {
+  std::unique_ptr<ModelT> model(new ModelT);
+  model->version = TFLITE_SCHEMA_VERSION;
+  model->operator_codes.emplace_back(new OperatorCodeT);
+  model->operator_codes[0]->builtin_code = BuiltinOperator_ADD;
+  // Buffer 0 is the empty buffer of tensors without data.
+  model->buffers.emplace_back(new BufferT);
+
+  std::unique_ptr<SubGraphT> subgraph(new SubGraphT);
+  for (int i = 0; i < kNumTensors; ++i) {
+    std::unique_ptr<TensorT> tensor(new TensorT);
+    tensor->shape = {1, 256};
+    tensor->type = TensorType_FLOAT32;
+    tensor->buffer = 0;
+    subgraph->tensors.push_back(std::move(tensor));
+  }
+  for (int i = 0; i + 1 < kNumTensors; ++i) {
+    std::unique_ptr<OperatorT> op(new OperatorT);
+    op->opcode_index = 0;
+    op->inputs = {i, i};
+    op->outputs = {i + 1};
+    op->builtin_options.Set(AddOptionsT());
+    subgraph->operators.push_back(std::move(op));
+  }
+  subgraph->inputs = {0};
+  subgraph->outputs = {kNumTensors - 1};
+  model->subgraphs.push_back(std::move(subgraph));
+  return model;
+}
+
+// Returns the buffer of 'model' holding an offline memory plan, if any.
+BufferT* FindPlanBuffer(ModelT* model) {
+  for (int buffer_index : model->metadata_buffer) {
+    BufferT* buffer = model->buffers[buffer_index].get();
+    if (IsOfflineMemoryPlan(buffer->data.data(), buffer->data.size())) {
+      return buffer;
+    }
+  }
+  return nullptr;
+}
+
+// Checks that the arena tensors of 'interpreter' are laid out as in 'plan'.
+void ExpectTensorsPlacedAsIn(const Interpreter& interpreter,
+                             const OfflineMemoryPlan& plan) {
+  ASSERT_EQ(plan.offsets.size(), interpreter.tensors_size());
+  ASSERT_GE(plan.offsets[0], 0);
+  const char* base = interpreter.tensor(0)->data.raw - plan.offsets[0];
+  for (int i = 0; i < interpreter.tensors_size(); ++i) {
+    ASSERT_GE(plan.offsets[i], 0);
+    EXPECT_EQ(interpreter.tensor(i)->data.raw - base, plan.offsets[i])
+        << "tensor " << i;
+  }
+}
+
+class EmbedMemoryPlanTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    std::unique_ptr<ModelT> model = CreateAddChainModel();
+    flatbuffers::FlatBufferBuilder input_builder;
+    FinishModelBuffer(input_builder, Model::Pack(input_builder, model.get()));
+    ASSERT_EQ(EmbedMemoryPlan(&builder_,
+                              GetModel(input_builder.GetBufferPointer()),
+                              resolver_),
+              kTfLiteOk);
+    model_.reset(GetModel(builder_.GetBufferPointer())->UnPack());
+  }
+
+  // Returns an interpreter of 'model' with its tensors allocated.
+  std::unique_ptr<Interpreter> AllocateInterpreter(const Model* model) {
+    std::unique_ptr<Interpreter> interpreter;
+    EXPECT_EQ(InterpreterBuilder(model, resolver_)(&interpreter), kTfLiteOk);
+    EXPECT_NE(interpreter, nullptr);
+    if (interpreter != nullptr) {
+      EXPECT_EQ(interpreter->AllocateTensors(), kTfLiteOk);
+    }
+    return interpreter;
+  }
+
+  ops::builtin::BuiltinOpResolver resolver_;
+  flatbuffers::FlatBufferBuilder builder_;
+  // The model with the embedded plan, unpacked.
+  std::unique_ptr<ModelT> model_;
+};
+
+TEST_F(EmbedMemoryPlanTest, ArenaPlannerUsesEmbeddedOffsets) {
+  BufferT* plan_buffer = FindPlanBuffer(model_.get());
+  ASSERT_NE(plan_buffer, nullptr);
+  OfflineMemoryPlan plan;
+  ASSERT_EQ(DeserializeOfflineMemoryPlan(plan_buffer->data.data(),
+                                         plan_buffer->data.size(),
+                                         DefaultErrorReporter(), &plan),
+            kTfLiteOk);
+  ASSERT_EQ(plan.offsets.size(), kNumTensors);
+  // The first and third ADDs have no tensor in common, so the plan reuses
+  // memory and takes less than one buffer per tensor.
+  EXPECT_LT(plan.arena_size, kNumTensors * 1024);
+
+  std::unique_ptr<Interpreter> interpreter =
+      AllocateInterpreter(GetModel(builder_.GetBufferPointer()));
+  ASSERT_NE(interpreter, nullptr);
+  ExpectTensorsPlacedAsIn(*interpreter, plan);
+}
+
+TEST_F(EmbedMemoryPlanTest, ArenaPlannerFollowsAnEditedPlan) {
+  BufferT* plan_buffer = FindPlanBuffer(model_.get());
+  ASSERT_NE(plan_buffer, nullptr);
+  OfflineMemoryPlan plan;
+  ASSERT_EQ(DeserializeOfflineMemoryPlan(plan_buffer->data.data(),
+                                         plan_buffer->data.size(),
+                                         DefaultErrorReporter(), &plan),
+            kTfLiteOk);
+  // Spreading the tensors out keeps the plan valid, but online placement
+  // would not pick these offsets.
+  for (int64_t& offset : plan.offsets) offset *= 2;
+  plan.arena_size *= 2;
+  plan_buffer->data = SerializeOfflineMemoryPlan(plan);
+  flatbuffers::FlatBufferBuilder builder;
+  FinishModelBuffer(builder, Model::Pack(builder, model_.get()));
+
+  std::unique_ptr<Interpreter> interpreter =
+      AllocateInterpreter(GetModel(builder.GetBufferPointer()));
+  ASSERT_NE(interpreter, nullptr);
+  ExpectTensorsPlacedAsIn(*interpreter, plan);
+
+  // The model still computes the same values.
+  float* input = interpreter->typed_input_tensor<float>(0);
+  for (int i = 0; i < 256; ++i) input[i] = i;
+  ASSERT_EQ(interpreter->Invoke(), kTfLiteOk);
+  const float* output = interpreter->typed_output_tensor<float>(0);
+  for (int i = 0; i < 256; ++i) EXPECT_EQ(output[i], 8 * i);
+}
+
+TEST_F(EmbedMemoryPlanTest, ReplacesAnEmbeddedPlan) {
+  flatbuffers::FlatBufferBuilder builder;
+  ASSERT_EQ(EmbedMemoryPlan(&builder, GetModel(builder_.GetBufferPointer()),
+                            resolver_),
+            kTfLiteOk);
+  std::unique_ptr<ModelT> model(
+      GetModel(builder.GetBufferPointer())->UnPack());
+  EXPECT_EQ(model->metadata_buffer.size(), 1);
+  EXPECT_EQ(model->buffers.size(), model_->buffers.size());
+}
+
+}  // namespace
+}  // namespace optimize
+}  // namespace tflite
+
+int main(int argc, char** argv) {
+  ::tflite::LogToStderr();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
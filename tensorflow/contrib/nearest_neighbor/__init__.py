@@ -25,6 +25,11 @@ The following ops generate multiprobe sequences for various hash families.
 
 @@hyperplane_lsh_hash
 
+### Maximum inner product search ops
+
+@@maximum_inner_product_search
+@@IVFIndex
+
 """
 
 from __future__ import absolute_import
@@ -0,0 +1,189 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CONTRIB_NEAREST_NEIGHBOR_KERNELS_MIPS_H_
+#define TENSORFLOW_CONTRIB_NEAREST_NEIGHBOR_KERNELS_MIPS_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace nearest_neighbor {
+
+// Building blocks for maximum inner product search (MIPS). Items are scored
+// against a tile of queries one cache-sized block at a time with an Eigen
+// matrix product, and every block of scores is folded into a running top-k
+// per query, so that the full [num_queries, num_items] score matrix is never
+// materialized.
+
+// Number of items scored at once. A block of scores for a tile of
+// kQueryTileSize queries then takes 32KB for float.
+constexpr int64 kItemBlockSize = 256;
+constexpr int64 kQueryTileSize = 32;
+
+// Scores are compared against the running threshold this many at a time with
+// a branch-free test, so that the common case of a block holding no candidate
+// costs a few vectorized comparisons.
+constexpr int kFilterBlockSize = 16;
+
+// Keeps the k best (score, index) pairs offered so far. Higher scores are
+// better, NaN is worse than any other score, and ties (NaN included) are broken
+// in favor of the lower index so that the result does not depend on the order
+// in which the pairs are offered. k pairs are kept as soon as k were offered,
+// whatever their scores.
+template <typename ScoreType, typename IndexType>
+class TopKAccumulator {
+ public:
+  using Entry = std::pair<ScoreType, IndexType>;
+
+  explicit TopKAccumulator(int64 k) : k_(k) { entries_.reserve(k); }
+
+  // Scores below the threshold cannot enter the top k. Scores equal to it may
+  // still win on their index, and the threshold may be NaN, so callers filter
+  // with !(score < threshold), which NaN passes too, and let Push() decide.
+  ScoreType Threshold() const {
+    return static_cast<int64>(entries_.size()) < k_
+               ? -std::numeric_limits<ScoreType>::infinity()
+               : entries_.front().first;
+  }
+
+  void Push(ScoreType score, IndexType index) {
+    if (k_ == 0) return;
+    if (static_cast<int64>(entries_.size()) < k_) {
+      entries_.emplace_back(score, index);
+      std::push_heap(entries_.begin(), entries_.end(), Better);
+      return;
+    }
+    // The front of the heap is the worst entry kept.
+    if (!Better(Entry(score, index), entries_.front())) return;
+    std::pop_heap(entries_.begin(), entries_.end(), Better);
+    entries_.back() = Entry(score, index);
+    std::push_heap(entries_.begin(), entries_.end(), Better);
+  }
+
+  // Unordered view of the entries kept, e.g. for merging accumulators.
+  const std::vector<Entry>& entries() const { return entries_; }
+
+  int64 size() const { return entries_.size(); }
+
+  // Writes the entries kept to scores[0:size()] and indices[0:size()], best
+  // first, and clears the accumulator.
+  void ExtractSorted(ScoreType* scores, IndexType* indices) {
+    std::sort_heap(entries_.begin(), entries_.end(), Better);
+    for (size_t i = 0; i < entries_.size(); ++i) {
+      scores[i] = entries_[i].first;
+      indices[i] = entries_[i].second;
+    }
+    entries_.clear();
+  }
+
+ private:
+  static bool Better(const Entry& a, const Entry& b) {
+    const bool a_is_nan = std::isnan(a.first);
+    const bool b_is_nan = std::isnan(b.first);
+    if (a_is_nan || b_is_nan) {
+      return a_is_nan == b_is_nan ? a.second < b.second : b_is_nan;
+    }
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+  }
+
+  int64 k_;
+  std::vector<Entry> entries_;
+};
+
+// Offers a row of scores to an accumulator, where scores[j] belongs to index
+// first_index + j.
+template <typename ScoreType, typename IndexType>
+void OfferScores(const ScoreType* scores, int64 num_scores,
+                 IndexType first_index,
+                 TopKAccumulator<ScoreType, IndexType>* accumulator) {
+  ScoreType threshold = accumulator->Threshold();
+  int64 j = 0;
+  for (; j + kFilterBlockSize <= num_scores; j += kFilterBlockSize) {
+    bool any = false;
+    for (int b = 0; b < kFilterBlockSize; ++b) {
+      any |= !(scores[j + b] < threshold);
+    }
+    if (!any) continue;
+    for (int b = 0; b < kFilterBlockSize; ++b) {
+      if (!(scores[j + b] < threshold)) {
+        accumulator->Push(scores[j + b], first_index + j + b);
+        threshold = accumulator->Threshold();
+      }
+    }
+  }
+  for (; j < num_scores; ++j) {
+    if (!(scores[j] < threshold)) {
+      accumulator->Push(scores[j], first_index + j);
+      threshold = accumulator->Threshold();
+    }
+  }
+}
+
+// Scores the queries, a row-major [num_queries, dim] matrix, against the
+// items [item_begin, item_end) of a row-major [num_items, dim] matrix and
+// offers the scores of query i to accumulators[i]. Indices are item rows.
+template <typename T>
+void SearchItemRange(const T* queries, int64 num_queries, const T* items,
+                     int64 item_begin, int64 item_end, int64 dim,
+                     TopKAccumulator<T, int64>* accumulators) {
+  using Matrix =
+      Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+  using ConstMatrixMap = Eigen::Map<const Matrix>;
+  using MatrixMap = Eigen::Map<Matrix>;
+
+  ConstMatrixMap query_map(queries, num_queries, dim);
+  std::vector<T> buffer(num_queries * kItemBlockSize);
+  for (int64 start = item_begin; start < item_end; start += kItemBlockSize) {
+    const int64 block_size = std::min(kItemBlockSize, item_end - start);
+    ConstMatrixMap block(items + start * dim, block_size, dim);
+    MatrixMap scores(buffer.data(), num_queries, block_size);
+    scores.noalias() = query_map * block.transpose();
+    for (int64 i = 0; i < num_queries; ++i) {
+      OfferScores<T, int64>(buffer.data() + i * block_size, block_size,
+                            start, &accumulators[i]);
+    }
+  }
+}
+
+// Quantizes a vector to int8 codes with a single scale, such that
+// x[j] ~= scale * codes[j]. Returns the scale, which is 0 for a zero vector.
+inline float QuantizeToInt8(const float* x, int64 dim, int8* codes) {
+  float max_abs = 0.0f;
+  for (int64 j = 0; j < dim; ++j) {
+    max_abs = std::max(max_abs, std::abs(x[j]));
+  }
+  if (max_abs == 0.0f) {
+    std::fill(codes, codes + dim, 0);
+    return 0.0f;
+  }
+  const float scale = max_abs / 127.0f;
+  const float inverse_scale = 127.0f / max_abs;
+  for (int64 j = 0; j < dim; ++j) {
+    codes[j] = static_cast<int8>(std::round(x[j] * inverse_scale));
+  }
+  return scale;
+}
+
+}  // namespace nearest_neighbor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CONTRIB_NEAREST_NEIGHBOR_KERNELS_MIPS_H_
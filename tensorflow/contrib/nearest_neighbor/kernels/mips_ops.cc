@@ -0,0 +1,446 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "tensorflow/contrib/nearest_neighbor/kernels/mips.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+using errors::InvalidArgument;
+
+using nearest_neighbor::kItemBlockSize;
+using nearest_neighbor::kQueryTileSize;
+using nearest_neighbor::OfferScores;
+using nearest_neighbor::QuantizeToInt8;
+using nearest_neighbor::SearchItemRange;
+using nearest_neighbor::TopKAccumulator;
+
+namespace {
+
+// Splitting the items of a query tile across threads only pays off when each
+// part still spans a good number of item blocks.
+constexpr int64 kMinItemsPerPartition = 16 * kItemBlockSize;
+
+Status CheckMatrix(const Tensor& t, const char* name) {
+  if (!TensorShapeUtils::IsMatrix(t.shape())) {
+    return InvalidArgument(name, " must be 2-D, got shape ",
+                           t.shape().DebugString());
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+// Exact maximum inner product search by brute force. The work is split into
+// tiles of queries times partitions of the items, and the partial top k of the
+// partitions of a query are merged at the end.
+template <typename T>
+class MaximumInnerProductSearchOp : public OpKernel {
+ public:
+  explicit MaximumInnerProductSearchOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& queries = context->input(0);
+    const Tensor& items = context->input(1);
+    const Tensor& k_tensor = context->input(2);
+    OP_REQUIRES_OK(context, CheckMatrix(queries, "queries"));
+    OP_REQUIRES_OK(context, CheckMatrix(items, "items"));
+    OP_REQUIRES(context, queries.dim_size(1) == items.dim_size(1),
+                InvalidArgument("queries and items must have the same number "
+                                "of columns, got ",
+                                queries.dim_size(1), " and ",
+                                items.dim_size(1)));
+    OP_REQUIRES(context, TensorShapeUtils::IsScalar(k_tensor.shape()),
+                InvalidArgument("k must be a scalar, got shape ",
+                                k_tensor.shape().DebugString()));
+    const int64 k = k_tensor.scalar<int32>()();
+    const int64 num_queries = queries.dim_size(0);
+    const int64 num_items = items.dim_size(0);
+    const int64 dim = queries.dim_size(1);
+    OP_REQUIRES(context, k >= 0 && k <= num_items,
+                InvalidArgument("k must be in [0, ", num_items, "], got ", k));
+
+    Tensor* scores_tensor = nullptr;
+    Tensor* indices_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({num_queries, k}),
+                                            &scores_tensor));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(1, TensorShape({num_queries, k}),
+                                            &indices_tensor));
+    if (num_queries == 0 || k == 0) return;
+
+    const T* query_data = queries.flat<T>().data();
+    const T* item_data = items.flat<T>().data();
+    T* scores = scores_tensor->flat<T>().data();
+    int64* indices = indices_tensor->flat<int64>().data();
+
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    const int64 num_tiles = (num_queries + kQueryTileSize - 1) / kQueryTileSize;
+    // Small batches, as in online serving, leave threads idle unless the
+    // items are partitioned as well.
+    const int64 num_partitions = std::max<int64>(
+        1, std::min<int64>(worker_threads->num_threads / num_tiles,
+                           num_items / kMinItemsPerPartition));
+    const int64 items_per_partition =
+        (num_items + num_partitions - 1) / num_partitions;
+
+    using Accumulator = TopKAccumulator<T, int64>;
+    // partials[tile * num_partitions + partition] holds an accumulator per
+    // query of the tile.
+    std::vector<std::vector<Accumulator>> partials(num_tiles * num_partitions);
+    auto search = [&](int64 start, int64 limit) {
+      for (int64 unit = start; unit < limit; ++unit) {
+        const int64 tile = unit / num_partitions;
+        const int64 partition = unit % num_partitions;
+        const int64 query_begin = tile * kQueryTileSize;
+        const int64 tile_size =
+            std::min(kQueryTileSize, num_queries - query_begin);
+        const int64 item_begin = partition * items_per_partition;
+        const int64 item_end =
+            std::min(num_items, item_begin + items_per_partition);
+        std::vector<Accumulator>& accumulators = partials[unit];
+        accumulators.assign(tile_size, Accumulator(k));
+        SearchItemRange<T>(query_data + query_begin * dim, tile_size,
+                           item_data, item_begin, item_end, dim,
+                           accumulators.data());
+      }
+    };
+    const int64 search_cost = kQueryTileSize * items_per_partition * dim;
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          num_tiles * num_partitions, search_cost, search);
+
+    auto merge = [&](int64 start, int64 limit) {
+      for (int64 i = start; i < limit; ++i) {
+        const int64 tile = i / kQueryTileSize;
+        const int64 offset = i % kQueryTileSize;
+        if (num_partitions == 1) {
+          partials[tile][offset].ExtractSorted(scores + i * k, indices + i * k);
+          continue;
+        }
+        Accumulator merged(k);
+        for (int64 p = 0; p < num_partitions; ++p) {
+          for (const auto& entry :
+               partials[tile * num_partitions + p][offset].entries()) {
+            merged.Push(entry.first, entry.second);
+          }
+        }
+        merged.ExtractSorted(scores + i * k, indices + i * k);
+      }
+    };
+    const int64 merge_cost = num_partitions * k * 10;
+    Shard(worker_threads->num_threads, worker_threads->workers, num_queries,
+          merge_cost, merge);
+  }
+};
+
+#define REGISTER_KERNELS(T)                                   \
+  REGISTER_KERNEL_BUILDER(Name("MaximumInnerProductSearch")   \
+                              .Device(DEVICE_CPU)             \
+                              .TypeConstraint<T>("T"),        \
+                          MaximumInnerProductSearchOp<T>);
+
+REGISTER_KERNELS(float);
+REGISTER_KERNELS(double);
+#undef REGISTER_KERNELS
+
+// An inverted-file (IVF) index for approximate maximum inner product search.
+// Every item is assigned to the list of the centroid with which it has the
+// largest inner product, and stored there as int8 codes with a per-item scale.
+// A search scores the centroids, and then only the items of the lists of the
+// best centroids, straight from their codes.
+class IVFIndexResource : public ResourceBase {
+ public:
+  IVFIndexResource() : dim_(0), num_items_(0) {}
+
+  string DebugString() override {
+    tf_shared_lock l(mu_);
+    return strings::StrCat("IVFIndex with ", centroids_.dim_size(0),
+                           " lists holding ", num_items_, " items of ", dim_,
+                           " dimensions");
+  }
+
+  mutex* get_mutex() { return &mu_; }
+
+  // Replaces the contents of the index.
+  void Build(OpKernelContext* context, const Tensor& centroids,
+             const Tensor& items) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Writes the k best items of each query, padded with scores of -infinity
+  // and indices of -1 when the probed lists hold fewer than k items.
+  void Search(OpKernelContext* context, const Tensor& queries, int64 k,
+              int64 num_probes, Tensor* scores_tensor,
+              Tensor* indices_tensor) SHARED_LOCKS_REQUIRED(mu_);
+
+  int64 dim() const SHARED_LOCKS_REQUIRED(mu_) { return dim_; }
+  int64 num_lists() const SHARED_LOCKS_REQUIRED(mu_) {
+    return centroids_.dim_size(0);
+  }
+
+ private:
+  using Matrix = Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic,
+                               Eigen::RowMajor>;
+  using ConstMatrixMap = Eigen::Map<const Matrix>;
+  using MatrixMap = Eigen::Map<Matrix>;
+  using CodeMatrix = Eigen::Matrix<int8, Eigen::Dynamic, Eigen::Dynamic,
+                                   Eigen::RowMajor>;
+  using ConstCodeMatrixMap = Eigen::Map<const CodeMatrix>;
+  using Vector = Eigen::Matrix<float, Eigen::Dynamic, 1>;
+  using ConstVectorMap = Eigen::Map<const Vector>;
+  using VectorMap = Eigen::Map<Vector>;
+
+  mutex mu_;
+  int64 dim_ GUARDED_BY(mu_);
+  int64 num_items_ GUARDED_BY(mu_);
+  // [num_lists, dim_].
+  Tensor centroids_ GUARDED_BY(mu_);
+  // List l holds the positions [list_offsets_[l], list_offsets_[l + 1]) of
+  // the arrays below.
+  std::vector<int64> list_offsets_ GUARDED_BY(mu_);
+  std::vector<int64> item_ids_ GUARDED_BY(mu_);
+  // [num_items_, dim_].
+  std::vector<int8> codes_ GUARDED_BY(mu_);
+  std::vector<float> scales_ GUARDED_BY(mu_);
+};
+
+void IVFIndexResource::Build(OpKernelContext* context, const Tensor& centroids,
+                             const Tensor& items) {
+  const int64 num_lists = centroids.dim_size(0);
+  const int64 num_items = items.dim_size(0);
+  const int64 dim = centroids.dim_size(1);
+  const float* item_data = items.flat<float>().data();
+  ConstMatrixMap centroid_map(centroids.flat<float>().data(), num_lists, dim);
+  auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+
+  // Assigns the items to lists, a block of items at a time.
+  std::vector<int64> assignments(num_items);
+  auto assign = [&](int64 start, int64 limit) {
+    std::vector<float> buffer(kItemBlockSize * num_lists);
+    for (int64 block = start; block < limit; ++block) {
+      const int64 begin = block * kItemBlockSize;
+      const int64 block_size = std::min(kItemBlockSize, num_items - begin);
+      ConstMatrixMap item_block(item_data + begin * dim, block_size, dim);
+      MatrixMap scores(buffer.data(), block_size, num_lists);
+      scores.noalias() = item_block * centroid_map.transpose();
+      for (int64 i = 0; i < block_size; ++i) {
+        Eigen::Index best;
+        scores.row(i).maxCoeff(&best);
+        assignments[begin + i] = best;
+      }
+    }
+  };
+  const int64 num_blocks = (num_items + kItemBlockSize - 1) / kItemBlockSize;
+  Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+        kItemBlockSize * num_lists * dim, assign);
+
+  // Lays the lists out one after the other, keeping the items of a list in
+  // their original order.
+  std::vector<int64> offsets(num_lists + 1, 0);
+  for (int64 i = 0; i < num_items; ++i) ++offsets[assignments[i] + 1];
+  for (int64 l = 0; l < num_lists; ++l) offsets[l + 1] += offsets[l];
+  std::vector<int64> positions(num_items);
+  {
+    std::vector<int64> next(offsets.begin(), offsets.end() - 1);
+    for (int64 i = 0; i < num_items; ++i) {
+      positions[i] = next[assignments[i]]++;
+    }
+  }
+
+  std::vector<int64> item_ids(num_items);
+  std::vector<int8> codes(num_items * dim);
+  std::vector<float> scales(num_items);
+  auto quantize = [&](int64 start, int64 limit) {
+    for (int64 i = start; i < limit; ++i) {
+      const int64 position = positions[i];
+      item_ids[position] = i;
+      scales[position] = QuantizeToInt8(item_data + i * dim, dim,
+                                        codes.data() + position * dim);
+    }
+  };
+  Shard(worker_threads->num_threads, worker_threads->workers, num_items,
+        dim * 5, quantize);
+
+  dim_ = dim;
+  num_items_ = num_items;
+  centroids_ = centroids;
+  list_offsets_.swap(offsets);
+  item_ids_.swap(item_ids);
+  codes_.swap(codes);
+  scales_.swap(scales);
+}
+
+void IVFIndexResource::Search(OpKernelContext* context, const Tensor& queries,
+                              int64 k, int64 num_probes, Tensor* scores_tensor,
+                              Tensor* indices_tensor) {
+  const int64 num_queries = queries.dim_size(0);
+  const int64 num_lists = centroids_.dim_size(0);
+  num_probes = std::min(num_probes, num_lists);
+  const float* query_data = queries.flat<float>().data();
+  ConstMatrixMap centroid_map(centroids_.flat<float>().data(), num_lists, dim_);
+  float* scores = scores_tensor->flat<float>().data();
+  int64* indices = indices_tensor->flat<int64>().data();
+
+  auto search = [&](int64 start, int64 limit) {
+    Vector centroid_scores(num_lists);
+    std::vector<float> probe_scores(num_probes);
+    std::vector<int64> probes(num_probes);
+    Matrix decoded(kItemBlockSize, dim_);
+    Vector item_scores(kItemBlockSize);
+    for (int64 q = start; q < limit; ++q) {
+      ConstVectorMap query(query_data + q * dim_, dim_);
+      centroid_scores.noalias() = centroid_map * query;
+      TopKAccumulator<float, int64> best_lists(num_probes);
+      OfferScores<float, int64>(centroid_scores.data(), num_lists, 0,
+                                &best_lists);
+      best_lists.ExtractSorted(probe_scores.data(), probes.data());
+
+      // Candidates are keyed by their position in the index, and mapped back
+      // to item ids at the end.
+      TopKAccumulator<float, int64> best_items(k);
+      for (int64 l : probes) {
+        for (int64 begin = list_offsets_[l]; begin < list_offsets_[l + 1];
+             begin += kItemBlockSize) {
+          const int64 block_size =
+              std::min(kItemBlockSize, list_offsets_[l + 1] - begin);
+          ConstCodeMatrixMap code_block(codes_.data() + begin * dim_,
+                                        block_size, dim_);
+          decoded.topRows(block_size) = code_block.cast<float>();
+          item_scores.head(block_size).noalias() =
+              decoded.topRows(block_size) * query;
+          item_scores.head(block_size).array() *=
+              ConstVectorMap(scales_.data() + begin, block_size).array();
+          OfferScores<float, int64>(item_scores.data(), block_size, begin,
+                                    &best_items);
+        }
+      }
+      const int64 found = best_items.size();
+      float* query_scores = scores + q * k;
+      int64* query_indices = indices + q * k;
+      best_items.ExtractSorted(query_scores, query_indices);
+      for (int64 i = 0; i < found; ++i) {
+        query_indices[i] = item_ids_[query_indices[i]];
+      }
+      std::fill(query_scores + found, query_scores + k,
+                -std::numeric_limits<float>::infinity());
+      std::fill(query_indices + found, query_indices + k, -1);
+    }
+  };
+  const int64 average_list_size = num_items_ / std::max<int64>(1, num_lists);
+  const int64 cost = dim_ * (num_lists + num_probes * average_list_size);
+  auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads->num_threads, worker_threads->workers, num_queries, cost,
+        search);
+}
+
+REGISTER_RESOURCE_HANDLE_KERNEL(IVFIndexResource);
+
+class IVFIndexBuildOp : public OpKernel {
+ public:
+  explicit IVFIndexBuildOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& centroids = context->input(1);
+    const Tensor& items = context->input(2);
+    OP_REQUIRES_OK(context, CheckMatrix(centroids, "centroids"));
+    OP_REQUIRES_OK(context, CheckMatrix(items, "items"));
+    OP_REQUIRES(context, centroids.dim_size(0) >= 1,
+                InvalidArgument("Need at least one centroid"));
+    OP_REQUIRES(context, centroids.dim_size(1) == items.dim_size(1),
+                InvalidArgument("centroids and items must have the same "
+                                "number of columns, got ",
+                                centroids.dim_size(1), " and ",
+                                items.dim_size(1)));
+
+    IVFIndexResource* index = nullptr;
+    OP_REQUIRES_OK(context,
+                   LookupOrCreateResource<IVFIndexResource>(
+                       context, HandleFromInput(context, 0), &index,
+                       [](IVFIndexResource** ret) {
+                         *ret = new IVFIndexResource;
+                         return Status::OK();
+                       }));
+    core::ScopedUnref unref_me(index);
+    mutex_lock l(*index->get_mutex());
+    index->Build(context, centroids, items);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("IVFIndexBuild").Device(DEVICE_CPU),
+                        IVFIndexBuildOp);
+
+class IVFIndexSearchOp : public OpKernel {
+ public:
+  explicit IVFIndexSearchOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& queries = context->input(1);
+    const Tensor& k_tensor = context->input(2);
+    const Tensor& num_probes_tensor = context->input(3);
+    OP_REQUIRES_OK(context, CheckMatrix(queries, "queries"));
+    OP_REQUIRES(context, TensorShapeUtils::IsScalar(k_tensor.shape()),
+                InvalidArgument("k must be a scalar, got shape ",
+                                k_tensor.shape().DebugString()));
+    OP_REQUIRES(context, TensorShapeUtils::IsScalar(num_probes_tensor.shape()),
+                InvalidArgument("num_probes must be a scalar, got shape ",
+                                num_probes_tensor.shape().DebugString()));
+    const int64 k = k_tensor.scalar<int32>()();
+    const int64 num_probes = num_probes_tensor.scalar<int32>()();
+    OP_REQUIRES(context, k >= 0,
+                InvalidArgument("k must be non-negative, got ", k));
+    OP_REQUIRES(context, num_probes >= 1,
+                InvalidArgument("num_probes must be at least 1, got ",
+                                num_probes));
+
+    IVFIndexResource* index = nullptr;
+    OP_REQUIRES_OK(
+        context, LookupResource(context, HandleFromInput(context, 0), &index));
+    core::ScopedUnref unref_me(index);
+    tf_shared_lock l(*index->get_mutex());
+    OP_REQUIRES(context, queries.dim_size(1) == index->dim(),
+                InvalidArgument("queries must have ", index->dim(),
+                                " columns, got ", queries.dim_size(1)));
+
+    const int64 num_queries = queries.dim_size(0);
+    Tensor* scores = nullptr;
+    Tensor* indices = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({num_queries, k}), &scores));
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                1, TensorShape({num_queries, k}), &indices));
+    if (num_queries == 0 || k == 0) return;
+    index->Search(context, queries, k, num_probes, scores, indices);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("IVFIndexSearch").Device(DEVICE_CPU),
+                        IVFIndexSearchOp);
+
+}  // namespace tensorflow
@@ -0,0 +1,278 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/contrib/nearest_neighbor/kernels/mips.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+using nearest_neighbor::OfferScores;
+using nearest_neighbor::QuantizeToInt8;
+using nearest_neighbor::TopKAccumulator;
+
+TEST(TopKAccumulatorTest, KeepsBestWithLowerIndexOnTies) {
+  TopKAccumulator<float, int64> accumulator(3);
+  // Offered out of order, as when merging partial results.
+  accumulator.Push(1.0f, 7);
+  accumulator.Push(3.0f, 5);
+  accumulator.Push(2.0f, 4);
+  accumulator.Push(2.0f, 2);
+  accumulator.Push(0.5f, 0);
+  accumulator.Push(3.0f, 9);
+  float scores[3];
+  int64 indices[3];
+  accumulator.ExtractSorted(scores, indices);
+  EXPECT_EQ(3.0f, scores[0]);
+  EXPECT_EQ(5, indices[0]);
+  EXPECT_EQ(3.0f, scores[1]);
+  EXPECT_EQ(9, indices[1]);
+  EXPECT_EQ(2.0f, scores[2]);
+  EXPECT_EQ(2, indices[2]);
+  EXPECT_EQ(0, accumulator.size());
+}
+
+TEST(TopKAccumulatorTest, OfferScoresMatchesSort) {
+  std::vector<float> scores(1000);
+  for (size_t i = 0; i < scores.size(); ++i) {
+    // Plenty of ties.
+    scores[i] = static_cast<float>((i * 7919) % 101);
+  }
+  TopKAccumulator<float, int64> accumulator(37);
+  OfferScores<float, int64>(scores.data(), scores.size(), 10, &accumulator);
+  std::vector<float> top_scores(37);
+  std::vector<int64> top_indices(37);
+  accumulator.ExtractSorted(top_scores.data(), top_indices.data());
+
+  std::vector<int64> expected(scores.size());
+  for (size_t i = 0; i < expected.size(); ++i) expected[i] = i;
+  std::stable_sort(expected.begin(), expected.end(),
+                   [&](int64 a, int64 b) { return scores[a] > scores[b]; });
+  for (int i = 0; i < 37; ++i) {
+    EXPECT_EQ(expected[i] + 10, top_indices[i]);
+    EXPECT_EQ(scores[expected[i]], top_scores[i]);
+  }
+}
+
+TEST(TopKAccumulatorTest, RanksNaNLast) {
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  std::vector<float> scores(40, nan);
+  scores[3] = -std::numeric_limits<float>::infinity();
+  scores[35] = 1.0f;
+  TopKAccumulator<float, int64> accumulator(4);
+  OfferScores<float, int64>(scores.data(), scores.size(), 0, &accumulator);
+  float top_scores[4];
+  int64 top_indices[4];
+  accumulator.ExtractSorted(top_scores, top_indices);
+  EXPECT_EQ(1.0f, top_scores[0]);
+  EXPECT_EQ(35, top_indices[0]);
+  EXPECT_EQ(-std::numeric_limits<float>::infinity(), top_scores[1]);
+  EXPECT_EQ(3, top_indices[1]);
+  EXPECT_TRUE(std::isnan(top_scores[2]));
+  EXPECT_EQ(0, top_indices[2]);
+  EXPECT_TRUE(std::isnan(top_scores[3]));
+  EXPECT_EQ(1, top_indices[3]);
+}
+
+TEST(QuantizeToInt8Test, RoundTrip) {
+  const float x[] = {0.5f, -2.0f, 1.0f, 0.0f};
+  int8 codes[4];
+  const float scale = QuantizeToInt8(x, 4, codes);
+  EXPECT_FLOAT_EQ(2.0f / 127, scale);
+  EXPECT_EQ(-127, codes[1]);
+  for (int j = 0; j < 4; ++j) {
+    EXPECT_NEAR(x[j], scale * codes[j], scale / 2);
+  }
+  const float zeros[] = {0.0f, 0.0f};
+  EXPECT_EQ(0.0f, QuantizeToInt8(zeros, 2, codes));
+  EXPECT_EQ(0, codes[0]);
+}
+
+class MaximumInnerProductSearchOpTest : public OpsTestBase {
+ protected:
+  void MakeOp() {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "MaximumInnerProductSearch")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("T", DT_FLOAT)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(MaximumInnerProductSearchOpTest, Simple) {
+  MakeOp();
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 0, 1, -1});
+  AddInputFromArray<float>(TensorShape({4, 2}), {1, 1, 2, 0, -1, -3, 0, 2});
+  AddInputFromArray<int32>(TensorShape({}), {2});
+  TF_ASSERT_OK(RunOpKernel());
+  // Query 0 scores {1, 2, -1, 0}, query 1 scores {0, 2, 2, -2}.
+  test::ExpectTensorEqual<float>(
+      *GetOutput(0), test::AsTensor<float>({2, 1, 2, 2}, TensorShape({2, 2})));
+  test::ExpectTensorEqual<int64>(
+      *GetOutput(1), test::AsTensor<int64>({1, 0, 1, 2}, TensorShape({2, 2})));
+}
+
+TEST_F(MaximumInnerProductSearchOpTest, NaNScoresRankLast) {
+  MakeOp();
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  AddInputFromArray<float>(TensorShape({1, 2}), {1, 0});
+  AddInputFromArray<float>(TensorShape({3, 2}), {nan, 0, 1, 0, 2, 0});
+  AddInputFromArray<int32>(TensorShape({}), {3});
+  TF_ASSERT_OK(RunOpKernel());
+  const auto scores = GetOutput(0)->matrix<float>();
+  EXPECT_EQ(2.0f, scores(0, 0));
+  EXPECT_EQ(1.0f, scores(0, 1));
+  EXPECT_TRUE(std::isnan(scores(0, 2)));
+  test::ExpectTensorEqual<int64>(
+      *GetOutput(1), test::AsTensor<int64>({2, 1, 0}, TensorShape({1, 3})));
+}
+
+TEST_F(MaximumInnerProductSearchOpTest, MatchesMatMulAndSort) {
+  MakeOp();
+  // Enough items to partition them across threads, and a batch that does not
+  // fill the last tile of queries.
+  const int64 kQueries = 45;
+  const int64 kItems = 20000;
+  const int64 kDim = 8;
+  const int kK = 10;
+  // Small integers so that the products are exact and ties are common.
+  std::vector<float> queries(kQueries * kDim);
+  std::vector<float> items(kItems * kDim);
+  for (int64 i = 0; i < kQueries * kDim; ++i) queries[i] = (i * 3) % 5 - 2;
+  for (int64 i = 0; i < kItems * kDim; ++i) items[i] = (i * 7) % 9 - 4;
+  AddInputFromArray<float>(TensorShape({kQueries, kDim}), queries);
+  AddInputFromArray<float>(TensorShape({kItems, kDim}), items);
+  AddInputFromArray<int32>(TensorShape({}), {kK});
+  TF_ASSERT_OK(RunOpKernel());
+
+  auto scores = GetOutput(0)->matrix<float>();
+  auto indices = GetOutput(1)->matrix<int64>();
+  for (int64 q = 0; q < kQueries; ++q) {
+    std::vector<float> all(kItems);
+    for (int64 i = 0; i < kItems; ++i) {
+      all[i] = 0;
+      for (int64 j = 0; j < kDim; ++j) {
+        all[i] += queries[q * kDim + j] * items[i * kDim + j];
+      }
+    }
+    std::vector<int64> order(kItems);
+    for (int64 i = 0; i < kItems; ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int64 a, int64 b) { return all[a] > all[b]; });
+    for (int i = 0; i < kK; ++i) {
+      EXPECT_EQ(order[i], indices(q, i)) << "query " << q << " rank " << i;
+      EXPECT_EQ(all[order[i]], scores(q, i));
+    }
+  }
+}
+
+TEST_F(MaximumInnerProductSearchOpTest, InvalidK) {
+  MakeOp();
+  AddInputFromArray<float>(TensorShape({1, 2}), {1, 0});
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 1, 2, 0});
+  AddInputFromArray<int32>(TensorShape({}), {3});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(str_util::StrContains(s.ToString(), "k must be in [0, 2]"))
+      << s;
+}
+
+// Retrieves the top 100 of a catalogue of a million items for a small batch of
+// queries, either with the fused op or with a MatMul followed by TopKV2.
+static void MIPSHelper(int iters, bool fused, int batch_size,
+                       int num_threads) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  const int64 kItems = 1000000;
+  const int64 kDim = 64;
+  Tensor queries(DT_FLOAT, TensorShape({batch_size, kDim}));
+  queries.flat<float>().setRandom();
+  Tensor items(DT_FLOAT, TensorShape({kItems, kDim}));
+  items.flat<float>().setRandom();
+  Tensor k = test::AsScalar<int32>(100);
+
+  Node* node;
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "MaximumInnerProductSearch")
+                    .Input(test::graph::Constant(g, queries))
+                    .Input(test::graph::Constant(g, items))
+                    .Input(test::graph::Constant(g, k))
+                    .Attr("T", DT_FLOAT)
+                    .Finalize(g, &node));
+  } else {
+    Node* scores;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "MatMul")
+                    .Input(test::graph::Constant(g, queries))
+                    .Input(test::graph::Constant(g, items))
+                    .Attr("transpose_b", true)
+                    .Finalize(g, &scores));
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "TopKV2")
+                    .Input(scores)
+                    .Input(test::graph::Constant(g, k))
+                    .Finalize(g, &node));
+  }
+
+  SessionOptions opts;
+  opts.config.set_intra_op_parallelism_threads(num_threads);
+  opts.config.set_inter_op_parallelism_threads(1);
+  testing::UseRealTime();
+  testing::ItemsProcessed(static_cast<int64>(iters) * batch_size * kItems);
+  testing::StartTiming();
+  test::Benchmark("cpu", g, &opts).Run(iters);
+}
+
+static void BM_MaximumInnerProductSearch(int iters, int batch_size,
+                                         int num_threads) {
+  MIPSHelper(iters, true, batch_size, num_threads);
+}
+
+static void BM_MatMulTopK(int iters, int batch_size, int num_threads) {
+  MIPSHelper(iters, false, batch_size, num_threads);
+}
+
+BENCHMARK(BM_MaximumInnerProductSearch)
+    ->ArgPair(1, 1)
+    ->ArgPair(1, 8)
+    ->ArgPair(32, 8)
+    ->ArgPair(256, 8);
+BENCHMARK(BM_MatMulTopK)
+    ->ArgPair(1, 1)
+    ->ArgPair(1, 8)
+    ->ArgPair(32, 8)
+    ->ArgPair(256, 8);
+
+}  // namespace
+}  // namespace tensorflow
@@ -13,10 +13,17 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include "tensorflow/core/framework/common_shape_fns.h"
 #include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/shape_inference.h"
 
 namespace tensorflow {
 
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
 REGISTER_OP("HyperplaneLSHProbes")
     .Attr("CoordinateType: {float, double}")
     .Input("point_hyperplane_product: CoordinateType")
@@ -46,4 +53,125 @@ probes: the output matrix of probes. Size `batch_size` times `num_probes`.
 table_ids: the output matrix of tables ids. Size `batch_size` times `num_probes`.
 )doc");
 
+namespace {
+
+// Shape function of the search ops: queries of shape [batch_size, dim] and a
+// scalar k give scores and indices of shape [batch_size, k].
+Status SearchShapeFn(InferenceContext* c, int queries_input, int k_input) {
+  ShapeHandle queries;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(queries_input), 2, &queries));
+  ShapeHandle unused;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(k_input), 0, &unused));
+  DimensionHandle k;
+  TF_RETURN_IF_ERROR(c->MakeDimForScalarInput(k_input, &k));
+  ShapeHandle output = c->Matrix(c->Dim(queries, 0), k);
+  c->set_output(0, output);
+  c->set_output(1, output);
+  return Status::OK();
+}
+
+}  // namespace
+
+REGISTER_OP("MaximumInnerProductSearch")
+    .Input("queries: T")
+    .Input("items: T")
+    .Input("k: int32")
+    .Output("scores: T")
+    .Output("indices: int64")
+    .Attr("T: {float, double}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle queries;
+      ShapeHandle items;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &queries));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &items));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(queries, 1), c->Dim(items, 1), &unused));
+      return SearchShapeFn(c, 0, 2);
+    })
+    .Doc(R"doc(
+Finds the items with the largest inner products with each query, exactly.
+
+Unlike a MatMul followed by TopK, the op never materializes the
+`[batch_size, num_items]` matrix of scores: the items are scored a block at a
+time and every block is folded into a running top k per query. Small batches
+are parallelized over the items as well as over the queries.
+
+Ties are broken in favor of the lower index, and NaN scores rank below all
+others. The inner products may round differently from those of a MatMul.
+
+queries: 2-D, of shape `[batch_size, dim]`.
+items: 2-D, of shape `[num_items, dim]`.
+k: 0-D. The number of items to return for each query, at most `num_items`.
+scores: 2-D, of shape `[batch_size, k]`. The inner products of the best items
+  for each query, in decreasing order.
+indices: 2-D, of shape `[batch_size, k]`. The rows of `items` the scores
+  belong to.
+)doc");
+
+REGISTER_RESOURCE_HANDLE_OP(IVFIndexResource);
+
+REGISTER_OP("IVFIndexBuild")
+    .Input("index_handle: resource")
+    .Input("centroids: float")
+    .Input("items: float")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      ShapeHandle centroids;
+      ShapeHandle items;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &centroids));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 2, &items));
+      DimensionHandle unused_dim;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(centroids, 1), c->Dim(items, 1),
+                                  &unused_dim));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Builds an inverted-file (IVF) index for approximate maximum inner product
+search, replacing the previous contents of the index.
+
+Every item is assigned to the list of the centroid with which it has the largest
+inner product, and is stored as int8 codes with a scale of its own, which takes
+a quarter of the memory of the float items. The centroids would typically come
+from running k-means on the items.
+
+index_handle: The handle to an IVFIndexResource.
+centroids: 2-D, of shape `[num_lists, dim]`.
+items: 2-D, of shape `[num_items, dim]`.
+)doc");
+
+REGISTER_OP("IVFIndexSearch")
+    .Input("index_handle: resource")
+    .Input("queries: float")
+    .Input("k: int32")
+    .Input("num_probes: int32")
+    .Output("scores: float")
+    .Output("indices: int64")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(3), 0, &unused));
+      return SearchShapeFn(c, 1, 2);
+    })
+    .Doc(R"doc(
+Finds items with large inner products with each query in an IVF index.
+
+Only the items of the `num_probes` lists whose centroids have the largest inner
+products with a query are scored, from their int8 codes, so both the set of
+items returned and their scores are approximate. Queries with fewer than `k`
+items in their probed lists get scores of `-inf` and indices of `-1` in the
+remaining slots.
+
+index_handle: The handle to an IVFIndexResource built by IVFIndexBuild.
+queries: 2-D, of shape `[batch_size, dim]`.
+k: 0-D. The number of items to return for each query.
+num_probes: 0-D. The number of lists to search for each query.
+scores: 2-D, of shape `[batch_size, k]`. The approximate inner products of the
+  best items found for each query, in decreasing order.
+indices: 2-D, of shape `[batch_size, k]`. The rows of the items the index was
+  built from that the scores belong to.
+)doc");
+
 }  // namespace tensorflow
@@ -0,0 +1,108 @@
+# Copyright 2017 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for the maximum inner product search ops."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import numpy as np
+
+from tensorflow.contrib.nearest_neighbor.python.ops import nearest_neighbor_ops
+from tensorflow.python.framework import errors
+from tensorflow.python.platform import test
+
+
+def _exact_top_k(queries, items, k):
+  scores = np.dot(queries, items.T)
+  # A stable sort of the negated scores breaks ties in favor of lower indices.
+  indices = np.argsort(-scores, axis=1, kind="mergesort")[:, :k]
+  return scores[np.arange(len(queries))[:, None], indices], indices
+
+
+class MaximumInnerProductSearchTest(test.TestCase):
+
+  def testMatchesMatMulAndSort(self):
+    rng = np.random.RandomState(0)
+    for dtype in [np.float32, np.float64]:
+      # Integer values make the products exact and create ties.
+      queries = rng.randint(-3, 4, size=(37, 16)).astype(dtype)
+      items = rng.randint(-3, 4, size=(3000, 16)).astype(dtype)
+      expected_scores, expected_indices = _exact_top_k(queries, items, 25)
+      with self.cached_session():
+        scores, indices = nearest_neighbor_ops.maximum_inner_product_search(
+            queries, items, 25)
+        self.assertAllEqual(expected_scores, scores.eval())
+        self.assertAllEqual(expected_indices, indices.eval())
+
+  def testShapes(self):
+    scores, indices = nearest_neighbor_ops.maximum_inner_product_search(
+        np.zeros((4, 3), np.float32), np.zeros((10, 3), np.float32), 5)
+    self.assertEqual([4, 5], scores.get_shape().as_list())
+    self.assertEqual([4, 5], indices.get_shape().as_list())
+
+  def testKTooLarge(self):
+    with self.cached_session():
+      scores, _ = nearest_neighbor_ops.maximum_inner_product_search(
+          np.zeros((1, 3), np.float32), np.zeros((2, 3), np.float32), 3)
+      with self.assertRaisesOpError("k must be in"):
+        scores.eval()
+
+
+class IVFIndexTest(test.TestCase):
+
+  def testProbingAllListsFindsTheExactItems(self):
+    rng = np.random.RandomState(1)
+    items = rng.randn(500, 8).astype(np.float32)
+    centroids = items[:10]
+    queries = rng.randn(20, 8).astype(np.float32)
+    expected_scores, expected_indices = _exact_top_k(queries, items, 5)
+    with self.cached_session() as sess:
+      index = nearest_neighbor_ops.IVFIndex()
+      sess.run(index.build(centroids, items))
+      scores, indices = sess.run(index.search(queries, 5, num_probes=10))
+    # The scores come from int8 codes, which are accurate to within half a
+    # quantization step per coordinate.
+    self.assertAllClose(expected_scores, scores, atol=0.2)
+    overlap = np.mean([
+        len(set(a) & set(b)) / 5.0 for a, b in zip(expected_indices, indices)
+    ])
+    self.assertGreater(overlap, 0.9)
+
+  def testFewProbes(self):
+    # Two well separated clusters, and one list per cluster.
+    items = np.array(
+        [[10, 1], [10, 2], [10, 3], [-10, 1], [-10, 2]], dtype=np.float32)
+    centroids = np.array([[1, 0], [-1, 0]], dtype=np.float32)
+    with self.cached_session() as sess:
+      index = nearest_neighbor_ops.IVFIndex()
+      sess.run(index.build(centroids, items))
+      scores, indices = sess.run(
+          index.search(np.array([[-1, 0]], np.float32), 3, num_probes=1))
+    # Only the second list is searched, and it holds two items.
+    self.assertAllEqual([[3, 4, -1]], indices)
+    self.assertAllClose([10, 10], scores[0, :2], atol=0.1)
+    self.assertEqual(-np.inf, scores[0, 2])
+
+  def testSearchBeforeBuild(self):
+    with self.cached_session():
+      index = nearest_neighbor_ops.IVFIndex()
+      scores, _ = index.search(np.zeros((1, 2), np.float32), 1, 1)
+      with self.assertRaises(errors.NotFoundError):
+        scores.eval()
+
+
+if __name__ == "__main__":
+  test.main()
@@ -62,3 +62,111 @@ def hyperplane_lsh_probes(point_hyperplane_product,
                                                      name=name)
 
 ops.NotDifferentiable("HyperplaneLSHProbes")
+
+
+def maximum_inner_product_search(queries, items, k, name=None):
+  """Finds the items with the largest inner products with each query.
+
+  The search is exhaustive: it returns the `k` largest inner products of each
+  query, like `tf.nn.top_k` applied to
+  `tf.matmul(queries, items, transpose_b=True)` would. The results may still
+  differ from those: the inner products are computed a block of items at a
+  time, so they may round differently, ties are broken in favor of the lower
+  index, and NaN scores rank below all others. The op never materializes the
+  `[batch_size, num_items]` matrix of scores: it keeps a running top `k` per
+  query instead.
+
+  Args:
+    queries: a `float32` or `float64` matrix of shape `[batch_size, dim]`.
+    items: a matrix of the same type as `queries`, of shape `[num_items, dim]`.
+    k: the number of items to return for each query, at most `num_items`.
+    name: A name for the operation (optional).
+
+  Returns:
+    scores: a matrix of shape `[batch_size, k]` with the inner products of the
+      best items for each query, in decreasing order.
+    indices: an `int64` matrix of shape `[batch_size, k]` with the rows of
+      `items` the scores belong to.
+  """
+  return _nearest_neighbor_ops.maximum_inner_product_search(
+      queries, items, k, name=name)
+
+
+ops.NotDifferentiable("MaximumInnerProductSearch")
+
+
+class IVFIndex(object):
+  """An inverted-file index for approximate maximum inner product search.
+
+  The items are split into lists, one per centroid, and stored as int8 codes.
+  A search only scores the items of the lists whose centroids are the best
+  matches for a query, which makes it sublinear in the number of items at the
+  cost of approximate results.
+
+  ```python
+  index = IVFIndex()
+  build_op = index.build(centroids, items)
+  scores, indices = index.search(queries, k=100, num_probes=8)
+  ```
+  """
+
+  def __init__(self, container="", shared_name=None, name=None):
+    """Creates a handle to an index, which `build` has to fill before use.
+
+    Args:
+      container: An optional `string`. The container of the index resource.
+      shared_name: An optional `string`. Graphs using the same name share the
+        index. Defaults to the name of the handle.
+      name: A name for the operation (optional).
+    """
+    with ops.name_scope(name, "IVFIndex") as scope:
+      self._handle = _nearest_neighbor_ops.ivf_index_resource_handle_op(
+          container=container,
+          shared_name=shared_name or scope,
+          name=scope)
+
+  @property
+  def handle(self):
+    return self._handle
+
+  def build(self, centroids, items, name=None):
+    """Returns an op filling the index, replacing its previous contents.
+
+    Every item goes to the list of the centroid with which it has the largest
+    inner product.
+
+    Args:
+      centroids: a `float32` matrix of shape `[num_lists, dim]`, e.g. found by
+        k-means on the items.
+      items: a `float32` matrix of shape `[num_items, dim]`.
+      name: A name for the operation (optional).
+
+    Returns:
+      The created op.
+    """
+    return _nearest_neighbor_ops.ivf_index_build(
+        self._handle, centroids, items, name=name)
+
+  def search(self, queries, k, num_probes, name=None):
+    """Finds items with large inner products with each query.
+
+    Args:
+      queries: a `float32` matrix of shape `[batch_size, dim]`.
+      k: the number of items to return for each query.
+      num_probes: the number of lists to search for each query.
+      name: A name for the operation (optional).
+
+    Returns:
+      scores: a `float32` matrix of shape `[batch_size, k]` with the
+        approximate inner products of the best items found, in decreasing
+        order. Slots left when the probed lists hold fewer than `k` items are
+        `-inf`.
+      indices: an `int64` matrix of shape `[batch_size, k]` with the rows of
+        the items the index was built from, or -1 for empty slots.
+    """
+    return _nearest_neighbor_ops.ivf_index_search(
+        self._handle, queries, k, num_probes, name=name)
+
+
+ops.NotDifferentiable("IVFIndexBuild")
+ops.NotDifferentiable("IVFIndexSearch")
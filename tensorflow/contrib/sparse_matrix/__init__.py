@@ -0,0 +1,34 @@
+# Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Sparse matrices in compressed sparse row (CSR) format.
+
+## Sparse matrices in compressed sparse row (CSR) format
+
+A `CSRSparseMatrix` keeps the structure of a sparse matrix in a variant tensor,
+so that models that reuse the same matrix at every step, e.g. the adjacency
+matrix of graph convolutional networks, convert it once.
+
+@@CSRSparseMatrix
+@@matmul
+
+"""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+# pylint: disable=unused-import,wildcard-import,line-too-long
+from tensorflow.contrib.sparse_matrix.python.ops.sparse_matrix_ops import *
+# pylint: enable=unused-import,wildcard-import,line-too-long
@@ -0,0 +1,121 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/contrib/sparse_matrix/kernels/csr_sparse_matrix.h"
+
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/variant_op_registry.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace tensorflow {
+
+const char CSRSparseMatrix::kTypeName[] = "tensorflow::CSRSparseMatrix";
+
+Status CSRSparseMatrix::Validate() const {
+  if (rows_ < 0 || cols_ < 0) {
+    return errors::InvalidArgument("Invalid CSR matrix shape [", rows_, ", ",
+                                   cols_, "]");
+  }
+  if (row_ptrs_.dtype() != DT_INT64 || col_indices_.dtype() != DT_INT64) {
+    return errors::InvalidArgument(
+        "CSR matrix row_ptrs and col_indices must be int64, got ",
+        DataTypeString(row_ptrs_.dtype()), " and ",
+        DataTypeString(col_indices_.dtype()));
+  }
+  if (row_ptrs_.shape() != TensorShape({rows_ + 1})) {
+    return errors::InvalidArgument("CSR matrix row_ptrs must have shape [",
+                                   rows_ + 1, "], got ",
+                                   row_ptrs_.shape().DebugString());
+  }
+  if (!TensorShapeUtils::IsVector(col_indices_.shape()) ||
+      values_.shape() != col_indices_.shape()) {
+    return errors::InvalidArgument(
+        "CSR matrix col_indices and values must be vectors of the same "
+        "length, got ",
+        col_indices_.shape().DebugString(), " and ",
+        values_.shape().DebugString());
+  }
+  auto row_ptrs = row_ptrs_.vec<int64>();
+  auto col_indices = col_indices_.vec<int64>();
+  if (row_ptrs(0) != 0 || row_ptrs(rows_) != nnz()) {
+    return errors::InvalidArgument("CSR matrix row_ptrs must range over [0, ",
+                                   nnz(), "], got [", row_ptrs(0), ", ",
+                                   row_ptrs(rows_), "]");
+  }
+  for (int64 i = 0; i < rows_; ++i) {
+    if (row_ptrs(i) > row_ptrs(i + 1)) {
+      return errors::InvalidArgument("CSR matrix row_ptrs must not decrease, ",
+                                     "got row_ptrs[", i, "] = ", row_ptrs(i),
+                                     " > row_ptrs[", i + 1,
+                                     "] = ", row_ptrs(i + 1));
+    }
+  }
+  for (int64 i = 0; i < rows_; ++i) {
+    for (int64 j = row_ptrs(i); j < row_ptrs(i + 1); ++j) {
+      const int64 col = col_indices(j);
+      if (col < 0 || col >= cols_) {
+        return errors::InvalidArgument("CSR matrix col_indices[", j, "] = ",
+                                       col, " is not in [0, ", cols_, ")");
+      }
+      if (j > row_ptrs(i) && col <= col_indices(j - 1)) {
+        return errors::InvalidArgument(
+            "CSR matrix col_indices must be increasing within rows, got ",
+            col_indices(j - 1), " then ", col, " in row ", i);
+      }
+    }
+  }
+  return Status::OK();
+}
+
+void CSRSparseMatrix::Encode(VariantTensorData* data) const {
+  data->set_type_name(TypeName());
+  *data->add_tensors() = row_ptrs_;
+  *data->add_tensors() = col_indices_;
+  *data->add_tensors() = values_;
+  string metadata;
+  core::PutVarint64(&metadata, static_cast<uint64>(rows_));
+  core::PutVarint64(&metadata, static_cast<uint64>(cols_));
+  data->set_metadata(metadata);
+}
+
+bool CSRSparseMatrix::Decode(const VariantTensorData& data) {
+  if (data.tensors_size() != 3) return false;
+  string metadata;
+  data.get_metadata(&metadata);
+  StringPiece iter(metadata);
+  uint64 rows;
+  uint64 cols;
+  if (!core::GetVarint64(&iter, &rows) || !core::GetVarint64(&iter, &cols)) {
+    return false;
+  }
+  rows_ = static_cast<int64>(rows);
+  cols_ = static_cast<int64>(cols);
+  row_ptrs_ = data.tensors(0);
+  col_indices_ = data.tensors(1);
+  values_ = data.tensors(2);
+  return Validate().ok();
+}
+
+string CSRSparseMatrix::DebugString() const {
+  return strings::StrCat("CSRSparseMatrix<", DataTypeString(dtype()), ">[",
+                         rows_, ", ", cols_, "] with ", nnz(), " nonzeros");
+}
+
+REGISTER_UNARY_VARIANT_DECODE_FUNCTION(CSRSparseMatrix,
+                                       CSRSparseMatrix::kTypeName);
+
+}  // namespace tensorflow
@@ -0,0 +1,81 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CONTRIB_SPARSE_MATRIX_KERNELS_CSR_SPARSE_MATRIX_H_
+#define TENSORFLOW_CONTRIB_SPARSE_MATRIX_KERNELS_CSR_SPARSE_MATRIX_H_
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/framework/variant.h"
+#include "tensorflow/core/framework/variant_encode_decode.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace tensorflow {
+
+// Variant compatible 2-D sparse matrix in compressed sparse row (CSR) format,
+// so that its structure can be built once and kept across steps instead of
+// being re-derived from a SparseTensor by every op.
+//
+// Row i holds the nonzeros with column indices
+// col_indices[row_ptrs[i]:row_ptrs[i + 1]], in increasing order, and values
+// values[row_ptrs[i]:row_ptrs[i + 1]].  row_ptrs and col_indices are int64
+// vectors; the values determine the dtype of the matrix.
+//
+// Instances should never be mutated after stored in a variant tensor.
+class CSRSparseMatrix {
+ public:
+  CSRSparseMatrix() : rows_(0), cols_(0) {}
+
+  // Does not check the components; see Validate().
+  CSRSparseMatrix(int64 rows, int64 cols, const Tensor& row_ptrs,
+                  const Tensor& col_indices, const Tensor& values)
+      : rows_(rows),
+        cols_(cols),
+        row_ptrs_(row_ptrs),
+        col_indices_(col_indices),
+        values_(values) {}
+
+  // Returns an error unless the components describe a valid CSR matrix.
+  Status Validate() const;
+
+  int64 rows() const { return rows_; }
+  int64 cols() const { return cols_; }
+  int64 nnz() const { return col_indices_.NumElements(); }
+  DataType dtype() const { return values_.dtype(); }
+
+  const Tensor& row_ptrs() const { return row_ptrs_; }
+  const Tensor& col_indices() const { return col_indices_; }
+  const Tensor& values() const { return values_; }
+
+  static const char kTypeName[];
+  string TypeName() const { return kTypeName; }
+
+  void Encode(VariantTensorData* data) const;
+
+  bool Decode(const VariantTensorData& data);
+
+  string DebugString() const;
+
+ private:
+  int64 rows_;
+  int64 cols_;
+  Tensor row_ptrs_;
+  Tensor col_indices_;
+  Tensor values_;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CONTRIB_SPARSE_MATRIX_KERNELS_CSR_SPARSE_MATRIX_H_
@@ -0,0 +1,674 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/contrib/sparse_matrix/kernels/csr_sparse_matrix.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/variant.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Number of row blocks per thread in ParallelForRows, so that the blocks
+// still balance when some threads are busy.
+const int64 kBlocksPerThread = 4;
+
+// The transpose only splits matrices with at least this many nonzeros per
+// block, and per column, so that its per-block column counts stay small.
+const int64 kMinTransposeBlockNonzeros = 4096;
+
+// Returns the CSR sparse matrix held by the scalar variant `input`, after
+// checking that its values have type `dtype`.
+Status GetMatrix(const Tensor& input, DataType dtype,
+                 const CSRSparseMatrix** matrix) {
+  if (!TensorShapeUtils::IsScalar(input.shape())) {
+    return errors::InvalidArgument(
+        "Expected a scalar CSR sparse matrix, got shape ",
+        input.shape().DebugString());
+  }
+  const CSRSparseMatrix* m = input.scalar<Variant>()().get<CSRSparseMatrix>();
+  if (m == nullptr) {
+    return errors::InvalidArgument(
+        "Input is not a CSR sparse matrix. Saw: '",
+        input.scalar<Variant>()().DebugString(), "'");
+  }
+  if (m->dtype() != dtype) {
+    return errors::InvalidArgument("Invalid data types; op expects ",
+                                   DataTypeString(dtype),
+                                   " but the CSR sparse matrix holds ",
+                                   DataTypeString(m->dtype()));
+  }
+  *matrix = m;
+  return Status::OK();
+}
+
+// Stores `matrix` in the scalar variant output `index`.
+Status SetMatrixOutput(OpKernelContext* ctx, int index,
+                       CSRSparseMatrix matrix) {
+  Tensor* output;
+  AllocatorAttributes attr;
+  attr.set_on_host(true);
+  TF_RETURN_IF_ERROR(
+      ctx->allocate_output(index, TensorShape({}), &output, attr));
+  output->scalar<Variant>()() = std::move(matrix);
+  return Status::OK();
+}
+
+// Splits the rows of a matrix with the given row pointers into at most
+// `num_blocks` contiguous blocks of about the same cost, where each row costs
+// `cost_per_row` plus `cost_per_nonzero` per nonzero.  Balancing on the
+// nonzeros keeps skewed rows, e.g. those of power-law graphs, from serializing
+// on one thread.  Returns the block boundaries.
+std::vector<int64> BalancedRowBlocks(const Tensor& row_ptrs,
+                                     int64 cost_per_row,
+                                     int64 cost_per_nonzero,
+                                     int64 num_blocks) {
+  auto row_ptrs_vec = row_ptrs.vec<int64>();
+  const int64 rows = row_ptrs_vec.size() - 1;
+  num_blocks = std::max<int64>(1, std::min(num_blocks, rows));
+  // The cost of the rows before row i, which increases with i.
+  auto cost_before = [&](int64 i) {
+    return row_ptrs_vec(i) * cost_per_nonzero + i * cost_per_row;
+  };
+  const int64 total_cost = cost_before(rows);
+  std::vector<int64> bounds(num_blocks + 1);
+  bounds[0] = 0;
+  for (int64 b = 1; b < num_blocks; ++b) {
+    const int64 target = total_cost / num_blocks * b;
+    int64 lo = bounds[b - 1];
+    int64 hi = rows;
+    while (lo < hi) {
+      const int64 mid = lo + (hi - lo) / 2;
+      if (cost_before(mid) < target) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    bounds[b] = lo;
+  }
+  bounds[num_blocks] = rows;
+  return bounds;
+}
+
+// Calls `fn(row_begin, row_end)` in parallel on blocks of the rows of a matrix
+// with the given row pointers, balanced as in BalancedRowBlocks.
+void ParallelForRows(OpKernelContext* ctx, const Tensor& row_ptrs,
+                     int64 cost_per_row, int64 cost_per_nonzero,
+                     const std::function<void(int64, int64)>& fn) {
+  auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+  const std::vector<int64> bounds =
+      BalancedRowBlocks(row_ptrs, cost_per_row, cost_per_nonzero,
+                        kBlocksPerThread * worker_threads->num_threads);
+  const int64 num_blocks = bounds.size() - 1;
+  const int64 rows = bounds.back();
+  const int64 total_cost = row_ptrs.vec<int64>()(rows) * cost_per_nonzero +
+                           rows * cost_per_row;
+  auto compute_blocks = [&bounds, &fn](int64 begin, int64 end) {
+    fn(bounds[begin], bounds[end]);
+  };
+  Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+        total_cost / num_blocks + 1, compute_blocks);
+}
+
+}  // namespace
+
+template <typename T>
+class SparseTensorToCSRSparseMatrixOp : public OpKernel {
+ public:
+  explicit SparseTensorToCSRSparseMatrixOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& indices = ctx->input(0);
+    const Tensor& values = ctx->input(1);
+    const Tensor& dense_shape = ctx->input(2);
+    OP_REQUIRES(ctx,
+                TensorShapeUtils::IsMatrix(indices.shape()) &&
+                    indices.dim_size(1) == 2,
+                errors::InvalidArgument(
+                    "indices must be a matrix with 2 columns, got shape ",
+                    indices.shape().DebugString()));
+    OP_REQUIRES(ctx,
+                TensorShapeUtils::IsVector(values.shape()) &&
+                    values.dim_size(0) == indices.dim_size(0),
+                errors::InvalidArgument(
+                    "values must be a vector of length ", indices.dim_size(0),
+                    ", got shape ", values.shape().DebugString()));
+    OP_REQUIRES(ctx, dense_shape.shape() == TensorShape({2}),
+                errors::InvalidArgument(
+                    "dense_shape must have shape [2], got shape ",
+                    dense_shape.shape().DebugString()));
+    const int64 rows = dense_shape.vec<int64>()(0);
+    const int64 cols = dense_shape.vec<int64>()(1);
+    OP_REQUIRES(ctx, rows >= 0 && cols >= 0,
+                errors::InvalidArgument("Invalid dense_shape [", rows, ", ",
+                                        cols, "]"));
+    const int64 nnz = indices.dim_size(0);
+    auto indices_mat = indices.matrix<int64>();
+    auto values_vec = values.vec<T>();
+
+    Tensor row_ptrs;
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(DT_INT64, TensorShape({rows + 1}), &row_ptrs));
+    auto row_ptrs_vec = row_ptrs.vec<int64>();
+    row_ptrs_vec.setZero();
+    for (int64 i = 0; i < nnz; ++i) {
+      const int64 row = indices_mat(i, 0);
+      const int64 col = indices_mat(i, 1);
+      OP_REQUIRES(ctx, row >= 0 && row < rows && col >= 0 && col < cols,
+                  errors::InvalidArgument("indices[", i, "] = [", row, ", ",
+                                          col, "] is out of bounds for shape [",
+                                          rows, ", ", cols, "]"));
+      ++row_ptrs_vec(row + 1);
+    }
+    for (int64 i = 0; i < rows; ++i) {
+      row_ptrs_vec(i + 1) += row_ptrs_vec(i);
+    }
+
+    Tensor col_indices;
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(DT_INT64, TensorShape({nnz}), &col_indices));
+    auto col_indices_vec = col_indices.vec<int64>();
+    Tensor csr_values;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(DataTypeToEnum<T>::value,
+                                           TensorShape({nnz}), &csr_values));
+    auto csr_values_vec = csr_values.vec<T>();
+    // Scatters the nonzeros to their rows, keeping their order within rows,
+    // so that canonically ordered inputs need no sorting below.
+    std::vector<int64> next(row_ptrs_vec.data(), row_ptrs_vec.data() + rows);
+    for (int64 i = 0; i < nnz; ++i) {
+      const int64 pos = next[indices_mat(i, 0)]++;
+      col_indices_vec(pos) = indices_mat(i, 1);
+      csr_values_vec(pos) = values_vec(i);
+    }
+
+    // Sorts the rows that are not ordered by column yet.
+    mutex mu;
+    int64 duplicate_row = rows;
+    auto sort_rows = [&](int64 begin, int64 end) {
+      std::vector<std::pair<int64, T>> entries;
+      for (int64 i = begin; i < end; ++i) {
+        const int64 start = row_ptrs_vec(i);
+        const int64 limit = row_ptrs_vec(i + 1);
+        bool ordered = true;
+        for (int64 j = start + 1; j < limit && ordered; ++j) {
+          ordered = col_indices_vec(j - 1) < col_indices_vec(j);
+        }
+        if (ordered) continue;
+        entries.clear();
+        for (int64 j = start; j < limit; ++j) {
+          entries.emplace_back(col_indices_vec(j), csr_values_vec(j));
+        }
+        std::sort(entries.begin(), entries.end(),
+                  [](const std::pair<int64, T>& a,
+                     const std::pair<int64, T>& b) {
+                    return a.first < b.first;
+                  });
+        for (int64 j = start; j < limit; ++j) {
+          col_indices_vec(j) = entries[j - start].first;
+          csr_values_vec(j) = entries[j - start].second;
+          if (j > start && col_indices_vec(j) == col_indices_vec(j - 1)) {
+            mutex_lock l(mu);
+            duplicate_row = std::min(duplicate_row, i);
+          }
+        }
+      }
+    };
+    ParallelForRows(ctx, row_ptrs, 1, 8, sort_rows);
+    OP_REQUIRES(ctx, duplicate_row == rows,
+                errors::InvalidArgument("indices has duplicate entries in row ",
+                                        duplicate_row));
+
+    OP_REQUIRES_OK(ctx, SetMatrixOutput(ctx, 0,
+                                        CSRSparseMatrix(rows, cols, row_ptrs,
+                                                        col_indices,
+                                                        csr_values)));
+  }
+};
+
+template <typename T>
+class DenseToCSRSparseMatrixOp : public OpKernel {
+ public:
+  explicit DenseToCSRSparseMatrixOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& dense = ctx->input(0);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsMatrix(dense.shape()),
+                errors::InvalidArgument("dense must be a matrix, got shape ",
+                                        dense.shape().DebugString()));
+    const int64 rows = dense.dim_size(0);
+    const int64 cols = dense.dim_size(1);
+    auto dense_mat = dense.matrix<T>();
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+
+    Tensor row_ptrs;
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(DT_INT64, TensorShape({rows + 1}), &row_ptrs));
+    auto row_ptrs_vec = row_ptrs.vec<int64>();
+    row_ptrs_vec(0) = 0;
+    // Counts the nonzeros of each row, so that the rows can then be filled in
+    // parallel.
+    auto count_rows = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        int64 count = 0;
+        for (int64 j = 0; j < cols; ++j) {
+          count += dense_mat(i, j) != T(0);
+        }
+        row_ptrs_vec(i + 1) = count;
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, rows, cols,
+          count_rows);
+    for (int64 i = 0; i < rows; ++i) {
+      row_ptrs_vec(i + 1) += row_ptrs_vec(i);
+    }
+
+    const int64 nnz = row_ptrs_vec(rows);
+    Tensor col_indices;
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(DT_INT64, TensorShape({nnz}), &col_indices));
+    auto col_indices_vec = col_indices.vec<int64>();
+    Tensor values;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(DataTypeToEnum<T>::value,
+                                           TensorShape({nnz}), &values));
+    auto values_vec = values.vec<T>();
+    auto fill_rows = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        int64 pos = row_ptrs_vec(i);
+        for (int64 j = 0; j < cols; ++j) {
+          const T value = dense_mat(i, j);
+          if (value != T(0)) {
+            col_indices_vec(pos) = j;
+            values_vec(pos) = value;
+            ++pos;
+          }
+        }
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, rows, 2 * cols,
+          fill_rows);
+
+    OP_REQUIRES_OK(ctx, SetMatrixOutput(ctx, 0,
+                                        CSRSparseMatrix(rows, cols, row_ptrs,
+                                                        col_indices, values)));
+  }
+};
+
+template <typename T>
+class CSRSparseMatrixToSparseTensorOp : public OpKernel {
+ public:
+  explicit CSRSparseMatrixToSparseTensorOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const CSRSparseMatrix* matrix;
+    OP_REQUIRES_OK(ctx, GetMatrix(ctx->input(0), DataTypeToEnum<T>::value,
+                                  &matrix));
+    Tensor* indices;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                            0, TensorShape({matrix->nnz(), 2}), &indices));
+    auto indices_mat = indices->matrix<int64>();
+    auto row_ptrs = matrix->row_ptrs().vec<int64>();
+    auto col_indices = matrix->col_indices().vec<int64>();
+    auto fill_rows = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        for (int64 j = row_ptrs(i); j < row_ptrs(i + 1); ++j) {
+          indices_mat(j, 0) = i;
+          indices_mat(j, 1) = col_indices(j);
+        }
+      }
+    };
+    ParallelForRows(ctx, matrix->row_ptrs(), 1, 2, fill_rows);
+
+    // The nonzeros are already in row-major order.
+    ctx->set_output(1, matrix->values());
+
+    Tensor* dense_shape;
+    OP_REQUIRES_OK(ctx,
+                   ctx->allocate_output(2, TensorShape({2}), &dense_shape));
+    dense_shape->vec<int64>()(0) = matrix->rows();
+    dense_shape->vec<int64>()(1) = matrix->cols();
+  }
+};
+
+template <typename T>
+class CSRSparseMatrixToDenseOp : public OpKernel {
+ public:
+  explicit CSRSparseMatrixToDenseOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const CSRSparseMatrix* matrix;
+    OP_REQUIRES_OK(ctx, GetMatrix(ctx->input(0), DataTypeToEnum<T>::value,
+                                  &matrix));
+    const int64 cols = matrix->cols();
+    Tensor* dense;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                            0, TensorShape({matrix->rows(), cols}), &dense));
+    if (dense->NumElements() == 0) return;
+    T* dense_data = dense->flat<T>().data();
+    auto row_ptrs = matrix->row_ptrs().vec<int64>();
+    auto col_indices = matrix->col_indices().vec<int64>();
+    auto values = matrix->values().vec<T>();
+    auto fill_rows = [&](int64 begin, int64 end) {
+      std::fill(dense_data + begin * cols, dense_data + end * cols, T(0));
+      for (int64 i = begin; i < end; ++i) {
+        T* dense_row = dense_data + i * cols;
+        for (int64 j = row_ptrs(i); j < row_ptrs(i + 1); ++j) {
+          dense_row[col_indices(j)] = values(j);
+        }
+      }
+    };
+    ParallelForRows(ctx, matrix->row_ptrs(), cols, 1, fill_rows);
+  }
+};
+
+template <typename T>
+class CSRSparseMatrixMatMulOp : public OpKernel {
+ public:
+  explicit CSRSparseMatrixMatMulOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const CSRSparseMatrix* a;
+    OP_REQUIRES_OK(ctx,
+                   GetMatrix(ctx->input(0), DataTypeToEnum<T>::value, &a));
+    const Tensor& b = ctx->input(1);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsMatrix(b.shape()),
+                errors::InvalidArgument("b must be a matrix, got shape ",
+                                        b.shape().DebugString()));
+    OP_REQUIRES(ctx, a->cols() == b.dim_size(0),
+                errors::InvalidArgument(
+                    "Matrix size-incompatible: a has shape [", a->rows(), ", ",
+                    a->cols(), "] and b has shape ", b.shape().DebugString()));
+    const int64 n = b.dim_size(1);
+    Tensor* product;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(
+                            0, TensorShape({a->rows(), n}), &product));
+    if (product->NumElements() == 0) return;
+
+    auto row_ptrs = a->row_ptrs().vec<int64>();
+    auto col_indices = a->col_indices().vec<int64>();
+    auto values = a->values().vec<T>();
+    const T* b_data = b.flat<T>().data();
+    T* product_data = product->flat<T>().data();
+    // Accumulates each row of the product from the rows of b selected by the
+    // nonzeros of the same row of a.  The inner loops run over contiguous
+    // rows, so that they vectorize.
+    auto compute_rows = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        T* product_row = product_data + i * n;
+        std::fill(product_row, product_row + n, T(0));
+        for (int64 j = row_ptrs(i); j < row_ptrs(i + 1); ++j) {
+          const T value = values(j);
+          const T* b_row = b_data + col_indices(j) * n;
+          for (int64 k = 0; k < n; ++k) {
+            product_row[k] += value * b_row[k];
+          }
+        }
+      }
+    };
+    ParallelForRows(ctx, a->row_ptrs(), n, 2 * n, compute_rows);
+  }
+};
+
+// Computes the product with Gustavson's algorithm: a first pass counts the
+// nonzeros of each row of the product, so that a second pass can compute the
+// rows in parallel, directly into their final position.
+template <typename T>
+class CSRSparseMatrixSparseMatMulOp : public OpKernel {
+ public:
+  explicit CSRSparseMatrixSparseMatMulOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const CSRSparseMatrix* a;
+    OP_REQUIRES_OK(ctx,
+                   GetMatrix(ctx->input(0), DataTypeToEnum<T>::value, &a));
+    const CSRSparseMatrix* b;
+    OP_REQUIRES_OK(ctx,
+                   GetMatrix(ctx->input(1), DataTypeToEnum<T>::value, &b));
+    OP_REQUIRES(ctx, a->cols() == b->rows(),
+                errors::InvalidArgument(
+                    "Matrix size-incompatible: a has shape [", a->rows(), ", ",
+                    a->cols(), "] and b has shape [", b->rows(), ", ",
+                    b->cols(), "]"));
+    const int64 rows = a->rows();
+    const int64 cols = b->cols();
+    auto a_row_ptrs = a->row_ptrs().vec<int64>();
+    auto a_col_indices = a->col_indices().vec<int64>();
+    auto a_values = a->values().vec<T>();
+    auto b_row_ptrs = b->row_ptrs().vec<int64>();
+    auto b_col_indices = b->col_indices().vec<int64>();
+    auto b_values = b->values().vec<T>();
+    // Each nonzero of a visits a row of b.
+    const int64 cost_per_nonzero =
+        1 + b->nnz() / std::max<int64>(1, b->rows());
+
+    Tensor row_ptrs;
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(DT_INT64, TensorShape({rows + 1}), &row_ptrs));
+    auto row_ptrs_vec = row_ptrs.vec<int64>();
+    row_ptrs_vec(0) = 0;
+    // Counts the distinct columns of each row of the product, marking the
+    // columns already seen in the current row.
+    auto count_rows = [&](int64 begin, int64 end) {
+      std::vector<int64> marker(cols, -1);
+      for (int64 i = begin; i < end; ++i) {
+        int64 count = 0;
+        for (int64 j = a_row_ptrs(i); j < a_row_ptrs(i + 1); ++j) {
+          const int64 k = a_col_indices(j);
+          for (int64 l = b_row_ptrs(k); l < b_row_ptrs(k + 1); ++l) {
+            const int64 col = b_col_indices(l);
+            if (marker[col] != i) {
+              marker[col] = i;
+              ++count;
+            }
+          }
+        }
+        row_ptrs_vec(i + 1) = count;
+      }
+    };
+    ParallelForRows(ctx, a->row_ptrs(), 1, cost_per_nonzero, count_rows);
+    for (int64 i = 0; i < rows; ++i) {
+      row_ptrs_vec(i + 1) += row_ptrs_vec(i);
+    }
+
+    const int64 nnz = row_ptrs_vec(rows);
+    Tensor col_indices;
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(DT_INT64, TensorShape({nnz}), &col_indices));
+    int64* col_indices_data = col_indices.vec<int64>().data();
+    Tensor values;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(DataTypeToEnum<T>::value,
+                                           TensorShape({nnz}), &values));
+    T* values_data = values.vec<T>().data();
+    // Accumulates each row of the product into a dense row, then gathers its
+    // nonzeros in increasing column order.
+    auto compute_rows = [&](int64 begin, int64 end) {
+      std::vector<int64> marker(cols, -1);
+      std::vector<T> accumulator(cols);
+      for (int64 i = begin; i < end; ++i) {
+        int64* row_cols = col_indices_data + row_ptrs_vec(i);
+        int64 count = 0;
+        for (int64 j = a_row_ptrs(i); j < a_row_ptrs(i + 1); ++j) {
+          const int64 k = a_col_indices(j);
+          const T a_value = a_values(j);
+          for (int64 l = b_row_ptrs(k); l < b_row_ptrs(k + 1); ++l) {
+            const int64 col = b_col_indices(l);
+            if (marker[col] != i) {
+              marker[col] = i;
+              accumulator[col] = a_value * b_values(l);
+              row_cols[count++] = col;
+            } else {
+              accumulator[col] += a_value * b_values(l);
+            }
+          }
+        }
+        std::sort(row_cols, row_cols + count);
+        T* row_values = values_data + row_ptrs_vec(i);
+        for (int64 p = 0; p < count; ++p) {
+          row_values[p] = accumulator[row_cols[p]];
+        }
+      }
+    };
+    ParallelForRows(ctx, a->row_ptrs(), 1, 2 * cost_per_nonzero,
+                    compute_rows);
+
+    OP_REQUIRES_OK(ctx, SetMatrixOutput(ctx, 0,
+                                        CSRSparseMatrix(rows, cols, row_ptrs,
+                                                        col_indices, values)));
+  }
+};
+
+// Transposes by counting sort on the column indices.  Blocks of input rows
+// count their nonzeros per column in parallel, and then scatter them in
+// parallel to disjoint output ranges, so that each output row stays ordered by
+// column.
+template <typename T>
+class CSRSparseMatrixTransposeOp : public OpKernel {
+ public:
+  explicit CSRSparseMatrixTransposeOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    const CSRSparseMatrix* input;
+    OP_REQUIRES_OK(ctx, GetMatrix(ctx->input(0), DataTypeToEnum<T>::value,
+                                  &input));
+    const int64 rows = input->rows();
+    const int64 cols = input->cols();
+    const int64 nnz = input->nnz();
+    auto input_row_ptrs = input->row_ptrs().vec<int64>();
+    auto input_col_indices = input->col_indices().vec<int64>();
+    auto input_values = input->values().vec<T>();
+
+    Tensor row_ptrs;
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(DT_INT64, TensorShape({cols + 1}), &row_ptrs));
+    auto row_ptrs_vec = row_ptrs.vec<int64>();
+    Tensor col_indices;
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(DT_INT64, TensorShape({nnz}), &col_indices));
+    auto col_indices_vec = col_indices.vec<int64>();
+    Tensor values;
+    OP_REQUIRES_OK(ctx, ctx->allocate_temp(DataTypeToEnum<T>::value,
+                                           TensorShape({nnz}), &values));
+    auto values_vec = values.vec<T>();
+
+    // The per-block column counts take num_blocks * cols entries, which stays
+    // below nnz.
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    const std::vector<int64> bounds = BalancedRowBlocks(
+        input->row_ptrs(), 1, 1,
+        std::min<int64>(worker_threads->num_threads,
+                        nnz / std::max(cols, kMinTransposeBlockNonzeros)));
+    const int64 num_blocks = bounds.size() - 1;
+    const int64 cost_per_block = nnz / num_blocks + 1;
+    std::vector<int64> offsets(num_blocks * cols, 0);
+    auto count_blocks = [&](int64 begin, int64 end) {
+      for (int64 b = begin; b < end; ++b) {
+        int64* counts = offsets.data() + b * cols;
+        for (int64 j = input_row_ptrs(bounds[b]);
+             j < input_row_ptrs(bounds[b + 1]); ++j) {
+          ++counts[input_col_indices(j)];
+        }
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+          cost_per_block, count_blocks);
+
+    // Turns the counts into the output position of the first nonzero of each
+    // block in each column.
+    int64 pos = 0;
+    for (int64 c = 0; c < cols; ++c) {
+      row_ptrs_vec(c) = pos;
+      for (int64 b = 0; b < num_blocks; ++b) {
+        const int64 count = offsets[b * cols + c];
+        offsets[b * cols + c] = pos;
+        pos += count;
+      }
+    }
+    row_ptrs_vec(cols) = pos;
+
+    auto scatter_blocks = [&](int64 begin, int64 end) {
+      for (int64 b = begin; b < end; ++b) {
+        int64* next = offsets.data() + b * cols;
+        for (int64 i = bounds[b]; i < bounds[b + 1]; ++i) {
+          for (int64 j = input_row_ptrs(i); j < input_row_ptrs(i + 1); ++j) {
+            const int64 p = next[input_col_indices(j)]++;
+            col_indices_vec(p) = i;
+            values_vec(p) = input_values(j);
+          }
+        }
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, num_blocks,
+          2 * cost_per_block, scatter_blocks);
+
+    OP_REQUIRES_OK(ctx, SetMatrixOutput(ctx, 0,
+                                        CSRSparseMatrix(cols, rows, row_ptrs,
+                                                        col_indices, values)));
+  }
+};
+
+#define REGISTER_KERNELS(type)                                   \
+  REGISTER_KERNEL_BUILDER(Name("SparseTensorToCSRSparseMatrix")  \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<type>("T"),        \
+                          SparseTensorToCSRSparseMatrixOp<type>); \
+  REGISTER_KERNEL_BUILDER(Name("DenseToCSRSparseMatrix")         \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<type>("T"),        \
+                          DenseToCSRSparseMatrixOp<type>);       \
+  REGISTER_KERNEL_BUILDER(Name("CSRSparseMatrixToSparseTensor")  \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<type>("T"),        \
+                          CSRSparseMatrixToSparseTensorOp<type>); \
+  REGISTER_KERNEL_BUILDER(Name("CSRSparseMatrixToDense")         \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<type>("T"),        \
+                          CSRSparseMatrixToDenseOp<type>);       \
+  REGISTER_KERNEL_BUILDER(Name("CSRSparseMatrixMatMul")          \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<type>("T"),        \
+                          CSRSparseMatrixMatMulOp<type>);        \
+  REGISTER_KERNEL_BUILDER(Name("CSRSparseMatrixSparseMatMul")    \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<type>("T"),        \
+                          CSRSparseMatrixSparseMatMulOp<type>);  \
+  REGISTER_KERNEL_BUILDER(Name("CSRSparseMatrixTranspose")       \
+                              .Device(DEVICE_CPU)                \
+                              .TypeConstraint<type>("T"),        \
+                          CSRSparseMatrixTransposeOp<type>);
+
+TF_CALL_float(REGISTER_KERNELS);
+TF_CALL_double(REGISTER_KERNELS);
+#undef REGISTER_KERNELS
+
+}  // namespace tensorflow
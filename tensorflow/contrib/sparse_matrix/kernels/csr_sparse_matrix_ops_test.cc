@@ -0,0 +1,324 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/contrib/sparse_matrix/kernels/csr_sparse_matrix.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/framework/variant.h"
+#include "tensorflow/core/framework/variant_encode_decode.h"
+#include "tensorflow/core/framework/variant_tensor_data.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+// The 3 x 4 matrix
+//   [[1, 0, 2, 0],
+//    [0, 0, 0, 0],
+//    [0, 3, 0, 4]]
+CSRSparseMatrix TestMatrix() {
+  return CSRSparseMatrix(3, 4, test::AsTensor<int64>({0, 2, 2, 4}),
+                         test::AsTensor<int64>({0, 2, 1, 3}),
+                         test::AsTensor<float>({1, 2, 3, 4}));
+}
+
+void ExpectMatrixEqual(const CSRSparseMatrix& expected,
+                       const CSRSparseMatrix& actual) {
+  EXPECT_EQ(expected.rows(), actual.rows());
+  EXPECT_EQ(expected.cols(), actual.cols());
+  test::ExpectTensorEqual<int64>(expected.row_ptrs(), actual.row_ptrs());
+  test::ExpectTensorEqual<int64>(expected.col_indices(), actual.col_indices());
+  test::ExpectTensorEqual<float>(expected.values(), actual.values());
+}
+
+TEST(CSRSparseMatrixTest, Validate) {
+  TF_EXPECT_OK(TestMatrix().Validate());
+  Status s = CSRSparseMatrix(3, 4, test::AsTensor<int64>({0, 2, 2, 4}),
+                             test::AsTensor<int64>({2, 0, 1, 3}),
+                             test::AsTensor<float>({1, 2, 3, 4}))
+                 .Validate();
+  EXPECT_TRUE(str_util::StrContains(s.ToString(), "increasing within rows"))
+      << s;
+  s = CSRSparseMatrix(3, 4, test::AsTensor<int64>({0, 2, 2, 4}),
+                      test::AsTensor<int64>({0, 2, 1, 4}),
+                      test::AsTensor<float>({1, 2, 3, 4}))
+          .Validate();
+  EXPECT_TRUE(
+      str_util::StrContains(s.ToString(), "col_indices[3] = 4 is not in"))
+      << s;
+}
+
+TEST(CSRSparseMatrixTest, EncodeDecode) {
+  VariantTensorData data;
+  TestMatrix().Encode(&data);
+  EXPECT_EQ(CSRSparseMatrix::kTypeName, data.type_name());
+  CSRSparseMatrix decoded;
+  ASSERT_TRUE(decoded.Decode(data));
+  ExpectMatrixEqual(TestMatrix(), decoded);
+}
+
+class CSRSparseMatrixOpsTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op, const std::vector<DataType>& inputs) {
+    NodeDefBuilder builder("myop", op);
+    for (DataType input : inputs) {
+      builder.Input(FakeInput(input));
+    }
+    TF_ASSERT_OK(builder.Attr("T", DT_FLOAT).Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  void AddMatrixInput(const CSRSparseMatrix& matrix) {
+    AddInputFromArray<Variant>(TensorShape({}), {matrix});
+  }
+
+  const CSRSparseMatrix& GetMatrixOutput(int index) {
+    const CSRSparseMatrix* matrix =
+        GetOutput(index)->scalar<Variant>()().get<CSRSparseMatrix>();
+    CHECK(matrix != nullptr);
+    TF_CHECK_OK(matrix->Validate());
+    return *matrix;
+  }
+};
+
+TEST_F(CSRSparseMatrixOpsTest, FromSparseTensor) {
+  MakeOp("SparseTensorToCSRSparseMatrix", {DT_INT64, DT_FLOAT, DT_INT64});
+  // Not in canonical order.
+  AddInputFromArray<int64>(TensorShape({4, 2}), {2, 3, 0, 2, 2, 1, 0, 0});
+  AddInputFromArray<float>(TensorShape({4}), {4, 2, 3, 1});
+  AddInputFromArray<int64>(TensorShape({2}), {3, 4});
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectMatrixEqual(TestMatrix(), GetMatrixOutput(0));
+}
+
+TEST_F(CSRSparseMatrixOpsTest, FromSparseTensorDuplicate) {
+  MakeOp("SparseTensorToCSRSparseMatrix", {DT_INT64, DT_FLOAT, DT_INT64});
+  AddInputFromArray<int64>(TensorShape({3, 2}), {1, 3, 0, 2, 1, 3});
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  AddInputFromArray<int64>(TensorShape({2}), {3, 4});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(str_util::StrContains(s.ToString(), "duplicate entries in row 1"))
+      << s;
+}
+
+TEST_F(CSRSparseMatrixOpsTest, FromSparseTensorOutOfBounds) {
+  MakeOp("SparseTensorToCSRSparseMatrix", {DT_INT64, DT_FLOAT, DT_INT64});
+  AddInputFromArray<int64>(TensorShape({2, 2}), {0, 0, 3, 1});
+  AddInputFromArray<float>(TensorShape({2}), {1, 2});
+  AddInputFromArray<int64>(TensorShape({2}), {3, 4});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(str_util::StrContains(s.ToString(),
+                                    "indices[1] = [3, 1] is out of bounds"))
+      << s;
+}
+
+TEST_F(CSRSparseMatrixOpsTest, FromDense) {
+  MakeOp("DenseToCSRSparseMatrix", {DT_FLOAT});
+  AddInputFromArray<float>(TensorShape({3, 4}),
+                           {1, 0, 2, 0, 0, 0, 0, 0, 0, 3, 0, 4});
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectMatrixEqual(TestMatrix(), GetMatrixOutput(0));
+}
+
+TEST_F(CSRSparseMatrixOpsTest, ToSparseTensor) {
+  MakeOp("CSRSparseMatrixToSparseTensor", {DT_VARIANT});
+  AddMatrixInput(TestMatrix());
+  TF_ASSERT_OK(RunOpKernel());
+  test::ExpectTensorEqual<int64>(
+      test::AsTensor<int64>({0, 0, 0, 2, 2, 1, 2, 3}, TensorShape({4, 2})),
+      *GetOutput(0));
+  test::ExpectTensorEqual<float>(test::AsTensor<float>({1, 2, 3, 4}),
+                                 *GetOutput(1));
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({3, 4}),
+                                 *GetOutput(2));
+}
+
+TEST_F(CSRSparseMatrixOpsTest, ToDense) {
+  MakeOp("CSRSparseMatrixToDense", {DT_VARIANT});
+  AddMatrixInput(TestMatrix());
+  TF_ASSERT_OK(RunOpKernel());
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({1, 0, 2, 0, 0, 0, 0, 0, 0, 3, 0, 4},
+                            TensorShape({3, 4})),
+      *GetOutput(0));
+}
+
+TEST_F(CSRSparseMatrixOpsTest, WrongType) {
+  NodeDefBuilder builder("myop", "CSRSparseMatrixToDense");
+  TF_ASSERT_OK(builder.Input(FakeInput(DT_VARIANT))
+                   .Attr("T", DT_DOUBLE)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddMatrixInput(TestMatrix());
+  Status s = RunOpKernel();
+  EXPECT_TRUE(str_util::StrContains(s.ToString(), "holds float")) << s;
+}
+
+TEST_F(CSRSparseMatrixOpsTest, MatMul) {
+  MakeOp("CSRSparseMatrixMatMul", {DT_VARIANT, DT_FLOAT});
+  AddMatrixInput(TestMatrix());
+  AddInputFromArray<float>(TensorShape({4, 2}), {1, 2, 3, 4, 5, 6, 7, 8});
+  TF_ASSERT_OK(RunOpKernel());
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({11, 14, 0, 0, 37, 44}, TensorShape({3, 2})),
+      *GetOutput(0));
+}
+
+TEST_F(CSRSparseMatrixOpsTest, MatMulIncompatible) {
+  MakeOp("CSRSparseMatrixMatMul", {DT_VARIANT, DT_FLOAT});
+  AddMatrixInput(TestMatrix());
+  AddInputFromArray<float>(TensorShape({3, 2}), {1, 2, 3, 4, 5, 6});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(str_util::StrContains(s.ToString(), "size-incompatible")) << s;
+}
+
+TEST_F(CSRSparseMatrixOpsTest, SparseMatMul) {
+  MakeOp("CSRSparseMatrixSparseMatMul", {DT_VARIANT, DT_VARIANT});
+  AddMatrixInput(TestMatrix());
+  // The 4 x 3 matrix
+  //   [[0, 5, 0],
+  //    [1, 0, 0],
+  //    [0, 1, 2],
+  //    [1, 0, 0]]
+  AddMatrixInput(CSRSparseMatrix(4, 3, test::AsTensor<int64>({0, 1, 2, 4, 5}),
+                                 test::AsTensor<int64>({1, 0, 1, 2, 0}),
+                                 test::AsTensor<float>({5, 1, 1, 2, 1})));
+  TF_ASSERT_OK(RunOpKernel());
+  // [[0, 7, 4],
+  //  [0, 0, 0],
+  //  [7, 0, 0]]
+  ExpectMatrixEqual(CSRSparseMatrix(3, 3, test::AsTensor<int64>({0, 2, 2, 3}),
+                                    test::AsTensor<int64>({1, 2, 0}),
+                                    test::AsTensor<float>({7, 4, 7})),
+                    GetMatrixOutput(0));
+}
+
+TEST_F(CSRSparseMatrixOpsTest, Transpose) {
+  MakeOp("CSRSparseMatrixTranspose", {DT_VARIANT});
+  AddMatrixInput(TestMatrix());
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectMatrixEqual(
+      CSRSparseMatrix(4, 3, test::AsTensor<int64>({0, 1, 2, 3, 4}),
+                      test::AsTensor<int64>({0, 2, 0, 2}),
+                      test::AsTensor<float>({1, 3, 2, 4})),
+      GetMatrixOutput(0));
+}
+
+// Returns a `rows` x `rows` adjacency matrix with `degree` nonzeros per row on
+// average, where the degrees of the rows follow a power law, as in graph
+// models.
+CSRSparseMatrix RandomGraph(int64 rows, int64 degree) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64> row_ptrs = {0};
+  std::vector<int64> col_indices;
+  for (int64 i = 0; i < rows; ++i) {
+    const int64 row_degree =
+        std::min(rows, degree * rows / (10 * (i + 1)) + degree / 2);
+    const int64 stride = rows / row_degree;
+    const int64 start = rnd.Uniform64(stride);
+    for (int64 j = 0; j < row_degree; ++j) {
+      col_indices.push_back(start + j * stride);
+    }
+    row_ptrs.push_back(col_indices.size());
+  }
+  const int64 nnz = col_indices.size();
+  Tensor values(DT_FLOAT, TensorShape({nnz}));
+  values.flat<float>().setRandom();
+  return CSRSparseMatrix(rows, rows, test::AsTensor<int64>(row_ptrs),
+                         test::AsTensor<int64>(col_indices), values);
+}
+
+// Graph convolution step: multiplies a 100k-node graph by a [100k, 64] matrix
+// of node features, either with the CSR matrix or with the equivalent
+// SparseTensor.
+static void GraphMatMulHelper(int iters, bool csr, int num_threads) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  const int64 kRows = 100000;
+  const int64 kFeatures = 64;
+  const CSRSparseMatrix adjacency = RandomGraph(kRows, 16);
+  Tensor features(DT_FLOAT, TensorShape({kRows, kFeatures}));
+  features.flat<float>().setRandom();
+
+  Node* node;
+  if (csr) {
+    Tensor matrix(DT_VARIANT, TensorShape({}));
+    matrix.scalar<Variant>()() = adjacency;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "CSRSparseMatrixMatMul")
+                    .Input(test::graph::Constant(g, matrix))
+                    .Input(test::graph::Constant(g, features))
+                    .Attr("T", DT_FLOAT)
+                    .Finalize(g, &node));
+  } else {
+    Tensor indices(DT_INT64, TensorShape({adjacency.nnz(), 2}));
+    auto indices_mat = indices.matrix<int64>();
+    auto row_ptrs = adjacency.row_ptrs().vec<int64>();
+    auto col_indices = adjacency.col_indices().vec<int64>();
+    for (int64 i = 0; i < kRows; ++i) {
+      for (int64 j = row_ptrs(i); j < row_ptrs(i + 1); ++j) {
+        indices_mat(j, 0) = i;
+        indices_mat(j, 1) = col_indices(j);
+      }
+    }
+    TF_CHECK_OK(
+        NodeBuilder(g->NewName("n"), "SparseTensorDenseMatMul")
+            .Input(test::graph::Constant(g, indices))
+            .Input(test::graph::Constant(g, adjacency.values()))
+            .Input(test::graph::Constant(g, test::AsTensor<int64>({kRows,
+                                                                   kRows})))
+            .Input(test::graph::Constant(g, features))
+            .Finalize(g, &node));
+  }
+
+  SessionOptions opts;
+  opts.config.set_intra_op_parallelism_threads(num_threads);
+  opts.config.set_inter_op_parallelism_threads(1);
+  testing::UseRealTime();
+  testing::ItemsProcessed(static_cast<int64>(iters) * adjacency.nnz() *
+                          kFeatures);
+  testing::StartTiming();
+  test::Benchmark("cpu", g, &opts).Run(iters);
+}
+
+static void BM_CSRSparseMatrixMatMul(int iters, int num_threads) {
+  GraphMatMulHelper(iters, true, num_threads);
+}
+
+static void BM_SparseTensorGraphMatMul(int iters, int num_threads) {
+  GraphMatMulHelper(iters, false, num_threads);
+}
+
+BENCHMARK(BM_CSRSparseMatrixMatMul)->Arg(1)->Arg(4)->Arg(16);
+BENCHMARK(BM_SparseTensorGraphMatMul)->Arg(1)->Arg(4)->Arg(16);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,182 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/common_shape_fns.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/shape_inference.h"
+
+namespace tensorflow {
+
+using shape_inference::DimensionHandle;
+using shape_inference::InferenceContext;
+using shape_inference::ShapeHandle;
+
+REGISTER_OP("SparseTensorToCSRSparseMatrix")
+    .Input("indices: int64")
+    .Input("values: T")
+    .Input("dense_shape: int64")
+    .Output("sparse_matrix: variant")
+    .Attr("T: {float, double}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle indices;
+      ShapeHandle values;
+      ShapeHandle dense_shape;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &indices));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &values));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &dense_shape));
+      DimensionHandle unused;
+      TF_RETURN_IF_ERROR(c->WithValue(c->Dim(indices, 1), 2, &unused));
+      TF_RETURN_IF_ERROR(c->WithValue(c->Dim(dense_shape, 0), 2, &unused));
+      TF_RETURN_IF_ERROR(
+          c->Merge(c->Dim(indices, 0), c->Dim(values, 0), &unused));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Converts a 2-D SparseTensor to a CSR sparse matrix.
+
+The indices need not be ordered, but must not repeat.
+
+indices: 2-D. The indices of the nonzeros of the SparseTensor.
+values: 1-D. The values of the nonzeros of the SparseTensor.
+dense_shape: 1-D. The shape of the SparseTensor.
+sparse_matrix: A scalar variant holding the CSR sparse matrix.
+)doc");
+
+REGISTER_OP("DenseToCSRSparseMatrix")
+    .Input("dense: T")
+    .Output("sparse_matrix: variant")
+    .Attr("T: {float, double}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &unused));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Converts the nonzeros of a dense matrix to a CSR sparse matrix.
+
+dense: 2-D.
+sparse_matrix: A scalar variant holding the CSR sparse matrix.
+)doc");
+
+REGISTER_OP("CSRSparseMatrixToSparseTensor")
+    .Input("sparse_matrix: variant")
+    .Output("indices: int64")
+    .Output("values: T")
+    .Output("dense_shape: int64")
+    .Attr("T: {float, double}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      c->set_output(0, c->Matrix(InferenceContext::kUnknownDim, 2));
+      c->set_output(1, c->Vector(InferenceContext::kUnknownDim));
+      c->set_output(2, c->Vector(2));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Converts a CSR sparse matrix to a SparseTensor, in row-major order.
+
+sparse_matrix: A scalar variant holding a CSR sparse matrix of type T.
+indices: 2-D. The indices of the nonzeros.
+values: 1-D. The values of the nonzeros.
+dense_shape: 1-D. The shape of the matrix.
+)doc");
+
+REGISTER_OP("CSRSparseMatrixToDense")
+    .Input("sparse_matrix: variant")
+    .Output("dense: T")
+    .Attr("T: {float, double}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      c->set_output(0, c->Matrix(InferenceContext::kUnknownDim,
+                                 InferenceContext::kUnknownDim));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Converts a CSR sparse matrix to a dense matrix.
+
+sparse_matrix: A scalar variant holding a CSR sparse matrix of type T.
+dense: 2-D.
+)doc");
+
+REGISTER_OP("CSRSparseMatrixMatMul")
+    .Input("a: variant")
+    .Input("b: T")
+    .Output("product: T")
+    .Attr("T: {float, double}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      ShapeHandle b;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &b));
+      c->set_output(0,
+                    c->Matrix(InferenceContext::kUnknownDim, c->Dim(b, 1)));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Multiplies a CSR sparse matrix by a dense matrix.
+
+Rows of the product are computed in parallel, in blocks holding about the same
+number of nonzeros of `a`.  Sparse matrix-vector products are the case of `b`
+with a single column.
+
+a: A scalar variant holding a CSR sparse matrix of type T, of shape [m, k].
+b: 2-D, of shape [k, n].
+product: 2-D, of shape [m, n].
+)doc");
+
+REGISTER_OP("CSRSparseMatrixSparseMatMul")
+    .Input("a: variant")
+    .Input("b: variant")
+    .Output("product: variant")
+    .Attr("T: {float, double}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 0, &unused));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Multiplies two CSR sparse matrices.
+
+The product only holds the entries that some product of nonzeros contributes
+to, and its rows are computed in parallel.
+
+a: A scalar variant holding a CSR sparse matrix of type T, of shape [m, k].
+b: A scalar variant holding a CSR sparse matrix of type T, of shape [k, n].
+product: A scalar variant holding the CSR sparse matrix of shape [m, n].
+)doc");
+
+REGISTER_OP("CSRSparseMatrixTranspose")
+    .Input("input: variant")
+    .Output("output: variant")
+    .Attr("T: {float, double}")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+      c->set_output(0, c->Scalar());
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Transposes a CSR sparse matrix.
+
+input: A scalar variant holding a CSR sparse matrix of type T.
+output: A scalar variant holding the transposed CSR sparse matrix.
+)doc");
+
+}  // namespace tensorflow
@@ -0,0 +1,147 @@
+# Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Tests for CSR sparse matrix ops."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import numpy as np
+
+from tensorflow.contrib.sparse_matrix.python.ops import sparse_matrix_ops
+from tensorflow.core.protobuf import config_pb2
+from tensorflow.python.framework import constant_op
+from tensorflow.python.framework import dtypes
+from tensorflow.python.framework import sparse_tensor
+from tensorflow.python.ops import gradient_checker
+from tensorflow.python.platform import test
+
+
+def _random_sparse(shape, density, seed):
+  rng = np.random.RandomState(seed)
+  x = rng.randn(*shape)
+  x[rng.rand(*shape) > density] = 0
+  return x
+
+
+class CSRSparseMatrixTest(test.TestCase):
+
+  def _testRoundTrip(self, dtype):
+    x = _random_sparse([7, 5], 0.4, seed=1).astype(dtype)
+    with self.cached_session():
+      matrix = sparse_matrix_ops.CSRSparseMatrix.from_dense(x)
+      self.assertAllEqual(x, matrix.to_dense().eval())
+      sp = matrix.to_sparse_tensor()
+      indices, values, dense_shape = self.evaluate(
+          [sp.indices, sp.values, sp.dense_shape])
+      self.assertAllEqual(np.transpose(np.nonzero(x)), indices)
+      self.assertAllEqual(x[np.nonzero(x)], values)
+      self.assertAllEqual([7, 5], dense_shape)
+
+  def testRoundTrip(self):
+    self._testRoundTrip(np.float32)
+    self._testRoundTrip(np.float64)
+
+  def testFromSparseTensor(self):
+    sp = sparse_tensor.SparseTensor(
+        indices=[[2, 1], [0, 3], [0, 0]], values=[3., 2., 1.],
+        dense_shape=[3, 4])
+    with self.cached_session():
+      matrix = sparse_matrix_ops.CSRSparseMatrix.from_sparse_tensor(sp)
+      self.assertAllEqual([[1, 0, 0, 2], [0, 0, 0, 0], [0, 3, 0, 0]],
+                          matrix.to_dense().eval())
+
+  def testFromSparseTensorDuplicates(self):
+    sp = sparse_tensor.SparseTensor(
+        indices=[[0, 1], [0, 1]], values=[1., 2.], dense_shape=[3, 4])
+    with self.cached_session():
+      matrix = sparse_matrix_ops.CSRSparseMatrix.from_sparse_tensor(sp)
+      with self.assertRaisesOpError("duplicate entries in row 0"):
+        matrix.to_dense().eval()
+
+  def testTranspose(self):
+    x = _random_sparse([40, 30], 0.2, seed=2)
+    with self.cached_session():
+      matrix = sparse_matrix_ops.CSRSparseMatrix.from_dense(x)
+      self.assertAllEqual(x.T, matrix.transpose().to_dense().eval())
+
+  def testMatMul(self):
+    x = _random_sparse([50, 40], 0.1, seed=3)
+    y = np.random.RandomState(4).randn(40, 8)
+    with self.cached_session():
+      matrix = sparse_matrix_ops.CSRSparseMatrix.from_dense(x)
+      self.assertAllClose(
+          np.dot(x, y), sparse_matrix_ops.matmul(matrix, y).eval())
+      # Matrix-vector product.
+      self.assertAllClose(
+          np.dot(x, y[:, :1]),
+          sparse_matrix_ops.matmul(matrix, y[:, :1]).eval())
+
+  def testMatMulWrongShape(self):
+    with self.cached_session():
+      matrix = sparse_matrix_ops.CSRSparseMatrix.from_dense(np.eye(3))
+      with self.assertRaisesOpError("size-incompatible"):
+        sparse_matrix_ops.matmul(matrix, np.ones([4, 2])).eval()
+
+  def testMatMulWrongDtype(self):
+    matrix = sparse_matrix_ops.CSRSparseMatrix.from_dense(
+        np.eye(3, dtype=np.float32))
+    with self.assertRaises(TypeError):
+      sparse_matrix_ops.matmul(
+          matrix,
+          sparse_matrix_ops.CSRSparseMatrix.from_dense(np.eye(3)))
+
+  def testSparseMatMul(self):
+    x = _random_sparse([30, 20], 0.1, seed=5)
+    y = _random_sparse([20, 25], 0.1, seed=6)
+    with self.cached_session():
+      product = sparse_matrix_ops.matmul(
+          sparse_matrix_ops.CSRSparseMatrix.from_dense(x),
+          sparse_matrix_ops.CSRSparseMatrix.from_dense(y))
+      self.assertAllClose(np.dot(x, y), product.to_dense().eval())
+
+  def testMultiThreaded(self):
+    # Skewed rows, as in graphs, split across threads.
+    x = _random_sparse([500, 400], 0.05, seed=7)
+    x[:5, :] = np.random.RandomState(8).randn(5, 400)
+    y = np.random.RandomState(9).randn(400, 16)
+    config = config_pb2.ConfigProto(intra_op_parallelism_threads=4)
+    with self.session(config=config):
+      matrix = sparse_matrix_ops.CSRSparseMatrix.from_dense(x)
+      dense, product, sparse_product, transpose = self.evaluate([
+          matrix.to_dense(),
+          sparse_matrix_ops.matmul(matrix, y),
+          sparse_matrix_ops.matmul(matrix, matrix.transpose()).to_dense(),
+          matrix.transpose().to_dense()
+      ])
+      self.assertAllEqual(x, dense)
+      self.assertAllClose(np.dot(x, y), product)
+      self.assertAllClose(np.dot(x, x.T), sparse_product)
+      self.assertAllEqual(x.T, transpose)
+
+  def testMatMulGradient(self):
+    x = _random_sparse([6, 5], 0.5, seed=10)
+    with self.cached_session():
+      matrix = sparse_matrix_ops.CSRSparseMatrix.from_dense(x)
+      y = constant_op.constant(
+          np.random.RandomState(11).randn(5, 3), dtype=dtypes.float64)
+      product = sparse_matrix_ops.matmul(matrix, y)
+      error = gradient_checker.compute_gradient_error(
+          y, [5, 3], product, [6, 3])
+      self.assertLess(error, 1e-8)
+
+
+if __name__ == "__main__":
+  test.main()
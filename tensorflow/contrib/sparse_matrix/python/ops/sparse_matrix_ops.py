@@ -0,0 +1,143 @@
+# Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+"""Wrappers for CSR sparse matrix operations."""
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+from tensorflow.contrib.util import loader
+from tensorflow.python.framework import ops
+from tensorflow.python.framework import sparse_tensor
+from tensorflow.python.platform import resource_loader
+
+_sparse_matrix_ops = loader.load_op_library(
+    resource_loader.get_path_to_datafile("_sparse_matrix_ops.so"))
+
+__all__ = ["CSRSparseMatrix", "matmul"]
+
+
+class CSRSparseMatrix(object):
+  """A 2-D sparse matrix in compressed sparse row (CSR) format.
+
+  The matrix is held by a scalar variant tensor, so that its structure is built
+  once, instead of being re-derived from a `SparseTensor` by every op that
+  uses it.
+  """
+
+  def __init__(self, handle, dtype):
+    """Wraps a scalar variant tensor holding a CSR sparse matrix.
+
+    Args:
+      handle: A scalar `variant` `Tensor`, as produced by the conversion ops.
+      dtype: The `DType` of the values of the matrix.
+    """
+    self._handle = handle
+    self._dtype = dtype
+
+  @classmethod
+  def from_sparse_tensor(cls, sp_input, name=None):
+    """Converts a 2-D `SparseTensor`, whose indices must not repeat."""
+    sp_input = sparse_tensor.SparseTensor.from_value(sp_input)
+    with ops.name_scope(name, "SparseTensorToCSRSparseMatrix", [sp_input]):
+      handle = _sparse_matrix_ops.sparse_tensor_to_csr_sparse_matrix(
+          sp_input.indices, sp_input.values, sp_input.dense_shape)
+    return cls(handle, sp_input.dtype)
+
+  @classmethod
+  def from_dense(cls, dense, name=None):
+    """Converts the nonzeros of a dense matrix."""
+    with ops.name_scope(name, "DenseToCSRSparseMatrix", [dense]):
+      dense = ops.convert_to_tensor(dense, name="dense")
+      handle = _sparse_matrix_ops.dense_to_csr_sparse_matrix(dense)
+    return cls(handle, dense.dtype)
+
+  @property
+  def handle(self):
+    """The scalar variant `Tensor` holding the matrix."""
+    return self._handle
+
+  @property
+  def dtype(self):
+    """The `DType` of the values of the matrix."""
+    return self._dtype
+
+  def to_sparse_tensor(self, name=None):
+    """Returns the matrix as a `SparseTensor`, in row-major order."""
+    indices, values, dense_shape = (
+        _sparse_matrix_ops.csr_sparse_matrix_to_sparse_tensor(
+            self._handle, T=self._dtype, name=name))
+    return sparse_tensor.SparseTensor(indices, values, dense_shape)
+
+  def to_dense(self, name=None):
+    """Returns the matrix as a dense `Tensor`."""
+    return _sparse_matrix_ops.csr_sparse_matrix_to_dense(
+        self._handle, T=self._dtype, name=name)
+
+  def transpose(self, name=None):
+    """Returns the transpose of the matrix, as a `CSRSparseMatrix`."""
+    return CSRSparseMatrix(
+        _sparse_matrix_ops.csr_sparse_matrix_transpose(
+            self._handle, T=self._dtype, name=name), self._dtype)
+
+
+def matmul(a, b, name=None):
+  """Multiplies a `CSRSparseMatrix` by a dense matrix or a `CSRSparseMatrix`.
+
+  The rows of the product are computed in parallel.  For sparse
+  matrix-vector products, `b` is a matrix with a single column.
+
+  Args:
+    a: A `CSRSparseMatrix` of shape `[m, k]`.
+    b: A `CSRSparseMatrix`, or a dense `Tensor`, of shape `[k, n]` and the
+      same dtype as `a`.
+    name: A name for the operation (optional).
+
+  Returns:
+    A `CSRSparseMatrix` of shape `[m, n]` if `b` is a `CSRSparseMatrix`, and a
+    dense `Tensor` otherwise.  Only the product with a dense `b` has a
+    gradient, with respect to `b`.
+
+  Raises:
+    TypeError: If `a` is not a `CSRSparseMatrix`, or the dtypes differ.
+  """
+  if not isinstance(a, CSRSparseMatrix):
+    raise TypeError("a must be a CSRSparseMatrix, got %s" % type(a))
+  if isinstance(b, CSRSparseMatrix):
+    if a.dtype != b.dtype:
+      raise TypeError("a and b must have the same dtype, got %s and %s" %
+                      (a.dtype, b.dtype))
+    return CSRSparseMatrix(
+        _sparse_matrix_ops.csr_sparse_matrix_sparse_mat_mul(
+            a.handle, b.handle, T=a.dtype, name=name), a.dtype)
+  with ops.name_scope(name, "CSRSparseMatrixMatMul", [a.handle, b]):
+    b = ops.convert_to_tensor(b, dtype=a.dtype, name="b")
+    return _sparse_matrix_ops.csr_sparse_matrix_mat_mul(a.handle, b)
+
+
+@ops.RegisterGradient("CSRSparseMatrixMatMul")
+def _csr_sparse_matrix_mat_mul_grad(op, grad):
+  """The gradient of the product with respect to the dense matrix."""
+  a_transpose = _sparse_matrix_ops.csr_sparse_matrix_transpose(
+      op.inputs[0], T=op.get_attr("T"))
+  return None, _sparse_matrix_ops.csr_sparse_matrix_mat_mul(a_transpose, grad)
+
+
+ops.NotDifferentiable("SparseTensorToCSRSparseMatrix")
+ops.NotDifferentiable("DenseToCSRSparseMatrix")
+ops.NotDifferentiable("CSRSparseMatrixToSparseTensor")
+ops.NotDifferentiable("CSRSparseMatrixToDense")
+ops.NotDifferentiable("CSRSparseMatrixSparseMatMul")
+ops.NotDifferentiable("CSRSparseMatrixTranspose")
@@ -16,6 +16,7 @@ limitations under the License.
 
 #include <stddef.h>
 #include <algorithm>
+#include <map>
 #include <unordered_map>
 #include <utility>
 
@@ -430,6 +431,7 @@ void CollectiveParamResolverLocal::CompleteDefaultRanking(
   size_t num_devices = ir->shared.group.group_size;
   std::vector<string> new_device_names(num_devices, "");
   std::vector<string> new_task_names(num_devices, "");
+  std::vector<int> new_numa_nodes(num_devices, 0);
   for (const auto& git : gdm) {
     const TaskDeviceMap& tdm = git.second;
     for (const auto& tit : tdm) {
@@ -438,11 +440,21 @@ void CollectiveParamResolverLocal::CompleteDefaultRanking(
           ir->shared.instance.device_names[dr.original_rank];
       new_task_names[dr.global_rank] =
           ir->shared.instance.task_names[dr.original_rank];
+      new_numa_nodes[dr.global_rank] = dr.locality->numa_node();
     }
   }
 
   ir->shared.instance.device_names = new_device_names;
   ir->shared.instance.task_names = new_task_names;
+  // Group the devices sharing a task and NUMA node, for hierarchical
+  // collectives.
+  std::map<std::pair<string, int>, int> group_ids;
+  ir->shared.instance.locality_groups.clear();
+  for (size_t i = 0; i < num_devices; ++i) {
+    auto key = std::make_pair(new_task_names[i], new_numa_nodes[i]);
+    auto it = group_ids.insert({key, static_cast<int>(group_ids.size())});
+    ir->shared.instance.locality_groups.push_back(it.first->second);
+  }
   if (VLOG_IS_ON(2)) {
     string buf;
     for (const auto& d : new_device_names) strings::StrAppend(&buf, "\n", d);
@@ -611,9 +623,13 @@ void CollectiveParamResolverLocal::CompleteInstanceFromInitializedIRec(
   // TODO(b/113171733): we need a better way to pick the collective
   // implementation.  The ideal way would depend upon the topology and link
   // strength before picking a particular implementation.
-  cp->instance.impl_details.collective_name =
-      (cp->instance.type == BROADCAST_COLLECTIVE) ? "HierarchicalTreeBroadcast"
-                                                  : "RingReduce";
+  if (cp->instance.type == BROADCAST_COLLECTIVE) {
+    cp->instance.impl_details.collective_name = "HierarchicalTreeBroadcast";
+  } else if (cp->instance.impl_details.hierarchical) {
+    cp->instance.impl_details.collective_name = "HierarchicalReduce";
+  } else {
+    cp->instance.impl_details.collective_name = "RingReduce";
+  }
   CollectiveImplementationInterface* col_impl;
   Status lookup_status = CollectiveRegistry::LookupParamResolverInstance(
       cp->instance.impl_details.collective_name, &col_impl);
@@ -93,6 +93,50 @@ TEST_F(CollectiveParamResolverLocalTest, CompleteParamsReduction1Task) {
     EXPECT_FALSE(cps[i].is_source);
     EXPECT_EQ(cps[i].default_rank, i);
     EXPECT_TRUE(cps[i].instance.same_num_devices_per_task);
+    // All devices share a task and NUMA node.
+    EXPECT_EQ(std::vector<int>(NUM_DEVS, 0), cps[i].instance.locality_groups);
+    EXPECT_EQ("RingReduce", cps[i].instance.impl_details.collective_name);
+  }
+}
+
+TEST_F(CollectiveParamResolverLocalTest, CompleteParamsHierarchicalReduction) {
+  CollectiveParams cps[NUM_DEVS];
+  Status statuses[NUM_DEVS];
+  Notification note[NUM_DEVS];
+  for (int i = 0; i < NUM_DEVS; ++i) {
+    CollectiveParams* cp = &cps[i];
+    cp->group.group_key = 1;
+    cp->group.group_size = 3;
+    cp->group.device_type = DeviceType("CPU");
+    cp->group.num_tasks = 1;
+    cp->instance.instance_key = 8;
+    cp->instance.type = REDUCTION_COLLECTIVE;
+    cp->instance.data_type = DataType(DT_FLOAT);
+    cp->instance.shape = TensorShape({5});
+    cp->instance.device_names.push_back(
+        strings::StrCat("/job:localhost/replica:0/task:0/device:CPU:", i));
+    cp->instance.impl_details.hierarchical = true;
+    cp->is_source = false;
+    Env::Default()->SchedClosure([this, i, cp, &note, &statuses]() {
+      prl_->CompleteParamsAsync(cp->instance.device_names[0], cp,
+                                nullptr /*CancellationManager*/,
+                                [this, &statuses, &note, i](const Status& s) {
+                                  statuses[i] = s;
+                                  note[i].Notify();
+                                });
+    });
+  }
+  for (int i = 0; i < NUM_DEVS; ++i) {
+    note[i].WaitForNotification();
+  }
+  for (int i = 0; i < NUM_DEVS; ++i) {
+    TF_ASSERT_OK(statuses[i]);
+    EXPECT_EQ("HierarchicalReduce",
+              cps[i].instance.impl_details.collective_name);
+    // One locality group, whose leader is the first device.
+    EXPECT_EQ((std::vector<std::vector<int>>{{0}, {0, 1, 2}}),
+              cps[i].instance.impl_details.subdiv_permutations);
+    EXPECT_EQ((std::vector<int>{i == 0 ? 0 : -1, i}), cps[i].subdiv_rank);
   }
 }
 
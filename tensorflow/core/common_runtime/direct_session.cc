@@ -34,6 +34,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/common_runtime/scoped_allocator_mgr.h"
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/common_runtime/step_trace_collector.h"
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/graph.pb_text.h"
 #include "tensorflow/core/framework/graph.pb.h"
@@ -547,6 +548,17 @@ Status DirectSession::RunInternal(int64 step_id, const RunOptions& run_options,
     args.stats_collector = run_state.collector.get();
   }
 
+  // Sample a lightweight trace of the steps that are not traced otherwise.
+  std::unique_ptr<StepTraceCollector> step_trace;
+  const int32 step_trace_sample_period =
+      options_.config.experimental().step_trace_sample_period();
+  if (args.stats_collector == nullptr && run_metadata != nullptr &&
+      step_trace_sample_period > 0 &&
+      executor_step_count % step_trace_sample_period == 0) {
+    step_trace.reset(new StepTraceCollector);
+    args.stats_collector = step_trace.get();
+  }
+
   std::unique_ptr<DeviceTracer> tracer;
   if (run_options.trace_level() >= RunOptions::HARDWARE_TRACE) {
     tracer = CreateDeviceTracer();
@@ -677,6 +689,10 @@ Status DirectSession::RunInternal(int64 step_id, const RunOptions& run_options,
     run_state.collector->Finalize();
   }
 
+  if (step_trace) {
+    step_trace->ToStepStats(run_metadata->mutable_step_stats());
+  }
+
   // Build and return the cost model as instructed.
   if (update_cost_model) {
     // Build the cost model
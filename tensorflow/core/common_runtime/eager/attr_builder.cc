@@ -100,6 +100,7 @@ Status AttrTypeMapForOp(const char* op_name, const AttrTypeMap** out) {
   template <>                                                                \
   AttrBuilder& AttrBuilder::Set(StringPiece attr_name, value_type&& value) { \
     value_field.push_back(std::make_pair(attr_name, value));                 \
+    cached_cache_key_valid_ = false;                                         \
     return *this;                                                            \
   }
 
@@ -207,6 +208,15 @@ inline tensorflow::Fprint128 CacheKeyHelper(StringPiece s, uint64 b) {
 }  // namespace
 
 tensorflow::Fprint128 AttrBuilder::CacheKey(const string& device) const {
+  if (!cached_cache_key_valid_ || cached_cache_key_device_ != device) {
+    cached_cache_key_ = ComputeCacheKey(device);
+    cached_cache_key_device_ = device;
+    cached_cache_key_valid_ = true;
+  }
+  return cached_cache_key_;
+}
+
+tensorflow::Fprint128 AttrBuilder::ComputeCacheKey(const string& device) const {
   tensorflow::Fprint128 f = tensorflow::Fingerprint128(op_name_);
   f = tensorflow::FingerprintCat128(f, tensorflow::Fingerprint128(device));
   if (node_def_ != nullptr) {
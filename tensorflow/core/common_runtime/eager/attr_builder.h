@@ -78,6 +78,9 @@ Status AttrTypeByName(const AttrTypeMap& m, const string& attr_name,
 // BuildNodeDef. Also, calls to NumInputs or Set between multiple invocations
 // to CacheKey may cause different values to be returned by CacheKey.
 //
+// CacheKey memoizes its result until the next call to Set, so that executing
+// the same op repeatedly does not fingerprint its attributes each time.
+//
 // For performance reasons, the class internally delays the actual construction
 // of the NodeDef till BuildNodeDef is called, or Set is called with certain
 // uncommon types (see template specializations of Set to see which types
@@ -88,7 +91,8 @@ class AttrBuilder {
       : op_name_(op),
         num_inputs_(0),
         node_def_(nullptr),
-        node_def_finalized_(false) {}
+        node_def_finalized_(false),
+        cached_cache_key_valid_(false) {}
 
   // Needed to work around call to ValidateNodeDef in CreateOpKernel.
   AttrBuilder& NumInputs(int n);
@@ -97,6 +101,7 @@ class AttrBuilder {
   AttrBuilder& Set(StringPiece attr_name, T&& value) {
     MayBeInitializeNodeDef();
     SetInAttrValueMap(node_def_->mutable_attr(), attr_name, value);
+    cached_cache_key_valid_ = false;
     return *this;
   }
 
@@ -109,6 +114,8 @@ class AttrBuilder {
   template <class T>
   using AttrVec = tensorflow::gtl::InlinedVector<std::pair<StringPiece, T>, 2>;
 
+  tensorflow::Fprint128 ComputeCacheKey(const string& device) const;
+
   void MayBeInitializeNodeDef();
   // Fill `m` with the attr-value pairs set via AttrBuilder::Set() so far, as
   // well as any default attr-value pairs from the associated op_def, if there
@@ -145,6 +152,11 @@ class AttrBuilder {
   int num_inputs_;
   std::unique_ptr<NodeDef> node_def_;
   bool node_def_finalized_;
+
+  // The result of the last call to CacheKey, and the device it was for.
+  mutable bool cached_cache_key_valid_;
+  mutable string cached_cache_key_device_;
+  mutable tensorflow::Fprint128 cached_cache_key_;
 };  // namespace tensorflow
 
 template <>
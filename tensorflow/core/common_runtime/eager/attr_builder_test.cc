@@ -58,5 +58,25 @@ TEST(AttrTypeMap, Lookup) {
   EXPECT_NE(is_list, 0);
 }
 
+TEST(AttrBuilder, CacheKey) {
+  AttrBuilder a("MatMul");
+  a.Set("transpose_a", true);
+  const Fprint128 key = a.CacheKey("cpu:0");
+  EXPECT_EQ(key, a.CacheKey("cpu:0"));
+  EXPECT_FALSE(key == a.CacheKey("cpu:1"));
+  EXPECT_EQ(key, a.CacheKey("cpu:0"));
+
+  AttrBuilder b("MatMul");
+  b.Set("transpose_a", true);
+  EXPECT_EQ(key, b.CacheKey("cpu:0"));
+
+  // Setting an attribute invalidates the memoized key.
+  a.Set("transpose_b", true);
+  const Fprint128 new_key = a.CacheKey("cpu:0");
+  EXPECT_FALSE(key == new_key);
+  a.BuildNodeDef();
+  EXPECT_EQ(new_key, a.CacheKey("cpu:0"));
+}
+
 }  // namespace
 }  // namespace tensorflow
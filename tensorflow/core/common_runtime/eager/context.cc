@@ -44,6 +44,26 @@ std::unique_ptr<thread::ThreadPool> EagerThreadPool(
       NewThreadPoolFromSessionOptions(opts_copy));
 }
 
+uint64 NewKernelCacheGeneration() {
+  static std::atomic<uint64> next_generation(1);
+  return next_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+// A small direct-mapped cache of the kernels a thread recently looked up, in
+// any EagerContext.
+struct ThreadKernelCacheEntry {
+  // The kernel_cache_generation_ of the context the kernel belongs to.
+  uint64 generation = 0;
+  Fprint128 cache_key = {0, 0};
+  KernelAndDevice* kernel = nullptr;
+};
+
+ThreadKernelCacheEntry* ThreadKernelCacheEntryFor(Fprint128 cache_key) {
+  static constexpr int kNumEntries = 16;
+  static thread_local ThreadKernelCacheEntry entries[kNumEntries];
+  return &entries[cache_key.low64 % kNumEntries];
+}
+
 }  // namespace
 
 EagerContext::EagerContext(const SessionOptions& opts,
@@ -65,6 +85,7 @@ EagerContext::EagerContext(const SessionOptions& opts,
       pflr_(new ProcessFunctionLibraryRuntime(
           device_mgr, opts.env, TF_GRAPH_DEF_VERSION, &func_lib_def_, {},
           thread_pool_.get())),
+      kernel_cache_generation_(NewKernelCacheGeneration()),
       log_device_placement_(opts.config.log_device_placement()),
       num_active_steps_(0),
       async_default_(async),
@@ -135,6 +156,8 @@ Status EagerContext::SetAsyncForThread(bool async) {
 
 void EagerContext::ClearCaches() {
   mutex_lock ml(cache_mu_);
+  kernel_cache_generation_.store(NewKernelCacheGeneration(),
+                                 std::memory_order_release);
   gtl::STLDeleteValues(&kernel_cache_);
 }
 
@@ -306,14 +329,30 @@ Status EagerContext::AddFunctionDef(const FunctionDef& fdef) {
 }
 
 KernelAndDevice* EagerContext::GetCachedKernel(Fprint128 cache_key) {
+  ThreadKernelCacheEntry* entry = ThreadKernelCacheEntryFor(cache_key);
+  if (entry->generation ==
+          kernel_cache_generation_.load(std::memory_order_acquire) &&
+      entry->cache_key == cache_key) {
+    return entry->kernel;
+  }
   tf_shared_lock l(cache_mu_);
-  return gtl::FindPtrOrNull(kernel_cache_, cache_key);
+  KernelAndDevice* kernel = gtl::FindPtrOrNull(kernel_cache_, cache_key);
+  if (kernel != nullptr) {
+    entry->generation = kernel_cache_generation_;
+    entry->cache_key = cache_key;
+    entry->kernel = kernel;
+  }
+  return kernel;
 }
 
 void EagerContext::AddKernelToCache(Fprint128 cache_key,
                                     KernelAndDevice* kernel) {
   mutex_lock ml(cache_mu_);
   gtl::InsertOrUpdate(&kernel_cache_, cache_key, kernel);
+  ThreadKernelCacheEntry* entry = ThreadKernelCacheEntryFor(cache_key);
+  entry->generation = kernel_cache_generation_;
+  entry->cache_key = cache_key;
+  entry->kernel = kernel;
 }
 
 void EagerContext::SetShouldStoreMetadata(bool value) {
@@ -139,6 +139,9 @@ class EagerContext {
 
   Status AddFunctionDef(const FunctionDef& fdef);
 
+  // Returns the kernel cached under `cache_key`, or nullptr. The kernels
+  // recently looked up by a thread are also cached in that thread, so that
+  // looking them up again takes no lock.
   KernelAndDevice* GetCachedKernel(Fprint128 cache_key);
 
   void AddKernelToCache(Fprint128 cache_key, KernelAndDevice* kernel);
@@ -246,6 +249,9 @@ class EagerContext {
   mutex cache_mu_;
   std::unordered_map<Fprint128, KernelAndDevice*, Fprint128Hasher> kernel_cache_
       GUARDED_BY(cache_mu_);
+  // Identifies the contents of `kernel_cache_` in the per-thread kernel caches.
+  // Unique across contexts, and renewed by ClearCaches.
+  std::atomic<uint64> kernel_cache_generation_;
 
   // Whether we should compute RunMetadata.
   std::atomic<bool> should_store_metadata_{false};
@@ -0,0 +1,96 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/eager/context.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/eager/kernel_and_device.h"
+#include "tensorflow/core/common_runtime/rendezvous_mgr.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+std::unique_ptr<EagerContext> NewContext() {
+  std::unique_ptr<DeviceMgr> device_mgr(new DeviceMgr({DeviceFactory::NewDevice(
+      "CPU", SessionOptions(), "/job:localhost/replica:0/task:0")}));
+  Rendezvous* rendezvous = new IntraProcessRendezvous(device_mgr.get());
+  return std::unique_ptr<EagerContext>(new EagerContext(
+      SessionOptions(), DEVICE_PLACEMENT_SILENT, /*async=*/false,
+      std::move(device_mgr), rendezvous));
+}
+
+// Looks `cache_key` up in `context`, from a new thread.
+KernelAndDevice* GetCachedKernelOnNewThread(EagerContext* context,
+                                            Fprint128 cache_key) {
+  KernelAndDevice* kernel = nullptr;
+  std::unique_ptr<Thread> thread(Env::Default()->StartThread(
+      {}, "lookup",
+      [&] { kernel = context->GetCachedKernel(cache_key); }));
+  thread.reset();
+  return kernel;
+}
+
+TEST(EagerContextTest, KernelCachedOnOneThreadIsFoundOnAnother) {
+  std::unique_ptr<EagerContext> context = NewContext();
+  const Fprint128 cache_key = Fingerprint128("MatMul");
+  EXPECT_EQ(nullptr, context->GetCachedKernel(cache_key));
+
+  KernelAndDevice* kernel = new KernelAndDevice(nullptr, false);
+  context->AddKernelToCache(cache_key, kernel);
+  EXPECT_EQ(kernel, context->GetCachedKernel(cache_key));
+  // The other thread's own cache is empty, so the kernel comes from the map
+  // shared by all threads.
+  EXPECT_EQ(kernel, GetCachedKernelOnNewThread(context.get(), cache_key));
+  EXPECT_EQ(nullptr, GetCachedKernelOnNewThread(context.get(),
+                                                Fingerprint128("Add")));
+}
+
+TEST(EagerContextTest, ClearCachesInvalidatesThreadCaches) {
+  std::unique_ptr<EagerContext> context = NewContext();
+  const Fprint128 cache_key = Fingerprint128("MatMul");
+  context->AddKernelToCache(cache_key, new KernelAndDevice(nullptr, false));
+  ASSERT_NE(nullptr, context->GetCachedKernel(cache_key));
+
+  // Deletes the kernel, which this thread's cache still points to.
+  context->ClearCaches();
+  EXPECT_EQ(nullptr, context->GetCachedKernel(cache_key));
+
+  KernelAndDevice* kernel = new KernelAndDevice(nullptr, false);
+  context->AddKernelToCache(cache_key, kernel);
+  EXPECT_EQ(kernel, context->GetCachedKernel(cache_key));
+  EXPECT_EQ(kernel, GetCachedKernelOnNewThread(context.get(), cache_key));
+}
+
+TEST(EagerContextTest, ThreadCachesDoNotMixContexts) {
+  std::unique_ptr<EagerContext> context = NewContext();
+  std::unique_ptr<EagerContext> other_context = NewContext();
+  const Fprint128 cache_key = Fingerprint128("MatMul");
+  KernelAndDevice* kernel = new KernelAndDevice(nullptr, false);
+  context->AddKernelToCache(cache_key, kernel);
+  ASSERT_EQ(kernel, context->GetCachedKernel(cache_key));
+  EXPECT_EQ(nullptr, other_context->GetCachedKernel(cache_key));
+  EXPECT_EQ(kernel, context->GetCachedKernel(cache_key));
+}
+
+}  // namespace
+}  // namespace tensorflow
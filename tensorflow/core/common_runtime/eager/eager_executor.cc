@@ -19,15 +19,65 @@ namespace tensorflow {
 
 EagerNode::EagerNode(tensorflow::uint64 id) : id(id) {}
 
+void EagerExecutor::NodeQueue::Push(EagerNode* node) {
+  node->next_.store(nullptr, std::memory_order_relaxed);
+  // Sequentially consistent, to order the push before the check of
+  // thread_waiting_ in Add.
+  EagerNode* prev = head_.exchange(node, std::memory_order_seq_cst);
+  // Until this store, the queue is cut in two at `prev`, and Pop stops there.
+  prev->next_.store(node, std::memory_order_release);
+}
+
+EagerNode* EagerExecutor::NodeQueue::Pop() {
+  EagerNode* tail = tail_;
+  EagerNode* next = tail->next_.load(std::memory_order_acquire);
+  if (tail == &stub_) {
+    if (next == nullptr) {
+      return nullptr;
+    }
+    tail_ = next;
+    tail = next;
+    next = next->next_.load(std::memory_order_acquire);
+  }
+  if (next != nullptr) {
+    tail_ = next;
+    return tail;
+  }
+  if (tail != head_.load(std::memory_order_acquire)) {
+    // A node is being pushed after `tail`.
+    return nullptr;
+  }
+  // `tail` is the last node: push the stub behind it to be able to remove it.
+  Push(&stub_);
+  next = tail->next_.load(std::memory_order_acquire);
+  if (next != nullptr) {
+    tail_ = next;
+    return tail;
+  }
+  return nullptr;
+}
+
+bool EagerExecutor::NodeQueue::Empty() const {
+  return tail_ == &stub_ && head_.load(std::memory_order_seq_cst) == &stub_;
+}
+
 EagerExecutor::~EagerExecutor() {
+  std::unique_ptr<Thread> thread;
+  {
+    tensorflow::mutex_lock l(node_queue_mutex_);
+    thread_done_ = true;
+    nodes_pending_.notify_all();
+    thread.swap(thread_);
+  }
+  // Joins the executor thread, after which this thread is the consumer of
+  // node_queue_.
+  thread.reset();
   tensorflow::mutex_lock l(node_queue_mutex_);
-  thread_done_ = true;
-  nodes_pending_.notify_all();
+  DiscardPendingNodes();
 }
 
 tensorflow::uint64 EagerExecutor::NextId() {
-  tensorflow::mutex_lock l(next_id_mutex_);
-  return next_id_++;
+  return next_id_.fetch_add(1, std::memory_order_relaxed);
 }
 
 void EagerExecutor::EnableAsync() {
@@ -40,28 +90,71 @@ void EagerExecutor::EnableAsync() {
 }
 
 void EagerExecutor::Add(EagerNode* node) {
-  tensorflow::mutex_lock l(node_queue_mutex_);
-  DCHECK(thread_) << "EnableAsync should have been called before Add";
-  if (!status_.ok()) {
+  if (!ok_.load(std::memory_order_acquire)) {
     delete node;
     return;
   }
-  int64 qlen = node_queue_.size();
-  if (qlen > 0) {
-    if (node_queue_.back()->id >= node->id) {
-      status_ = tensorflow::errors::InvalidArgument(
-          "Inserting EagerNode with non-increasing ids:",
-          node_queue_.back()->id, " vs ", node->id);
-      delete node;
-      return;
-    }
-    node_queue_.push(node);
-  } else {
-    node_queue_.push(node);
+  tensorflow::uint64 last_added_id =
+      last_added_id_.load(std::memory_order_relaxed);
+  bool added = false;
+  while (!added && node->id > last_added_id) {
+    added = last_added_id_.compare_exchange_weak(last_added_id, node->id);
+  }
+  if (added) {
+    // Nodes are pushed in the order in which their ids replaced each other.
+    // The executor thread may delete `node` as soon as it is pushed.
+    const tensorflow::uint64 node_id = node->id;
+    WaitForPush(last_added_id);
+    node_queue_.Push(node);
+    last_pushed_id_.store(node_id, std::memory_order_release);
+  } else if (!AddWhileIdle(node)) {
+    return;
+  }
+  // Only the first node added while the executor thread is blocked wakes it
+  // up; it then runs all the nodes added meanwhile.
+  if (thread_waiting_.exchange(false)) {
+    tensorflow::mutex_lock l(node_queue_mutex_);
     nodes_pending_.notify_all();
   }
 }
 
+bool EagerExecutor::AddWhileIdle(EagerNode* node) {
+  tensorflow::mutex_lock l(node_queue_mutex_);
+  tensorflow::uint64 last_added_id = last_added_id_.load();
+  // Ids may only go down when no node is pending, as threads may add the ids
+  // they got from NextId in a different order. Only this function lowers
+  // last_added_id_, so the exchange below only fails if a node was added
+  // meanwhile.
+  if (node->id < last_added_id && last_done_id_.load() == last_added_id) {
+    WaitForPush(last_added_id);
+    if (last_added_id_.compare_exchange_strong(last_added_id, node->id)) {
+      // The executor thread doesn't touch last_done_id_ until it runs this
+      // node, and setting it below the id keeps WaitFor from returning before
+      // the node is done. WaitImpl and NodeDone read both ids under the lock,
+      // so they see them change together.
+      const tensorflow::uint64 node_id = node->id;
+      last_done_id_.store(node_id - 1);
+      node_queue_.Push(node);
+      last_pushed_id_.store(node_id, std::memory_order_release);
+      return true;
+    }
+  }
+  SetError(tensorflow::errors::InvalidArgument(
+      "Inserting EagerNode with non-increasing ids:", last_added_id, " vs ",
+      node->id));
+  delete node;
+  return false;
+}
+
+void EagerExecutor::WaitForPush(tensorflow::uint64 node_id) {
+  // The thread adding `node_id` is between replacing the last id and
+  // pushing its node, which takes no lock and so finishes quickly unless that
+  // thread is descheduled.
+  while (last_pushed_id_.load(std::memory_order_acquire) != node_id) {
+    std::this_thread::yield();
+  }
+}
+
 tensorflow::Status EagerExecutor::WaitFor(tensorflow::uint64 node_id) {
   return WaitImpl(false, node_id);
 }
@@ -72,20 +165,29 @@ tensorflow::Status EagerExecutor::WaitForAllPendingNodes() {
 
 tensorflow::Status EagerExecutor::WaitImpl(bool wait_all,
                                            tensorflow::uint64 node_id) {
-  tensorflow::condition_variable cond;
+  Waiter waiter;
   tensorflow::mutex_lock l(node_queue_mutex_);
   // Don't wait if an error is already set.
   if (!status_.ok()) return status_;
-  if (node_queue_.empty()) return tensorflow::Status::OK();
+  const tensorflow::uint64 last_added_id = last_added_id_.load();
   if (wait_all) {
-    node_id = node_queue_.back()->id;
-  } else if (node_id < node_queue_.front()->id) {
-    // Note that we are relying on the ops being dispatched sequentially from
-    // the queue.
-    return tensorflow::Status::OK();
-  }
-  node_done_notifications_.insert(std::make_pair(node_id, &cond));
-  cond.wait(l);
+    node_id = last_added_id;
+  }
+  // Sequentially consistent, so that either NodeDone sees the waiter, or the
+  // waiter sees the node done.
+  num_waiters_.fetch_add(1);
+  // Note that we are relying on the ops being dispatched sequentially from
+  // the queue.
+  const tensorflow::uint64 last_done_id = last_done_id_.load();
+  if (last_done_id < node_id && last_done_id < last_added_id) {
+    node_done_notifications_.insert(std::make_pair(node_id, &waiter));
+    while (!waiter.done) {
+      waiter.cond.wait(l);
+    }
+  }
+  num_waiters_.fetch_sub(1);
+  // An error that woke this thread up may have been cleared since.
+  if (!waiter.status.ok()) return waiter.status;
   // Note that we could be woken up if an error occurs, even though the node has
   // not actually executed.
   return status_;
@@ -94,12 +196,11 @@ tensorflow::Status EagerExecutor::WaitImpl(bool wait_all,
 void EagerExecutor::ClearError() {
   tensorflow::mutex_lock l(node_queue_mutex_);
   if (status_.ok()) return;
-  // If an error was set, node_done_notifications_ and node_queue_ should have
-  // been cleared, and no new entries should have been added since.
+  // If an error was set, node_done_notifications_ should have been cleared,
+  // and no new entries should have been added since.
   DCHECK(node_done_notifications_.empty());
-  DCHECK(node_queue_.empty());
   status_ = tensorflow::Status::OK();
-  nodes_pending_.notify_all();
+  ok_.store(true, std::memory_order_release);
 }
 
 tensorflow::Status EagerExecutor::status() {
@@ -107,45 +208,100 @@ tensorflow::Status EagerExecutor::status() {
   return status_;
 }
 
-void EagerExecutor::Run() {
+void EagerExecutor::SetError(const tensorflow::Status& status) {
+  status_ = status;
+  ok_.store(false, std::memory_order_release);
+  // Note that we notify all waiting threads in case an error has occurred.
+  // These calling threads are responsible for checking status_ before
+  // proceeding.
+  for (auto& id_and_waiter : node_done_notifications_) {
+    id_and_waiter.second->done = true;
+    id_and_waiter.second->status = status;
+    id_and_waiter.second->cond.notify_all();
+  }
+  node_done_notifications_.clear();
+}
+
+EagerNode* EagerExecutor::NextNode() {
+  // Spinning a little before blocking saves a wakeup when nodes are added in
+  // quick succession.
+  const int kSpinIterations = 100;
+  int spins = 0;
   while (true) {
-    std::unique_ptr<EagerNode> curr_node;
-    {
-      tensorflow::mutex_lock l(node_queue_mutex_);
-      while (node_queue_.empty() || !status_.ok()) {
-        if (thread_done_) return;
-        nodes_pending_.wait(l);
-      }
-      curr_node.reset(node_queue_.front());
+    EagerNode* node = node_queue_.Pop();
+    if (node != nullptr) {
+      return node;
+    }
+    if (!node_queue_.Empty() || ++spins < kSpinIterations) {
+      std::this_thread::yield();
+      continue;
     }
-    tensorflow::Status status = curr_node->Run();
-    const bool ok = status.ok();
     tensorflow::mutex_lock l(node_queue_mutex_);
-    node_queue_.pop();
-    if (!ok) {
-      status_ = status;
-      // TODO(agarwal): mark all affected handles as corrupted before clearing
-      // this queue.
-      // We remove any pending ops so that we don't try to execute them if
-      // ClearError is called.
-      for (int i = 0; i < node_queue_.size(); ++i) {
-        delete node_queue_.front();
-        node_queue_.pop();
+    while (true) {
+      // Sequentially consistent, so that either Add sees the thread waiting,
+      // or the thread sees the node added.
+      thread_waiting_.store(true);
+      if (thread_done_) {
+        thread_waiting_.store(false);
+        return nullptr;
       }
+      if (!node_queue_.Empty()) break;
+      nodes_pending_.wait(l);
     }
-    if (!node_done_notifications_.empty()) {
-      tensorflow::uint64 node_id = curr_node->id;
-      // Note that we notify all waiting threads in case an error has occurred.
-      // These calling threads are responsible for checking status_ before
-      // proceeding.
-      const auto range = ok ? node_done_notifications_.equal_range(node_id)
-                            : make_pair(node_done_notifications_.begin(),
-                                        node_done_notifications_.end());
-      for (auto it = range.first; it != range.second; ++it) {
-        it->second->notify_all();
+    thread_waiting_.store(false);
+    spins = 0;
+  }
+}
+
+void EagerExecutor::DiscardPendingNodes() {
+  while (true) {
+    EagerNode* node = node_queue_.Pop();
+    if (node != nullptr) {
+      last_done_id_.store(node->id);
+      delete node;
+    } else if (node_queue_.Empty()) {
+      return;
+    }
+  }
+}
+
+void EagerExecutor::NodeDone(tensorflow::uint64 node_id) {
+  // Pending nodes have increasing ids, so all the nodes with lower ids are
+  // done.
+  last_done_id_.store(node_id);
+  if (num_waiters_.load() == 0) return;
+  tensorflow::mutex_lock l(node_queue_mutex_);
+  // Add may have let ids go down since. Once no node is pending, the waiters
+  // for ids above the new ones are done too.
+  const tensorflow::uint64 last_done_id = last_done_id_.load();
+  const auto end = last_done_id == last_added_id_.load()
+                       ? node_done_notifications_.end()
+                       : node_done_notifications_.upper_bound(last_done_id);
+  for (auto it = node_done_notifications_.begin(); it != end; ++it) {
+    it->second->done = true;
+    it->second->cond.notify_all();
+  }
+  node_done_notifications_.erase(node_done_notifications_.begin(), end);
+}
+
+void EagerExecutor::Run() {
+  while (true) {
+    std::unique_ptr<EagerNode> curr_node(NextNode());
+    if (curr_node == nullptr) return;
+    // Nodes are discarded while an error is set.
+    if (ok_.load(std::memory_order_acquire)) {
+      tensorflow::Status status = curr_node->Run();
+      if (!status.ok()) {
+        tensorflow::mutex_lock l(node_queue_mutex_);
+        SetError(status);
+        // TODO(agarwal): mark all affected handles as corrupted before clearing
+        // this queue.
+        // We remove any pending ops so that we don't try to execute them if
+        // ClearError is called.
+        DiscardPendingNodes();
       }
-      node_done_notifications_.erase(range.first, range.second);
     }
+    NodeDone(curr_node->id);
   }
 }
 
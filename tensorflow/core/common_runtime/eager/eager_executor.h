@@ -16,6 +16,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_COMMON_RUNTIME_EAGER_EAGER_EXECUTOR_H_
 
 #include <algorithm>
+#include <atomic>
 #include <cstddef>
 #include <map>
 #include <memory>
@@ -53,6 +54,12 @@ class EagerNode {
   // An id unique to the TFE_Context under which this node is created. Allocated
   // monotonically.
   const uint64 id;
+
+ private:
+  friend class EagerExecutor;
+
+  // The next node in the queue of pending nodes of an EagerExecutor.
+  std::atomic<EagerNode*> next_{nullptr};
 };
 
 // A class for handling async execution (see TFE_ContextSetAsync).
@@ -64,6 +71,12 @@ class EagerNode {
 // TODO(agarwal): Support out-of-order execution and dispatching multiple
 // EagerNode in parallel.
 // TODO(agarwal): Implement optimizations over EagerNode traces.
+//
+// Nodes go through a lock-free queue. Adding a node only takes a lock when its
+// id is below that of the last node added, and the executor thread is only
+// woken up (under a lock) when it has run out of nodes and is about to block.
+// Likewise, finishing a node only takes a lock when some thread is waiting for
+// nodes.
 class EagerExecutor {
  public:
   ~EagerExecutor();
@@ -77,8 +90,9 @@ class EagerExecutor {
   // object.
   uint64 NextId();
 
-  // Schedules `node` for execution.
-  // Note that Add must be called in monotonically increasing order of node->id.
+  // Schedules `node` for execution. EnableAsync must have been called.
+  // Note that Add must be called in monotonically increasing order of node->id,
+  // except when no node is pending. Otherwise, an error is set.
   void Add(EagerNode* node);
 
   // Causes the caller to block till node with id `node_id` has finished
@@ -95,30 +109,121 @@ class EagerExecutor {
   Status status();
 
  private:
+  // A queue of EagerNodes linked through EagerNode::next_, with any number of
+  // producers and a single consumer, that takes no locks (this is Vyukov's
+  // intrusive MPSC queue).
+  class NodeQueue {
+   public:
+    NodeQueue() : head_(&stub_), tail_(&stub_) {}
+
+    // Adds `node` at the back of the queue.
+    void Push(EagerNode* node);
+
+    // Removes the node at the front of the queue and returns it. Returns
+    // nullptr if the queue is empty, or if the node at the front is still
+    // being pushed. Must only be called by the consumer.
+    EagerNode* Pop();
+
+    // Whether the queue is empty. Must only be called by the consumer.
+    bool Empty() const;
+
+   private:
+    // A placeholder, in the queue whenever it would otherwise be empty.
+    class StubNode : public EagerNode {
+     public:
+      StubNode() : EagerNode(0) {}
+      Status Run() override { return Status::OK(); }
+    };
+    StubNode stub_;
+
+    // The most recently pushed node.
+    std::atomic<EagerNode*> head_;
+    // The node at the front of the queue.
+    EagerNode* tail_;
+  };
+
   // Starts execution of pending EagerNodes. This function loops till
   // thread_done_ is set to true. If any errors are encontered, these are set
-  // inside `status_`. The loop blocks anytime there are no pending nodes, or if
-  // `status_` is not ok.
+  // inside `status_`, and pending nodes are discarded until ClearError is
+  // called.
   void Run();
 
+  // Adds `node`, whose id isn't above that of the last node added, if no node
+  // is pending. Otherwise sets an error, deletes `node` and returns false.
+  bool AddWhileIdle(EagerNode* node);
+
+  // Waits until the node with id `node_id`, which was the last one added
+  // when the caller added its own, has been pushed to `node_queue_`.
+  void WaitForPush(uint64 node_id);
+
+  // Returns the next node to run, blocking if there is none. Returns nullptr
+  // once thread_done_ is set.
+  EagerNode* NextNode();
+
+  // Deletes the nodes pending execution. Must only be called by the consumer
+  // of `node_queue_`. Holding the lock keeps ClearError from letting new nodes
+  // run before the old ones are discarded.
+  void DiscardPendingNodes() EXCLUSIVE_LOCKS_REQUIRED(node_queue_mutex_);
+
+  // Records that the node with id `node_id` is done, waking up threads waiting
+  // for it.
+  void NodeDone(uint64 node_id);
+
+  // Sets `status_` to the error `status`, waking up all waiting threads.
+  void SetError(const Status& status)
+      EXCLUSIVE_LOCKS_REQUIRED(node_queue_mutex_);
+
   Status WaitImpl(bool wait_all, uint64 node_id);
 
+  // Queue of pending EagerNodes.
+  NodeQueue node_queue_;
+
+  // The ids of the last node added, and of the last node executed or
+  // discarded. Pending nodes have increasing ids between the two, and no node
+  // is pending when they are equal. last_added_id_ only goes down in
+  // AddWhileIdle, and last_done_id_ is written by the executor thread, or in
+  // AddWhileIdle when no node is pending.
+  std::atomic<uint64> last_added_id_{0};
+  std::atomic<uint64> last_done_id_{0};
+
+  // The id of the last node pushed to `node_queue_`. Each thread adding a node
+  // waits for the node whose id it replaced in last_added_id_ to be pushed
+  // first, so that nodes are queued in the order in which ids were checked.
+  std::atomic<uint64> last_pushed_id_{0};
+
+  // Whether the executor thread is about to block on `nodes_pending_`, in
+  // which case Add needs to wake it up.
+  std::atomic<bool> thread_waiting_{false};
+
+  // The number of threads waiting in WaitImpl, which NodeDone needs to wake
+  // up.
+  std::atomic<int> num_waiters_{0};
+
+  // Whether `status_` is ok, readable without locking.
+  std::atomic<bool> ok_{true};
+
   mutex node_queue_mutex_;
 
   // Used to signal that some EagerNodes are pending execution.
   condition_variable nodes_pending_ GUARDED_BY(node_queue_mutex_);
 
-  // Queue of pending EagerNodes.
-  std::queue<EagerNode*> node_queue_ GUARDED_BY(node_queue_mutex_);
-
   // `status_` is set based on any errors raised during execution of a
   // EagerNode.  It remains set until ClearError is called.
   Status status_ GUARDED_BY(node_queue_mutex_);
 
-  // Map from id of a EagerNode to condition_variables (not owned by the map).
-  // These condition_variables are notified and removed when that EagerNode is
-  // done executing, or if an error is found in execution of any EagerNode.
-  std::multimap<uint64, condition_variable*> node_done_notifications_
+  // A thread waiting in WaitImpl.
+  struct Waiter {
+    condition_variable cond;
+    // Set when the node waited for is done, or an error is found.
+    bool done = false;
+    // The error found, if any.
+    Status status;
+  };
+
+  // Map from id of a EagerNode to the threads waiting for it (not owned by the
+  // map). These are notified and removed when that EagerNode is done
+  // executing, or if an error is found in execution of any EagerNode.
+  std::multimap<uint64, Waiter*> node_done_notifications_
       GUARDED_BY(node_queue_mutex_);
 
   // Thread object that calls the `Run` method. Currently we use only one thread
@@ -129,8 +234,7 @@ class EagerExecutor {
   // current EagerNode.
   bool thread_done_ GUARDED_BY(node_queue_mutex_) = false;
 
-  mutex next_id_mutex_;
-  uint64 next_id_ GUARDED_BY(next_id_mutex_) = 1;
+  std::atomic<uint64> next_id_{1};
 };
 
 }  // namespace tensorflow
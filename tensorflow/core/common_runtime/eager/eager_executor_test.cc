@@ -0,0 +1,287 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/eager/eager_executor.h"
+
+#include <atomic>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// A node recording the order in which nodes run, and failing if asked to.
+class RecordingNode : public EagerNode {
+ public:
+  RecordingNode(uint64 id, std::vector<uint64>* run_ids, mutex* mu,
+                bool fail = false)
+      : EagerNode(id), run_ids_(run_ids), mu_(mu), fail_(fail) {}
+
+  Status Run() override {
+    mutex_lock l(*mu_);
+    run_ids_->push_back(id);
+    if (fail_) return errors::Internal("Node ", id, " failed");
+    return Status::OK();
+  }
+
+ private:
+  std::vector<uint64>* const run_ids_;
+  mutex* const mu_;
+  const bool fail_;
+};
+
+// A node recording its id once it has run, or once it is deleted without
+// running.
+class FinishingNode : public EagerNode {
+ public:
+  FinishingNode(uint64 id, std::set<uint64>* finished_ids, mutex* mu)
+      : EagerNode(id), finished_ids_(finished_ids), mu_(mu) {}
+  ~FinishingNode() override { Finish(); }
+
+  Status Run() override {
+    Finish();
+    return Status::OK();
+  }
+
+ private:
+  void Finish() {
+    mutex_lock l(*mu_);
+    finished_ids_->insert(id);
+  }
+
+  std::set<uint64>* const finished_ids_;
+  mutex* const mu_;
+};
+
+// A node counting how many nodes ran.
+class CountingNode : public EagerNode {
+ public:
+  CountingNode(uint64 id, std::atomic<int64>* count)
+      : EagerNode(id), count_(count) {}
+
+  Status Run() override {
+    count_->fetch_add(1, std::memory_order_relaxed);
+    return Status::OK();
+  }
+
+ private:
+  std::atomic<int64>* const count_;
+};
+
+TEST(EagerExecutorTest, RunsNodesInOrder) {
+  EagerExecutor executor;
+  executor.EnableAsync();
+  mutex mu;
+  std::vector<uint64> run_ids;
+  std::vector<uint64> expected_ids;
+  for (int i = 0; i < 100; ++i) {
+    const uint64 id = executor.NextId();
+    expected_ids.push_back(id);
+    executor.Add(new RecordingNode(id, &run_ids, &mu));
+  }
+  TF_EXPECT_OK(executor.WaitForAllPendingNodes());
+  mutex_lock l(mu);
+  EXPECT_EQ(expected_ids, run_ids);
+}
+
+TEST(EagerExecutorTest, WaitFor) {
+  EagerExecutor executor;
+  executor.EnableAsync();
+  mutex mu;
+  std::vector<uint64> run_ids;
+  uint64 id = 0;
+  for (int i = 0; i < 10; ++i) {
+    id = executor.NextId();
+    executor.Add(new RecordingNode(id, &run_ids, &mu));
+  }
+  TF_EXPECT_OK(executor.WaitFor(id));
+  mutex_lock l(mu);
+  EXPECT_EQ(10, run_ids.size());
+  EXPECT_EQ(id, run_ids.back());
+}
+
+TEST(EagerExecutorTest, WaitsAcrossIdleThread) {
+  EagerExecutor executor;
+  executor.EnableAsync();
+  mutex mu;
+  std::vector<uint64> run_ids;
+  // Lets the executor thread block between nodes.
+  for (int i = 0; i < 10; ++i) {
+    const uint64 id = executor.NextId();
+    executor.Add(new RecordingNode(id, &run_ids, &mu));
+    Env::Default()->SleepForMicroseconds(1000);
+    TF_EXPECT_OK(executor.WaitFor(id));
+  }
+  mutex_lock l(mu);
+  EXPECT_EQ(10, run_ids.size());
+}
+
+TEST(EagerExecutorTest, ErrorDiscardsPendingNodes) {
+  EagerExecutor executor;
+  executor.EnableAsync();
+  mutex mu;
+  std::vector<uint64> run_ids;
+  const uint64 failing_id = executor.NextId();
+  executor.Add(new RecordingNode(failing_id, &run_ids, &mu, /*fail=*/true));
+  for (int i = 0; i < 10; ++i) {
+    executor.Add(new RecordingNode(executor.NextId(), &run_ids, &mu));
+  }
+  EXPECT_TRUE(errors::IsInternal(executor.WaitForAllPendingNodes()));
+  EXPECT_TRUE(errors::IsInternal(executor.status()));
+  {
+    mutex_lock l(mu);
+    EXPECT_EQ(std::vector<uint64>({failing_id}), run_ids);
+    run_ids.clear();
+  }
+
+  // Nodes run again once the error is cleared.
+  executor.ClearError();
+  TF_EXPECT_OK(executor.status());
+  const uint64 id = executor.NextId();
+  executor.Add(new RecordingNode(id, &run_ids, &mu));
+  TF_EXPECT_OK(executor.WaitForAllPendingNodes());
+  mutex_lock l(mu);
+  EXPECT_EQ(std::vector<uint64>({id}), run_ids);
+}
+
+TEST(EagerExecutorTest, NonIncreasingIds) {
+  mutex mu;
+  std::vector<uint64> run_ids;
+  EagerExecutor executor;
+  executor.EnableAsync();
+  // Blocks the executor thread so that the nodes below are pending.
+  mu.lock();
+  executor.Add(new RecordingNode(2, &run_ids, &mu));
+  executor.Add(new RecordingNode(3, &run_ids, &mu));
+  executor.Add(new RecordingNode(3, &run_ids, &mu));
+  mu.unlock();
+  EXPECT_TRUE(errors::IsInvalidArgument(executor.WaitForAllPendingNodes()));
+}
+
+TEST(EagerExecutorTest, ManyProducers) {
+  EagerExecutor executor;
+  executor.EnableAsync();
+  constexpr int kNumThreads = 8;
+  constexpr int kNumNodesPerThread = 10000;
+  std::atomic<int64> count(0);
+  // Ids must be added in increasing order, so each thread allocates its id and
+  // adds its node under a lock, without any lock on the executor side.
+  mutex add_mu;
+  {
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int t = 0; t < kNumThreads; ++t) {
+      threads.emplace_back(Env::Default()->StartThread({}, "producer", [&]() {
+        for (int i = 0; i < kNumNodesPerThread; ++i) {
+          mutex_lock l(add_mu);
+          executor.Add(new CountingNode(executor.NextId(), &count));
+        }
+      }));
+    }
+  }
+  TF_EXPECT_OK(executor.WaitForAllPendingNodes());
+  EXPECT_EQ(kNumThreads * kNumNodesPerThread, count.load());
+}
+
+TEST(EagerExecutorTest, RacingProducers) {
+  // Ids are allocated and added without a common lock, as by several threads
+  // running eager ops, so some nodes are added after nodes with higher ids.
+  // They are rejected while those are pending, and run after them otherwise.
+  // Either way, waiting for a node must not return before it is done.
+  constexpr int kNumThreads = 4;
+  constexpr int kNumNodesPerThread = 2000;
+  // Outlive the executor, whose thread deletes the nodes.
+  mutex mu;
+  std::set<uint64> finished_ids;
+  EagerExecutor executor;
+  executor.EnableAsync();
+  {
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int t = 0; t < kNumThreads; ++t) {
+      threads.emplace_back(Env::Default()->StartThread({}, "producer", [&]() {
+        for (int i = 0; i < kNumNodesPerThread; ++i) {
+          const uint64 id = executor.NextId();
+          // Lets other threads add nodes with higher ids, and run them.
+          if (i % 2 == 0) std::this_thread::yield();
+          executor.Add(new FinishingNode(id, &finished_ids, &mu));
+          if (executor.WaitFor(id).ok()) {
+            mutex_lock l(mu);
+            EXPECT_EQ(1, finished_ids.count(id)) << id;
+          } else {
+            executor.ClearError();
+          }
+        }
+      }));
+    }
+  }
+  TF_EXPECT_OK(executor.WaitForAllPendingNodes());
+  mutex_lock l(mu);
+  EXPECT_EQ(kNumThreads * kNumNodesPerThread, finished_ids.size());
+}
+
+// Adds `iters` trivial nodes from `num_threads` threads, and waits for them.
+void BM_EagerExecutorAdd(int iters, int num_threads) {
+  testing::StopTiming();
+  EagerExecutor executor;
+  executor.EnableAsync();
+  std::atomic<int64> count(0);
+  mutex add_mu;
+  const int iters_per_thread = iters / num_threads;
+  testing::StartTiming();
+  {
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int t = 0; t < num_threads; ++t) {
+      threads.emplace_back(Env::Default()->StartThread({}, "producer", [&]() {
+        for (int i = 0; i < iters_per_thread; ++i) {
+          mutex_lock l(add_mu);
+          executor.Add(new CountingNode(executor.NextId(), &count));
+        }
+      }));
+    }
+  }
+  TF_CHECK_OK(executor.WaitForAllPendingNodes());
+  testing::StopTiming();
+  CHECK_EQ(iters_per_thread * num_threads, count.load());
+  testing::ItemsProcessed(static_cast<int64>(iters_per_thread) * num_threads);
+}
+BENCHMARK(BM_EagerExecutorAdd)->Arg(1)->Arg(2)->Arg(4);
+
+// Adds one node at a time and waits for it, as synchronous callers do.
+void BM_EagerExecutorAddAndWait(int iters) {
+  testing::StopTiming();
+  EagerExecutor executor;
+  executor.EnableAsync();
+  std::atomic<int64> count(0);
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    const uint64 id = executor.NextId();
+    executor.Add(new CountingNode(id, &count));
+    TF_CHECK_OK(executor.WaitFor(id));
+  }
+  testing::StopTiming();
+  testing::ItemsProcessed(iters);
+}
+BENCHMARK(BM_EagerExecutorAddAndWait);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,382 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_reducer.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/collective_util.h"
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+// Set true for greater intelligibility of debug mode log messages.
+#define READABLE_KEYS false
+
+namespace tensorflow {
+
+namespace {
+// The steps of the algorithm, each exchanging one set of chunks.
+enum HierarchicalReduceStep {
+  kGroupReduceScatter = 0,  // chunk i to the i-th device of the group
+  kGroupGather,             // group sums to the group leader
+  kLeaderReduceScatter,     // chunk i to the i-th leader
+  kLeaderAllGather,         // reduced chunks between leaders
+  kGroupScatter,            // chunk i of the result to the i-th device
+  kGroupAllGather,          // chunks of the result within the group
+};
+
+// Key to be used for BufRendezvous by HierarchicalReducer.
+string HierarchicalReduceBufKey(const string& exec_key, int step, int subdiv,
+                                int src_rank, int dst_rank) {
+  if (READABLE_KEYS) {
+    return strings::StrCat("hred(", exec_key, "):step(", step, "):subdiv(",
+                           subdiv, "):src(", src_rank, "):dst(", dst_rank,
+                           ")");
+  } else {
+    return strings::StrCat(exec_key, ":", step, ":", subdiv, ":", src_rank,
+                           ":", dst_rank);
+  }
+}
+}  // namespace
+
+HierarchicalReducer::HierarchicalReducer()
+    : col_ctx_(nullptr), col_params_(nullptr), group_subdiv_(-1) {}
+
+Status HierarchicalReducer::InitializeCollectiveParams(
+    CollectiveParams* col_params) {
+  CHECK_EQ(col_params->instance.type, REDUCTION_COLLECTIVE);
+  CHECK_EQ(col_params->instance.impl_details.collective_name,
+           "HierarchicalReduce");
+  if (col_params->group.device_type != "CPU") {
+    return errors::InvalidArgument(
+        "HierarchicalReduce only supports CPU devices, not ",
+        col_params->group.device_type.type_string());
+  }
+  if (col_params->instance.impl_details.compression != COMPRESSION_NONE) {
+    return errors::InvalidArgument(
+        "HierarchicalReduce does not support compression");
+  }
+  const int group_size = col_params->group.group_size;
+  const std::vector<int>& locality_groups =
+      col_params->instance.locality_groups;
+  // Number the groups densely, in order of first appearance.  Without
+  // locality information, the devices of each task form a group.
+  std::map<string, int> group_ids;
+  std::vector<int> device_groups(group_size);
+  for (int di = 0; di < group_size; ++di) {
+    const string key = locality_groups.size() == group_size
+                           ? strings::StrCat(locality_groups[di])
+                           : col_params->instance.task_names[di];
+    auto it = group_ids.insert({key, static_cast<int>(group_ids.size())});
+    device_groups[di] = it.first->second;
+  }
+  const int num_groups = static_cast<int>(group_ids.size());
+
+  std::vector<std::vector<int>>& perms =
+      col_params->instance.impl_details.subdiv_permutations;
+  perms.assign(num_groups + 1, std::vector<int>());
+  col_params->subdiv_rank.assign(num_groups + 1, -1);
+  for (int di = 0; di < group_size; ++di) {
+    std::vector<int>& perm = perms[device_groups[di] + 1];
+    const bool is_self = di == col_params->default_rank;
+    if (perm.empty()) {
+      // The first device of each group leads it.
+      if (is_self) col_params->subdiv_rank[0] = perms[0].size();
+      perms[0].push_back(di);
+    }
+    if (is_self) col_params->subdiv_rank[device_groups[di] + 1] = perm.size();
+    perm.push_back(di);
+  }
+
+  VLOG(2) << collective_util::SubdivPermDebugString(*col_params);
+  return Status::OK();
+}
+
+Status HierarchicalReducer::InitializeCollectiveContext(
+    CollectiveContext* col_ctx) {
+  CHECK(col_ctx->dev_mgr);
+  col_ctx_ = col_ctx;
+  col_params_ = &col_ctx->col_params;
+  return collective_util::InitializeDeviceAndLocality(
+      col_ctx->dev_mgr, col_ctx->device_name, &col_ctx->device,
+      &col_ctx->device_locality);
+}
+
+void HierarchicalReducer::Run(StatusCallback done) {
+  CHECK(col_ctx_);
+  CHECK(col_params_);
+  group_subdiv_ = -1;
+  for (int sdi = 1; sdi < col_params_->subdiv_rank.size(); ++sdi) {
+    if (col_params_->subdiv_rank[sdi] >= 0) group_subdiv_ = sdi;
+  }
+  CHECK_GT(group_subdiv_, 0);
+
+  Status s = CopyInputToOutput();
+  if (s.ok()) s = ReduceWithinGroup();
+  if (s.ok() && col_params_->subdiv_rank[0] >= 0) {
+    s = AllReduceAcrossLeaders();
+  }
+  if (s.ok()) s = GatherWithinGroup();
+  VLOG(2) << "device=" << col_ctx_->device_name << " return status " << s;
+  done(s);
+}
+
+Status HierarchicalReducer::CopyInputToOutput() {
+  if (col_ctx_->input == col_ctx_->output ||
+      DMAHelper::base(col_ctx_->input) == DMAHelper::base(col_ctx_->output)) {
+    return Status::OK();
+  }
+  Notification note;
+  Status status;
+  CollectiveRemoteAccessLocal::MemCpyAsync(
+      col_ctx_->op_ctx->input_device_context(0),
+      col_ctx_->op_ctx->op_device_context(), col_ctx_->device,
+      col_ctx_->device, col_ctx_->op_ctx->input_alloc_attr(0),
+      col_ctx_->op_ctx->output_alloc_attr(0), col_ctx_->input,
+      col_ctx_->output, 0 /*dev_to_dev_stream_index*/,
+      [&note, &status](const Status& s) {
+        status.Update(s);
+        note.Notify();
+      });
+  note.WaitForNotification();
+  return status;
+}
+
+Status HierarchicalReducer::ReduceWithinGroup() {
+  const int group_size =
+      col_params_->instance.impl_details.subdiv_permutations[group_subdiv_]
+          .size();
+  const int my_rank = col_params_->subdiv_rank[group_subdiv_];
+  std::unique_ptr<CollectiveAdapter> ca(MakeCollectiveAdapter(
+      col_ctx_->output, group_size,
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0))));
+
+  // Reduce-scatter: each device sums chunk my_rank of all devices.
+  std::vector<Transfer> sends;
+  std::vector<Transfer> recvs;
+  for (int r = 0; r < group_size; ++r) {
+    if (r == my_rank) continue;
+    if (ca->ChunkBytes(r) > 0) {
+      sends.push_back({group_subdiv_, r, ca->ChunkAlias(r)});
+    }
+    if (ca->ChunkBytes(my_rank) > 0) {
+      recvs.push_back({group_subdiv_, r, ca->TempChunk(my_rank)});
+    }
+  }
+  Status s = Exchange(kGroupReduceScatter, &sends, &recvs);
+  Tensor my_chunk = ca->ChunkAlias(my_rank);
+  for (int i = 0; s.ok() && i < recvs.size(); ++i) {
+    s = ComputeBinOp(col_params_->merge_op.get(), &my_chunk,
+                     &recvs[i].tensor);
+  }
+
+  // Gather the group sums at the leader.
+  sends.clear();
+  recvs.clear();
+  if (my_rank != 0 && ca->ChunkBytes(my_rank) > 0) {
+    sends.push_back({group_subdiv_, 0, my_chunk});
+  } else if (my_rank == 0) {
+    for (int r = 1; r < group_size; ++r) {
+      if (ca->ChunkBytes(r) > 0) {
+        recvs.push_back({group_subdiv_, r, ca->ChunkAlias(r)});
+      }
+    }
+  }
+  if (s.ok()) s = Exchange(kGroupGather, &sends, &recvs);
+  ca->ConsumeFinalValue(col_ctx_->output);
+  return s;
+}
+
+Status HierarchicalReducer::AllReduceAcrossLeaders() {
+  const int num_leaders =
+      col_params_->instance.impl_details.subdiv_permutations[0].size();
+  const int my_rank = col_params_->subdiv_rank[0];
+  std::unique_ptr<CollectiveAdapter> ca(MakeCollectiveAdapter(
+      col_ctx_->output, num_leaders,
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0))));
+
+  // Reduce-scatter: each leader sums chunk my_rank of all groups.
+  std::vector<Transfer> sends;
+  std::vector<Transfer> recvs;
+  for (int r = 0; r < num_leaders; ++r) {
+    if (r == my_rank) continue;
+    if (ca->ChunkBytes(r) > 0) sends.push_back({0, r, ca->ChunkAlias(r)});
+    if (ca->ChunkBytes(my_rank) > 0) {
+      recvs.push_back({0, r, ca->TempChunk(my_rank)});
+    }
+  }
+  Status s = Exchange(kLeaderReduceScatter, &sends, &recvs);
+  Tensor my_chunk = ca->ChunkAlias(my_rank);
+  for (int i = 0; s.ok() && i < recvs.size(); ++i) {
+    s = ComputeBinOp(col_params_->merge_op.get(), &my_chunk,
+                     &recvs[i].tensor);
+  }
+  if (s.ok() && col_params_->final_op && ca->ChunkBytes(my_rank) > 0) {
+    Tensor group_size_val = ca->Scalar(col_params_->group.group_size);
+    s = ComputeBinOp(col_params_->final_op.get(), &my_chunk, &group_size_val);
+  }
+
+  // All-gather the reduced chunks.
+  sends.clear();
+  recvs.clear();
+  for (int r = 0; r < num_leaders; ++r) {
+    if (r == my_rank) continue;
+    if (ca->ChunkBytes(my_rank) > 0) sends.push_back({0, r, my_chunk});
+    if (ca->ChunkBytes(r) > 0) recvs.push_back({0, r, ca->ChunkAlias(r)});
+  }
+  if (s.ok()) s = Exchange(kLeaderAllGather, &sends, &recvs);
+  ca->ConsumeFinalValue(col_ctx_->output);
+  return s;
+}
+
+Status HierarchicalReducer::GatherWithinGroup() {
+  const int group_size =
+      col_params_->instance.impl_details.subdiv_permutations[group_subdiv_]
+          .size();
+  if (group_size == 1) return Status::OK();
+  const int my_rank = col_params_->subdiv_rank[group_subdiv_];
+  std::unique_ptr<CollectiveAdapter> ca(MakeCollectiveAdapter(
+      col_ctx_->output, group_size,
+      col_ctx_->device->GetAllocator(col_ctx_->op_ctx->output_alloc_attr(0))));
+
+  // The leader scatters the chunks of the result, so that it sends the
+  // tensor about twice rather than once per device.
+  std::vector<Transfer> sends;
+  std::vector<Transfer> recvs;
+  if (my_rank == 0) {
+    for (int r = 1; r < group_size; ++r) {
+      if (ca->ChunkBytes(r) > 0) {
+        sends.push_back({group_subdiv_, r, ca->ChunkAlias(r)});
+      }
+    }
+  } else if (ca->ChunkBytes(my_rank) > 0) {
+    recvs.push_back({group_subdiv_, 0, ca->ChunkAlias(my_rank)});
+  }
+  Status s = Exchange(kGroupScatter, &sends, &recvs);
+
+  // All-gather: every device sends its chunk to the devices other than the
+  // leader.
+  sends.clear();
+  recvs.clear();
+  for (int r = 1; r < group_size; ++r) {
+    if (r == my_rank) continue;
+    if (ca->ChunkBytes(my_rank) > 0) {
+      sends.push_back({group_subdiv_, r, ca->ChunkAlias(my_rank)});
+    }
+  }
+  if (my_rank != 0) {
+    for (int r = 0; r < group_size; ++r) {
+      if (r == my_rank) continue;
+      if (ca->ChunkBytes(r) > 0) {
+        recvs.push_back({group_subdiv_, r, ca->ChunkAlias(r)});
+      }
+    }
+  }
+  if (s.ok()) s = Exchange(kGroupAllGather, &sends, &recvs);
+  ca->ConsumeFinalValue(col_ctx_->output);
+  return s;
+}
+
+Status HierarchicalReducer::Exchange(int step, std::vector<Transfer>* sends,
+                                     std::vector<Transfer>* recvs) {
+  mutex mu;
+  Status status;
+  BlockingCounter pending(sends->size() + recvs->size());
+  auto done = [&mu, &status, &pending](const Status& s) {
+    {
+      mutex_lock l(mu);
+      status.Update(s);
+    }
+    pending.DecrementCount();
+  };
+  const auto& perms = col_params_->instance.impl_details.subdiv_permutations;
+  for (Transfer& send : *sends) {
+    const int my_rank = col_params_->subdiv_rank[send.subdiv];
+    const int dst_idx = perms[send.subdiv][send.peer_rank];
+    const string send_buf_key = HierarchicalReduceBufKey(
+        col_ctx_->exec_key, step, send.subdiv, my_rank, send.peer_rank);
+    VLOG(3) << "DispatchSend " << send_buf_key << " from_device "
+            << col_ctx_->device_name << " to_device "
+            << col_params_->instance.device_names[dst_idx];
+    col_ctx_->col_exec->PostToPeer(
+        col_params_->instance.device_names[dst_idx],
+        col_params_->instance.task_names[dst_idx], send_buf_key,
+        col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->output_alloc_attr(0), &send.tensor,
+        col_ctx_->device_locality, done);
+  }
+  for (Transfer& recv : *recvs) {
+    const int my_rank = col_params_->subdiv_rank[recv.subdiv];
+    const int src_idx = perms[recv.subdiv][recv.peer_rank];
+    const string recv_buf_key = HierarchicalReduceBufKey(
+        col_ctx_->exec_key, step, recv.subdiv, recv.peer_rank, my_rank);
+    VLOG(3) << "DispatchRecv " << recv_buf_key << " from_device "
+            << col_params_->instance.device_names[src_idx] << " to_device "
+            << col_ctx_->device_name;
+    col_ctx_->col_exec->RecvFromPeer(
+        col_params_->instance.device_names[src_idx],
+        col_params_->instance.task_names[src_idx],
+        col_params_->task.is_local[src_idx], recv_buf_key, col_ctx_->device,
+        col_ctx_->op_ctx->op_device_context(),
+        col_ctx_->op_ctx->output_alloc_attr(0), &recv.tensor,
+        col_ctx_->device_locality, 0 /*stream_index*/, done);
+  }
+  pending.Wait();
+  if (!status.ok()) {
+    // Cancels the transfers the other devices are waiting for.
+    col_ctx_->col_exec->StartAbort(status);
+  }
+  return status;
+}
+
+Status HierarchicalReducer::ComputeBinOp(OpKernel* op, Tensor* output,
+                                         Tensor* input) {
+  // Like RingReducer, run `op` with an OpKernelContext identical to that of
+  // the collective except for its inputs, forwarding the first to the output.
+  OpKernelContext* ctx = col_ctx_->op_ctx;
+  OpKernelContext::Params sub_params(*col_ctx_->op_params);
+  gtl::InlinedVector<TensorValue, 4> sub_inputs({output, input});
+  gtl::InlinedVector<AllocatorAttributes, 4> sub_input_attr(
+      {ctx->input_alloc_attr(0), ctx->input_alloc_attr(0)});
+  gtl::InlinedVector<DeviceContext*, 4> sub_input_dc(
+      {ctx->input_device_context(0), ctx->input_device_context(0)});
+  int forward_from = 0;
+  sub_params.op_kernel = op;
+  sub_params.inputs = &sub_inputs;
+  sub_params.input_alloc_attrs = &sub_input_attr;
+  sub_params.input_device_contexts = &sub_input_dc;
+  sub_params.eigen_gpu_device = nullptr;
+  sub_params.ensure_eigen_gpu_device();
+  sub_params.forward_from_array = &forward_from;
+  OpKernelContext sub_ctx(&sub_params, 1);
+  col_ctx_->device->Compute(op, &sub_ctx);
+  return sub_ctx.status();
+}
+
+REGISTER_COLLECTIVE(HierarchicalReduce, HierarchicalReducer);
+
+}  // namespace tensorflow
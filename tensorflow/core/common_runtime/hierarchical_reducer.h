@@ -0,0 +1,87 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
+
+#include <vector>
+
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/framework/collective.h"
+
+namespace tensorflow {
+
+// Two-level implementation of collective all-reduce, for CPU devices spread
+// over several hosts or NUMA nodes.  The devices are partitioned into
+// locality groups (devices of one task on one NUMA node), and the tensor is
+// reduced in three phases:
+//  1. Within each group, a reduce-scatter leaves the group sum of chunk i at
+//     the i-th device of the group, and the chunks are gathered at the
+//     first device of the group, its leader.
+//  2. The leaders all-reduce the group sums between themselves.
+//  3. Within each group, the leader scatters the chunks of the result, and
+//     the devices all-gather them.
+// Only the leaders exchange data across groups, once per group.
+class HierarchicalReducer : public CollectiveImplementationInterface {
+ public:
+  HierarchicalReducer();
+  ~HierarchicalReducer() override = default;
+
+  // Establishes the subdiv permutations of the locality groups.  Subdiv 0
+  // comprises the leader of each group, and subdiv i+1 the devices of group
+  // i.  The groups are those of CollInstanceParams::locality_groups, or the
+  // tasks if those are unknown.  A device not in a subdiv has rank -1 there.
+  Status InitializeCollectiveParams(CollectiveParams* col_params) override;
+
+  // Initializes members of CollectiveContext not yet initialized, i.e. device
+  // and device_locality.  Also saves the CollectiveContext in this object.
+  Status InitializeCollectiveContext(CollectiveContext* col_ctx) override;
+
+  // Executes the hierarchical reduction.
+  // Must be called in a blockable thread.
+  void Run(StatusCallback done) override;
+
+ private:
+  // A transfer of `tensor` to or from the device at `peer_rank` in `subdiv`.
+  struct Transfer {
+    int subdiv;
+    int peer_rank;
+    Tensor tensor;
+  };
+
+  // Dispatches the sends and receives of algorithm step `step`, and waits for
+  // all of them to complete.
+  Status Exchange(int step, std::vector<Transfer>* sends,
+                  std::vector<Transfer>* recvs);
+
+  // Computes `op` on `output` and `input`, in place on `output`.
+  Status ComputeBinOp(OpKernel* op, Tensor* output, Tensor* input);
+
+  // Phases 1 and 3 of the algorithm, within the locality group of this
+  // device.
+  Status ReduceWithinGroup();
+  Status GatherWithinGroup();
+
+  // Phase 2 of the algorithm, for group leaders.
+  Status AllReduceAcrossLeaders();
+
+  Status CopyInputToOutput();
+
+  CollectiveContext* col_ctx_;          // Not owned
+  const CollectiveParams* col_params_;  // Not owned
+  int group_subdiv_;                    // Subdiv of this device's group
+};
+
+}  // namespace tensorflow
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_HIERARCHICAL_REDUCER_H_
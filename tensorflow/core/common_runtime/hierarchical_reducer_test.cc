@@ -0,0 +1,273 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/common_runtime/hierarchical_reducer.h"
+
+#include <atomic>
+#include "tensorflow/core/common_runtime/base_collective_executor.h"
+#include "tensorflow/core/common_runtime/collective_rma_local.h"
+#include "tensorflow/core/common_runtime/device_mgr.h"
+#include "tensorflow/core/common_runtime/device_resolver_local.h"
+#include "tensorflow/core/common_runtime/process_util.h"
+#include "tensorflow/core/common_runtime/test_collective_executor_mgr.h"
+#include "tensorflow/core/common_runtime/threadpool_device.h"
+#include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+namespace {
+
+static int64 kStepId = 123;
+
+std::unique_ptr<OpKernel> GetKernel(const NodeDef& node, DeviceBase* device) {
+  Status status;
+  std::unique_ptr<OpKernel> k = CreateOpKernel(
+      DEVICE_CPU, device, device->GetAllocator(AllocatorAttributes()), node,
+      TF_GRAPH_DEF_VERSION, &status);
+  TF_CHECK_OK(status);
+  return k;
+}
+
+std::unique_ptr<OpKernel> GetBinOp(const string& op, DeviceBase* device) {
+  NodeDef node_def;
+  TF_CHECK_OK(NodeDefBuilder(strings::StrCat(op, "_node"), op)
+                  .Attr("T", DT_FLOAT)
+                  .Input(FakeInput(DT_FLOAT))
+                  .Input(FakeInput(DT_FLOAT))
+                  .Finalize(&node_def));
+  return GetKernel(node_def, device);
+}
+
+CollectiveParams SetUpCollectiveParams(int num_tasks, int num_devs_per_task) {
+  CollectiveParams cp;
+  cp.name = "test_collective";
+  cp.group.group_key = 5;
+  cp.group.group_size = num_tasks * num_devs_per_task;
+  cp.group.device_type = DEVICE_CPU;
+  cp.group.num_tasks = num_tasks;
+  cp.instance.instance_key = 17;
+  cp.instance.type = REDUCTION_COLLECTIVE;
+  cp.instance.data_type = DT_FLOAT;
+  cp.instance.impl_details.collective_name = "HierarchicalReduce";
+  cp.instance.impl_details.hierarchical = true;
+  for (int ti = 0; ti < num_tasks; ++ti) {
+    const string task_name =
+        strings::StrCat("/job:worker/replica:0/task:", ti);
+    for (int di = 0; di < num_devs_per_task; ++di) {
+      cp.instance.task_names.push_back(task_name);
+      cp.instance.device_names.push_back(
+          strings::StrCat(task_name, "/device:CPU:", di));
+      // This test runs in a single process.
+      cp.task.is_local.push_back(true);
+    }
+  }
+  return cp;
+}
+
+class HierarchicalReducerTest : public ::testing::Test {
+ protected:
+  ~HierarchicalReducerTest() override {
+    if (col_exec_) col_exec_->Unref();
+  }
+
+  void RunSubdivPermsTest(
+      CollectiveParams* cp,
+      const std::vector<std::vector<int>>& expected_subdiv_perms,
+      const std::vector<int>& expected_subdiv_rank) {
+    HierarchicalReducer reducer;
+    TF_CHECK_OK(reducer.InitializeCollectiveParams(cp));
+    EXPECT_EQ(expected_subdiv_perms,
+              cp->instance.impl_details.subdiv_permutations);
+    EXPECT_EQ(expected_subdiv_rank, cp->subdiv_rank);
+  }
+
+  // Reduces, with merge_op Add and final_op Div, a tensor of `tensor_len`
+  // values on each of the devices of `num_tasks` tasks with
+  // `num_devs_per_task` devices each, in `locality_groups`.
+  void RunTest(int num_tasks, int num_devs_per_task,
+               const std::vector<int>& locality_groups, int tensor_len) {
+    col_params_ = SetUpCollectiveParams(num_tasks, num_devs_per_task);
+    col_params_.instance.locality_groups = locality_groups;
+    col_params_.instance.shape = TensorShape({tensor_len});
+    std::vector<Device*> devices;
+    SessionOptions sess_opts;
+    sess_opts.env = Env::Default();
+    for (const string& dev_name : col_params_.instance.device_names) {
+      devices.push_back(new ThreadPoolDevice(sess_opts, dev_name,
+                                             Bytes(4 << 20), DeviceLocality(),
+                                             cpu_allocator()));
+    }
+    dev_mgr_.reset(new DeviceMgr(devices));
+    dev_resolver_.reset(new DeviceResolverLocal(dev_mgr_.get()));
+    col_exec_ = new BaseCollectiveExecutor(
+        &col_exec_mgr_,
+        new CollectiveRemoteAccessLocal(dev_mgr_.get(), dev_resolver_.get(),
+                                        kStepId),
+        kStepId, dev_mgr_.get());
+
+    const int group_size = col_params_.group.group_size;
+    std::vector<float> expected(tensor_len, 0);
+    std::vector<Tensor> tensors;
+    for (int rank = 0; rank < group_size; ++rank) {
+      Tensor t(DT_FLOAT, TensorShape({tensor_len}));
+      for (int i = 0; i < tensor_len; ++i) {
+        t.flat<float>()(i) = (rank + 1) * i;
+        expected[i] += (rank + 1) * i;
+      }
+      tensors.push_back(t);
+    }
+    for (int i = 0; i < tensor_len; ++i) expected[i] /= group_size;
+
+    std::vector<Status> statuses(group_size);
+    std::atomic<int> done(0);
+    for (int rank = 0; rank < group_size; ++rank) {
+      SchedClosure([this, rank, &tensors, &statuses, &done] {
+        statuses[rank] = DoReduce(rank, &tensors[rank]);
+        ++done;
+      });
+    }
+    while (done < group_size) {
+      Env::Default()->SleepForMicroseconds(1000);
+    }
+    for (int rank = 0; rank < group_size; ++rank) {
+      TF_EXPECT_OK(statuses[rank]);
+      for (int i = 0; i < tensor_len; ++i) {
+        EXPECT_FLOAT_EQ(expected[i], tensors[rank].flat<float>()(i))
+            << "Mismatch at device " << rank << " index " << i;
+      }
+    }
+  }
+
+  // Runs the reduction of `tensor`, in place, on the device at `rank`.
+  Status DoReduce(int rank, Tensor* tensor) {
+    Device* device = nullptr;
+    TF_CHECK_OK(dev_mgr_->LookupDevice(col_params_.instance.device_names[rank],
+                                       &device));
+    CollectiveParams col_params;
+    col_params.name = col_params_.name;
+    col_params.group = col_params_.group;
+    col_params.instance = col_params_.instance;
+    col_params.instance.impl_details.collective_name = "HierarchicalReduce";
+    col_params.task = col_params_.task;
+    col_params.default_rank = rank;
+    col_params.merge_op = GetBinOp("Add", device);
+    col_params.final_op = GetBinOp("Div", device);
+    HierarchicalReducer reducer;
+    TF_RETURN_IF_ERROR(reducer.InitializeCollectiveParams(&col_params));
+
+    NodeDef node_def;
+    TF_CHECK_OK(
+        NodeDefBuilder(strings::StrCat("collective_reduce_", rank),
+                       "CollectiveReduce")
+            .Attr("T", DT_FLOAT)
+            .Attr("merge_op", "Add")
+            .Attr("final_op", "Div")
+            .Attr("group_size", col_params.group.group_size)
+            .Attr("group_key", col_params.group.group_key)
+            .Attr("instance_key", col_params.instance.instance_key)
+            .Attr("subdiv_offsets", std::vector<int>())
+            .Attr("hierarchical", true)
+            .Input(FakeInput(DT_FLOAT))
+            .Finalize(&node_def));
+    std::unique_ptr<OpKernel> op = GetKernel(node_def, device);
+
+    OpKernelContext::Params op_params;
+    op_params.step_id = kStepId;
+    op_params.device = device;
+    gtl::InlinedVector<TensorValue, 4> inputs;
+    inputs.push_back(TensorValue(tensor));
+    op_params.inputs = &inputs;
+    gtl::InlinedVector<AllocatorAttributes, 4> input_aa(
+        {AllocatorAttributes()});
+    op_params.input_alloc_attrs = &input_aa;
+    DeviceContext* dev_ctx = new DeviceContext;
+    gtl::InlinedVector<DeviceContext*, 4> input_dc({dev_ctx});
+    op_params.input_device_contexts = &input_dc;
+    op_params.op_device_context = dev_ctx;
+    AllocatorAttributes generic_alloc_attr;
+    op_params.output_attr_array = &generic_alloc_attr;
+    op_params.op_kernel = op.get();
+    OpKernelContext ctx(&op_params, 1);
+
+    string exec_key = strings::StrCat(col_params.instance.instance_key, ":0:0");
+    CollectiveContext col_ctx(col_exec_, dev_mgr_.get(), &ctx, &op_params,
+                              col_params, exec_key, kStepId, tensor, tensor);
+    TF_CHECK_OK(reducer.InitializeCollectiveContext(&col_ctx));
+    Status status;
+    reducer.Run([&status](const Status& s) { status = s; });
+    dev_ctx->Unref();
+    return status;
+  }
+
+  TestCollectiveExecutorMgr col_exec_mgr_;
+  CollectiveExecutor* col_exec_ = nullptr;
+  std::unique_ptr<DeviceResolverLocal> dev_resolver_;
+  std::unique_ptr<DeviceMgr> dev_mgr_;
+  CollectiveParams col_params_;
+};
+
+TEST_F(HierarchicalReducerTest, InitializeParams) {
+  CollectiveParams cp = SetUpCollectiveParams(2, 4);
+  // Two NUMA nodes per task.
+  cp.instance.locality_groups = {0, 0, 1, 1, 2, 2, 3, 3};
+  cp.default_rank = 2;
+  RunSubdivPermsTest(&cp, {{0, 2, 4, 6}, {0, 1}, {2, 3}, {4, 5}, {6, 7}},
+                     {1, -1, 0, -1, -1});
+  cp.default_rank = 7;
+  RunSubdivPermsTest(&cp, {{0, 2, 4, 6}, {0, 1}, {2, 3}, {4, 5}, {6, 7}},
+                     {-1, -1, -1, -1, 1});
+
+  // Without localities, the tasks form the groups.
+  cp.instance.locality_groups.clear();
+  cp.default_rank = 5;
+  RunSubdivPermsTest(&cp, {{0, 4}, {0, 1, 2, 3}, {4, 5, 6, 7}}, {-1, -1, 1});
+}
+
+TEST_F(HierarchicalReducerTest, RequiresCPU) {
+  CollectiveParams cp = SetUpCollectiveParams(1, 2);
+  cp.group.device_type = DEVICE_GPU;
+  cp.default_rank = 0;
+  HierarchicalReducer reducer;
+  EXPECT_TRUE(
+      errors::IsInvalidArgument(reducer.InitializeCollectiveParams(&cp)));
+}
+
+TEST_F(HierarchicalReducerTest, OneGroup) { RunTest(1, 3, {}, 1001); }
+
+TEST_F(HierarchicalReducerTest, GroupPerTask) { RunTest(2, 3, {}, 1001); }
+
+TEST_F(HierarchicalReducerTest, GroupPerNumaNode) {
+  RunTest(2, 4, {0, 0, 1, 1, 2, 2, 3, 3}, 4096);
+}
+
+TEST_F(HierarchicalReducerTest, SingleDeviceGroups) {
+  RunTest(3, 1, {}, 100);
+}
+
+TEST_F(HierarchicalReducerTest, UnevenGroups) {
+  RunTest(1, 5, {0, 0, 0, 1, 1}, 1001);
+}
+
+TEST_F(HierarchicalReducerTest, ShortTensor) { RunTest(2, 4, {}, 2); }
+
+}  // namespace
+}  // namespace tensorflow
@@ -15,8 +15,12 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/ring_reducer.h"
 
 #include <stdlib.h>
+#include <algorithm>
 #include <atomic>
+#include <cmath>
+#include <cstring>
 #include <functional>
+#include <numeric>
 #include <utility>
 
 #include "tensorflow/core/common_runtime/collective_rma_local.h"
@@ -27,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/bfloat16.h"
 #include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -69,8 +74,68 @@ string RingReduceBufKey(const string& exec_key, int pass, int section,
   }
 }
 
+// The number of values a chunk of `num_elements` values keeps under top-k
+// compression.
+int64 TopKCount(int64 num_elements, float fraction) {
+  const int64 k = static_cast<int64>(std::ceil(fraction * num_elements));
+  return std::min(num_elements, std::max<int64>(1, k));
+}
+
+// Writes to `message` the indices of the `k` values of `values` of largest
+// magnitude, in increasing order, followed by the bits of those values, and
+// leaves the other values in `residual`.
+void TopKCompress(const float* values, int64 num_elements, int64 k,
+                  int32* message, float* residual) {
+  std::vector<int32> indices(num_elements);
+  std::iota(indices.begin(), indices.end(), 0);
+  if (k < num_elements) {
+    std::nth_element(indices.begin(), indices.begin() + k, indices.end(),
+                     [values](int32 a, int32 b) {
+                       return std::abs(values[a]) > std::abs(values[b]);
+                     });
+  }
+  std::sort(indices.begin(), indices.begin() + k);
+  std::memcpy(residual, values, num_elements * sizeof(float));
+  for (int64 i = 0; i < k; ++i) {
+    const int32 index = indices[i];
+    message[i] = index;
+    std::memcpy(&message[k + i], &values[index], sizeof(float));
+    residual[index] = 0;
+  }
+}
+
+// Adds the values of a message written by TopKCompress to the zeroed
+// `values`.
+void TopKDecompress(const int32* message, int64 k, float* values) {
+  for (int64 i = 0; i < k; ++i) {
+    float value;
+    std::memcpy(&value, &message[k + i], sizeof(float));
+    values[message[i]] = value;
+  }
+}
+
 }  // namespace
 
+Status RingReduceResiduals::LookupOrCreate(Device* device, int32 instance_key,
+                                           RingReduceResiduals** residuals) {
+  return device->resource_manager()->LookupOrCreate<RingReduceResiduals>(
+      CollectiveInstanceContainer(instance_key), "ring_reduce_residuals",
+      residuals, [](RingReduceResiduals** r) {
+        *r = new RingReduceResiduals;
+        return Status::OK();
+      });
+}
+
+Tensor* RingReduceResiduals::Get(int field_idx, const Tensor& chunk) {
+  if (residuals.size() <= field_idx) residuals.resize(field_idx + 1);
+  Tensor* residual = &residuals[field_idx];
+  if (!residual->IsInitialized() || residual->shape() != chunk.shape()) {
+    *residual = Tensor(DT_FLOAT, chunk.shape());
+    residual->flat<float>().setZero();
+  }
+  return residual;
+}
+
 void RingReducer::PCQueue::Enqueue(RingField* rf) {
   mutex_lock l(pcq_mu_);
   deque_.push_back(rf);
@@ -98,7 +163,9 @@ RingReducer::RingReducer()
       col_params_(nullptr),
       done_(nullptr),
       group_size_(-1),
-      num_subdivs_(-1) {}
+      num_subdivs_(-1),
+      compression_(COMPRESSION_NONE),
+      residuals_(nullptr) {}
 
 RingReducer::~RingReducer() { group_size_tensor_ready_.WaitForNotification(); }
 
@@ -132,6 +199,10 @@ Status GenerateSubdivsInCollectiveParams(CollectiveParams* col_params) {
     return errors::Internal("Unexpected num_subdivs ", num_subdivs,
                             " in RingReducer");
   }
+  // Bidirectional rings pair each subdivision with one running the other way.
+  if (col_params->instance.impl_details.bidirectional && num_subdivs % 2 == 1) {
+    ++num_subdivs;
+  }
 
   int subdiv_stride = kAvgDevPerTask / num_subdivs;
   if (subdiv_stride == 0) subdiv_stride = 1;
@@ -188,8 +259,40 @@ Status RingReducer::InitializeCollectiveParams(CollectiveParams* col_params) {
   dev_per_task.push_back(dev_count);
   CHECK_EQ(col_params->group.num_tasks, dev_per_task.size());
 
+  const CollImplDetails& impl_details = col_params->instance.impl_details;
+  if (impl_details.compression != COMPRESSION_NONE) {
+    if (col_params->instance.data_type != DT_FLOAT ||
+        col_params->group.device_type != "CPU") {
+      return errors::InvalidArgument(
+          "RingReduce compression is only supported for float tensors on CPU "
+          "devices, not ",
+          DataTypeString(col_params->instance.data_type), " on ",
+          col_params->group.device_type.type_string());
+    }
+    if (impl_details.compression == COMPRESSION_TOPK &&
+        (impl_details.topk_fraction <= 0 || impl_details.topk_fraction > 1)) {
+      return errors::InvalidArgument("RingReduce topk_fraction must be in "
+                                     "(0, 1], not ",
+                                     impl_details.topk_fraction);
+    }
+  }
+
   if (col_params->instance.impl_details.subdiv_offsets.empty()) {
     TF_RETURN_IF_ERROR(GenerateSubdivsInCollectiveParams(col_params));
+  } else if (impl_details.bidirectional &&
+             impl_details.subdiv_offsets.size() % 2 == 1) {
+    // Bidirectional rings need subdivisions in pairs, so an odd number of
+    // given offsets is mirrored: each one gets a second subdivision, which
+    // starts at the same offset and runs the other way.
+    std::vector<int>& subdiv_offsets =
+        col_params->instance.impl_details.subdiv_offsets;
+    std::vector<int> mirrored_offsets;
+    mirrored_offsets.reserve(2 * subdiv_offsets.size());
+    for (int subdiv_offset : subdiv_offsets) {
+      mirrored_offsets.push_back(subdiv_offset);
+      mirrored_offsets.push_back(subdiv_offset);
+    }
+    subdiv_offsets.swap(mirrored_offsets);
   }
 
   // Generate a ring permutation for requested offset.
@@ -232,6 +335,15 @@ Status RingReducer::InitializeCollectiveParams(CollectiveParams* col_params) {
       prior_dev_count += dev_per_task[ti];
     }
     CHECK_EQ(col_params->group.group_size, perm.size());
+    if (impl_details.bidirectional && sdi % 2 == 1) {
+      // Odd subdivisions run their ring in the opposite direction, so that
+      // both directions of each link carry data.
+      std::reverse(perm.begin(), perm.end());
+      if (col_params->subdiv_rank[sdi] >= 0) {
+        col_params->subdiv_rank[sdi] =
+            col_params->group.group_size - 1 - col_params->subdiv_rank[sdi];
+      }
+    }
   }
 
   VLOG(2) << collective_util::SubdivPermDebugString(*col_params);
@@ -255,6 +367,7 @@ void RingReducer::Run(StatusCallback done) {
   num_subdivs_ = static_cast<int>(
       col_params_->instance.impl_details.subdiv_permutations.size());
   CHECK_GT(num_subdivs_, 0);
+  compression_ = col_params_->instance.impl_details.compression;
 
   if (VLOG_IS_ON(1)) {
     string buf;
@@ -391,6 +504,10 @@ void RingReducer::Finish(bool ok) {
     s = status_;
   }
   rfv_.clear();  // Give up Refs on output tensor.
+  if (residuals_ != nullptr) {
+    residuals_->Unref();
+    residuals_ = nullptr;
+  }
   done_(s);
 }
 
@@ -469,6 +586,24 @@ void RingReducer::InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
     rf->tmp_chunk = ca_->TempChunk(rf->sc_idx);
     CHECK(rf->tmp_chunk.IsAligned()) << rf->DebugString();
   }
+  // The second pass may send or receive even if the first does not.
+  if (compression_ != COMPRESSION_NONE && ca_->ChunkBytes(rf->sc_idx) > 0) {
+    TensorShape buf_shape = rf->chunk.shape();
+    DataType buf_type = DT_HALF;
+    if (compression_ == COMPRESSION_BF16) {
+      buf_type = DT_BFLOAT16;
+    } else if (compression_ == COMPRESSION_TOPK) {
+      // Values and their indices, as int32.
+      buf_type = DT_INT32;
+      buf_shape = TensorShape({2 * TopKCount(rf->chunk.NumElements(),
+                                              col_params_->instance.impl_details
+                                                  .topk_fraction)});
+    }
+    Allocator* allocator = col_ctx_->device->GetAllocator(
+        col_ctx_->op_ctx->output_alloc_attr(0));
+    rf->send_buf = Tensor(allocator, buf_type, buf_shape);
+    rf->recv_buf = Tensor(allocator, buf_type, buf_shape);
+  }
   VLOG(2) << this << " InitRingField " << rf->DebugString() << " chunk "
           << ca_->TBounds(rf->chunk);
 }
@@ -503,6 +638,72 @@ string RingReducer::RingField::DebugString() const {
   return rv;
 }
 
+bool RingReducer::CompressedTransfer(const RingField& rf) const {
+  return compression_ != COMPRESSION_NONE &&
+         !(compression_ == COMPRESSION_TOPK && rf.second_pass);
+}
+
+void RingReducer::CompressChunk(RingField* rf) {
+  const Eigen::ThreadPoolDevice& d = *col_ctx_->device->eigen_cpu_device();
+  switch (compression_) {
+    case COMPRESSION_FP16: {
+      // Values beyond the range of half saturate, rather than overflowing to
+      // infinity, which the reduction could not recover from.
+      const float max_half = static_cast<float>(
+          Eigen::NumTraits<Eigen::half>::highest());
+      rf->send_buf.flat<Eigen::half>().device(d) =
+          rf->chunk.flat<float>()
+              .cwiseMax(-max_half)
+              .cwiseMin(max_half)
+              .cast<Eigen::half>();
+      break;
+    }
+    case COMPRESSION_BF16:
+      rf->send_buf.flat<bfloat16>().device(d) =
+          rf->chunk.flat<float>().cast<bfloat16>();
+      break;
+    case COMPRESSION_TOPK: {
+      // Error feedback: what was left out of the last message for this field
+      // is sent along with the new values.
+      mutex_lock l(residuals_->mu);
+      Tensor* residual = residuals_->Get(rf->sc_idx, rf->chunk);
+      rf->chunk.flat<float>().device(d) += residual->flat<float>();
+      TopKCompress(rf->chunk.flat<float>().data(), rf->chunk.NumElements(),
+                   rf->send_buf.NumElements() / 2,
+                   rf->send_buf.flat<int32>().data(),
+                   residual->flat<float>().data());
+      break;
+    }
+    case COMPRESSION_NONE:
+      LOG(FATAL) << "Unexpected uncompressed transfer";
+  }
+}
+
+void RingReducer::DecompressChunk(const Tensor& src, Tensor* dst) {
+  const Eigen::ThreadPoolDevice& d = *col_ctx_->device->eigen_cpu_device();
+  switch (compression_) {
+    case COMPRESSION_FP16:
+      dst->flat<float>().device(d) = src.flat<Eigen::half>().cast<float>();
+      break;
+    case COMPRESSION_BF16:
+      dst->flat<float>().device(d) = src.flat<bfloat16>().cast<float>();
+      break;
+    case COMPRESSION_TOPK:
+      dst->flat<float>().setZero();
+      TopKDecompress(src.flat<int32>().data(), src.NumElements() / 2,
+                     dst->flat<float>().data());
+      break;
+    case COMPRESSION_NONE:
+      LOG(FATAL) << "Unexpected uncompressed transfer";
+  }
+}
+
+Status RingReducer::ReduceRecvdChunk(RingField* rf) {
+  if (CompressedTransfer(*rf)) DecompressChunk(rf->recv_buf, &rf->tmp_chunk);
+  return ComputeBinOp(col_ctx_->device, col_params_->merge_op.get(),
+                      &rf->chunk, &rf->tmp_chunk);
+}
+
 void RingReducer::DispatchSend(RingField* rf, const StatusCallback& done) {
   CHECK(rf->do_send);
   string send_buf_key = RingReduceBufKey(col_ctx_->exec_key, rf->second_pass,
@@ -517,7 +718,8 @@ void RingReducer::DispatchSend(RingField* rf, const StatusCallback& done) {
       col_params_->instance.device_names[send_to_dev_idx],
       col_params_->instance.task_names[send_to_dev_idx], send_buf_key,
       col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
-      col_ctx_->op_ctx->output_alloc_attr(0), &rf->chunk,
+      col_ctx_->op_ctx->output_alloc_attr(0),
+      CompressedTransfer(*rf) ? &rf->send_buf : &rf->chunk,
       col_ctx_->device_locality, done);
 }
 
@@ -532,6 +734,7 @@ void RingReducer::DispatchRecv(RingField* rf, const StatusCallback& done) {
   Tensor* dst_tensor = (!rf->second_pass && (col_params_->merge_op != nullptr))
                            ? &rf->tmp_chunk
                            : &rf->chunk;
+  if (CompressedTransfer(*rf)) dst_tensor = &rf->recv_buf;
   col_ctx_->col_exec->RecvFromPeer(
       col_params_->instance.device_names[rf->recv_dev_idx],
       col_params_->instance.task_names[rf->recv_dev_idx],
@@ -589,9 +792,26 @@ bool RingReducer::RunAsyncParts() {
     }
   }
 
+  if (compression_ == COMPRESSION_TOPK) {
+    Status s = RingReduceResiduals::LookupOrCreate(
+        col_ctx_->device, col_params_->instance.instance_key, &residuals_);
+    if (!s.ok()) {
+      mutex_lock l(status_mu_);
+      status_ = s;
+      return false;
+    }
+  }
+  // On CPU devices reductions run on the device's worker threads, so that
+  // this thread keeps dispatching the transfers of other fields meanwhile.
+  thread::ThreadPool* reduce_pool =
+      col_params_->group.device_type == "CPU"
+          ? col_ctx_->device->tensorflow_cpu_worker_threads()->workers
+          : nullptr;
+
   int field_done_count = 0;
   int send_pending_count = 0;
   int recv_pending_count = 0;
+  int reduce_pending_count = 0;
   std::atomic<bool> aborted(false);
 
   // Loop until all RingFields have advanced to completion.
@@ -632,18 +852,39 @@ bool RingReducer::RunAsyncParts() {
           --recv_pending_count;
           if (!rf->second_pass) {
             rf->action = RF_REDUCE;
-            Status s =
-                ComputeBinOp(col_ctx_->device, col_params_->merge_op.get(),
-                             &rf->chunk, &rf->tmp_chunk);
-            if (!s.ok()) {
-              aborted = true;
-              StartAbort(s);
+            if (reduce_pool != nullptr) {
+              rf->reduce_pending = true;
+              reduce_pool->Schedule([this, rf, &ready_queue]() {
+                rf->status = ReduceRecvdChunk(rf);
+                ready_queue.Enqueue(rf);
+              });
+              dispatched = true;
+              ++reduce_pending_count;
+            } else {
+              Status s = ReduceRecvdChunk(rf);
+              if (!s.ok()) {
+                aborted = true;
+                StartAbort(s);
+              }
             }
           } else {
+            if (CompressedTransfer(*rf)) {
+              DecompressChunk(rf->recv_buf, &rf->chunk);
+            }
             rf->action = RF_SEND_READY;
           }
           break;
         case RF_REDUCE:
+          if (rf->reduce_pending) {
+            CHECK_GT(reduce_pending_count, 0);
+            --reduce_pending_count;
+            rf->reduce_pending = false;
+            if (!rf->status.ok()) {
+              aborted = true;
+              StartAbort(rf->status);
+              break;
+            }
+          }
           if (!rf->second_pass && col_params_->final_op.get() && rf->is_final) {
             rf->action = RF_FINALIZE;
             group_size_tensor_ready_.WaitForNotification();
@@ -663,6 +904,14 @@ bool RingReducer::RunAsyncParts() {
           break;
         case RF_SEND_READY:
           if (rf->do_send) {
+            if (CompressedTransfer(*rf)) {
+              CompressChunk(rf);
+              if (rf->second_pass && !rf->do_recv) {
+                // The reduced value is rounded here as it is on the devices
+                // receiving it, so that all devices end with the same value.
+                DecompressChunk(rf->send_buf, &rf->chunk);
+              }
+            }
             rf->action = RF_SEND;
             auto send_complete = [this, rf, &ready_queue, &aborted](Status s) {
               if (!s.ok()) {
@@ -701,12 +950,19 @@ bool RingReducer::RunAsyncParts() {
   if (aborted) {
     // All of the pending data actions should be aborted; field the
     // callbacks and clear the queue before quitting.
-    while ((send_pending_count > 0) || (recv_pending_count > 0)) {
+    while ((send_pending_count > 0) || (recv_pending_count > 0) ||
+           (reduce_pending_count > 0)) {
       RingField* rf = ready_queue.Dequeue();
       switch (rf->action) {
         case RF_RECV:
           --recv_pending_count;
           break;
+        case RF_REDUCE:
+          if (rf->reduce_pending) {
+            rf->reduce_pending = false;
+            --reduce_pending_count;
+          }
+          break;
         case RF_SEND:
           --send_pending_count;
           break;
@@ -718,6 +974,7 @@ bool RingReducer::RunAsyncParts() {
 
   CHECK_EQ(send_pending_count, 0);
   CHECK_EQ(recv_pending_count, 0);
+  CHECK_EQ(reduce_pending_count, 0);
 
   VLOG(2) << this << " device=" << col_ctx_->device_name << " finish;"
           << " final value " << TensorDebugString(ca_->Value());
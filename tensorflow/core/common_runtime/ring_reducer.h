@@ -22,10 +22,33 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/base_collective_executor.h"
 #include "tensorflow/core/framework/collective.h"
+#include "tensorflow/core/framework/resource_mgr.h"
 
 namespace tensorflow {
 class Device;
 
+// The error feedback of top-k compression in RingReducer: for each field of
+// the reduced tensor, the values a device left out of what it sent, which it
+// adds back before sending on the next execution of the same instance. Kept
+// in the ResourceMgr of the device, in the CollectiveInstanceContainer of the
+// instance, so they are freed along with its op kernel.
+class RingReduceResiduals : public ResourceBase {
+ public:
+  // Looks up the residuals of `instance_key` on `device`, creating them if
+  // needed. The caller owns a reference on `*residuals`.
+  static Status LookupOrCreate(Device* device, int32 instance_key,
+                               RingReduceResiduals** residuals);
+
+  // Returns the residual of field `field_idx`, shaped like `chunk`: zeros at
+  // first.
+  Tensor* Get(int field_idx, const Tensor& chunk) EXCLUSIVE_LOCKS_REQUIRED(mu);
+
+  string DebugString() override { return "RingReduceResiduals"; }
+
+  mutex mu;
+  std::vector<Tensor> residuals GUARDED_BY(mu);
+};
+
 // Ring-algorithm implementation of collective all-reduce.
 class RingReducer : public CollectiveImplementationInterface {
  public:
@@ -98,8 +121,11 @@ class RingReducer : public CollectiveImplementationInterface {
     bool do_send = false;   // is the value sent in this pass?
     bool do_recv = false;   // is the value recv'd in this pass?
     bool is_final = false;  // is the last field in the pass for this rank
+    bool reduce_pending = false;  // is a reduction running asynchronously?
     Tensor chunk;           // alias to field values
     Tensor tmp_chunk;
+    Tensor send_buf;        // compressed values to send
+    Tensor recv_buf;        // compressed values received
     Status status;
     string DebugString() const;
   };
@@ -109,6 +135,18 @@ class RingReducer : public CollectiveImplementationInterface {
   void DispatchSend(RingField* rf, const StatusCallback& done);
   void DispatchRecv(RingField* rf, const StatusCallback& done);
 
+  // Merges the values received for `rf` into its chunk.
+  Status ReduceRecvdChunk(RingField* rf);
+
+  // Whether the values of `rf` are sent compressed in its current pass. Top-k
+  // compression only applies to the first pass, as the values of the second
+  // pass are final.
+  bool CompressedTransfer(const RingField& rf) const;
+  // Compresses the chunk of `rf` into its send_buf.
+  void CompressChunk(RingField* rf);
+  // Decompresses `src` into `dst`.
+  void DecompressChunk(const Tensor& src, Tensor* dst);
+
   // For constructing log messages for debugging.
   string FieldState();
   string TensorDebugString(const Tensor& tensor);
@@ -131,6 +169,8 @@ class RingReducer : public CollectiveImplementationInterface {
   StatusCallback done_;
   int group_size_;
   int num_subdivs_;
+  CollectiveCompression compression_;
+  RingReduceResiduals* residuals_;  // Only with top-k compression.
   Tensor group_size_tensor_;
   Notification group_size_tensor_ready_;
   std::unique_ptr<CollectiveAdapter> ca_;
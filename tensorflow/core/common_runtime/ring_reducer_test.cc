@@ -15,6 +15,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/ring_reducer.h"
 
 #include <algorithm>
+#include <cmath>
 #include "tensorflow/core/common_runtime/base_collective_executor.h"
 #include "tensorflow/core/common_runtime/collective_rma_local.h"
 #include "tensorflow/core/common_runtime/device.h"
@@ -39,7 +40,7 @@ limitations under the License.
 namespace tensorflow {
 
 // Wraps CollectiveRemoteAccessLocal with the ability to return an
-// error status to the N'th action.
+// error status to the N'th action, and counts the bytes sent.
 class FailTestRMA : public CollectiveRemoteAccessLocal {
  public:
   FailTestRMA(const DeviceMgr* dev_mgr, DeviceResolverInterface* dev_resolver,
@@ -84,13 +85,23 @@ class FailTestRMA : public CollectiveRemoteAccessLocal {
                   const DeviceLocality& client_locality,
                   const StatusCallback& done) override {
     if (MaybeFail(done)) return;
+    {
+      mutex_lock l(mu_);
+      bytes_sent_ += from_tensor->TotalBytes();
+    }
     CollectiveRemoteAccessLocal::PostToPeer(
         peer_device, peer_task, key, from_device, from_device_ctx,
         from_alloc_attr, from_tensor, client_locality, done);
   }
 
+  int64 bytes_sent() {
+    mutex_lock l(mu_);
+    return bytes_sent_;
+  }
+
   mutex mu_;
   int fail_after_ GUARDED_BY(mu_);
+  int64 bytes_sent_ GUARDED_BY(mu_) = 0;
 };
 
 std::unique_ptr<OpKernel> GetKernel(const NodeDef& node,
@@ -203,6 +214,9 @@ class RingReducerTest : public ::testing::Test {
     col_params_.instance.type = REDUCTION_COLLECTIVE;
     col_params_.instance.impl_details.collective_name = "RingReduce";
     col_params_.instance.data_type = dtype;
+    col_params_.instance.impl_details.bidirectional = bidirectional_;
+    col_params_.instance.impl_details.compression = compression_;
+    col_params_.instance.impl_details.topk_fraction = topk_fraction_;
     col_params_.instance.impl_details.subdiv_permutations.resize(num_subdivs);
     col_params_.subdiv_rank.resize(num_subdivs);
     int subdiv_stride = num_devices / num_subdivs;
@@ -251,6 +265,14 @@ class RingReducerTest : public ::testing::Test {
         }
       }
     }
+    if (bidirectional_) {
+      // As RingReducer::InitializeCollectiveParams does.
+      for (int sdi = 1; sdi < num_subdivs; sdi += 2) {
+        std::vector<int>& perm =
+            col_params_.instance.impl_details.subdiv_permutations[sdi];
+        std::reverse(perm.begin(), perm.end());
+      }
+    }
     for (int wi = 0; wi < num_workers; ++wi) {
       for (int di = 0; di < num_devices; ++di) {
         int rank = wi * num_devices + di;
@@ -356,6 +378,60 @@ class RingReducerTest : public ::testing::Test {
     }
   }
 
+  // Reduces float tensors of `tensor_len` values, initialized by `value_f`
+  // from the device index and the value index, and checks that all devices
+  // end with the same value, within `tolerance` of the exact mean.
+  void RunCompressionTest(
+      int num_devices, int num_subdivs, int tensor_len,
+      const std::function<float(int di, int i)>& value_f, float tolerance) {
+    Init(1, num_devices, DT_FLOAT, DEVICE_CPU, num_subdivs, 0);
+    std::vector<float> expected(tensor_len, 0.0);
+    for (int di = 0; di < static_cast<int>(instances_.size()); ++di) {
+      instances_[di]->InitTensor(
+          DT_FLOAT, TensorShape({tensor_len}),
+          [&expected, &value_f, di](Tensor* t) {
+            for (int i = 0; i < t->NumElements(); ++i) {
+              t->flat<float>()(i) = value_f(di, i);
+              expected[i] += value_f(di, i);
+            }
+          });
+    }
+    Reduce(0);
+    const Tensor& first = instances_[0]->tensor_;
+    for (int di = 0; di < static_cast<int>(instances_.size()); ++di) {
+      TF_EXPECT_OK(instances_[di]->status_);
+      const Tensor& actual = instances_[di]->tensor_;
+      for (int i = 0; i < tensor_len; ++i) {
+        EXPECT_NEAR(expected[i] / num_devices, actual.flat<float>()(i),
+                    tolerance)
+            << "Mismatch at device " << di << " index " << i;
+        EXPECT_EQ(first.flat<float>()(i), actual.flat<float>()(i))
+            << "Devices differ at device " << di << " index " << i;
+      }
+    }
+  }
+
+  // The sum of the top-k compression residuals left on all devices.
+  float SumOfResiduals() {
+    float sum = 0;
+    for (DeviceInstance* instance : instances_) {
+      RingReduceResiduals* residuals = nullptr;
+      TF_CHECK_OK(RingReduceResiduals::LookupOrCreate(
+          instance->device_, col_params_.instance.instance_key, &residuals));
+      {
+        mutex_lock l(residuals->mu);
+        for (const Tensor& residual : residuals->residuals) {
+          if (!residual.IsInitialized()) continue;
+          for (int i = 0; i < residual.NumElements(); ++i) {
+            sum += residual.flat<float>()(i);
+          }
+        }
+      }
+      residuals->Unref();
+    }
+    return sum;
+  }
+
   std::unique_ptr<OpKernel> GetCollectiveReduce(const CollectiveParams& params,
                                                 Tensor* input,
                                                 const DeviceType& device_type,
@@ -394,6 +470,13 @@ class RingReducerTest : public ::testing::Test {
     reducer.group_size_tensor_ready_.Notify();  // To unblock destructor.
   }
 
+  Status InitializeParams(CollectiveParams* cp) {
+    RingReducer reducer;
+    Status s = reducer.InitializeCollectiveParams(cp);
+    reducer.group_size_tensor_ready_.Notify();  // To unblock destructor.
+    return s;
+  }
+
   class DeviceInstance {
    public:
     DeviceInstance(int rank, const string& dev_name,
@@ -539,7 +622,7 @@ class RingReducerTest : public ::testing::Test {
   DeviceType device_type_;
   TestCollectiveExecutorMgr col_exec_mgr_;
   CollectiveExecutor* col_exec_;
-  CollectiveRemoteAccessLocal* rma_;
+  FailTestRMA* rma_;
   std::unique_ptr<DeviceResolverLocal> dev_resolver_;
   std::vector<DeviceInstance*> instances_;
   CollectiveParams col_params_;
@@ -547,6 +630,10 @@ class RingReducerTest : public ::testing::Test {
   std::unique_ptr<tensorflow::DeviceMgr> dev_mgr_;
   mutex mu_;
   int32 reduce_counter_ GUARDED_BY(mu_) = 0;
+  // Applied to col_params_ by Init().
+  bool bidirectional_ = false;
+  CollectiveCompression compression_ = COMPRESSION_NONE;
+  float topk_fraction_ = 0.01f;
 };
 
 CollectiveParams SetUpCollectiveParams(const int num_devs_per_task,
@@ -639,6 +726,171 @@ TEST_F(RingReducerTest, AutomaticSubdivs) {
                      {0, 3});
 }
 
+TEST_F(RingReducerTest, BidirectionalParams) {
+  const int kNumDevsPerTask = 8;
+  const int kNumTasks = 3;
+  CollectiveParams cp = SetUpCollectiveParams(kNumDevsPerTask, kNumTasks);
+  cp.instance.impl_details.bidirectional = true;
+
+  // Odd subdivisions run in reverse.
+  cp.default_rank = 0;
+  cp.instance.impl_details.subdiv_offsets = {0, 4};
+  RunSubdivPermsTest(&cp,
+                     {{0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11,
+                       12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23},
+                      {19, 18, 17, 16, 23, 22, 21, 20, 11, 10, 9, 8,
+                       15, 14, 13, 12, 3,  2,  1,  0,  7,  6,  5, 4}},
+                     {0, 19});
+
+  // An odd number of given offsets, as the {0} default of the Python
+  // all_reduce, is mirrored into subdivisions running both ways.
+  cp.instance.impl_details.subdiv_offsets = {0};
+  RunSubdivPermsTest(&cp,
+                     {{0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11,
+                       12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23},
+                      {23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12,
+                       11, 10, 9,  8,  7,  6,  5,  4,  3,  2,  1,  0}},
+                     {0, 23});
+
+  // Generated subdivisions come in pairs.
+  cp.instance.impl_details.subdiv_offsets.clear();
+  RunSubdivPermsTest(&cp,
+                     {{0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11,
+                       12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23},
+                      {20, 21, 22, 23, 16, 17, 18, 19, 12, 13, 14, 15,
+                       8,  9,  10, 11, 4,  5,  6,  7,  0,  1,  2,  3}},
+                     {0, 20});
+}
+
+TEST_F(RingReducerTest, CompressionRequiresFloatOnCPU) {
+  CollectiveParams cp = SetUpCollectiveParams(2, 1);
+  cp.default_rank = 0;
+  cp.instance.impl_details.compression = COMPRESSION_FP16;
+  EXPECT_TRUE(errors::IsInvalidArgument(InitializeParams(&cp)));
+}
+
+TEST_F(RingReducerTest, Bidirectional) {
+  bidirectional_ = true;
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, 2, 4, 2, 1001, 0);
+}
+
+TEST_F(RingReducerTest, Fp16Compression) {
+  compression_ = COMPRESSION_FP16;
+  const int kNumDevs = 4;
+  const int kLen = 1024;
+  RunCompressionTest(kNumDevs, 1, kLen,
+                     [](int di, int i) { return (di + 1) * 0.01f * i; },
+                     0.1f);
+  // Both passes send half as many bytes as uncompressed.
+  EXPECT_EQ(2 * (kNumDevs - 1) * kLen * sizeof(Eigen::half),
+            rma_->bytes_sent());
+}
+
+TEST_F(RingReducerTest, Fp16CompressionSaturates) {
+  compression_ = COMPRESSION_FP16;
+  const int kNumDevs = 4;
+  const int kLen = 64;
+  const float kValue = 25000;
+  Init(1, kNumDevs, DT_FLOAT, DEVICE_CPU, 1, 0);
+  for (int di = 0; di < kNumDevs; ++di) {
+    instances_[di]->InitTensor(DT_FLOAT, TensorShape({kLen}),
+                               [kValue](Tensor* t) {
+                                 t->flat<float>().setConstant(kValue);
+                               });
+  }
+  Reduce(0);
+  // The partial sums of three devices exceed the range of half, and are sent
+  // as its largest value instead of as infinity.
+  const float max_half =
+      static_cast<float>(Eigen::NumTraits<Eigen::half>::highest());
+  const Tensor& first = instances_[0]->tensor_;
+  for (int di = 0; di < kNumDevs; ++di) {
+    TF_EXPECT_OK(instances_[di]->status_);
+    const Tensor& actual = instances_[di]->tensor_;
+    for (int i = 0; i < kLen; ++i) {
+      const float value = actual.flat<float>()(i);
+      EXPECT_TRUE(std::isfinite(value)) << "device " << di << " index " << i;
+      EXPECT_LE(max_half / kNumDevs, value);
+      EXPECT_GE(kValue, value);
+      EXPECT_EQ(first.flat<float>()(i), value);
+    }
+  }
+}
+
+TEST_F(RingReducerTest, Bfloat16Compression) {
+  compression_ = COMPRESSION_BF16;
+  bidirectional_ = true;
+  const int kNumDevs = 4;
+  const int kLen = 1024;
+  RunCompressionTest(kNumDevs, 2, kLen,
+                     [](int di, int i) { return (di + 1) * 0.01f * i; },
+                     0.5f);
+  EXPECT_EQ(2 * (kNumDevs - 1) * kLen * sizeof(bfloat16), rma_->bytes_sent());
+}
+
+TEST_F(RingReducerTest, TopKCompressionOfSparseValuesIsExact) {
+  compression_ = COMPRESSION_TOPK;
+  topk_fraction_ = 0.2;
+  const int kNumDevs = 4;
+  const int kLen = 1000;
+  // Each chunk of 250 values has 25 non-zero values, fewer than its k of 50.
+  RunCompressionTest(
+      kNumDevs, 1, kLen,
+      [](int di, int i) { return i % 10 == 0 ? (di + 1) * 0.5f * i : 0.0f; },
+      1e-3);
+  EXPECT_EQ(0, SumOfResiduals());
+  // The first pass sends k indices and k values per chunk, the second pass
+  // all values.
+  const int64 chunk_len = kLen / kNumDevs;
+  const int64 k = 50;
+  EXPECT_EQ(kNumDevs * (kNumDevs - 1) * (2 * k + chunk_len) * sizeof(float),
+            rma_->bytes_sent());
+}
+
+TEST_F(RingReducerTest, TopKCompressionKeepsResiduals) {
+  compression_ = COMPRESSION_TOPK;
+  topk_fraction_ = 0.01;
+  const int kNumDevs = 4;
+  const int kLen = 1000;
+  Init(1, kNumDevs, DT_FLOAT, DEVICE_CPU, 1, 0);
+  float input_sum = 0;
+  for (int di = 0; di < kNumDevs; ++di) {
+    instances_[di]->InitTensor(DT_FLOAT, TensorShape({kLen}),
+                               [&input_sum, di](Tensor* t) {
+                                 for (int i = 0; i < kLen; ++i) {
+                                   t->flat<float>()(i) = (di + 1) + i % 7;
+                                   input_sum += t->flat<float>()(i);
+                                 }
+                               });
+  }
+  Reduce(0);
+  float output_sum = 0;
+  for (int di = 0; di < kNumDevs; ++di) {
+    TF_EXPECT_OK(instances_[di]->status_);
+    EXPECT_EQ(kLen, instances_[di]->tensor_.NumElements());
+  }
+  for (int i = 0; i < kLen; ++i) {
+    output_sum += instances_[0]->tensor_.flat<float>()(i);
+  }
+  // What was not sent is kept for the next execution.
+  EXPECT_NEAR(input_sum, kNumDevs * output_sum + SumOfResiduals(),
+              1e-4 * input_sum);
+
+  // The residuals are kept in the container of the instance, which its op
+  // kernel cleans up when destroyed.
+  const string container =
+      CollectiveInstanceContainer(col_params_.instance.instance_key);
+  for (DeviceInstance* instance : instances_) {
+    RingReduceResiduals* residuals = nullptr;
+    TF_EXPECT_OK(
+        instance->device_->resource_manager()->Lookup<RingReduceResiduals>(
+            container, "ring_reduce_residuals", &residuals));
+    if (residuals != nullptr) residuals->Unref();
+    TF_EXPECT_OK(instance->device_->resource_manager()->Cleanup(container));
+  }
+  EXPECT_EQ(0, SumOfResiduals());
+}
+
 TEST_F(RingReducerTest, AutomaticSubdivUpperBound) {
   const int kNumDevsPerTask = 1;
   const int kNumTasks = 4;
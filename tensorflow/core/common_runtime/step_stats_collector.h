@@ -147,6 +147,10 @@ class StepStatsCollectorInterface {
   // "ResourceExhaustedError: OOM when allocating tensor ...
   // on /job:localhost/replica:0/task:0/device:GPU:0 by allocator GPU_0_bfc"
   virtual string ReportAllocsOnResourceExhausted(const string& err) = 0;
+
+  // Returns whether the executor should track the allocations of the nodes
+  // for which statistics are collected.
+  virtual bool TrackAllocations() const { return true; }
 };
 
 // StepStatsCollector manages the collection of a StepStats object.
@@ -0,0 +1,299 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_trace_collector.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace {
+
+// Owns the ring buffers of all threads.  Buffers are never freed, so that
+// readers need not synchronize with exiting threads; the buffer of an exited
+// thread is handed to the next thread needing one.
+class RingBufferRegistry {
+ public:
+  static RingBufferRegistry* Global() {
+    static RingBufferRegistry* registry = new RingBufferRegistry;
+    return registry;
+  }
+
+  StepTraceRingBuffer* Acquire() {
+    mutex_lock l(mu_);
+    if (!free_.empty()) {
+      StepTraceRingBuffer* buffer = free_.back();
+      free_.pop_back();
+      return buffer;
+    }
+    buffers_.emplace_back(
+        new StepTraceRingBuffer(static_cast<int32>(buffers_.size())));
+    return buffers_.back().get();
+  }
+
+  void Release(StepTraceRingBuffer* buffer) {
+    mutex_lock l(mu_);
+    free_.push_back(buffer);
+  }
+
+  void CollectAll(int64 trace_id, std::vector<StepTraceEvent>* events) {
+    mutex_lock l(mu_);
+    for (const auto& buffer : buffers_) {
+      buffer->Collect(trace_id, events);
+    }
+  }
+
+ private:
+  mutex mu_;
+  std::vector<std::unique_ptr<StepTraceRingBuffer>> buffers_ GUARDED_BY(mu_);
+  std::vector<StepTraceRingBuffer*> free_ GUARDED_BY(mu_);
+};
+
+// Holds the ring buffer of a thread, and releases it when the thread exits.
+struct ThreadRingBuffer {
+  ThreadRingBuffer() : buffer(RingBufferRegistry::Global()->Acquire()) {}
+  ~ThreadRingBuffer() { RingBufferRegistry::Global()->Release(buffer); }
+
+  StepTraceRingBuffer* const buffer;
+};
+
+std::atomic<int64> next_trace_id(1);
+
+// Records the execution of one node into a StepTraceEvent, and appends it to
+// the ring buffer of the thread completing the node.
+class TraceNodeExecStats : public NodeExecStatsInterface {
+ public:
+  TraceNodeExecStats(int64 trace_id, const Node* node) {
+    event_.trace_id = trace_id;
+    event_.node = node;
+  }
+
+  void Done(const string& device) override {
+    StepTraceRingBuffer* buffer = StepTraceRingBuffer::ForCurrentThread();
+    event_.thread_id = buffer->thread_id();
+    buffer->Append(event_);
+    delete this;
+  }
+
+  void RecordExecutorStarted() override {
+    event_.all_start_nanos = Env::Default()->NowNanos();
+  }
+
+  void RecordComputeStarted() override {
+    event_.op_start_nanos = Env::Default()->NowNanos();
+  }
+
+  void RecordComputeEnded() override {
+    event_.op_end_nanos = Env::Default()->NowNanos();
+  }
+
+  void RecordExecutorEnded() override {
+    event_.all_end_nanos = Env::Default()->NowNanos();
+  }
+
+  void SetMemory(OpKernelContext* ctx) override {}
+
+  void SetOutput(int slot, const Tensor* tensor) override {
+    event_.output_bytes += tensor->TotalBytes();
+  }
+
+  void SetReferencedTensors(const TensorReferenceVector& tensors) override {}
+
+  void SetScheduled(int64 nanos) override { event_.scheduled_nanos = nanos; }
+
+ private:
+  StepTraceEvent event_;
+};
+
+}  // namespace
+
+constexpr int64 StepTraceRingBuffer::kCapacity;
+constexpr int StepTraceRingBuffer::kEventWords;
+
+/* static */
+StepTraceRingBuffer* StepTraceRingBuffer::ForCurrentThread() {
+  static thread_local ThreadRingBuffer thread_buffer;
+  return thread_buffer.buffer;
+}
+
+/* static */
+void StepTraceRingBuffer::CollectAll(int64 trace_id,
+                                     std::vector<StepTraceEvent>* events) {
+  RingBufferRegistry::Global()->CollectAll(trace_id, events);
+}
+
+void StepTraceRingBuffer::Append(const StepTraceEvent& event) {
+  static_assert(sizeof(StepTraceEvent) % sizeof(int64) == 0,
+                "StepTraceEvent must be made of whole words");
+  int64 words[kEventWords];
+  memcpy(words, &event, sizeof(words));
+
+  const int64 head = head_.load(std::memory_order_relaxed);
+  Slot& slot = slots_[head & (kCapacity - 1)];
+  const int64 seq = slot.seq.load(std::memory_order_relaxed);
+  slot.seq.store(seq + 1, std::memory_order_relaxed);
+  // Orders the odd sequence number before the writes of the words, for readers
+  // checking the sequence number after reading them.
+  std::atomic_thread_fence(std::memory_order_release);
+  for (int i = 0; i < kEventWords; ++i) {
+    slot.words[i].store(words[i], std::memory_order_relaxed);
+  }
+  slot.seq.store(seq + 2, std::memory_order_release);
+  head_.store(head + 1, std::memory_order_release);
+}
+
+void StepTraceRingBuffer::Collect(int64 trace_id,
+                                  std::vector<StepTraceEvent>* events) const {
+  const int64 head = head_.load(std::memory_order_acquire);
+  const int64 begin = std::max<int64>(0, head - kCapacity);
+  constexpr int kTraceIdWord =
+      offsetof(StepTraceEvent, trace_id) / sizeof(int64);
+  const size_t first = events->size();
+  std::vector<int64> indices;
+  int64 words[kEventWords];
+  for (int64 i = begin; i < head; ++i) {
+    const Slot& slot = slots_[i & (kCapacity - 1)];
+    const int64 seq = slot.seq.load(std::memory_order_acquire);
+    // Skips the slot if it is being written, or already holds a newer event.
+    if (seq != 2 * (i / kCapacity + 1)) continue;
+    if (slot.words[kTraceIdWord].load(std::memory_order_relaxed) !=
+        trace_id) {
+      continue;
+    }
+    for (int w = 0; w < kEventWords; ++w) {
+      words[w] = slot.words[w].load(std::memory_order_relaxed);
+    }
+    // Orders the reads of the words before the check of the sequence number.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != seq) continue;
+    events->emplace_back();
+    memcpy(&events->back(), words, sizeof(words));
+    indices.push_back(i);
+  }
+  // Events are only skipped above once the owning thread overwrites their
+  // slot, which it does in order.  Dropping the events older than the oldest
+  // one still held, like the skipped ones, keeps the result contiguous.
+  const int64 new_head = head_.load(std::memory_order_acquire);
+  size_t out = first;
+  for (size_t k = 0; k < indices.size(); ++k) {
+    if (indices[k] >= new_head - kCapacity) {
+      (*events)[out++] = (*events)[first + k];
+    }
+  }
+  events->resize(out);
+}
+
+StepTraceCollector::StepTraceCollector()
+    : trace_id_(next_trace_id.fetch_add(1, std::memory_order_relaxed)) {}
+
+NodeExecStatsInterface* StepTraceCollector::CreateNodeExecStats(
+    const Node* node) {
+  // Only collect statistics for non-transfer nodes, like StepStatsCollector.
+  if (IsSend(node) || IsRecv(node)) {
+    return nullptr;
+  }
+  return new TraceNodeExecStats(trace_id_, node);
+}
+
+string StepTraceCollector::ReportAllocsOnResourceExhausted(const string& err) {
+  return "";
+}
+
+std::vector<StepTraceEvent> StepTraceCollector::Events() const {
+  std::vector<StepTraceEvent> events;
+  StepTraceRingBuffer::CollectAll(trace_id_, &events);
+  std::sort(events.begin(), events.end(),
+            [](const StepTraceEvent& a, const StepTraceEvent& b) {
+              return a.all_start_nanos < b.all_start_nanos;
+            });
+  return events;
+}
+
+void StepTraceCollector::ToStepStats(StepStats* step_stats) const {
+  std::map<string, DeviceStepStats*> dev_stats;
+  for (const StepTraceEvent& event : Events()) {
+    const string& device = event.node->assigned_device_name();
+    DeviceStepStats*& device_stats = dev_stats[device];
+    if (device_stats == nullptr) {
+      device_stats = step_stats->add_dev_stats();
+      device_stats->set_device(device);
+    }
+    NodeExecStats* ns = device_stats->add_node_stats();
+    ns->set_node_name(event.node->name());
+    ns->set_timeline_label(strings::StrCat(event.node->name(), " = ",
+                                           event.node->type_string(), "()"));
+    ns->set_thread_id(event.thread_id);
+    const int64 start = event.all_start_nanos;
+    ns->set_scheduled_nanos(event.scheduled_nanos);
+    ns->set_scheduled_micros(event.scheduled_nanos / EnvTime::kMicrosToNanos);
+    ns->set_all_start_nanos(start);
+    ns->set_all_start_micros(start / EnvTime::kMicrosToNanos);
+    ns->set_op_start_rel_nanos(event.op_start_nanos - start);
+    ns->set_op_start_rel_micros((event.op_start_nanos - start) /
+                                EnvTime::kMicrosToNanos);
+    ns->set_op_end_rel_nanos(event.op_end_nanos - start);
+    ns->set_op_end_rel_micros((event.op_end_nanos - start) /
+                              EnvTime::kMicrosToNanos);
+    ns->set_all_end_rel_nanos(event.all_end_nanos - start);
+    ns->set_all_end_rel_micros((event.all_end_nanos - start) /
+                               EnvTime::kMicrosToNanos);
+    AllocatorMemoryUsed* memory = ns->add_memory();
+    memory->set_allocator_name("output");
+    memory->set_total_bytes(event.output_bytes);
+  }
+}
+
+string StepTraceCollector::ToChromeTrace() const {
+  std::map<string, int> pids;
+  string trace = "{\"traceEvents\":[";
+  bool first = true;
+  for (const StepTraceEvent& event : Events()) {
+    const string& device = event.node->assigned_device_name();
+    auto it = pids.find(device);
+    if (it == pids.end()) {
+      it = pids.emplace(device, static_cast<int>(pids.size())).first;
+      strings::StrAppend(&trace, first ? "" : ",",
+                         "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":",
+                         it->second, ",\"args\":{\"name\":\"", device, "\"}}");
+      first = false;
+    }
+    // Node and device names need no escaping.
+    strings::StrAppend(
+        &trace, first ? "" : ",", "{\"ph\":\"X\",\"name\":\"",
+        event.node->type_string(), "\",\"pid\":", it->second,
+        ",\"tid\":", event.thread_id,
+        ",\"ts\":", event.all_start_nanos / EnvTime::kMicrosToNanos,
+        ",\"dur\":",
+        (event.all_end_nanos - event.all_start_nanos) / EnvTime::kMicrosToNanos,
+        ",\"args\":{\"name\":\"", event.node->name(),
+        "\",\"output_bytes\":", event.output_bytes, "}}");
+    first = false;
+  }
+  strings::StrAppend(&trace, "]}");
+  return trace;
+}
+
+}  // namespace tensorflow
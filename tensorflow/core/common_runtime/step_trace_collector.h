@@ -0,0 +1,130 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_STEP_TRACE_COLLECTOR_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_STEP_TRACE_COLLECTOR_H_
+
+#include <atomic>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/step_stats_collector.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+class Node;
+class StepStats;
+
+// A fixed-size record of the execution of one node, as kept by
+// StepTraceCollector.  Times are in nanoseconds since the epoch.
+struct StepTraceEvent {
+  int64 trace_id = 0;
+  const Node* node = nullptr;
+  int64 scheduled_nanos = 0;
+  int64 all_start_nanos = 0;
+  int64 op_start_nanos = 0;
+  int64 op_end_nanos = 0;
+  int64 all_end_nanos = 0;
+  // Total size of the output tensors of the node.
+  int64 output_bytes = 0;
+  // Index of the ring buffer, and thus of the thread, that recorded the event.
+  int32 thread_id = 0;
+};
+
+// A ring buffer of the most recent StepTraceEvents recorded by one thread.
+// Appends are wait-free and only made by the owning thread; readers may run
+// concurrently on other threads, and skip the events being overwritten.
+// Each slot is a seqlock: its words are atomics, and its sequence number is
+// odd while it is written.
+class StepTraceRingBuffer {
+ public:
+  static constexpr int64 kCapacity = 1 << 14;
+
+  explicit StepTraceRingBuffer(int32 thread_id) : thread_id_(thread_id) {}
+
+  // Returns the buffer of the calling thread, creating it on first use.  The
+  // buffer of an exiting thread is reused by a later thread.
+  static StepTraceRingBuffer* ForCurrentThread();
+
+  // Appends to `events` the events of `trace_id` held by all ring buffers.
+  static void CollectAll(int64 trace_id, std::vector<StepTraceEvent>* events);
+
+  // Appends `event`, overwriting the oldest event if the buffer is full.
+  void Append(const StepTraceEvent& event);
+
+  // Appends to `events` the events of `trace_id` held by this buffer.
+  void Collect(int64 trace_id, std::vector<StepTraceEvent>* events) const;
+
+  int32 thread_id() const { return thread_id_; }
+
+ private:
+  static constexpr int kEventWords = sizeof(StepTraceEvent) / sizeof(int64);
+
+  struct Slot {
+    // Twice the number of writes started to the slot, minus one while a write
+    // is in progress.  The event appended at index i is complete when the
+    // sequence number is 2 * (i / kCapacity + 1).
+    std::atomic<int64> seq{0};
+    std::atomic<int64> words[kEventWords];
+  };
+
+  const int32 thread_id_;
+  // Number of events ever appended.
+  std::atomic<int64> head_{0};
+  Slot slots_[kCapacity];
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepTraceRingBuffer);
+};
+
+// StepTraceCollector is a low-overhead alternative to StepStatsCollector,
+// meant to be left enabled on a sample of the steps in production.  Nodes
+// append a StepTraceEvent to the ring buffer of their thread when done,
+// without taking locks or building protos, and do not track allocations.
+// The events are converted to StepStats or to the Chrome trace format on
+// demand, as long as the ring buffers still hold them.
+class StepTraceCollector : public StepStatsCollectorInterface {
+ public:
+  StepTraceCollector();
+
+  NodeExecStatsInterface* CreateNodeExecStats(const Node* node) override;
+  string ReportAllocsOnResourceExhausted(const string& err) override;
+  bool TrackAllocations() const override { return false; }
+
+  // Identifies the events of this collector in the ring buffers.
+  int64 trace_id() const { return trace_id_; }
+
+  // Returns the events recorded so far, ordered by start time.
+  std::vector<StepTraceEvent> Events() const;
+
+  // Adds the recorded events to `step_stats`, one DeviceStepStats per
+  // assigned device.  The output size of each node is reported as the
+  // total_bytes of an "output" AllocatorMemoryUsed.  The traced nodes must
+  // still be alive.
+  void ToStepStats(StepStats* step_stats) const;
+
+  // Returns the recorded events in the Chrome trace event JSON format, with
+  // one process per device and one thread per ring buffer.  The traced nodes
+  // must still be alive.
+  string ToChromeTrace() const;
+
+ private:
+  const int64 trace_id_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StepTraceCollector);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_STEP_TRACE_COLLECTOR_H_
@@ -0,0 +1,188 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/step_trace_collector.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+StepTraceEvent MakeEvent(int64 trace_id, int64 start) {
+  StepTraceEvent event;
+  event.trace_id = trace_id;
+  event.all_start_nanos = start;
+  event.all_end_nanos = 2 * start;
+  return event;
+}
+
+TEST(StepTraceRingBufferTest, KeepsMostRecentEvents) {
+  std::unique_ptr<StepTraceRingBuffer> buffer(new StepTraceRingBuffer(0));
+  const int64 num_events = StepTraceRingBuffer::kCapacity + 10;
+  for (int64 i = 0; i < num_events; ++i) {
+    buffer->Append(MakeEvent(i % 2 + 1, i));
+  }
+  std::vector<StepTraceEvent> events;
+  buffer->Collect(1, &events);
+  ASSERT_EQ(StepTraceRingBuffer::kCapacity / 2, events.size());
+  EXPECT_EQ(10, events.front().all_start_nanos);
+  EXPECT_EQ(num_events - 2, events.back().all_start_nanos);
+  events.clear();
+  buffer->Collect(3, &events);
+  EXPECT_TRUE(events.empty());
+}
+
+TEST(StepTraceRingBufferTest, ConcurrentCollect) {
+  std::unique_ptr<StepTraceRingBuffer> buffer(new StepTraceRingBuffer(0));
+  std::atomic<bool> stop(false);
+  std::unique_ptr<Thread> writer(
+      Env::Default()->StartThread({}, "writer", [&buffer, &stop]() {
+        for (int64 i = 1; !stop; ++i) {
+          buffer->Append(MakeEvent(1, i));
+        }
+      }));
+  for (int i = 0; i < 100; ++i) {
+    std::vector<StepTraceEvent> events;
+    buffer->Collect(1, &events);
+    ASSERT_LE(events.size(), StepTraceRingBuffer::kCapacity);
+    for (size_t k = 0; k < events.size(); ++k) {
+      // No collected event is torn, and they are in order without gaps.
+      EXPECT_EQ(2 * events[k].all_start_nanos, events[k].all_end_nanos);
+      if (k > 0) {
+        EXPECT_EQ(events[k - 1].all_start_nanos + 1,
+                  events[k].all_start_nanos);
+      }
+    }
+  }
+  stop = true;
+}
+
+class StepTraceCollectorTest : public ::testing::Test {
+ protected:
+  StepTraceCollectorTest() : graph_(OpRegistry::Global()) {}
+
+  Node* AddConstant(const string& device, int64 num_elements) {
+    Node* node = test::graph::Constant(
+        &graph_, Tensor(DT_FLOAT, TensorShape({num_elements})));
+    node->set_assigned_device_name(device);
+    return node;
+  }
+
+  // Records an execution of `node` into `collector`, on the calling thread.
+  void Execute(StepTraceCollector* collector, Node* node) {
+    NodeExecStatsInterface* stats = collector->CreateNodeExecStats(node);
+    stats->SetScheduled(Env::Default()->NowNanos());
+    stats->RecordExecutorStarted();
+    stats->RecordComputeStarted();
+    stats->RecordComputeEnded();
+    Tensor output(DT_FLOAT, TensorShape({10}));
+    stats->SetOutput(0, &output);
+    stats->RecordExecutorEnded();
+    stats->Done(node->assigned_device_name());
+  }
+
+  Graph graph_;
+};
+
+TEST_F(StepTraceCollectorTest, ToStepStats) {
+  const string cpu0 = "/job:localhost/replica:0/task:0/device:CPU:0";
+  const string cpu1 = "/job:localhost/replica:0/task:0/device:CPU:1";
+  Node* a = AddConstant(cpu0, 1);
+  Node* b = AddConstant(cpu1, 2);
+  Node* c = AddConstant(cpu1, 3);
+
+  StepTraceCollector collector;
+  StepTraceCollector other_collector;
+  EXPECT_NE(collector.trace_id(), other_collector.trace_id());
+  EXPECT_FALSE(collector.TrackAllocations());
+  Execute(&collector, a);
+  Execute(&other_collector, a);
+  // Nodes may complete on any thread.
+  std::unique_ptr<Thread> thread(Env::Default()->StartThread(
+      {}, "executor", [this, &collector, b, c]() {
+        Execute(&collector, b);
+        Execute(&collector, c);
+      }));
+  thread.reset();
+
+  EXPECT_EQ(3, collector.Events().size());
+  EXPECT_EQ(1, other_collector.Events().size());
+
+  StepStats step_stats;
+  collector.ToStepStats(&step_stats);
+  ASSERT_EQ(2, step_stats.dev_stats_size());
+  std::map<string, std::vector<string>> nodes_by_device;
+  for (const DeviceStepStats& dev_stats : step_stats.dev_stats()) {
+    for (const NodeExecStats& ns : dev_stats.node_stats()) {
+      nodes_by_device[dev_stats.device()].push_back(ns.node_name());
+      EXPECT_GT(ns.all_start_nanos(), 0);
+      EXPECT_LE(ns.op_start_rel_nanos(), ns.op_end_rel_nanos());
+      EXPECT_LE(ns.op_end_rel_nanos(), ns.all_end_rel_nanos());
+      ASSERT_EQ(1, ns.memory_size());
+      EXPECT_EQ(40, ns.memory(0).total_bytes());
+    }
+  }
+  EXPECT_EQ(std::vector<string>({a->name()}), nodes_by_device[cpu0]);
+  EXPECT_EQ(std::vector<string>({b->name(), c->name()}),
+            nodes_by_device[cpu1]);
+  const int32 main_thread = step_stats.dev_stats(0).node_stats(0).thread_id();
+  EXPECT_NE(main_thread, step_stats.dev_stats(1).node_stats(0).thread_id());
+}
+
+TEST_F(StepTraceCollectorTest, ToChromeTrace) {
+  const string cpu0 = "/job:localhost/replica:0/task:0/device:CPU:0";
+  Node* a = AddConstant(cpu0, 1);
+  StepTraceCollector collector;
+  Execute(&collector, a);
+  const string trace = collector.ToChromeTrace();
+  EXPECT_EQ(0, trace.find("{\"traceEvents\":[{\"ph\":\"M\""));
+  EXPECT_NE(string::npos, trace.find(strings::StrCat(
+                              "\"args\":{\"name\":\"", a->name(), "\"")));
+  EXPECT_NE(string::npos, trace.find(cpu0));
+  EXPECT_NE(string::npos, trace.find("\"output_bytes\":40"));
+}
+
+static void BM_StepTraceCollector(int iters) {
+  testing::StopTiming();
+  Graph graph(OpRegistry::Global());
+  Node* node = test::graph::Constant(&graph, Tensor(DT_FLOAT, {1}));
+  Tensor output(DT_FLOAT, TensorShape({10}));
+  StepTraceCollector collector;
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    NodeExecStatsInterface* stats = collector.CreateNodeExecStats(node);
+    stats->RecordExecutorStarted();
+    stats->RecordComputeStarted();
+    stats->RecordComputeEnded();
+    stats->SetOutput(0, &output);
+    stats->RecordExecutorEnded();
+    stats->Done("");
+  }
+}
+BENCHMARK(BM_StepTraceCollector);
+
+}  // namespace
+}  // namespace tensorflow
@@ -46,6 +46,10 @@ std::vector<RegistrationInfo>* MutableCollectiveRegistry() {
 }
 }  // namespace
 
+string CollectiveInstanceContainer(int32 instance_key) {
+  return strings::StrCat("collective_instance_", instance_key);
+}
+
 string CollGroupParams::ToString() const {
   return strings::StrCat("CollGroupParams {group_key=", group_key,
                          " group_size=", group_size,
@@ -64,6 +68,8 @@ CollInstanceParams& CollInstanceParams::operator=(
     device_names.assign(other.device_names.begin(), other.device_names.end());
     task_names.assign(other.task_names.begin(), other.task_names.end());
     same_num_devices_per_task = other.same_num_devices_per_task;
+    locality_groups.assign(other.locality_groups.begin(),
+                           other.locality_groups.end());
     impl_details.subdiv_offsets.assign(
         other.impl_details.subdiv_offsets.begin(),
         other.impl_details.subdiv_offsets.end());
@@ -75,6 +81,10 @@ CollInstanceParams& CollInstanceParams::operator=(
     impl_details.subdiv_source_rank.assign(
         other.impl_details.subdiv_source_rank.begin(),
         other.impl_details.subdiv_source_rank.end());
+    impl_details.bidirectional = other.impl_details.bidirectional;
+    impl_details.compression = other.impl_details.compression;
+    impl_details.topk_fraction = other.impl_details.topk_fraction;
+    impl_details.hierarchical = other.impl_details.hierarchical;
   }
   return *this;
 }
@@ -110,6 +120,25 @@ string CollInstanceParams::ToString() const {
     strings::StrAppend(&v, "}");
   }
   strings::StrAppend(&v, "}");  // all subdivs
+  if (!locality_groups.empty()) {
+    strings::StrAppend(&v, " locality_groups={");
+    for (const auto& g : locality_groups) {
+      strings::StrAppend(&v, g, ",");
+    }
+    strings::StrAppend(&v, "}");
+  }
+  if (impl_details.bidirectional) {
+    strings::StrAppend(&v, " bidirectional");
+  }
+  if (impl_details.hierarchical) {
+    strings::StrAppend(&v, " hierarchical");
+  }
+  if (impl_details.compression != COMPRESSION_NONE) {
+    strings::StrAppend(&v, " compression=", impl_details.compression);
+    if (impl_details.compression == COMPRESSION_TOPK) {
+      strings::StrAppend(&v, " topk_fraction=", impl_details.topk_fraction);
+    }
+  }
   return v;
 }
 
@@ -58,6 +58,18 @@ struct CollGroupParams {
       : group_key(0), group_size(0), device_type(DEVICE_CPU), num_tasks(0) {}
 };
 
+// Lossy compression applied by a collective to the values it exchanges
+// between devices.
+enum CollectiveCompression {
+  COMPRESSION_NONE = 0,
+  // Values are sent as half or bfloat16.
+  COMPRESSION_FP16,
+  COMPRESSION_BF16,
+  // Only the values of largest magnitude are sent, the others being carried
+  // over to the next execution (error feedback).
+  COMPRESSION_TOPK,
+};
+
 // The best implementation of a collective op depends on many factors
 // including the number of devices involved, the topology of
 // interconnects between them and the sizes of inputs.  This structure
@@ -70,8 +82,24 @@ struct CollImplDetails {
   std::vector<std::vector<int>> subdiv_permutations;
   std::vector<int> subdiv_offsets;
   std::vector<int> subdiv_source_rank;  // rank of source in each subdiv
+  // If true, every other subdivision ring runs in the reverse direction, so
+  // that both directions of each link carry data.
+  bool bidirectional = false;
+  // Lossy compression of the values exchanged between devices.
+  CollectiveCompression compression = COMPRESSION_NONE;
+  // With COMPRESSION_TOPK, the fraction of the values of each chunk sent.
+  float topk_fraction = 0.01f;
+  // If true, reductions run as a two-level HierarchicalReduce over the
+  // locality groups of the devices, instead of as a flat RingReduce.
+  bool hierarchical = false;
 };
 
+// Returns the ResourceMgr container in which collective implementations keep
+// state that carries over from one execution of instance `instance_key` to
+// the next on a device, such as the residuals of top-k compression. The op
+// kernel of the instance cleans up the container when it is destroyed.
+string CollectiveInstanceContainer(int32 instance_key);
+
 // Data common to all members of a collective instance.
 struct CollInstanceParams {
   // Identifies all participating graph nodes.
@@ -85,6 +113,10 @@ struct CollInstanceParams {
   std::vector<string> task_names;
   // True if every task has the same number of devices.
   bool same_num_devices_per_task = false;
+  // Locality group of each member, in default rank order: the members on the
+  // same task and NUMA node share a group.  Groups are numbered in order of
+  // first appearance.  Empty if the localities are unknown.
+  std::vector<int> locality_groups;
   CollImplDetails impl_details;
   string ToString() const;
   CollInstanceParams& operator=(const struct CollInstanceParams& other);
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "tensorflow/core/grappler/optimizers/remapper.h"
 
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/versions.pb.h"
 #include "tensorflow/core/grappler/costs/graph_properties.h"
 #include "tensorflow/core/grappler/graph_view.h"
@@ -22,7 +24,9 @@ limitations under the License.
 #include "tensorflow/core/grappler/op_types.h"
 #include "tensorflow/core/grappler/optimizers/constant_folding.h"
 #include "tensorflow/core/grappler/utils.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/device_name_utils.h"
 
 namespace tensorflow {
 namespace grappler {
@@ -165,16 +169,252 @@ void AddBatchNormNodes(GraphDef* optimized_graph, const NodeDef& fused_node) {
   *r->add_input() = c->name();
 }
 
+namespace {
+
+// Returns the combiner of the FusedEmbeddingSparseSegmentReduction computing
+// the sparse segment reduction `node`, or nullptr if `node` is not one.
+const char* SparseSegmentCombiner(const NodeDef& node) {
+  if (node.op() == "SparseSegmentSum") return "sum";
+  if (node.op() == "SparseSegmentMean") return "mean";
+  if (node.op() == "SparseSegmentSqrtN") return "sqrtn";
+  return nullptr;
+}
+
+bool IsOnCpu(const NodeDef& node) {
+  string task;
+  string device;
+  return DeviceNameUtils::SplitDeviceName(node.device(), &task, &device) &&
+         str_util::StrContains(device, DEVICE_CPU);
+}
+
+// Returns true if `prop` is known to be a scalar equal to 0.
+bool IsConstantZero(const OpInfo::TensorProperties& prop) {
+  Tensor value;
+  if (!prop.has_value() || !value.FromProto(prop.value()) ||
+      value.NumElements() != 1) {
+    return false;
+  }
+  if (value.dtype() == DT_INT32) return value.flat<int32>()(0) == 0;
+  if (value.dtype() == DT_INT64) return value.flat<int64>()(0) == 0;
+  return false;
+}
+
+// Embedding lookups gather the rows of the ids from an embedding table, and
+// combine them with a sparse segment reduction.  If the gathered rows are not
+// used otherwise, both are replaced by a FusedEmbeddingSparseSegmentReduction,
+// which reads the rows of the table directly into its output instead of
+// materializing them.  The rows may also be read by Shape ops, as in the
+// gradients of the reductions, which are then computed from the ids and the
+// table and added to `gather_shapes`.  Returns the gather to fuse into `node`,
+// or nullptr.
+const NodeDef* FusibleEmbeddingGather(
+    const GraphView& graph, const std::unordered_set<string>& nodes_to_preserve,
+    GraphProperties* properties, bool* inferred_properties, const NodeDef& node,
+    std::vector<const NodeDef*>* gather_shapes) {
+  if (SparseSegmentCombiner(node) == nullptr || !IsOnCpu(node)) return nullptr;
+  const DataType type = GetDataTypeFromAttr(node, "T");
+  if (type != DT_FLOAT && type != DT_DOUBLE) return nullptr;
+
+  const GraphView::OutputPort data =
+      graph.GetRegularFanin(GraphView::InputPort(&node, 0));
+  const NodeDef* gather = data.node;
+  if (gather == nullptr || data.port_id != 0) return nullptr;
+  if (gather->op() != "Gather" && gather->op() != "GatherV2" &&
+      gather->op() != "ResourceGather") {
+    return nullptr;
+  }
+  if (gather->device() != node.device() ||
+      nodes_to_preserve.count(gather->name()) > 0) {
+    return nullptr;
+  }
+  std::vector<const NodeDef*> shapes;
+  for (const GraphView::Edge& edge : graph.GetFanoutEdges(*gather, true)) {
+    if (edge.tgt.node == &node && edge.tgt.port_id == 0) continue;
+    if (edge.src.port_id != 0 || edge.tgt.port_id != 0 ||
+        !IsShape(*edge.tgt.node)) {
+      return nullptr;
+    }
+    shapes.push_back(edge.tgt.node);
+  }
+
+  if (!*inferred_properties) {
+    // Infer properties lazily in case they are not needed.
+    if (!properties->InferStatically(false).ok()) return nullptr;
+    *inferred_properties = true;
+  }
+  const auto& props = properties->GetInputProperties(gather->name());
+  if (props.size() < 2) return nullptr;
+  // The fused op only takes a vector of ids.
+  const TensorShapeProto& ids_shape = props[1].shape();
+  if (ids_shape.unknown_rank() || ids_shape.dim_size() != 1) return nullptr;
+  if (gather->op() == "GatherV2" &&
+      (props.size() < 3 || !IsConstantZero(props[2]))) {
+    return nullptr;
+  }
+  gather_shapes->insert(gather_shapes->end(), shapes.begin(), shapes.end());
+  return gather;
+}
+
+void AddFusedEmbeddingNode(GraphDef* optimized_graph, const NodeDef& gather,
+                           const NodeDef& node) {
+  NodeDef* fused = optimized_graph->add_node();
+  fused->set_name(node.name());
+  fused->set_device(node.device());
+  const bool is_resource = gather.op() == "ResourceGather";
+  fused->set_op(is_resource ? "ResourceFusedEmbeddingSparseSegmentReduction"
+                            : "FusedEmbeddingSparseSegmentReduction");
+  *fused->add_input() = gather.input(0);
+  *fused->add_input() = gather.input(1);
+  *fused->add_input() = node.input(1);
+  *fused->add_input() = node.input(2);
+  for (const NodeDef* n : {&gather, &node}) {
+    for (const string& input : n->input()) {
+      if (IsControlInput(input)) *fused->add_input() = input;
+    }
+  }
+
+  auto* attr = fused->mutable_attr();
+  (*attr)["combiner"].set_s(SparseSegmentCombiner(node));
+  (*attr)[is_resource ? "dtype" : "T"].set_type(
+      GetDataTypeFromAttr(node, "T"));
+  (*attr)["Tids"].set_type(GetDataTypeFromAttr(gather, "Tindices"));
+  (*attr)["Tidx"].set_type(node.attr().count("Tidx")
+                               ? node.attr().at("Tidx").type()
+                               : DT_INT32);
+}
+
+// Adds a Const node holding `value`, with a control dependency on
+// `control_input` to place it in the same frame.
+NodeDef* AddConstNode(GraphDef* optimized_graph, const string& name,
+                      Tensor value, const string& device,
+                      const string& control_input) {
+  NodeDef* node = optimized_graph->add_node();
+  TF_CHECK_OK(ConstantFolding::CreateNodeDef(name, &value, node));
+  node->set_device(device);
+  *node->add_input() = control_input;
+  return node;
+}
+
+// Replaces `shape`, the Shape of the rows gathered by `gather`, with the
+// concatenation of the shape of the ids and of the shape of a row of the
+// table, since the gather is fused away.
+void AddGatherShapeNodes(GraphDef* optimized_graph, const NodeDef& gather,
+                         const NodeDef& shape) {
+  const string& table = gather.input(0);
+  const string& ids = gather.input(1);
+  const DataType out_type = shape.attr().count("out_type")
+                                ? shape.attr().at("out_type").type()
+                                : DT_INT32;
+  const string ids_control = AsControlDependency(NodeName(ids));
+
+  NodeDef* ids_shape = optimized_graph->add_node();
+  ids_shape->set_name(AddPrefixToNodeName("IdsShape", shape.name()));
+  ids_shape->set_op("Shape");
+  ids_shape->set_device(shape.device());
+  *ids_shape->add_input() = ids;
+  (*ids_shape->mutable_attr())["T"].set_type(
+      GetDataTypeFromAttr(gather, "Tindices"));
+  (*ids_shape->mutable_attr())["out_type"].set_type(out_type);
+
+  NodeDef* table_shape = optimized_graph->add_node();
+  table_shape->set_name(AddPrefixToNodeName("TableShape", shape.name()));
+  // Resource variables are read on their device, where the gather ran.
+  table_shape->set_device(gather.device());
+  *table_shape->add_input() = table;
+  if (gather.op() == "ResourceGather") {
+    table_shape->set_op("VariableShape");
+  } else {
+    table_shape->set_op("Shape");
+    (*table_shape->mutable_attr())["T"].set_type(
+        GetDataTypeFromAttr(gather, "Tparams"));
+  }
+  (*table_shape->mutable_attr())["out_type"].set_type(out_type);
+
+  // The shape of a row is table_shape[1:].
+  Tensor row_begin(DT_INT32, TensorShape({1}));
+  row_begin.flat<int32>()(0) = 1;
+  Tensor row_size(DT_INT32, TensorShape({1}));
+  row_size.flat<int32>()(0) = -1;
+  Tensor axis(DT_INT32, TensorShape());
+  axis.scalar<int32>()() = 0;
+  const NodeDef* row_begin_node = AddConstNode(
+      optimized_graph, AddPrefixToNodeName("RowBegin", shape.name()), row_begin,
+      shape.device(), ids_control);
+  const NodeDef* row_size_node = AddConstNode(
+      optimized_graph, AddPrefixToNodeName("RowSize", shape.name()), row_size,
+      shape.device(), ids_control);
+  const NodeDef* axis_node = AddConstNode(
+      optimized_graph, AddPrefixToNodeName("Axis", shape.name()), axis,
+      shape.device(), ids_control);
+
+  NodeDef* row_shape = optimized_graph->add_node();
+  row_shape->set_name(AddPrefixToNodeName("RowShape", shape.name()));
+  row_shape->set_op("Slice");
+  row_shape->set_device(shape.device());
+  *row_shape->add_input() = table_shape->name();
+  *row_shape->add_input() = row_begin_node->name();
+  *row_shape->add_input() = row_size_node->name();
+  (*row_shape->mutable_attr())["T"].set_type(out_type);
+  (*row_shape->mutable_attr())["Index"].set_type(DT_INT32);
+
+  NodeDef* concat = optimized_graph->add_node();
+  concat->set_name(shape.name());
+  concat->set_op("ConcatV2");
+  concat->set_device(shape.device());
+  *concat->add_input() = ids_shape->name();
+  *concat->add_input() = row_shape->name();
+  *concat->add_input() = axis_node->name();
+  for (const string& input : shape.input()) {
+    if (IsControlInput(input)) *concat->add_input() = input;
+  }
+  (*concat->mutable_attr())["N"].set_i(2);
+  (*concat->mutable_attr())["T"].set_type(out_type);
+  (*concat->mutable_attr())["Tidx"].set_type(DT_INT32);
+}
+
+}  // namespace
+
 Status Remapper::Optimize(Cluster* /*cluster*/, const GrapplerItem& item,
                           GraphDef* optimized_graph) {
   GraphProperties properties(item);
   bool inferred_properties = false;
   GraphView graph(const_cast<GraphDef*>(&item.graph));
 
+  const std::unordered_set<string> nodes_to_preserve = item.NodesToPreserve();
+  std::unordered_map<string, const NodeDef*> embedding_gathers;
+  std::unordered_set<string> fused_gathers;
+  // Shapes of fused gathers, mapped to the gathers.
+  std::unordered_map<string, const NodeDef*> gather_shapes;
+  for (const NodeDef& node : item.graph.node()) {
+    std::vector<const NodeDef*> shapes;
+    const NodeDef* gather =
+        FusibleEmbeddingGather(graph, nodes_to_preserve, &properties,
+                               &inferred_properties, node, &shapes);
+    if (gather != nullptr) {
+      embedding_gathers[node.name()] = gather;
+      fused_gathers.insert(gather->name());
+      for (const NodeDef* shape : shapes) {
+        gather_shapes[shape->name()] = gather;
+      }
+    }
+  }
+
   // During inference, most of the inputs to FusedBatchNorm are constant, and we
   // can therefore replace the op with a much cheaper set of primitives.
   optimized_graph->mutable_node()->Reserve(item.graph.node_size());
   for (const NodeDef& node : item.graph.node()) {
+    if (fused_gathers.count(node.name()) > 0) continue;
+    auto gather_shape = gather_shapes.find(node.name());
+    if (gather_shape != gather_shapes.end()) {
+      AddGatherShapeNodes(optimized_graph, *gather_shape->second, node);
+      continue;
+    }
+    auto embedding_gather = embedding_gathers.find(node.name());
+    if (embedding_gather != embedding_gathers.end()) {
+      VLOG(1) << "Fusing embedding lookup " << node.name();
+      AddFusedEmbeddingNode(optimized_graph, *embedding_gather->second, node);
+      continue;
+    }
     if (node.op() == "FusedBatchNorm" || node.op() == "FusedBatchNormV2") {
       bool optimizable = (node.attr().count("T") == 0 ||
                           node.attr().at("T").type() == DT_FLOAT);
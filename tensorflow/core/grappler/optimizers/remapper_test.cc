@@ -91,5 +91,137 @@ TEST_F(RemapperTest, FusedBatchNormNCHW) {
   }
 }
 
+TEST_F(RemapperTest, FuseEmbeddingLookup) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice(
+      "/job:localhost/replica:0/task:0/device:CPU:0");
+  Output params = ops::Const(s.WithOpName("params"),
+                             {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f}, {3, 2});
+  Output ids = ops::Const(s.WithOpName("ids"), {2, 0}, {2});
+  Output indices = ops::Const(s.WithOpName("indices"), {0, 1, 0}, {3});
+  Output segment_ids = ops::Const(s.WithOpName("segment_ids"), {0, 0, 2}, {3});
+  Output axis = ops::Const(s.WithOpName("axis"), 0);
+  Output gather = ops::GatherV2(s.WithOpName("gather"), params, ids, axis);
+  Output mean = ops::SparseSegmentMean(s.WithOpName("mean"), gather, indices,
+                                       segment_ids);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"mean"};
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("gather", node.name());
+    if (node.name() == "mean") {
+      EXPECT_EQ("FusedEmbeddingSparseSegmentReduction", node.op());
+      ASSERT_EQ(4, node.input_size());
+      EXPECT_EQ("params", node.input(0));
+      EXPECT_EQ("ids", node.input(1));
+      EXPECT_EQ("indices", node.input(2));
+      EXPECT_EQ("segment_ids", node.input(3));
+      EXPECT_EQ("mean", node.attr().at("combiner").s());
+      ++found;
+    }
+  }
+  EXPECT_EQ(1, found);
+
+  auto tensors_expected = EvaluateNodes(item.graph, item.fetch);
+  EXPECT_EQ(1, tensors_expected.size());
+  auto tensors = EvaluateNodes(output, item.fetch);
+  EXPECT_EQ(1, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+}
+
+TEST_F(RemapperTest, FuseEmbeddingLookupWithGradient) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice(
+      "/job:localhost/replica:0/task:0/device:CPU:0");
+  Output params = ops::Const(s.WithOpName("params"),
+                             {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f}, {3, 2});
+  Output ids = ops::Placeholder(s.WithOpName("ids"), DT_INT32,
+                                ops::Placeholder::Shape({-1}));
+  Output indices = ops::Const(s.WithOpName("indices"), {0, 1, 2}, {3});
+  Output segment_ids = ops::Const(s.WithOpName("segment_ids"), {0, 0, 1}, {3});
+  Output axis = ops::Const(s.WithOpName("axis"), 0);
+  Output gather = ops::GatherV2(s.WithOpName("gather"), params, ids, axis);
+  Output sum =
+      ops::SparseSegmentSum(s.WithOpName("sum"), gather, indices, segment_ids);
+  // The gradient of the sum with respect to the gathered rows, as built by
+  // _SparseSegmentSumGrad.
+  Output grad = ops::OnesLike(s.WithOpName("grad"), sum);
+  Output shape = ops::Shape(s.WithOpName("shape"), gather);
+  Output input_rows = ops::StridedSlice(
+      s.WithOpName("input_rows"), shape, ops::Const(s, {0}, {1}),
+      ops::Const(s, {1}, {1}), ops::Const(s, {1}, {1}),
+      ops::StridedSlice::ShrinkAxisMask(1));
+  Output gathered_grad = ops::GatherV2(s.WithOpName("gathered_grad"), grad,
+                                       segment_ids, axis);
+  Output data_grad = ops::UnsortedSegmentSum(
+      s.WithOpName("data_grad"), gathered_grad, indices, input_rows);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"sum", "shape", "data_grad"};
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  int found = 0;
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE("gather", node.name());
+    if (node.name() == "sum") {
+      EXPECT_EQ("FusedEmbeddingSparseSegmentReduction", node.op());
+      ++found;
+    }
+    if (node.name() == "shape") {
+      EXPECT_EQ("ConcatV2", node.op());
+      ++found;
+    }
+  }
+  EXPECT_EQ(2, found);
+
+  Tensor ids_t = test::AsTensor<int32>({2, 0, 1});
+  auto tensors_expected =
+      EvaluateNodes(item.graph, item.fetch, {{"ids", ids_t}});
+  EXPECT_EQ(3, tensors_expected.size());
+  auto tensors = EvaluateNodes(output, item.fetch, {{"ids", ids_t}});
+  EXPECT_EQ(3, tensors.size());
+  test::ExpectTensorNear<float>(tensors_expected[0], tensors[0], 1e-6);
+  test::ExpectTensorEqual<int32>(tensors_expected[1], tensors[1]);
+  test::ExpectTensorNear<float>(tensors_expected[2], tensors[2], 1e-6);
+}
+
+TEST_F(RemapperTest, DontFuseEmbeddingLookupWithOtherConsumers) {
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope().WithDevice(
+      "/job:localhost/replica:0/task:0/device:CPU:0");
+  Output params = ops::Const(s.WithOpName("params"),
+                             {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f}, {3, 2});
+  Output ids = ops::Const(s.WithOpName("ids"), {2, 0}, {2});
+  Output indices = ops::Const(s.WithOpName("indices"), {0, 1}, {2});
+  Output segment_ids = ops::Const(s.WithOpName("segment_ids"), {0, 0}, {2});
+  Output axis = ops::Const(s.WithOpName("axis"), 0);
+  Output gather = ops::GatherV2(s.WithOpName("gather"), params, ids, axis);
+  Output sum =
+      ops::SparseSegmentSum(s.WithOpName("sum"), gather, indices, segment_ids);
+  Output square = ops::Square(s.WithOpName("square"), gather);
+
+  GrapplerItem item;
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  item.fetch = {"sum", "square"};
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_CHECK_OK(optimizer.Optimize(nullptr, item, &output));
+
+  for (const NodeDef& node : output.node()) {
+    if (node.name() == "sum") {
+      EXPECT_EQ("SparseSegmentSum", node.op());
+    }
+  }
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/batching_util/batch_input_buffer.h"
 #include "tensorflow/core/kernels/batching_util/periodic_function.h"
 #include "tensorflow/core/kernels/batching_util/shared_batch_scheduler.h"
 #include "tensorflow/core/kernels/concat_lib.h"
@@ -27,7 +28,9 @@ limitations under the License.
 #include "tensorflow/core/kernels/split_lib.h"
 #include "tensorflow/core/lib/gtl/cleanup.h"
 #include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
 
 namespace tensorflow {
 
@@ -212,6 +215,23 @@ class BatchResource : public ResourceBase {
                        const std::vector<int32>& allowed_batch_sizes,
                        FunctionLibraryRuntime::Handle fhandle,
                        std::unique_ptr<BatchResource>* resource) {
+    return Create(num_batch_threads, max_batch_size, batch_timeout_micros,
+                  max_enqueued_batches, allowed_batch_sizes, fhandle,
+                  /*enable_ragged_batching=*/false,
+                  /*ragged_length_buckets=*/{}, resource);
+  }
+
+  // As above. If 'enable_ragged_batching' is true, each invocation supplies
+  // one variable-length row rather than a slice of the batch; see
+  // ConcatInputTensors(). Rows are queued by length, in one queue per entry
+  // of 'ragged_length_buckets' plus one for longer rows.
+  static Status Create(int32 num_batch_threads, int32 max_batch_size,
+                       int32 batch_timeout_micros, int32 max_enqueued_batches,
+                       const std::vector<int32>& allowed_batch_sizes,
+                       FunctionLibraryRuntime::Handle fhandle,
+                       bool enable_ragged_batching,
+                       const std::vector<int32>& ragged_length_buckets,
+                       std::unique_ptr<BatchResource>* resource) {
     std::unique_ptr<BatchResource> new_resource(new BatchResource);
 
     Batcher::Options batcher_options;
@@ -229,6 +249,9 @@ class BatchResource : public ResourceBase {
 
     new_resource->fhandle_ = fhandle;
 
+    new_resource->enable_ragged_batching_ = enable_ragged_batching;
+    new_resource->ragged_length_buckets_ = ragged_length_buckets;
+
     *resource = std::move(new_resource);
     return Status::OK();
   }
@@ -269,9 +292,31 @@ class BatchResource : public ResourceBase {
     batch_components->context = context;
     batch_components->done_callback = std::move(done_callback);
 
+    string queue_name = batcher_queue_name;
+    if (enable_ragged_batching_) {
+      const int64 length = batch_components->num_values();
+      if (length == 0) {
+        return errors::InvalidArgument(
+            "Ragged batching input tensors must have a non-empty 0th "
+            "dimension");
+      }
+      batch_components->ragged = true;
+      // Queueing rows of similar length together keeps the rows of a batch
+      // balanced, for functions whose cost depends on the longest row.
+      if (!ragged_length_buckets_.empty()) {
+        const int bucket =
+            std::lower_bound(ragged_length_buckets_.begin(),
+                             ragged_length_buckets_.end(), length) -
+            ragged_length_buckets_.begin();
+        strings::StrAppend(&queue_name, "/ragged_bucket_", bucket);
+      }
+    } else {
+      TF_RETURN_IF_ERROR(
+          CopyToBatchBuffer(queue_name, context, batch_components.get()));
+    }
+
     BatcherQueue* batcher_queue;
-    TF_RETURN_IF_ERROR(
-        LookupOrCreateBatcherQueue(batcher_queue_name, &batcher_queue));
+    TF_RETURN_IF_ERROR(LookupOrCreateBatcherQueue(queue_name, &batcher_queue));
     return batcher_queue->Schedule(&batch_components);
   }
 
@@ -288,7 +333,23 @@ class BatchResource : public ResourceBase {
     OpKernelContext* context;
     AsyncOpKernel::DoneCallback done_callback;
 
-    size_t size() const override { return inputs[0].shape().dim_size(0); }
+    // Whether 'inputs' hold a single ragged row, whose length is their 0th
+    // dimension size.
+    bool ragged = false;
+
+    // If not null, the batch buffer with rows reserved for a copy of
+    // 'inputs', from row 'buffer_offset' on. The copy is deferred, until the
+    // batch is processed, for the first task of the buffer: that way a task
+    // alone in its batch is never copied.
+    std::shared_ptr<serving::BatchInputBuffer> buffer;
+    int64 buffer_offset = 0;
+    bool copied_to_buffer = false;
+
+    // The 0th dimension size of the tensors this task contributes to the
+    // batched inputs.
+    int64 num_values() const { return inputs[0].shape().dim_size(0); }
+
+    size_t size() const override { return ragged ? 1 : num_values(); }
   };
 
   using Batcher = serving::SharedBatchScheduler<BatchTask>;
@@ -327,6 +388,101 @@ class BatchResource : public ResourceBase {
     return batch_size;
   }
 
+  // Reserves rows for the inputs of 'task' in the batch buffer of the queue
+  // named 'queue_name', after those of the previous task, unless they don't
+  // fit in it or in the open batch of the queue, in which case they start a
+  // new buffer, allocated from the device of 'context'. Copies the inputs
+  // to the reserved rows, unless they are the first of the buffer. This way
+  // the inputs are copied at most once, mostly by the invoking thread, and the
+  // batch is a slice of the buffer. Leaves alone tasks with inputs that can't
+  // be copied as bytes.
+  Status CopyToBatchBuffer(const string& queue_name, OpKernelContext* context,
+                           BatchTask* task) {
+    for (const Tensor& input : task->inputs) {
+      if (!DataTypeCanUseMemcpy(input.dtype())) {
+        return Status::OK();
+      }
+    }
+    const int64 num_rows = task->size();
+    const int64 max_batch_size = batcher_queue_options_.max_batch_size;
+
+    std::shared_ptr<serving::BatchInputBuffer> buffer;
+    int64 offset = -1;
+    bool first = false;
+    {
+      mutex_lock l(batch_buffers_mu_);
+      std::shared_ptr<serving::BatchInputBuffer>& current =
+          batch_buffers_[queue_name];
+      if (current != nullptr && current->Matches(task->inputs)) {
+        offset = current->Reserve(num_rows, max_batch_size);
+      }
+      if (offset < 0) {
+        if (num_rows == 0 || num_rows > max_batch_size) {
+          return Status::OK();
+        }
+        // Room for the largest padded batch.
+        int64 capacity = max_batch_size;
+        if (!allowed_batch_sizes_.empty()) {
+          capacity = std::max<int64>(capacity, allowed_batch_sizes_.back());
+        }
+        std::unique_ptr<serving::BatchInputBuffer> new_buffer;
+        TF_RETURN_IF_ERROR(serving::BatchInputBuffer::Create(
+            context->device()->GetAllocator(AllocatorAttributes()),
+            task->inputs, capacity, &new_buffer));
+        current = std::move(new_buffer);
+        offset = current->Reserve(num_rows, max_batch_size);
+        first = true;
+      }
+      buffer = current;
+    }
+
+    if (!first) {
+      buffer->CopyIn(task->inputs, offset);
+      task->copied_to_buffer = true;
+    }
+    task->buffer = std::move(buffer);
+    task->buffer_offset = offset;
+    return Status::OK();
+  }
+
+  // If the tasks of 'batch' reserved consecutive rows of a batch buffer, and
+  // the buffer has room for the padding, sets 'batched_inputs' to (zero-copy)
+  // slices of the buffer, padded with copies of the first row, and returns
+  // true. Returns false, without copying it, for a task alone in its batch
+  // that needs no padding, whose inputs can be passed on as they are.
+  bool SliceBatchBuffer(const Batch& batch, int padded_batch_size,
+                        std::vector<Tensor>* batched_inputs) const {
+    const std::shared_ptr<serving::BatchInputBuffer>& buffer =
+        batch.task(0).buffer;
+    if (buffer == nullptr) {
+      return false;
+    }
+    const int64 start = batch.task(0).buffer_offset;
+    int64 end = start;
+    for (int task_idx = 0; task_idx < batch.num_tasks(); ++task_idx) {
+      const BatchTask& task = batch.task(task_idx);
+      if (task.buffer != buffer || task.buffer_offset != end) {
+        return false;
+      }
+      end += task.size();
+    }
+    if (!buffer->CloseBatch(start, end, padded_batch_size)) {
+      return false;
+    }
+    if (batch.num_tasks() == 1 && end - start == padded_batch_size &&
+        !batch.task(0).copied_to_buffer) {
+      return false;
+    }
+    for (int task_idx = 0; task_idx < batch.num_tasks(); ++task_idx) {
+      const BatchTask& task = batch.task(task_idx);
+      if (!task.copied_to_buffer) {
+        buffer->CopyIn(task.inputs, task.buffer_offset);
+      }
+    }
+    *batched_inputs = buffer->Slice(start, end, padded_batch_size);
+    return true;
+  }
+
   Status ConcatInputTensors(const Batch& batch, OpKernelContext* context,
                             std::vector<Tensor>* concatenated_tensors) const {
     if (batch.num_tasks() == 0) {
@@ -340,6 +496,17 @@ class BatchResource : public ResourceBase {
     const int num_inputs = batch.task(0).inputs.size();
     concatenated_tensors->reserve(num_inputs);
 
+    // Ragged tasks don't use batch buffers, so no row splits are needed.
+    if (SliceBatchBuffer(batch, padded_batch_size, concatenated_tensors)) {
+      return Status::OK();
+    }
+
+    if (batch.num_tasks() == 1 && padding_amount == 0) {
+      // A task alone in its batch needs no copy.
+      *concatenated_tensors = batch.task(0).inputs;
+      return AppendRowSplits(batch, context, concatenated_tensors);
+    }
+
     // Process each input one at a time (the typical case has just one).
     for (int i = 0; i < num_inputs; ++i) {
       // Concatenate the tasks ith input tensors into a big output tensor.
@@ -401,6 +568,26 @@ class BatchResource : public ResourceBase {
       TF_RETURN_IF_ERROR(concat_status);
       concatenated_tensors->push_back(concatenated_tensor);
     }
+
+    return AppendRowSplits(batch, context, concatenated_tensors);
+  }
+
+  // Ragged rows are concatenated without padding, so the function also needs
+  // to know where each row starts: appends those offsets to 'batched_inputs'.
+  Status AppendRowSplits(const Batch& batch, OpKernelContext* context,
+                         std::vector<Tensor>* batched_inputs) const {
+    if (enable_ragged_batching_) {
+      Tensor row_splits;
+      TF_RETURN_IF_ERROR(context->allocate_temp(
+          DT_INT64, TensorShape({batch.num_tasks() + 1}), &row_splits));
+      auto row_splits_flat = row_splits.vec<int64>();
+      row_splits_flat(0) = 0;
+      for (int task_idx = 0; task_idx < batch.num_tasks(); ++task_idx) {
+        row_splits_flat(task_idx + 1) =
+            row_splits_flat(task_idx) + batch.task(task_idx).num_values();
+      }
+      batched_inputs->push_back(row_splits);
+    }
     return Status::OK();
   }
 
@@ -417,6 +604,17 @@ class BatchResource : public ResourceBase {
     for (int i = 0; i < batch->num_tasks(); ++i) {
       task_sizes_plus_optional_padding.push_back(batch->task(i).size());
     }
+    // For ragged batches, the number of values of each task, for outputs that
+    // have one entry per value rather than one per row.
+    std::vector<int64> task_num_values;
+    int64 total_num_values = 0;
+    if (enable_ragged_batching_) {
+      task_num_values.reserve(batch->num_tasks());
+      for (int i = 0; i < batch->num_tasks(); ++i) {
+        task_num_values.push_back(batch->task(i).num_values());
+        total_num_values += task_num_values.back();
+      }
+    }
     const int padding_size =
         RoundToLowestAllowedBatchSize(batch->size()) - batch->size();
     if (padding_size > 0) {
@@ -438,26 +636,57 @@ class BatchResource : public ResourceBase {
         return errors::FailedPrecondition(
             "Batched output tensor has 0 dimensions");
       }
-      if (output_tensor.shape().dim_size(0) != batch->size() + padding_size) {
+      const std::vector<int64>* split_sizes = &task_sizes_plus_optional_padding;
+      if (enable_ragged_batching_ &&
+          output_tensor.shape().dim_size(0) != batch->size()) {
+        // Rows have at least one value, so when the number of rows and values
+        // match, the two ways of splitting agree.
+        if (output_tensor.shape().dim_size(0) != total_num_values) {
+          return errors::FailedPrecondition(
+              "Ragged batched output tensor's 0th dimension equals neither "
+              "the number of rows nor the number of values of the batch");
+        }
+        split_sizes = &task_num_values;
+      } else if (output_tensor.shape().dim_size(0) !=
+                 batch->size() + padding_size) {
         return errors::FailedPrecondition(
             "Batched output tensor's 0th dimension does not equal the sum of "
             "the 0th dimension sizes of the input tensors");
       }
 
       std::vector<Tensor> split_tensor;
-      const Status split_status = tensor::Split(
-          output_tensor, task_sizes_plus_optional_padding, &split_tensor);
-      DCHECK(split_status.ok()) << split_status.ToString();
-      if (!split_status.ok()) {
-        return errors::Internal("Tensor split operation failed: ",
-                                split_status.ToString());
+      if (DataTypeCanUseMemcpy(output_tensor.dtype())) {
+        // Hand out slices sharing the batched output's buffer, which each
+        // keep the whole batched output alive. So only tasks with at least
+        // half of its rows get one, so as to keep at most twice the memory
+        // they need, and only aligned ones (which kernels can map as Eigen
+        // tensors): the others get a copy.
+        split_tensor.reserve(split_sizes->size());
+        const int64 num_rows = output_tensor.dim_size(0);
+        int64 position = 0;
+        for (const int64 size : *split_sizes) {
+          Tensor slice = output_tensor.Slice(position, position + size);
+          if (2 * size >= num_rows && slice.IsAligned()) {
+            split_tensor.push_back(slice);
+          } else {
+            split_tensor.push_back(tensor::DeepCopy(slice));
+          }
+          position += size;
+        }
+      } else {
+        const Status split_status =
+            tensor::Split(output_tensor, *split_sizes, &split_tensor);
+        DCHECK(split_status.ok()) << split_status.ToString();
+        if (!split_status.ok()) {
+          return errors::Internal("Tensor split operation failed: ",
+                                  split_status.ToString());
+        }
       }
-      DCHECK_EQ(split_tensor.size(), task_sizes_plus_optional_padding.size());
-      if (split_tensor.size() != task_sizes_plus_optional_padding.size()) {
+      DCHECK_EQ(split_tensor.size(), split_sizes->size());
+      if (split_tensor.size() != split_sizes->size()) {
         return errors::Internal(
             "Tensor split operation did not work as expected; got ",
-            split_tensor.size(), " splits; expected ",
-            task_sizes_plus_optional_padding.size());
+            split_tensor.size(), " splits; expected ", split_sizes->size());
       }
 
       for (int j = 0; j < batch->num_tasks(); ++j) {
@@ -684,8 +913,16 @@ class BatchResource : public ResourceBase {
   std::map<string, std::unique_ptr<BatcherQueue>> batcher_queues_
       GUARDED_BY(batcher_queues_mu_);
 
+  // The batch buffer that inputs are copied to, for each batcher queue.
+  mutex batch_buffers_mu_;
+  std::map<string, std::shared_ptr<serving::BatchInputBuffer>> batch_buffers_
+      GUARDED_BY(batch_buffers_mu_);
+
   std::vector<int32> allowed_batch_sizes_;
   FunctionLibraryRuntime::Handle fhandle_;
+
+  bool enable_ragged_batching_ = false;
+  std::vector<int32> ragged_length_buckets_;
 };
 
 class BatchFunctionKernel : public AsyncOpKernel {
@@ -707,6 +944,11 @@ class BatchFunctionKernel : public AsyncOpKernel {
                    c->GetAttr("max_enqueued_batches", &max_enqueued_batches_));
     OP_REQUIRES_OK(c, c->GetAttr("allowed_batch_sizes", &allowed_batch_sizes_));
     OP_REQUIRES_OK(c, ValidateAllowedBatchSizes());
+    OP_REQUIRES_OK(
+        c, c->GetAttr("enable_ragged_batching", &enable_ragged_batching_));
+    OP_REQUIRES_OK(
+        c, c->GetAttr("ragged_length_buckets", &ragged_length_buckets_));
+    OP_REQUIRES_OK(c, ValidateRaggedBatching());
 
     auto lib = c->function_library();
     OP_REQUIRES(c, lib != nullptr, errors::Internal("No function library"));
@@ -726,7 +968,9 @@ class BatchFunctionKernel : public AsyncOpKernel {
       TF_RETURN_IF_ERROR(
           BatchResource::Create(num_batch_threads_, max_batch_size_,
                                 batch_timeout_micros_, max_enqueued_batches_,
-                                allowed_batch_sizes_, fhandle_, &new_resource));
+                                allowed_batch_sizes_, fhandle_,
+                                enable_ragged_batching_, ragged_length_buckets_,
+                                &new_resource));
       *r = new_resource.release();
       return Status::OK();
     };
@@ -763,6 +1007,32 @@ class BatchFunctionKernel : public AsyncOpKernel {
     return Status::OK();
   }
 
+  // Validates the ragged batching attributes. Ragged batches are never padded,
+  // and 'ragged_length_buckets_' must increase monotonically.
+  Status ValidateRaggedBatching() const {
+    if (!enable_ragged_batching_) {
+      if (!ragged_length_buckets_.empty()) {
+        return errors::InvalidArgument(
+            "ragged_length_buckets requires enable_ragged_batching");
+      }
+      return Status::OK();
+    }
+    if (!allowed_batch_sizes_.empty()) {
+      return errors::InvalidArgument(
+          "allowed_batch_sizes cannot be used with enable_ragged_batching");
+    }
+    int32 last_length = 0;
+    for (const int32 length : ragged_length_buckets_) {
+      if (length <= last_length) {
+        return errors::InvalidArgument(
+            "ragged_length_buckets entries must be positive and monotonically "
+            "increasing");
+      }
+      last_length = length;
+    }
+    return Status::OK();
+  }
+
  private:
   string container_;
   string shared_name_;
@@ -773,6 +1043,8 @@ class BatchFunctionKernel : public AsyncOpKernel {
   int32 max_enqueued_batches_;
   std::vector<int32> allowed_batch_sizes_;
   FunctionLibraryRuntime::Handle fhandle_;
+  bool enable_ragged_batching_;
+  std::vector<int32> ragged_length_buckets_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("BatchFunction").Device(DEVICE_CPU),
@@ -176,6 +176,11 @@ class BasicBatchScheduler : public BatchScheduler<TaskType> {
     // parameter.
     int max_enqueued_batches = 10;
 
+    // If positive, the target 99th percentile latency of tasks, in
+    // microseconds. Batch sizes and timeouts are then tuned while running,
+    // with 'max_batch_size' and 'batch_timeout_micros' as upper bounds.
+    int64 target_p99_latency_micros = 0;
+
     // The following options are typically only overridden by test code.
 
     // The environment to use.
@@ -231,6 +236,8 @@ Status BasicBatchScheduler<TaskType>::Create(
       options.batch_timeout_micros;
   shared_scheduler_queue_options.max_enqueued_batches =
       options.max_enqueued_batches;
+  shared_scheduler_queue_options.target_p99_latency_micros =
+      options.target_p99_latency_micros;
   std::unique_ptr<BatchScheduler<TaskType>> shared_scheduler_queue;
   TF_RETURN_IF_ERROR(shared_scheduler->AddQueue(shared_scheduler_queue_options,
                                                 process_batch_callback,
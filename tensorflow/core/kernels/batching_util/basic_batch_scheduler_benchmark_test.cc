@@ -14,10 +14,16 @@ limitations under the License.
 ==============================================================================*/
 
 // Benchmarks for performance (throughput and latency) of BasicBatchScheduler
-// under various rates of task injection.
+// under various rates of task injection, and of the ways of batching
+// variable-length tasks.
+
+#include <algorithm>
 
 #include "tensorflow/core/kernels/batching_util/basic_batch_scheduler.h"
+#include "tensorflow/core/kernels/batching_util/shared_batch_scheduler.h"
 #include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/init_main.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -387,6 +393,174 @@ BENCHMARK(ThroughputBM_LargeTimeout)
     ->Arg(32)
     ->Arg(64);
 
+// The ways of batching variable-length rows compared by the ragged throughput
+// benchmark.
+enum class RaggedBatchingMode {
+  // Rows are padded to the longest row of their batch.
+  kPadded,
+  // As kPadded, but rows are queued by length, so that batches are made of
+  // rows of similar lengths.
+  kPaddedBucketed,
+  // Rows are concatenated without padding.
+  kRagged,
+};
+
+class RaggedBenchmarkBatchTask : public BatchTask {
+ public:
+  explicit RaggedBenchmarkBatchTask(int length) : length_(length) {}
+
+  RaggedBenchmarkBatchTask(const RaggedBenchmarkBatchTask&) = delete;
+  RaggedBenchmarkBatchTask& operator=(const RaggedBenchmarkBatchTask&) = delete;
+
+  ~RaggedBenchmarkBatchTask() override = default;
+
+  size_t size() const override { return 1; }
+
+  int length() const { return length_; }
+
+ private:
+  // The number of values of the row.
+  const int length_;
+};
+
+// Performs 'cost' units of dummy CPU work.
+void PerformCpuWork(int64 cost) {
+  int dummy = 1;
+  for (int64 i = 0; i < cost; ++i) {
+    dummy += dummy * 2;
+  }
+  CHECK_NE(dummy, 0);
+}
+
+// The state and logic associated with a ragged throughput benchmark, which
+// injects rows of random lengths into a batch scheduler, processes the batches
+// at a fixed cost per value (padding included), and measures the rate at which
+// the values of the rows (padding excluded) get processed.
+class RaggedThroughputBenchmark {
+ public:
+  RaggedThroughputBenchmark(RaggedBatchingMode mode, int num_batch_threads);
+
+  RaggedThroughputBenchmark(const RaggedThroughputBenchmark&) = delete;
+  RaggedThroughputBenchmark& operator=(const RaggedThroughputBenchmark&) =
+      delete;
+
+  // Perform the benchmark run, based on the parameters supplied to the ctor.
+  void RunBenchmark(int iters);
+
+ private:
+  // Processes a batch of tasks. (Invoked by the scheduler on one of its batch
+  // threads.)
+  void ProcessBatch(std::unique_ptr<Batch<RaggedBenchmarkBatchTask>> batch);
+
+  const RaggedBatchingMode mode_;
+  const int num_batch_threads_;
+};
+
+RaggedThroughputBenchmark::RaggedThroughputBenchmark(RaggedBatchingMode mode,
+                                                     int num_batch_threads)
+    : mode_(mode), num_batch_threads_(num_batch_threads) {}
+
+void RaggedThroughputBenchmark::RunBenchmark(int iters) {
+  CHECK_GE(iters, 1);
+
+  testing::StopTiming();
+  const int kNumTasksPerIteration = 10 * 1000;
+  const int kMaxRowLength = 64;
+  // Upper bounds of the row lengths of each queue, in kPaddedBucketed mode.
+  const std::vector<int> kLengthBuckets = {16, 32, 48};
+
+  random::PhiloxRandom philox(testing::RandomSeed());
+  random::SimplePhilox rand(&philox);
+  std::vector<int> lengths(kNumTasksPerIteration);
+  int64 num_values = 0;
+  for (int& length : lengths) {
+    length = 1 + rand.Uniform(kMaxRowLength);
+    num_values += length;
+  }
+
+  SharedBatchScheduler<RaggedBenchmarkBatchTask>::Options options;
+  options.num_batch_threads = num_batch_threads_;
+  std::shared_ptr<SharedBatchScheduler<RaggedBenchmarkBatchTask>> scheduler;
+  TF_CHECK_OK(SharedBatchScheduler<RaggedBenchmarkBatchTask>::Create(
+      options, &scheduler));
+  SharedBatchScheduler<RaggedBenchmarkBatchTask>::QueueOptions queue_options;
+  queue_options.max_batch_size = 32;
+  queue_options.batch_timeout_micros = 1000;
+  queue_options.max_enqueued_batches = INT_MAX;  // Unbounded queue.
+  const int num_queues = mode_ == RaggedBatchingMode::kPaddedBucketed
+                             ? kLengthBuckets.size() + 1
+                             : 1;
+  std::vector<std::unique_ptr<BatchScheduler<RaggedBenchmarkBatchTask>>> queues(
+      num_queues);
+  for (auto& queue : queues) {
+    TF_CHECK_OK(scheduler->AddQueue(
+        queue_options,
+        [this](std::unique_ptr<Batch<RaggedBenchmarkBatchTask>> batch) {
+          ProcessBatch(std::move(batch));
+        },
+        &queue));
+  }
+
+  testing::ItemsProcessed(iters * num_values);
+  testing::UseRealTime();
+  testing::StartTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    for (const int length : lengths) {
+      int queue_index = 0;
+      if (num_queues > 1) {
+        queue_index = std::lower_bound(kLengthBuckets.begin(),
+                                       kLengthBuckets.end(), length) -
+                      kLengthBuckets.begin();
+      }
+      auto task = std::unique_ptr<RaggedBenchmarkBatchTask>(
+          new RaggedBenchmarkBatchTask(length));
+      TF_CHECK_OK(queues[queue_index]->Schedule(&task));
+    }
+  }
+
+  // Wait for the scheduler to process all tasks.
+  queues.clear();
+  testing::StopTiming();
+}
+
+void RaggedThroughputBenchmark::ProcessBatch(
+    std::unique_ptr<Batch<RaggedBenchmarkBatchTask>> batch) {
+  int64 num_values = 0;
+  int max_length = 0;
+  for (int i = 0; i < batch->num_tasks(); ++i) {
+    num_values += batch->task(i).length();
+    max_length = std::max(max_length, batch->task(i).length());
+  }
+  const int64 num_processed_values = mode_ == RaggedBatchingMode::kRagged
+                                         ? num_values
+                                         : batch->num_tasks() * max_length;
+  const int64 kCpuCostPerValue = 1000;
+  PerformCpuWork(num_processed_values * kCpuCostPerValue);
+}
+
+static void RaggedThroughputBM_Padded(int iters, int num_batch_threads) {
+  RaggedThroughputBenchmark benchmark(RaggedBatchingMode::kPadded,
+                                      num_batch_threads);
+  benchmark.RunBenchmark(iters);
+}
+BENCHMARK(RaggedThroughputBM_Padded)->Arg(1)->Arg(4);
+
+static void RaggedThroughputBM_PaddedBucketed(int iters,
+                                              int num_batch_threads) {
+  RaggedThroughputBenchmark benchmark(RaggedBatchingMode::kPaddedBucketed,
+                                      num_batch_threads);
+  benchmark.RunBenchmark(iters);
+}
+BENCHMARK(RaggedThroughputBM_PaddedBucketed)->Arg(1)->Arg(4);
+
+static void RaggedThroughputBM_Ragged(int iters, int num_batch_threads) {
+  RaggedThroughputBenchmark benchmark(RaggedBatchingMode::kRagged,
+                                      num_batch_threads);
+  benchmark.RunBenchmark(iters);
+}
+BENCHMARK(RaggedThroughputBM_Ragged)->Arg(1)->Arg(4);
+
 static void RunLatencyBenchmark(int64 task_injection_interval_micros,
                                 int64 batch_timeout_micros) {
   BasicBatchScheduler<BenchmarkBatchTask>::Options scheduler_options;
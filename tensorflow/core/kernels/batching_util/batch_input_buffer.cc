@@ -0,0 +1,162 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/batching_util/batch_input_buffer.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+
+namespace tensorflow {
+namespace serving {
+
+namespace {
+
+// Returns the data of row 'row' of 'tensor', which has 'num_rows' rows.
+char* RowData(const Tensor& tensor, int64 num_rows, int64 row) {
+  const StringPiece data = tensor.tensor_data();
+  return const_cast<char*>(data.data()) + row * (data.size() / num_rows);
+}
+
+}  // namespace
+
+Status BatchInputBuffer::Create(Allocator* allocator,
+                                const std::vector<Tensor>& inputs,
+                                int64 capacity,
+                                std::unique_ptr<BatchInputBuffer>* buffer) {
+  if (capacity <= 0) {
+    return errors::InvalidArgument("Batch buffer capacity must be positive");
+  }
+  std::unique_ptr<BatchInputBuffer> new_buffer(new BatchInputBuffer);
+  new_buffer->capacity_ = capacity;
+  for (const Tensor& input : inputs) {
+    if (!DataTypeCanUseMemcpy(input.dtype())) {
+      return errors::InvalidArgument("Batch buffers can't hold ",
+                                     DataTypeString(input.dtype()),
+                                     " tensors");
+    }
+    if (input.dims() == 0) {
+      return errors::InvalidArgument(
+          "Batch buffer inputs must have at least one dimension");
+    }
+    TensorShape shape = input.shape();
+    shape.set_dim(0, capacity);
+    Tensor tensor(allocator, input.dtype(), shape);
+    if (!tensor.IsInitialized()) {
+      return errors::ResourceExhausted("OOM when allocating batch buffer of "
+                                       "shape ",
+                                       shape.DebugString());
+    }
+    new_buffer->tensors_.push_back(std::move(tensor));
+  }
+  *buffer = std::move(new_buffer);
+  return Status::OK();
+}
+
+bool BatchInputBuffer::Matches(const std::vector<Tensor>& inputs) const {
+  if (tensors_.size() != inputs.size()) {
+    return false;
+  }
+  for (int i = 0; i < inputs.size(); ++i) {
+    const Tensor& tensor = tensors_[i];
+    const Tensor& input = inputs[i];
+    if (tensor.dtype() != input.dtype() || tensor.dims() != input.dims()) {
+      return false;
+    }
+    for (int d = 1; d < input.dims(); ++d) {
+      if (tensor.dim_size(d) != input.dim_size(d)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+int64 BatchInputBuffer::Reserve(int64 num_rows, int64 max_batch_size) {
+  mutex_lock l(mu_);
+  // SharedBatchScheduler starts a new batch when a task doesn't fit in the
+  // open one, so the task starts a new buffer then too.
+  if (retired_ || num_reserved_rows_ + num_rows > capacity_ ||
+      num_reserved_rows_ - open_batch_start_row_ + num_rows > max_batch_size) {
+    return -1;
+  }
+  const int64 offset = num_reserved_rows_;
+  num_reserved_rows_ += num_rows;
+  return offset;
+}
+
+void BatchInputBuffer::CopyIn(const std::vector<Tensor>& inputs,
+                              int64 offset) {
+  // The reserved rows belong to the caller, so the copy needs no lock.
+  for (int i = 0; i < inputs.size(); ++i) {
+    const StringPiece from = inputs[i].tensor_data();
+    if (!from.empty()) {
+      memcpy(RowData(tensors_[i], capacity_, offset), from.data(),
+             from.size());
+    }
+  }
+}
+
+bool BatchInputBuffer::CloseBatch(int64 start, int64 end, int64 padded_size) {
+  const int64 padded_end = start + padded_size;
+  // Slices must be aligned, for kernels to map them as Eigen tensors.
+  bool can_slice = padded_end <= capacity_;
+  for (int i = 0; can_slice && i < tensors_.size(); ++i) {
+    can_slice = tensors_[i].Slice(start, padded_end).IsAligned();
+  }
+
+  mutex_lock l(mu_);
+  // Later tasks of the queue are in another batch.
+  open_batch_start_row_ = std::max(open_batch_start_row_, end);
+  // If there are none yet, they start a new, aligned, buffer.
+  if (num_reserved_rows_ == end) {
+    retired_ = true;
+  }
+  if (can_slice && padded_end > end) {
+    // The padding rows must not be handed out to later tasks.
+    if (num_reserved_rows_ == end) {
+      num_reserved_rows_ = padded_end;
+    } else {
+      can_slice = false;
+    }
+  }
+  return can_slice;
+}
+
+std::vector<Tensor> BatchInputBuffer::Slice(int64 start, int64 end,
+                                            int64 padded_size) {
+  const int64 padded_end = start + padded_size;
+  std::vector<Tensor> slices;
+  slices.reserve(tensors_.size());
+  for (const Tensor& tensor : tensors_) {
+    if (tensor.NumElements() > 0) {
+      const char* first_row = RowData(tensor, capacity_, start);
+      const size_t row_bytes = tensor.tensor_data().size() / capacity_;
+      for (int64 row = end; row < padded_end; ++row) {
+        memcpy(RowData(tensor, capacity_, row), first_row, row_bytes);
+      }
+    }
+    slices.push_back(tensor.Slice(start, padded_end));
+  }
+  return slices;
+}
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,102 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_BATCH_INPUT_BUFFER_H_
+#define TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_BATCH_INPUT_BUFFER_H_
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace serving {
+
+// A preallocated buffer, with a tensor of 'capacity' rows per input, into
+// which consecutive tasks of a batcher queue copy their inputs as they are
+// enqueued. The batched inputs of a batch of such tasks are then slices of the
+// buffer, rather than a concatenation of their inputs.
+//
+// Rows are handed out in order, and the buffer keeps track of where the open
+// batch of the queue starts, to hand out rows the way SharedBatchScheduler
+// forms batches: a task that would not fit in the open batch, or in the
+// buffer, goes in a new buffer instead.
+//
+// Copying the inputs of a task is left to its owner, who may defer it: rows
+// are reserved, not written, by Reserve().
+//
+// This class is thread-safe.
+class BatchInputBuffer {
+ public:
+  // Allocates a buffer for 'capacity' rows of inputs shaped like 'inputs'
+  // (in all but their 0th dimension), from 'allocator'.
+  static Status Create(Allocator* allocator, const std::vector<Tensor>& inputs,
+                       int64 capacity,
+                       std::unique_ptr<BatchInputBuffer>* buffer);
+
+  int64 capacity() const { return capacity_; }
+
+  // Whether inputs shaped like 'inputs' can go in this buffer.
+  bool Matches(const std::vector<Tensor>& inputs) const;
+
+  // Reserves 'num_rows' rows, following the rows reserved so far, for a task
+  // of the open batch. Returns the first of them, or -1 if they don't fit in
+  // the buffer or would make the open batch larger than 'max_batch_size'.
+  int64 Reserve(int64 num_rows, int64 max_batch_size);
+
+  // Copies 'inputs' to the rows reserved for them from 'offset' on.
+  void CopyIn(const std::vector<Tensor>& inputs, int64 offset);
+
+  // Records that the rows in [start, end) were processed as a batch, so later
+  // tasks are in another batch, and no more of them go in this buffer unless
+  // some already were. Returns whether the batch can be passed on as slices
+  // of the buffer padded to 'padded_size' rows, in which case the padding
+  // rows are reserved for it: the slices must then be taken with Slice(),
+  // once all the rows of the batch are copied in.
+  bool CloseBatch(int64 start, int64 end, int64 padded_size);
+
+  // Returns (zero-copy) slices of the rows in [start, start + padded_size),
+  // having filled the rows from 'end' on with copies of the first.
+  std::vector<Tensor> Slice(int64 start, int64 end, int64 padded_size);
+
+ private:
+  BatchInputBuffer() = default;
+
+  std::vector<Tensor> tensors_;
+  int64 capacity_ = 0;
+
+  mutex mu_;
+  // The number of rows handed out to tasks or to padding, from the first.
+  int64 num_reserved_rows_ GUARDED_BY(mu_) = 0;
+  // The first row of the open batch of the queue, as far as is known:
+  // batches are closed when full, which can be told from the rows handed out,
+  // or on a timeout, which is only known once they are processed.
+  int64 open_batch_start_row_ GUARDED_BY(mu_) = 0;
+  // Whether later tasks should go in a new buffer.
+  bool retired_ GUARDED_BY(mu_) = false;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BatchInputBuffer);
+};
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_BATCH_INPUT_BUFFER_H_
@@ -0,0 +1,173 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/batching_util/batch_input_buffer.h"
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// An allocator that counts the allocations it passes on to the CPU allocator.
+class CountingAllocator : public Allocator {
+ public:
+  string Name() override { return "counting"; }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override {
+    ++num_allocations_;
+    return cpu_allocator()->AllocateRaw(alignment, num_bytes);
+  }
+
+  void DeallocateRaw(void* ptr) override {
+    ++num_deallocations_;
+    cpu_allocator()->DeallocateRaw(ptr);
+  }
+
+  int num_allocations() const { return num_allocations_; }
+  int num_deallocations() const { return num_deallocations_; }
+
+ private:
+  int num_allocations_ = 0;
+  int num_deallocations_ = 0;
+};
+
+// Returns a task input of 'num_rows' rows of 2 floats, the ith of which is
+// {first + i, -(first + i)}.
+Tensor MakeInput(int first, int num_rows) {
+  Tensor input(DT_FLOAT, TensorShape({num_rows, 2}));
+  auto matrix = input.matrix<float>();
+  for (int i = 0; i < num_rows; ++i) {
+    matrix(i, 0) = first + i;
+    matrix(i, 1) = -(first + i);
+  }
+  return input;
+}
+
+TEST(BatchInputBufferTest, ConsecutiveTasksShareOneAllocation) {
+  CountingAllocator allocator;
+  std::unique_ptr<BatchInputBuffer> buffer;
+  TF_ASSERT_OK(BatchInputBuffer::Create(
+      &allocator, {MakeInput(0, 1), test::AsTensor<int32>({1})}, 8, &buffer));
+  EXPECT_EQ(8, buffer->capacity());
+  EXPECT_EQ(2, allocator.num_allocations());
+
+  EXPECT_EQ(0, buffer->Reserve(2, 8));
+  EXPECT_EQ(2, buffer->Reserve(3, 8));
+  EXPECT_EQ(5, buffer->Reserve(3, 8));
+  EXPECT_EQ(2, allocator.num_allocations());
+  buffer.reset();
+  EXPECT_EQ(2, allocator.num_deallocations());
+}
+
+TEST(BatchInputBufferTest, Matches) {
+  std::unique_ptr<BatchInputBuffer> buffer;
+  TF_ASSERT_OK(
+      BatchInputBuffer::Create(cpu_allocator(), {MakeInput(0, 1)}, 4, &buffer));
+  EXPECT_TRUE(buffer->Matches({MakeInput(0, 3)}));
+  EXPECT_FALSE(buffer->Matches({MakeInput(0, 3), MakeInput(0, 3)}));
+  EXPECT_FALSE(buffer->Matches({Tensor(DT_FLOAT, TensorShape({3, 4}))}));
+  EXPECT_FALSE(buffer->Matches({Tensor(DT_INT32, TensorShape({3, 2}))}));
+}
+
+TEST(BatchInputBufferTest, RejectsTensorsThatCantBeCopied) {
+  std::unique_ptr<BatchInputBuffer> buffer;
+  EXPECT_FALSE(BatchInputBuffer::Create(
+                   cpu_allocator(), {test::AsTensor<string>({"a"})}, 4, &buffer)
+                   .ok());
+  EXPECT_FALSE(
+      BatchInputBuffer::Create(cpu_allocator(), {MakeInput(0, 1)}, 0, &buffer)
+          .ok());
+}
+
+TEST(BatchInputBufferTest, ReservesRowsOfTheOpenBatch) {
+  std::unique_ptr<BatchInputBuffer> buffer;
+  TF_ASSERT_OK(
+      BatchInputBuffer::Create(cpu_allocator(), {MakeInput(0, 1)}, 8, &buffer));
+  EXPECT_EQ(0, buffer->Reserve(3, 4));
+  // Would not fit in the open batch.
+  EXPECT_EQ(-1, buffer->Reserve(2, 4));
+  EXPECT_EQ(3, buffer->Reserve(1, 4));
+  // The batch was closed by a timeout before the last task joined it.
+  EXPECT_FALSE(buffer->CloseBatch(0, 3, 4));
+  EXPECT_EQ(4, buffer->Reserve(3, 4));
+  // Would not fit in the buffer.
+  EXPECT_EQ(-1, buffer->Reserve(2, 4));
+}
+
+TEST(BatchInputBufferTest, ClosingTheLastBatchRetiresTheBuffer) {
+  std::unique_ptr<BatchInputBuffer> buffer;
+  TF_ASSERT_OK(
+      BatchInputBuffer::Create(cpu_allocator(), {MakeInput(0, 1)}, 8, &buffer));
+  EXPECT_EQ(0, buffer->Reserve(2, 4));
+  EXPECT_TRUE(buffer->CloseBatch(0, 2, 2));
+  EXPECT_EQ(-1, buffer->Reserve(1, 4));
+}
+
+TEST(BatchInputBufferTest, SlicesAndPads) {
+  std::unique_ptr<BatchInputBuffer> buffer;
+  TF_ASSERT_OK(
+      BatchInputBuffer::Create(cpu_allocator(), {MakeInput(0, 1)}, 8, &buffer));
+  const Tensor first = MakeInput(1, 2);
+  const Tensor second = MakeInput(3, 1);
+  EXPECT_EQ(0, buffer->Reserve(2, 8));
+  EXPECT_EQ(2, buffer->Reserve(1, 8));
+  buffer->CopyIn({second}, 2);
+  buffer->CopyIn({first}, 0);
+
+  ASSERT_TRUE(buffer->CloseBatch(0, 3, 4));
+  const std::vector<Tensor> slices = buffer->Slice(0, 3, 4);
+  ASSERT_EQ(1, slices.size());
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({1, -1, 2, -2, 3, -3, 1, -1}, {4, 2}), slices[0]);
+  // Later tasks go in a new buffer.
+  EXPECT_EQ(-1, buffer->Reserve(1, 8));
+}
+
+TEST(BatchInputBufferTest, SlicesShareTheBuffer) {
+  CountingAllocator allocator;
+  std::unique_ptr<BatchInputBuffer> buffer;
+  TF_ASSERT_OK(
+      BatchInputBuffer::Create(&allocator, {MakeInput(0, 1)}, 4, &buffer));
+  EXPECT_EQ(0, buffer->Reserve(4, 4));
+  buffer->CopyIn({MakeInput(5, 4)}, 0);
+  ASSERT_TRUE(buffer->CloseBatch(0, 4, 4));
+  std::vector<Tensor> slices = buffer->Slice(0, 4, 4);
+  ASSERT_EQ(1, slices.size());
+  EXPECT_TRUE(slices[0].IsAligned());
+
+  buffer.reset();
+  EXPECT_EQ(0, allocator.num_deallocations());
+  test::ExpectTensorEqual<float>(MakeInput(5, 4), slices[0]);
+  slices.clear();
+  EXPECT_EQ(1, allocator.num_deallocations());
+  EXPECT_EQ(1, allocator.num_allocations());
+}
+
+TEST(BatchInputBufferTest, DoesNotSliceUnalignedBatches) {
+  std::unique_ptr<BatchInputBuffer> buffer;
+  // Rows of 3 floats, so the second row isn't aligned.
+  TF_ASSERT_OK(BatchInputBuffer::Create(
+      cpu_allocator(), {Tensor(DT_FLOAT, TensorShape({1, 3}))}, 4, &buffer));
+  EXPECT_EQ(0, buffer->Reserve(1, 4));
+  EXPECT_EQ(1, buffer->Reserve(1, 4));
+  EXPECT_FALSE(buffer->CloseBatch(1, 2, 2));
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
@@ -27,6 +27,7 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/batching_util/batch_scheduler.h"
 #include "tensorflow/core/kernels/batching_util/periodic_function.h"
+#include "tensorflow/core/kernels/batching_util/slo_batching_policy.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/strings/strcat.h"
@@ -158,6 +159,13 @@ class SharedBatchScheduler
     // See the class documentation above for guidelines on how to tune this
     // parameter.
     size_t max_enqueued_batches = 10;
+
+    // If positive, the target 99th percentile latency of the tasks of the
+    // queue, in microseconds, from being enqueued to being processed. The
+    // queue then tunes the size and timeout of its batches while running, to
+    // maximize throughput within that target: 'max_batch_size' and
+    // 'batch_timeout_micros' become upper bounds. See SloBatchingPolicy.
+    int64 target_p99_latency_micros = 0;
   };
   Status AddQueue(const QueueOptions& options,
                   std::function<void(std::unique_ptr<Batch<TaskType>>)>
@@ -255,11 +263,14 @@ class Queue {
   // Called by a thread that is ready to process a batch, to request one from
   // this queue. Either returns a batch that is ready to be processed, or
   // nullptr if the queue declines to schedule a batch at this time. If it
-  // returns a batch, the batch is guaranteed to be closed.
-  std::unique_ptr<Batch<TaskType>> ScheduleBatch();
+  // returns a batch, the batch is guaranteed to be closed, and
+  // 'start_time_micros' is set to the time at which its first task was added.
+  std::unique_ptr<Batch<TaskType>> ScheduleBatch(uint64* start_time_micros);
 
-  // Processes a batch that has been returned earlier by ScheduleBatch().
-  void ProcessBatch(std::unique_ptr<Batch<TaskType>> batch);
+  // Processes a batch that has been returned earlier by ScheduleBatch(),
+  // together with the start time returned along with it.
+  void ProcessBatch(std::unique_ptr<Batch<TaskType>> batch,
+                    uint64 start_time_micros);
 
   // Determines whether the queue is empty, i.e. has no tasks waiting or being
   // processed.
@@ -285,6 +296,16 @@ class Queue {
   // currently schedulable.
   bool IsOpenBatchSchedulable() const EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  // The batch size and timeout currently in effect: those picked by
+  // 'slo_policy_' if there is one, the ones from 'options_' otherwise.
+  size_t batch_size_limit() const EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return slo_policy_ ? slo_policy_->batch_size() : options_.max_batch_size;
+  }
+  int64 batch_timeout_micros() const EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    return slo_policy_ ? slo_policy_->batch_timeout_micros()
+                       : options_.batch_timeout_micros;
+  }
+
   const typename SharedBatchScheduler<TaskType>::QueueOptions options_;
 
   // The environment to use.
@@ -312,6 +333,15 @@ class Queue {
   // in 'batches_'. Valid iff that batch contains at least one task.
   uint64 open_batch_start_time_micros_ GUARDED_BY(mu_);
 
+  // Tunes the batch size and timeout if the queue has a latency target, and
+  // is null otherwise.
+  std::unique_ptr<SloBatchingPolicy> slo_policy_ GUARDED_BY(mu_);
+
+  // If 'slo_policy_' is set, the times at which the first task was added to
+  // each of the closed batches in 'batches_' (front to back). ScheduleBatch()
+  // hands the time over along with the batch.
+  std::deque<uint64> closed_batch_start_times_micros_ GUARDED_BY(mu_);
+
   // Whether this queue contains a batch that is eligible to be scheduled. Used
   // to keep track of when to call 'schedulable_batch_callback_'.
   bool schedulable_batch_ GUARDED_BY(mu_) = false;
@@ -408,6 +438,11 @@ Status SharedBatchScheduler<TaskType>::AddQueue(
         "max_enqueued_batches must be non-negative; was ",
         options.max_enqueued_batches);
   }
+  if (options.target_p99_latency_micros < 0) {
+    return errors::InvalidArgument(
+        "target_p99_latency_micros must be non-negative; was ",
+        options.target_p99_latency_micros);
+  }
 
   auto schedulable_batch_callback = [this] {
     mutex_lock l(mu_);
@@ -452,6 +487,8 @@ void SharedBatchScheduler<TaskType>::ThreadLogic() {
   std::unique_ptr<Batch<TaskType>> batch_to_process;
   // The queue with which 'batch_to_process' is associated.
   internal::Queue<TaskType>* queue_for_batch = nullptr;
+  // The time at which the first task was added to 'batch_to_process'.
+  uint64 batch_start_time_micros = 0;
   {
     mutex_lock l(mu_);
 
@@ -468,7 +505,8 @@ void SharedBatchScheduler<TaskType>::ThreadLogic() {
       const bool queue_closed = (*next_queue_to_schedule_)->closed();
 
       // Ask '*next_queue_to_schedule_' if it wants us to process a batch.
-      batch_to_process = (*next_queue_to_schedule_)->ScheduleBatch();
+      batch_to_process =
+          (*next_queue_to_schedule_)->ScheduleBatch(&batch_start_time_micros);
       if (batch_to_process != nullptr) {
         queue_for_batch = next_queue_to_schedule_->get();
       }
@@ -497,7 +535,8 @@ void SharedBatchScheduler<TaskType>::ThreadLogic() {
     }
   }
 
-  queue_for_batch->ProcessBatch(std::move(batch_to_process));
+  queue_for_batch->ProcessBatch(std::move(batch_to_process),
+                                batch_start_time_micros);
 }
 
 namespace internal {
@@ -513,6 +552,15 @@ Queue<TaskType>::Queue(
       schedulable_batch_callback_(schedulable_batch_callback) {
   // Create an initial, open batch.
   batches_.emplace_back(new Batch<TaskType>);
+
+  if (options.target_p99_latency_micros > 0) {
+    SloBatchingPolicy::Options policy_options;
+    policy_options.target_p99_latency_micros =
+        options.target_p99_latency_micros;
+    policy_options.max_batch_size = options.max_batch_size;
+    policy_options.max_batch_timeout_micros = options.batch_timeout_micros;
+    slo_policy_.reset(new SloBatchingPolicy(policy_options));
+  }
 }
 
 template <typename TaskType>
@@ -538,7 +586,8 @@ Status Queue<TaskType>::Schedule(std::unique_ptr<TaskType>* task) {
 
     DCHECK(!closed_);
 
-    if (batches_.back()->size() + (*task)->size() > options_.max_batch_size) {
+    if (!batches_.back()->empty() &&
+        batches_.back()->size() + (*task)->size() > batch_size_limit()) {
       if (batches_.size() >= options_.max_enqueued_batches) {
         return errors::Unavailable(
             "The batch scheduling queue to which this task was submitted is "
@@ -581,14 +630,15 @@ size_t Queue<TaskType>::SchedulingCapacity() const {
   mutex_lock l(mu_);
   const int num_new_batches_schedulable =
       options_.max_enqueued_batches - batches_.size();
+  const size_t batch_size = batch_size_limit();
   const int open_batch_capacity =
-      options_.max_batch_size - batches_.back()->size();
-  return (num_new_batches_schedulable * options_.max_batch_size) +
-         open_batch_capacity;
+      std::max(batch_size, batches_.back()->size()) - batches_.back()->size();
+  return (num_new_batches_schedulable * batch_size) + open_batch_capacity;
 }
 
 template <typename TaskType>
-std::unique_ptr<Batch<TaskType>> Queue<TaskType>::ScheduleBatch() {
+std::unique_ptr<Batch<TaskType>> Queue<TaskType>::ScheduleBatch(
+    uint64* start_time_micros) {
   // The batch to schedule, which we may populate below. (If left as nullptr,
   // that means we are electing not to schedule a batch at this time.)
   std::unique_ptr<Batch<TaskType>> batch_to_schedule;
@@ -606,6 +656,12 @@ std::unique_ptr<Batch<TaskType>> Queue<TaskType>::ScheduleBatch() {
       ++num_batches_being_processed_;
       batch_to_schedule = std::move(batches_.front());
       batches_.pop_front();
+      if (slo_policy_) {
+        *start_time_micros = closed_batch_start_times_micros_.front();
+        closed_batch_start_times_micros_.pop_front();
+      } else {
+        *start_time_micros = 0;
+      }
     } else {
       schedulable_batch_ = false;
     }
@@ -615,11 +671,22 @@ std::unique_ptr<Batch<TaskType>> Queue<TaskType>::ScheduleBatch() {
 }
 
 template <typename TaskType>
-void Queue<TaskType>::ProcessBatch(std::unique_ptr<Batch<TaskType>> batch) {
+void Queue<TaskType>::ProcessBatch(std::unique_ptr<Batch<TaskType>> batch,
+                                   uint64 start_time_micros) {
+  // The callback takes ownership of the batch, so keep what is needed to
+  // record its latency.
+  const size_t batch_size = batch->size();
+  const uint64 processing_start_time_micros = env_->NowMicros();
   process_batch_callback_(std::move(batch));
 
   {
     mutex_lock l(mu_);
+    if (slo_policy_) {
+      const uint64 end_time_micros = env_->NowMicros();
+      slo_policy_->RecordBatch(batch_size,
+                               end_time_micros - processing_start_time_micros,
+                               end_time_micros - start_time_micros);
+    }
     --num_batches_being_processed_;
     if (empty_notification_ != nullptr && IsEmptyInternal()) {
       empty_notification_->Notify();
@@ -659,6 +726,9 @@ template <typename TaskType>
 void Queue<TaskType>::StartNewBatch() {
   batches_.back()->Close();
   batches_.emplace_back(new Batch<TaskType>);
+  if (slo_policy_) {
+    closed_batch_start_times_micros_.push_back(open_batch_start_time_micros_);
+  }
 }
 
 template <typename TaskType>
@@ -667,9 +737,9 @@ bool Queue<TaskType>::IsOpenBatchSchedulable() const {
   if (open_batch->empty()) {
     return false;
   }
-  return closed_ || open_batch->size() >= options_.max_batch_size ||
+  return closed_ || open_batch->size() >= batch_size_limit() ||
          env_->NowMicros() >=
-             open_batch_start_time_micros_ + options_.batch_timeout_micros;
+             open_batch_start_time_micros_ + batch_timeout_micros();
 }
 
 template <typename TaskType>
@@ -591,6 +591,82 @@ TEST(SharedBatchSchedulerTest, QueueDestructorBlocksUntilAllTasksProcessed) {
   stop_teardown.Notify();
 }
 
+TEST(SharedBatchSchedulerTest, InvalidTargetLatency) {
+  std::shared_ptr<SharedBatchScheduler<FakeTask>> scheduler;
+  TF_ASSERT_OK(SharedBatchScheduler<FakeTask>::Create({}, &scheduler));
+  SharedBatchScheduler<FakeTask>::QueueOptions queue_options;
+  queue_options.target_p99_latency_micros = -1;
+  std::unique_ptr<BatchScheduler<FakeTask>> queue;
+  EXPECT_EQ(error::INVALID_ARGUMENT,
+            scheduler
+                ->AddQueue(queue_options,
+                           [](std::unique_ptr<Batch<FakeTask>> batch) {},
+                           &queue)
+                .code());
+}
+
+TEST(SharedBatchSchedulerTest, TargetLatencyStartsWithSmallBatches) {
+  mutex mu;
+  int num_tasks_processed = 0;
+  auto callback = [&mu, &num_tasks_processed](
+                      std::unique_ptr<Batch<FakeTask>> batch) {
+    ASSERT_TRUE(batch->IsClosed());
+    // Without latency measurements, batches hold a single task.
+    EXPECT_EQ(1, batch->num_tasks());
+    mutex_lock l(mu);
+    num_tasks_processed += batch->num_tasks();
+  };
+  {
+    std::shared_ptr<SharedBatchScheduler<FakeTask>> scheduler;
+    TF_ASSERT_OK(SharedBatchScheduler<FakeTask>::Create({}, &scheduler));
+    SharedBatchScheduler<FakeTask>::QueueOptions queue_options;
+    queue_options.max_batch_size = 10;
+    queue_options.batch_timeout_micros = 10 * 1000 * 1000;  // 10 seconds
+    queue_options.max_enqueued_batches = 10;
+    queue_options.target_p99_latency_micros = 1000 * 1000;  // 1 second
+    std::unique_ptr<BatchScheduler<FakeTask>> queue;
+    TF_ASSERT_OK(scheduler->AddQueue(queue_options, callback, &queue));
+    for (int i = 0; i < 5; ++i) {
+      TF_ASSERT_OK(ScheduleTask(1, queue.get()));
+    }
+  }
+  mutex_lock l(mu);
+  EXPECT_EQ(5, num_tasks_processed);
+}
+
+TEST(SharedBatchSchedulerTest, TargetLatencyWithConcurrentBatches) {
+  // Many batch threads finish batches at the same time, and batches freed by
+  // one thread get reused by another while latencies are recorded.
+  mutex mu;
+  int num_tasks_processed = 0;
+  auto callback = [&mu, &num_tasks_processed](
+                      std::unique_ptr<Batch<FakeTask>> batch) {
+    ASSERT_TRUE(batch->IsClosed());
+    const int num_tasks = batch->num_tasks();
+    batch.reset();
+    mutex_lock l(mu);
+    num_tasks_processed += num_tasks;
+  };
+  {
+    std::shared_ptr<SharedBatchScheduler<FakeTask>> scheduler;
+    SharedBatchScheduler<FakeTask>::Options options;
+    options.num_batch_threads = 8;
+    TF_ASSERT_OK(SharedBatchScheduler<FakeTask>::Create(options, &scheduler));
+    SharedBatchScheduler<FakeTask>::QueueOptions queue_options;
+    queue_options.max_batch_size = 4;
+    queue_options.batch_timeout_micros = 100;
+    queue_options.max_enqueued_batches = 2000;
+    queue_options.target_p99_latency_micros = 10 * 1000;  // 10 milliseconds
+    std::unique_ptr<BatchScheduler<FakeTask>> queue;
+    TF_ASSERT_OK(scheduler->AddQueue(queue_options, callback, &queue));
+    for (int i = 0; i < 2000; ++i) {
+      TF_ASSERT_OK(ScheduleTask(1, queue.get()));
+    }
+  }
+  mutex_lock l(mu);
+  EXPECT_EQ(2000, num_tasks_processed);
+}
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
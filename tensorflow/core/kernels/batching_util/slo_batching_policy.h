@@ -0,0 +1,283 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_SLO_BATCHING_POLICY_H_
+#define TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_SLO_BATCHING_POLICY_H_
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace serving {
+
+// Picks the size and timeout of the batches of a queue, so as to maximize
+// throughput while keeping the 99th percentile latency of its tasks (from
+// being enqueued to being processed) under a target.
+//
+// The policy keeps a histogram of batch processing latencies for each range of
+// batch sizes (1, 2, 3-4, 5-8, ...), and picks the size range with the highest
+// throughput whose 99th percentile processing latency fits in the latency
+// budget. The batch timeout gets the remainder of the budget. Size ranges
+// without enough measurements are explored one at a time, from small to large,
+// their latency being extrapolated linearly from the next smaller range.
+//
+// As processing latency is not all there is to task latency (tasks may also
+// wait for a free batch thread), the budget starts as the target and is then
+// adjusted from the measured 99th percentile latency of the oldest task of
+// each batch, over consecutive windows of batches: it shrinks whenever that
+// latency exceeds the target, and grows back slowly otherwise.
+//
+// This class is thread-compatible.
+class SloBatchingPolicy {
+ public:
+  struct Options {
+    // The target 99th percentile latency of tasks, in microseconds.
+    int64 target_p99_latency_micros = 0;
+
+    // The largest batch size and batch timeout the policy may pick.
+    size_t max_batch_size = 1000;
+    int64 max_batch_timeout_micros = 0;
+
+    // The number of measurements after which a latency histogram is renewed,
+    // bounding the memory of the policy so that it tracks changes in load.
+    int64 window_size = 1000;
+
+    // The number of measurements needed before a latency histogram is used.
+    int64 min_samples = 20;
+
+    // The number of batches over which task latency is measured for each
+    // adjustment of the latency budget.
+    int64 budget_adjustment_window = 100;
+  };
+
+  explicit SloBatchingPolicy(const Options& options);
+
+  // Records the processing of a batch of 'batch_size' task units, which took
+  // 'processing_micros', and whose oldest task waited 'latency_micros' from
+  // being enqueued to the end of the processing.
+  void RecordBatch(size_t batch_size, int64 processing_micros,
+                   int64 latency_micros);
+
+  // The batch size and batch timeout to use, as of the last RecordBatch().
+  size_t batch_size() const { return batch_size_; }
+  int64 batch_timeout_micros() const { return batch_timeout_micros_; }
+
+  // The current latency budget, in microseconds.
+  int64 latency_budget_micros() const {
+    return static_cast<int64>(budget_fraction_ *
+                              options_.target_p99_latency_micros);
+  }
+
+ private:
+  // Latency measurements, windowed: once the current histogram holds
+  // 'window_size' samples, its statistics replace those of the last complete
+  // window and it starts over.
+  class WindowedLatency {
+   public:
+    void Add(double micros, int64 window_size);
+
+    // Whether there are enough samples for the estimates below.
+    bool Known(int64 min_samples) const;
+
+    // The larger of the estimates of the last complete window and of the
+    // current one (if it has enough samples), so that increases in latency
+    // are picked up without waiting for a full window.
+    double Percentile99(int64 min_samples) const;
+    double Average(int64 min_samples) const;
+
+   private:
+    histogram::Histogram current_;
+    int64 current_count_ = 0;
+    bool has_last_window_ = false;
+    double last_window_p99_ = 0;
+    double last_window_average_ = 0;
+  };
+
+  // The largest batch size of the size range at 'index'.
+  size_t RangeLimit(int index) const;
+
+  // The index of the size range of 'batch_size'.
+  int RangeIndex(size_t batch_size) const;
+
+  // Recomputes 'batch_size_' and 'batch_timeout_micros_'.
+  void Update();
+
+  const Options options_;
+
+  // Processing latencies, per range of batch sizes.
+  std::vector<std::unique_ptr<WindowedLatency>> processing_latencies_;
+
+  // Latencies of the oldest task of each batch, since the last adjustment of
+  // the budget.
+  histogram::Histogram task_latencies_;
+  int64 num_task_latencies_ = 0;
+
+  // The latency budget, as a fraction of the target.
+  double budget_fraction_ = 1.0;
+
+  size_t batch_size_ = 1;
+  int64 batch_timeout_micros_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SloBatchingPolicy);
+};
+
+//////////
+// Implementation details follow. API users need not read.
+
+inline void SloBatchingPolicy::WindowedLatency::Add(double micros,
+                                                    int64 window_size) {
+  current_.Add(micros);
+  if (++current_count_ >= window_size) {
+    has_last_window_ = true;
+    last_window_p99_ = current_.Percentile(99);
+    last_window_average_ = current_.Average();
+    current_.Clear();
+    current_count_ = 0;
+  }
+}
+
+inline bool SloBatchingPolicy::WindowedLatency::Known(
+    int64 min_samples) const {
+  return has_last_window_ || current_count_ >= min_samples;
+}
+
+inline double SloBatchingPolicy::WindowedLatency::Percentile99(
+    int64 min_samples) const {
+  const double current =
+      current_count_ >= min_samples ? current_.Percentile(99) : 0;
+  return std::max(has_last_window_ ? last_window_p99_ : 0, current);
+}
+
+inline double SloBatchingPolicy::WindowedLatency::Average(
+    int64 min_samples) const {
+  const double current = current_count_ >= min_samples ? current_.Average() : 0;
+  return std::max(has_last_window_ ? last_window_average_ : 0, current);
+}
+
+inline SloBatchingPolicy::SloBatchingPolicy(const Options& options)
+    : options_(options) {
+  DCHECK_GT(options.target_p99_latency_micros, 0);
+  DCHECK_GT(options.max_batch_size, 0);
+  int num_ranges = 1;
+  while (RangeLimit(num_ranges - 1) < options.max_batch_size) {
+    ++num_ranges;
+  }
+  for (int i = 0; i < num_ranges; ++i) {
+    processing_latencies_.emplace_back(new WindowedLatency);
+  }
+  Update();
+}
+
+inline size_t SloBatchingPolicy::RangeLimit(int index) const {
+  return std::min(size_t{1} << index, options_.max_batch_size);
+}
+
+inline int SloBatchingPolicy::RangeIndex(size_t batch_size) const {
+  int index = 0;
+  while (index + 1 < processing_latencies_.size() &&
+         RangeLimit(index) < batch_size) {
+    ++index;
+  }
+  return index;
+}
+
+inline void SloBatchingPolicy::RecordBatch(size_t batch_size,
+                                           int64 processing_micros,
+                                           int64 latency_micros) {
+  processing_latencies_[RangeIndex(batch_size)]->Add(processing_micros,
+                                                     options_.window_size);
+
+  task_latencies_.Add(latency_micros);
+  if (++num_task_latencies_ >= options_.budget_adjustment_window) {
+    if (task_latencies_.Percentile(99) > options_.target_p99_latency_micros) {
+      budget_fraction_ = std::max(0.1, budget_fraction_ * 0.8);
+    } else {
+      budget_fraction_ = std::min(1.0, budget_fraction_ * 1.05);
+    }
+    task_latencies_.Clear();
+    num_task_latencies_ = 0;
+  }
+
+  Update();
+}
+
+inline void SloBatchingPolicy::Update() {
+  const double budget = latency_budget_micros();
+  const int64 min_samples = options_.min_samples;
+
+  // The known size range with the highest throughput within the budget, and
+  // its 99th percentile latency.
+  int best_index = -1;
+  double best_throughput = 0;
+  double best_p99 = 0;
+  // The largest known size range, from which to explore the next one.
+  int largest_known_index = -1;
+  for (int i = 0; i < processing_latencies_.size(); ++i) {
+    const WindowedLatency& latency = *processing_latencies_[i];
+    if (!latency.Known(min_samples)) {
+      continue;
+    }
+    largest_known_index = i;
+    const double p99 = latency.Percentile99(min_samples);
+    if (p99 > budget) {
+      continue;
+    }
+    const double throughput =
+        RangeLimit(i) / std::max(1.0, latency.Average(min_samples));
+    if (best_index < 0 || throughput > best_throughput) {
+      best_index = i;
+      best_throughput = throughput;
+      best_p99 = p99;
+    }
+  }
+
+  // Explore the size range following the largest known one, if its
+  // extrapolated latency fits in the budget.
+  if (largest_known_index < 0) {
+    best_index = 0;
+    best_p99 = 0;
+  } else if (best_index == largest_known_index &&
+             largest_known_index + 1 < processing_latencies_.size()) {
+    const int next_index = largest_known_index + 1;
+    const double next_p99 = best_p99 * RangeLimit(next_index) /
+                            RangeLimit(largest_known_index);
+    if (next_p99 <= budget) {
+      best_index = next_index;
+      best_p99 = next_p99;
+    }
+  } else if (best_index < 0) {
+    // Nothing fits; minimize latency.
+    best_index = 0;
+    best_p99 = processing_latencies_[0]->Known(min_samples)
+                   ? processing_latencies_[0]->Percentile99(min_samples)
+                   : 0;
+  }
+
+  batch_size_ = RangeLimit(best_index);
+  batch_timeout_micros_ = std::min(
+      options_.max_batch_timeout_micros,
+      std::max(int64{0}, static_cast<int64>(budget - best_p99)));
+}
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_BATCHING_UTIL_SLO_BATCHING_POLICY_H_
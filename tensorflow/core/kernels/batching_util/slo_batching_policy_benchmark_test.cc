@@ -0,0 +1,302 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Simulation benchmark comparing the latency and throughput of a batching
+// queue using fixed batch sizes and timeouts with one tuned by
+// SloBatchingPolicy, under bursty traffic.
+//
+// The simulation mirrors how a SharedBatchScheduler queue forms and schedules
+// batches (an open batch closing when full, and becoming schedulable once its
+// timeout expires; batch threads taking closed batches first), with simulated
+// batch processing latencies, on the clock of a FakeClockEnv. It is thus
+// deterministic and runs much faster than the simulated time.
+
+#include <cmath>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "tensorflow/core/kernels/batching_util/fake_clock_env.h"
+#include "tensorflow/core/kernels/batching_util/slo_batching_policy.h"
+#include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+using ::tensorflow::histogram::Histogram;
+
+// The granule of simulated time.
+constexpr int kTickMicros = 10;
+
+// The simulated time, after which no more tasks arrive.
+constexpr int64 kDurationMicros = 20 * 1000 * 1000 /* 20 seconds */;
+
+// The number of simulated batch threads.
+constexpr int kNumBatchThreads = 4;
+
+// The largest batch size of all configurations.
+constexpr size_t kMaxBatchSize = 256;
+
+// The target 99th percentile task latency.
+constexpr int64 kTargetP99LatencyMicros = 30 * 1000;
+
+// Traffic alternates between quiet and bursty phases of this duration, with
+// exponentially distributed inter-arrival times.
+constexpr int64 kPhaseMicros = 200 * 1000;
+constexpr double kQuietArrivalRatePerSecond = 5000;
+constexpr double kBurstArrivalRatePerSecond = 60000;
+
+// The simulated processing latency of a batch: a fixed overhead plus a cost
+// per task, with +/-20% noise and occasional stragglers taking twice as long.
+constexpr int64 kBatchOverheadMicros = 2000;
+constexpr int64 kTaskCostMicros = 30;
+
+// How a configuration picks batch sizes and timeouts.
+struct BatchingConfig {
+  string name;
+  size_t max_batch_size;
+  int64 batch_timeout_micros;
+  // If positive, SloBatchingPolicy tunes the batch size and timeout (up to the
+  // above) for this target.
+  int64 target_p99_latency_micros;
+};
+
+// A simulated batch: the arrival times of its tasks.
+struct SimulatedBatch {
+  uint64 start_time_micros = 0;
+  std::vector<uint64> task_arrival_times_micros;
+};
+
+// A batch being processed by a simulated batch thread.
+struct BatchInProgress {
+  SimulatedBatch batch;
+  uint64 processing_start_time_micros;
+  uint64 end_time_micros;
+};
+
+class BatchingSimulation {
+ public:
+  explicit BatchingSimulation(const BatchingConfig& config);
+
+  // Runs the simulation, and prints its results.
+  void Run();
+
+ private:
+  size_t BatchSizeLimit() const;
+  int64 BatchTimeoutMicros() const;
+
+  // Adds a task arriving now to the queue.
+  void AddTask();
+
+  // Completes the batches whose processing ended, and hands out batches to
+  // idle batch threads.
+  void ProcessBatches();
+
+  // Picks the simulated processing latency of a batch of 'batch_size' tasks.
+  int64 ProcessingMicros(size_t batch_size);
+
+  // The time until the next task arrival at the current traffic rate.
+  int64 NextArrivalIntervalMicros();
+
+  const BatchingConfig config_;
+  test_util::FakeClockEnv env_;
+  random::PhiloxRandom philox_;
+  random::SimplePhilox rng_;
+  std::unique_ptr<SloBatchingPolicy> slo_policy_;
+
+  // The closed batches, followed by the open one.
+  std::deque<SimulatedBatch> batches_;
+  std::vector<BatchInProgress> batches_in_progress_;
+
+  Histogram task_latency_millis_histogram_;
+  Histogram batch_size_histogram_;
+  int64 num_tasks_ = 0;
+  int64 num_tasks_over_target_ = 0;
+  // The total time spent processing batches, over all batch threads.
+  int64 busy_micros_ = 0;
+};
+
+BatchingSimulation::BatchingSimulation(const BatchingConfig& config)
+    : config_(config),
+      env_(Env::Default()),
+      philox_(/*seed=*/301),
+      rng_(&philox_) {
+  if (config.target_p99_latency_micros > 0) {
+    SloBatchingPolicy::Options options;
+    options.target_p99_latency_micros = config.target_p99_latency_micros;
+    options.max_batch_size = config.max_batch_size;
+    options.max_batch_timeout_micros = config.batch_timeout_micros;
+    slo_policy_.reset(new SloBatchingPolicy(options));
+  }
+  batches_.emplace_back();
+}
+
+size_t BatchingSimulation::BatchSizeLimit() const {
+  return slo_policy_ != nullptr ? slo_policy_->batch_size()
+                                : config_.max_batch_size;
+}
+
+int64 BatchingSimulation::BatchTimeoutMicros() const {
+  return slo_policy_ != nullptr ? slo_policy_->batch_timeout_micros()
+                                : config_.batch_timeout_micros;
+}
+
+void BatchingSimulation::AddTask() {
+  const uint64 now = env_.NowMicros();
+  if (!batches_.back().task_arrival_times_micros.empty() &&
+      batches_.back().task_arrival_times_micros.size() + 1 > BatchSizeLimit()) {
+    batches_.emplace_back();
+  }
+  SimulatedBatch& open_batch = batches_.back();
+  if (open_batch.task_arrival_times_micros.empty()) {
+    open_batch.start_time_micros = now;
+  }
+  open_batch.task_arrival_times_micros.push_back(now);
+}
+
+void BatchingSimulation::ProcessBatches() {
+  const uint64 now = env_.NowMicros();
+
+  for (auto it = batches_in_progress_.begin();
+       it != batches_in_progress_.end();) {
+    if (it->end_time_micros > now) {
+      ++it;
+      continue;
+    }
+    const std::vector<uint64>& arrivals = it->batch.task_arrival_times_micros;
+    batch_size_histogram_.Add(arrivals.size());
+    for (uint64 arrival_time_micros : arrivals) {
+      const int64 latency_micros = now - arrival_time_micros;
+      task_latency_millis_histogram_.Add(latency_micros / 1000.0);
+      ++num_tasks_;
+      if (latency_micros > kTargetP99LatencyMicros) {
+        ++num_tasks_over_target_;
+      }
+    }
+    if (slo_policy_ != nullptr) {
+      slo_policy_->RecordBatch(arrivals.size(),
+                               now - it->processing_start_time_micros,
+                               now - it->batch.start_time_micros);
+    }
+    it = batches_in_progress_.erase(it);
+  }
+
+  while (batches_in_progress_.size() < kNumBatchThreads) {
+    const SimulatedBatch& front = batches_.front();
+    const bool closed = batches_.size() > 1;
+    const bool open_schedulable =
+        !front.task_arrival_times_micros.empty() &&
+        (front.task_arrival_times_micros.size() >= BatchSizeLimit() ||
+         now >= front.start_time_micros + BatchTimeoutMicros());
+    if (!closed && !open_schedulable) {
+      break;
+    }
+    BatchInProgress in_progress;
+    in_progress.batch = std::move(batches_.front());
+    batches_.pop_front();
+    if (batches_.empty()) {
+      batches_.emplace_back();
+    }
+    in_progress.processing_start_time_micros = now;
+    const int64 processing_micros =
+        ProcessingMicros(in_progress.batch.task_arrival_times_micros.size());
+    in_progress.end_time_micros = now + processing_micros;
+    busy_micros_ += processing_micros;
+    batches_in_progress_.push_back(std::move(in_progress));
+  }
+}
+
+int64 BatchingSimulation::ProcessingMicros(size_t batch_size) {
+  const double noise = 0.8 + 0.4 * rng_.RandDouble();
+  const double straggler = rng_.OneIn(100) ? 2.0 : 1.0;
+  return static_cast<int64>(
+      (kBatchOverheadMicros + kTaskCostMicros * batch_size) * noise *
+      straggler);
+}
+
+int64 BatchingSimulation::NextArrivalIntervalMicros() {
+  const bool burst = (env_.NowMicros() / kPhaseMicros) % 2 == 1;
+  const double rate_per_micro =
+      (burst ? kBurstArrivalRatePerSecond : kQuietArrivalRatePerSecond) / 1e6;
+  // Exponentially distributed, avoiding log(0).
+  return static_cast<int64>(-std::log(1.0 - rng_.RandDouble()) /
+                            rate_per_micro);
+}
+
+void BatchingSimulation::Run() {
+  uint64 next_arrival_micros = NextArrivalIntervalMicros();
+  while (env_.NowMicros() < kDurationMicros || !batches_in_progress_.empty() ||
+         batches_.size() > 1 ||
+         !batches_.front().task_arrival_times_micros.empty()) {
+    while (env_.NowMicros() < kDurationMicros &&
+           next_arrival_micros <= env_.NowMicros()) {
+      AddTask();
+      next_arrival_micros += NextArrivalIntervalMicros();
+    }
+    ProcessBatches();
+    env_.AdvanceByMicroseconds(kTickMicros);
+  }
+
+  std::cout << std::setw(28) << std::left << config_.name << std::right
+            << std::setw(10) << std::fixed << std::setprecision(1)
+            << num_tasks_ * 1e6 / env_.NowMicros() << " tasks/s"
+            << "\tp50: " << task_latency_millis_histogram_.Median() << "ms"
+            << "\tp99: " << task_latency_millis_histogram_.Percentile(99)
+            << "ms"
+            << "\tover target: " << std::setprecision(2)
+            << 100.0 * num_tasks_over_target_ / num_tasks_ << "%"
+            << "\tmean batch size: " << std::setprecision(1)
+            << batch_size_histogram_.Average() << "\tbatch thread utilization: "
+            << 100.0 * busy_micros_ / (kNumBatchThreads * env_.NowMicros())
+            << "%" << std::endl;
+}
+
+void RunSimulations() {
+  std::cout << "Target p99 latency: " << kTargetP99LatencyMicros / 1000
+            << "ms, " << kNumBatchThreads << " batch threads" << std::endl;
+  std::vector<BatchingConfig> configs;
+  for (int64 timeout_micros : {0, 1000, 5000, 20000}) {
+    configs.push_back({strings::StrCat("fixed, timeout ", timeout_micros, "us"),
+                       kMaxBatchSize, timeout_micros, 0});
+  }
+  for (size_t max_batch_size : {16, 64}) {
+    configs.push_back(
+        {strings::StrCat("fixed, max size ", max_batch_size, ", 1000us"),
+         max_batch_size, 1000, 0});
+  }
+  configs.push_back({"slo", kMaxBatchSize, 20000, kTargetP99LatencyMicros});
+  for (const BatchingConfig& config : configs) {
+    BatchingSimulation(config).Run();
+  }
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
+
+int main(int argc, char** argv) {
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  tensorflow::serving::RunSimulations();
+  return 0;
+}
@@ -0,0 +1,106 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/batching_util/slo_batching_policy.h"
+
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// A batch processing latency growing linearly with the batch size.
+int64 ProcessingMicros(size_t batch_size) { return 1000 + 100 * batch_size; }
+
+SloBatchingPolicy::Options MakeOptions() {
+  SloBatchingPolicy::Options options;
+  options.target_p99_latency_micros = 10 * 1000;
+  options.max_batch_size = 100;
+  options.max_batch_timeout_micros = 5 * 1000;
+  options.window_size = 100;
+  options.min_samples = 10;
+  options.budget_adjustment_window = 50;
+  return options;
+}
+
+// Feeds 'policy' with full batches of its chosen size, whose tasks all meet
+// the target latency, until its choice settles.
+void RunFullBatches(SloBatchingPolicy* policy) {
+  for (int i = 0; i < 1000; ++i) {
+    const size_t batch_size = policy->batch_size();
+    const int64 processing_micros = ProcessingMicros(batch_size);
+    policy->RecordBatch(batch_size, processing_micros, processing_micros);
+  }
+}
+
+TEST(SloBatchingPolicyTest, StartsWithSmallBatches) {
+  SloBatchingPolicy policy(MakeOptions());
+  EXPECT_EQ(1, policy.batch_size());
+  EXPECT_EQ(5 * 1000, policy.batch_timeout_micros());
+}
+
+TEST(SloBatchingPolicyTest, GrowsBatchesWithinTarget) {
+  SloBatchingPolicy policy(MakeOptions());
+  RunFullBatches(&policy);
+  // Batches of 64 take 7.4ms, and batches of 100 would take 11ms.
+  EXPECT_EQ(64, policy.batch_size());
+  // The timeout gets the rest of the budget.
+  EXPECT_NEAR(10 * 1000 - ProcessingMicros(64), policy.batch_timeout_micros(),
+              0.1 * ProcessingMicros(64));
+}
+
+TEST(SloBatchingPolicyTest, UsesLargestBatchesWithLooseTarget) {
+  SloBatchingPolicy::Options options = MakeOptions();
+  options.target_p99_latency_micros = 1000 * 1000;
+  SloBatchingPolicy policy(options);
+  RunFullBatches(&policy);
+  EXPECT_EQ(100, policy.batch_size());
+  EXPECT_EQ(5 * 1000, policy.batch_timeout_micros());
+}
+
+TEST(SloBatchingPolicyTest, ShrinksBudgetWhenTargetIsMissed) {
+  SloBatchingPolicy policy(MakeOptions());
+  RunFullBatches(&policy);
+  const size_t batch_size = policy.batch_size();
+  // Tasks also wait for batch threads, missing the target.
+  for (int i = 0; i < 200; ++i) {
+    const size_t size = policy.batch_size();
+    policy.RecordBatch(size, ProcessingMicros(size),
+                       ProcessingMicros(size) + 8 * 1000);
+  }
+  EXPECT_LT(policy.latency_budget_micros(), 10 * 1000);
+  EXPECT_LT(policy.batch_size(), batch_size);
+
+  // Once tasks meet the target again, the budget recovers.
+  for (int i = 0; i < 5000; ++i) {
+    const size_t size = policy.batch_size();
+    policy.RecordBatch(size, ProcessingMicros(size), ProcessingMicros(size));
+  }
+  EXPECT_EQ(10 * 1000, policy.latency_budget_micros());
+  EXPECT_EQ(batch_size, policy.batch_size());
+}
+
+TEST(SloBatchingPolicyTest, FallsBackToSmallBatchesWhenNothingFits) {
+  SloBatchingPolicy::Options options = MakeOptions();
+  options.target_p99_latency_micros = 500;
+  SloBatchingPolicy policy(options);
+  RunFullBatches(&policy);
+  EXPECT_EQ(1, policy.batch_size());
+  EXPECT_EQ(0, policy.batch_timeout_micros());
+}
+
+}  // namespace
+}  // namespace serving
+}  // namespace tensorflow
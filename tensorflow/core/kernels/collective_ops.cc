@@ -12,10 +12,13 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
+#include <atomic>
+
 #include "tensorflow/core/framework/attr_value.pb.h"
 #include "tensorflow/core/framework/collective.h"
 #include "tensorflow/core/framework/node_def.pb.h"
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/lib/core/errors.h"
 
 namespace tensorflow {
@@ -87,6 +90,45 @@ class CollectiveReduceOpKernel : public CollectiveOpKernel {
                     "final_op must be one of {\"Id\", \"Div\"} but got ",
                     final_op_name));
     OP_REQUIRES_OK(c, c->GetAttr("T", &col_params_.instance.data_type));
+    CollImplDetails* impl_details = &col_params_.instance.impl_details;
+    OP_REQUIRES_OK(c,
+                   c->GetAttr("bidirectional", &impl_details->bidirectional));
+    string compression;
+    OP_REQUIRES_OK(c, c->GetAttr("compression", &compression));
+    if (compression == "fp16") {
+      impl_details->compression = COMPRESSION_FP16;
+    } else if (compression == "bf16") {
+      impl_details->compression = COMPRESSION_BF16;
+    } else if (compression == "topk") {
+      impl_details->compression = COMPRESSION_TOPK;
+    }
+    OP_REQUIRES_OK(c,
+                   c->GetAttr("topk_fraction", &impl_details->topk_fraction));
+    OP_REQUIRES(c,
+                impl_details->topk_fraction > 0 &&
+                    impl_details->topk_fraction <= 1,
+                errors::InvalidArgument(
+                    "topk_fraction must be in (0, 1] but got ",
+                    impl_details->topk_fraction));
+    OP_REQUIRES(c,
+                impl_details->compression == COMPRESSION_NONE ||
+                    (col_params_.instance.data_type == DT_FLOAT &&
+                     c->device_type() == DEVICE_CPU),
+                errors::InvalidArgument(
+                    "compression is only supported for float tensors on CPU"));
+    OP_REQUIRES(c,
+                impl_details->compression != COMPRESSION_TOPK ||
+                    merge_op_name == "Add",
+                errors::InvalidArgument(
+                    "topk compression requires merge_op \"Add\""));
+    OP_REQUIRES_OK(c, c->GetAttr("hierarchical", &impl_details->hierarchical));
+    OP_REQUIRES(c,
+                !impl_details->hierarchical ||
+                    (impl_details->compression == COMPRESSION_NONE &&
+                     c->device_type() == DEVICE_CPU),
+                errors::InvalidArgument("hierarchical reduction is only "
+                                        "supported on CPU, without "
+                                        "compression"));
 
     const NodeDef& real_node = c->def();
     col_params_.name = strings::StrCat(real_node.name(), ": Reduce(",
@@ -124,6 +166,18 @@ class CollectiveReduceOpKernel : public CollectiveOpKernel {
     return k;
   }
 
+  ~CollectiveReduceOpKernel() override {
+    // The state kept for the next execution of the instance, such as top-k
+    // residuals, is no longer needed.
+    ResourceMgr* resource_mgr = resource_mgr_.load(std::memory_order_acquire);
+    if (resource_mgr != nullptr) {
+      resource_mgr
+          ->Cleanup(
+              CollectiveInstanceContainer(col_params_.instance.instance_key))
+          .IgnoreError();
+    }
+  }
+
   void ComputeAsync(OpKernelContext* c, DoneCallback done) override {
     CollectiveExecutor* col_exec = c->collective_executor();
     OP_REQUIRES_ASYNC(
@@ -132,6 +186,9 @@ class CollectiveReduceOpKernel : public CollectiveOpKernel {
             "Failed to get CollectiveExecutor from OpKernelContext for Op ",
             col_params_.name),
         done);
+    if (col_params_.instance.impl_details.compression == COMPRESSION_TOPK) {
+      resource_mgr_.store(c->resource_manager(), std::memory_order_release);
+    }
     // Allocate output on the first pass through this function.  This must be
     // done immediately, while we're still in the executor thread.  Otherwise
     // the memory is not guaranteed to be unused by any concurrently executing
@@ -154,6 +211,10 @@ class CollectiveReduceOpKernel : public CollectiveOpKernel {
   }
 
  private:
+  // The ResourceMgr of the device the instance executed on, if it keeps state
+  // there across executions.
+  std::atomic<ResourceMgr*> resource_mgr_{nullptr};
+
   TF_DISALLOW_COPY_AND_ASSIGN(CollectiveReduceOpKernel);
 };
 
@@ -0,0 +1,395 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc and ../ops/resource_variable_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/framework/resource_var.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/prefetch.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Number of rows read ahead of the one being combined, whose params are
+// prefetched.  Embedding lookups are dominated by cache misses on the rows of
+// large tables.
+constexpr int64 kPrefetchDistance = 4;
+
+enum class Combiner { kSum, kMean, kSqrtN };
+
+Status GetCombiner(OpKernelConstruction* context, Combiner* combiner) {
+  string combiner_name;
+  TF_RETURN_IF_ERROR(context->GetAttr("combiner", &combiner_name));
+  if (combiner_name == "sum") {
+    *combiner = Combiner::kSum;
+  } else if (combiner_name == "mean") {
+    *combiner = Combiner::kMean;
+  } else if (combiner_name == "sqrtn") {
+    *combiner = Combiner::kSqrtN;
+  } else {
+    return errors::InvalidArgument("Unknown combiner: ", combiner_name);
+  }
+  return Status::OK();
+}
+
+// Returns the factor by which the sum of the `num` rows of a segment is scaled.
+template <typename T>
+T CombinerScale(Combiner combiner, int64 num) {
+  switch (combiner) {
+    case Combiner::kMean:
+      return T(1) / T(num);
+    case Combiner::kSqrtN:
+      return T(1) / T(std::sqrt(static_cast<double>(num)));
+    default:
+      return T(1);
+  }
+}
+
+// Validates the indices and segment ids, and lists the segments: segment k
+// combines the positions [segment_starts[k], segment_starts[k + 1]) of the
+// indices into the row segment_rows[k] of the output.
+Status ListSegments(const Tensor& indices, const Tensor& segment_ids,
+                    std::vector<int64>* segment_starts,
+                    std::vector<int32>* segment_rows) {
+  if (!TensorShapeUtils::IsVector(indices.shape())) {
+    return errors::InvalidArgument("indices should be a vector.");
+  }
+  if (!TensorShapeUtils::IsVector(segment_ids.shape())) {
+    return errors::InvalidArgument("segment_ids should be a vector.");
+  }
+  const int64 num_indices = indices.NumElements();
+  if (num_indices != segment_ids.NumElements()) {
+    return errors::InvalidArgument(
+        "segment_ids and indices should have same size.");
+  }
+  segment_starts->clear();
+  segment_rows->clear();
+  const auto segment_vec = segment_ids.vec<int32>();
+  for (int64 i = 0; i < num_indices; ++i) {
+    const int32 segment_id = internal::SubtleMustCopy(segment_vec(i));
+    if (!segment_rows->empty() && segment_rows->back() == segment_id) continue;
+    if (segment_id < 0) {
+      return errors::InvalidArgument("segment ids must be >= 0");
+    }
+    if (!segment_rows->empty() && segment_rows->back() > segment_id) {
+      return errors::InvalidArgument("segment ids are not increasing");
+    }
+    segment_starts->push_back(i);
+    segment_rows->push_back(segment_id);
+  }
+  segment_starts->push_back(num_indices);
+  return Status::OK();
+}
+
+// Returns the error for the first position of the indices whose row could not
+// be looked up.
+template <typename Tids, typename Tidx>
+Status BadIndexError(const typename TTypes<Tids>::ConstVec& ids_vec,
+                     const typename TTypes<Tidx>::ConstVec& indices_vec,
+                     int64 position, int64 num_params_rows) {
+  const Tidx index = indices_vec(position);
+  if (!FastBoundsCheck(index, ids_vec.size())) {
+    return errors::InvalidArgument("indices[", position, "] = ", index,
+                                   " is not in [0, ", ids_vec.size(), ")");
+  }
+  return errors::InvalidArgument("ids[", index, "] = ", ids_vec(index),
+                                 " is not in [0, ", num_params_rows, ")");
+}
+
+template <typename T, typename Tids, typename Tidx>
+void FusedEmbeddingSparseSegmentReduce(OpKernelContext* context,
+                                       Combiner combiner,
+                                       const Tensor& params) {
+  const Tensor& ids = context->input(1);
+  const Tensor& indices = context->input(2);
+  const Tensor& segment_ids = context->input(3);
+  OP_REQUIRES(context, TensorShapeUtils::IsVectorOrHigher(params.shape()),
+              errors::InvalidArgument("params must be at least 1 dimensional"));
+  OP_REQUIRES(context, TensorShapeUtils::IsVector(ids.shape()),
+              errors::InvalidArgument("ids should be a vector."));
+  std::vector<int64> segment_starts;
+  std::vector<int32> segment_rows;
+  OP_REQUIRES_OK(context, ListSegments(indices, segment_ids, &segment_starts,
+                                       &segment_rows));
+
+  const int64 output_rows = segment_rows.empty() ? 0 : segment_rows.back() + 1;
+  TensorShape output_shape = params.shape();
+  output_shape.set_dim(0, output_rows);
+  Tensor* output = nullptr;
+  OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+  if (output_rows == 0) return;
+
+  const auto params_flat = params.flat_outer_dims<T>();
+  const int64 num_params_rows = params_flat.dimension(0);
+  const int64 num_col = params_flat.dimension(1);
+  const auto ids_vec = ids.vec<Tids>();
+  const int64 num_ids = ids_vec.size();
+  const auto indices_vec = indices.vec<Tidx>();
+  const int64 num_indices = indices_vec.size();
+  auto output_flat = output->flat_outer_dims<T>();
+
+  // Returns the row of params at position k of the indices, or -1 if it is
+  // out of range.
+  auto params_row = [&](int64 k) -> int64 {
+    const Tidx index = internal::SubtleMustCopy(indices_vec(k));
+    if (!FastBoundsCheck(index, num_ids)) return -1;
+    const Tids id = internal::SubtleMustCopy(ids_vec(index));
+    if (!FastBoundsCheck(id, num_params_rows)) return -1;
+    return id;
+  };
+  const int64 prefetch_stride = std::max<int64>(1, 64 / sizeof(T));
+
+  // The segments are combined in parallel, as they write to disjoint rows of
+  // the output.  Reports the first position out of range, if any.
+  mutex mu;
+  int64 bad_index_position = num_indices;
+  auto combine_segments = [&](int64 first_segment, int64 last_segment) {
+    for (int64 s = first_segment; s < last_segment; ++s) {
+      const int64 start = segment_starts[s];
+      const int64 end = segment_starts[s + 1];
+      const int32 out_index = segment_rows[s];
+      // Zeroes the rows of the empty segments before this one.
+      const int32 uninitialized_index = s > 0 ? segment_rows[s - 1] + 1 : 0;
+      if (out_index > uninitialized_index) {
+        Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
+            out_index - uninitialized_index, num_col);
+        Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>,
+                         Eigen::Unaligned>
+            gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
+        gap_slice.setZero();
+      }
+
+      auto out = output_flat.template chip<0>(out_index);
+      out.setZero();
+      for (int64 k = start; k < end; ++k) {
+        if (k + kPrefetchDistance < end) {
+          const int64 next_row = params_row(k + kPrefetchDistance);
+          if (next_row >= 0) {
+            const T* next = &params_flat(next_row, 0);
+            for (int64 j = 0; j < num_col; j += prefetch_stride) {
+              port::prefetch<port::PREFETCH_HINT_T0>(next + j);
+            }
+          }
+        }
+        const int64 row = params_row(k);
+        if (row < 0) {
+          mutex_lock l(mu);
+          bad_index_position = std::min(bad_index_position, k);
+          return;
+        }
+        out += params_flat.template chip<0>(row);
+      }
+      if (combiner != Combiner::kSum && end - start > 1) {
+        out = out * CombinerScale<T>(combiner, end - start);
+      }
+    }
+  };
+  auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+  const int64 num_segments = segment_rows.size();
+  Shard(worker_threads->num_threads, worker_threads->workers, num_segments,
+        num_col * (num_indices / num_segments + 1), combine_segments);
+  if (bad_index_position < num_indices) {
+    context->CtxFailure(BadIndexError<Tids, Tidx>(
+        ids_vec, indices_vec, bad_index_position, num_params_rows));
+  }
+}
+
+}  // namespace
+
+template <typename T, typename Tids, typename Tidx>
+class FusedEmbeddingSparseSegmentReductionOp : public OpKernel {
+ public:
+  explicit FusedEmbeddingSparseSegmentReductionOp(OpKernelConstruction* c)
+      : OpKernel(c) {
+    OP_REQUIRES_OK(c, GetCombiner(c, &combiner_));
+  }
+
+  void Compute(OpKernelContext* c) override {
+    FusedEmbeddingSparseSegmentReduce<T, Tids, Tidx>(c, combiner_,
+                                                     c->input(0));
+  }
+
+ private:
+  Combiner combiner_;
+};
+
+template <typename T, typename Tids, typename Tidx>
+class ResourceFusedEmbeddingSparseSegmentReductionOp : public OpKernel {
+ public:
+  explicit ResourceFusedEmbeddingSparseSegmentReductionOp(
+      OpKernelConstruction* c)
+      : OpKernel(c) {
+    OP_REQUIRES_OK(c, GetCombiner(c, &combiner_));
+  }
+
+  void Compute(OpKernelContext* c) override {
+    Var* v = nullptr;
+    OP_REQUIRES_OK(c, LookupResource(c, HandleFromInput(c, 0), &v));
+    core::ScopedUnref su(v);
+    // As in ResourceGather, we hold the lock for the whole lookup instead of
+    // increasing the reference count of v->tensor(), so that writes to the
+    // variable do not copy it.
+    tf_shared_lock ml(*v->mu());
+    const Tensor& params = *v->tensor();
+    OP_REQUIRES(c, params.dtype() == DataTypeToEnum<T>::v(),
+                errors::InvalidArgument(
+                    "Trying to read variable with wrong dtype. Expected ",
+                    DataTypeString(DataTypeToEnum<T>::v()), " got ",
+                    DataTypeString(params.dtype())));
+    FusedEmbeddingSparseSegmentReduce<T, Tids, Tidx>(c, combiner_, params);
+  }
+
+ private:
+  Combiner combiner_;
+};
+
+template <typename T, typename Tids, typename Tidx>
+class FusedEmbeddingSparseSegmentReductionGradOp : public OpKernel {
+ public:
+  explicit FusedEmbeddingSparseSegmentReductionGradOp(OpKernelConstruction* c)
+      : OpKernel(c) {
+    OP_REQUIRES_OK(c, GetCombiner(c, &combiner_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& grad = context->input(0);
+    const Tensor& ids = context->input(1);
+    const Tensor& indices = context->input(2);
+    const Tensor& segment_ids = context->input(3);
+    OP_REQUIRES(context, TensorShapeUtils::IsVectorOrHigher(grad.shape()),
+                errors::InvalidArgument("grad must be at least 1 dimensional"));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(ids.shape()),
+                errors::InvalidArgument("ids should be a vector."));
+    std::vector<int64> segment_starts;
+    std::vector<int32> segment_rows;
+    OP_REQUIRES_OK(context, ListSegments(indices, segment_ids, &segment_starts,
+                                         &segment_rows));
+    OP_REQUIRES(context,
+                segment_rows.empty() || segment_rows.back() < grad.dim_size(0),
+                errors::InvalidArgument("Segment id ", segment_rows.back(),
+                                        " out of range [0, ", grad.dim_size(0),
+                                        ")"));
+
+    const int64 num_indices = indices.NumElements();
+    TensorShape values_shape = grad.shape();
+    values_shape.set_dim(0, num_indices);
+    Tensor* values = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, values_shape, &values));
+    Tensor* row_ids = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(1, indices.shape(),
+                                                     &row_ids));
+    if (num_indices == 0) return;
+
+    const auto grad_flat = grad.flat_outer_dims<T>();
+    const int64 num_col = grad_flat.dimension(1);
+    const auto ids_vec = ids.vec<Tids>();
+    const int64 num_ids = ids_vec.size();
+    const auto indices_vec = indices.vec<Tidx>();
+    auto values_flat = values->flat_outer_dims<T>();
+    auto row_ids_vec = row_ids->vec<Tids>();
+
+    // Each row read by the forward op gets the gradient of its segment.
+    mutex mu;
+    int64 bad_index_position = num_indices;
+    auto scatter_segments = [&](int64 first_segment, int64 last_segment) {
+      for (int64 s = first_segment; s < last_segment; ++s) {
+        const int64 start = segment_starts[s];
+        const int64 end = segment_starts[s + 1];
+        const auto segment_grad = grad_flat.template chip<0>(segment_rows[s]);
+        const T scale = CombinerScale<T>(combiner_, end - start);
+        for (int64 k = start; k < end; ++k) {
+          const Tidx index = internal::SubtleMustCopy(indices_vec(k));
+          if (!FastBoundsCheck(index, num_ids)) {
+            mutex_lock l(mu);
+            bad_index_position = std::min(bad_index_position, k);
+            return;
+          }
+          row_ids_vec(k) = ids_vec(index);
+          if (combiner_ == Combiner::kSum) {
+            values_flat.template chip<0>(k) = segment_grad;
+          } else {
+            values_flat.template chip<0>(k) = segment_grad * scale;
+          }
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    const int64 num_segments = segment_rows.size();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_segments,
+          num_col * (num_indices / num_segments + 1), scatter_segments);
+    OP_REQUIRES(context, bad_index_position == num_indices,
+                errors::InvalidArgument(
+                    "indices[", bad_index_position,
+                    "] = ", indices_vec(bad_index_position), " is not in [0, ",
+                    num_ids, ")"));
+  }
+
+ private:
+  Combiner combiner_;
+};
+
+#define REGISTER_KERNELS(T, Tids, Tidx)                                       \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("FusedEmbeddingSparseSegmentReduction")                            \
+          .Device(DEVICE_CPU)                                                 \
+          .TypeConstraint<T>("T")                                             \
+          .TypeConstraint<Tids>("Tids")                                       \
+          .TypeConstraint<Tidx>("Tidx"),                                      \
+      FusedEmbeddingSparseSegmentReductionOp<T, Tids, Tidx>);                 \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("ResourceFusedEmbeddingSparseSegmentReduction")                    \
+          .Device(DEVICE_CPU)                                                 \
+          .TypeConstraint<T>("dtype")                                         \
+          .TypeConstraint<Tids>("Tids")                                       \
+          .TypeConstraint<Tidx>("Tidx"),                                      \
+      ResourceFusedEmbeddingSparseSegmentReductionOp<T, Tids, Tidx>);         \
+  REGISTER_KERNEL_BUILDER(                                                    \
+      Name("FusedEmbeddingSparseSegmentReductionGrad")                        \
+          .Device(DEVICE_CPU)                                                 \
+          .TypeConstraint<T>("T")                                             \
+          .TypeConstraint<Tids>("Tids")                                       \
+          .TypeConstraint<Tidx>("Tidx"),                                      \
+      FusedEmbeddingSparseSegmentReductionGradOp<T, Tids, Tidx>);
+
+#define REGISTER_CPU_KERNELS(T)      \
+  REGISTER_KERNELS(T, int32, int32); \
+  REGISTER_KERNELS(T, int32, int64); \
+  REGISTER_KERNELS(T, int64, int32); \
+  REGISTER_KERNELS(T, int64, int64);
+
+REGISTER_CPU_KERNELS(float);
+REGISTER_CPU_KERNELS(double);
+
+#undef REGISTER_CPU_KERNELS
+#undef REGISTER_KERNELS
+
+}  // namespace tensorflow
@@ -0,0 +1,253 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedEmbeddingOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& op, const string& combiner) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", op)
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT64))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("combiner", combiner)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Embeddings of dimension 2: row r is {r, 10 * r}.
+  void AddParams() {
+    AddInputFromArray<float>(TensorShape({5, 2}),
+                             {0, 0, 1, 10, 2, 20, 3, 30, 4, 40});
+  }
+};
+
+TEST_F(FusedEmbeddingOpTest, Sum) {
+  MakeOp("FusedEmbeddingSparseSegmentReduction", "sum");
+  AddParams();
+  AddInputFromArray<int64>(TensorShape({3}), {4, 1, 2});
+  AddInputFromArray<int32>(TensorShape({5}), {0, 1, 1, 2, 0});
+  // Segment 1 is empty.
+  AddInputFromArray<int32>(TensorShape({5}), {0, 0, 2, 2, 3});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({4, 2}));
+  test::FillValues<float>(&expected, {5, 50, 0, 0, 3, 30, 4, 40});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedEmbeddingOpTest, Mean) {
+  MakeOp("FusedEmbeddingSparseSegmentReduction", "mean");
+  AddParams();
+  AddInputFromArray<int64>(TensorShape({3}), {4, 1, 2});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 1, 2, 1});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 0, 1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {7.0f / 3, 70.0f / 3, 1, 10});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedEmbeddingOpTest, SqrtN) {
+  MakeOp("FusedEmbeddingSparseSegmentReduction", "sqrtn");
+  AddParams();
+  AddInputFromArray<int64>(TensorShape({2}), {3, 1});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 1, 0, 1});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 0, 0});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 2}));
+  test::FillValues<float>(&expected, {4, 40});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(FusedEmbeddingOpTest, Empty) {
+  MakeOp("FusedEmbeddingSparseSegmentReduction", "sum");
+  AddParams();
+  AddInputFromArray<int64>(TensorShape({0}), {});
+  AddInputFromArray<int32>(TensorShape({0}), {});
+  AddInputFromArray<int32>(TensorShape({0}), {});
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(TensorShape({0, 2}), GetOutput(0)->shape());
+}
+
+TEST_F(FusedEmbeddingOpTest, BadIndex) {
+  MakeOp("FusedEmbeddingSparseSegmentReduction", "sum");
+  AddParams();
+  AddInputFromArray<int64>(TensorShape({2}), {3, 1});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 2, 1});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 1, 1});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(
+      str_util::StrContains(s.ToString(), "indices[1] = 2 is not in [0, 2)"))
+      << s;
+}
+
+TEST_F(FusedEmbeddingOpTest, BadId) {
+  MakeOp("FusedEmbeddingSparseSegmentReduction", "sum");
+  AddParams();
+  AddInputFromArray<int64>(TensorShape({2}), {3, 5});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 1});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 1});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(
+      str_util::StrContains(s.ToString(), "ids[1] = 5 is not in [0, 5)"))
+      << s;
+}
+
+TEST_F(FusedEmbeddingOpTest, UnsortedSegments) {
+  MakeOp("FusedEmbeddingSparseSegmentReduction", "sum");
+  AddParams();
+  AddInputFromArray<int64>(TensorShape({2}), {3, 1});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 1, 0});
+  AddInputFromArray<int32>(TensorShape({3}), {1, 0, 1});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(
+      str_util::StrContains(s.ToString(), "segment ids are not increasing"))
+      << s;
+}
+
+TEST_F(FusedEmbeddingOpTest, MeanGrad) {
+  MakeOp("FusedEmbeddingSparseSegmentReductionGrad", "mean");
+  AddInputFromArray<float>(TensorShape({2, 2}), {3, 6, 1, 2});
+  AddInputFromArray<int64>(TensorShape({3}), {4, 1, 2});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 1, 2, 1});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 0, 1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_values(allocator(), DT_FLOAT, TensorShape({4, 2}));
+  test::FillValues<float>(&expected_values, {1, 2, 1, 2, 1, 2, 1, 2});
+  test::ExpectTensorNear<float>(expected_values, *GetOutput(0), 1e-5);
+  Tensor expected_row_ids(allocator(), DT_INT64, TensorShape({4}));
+  test::FillValues<int64>(&expected_row_ids, {4, 1, 2, 1});
+  test::ExpectTensorEqual<int64>(expected_row_ids, *GetOutput(1));
+}
+
+// Embedding lookups: combines `batch` segments of 20 ids into a 100k-row
+// embedding of dimension 64, either with the fused op or with a Gather
+// followed by a SparseSegment reduction.
+static void EmbeddingLookupHelper(int iters, bool fused, const string& combiner,
+                                  int batch, int num_threads) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  const int kRows = 100000;
+  const int kDim = 64;
+  const int kIdsPerSegment = 20;
+  const int num_indices = batch * kIdsPerSegment;
+  Tensor params(DT_FLOAT, TensorShape({kRows, kDim}));
+  params.flat<float>().setRandom();
+  Tensor ids(DT_INT64, TensorShape({num_indices}));
+  auto ids_flat = ids.flat<int64>();
+  Tensor indices(DT_INT32, TensorShape({num_indices}));
+  auto indices_flat = indices.flat<int32>();
+  Tensor segments(DT_INT32, TensorShape({num_indices}));
+  auto segments_flat = segments.flat<int32>();
+  for (int i = 0; i < num_indices; ++i) {
+    ids_flat(i) = (i * 7919) % kRows;
+    indices_flat(i) = i;
+    segments_flat(i) = i / kIdsPerSegment;
+  }
+
+  Node* node;
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"),
+                            "FusedEmbeddingSparseSegmentReduction")
+                    .Input(test::graph::Constant(g, params))
+                    .Input(test::graph::Constant(g, ids))
+                    .Input(test::graph::Constant(g, indices))
+                    .Input(test::graph::Constant(g, segments))
+                    .Attr("combiner", combiner)
+                    .Finalize(g, &node));
+  } else {
+    const string op = combiner == "sum"
+                          ? "SparseSegmentSum"
+                          : combiner == "mean" ? "SparseSegmentMean"
+                                               : "SparseSegmentSqrtN";
+    Node* gather = test::graph::Gather(
+        g, test::graph::Constant(g, params), test::graph::Constant(g, ids),
+        test::graph::Constant(g, test::AsScalar<int32>(0)));
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), op)
+                    .Input(gather)
+                    .Input(test::graph::Constant(g, indices))
+                    .Input(test::graph::Constant(g, segments))
+                    .Attr("T", DT_FLOAT)
+                    .Finalize(g, &node));
+  }
+
+  SessionOptions opts;
+  opts.config.set_intra_op_parallelism_threads(num_threads);
+  opts.config.set_inter_op_parallelism_threads(1);
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * num_indices * kDim *
+                          sizeof(float));
+  testing::StartTiming();
+  test::Benchmark("cpu", g, &opts).Run(iters);
+}
+
+static void BM_EmbeddingLookupSum(int iters, int batch, int num_threads) {
+  EmbeddingLookupHelper(iters, false, "sum", batch, num_threads);
+}
+
+static void BM_FusedEmbeddingLookupSum(int iters, int batch,
+                                       int num_threads) {
+  EmbeddingLookupHelper(iters, true, "sum", batch, num_threads);
+}
+
+static void BM_EmbeddingLookupMean(int iters, int batch, int num_threads) {
+  EmbeddingLookupHelper(iters, false, "mean", batch, num_threads);
+}
+
+static void BM_FusedEmbeddingLookupMean(int iters, int batch,
+                                        int num_threads) {
+  EmbeddingLookupHelper(iters, true, "mean", batch, num_threads);
+}
+
+BENCHMARK(BM_EmbeddingLookupSum)
+    ->ArgPair(512, 1)
+    ->ArgPair(4096, 1)
+    ->ArgPair(4096, 4)
+    ->ArgPair(4096, 16);
+BENCHMARK(BM_FusedEmbeddingLookupSum)
+    ->ArgPair(512, 1)
+    ->ArgPair(4096, 1)
+    ->ArgPair(4096, 4)
+    ->ArgPair(4096, 16);
+BENCHMARK(BM_EmbeddingLookupMean)->ArgPair(4096, 1)->ArgPair(4096, 4);
+BENCHMARK(BM_FusedEmbeddingLookupMean)->ArgPair(4096, 1)->ArgPair(4096, 4);
+
+}  // namespace
+}  // namespace tensorflow
@@ -33,7 +33,9 @@ limitations under the License.
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 #if GOOGLE_CUDA
 #include "tensorflow/core/common_runtime/gpu/gpu_event_mgr.h"
@@ -111,86 +113,98 @@ class SegmentReductionOp : public OpKernel {
                 errors::InvalidArgument("segment ids must be >= 0"));
     auto output_flat = output->flat_outer_dims<T>();
 
+    // Validates the segment ids, and lists the segments: segment k reduces
+    // the rows [segment_starts[k], segment_starts[k + 1]) of the input into
+    // the row segment_rows[k] of the output.
+    std::vector<int64> segment_starts;
+    std::vector<Index> segment_rows;
+    Index out_index = internal::SubtleMustCopy(segment_vec(0));
+    segment_starts.push_back(0);
+    segment_rows.push_back(out_index);
+    for (int64 i = 1; i < num_indices; ++i) {
+      const Index next_index = internal::SubtleMustCopy(segment_vec(i));
+      if (out_index == next_index) continue;
+      // We have a new segment here.  Verify that the segment ids are growing.
+      OP_REQUIRES(context, out_index < next_index,
+                  errors::InvalidArgument("segment ids are not increasing"));
+      OP_REQUIRES(
+          context, FastBoundsCheck(out_index, output_rows),
+          errors::InvalidArgument(
+              "Segment id ", out_index, " out of range [0, ", output_rows,
+              "), possibly because 'segment_ids' input is not sorted."));
+      segment_starts.push_back(i);
+      segment_rows.push_back(next_index);
+      out_index = next_index;
+    }
+    OP_REQUIRES(
+        context, FastBoundsCheck(out_index, output_rows),
+        errors::InvalidArgument(
+            "Segment id ", out_index, " out of range [0, ", output_rows,
+            "), possibly because 'segment_ids' input is not sorted."));
+    segment_starts.push_back(num_indices);
+    const int64 num_segments = segment_rows.size();
+
 #if !defined(EIGEN_HAS_INDEX_LIST)
     Eigen::DSizes<Eigen::DenseIndex, 1> dims_to_reduce;
     dims_to_reduce[0] = 0;
 #else
     Eigen::IndexList<Eigen::type2index<0> > dims_to_reduce;
 #endif
-    Index start = 0, end = 1;
-
-    Index uninitialized_index = 0;  // Index from which the output is not set.
-    Index out_index = internal::SubtleMustCopy(segment_vec(start));
-
-    // TODO(agarwal): if this loop becomes a bottleneck, consider sharding it
-    // across threads.
     Eigen::DSizes<Eigen::DenseIndex, 1> out_slice_shape(num_col);
-    while (end <= num_indices) {
-      // We initialize next_index to 0 to avoid "warning: 'next_index' may be
-      // used uninitialized in this function" in the Mac build (since the
-      // compiler isn't smart enough to realize the code is safe).
-      Index next_index = 0;
-      if (end < num_indices) {
-        next_index = internal::SubtleMustCopy(segment_vec(end));
-        if (out_index == next_index) {
-          ++end;
-          continue;
+    typedef Eigen::TensorMap<Eigen::Tensor<T, 1, Eigen::RowMajor>,
+                             Eigen::Unaligned>
+        OutT;
+
+    // The segments are reduced in parallel, each on one thread, as they write
+    // to disjoint rows of the output.
+    auto reduce_segments = [&](int64 first_segment, int64 last_segment) {
+      for (int64 k = first_segment; k < last_segment; ++k) {
+        const int64 start = segment_starts[k];
+        const int64 end = segment_starts[k + 1];
+        const Index out_index = segment_rows[k];
+        // Index from which the output is not set.
+        const Index uninitialized_index = k > 0 ? segment_rows[k - 1] + 1 : 0;
+
+        // If there is a gap between two indices, we need to set that gap to
+        // the default value.
+        if (out_index > uninitialized_index) {
+          Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
+              out_index - uninitialized_index, num_col);
+          Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>,
+                           Eigen::Unaligned>
+              gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
+          gap_slice.setConstant(T(default_value));
         }
-        // We have a new segment here.  Verify that the segment ids are growing.
-        OP_REQUIRES(context, out_index < next_index,
-                    errors::InvalidArgument("segment ids are not increasing"));
-      }
-
-      // Process segment [start, end)
-      const T* in_slice_ptr = &input_flat(start, 0);
-      typedef Eigen::TensorMap<Eigen::Tensor<T, 1, Eigen::RowMajor>,
-                               Eigen::Unaligned>
-          OutT;
-
-      OP_REQUIRES(
-          context, FastBoundsCheck(out_index, output_rows),
-          errors::InvalidArgument(
-              "Segment id ", out_index, " out of range [0, ", output_rows,
-              "), possibly because 'segment_ids' input is not sorted."));
-
-      // If there is a gap between two indices, we need to set that gap to the
-      // default value.
-      if (out_index > uninitialized_index) {
-        Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
-            out_index - uninitialized_index, num_col);
-        Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>, Eigen::Unaligned>
-            gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
-        gap_slice.setConstant(T(default_value));
-      }
 
-      T* out_slice_ptr = &output_flat(out_index, 0);
-      OutT out_slice(out_slice_ptr, out_slice_shape);
-      // We don't use out_slice.device(context->eigen_device<Device>)
-      // because these pieces of work are likely to be very small and
-      // the context switching overhead dwarfs any benefit we get from
-      // using another thread to do this work.
-      if (start == end - 1) {
-        typedef Eigen::TensorMap<Eigen::Tensor<const T, 1, Eigen::RowMajor>,
-                                 Eigen::Unaligned>
-            InT;
-        InT in_slice(in_slice_ptr, out_slice_shape);
-        out_slice = in_slice;
-      } else {
-        Eigen::DSizes<Eigen::DenseIndex, 2> in_slice_shape(end - start,
-                                                           num_col);
-        typedef Eigen::TensorMap<Eigen::Tensor<const T, 2, Eigen::RowMajor>,
-                                 Eigen::Unaligned>
-            InT;
-        InT in_slice(in_slice_ptr, in_slice_shape);
-
-        out_slice = in_slice.reduce(dims_to_reduce, Reducer());
+        // Process segment [start, end)
+        const T* in_slice_ptr = &input_flat(start, 0);
+        T* out_slice_ptr = &output_flat(out_index, 0);
+        OutT out_slice(out_slice_ptr, out_slice_shape);
+        // We don't use out_slice.device(context->eigen_device<Device>)
+        // because these pieces of work are likely to be very small and
+        // the context switching overhead dwarfs any benefit we get from
+        // using another thread to do this work.
+        if (start == end - 1) {
+          typedef Eigen::TensorMap<Eigen::Tensor<const T, 1, Eigen::RowMajor>,
+                                   Eigen::Unaligned>
+              InT;
+          InT in_slice(in_slice_ptr, out_slice_shape);
+          out_slice = in_slice;
+        } else {
+          Eigen::DSizes<Eigen::DenseIndex, 2> in_slice_shape(end - start,
+                                                             num_col);
+          typedef Eigen::TensorMap<Eigen::Tensor<const T, 2, Eigen::RowMajor>,
+                                   Eigen::Unaligned>
+              InT;
+          InT in_slice(in_slice_ptr, in_slice_shape);
+
+          out_slice = in_slice.reduce(dims_to_reduce, Reducer());
+        }
       }
-      if (end >= num_indices) break;
-      start = end;
-      ++end;
-      uninitialized_index = out_index + 1;
-      out_index = next_index;
-    }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_segments,
+          num_col * (num_indices / num_segments + 1), reduce_segments);
   }
 };
 
@@ -364,9 +378,16 @@ TF_CALL_GPU_NUMBER_TYPES(REGISTER_GPU_SORTED_KERNELS_ALL);
 namespace functor {
 
 // The ReductionFunctor implementation for CPU.
+//
+// Large inputs are split into contiguous chunks of rows, which are reduced in
+// parallel into per-chunk partial outputs, and the partial outputs are then
+// reduced into the output, in chunk order, in parallel over the segments.
 template <typename T, typename Index, typename InitialValueF,
           typename ReductionF>
 struct UnsortedSegmentFunctor<CPUDevice, T, Index, InitialValueF, ReductionF> {
+  // Minimum number of input rows per chunk.
+  static constexpr int64 kMinRowsPerChunk = 4096;
+
   void operator()(OpKernelContext* ctx, const Index num_segments,
                   const TensorShape& segment_ids_shape,
                   typename TTypes<Index>::ConstFlat segment_ids,
@@ -379,17 +400,77 @@ struct UnsortedSegmentFunctor<CPUDevice, T, Index, InitialValueF, ReductionF> {
     const int64 N = segment_ids.dimension(0);
     ReductionF reduction;
     auto data_flat = typename TTypes<T, 2>::ConstTensor(data, N, data_size / N);
-    for (int64 i = 0; i < N; ++i) {
-      Index j = internal::SubtleMustCopy(segment_ids(i));
-      if (j < 0) {
-        continue;
+
+    // The partial outputs take at most as much memory as the input.
+    const int64 output_size = output.size();
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    const int64 num_chunks = std::min<int64>(
+        {static_cast<int64>(worker_threads->num_threads), N / kMinRowsPerChunk,
+         output_size > 0 ? 1 + data_size / output_size : 1});
+    if (num_chunks <= 1) {
+      for (int64 i = 0; i < N; ++i) {
+        Index j = internal::SubtleMustCopy(segment_ids(i));
+        if (j < 0) {
+          continue;
+        }
+        OP_REQUIRES(ctx, FastBoundsCheck(j, num_segments),
+                    errors::InvalidArgument(
+                        "segment_ids", SliceDebugString(segment_ids_shape, i),
+                        " = ", j, " is out of range [0, ", num_segments, ")"));
+        reduction(data_flat.template chip<0>(i), output.template chip<0>(j));
       }
-      OP_REQUIRES(ctx, FastBoundsCheck(j, num_segments),
+      return;
+    }
+
+    std::vector<Index> ids(N);
+    for (int64 i = 0; i < N; ++i) {
+      ids[i] = internal::SubtleMustCopy(segment_ids(i));
+      OP_REQUIRES(ctx, ids[i] < num_segments,
                   errors::InvalidArgument(
                       "segment_ids", SliceDebugString(segment_ids_shape, i),
-                      " = ", j, " is out of range [0, ", num_segments, ")"));
-      reduction(data_flat.template chip<0>(i), output.template chip<0>(j));
+                      " = ", ids[i], " is out of range [0, ", num_segments,
+                      ")"));
     }
+
+    // Chunk 0 is reduced into the output, and chunk c > 0 into partials[c - 1].
+    const int64 num_col = output.dimension(1);
+    Tensor partials;
+    OP_REQUIRES_OK(
+        ctx, ctx->allocate_temp(DataTypeToEnum<T>::value,
+                                TensorShape({(num_chunks - 1) * num_segments,
+                                             num_col}),
+                                &partials));
+    auto partials_flat = partials.matrix<T>();
+    const int64 chunk_size = (N + num_chunks - 1) / num_chunks;
+    auto reduce_chunks = [&](int64 first_chunk, int64 last_chunk) {
+      for (int64 c = first_chunk; c < last_chunk; ++c) {
+        typename TTypes<T, 2>::Tensor chunk_output(
+            c == 0 ? output.data() : &partials_flat((c - 1) * num_segments, 0),
+            num_segments, num_col);
+        if (c > 0) chunk_output.setConstant(InitialValueF()());
+        const int64 end = std::min(N, (c + 1) * chunk_size);
+        for (int64 i = c * chunk_size; i < end; ++i) {
+          if (ids[i] >= 0) {
+            reduction(data_flat.template chip<0>(i),
+                      chunk_output.template chip<0>(ids[i]));
+          }
+        }
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, num_chunks,
+          chunk_size * num_col, reduce_chunks);
+    auto partials_const = typename TTypes<T, 2>::ConstTensor(
+        partials_flat.data(), partials_flat.dimension(0), num_col);
+    auto merge_partials = [&](int64 first_segment, int64 last_segment) {
+      for (int64 c = 1; c < num_chunks; ++c) {
+        for (int64 j = first_segment; j < last_segment; ++j) {
+          reduction(partials_const.template chip<0>((c - 1) * num_segments + j),
+                    output.template chip<0>(j));
+        }
+      }
+    };
+    Shard(worker_threads->num_threads, worker_threads->workers, num_segments,
+          (num_chunks - 1) * num_col, merge_partials);
   }
 };
 
@@ -691,60 +772,81 @@ class SparseSegmentReductionOpBase : public OpKernel {
                 errors::InvalidArgument("segment ids must be >= 0"));
     auto output_flat = output->flat_outer_dims<T>();
 
-    int64 start = 0, end = 1;
-    // Index from which the output is not initialized.
-    OutputRow uninitialized_index = 0;
-    OutputRow out_index = internal::SubtleMustCopy(segment_vec(start));
-
-    while (true) {
-      // We initialize next_index to 0 to avoid "warning: 'next_index' may be
-      // used uninitialized in this function" in the Mac build (since the
-      // compiler isn't smart enough to realize the code is safe).
-      OutputRow next_index = 0;
-      if (end < num_indices) {
-        next_index = internal::SubtleMustCopy(segment_vec(end));
-        if (out_index == next_index) {
-          ++end;
-          continue;
-        }
-        // We have a new segment here.  Verify that the segment ids are growing.
-        OP_REQUIRES(context, out_index < next_index,
-                    errors::InvalidArgument("segment ids are not increasing"));
-      }
-
+    // Validates the segment ids, and lists the segments: segment k reduces
+    // the rows of the input at indices [segment_starts[k],
+    // segment_starts[k + 1]) into the row segment_rows[k] of the output.
+    std::vector<int64> segment_starts;
+    std::vector<OutputRow> segment_rows;
+    OutputRow out_index = internal::SubtleMustCopy(segment_vec(0));
+    segment_starts.push_back(0);
+    segment_rows.push_back(out_index);
+    for (int64 i = 1; i < num_indices; ++i) {
+      const OutputRow next_index = internal::SubtleMustCopy(segment_vec(i));
+      if (out_index == next_index) continue;
+      // We have a new segment here.  Verify that the segment ids are growing.
+      OP_REQUIRES(context, out_index < next_index,
+                  errors::InvalidArgument("segment ids are not increasing"));
       OP_REQUIRES(
           context, FastBoundsCheck(out_index, output_rows),
           errors::InvalidArgument(
               "Segment id ", out_index, " out of range [0, ", output_rows,
               "), possibly because 'segment_ids' input is not sorted."));
-
-      // If there is a gap between two indices, we need to set that gap to the
-      // default value.
-      if (out_index > uninitialized_index) {
-        Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
-            out_index - uninitialized_index, num_col);
-        Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>, Eigen::Unaligned>
-            gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
-        gap_slice.setConstant(default_value_);
-      }
-
-      auto out = output_flat.template chip<0>(out_index);
-      const int bad_offset =
-          Reduce(input_flat, indices_vec, start, end - start, out);
-      OP_REQUIRES(context, bad_offset < 0,
-                  errors::InvalidArgument(
-                      "Bad: indices[", start + bad_offset,
-                      "] == ", indices_vec(start + bad_offset),
-                      " out of range [0, ", input_flat.dimension(0), ")"));
-
-      start = end;
-      ++end;
-      uninitialized_index = out_index + 1;
+      segment_starts.push_back(i);
+      segment_rows.push_back(next_index);
       out_index = next_index;
-      if (end > num_indices) break;
     }
+    OP_REQUIRES(
+        context, FastBoundsCheck(out_index, output_rows),
+        errors::InvalidArgument(
+            "Segment id ", out_index, " out of range [0, ", output_rows,
+            "), possibly because 'segment_ids' input is not sorted."));
+    segment_starts.push_back(num_indices);
+    const int64 num_segments = segment_rows.size();
+
+    // The segments are reduced in parallel, as they write to disjoint rows of
+    // the output.  Reports the first index out of range, if any.
+    mutex mu;
+    int64 bad_index_position = num_indices;
+    auto reduce_segments = [&](int64 first_segment, int64 last_segment) {
+      for (int64 k = first_segment; k < last_segment; ++k) {
+        const int64 start = segment_starts[k];
+        const int64 end = segment_starts[k + 1];
+        const OutputRow out_index = segment_rows[k];
+        // Index from which the output is not initialized.
+        const OutputRow uninitialized_index =
+            k > 0 ? segment_rows[k - 1] + 1 : 0;
+
+        // If there is a gap between two indices, we need to set that gap to
+        // the default value.
+        if (out_index > uninitialized_index) {
+          Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
+              out_index - uninitialized_index, num_col);
+          Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>,
+                           Eigen::Unaligned>
+              gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
+          gap_slice.setConstant(default_value_);
+        }
+
+        auto out = output_flat.template chip<0>(out_index);
+        const int64 bad_offset =
+            Reduce(input_flat, indices_vec, start, end - start, out);
+        if (bad_offset >= 0) {
+          mutex_lock l(mu);
+          bad_index_position = std::min(bad_index_position, start + bad_offset);
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_segments,
+          num_col * (num_indices / num_segments + 1), reduce_segments);
+    OP_REQUIRES(context, bad_index_position == num_indices,
+                errors::InvalidArgument(
+                    "Bad: indices[", bad_index_position,
+                    "] == ", indices_vec(bad_index_position),
+                    " out of range [0, ", input_flat.dimension(0), ")"));
 
     // Fill the gap at the end with the default value.
+    const OutputRow uninitialized_index = segment_rows.back() + 1;
     if (uninitialized_index < output_rows) {
       Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
           output_rows - uninitialized_index, num_col);
@@ -166,4 +166,108 @@ static void BM_SparseSegmentMeanGrad_High(int iters, int size) {
 BENCHMARK(BM_SparseSegmentMeanGrad_Low)->Arg(1000)->Arg(100000);
 BENCHMARK(BM_SparseSegmentMeanGrad_High)->Arg(1000)->Arg(100000);
 
+// Embedding combiners: reduces `batch` segments of 20 rows of a 100k-row
+// embedding of dimension `dim`.
+static void SparseSegmentReductionHelper(int iters, const string& op,
+                                         int batch, int dim,
+                                         int num_threads) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  const int kRows = 100000;
+  const int kIdsPerSegment = 20;
+  const int num_indices = batch * kIdsPerSegment;
+  Tensor input(DT_FLOAT, TensorShape({kRows, dim}));
+  input.flat<float>().setRandom();
+  Tensor indices(DT_INT32, TensorShape({num_indices}));
+  auto indices_flat = indices.flat<int32>();
+  Tensor segments(DT_INT32, TensorShape({num_indices}));
+  auto segments_flat = segments.flat<int32>();
+  for (int i = 0; i < num_indices; ++i) {
+    indices_flat(i) = (i * 7919) % kRows;
+    segments_flat(i) = i / kIdsPerSegment;
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), op)
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, indices))
+                  .Input(test::graph::Constant(g, segments))
+                  .Attr("T", DT_FLOAT)
+                  .Finalize(g, &node));
+
+  SessionOptions opts;
+  opts.config.set_intra_op_parallelism_threads(num_threads);
+  opts.config.set_inter_op_parallelism_threads(1);
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * num_indices * dim *
+                          sizeof(float));
+  testing::StartTiming();
+  test::Benchmark("cpu", g, &opts).Run(iters);
+}
+
+static void BM_SparseSegmentSum(int iters, int batch, int num_threads) {
+  SparseSegmentReductionHelper(iters, "SparseSegmentSum", batch, 64,
+                               num_threads);
+}
+
+static void BM_SparseSegmentMean(int iters, int batch, int num_threads) {
+  SparseSegmentReductionHelper(iters, "SparseSegmentMean", batch, 64,
+                               num_threads);
+}
+
+static void BM_SparseSegmentSqrtN(int iters, int batch, int num_threads) {
+  SparseSegmentReductionHelper(iters, "SparseSegmentSqrtN", batch, 64,
+                               num_threads);
+}
+
+BENCHMARK(BM_SparseSegmentSum)
+    ->ArgPair(512, 1)
+    ->ArgPair(4096, 1)
+    ->ArgPair(4096, 4)
+    ->ArgPair(4096, 16);
+BENCHMARK(BM_SparseSegmentMean)->ArgPair(4096, 1)->ArgPair(4096, 4);
+BENCHMARK(BM_SparseSegmentSqrtN)->ArgPair(4096, 1)->ArgPair(4096, 4);
+
+// Reduces `num_rows` rows of dimension 64 into 1024 segments.
+static void BM_UnsortedSegmentSum(int iters, int num_rows, int num_threads) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  const int kDim = 64;
+  const int kNumSegments = 1024;
+  Tensor data(DT_FLOAT, TensorShape({num_rows, kDim}));
+  data.flat<float>().setRandom();
+  Tensor segment_ids(DT_INT32, TensorShape({num_rows}));
+  auto segment_ids_flat = segment_ids.flat<int32>();
+  for (int i = 0; i < num_rows; ++i) {
+    segment_ids_flat(i) = (i * 7919) % kNumSegments;
+  }
+  Tensor num_segments(DT_INT32, TensorShape({}));
+  num_segments.scalar<int32>()() = kNumSegments;
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "UnsortedSegmentSum")
+                  .Input(test::graph::Constant(g, data))
+                  .Input(test::graph::Constant(g, segment_ids))
+                  .Input(test::graph::Constant(g, num_segments))
+                  .Attr("T", DT_FLOAT)
+                  .Finalize(g, &node));
+
+  SessionOptions opts;
+  opts.config.set_intra_op_parallelism_threads(num_threads);
+  opts.config.set_inter_op_parallelism_threads(1);
+  testing::UseRealTime();
+  testing::BytesProcessed(static_cast<int64>(iters) * num_rows * kDim *
+                          sizeof(float));
+  testing::StartTiming();
+  test::Benchmark("cpu", g, &opts).Run(iters);
+}
+
+BENCHMARK(BM_UnsortedSegmentSum)
+    ->ArgPair(16 * 1024, 1)
+    ->ArgPair(256 * 1024, 1)
+    ->ArgPair(256 * 1024, 4)
+    ->ArgPair(256 * 1024, 16);
+
 }  // namespace tensorflow
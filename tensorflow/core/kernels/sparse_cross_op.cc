@@ -164,47 +164,91 @@ class OutputUpdater {
 };
 
 // Generates the sparse crosses as concatenation of strings.
+//
+// The features of a batch are read once in StartRow(), and the crosses are
+// then built incrementally: consecutive crosses share a prefix, so only the
+// features from the first one that changed are appended again.
 template <typename InternalType>
 class StringCrosser {
  public:
   StringCrosser(const std::vector<
                     std::unique_ptr<ColumnInterface<InternalType>>>& columns,
                 const int64 num_buckets_unused, const uint64 hash_key_unused)
-      : columns_(columns) {}
+      : columns_(columns),
+        features_(columns.size()),
+        prefix_ends_(columns.size() + 1, 0) {}
+
+  void StartRow(const int64 batch_index) {
+    for (size_t i = 0; i < columns_.size(); ++i) {
+      const int64 count = columns_[i]->FeatureCount(batch_index);
+      features_[i].clear();
+      features_[i].reserve(count);
+      for (int64 n = 0; n < count; ++n) {
+        features_[i].push_back(columns_[i]->Feature(batch_index, n));
+      }
+    }
+  }
 
-  string Generate(const int64 batch_index,
-                  const std::vector<int>& permutation) const {
-    static const auto k_feature_separator = "_X_";
+  // The features of the columns before first_changed are the same as for the
+  // previous cross of the row.
+  const string& Generate(const std::vector<int>& permutation,
+                         const int first_changed) {
+    static const StringPiece k_feature_separator = "_X_";
 
-    gtl::InlinedVector<InternalType, 6> cross_vec(columns_.size());
-    for (int i = 0; i < permutation.size(); i++) {
-      cross_vec[i] = columns_[i]->Feature(batch_index, permutation[i]);
+    cross_.resize(prefix_ends_[first_changed]);
+    for (size_t i = first_changed; i < permutation.size(); ++i) {
+      if (i > 0) {
+        cross_.append(k_feature_separator.data(), k_feature_separator.size());
+      }
+      const StringPiece feature(features_[i][permutation[i]]);
+      cross_.append(feature.data(), feature.size());
+      prefix_ends_[i + 1] = cross_.size();
     }
-    // TODO(zakaria): this will copy the string twice, might effect
-    // performance.
-    return str_util::Join(cross_vec, k_feature_separator);
+    return cross_;
   }
 
  private:
   const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>& columns_;
+  std::vector<std::vector<InternalType>> features_;
+  // prefix_ends_[i] is the length of the cross of the first i features.
+  std::vector<size_t> prefix_ends_;
+  string cross_;
 };
 
 // Generates the sparse crosses as nested hash to avoid string manipulations.
+//
+// Strings are fingerprinted once per batch in StartRow(), and the nested hash
+// of every prefix of the current cross is kept, so that a cross only rehashes
+// the features from the first one that changed.
 class HashCrosser {
  public:
   HashCrosser(
       const std::vector<std::unique_ptr<ColumnInterface<int64>>>& columns,
       const int64 num_buckets, const uint64 hash_key)
-      : columns_(columns), num_buckets_(num_buckets), hash_key_(hash_key) {}
+      : columns_(columns),
+        num_buckets_(num_buckets),
+        features_(columns.size()),
+        prefix_hashes_(columns.size() + 1, hash_key) {}
+
+  void StartRow(const int64 batch_index) {
+    for (size_t i = 0; i < columns_.size(); ++i) {
+      const int64 count = columns_[i]->FeatureCount(batch_index);
+      features_[i].resize(count);
+      for (int64 n = 0; n < count; ++n) {
+        features_[i][n] = columns_[i]->Feature(batch_index, n);
+      }
+    }
+  }
 
-  int64 Generate(const int64 batch_index,
-                 const std::vector<int>& permutation) const {
+  // The features of the columns before first_changed are the same as for the
+  // previous cross of the row.
+  int64 Generate(const std::vector<int>& permutation, const int first_changed) {
     // Do the fingerprint concatenation on uint64.
-    uint64 hashed_output = hash_key_;
-    for (size_t i = 0; i < permutation.size(); ++i) {
-      uint64 hash_i = columns_[i]->Feature(batch_index, permutation[i]);
-      hashed_output = FingerprintCat64(hashed_output, hash_i);
+    for (size_t i = first_changed; i < permutation.size(); ++i) {
+      const uint64 hash_i = features_[i][permutation[i]];
+      prefix_hashes_[i + 1] = FingerprintCat64(prefix_hashes_[i], hash_i);
     }
+    const uint64 hashed_output = prefix_hashes_[permutation.size()];
     // The return value is int64 based on the number of buckets.
     if (num_buckets_ > 0) {
       return hashed_output % num_buckets_;
@@ -217,7 +261,10 @@ class HashCrosser {
  private:
   const std::vector<std::unique_ptr<ColumnInterface<int64>>>& columns_;
   const int64 num_buckets_;
-  const uint64 hash_key_;
+  std::vector<std::vector<uint64>> features_;
+  // prefix_hashes_[i] is the nested hash of the first i features, starting
+  // from the hash key.
+  std::vector<uint64> prefix_hashes_;
 };
 
 // ProductIterator generates cartesian products based on indices.
@@ -228,45 +275,42 @@ class ProductIterator {
       const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>&
           columns,
       int64 batch_index)
-      : columns_(columns), batch_index_(batch_index) {
-    next_permutation_.resize(columns_.size(), 0);
-    // Sets has_next_ to false if any feature column has 0 features.
-    has_next_ = true;
-    for (int i = 0; i < columns_.size(); i++) {
-      if (columns_[i]->FeatureCount(batch_index_) == 0) {
-        has_next_ = false;
-        break;
-      }
+      : feature_counts_(columns.size()),
+        permutation_(columns.size(), 0),
+        remaining_(1),
+        started_(false) {
+    for (int i = 0; i < columns.size(); i++) {
+      feature_counts_[i] = columns[i]->FeatureCount(batch_index);
+      // There is no cross if any feature column has 0 features.
+      remaining_ *= feature_counts_[i];
     }
   }
 
-  std::vector<int> Next() {
-    std::vector<int> permutation(next_permutation_);
-
-    // Generates next permutation, if available.
-    bool carry = true;
-    for (int i = next_permutation_.size() - 1; i >= 0; i--) {
-      if (carry) {
-        next_permutation_[i] = next_permutation_[i] + 1;
-      }
-      if (next_permutation_[i] == columns_[i]->FeatureCount(batch_index_)) {
-        next_permutation_[i] = 0;
-      } else {
-        carry = false;
-        break;
-      }
+  // Returns the next permutation, and sets first_changed to the first column
+  // whose feature differs from the previous permutation.
+  const std::vector<int>& Next(int* first_changed) {
+    remaining_--;
+    if (!started_) {
+      started_ = true;
+      *first_changed = 0;
+      return permutation_;
     }
-    has_next_ = !carry;
-    return permutation;
+    int i = permutation_.size() - 1;
+    while (++permutation_[i] == feature_counts_[i]) {
+      permutation_[i] = 0;
+      --i;
+    }
+    *first_changed = i;
+    return permutation_;
   }
 
-  bool HasNext() { return has_next_; }
+  bool HasNext() const { return remaining_ > 0; }
 
  private:
-  bool has_next_;
-  const std::vector<std::unique_ptr<ColumnInterface<InternalType>>>& columns_;
-  const int64 batch_index_;
-  std::vector<int> next_permutation_;
+  std::vector<int64> feature_counts_;
+  std::vector<int> permutation_;
+  int64 remaining_;
+  bool started_;
 };
 
 template <bool HASHED_OUTPUT, typename InternalType>
@@ -315,8 +359,6 @@ class SparseCrossOp : public OpKernel {
         GenerateColumnsFromInput(indices_list_in, values_list_in,
                                  shapes_list_in, dense_list_in);
 
-    typename CrossTraits<HASHED_OUTPUT, InternalType>::Crosser crosser(
-        columns, num_buckets_, hash_key_);
     Tensor* indices_out;
     Tensor* values_out;
     Tensor* shape_out;
@@ -327,13 +369,24 @@ class SparseCrossOp : public OpKernel {
 
     typename CrossTraits<HASHED_OUTPUT, InternalType>::Updater updater(
         output_start_indices, indices_out, values_out);
-    auto do_work = [&columns, crosser, updater](int64 begin, int64 end) {
+    const int64 num_buckets = num_buckets_;
+    const uint64 hash_key = hash_key_;
+    auto do_work = [&columns, &updater, num_buckets, hash_key](int64 begin,
+                                                               int64 end) {
+      // The crosser keeps the state of the row being crossed, so every shard
+      // has its own.
+      typename CrossTraits<HASHED_OUTPUT, InternalType>::Crosser crosser(
+          columns, num_buckets, hash_key);
       for (int b = begin; b < end; b++) {
         ProductIterator<InternalType> product_iterator(columns, b);
+        if (!product_iterator.HasNext()) continue;
+        crosser.StartRow(b);
         int64 cross_count = 0;
+        int first_changed;
         while (product_iterator.HasNext()) {
-          const auto permutation = product_iterator.Next();
-          updater.Update(b, cross_count, crosser.Generate(b, permutation));
+          const auto& permutation = product_iterator.Next(&first_changed);
+          updater.Update(b, cross_count,
+                         crosser.Generate(permutation, first_changed));
           cross_count++;
         }
       }
@@ -19,6 +19,8 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/sparse_tensor_dense_matmul_op.h"
 
+#include <vector>
+
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/kernels/bounds_check.h"
@@ -244,6 +246,10 @@ struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
   // Vectorize certain operations above this size.
   static const std::size_t kNumVectorize = 32;
 
+  // Products with fewer multiply-adds than this are computed by a single
+  // thread: below, partitioning A by rows costs more than it saves.
+  static const int64 kMinParallelWork = 64 * 1024;
+
   static Status Compute(const CPUDevice& d, typename TTypes<T>::Matrix out,
                         typename TTypes<Tindices>::ConstMatrix a_indices,
                         typename TTypes<T>::ConstVec a_values,
@@ -254,11 +260,12 @@ struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
     const int lhs_index_a = ADJ_A ? 1 : 0;
     const int rhs_index_a = ADJ_A ? 0 : 1;
 
-    out.setZero();
+    if (d.numThreads() > 1 && out.dimension(0) > 1 &&
+        static_cast<int64>(nnz * rhs_right) >= kMinParallelWork) {
+      return ComputeByRows(d, out, a_indices, a_values, b);
+    }
 
-    // TODO(ebrevdo): After many failed experiments, can't find a multi-threaded
-    // approach that achieves the performance of the single threaded
-    // one.  Perhaps Eigen threadpool implementation is just too slow?
+    out.setZero();
 
     if (rhs_right < kNumVectorize) {
       // Disable vectorization if the RHS of output is too small
@@ -312,6 +319,124 @@ struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
     }
     return Status::OK();
   }
+
+ private:
+  // A nonzero of A: its position in a_indices and a_values, and its index
+  // into the rows (or the columns of the adjoint) of B.
+  struct RowNonzero {
+    int64 i;
+    int64 k;
+  };
+
+  // Computes the rows of the output in parallel.  The nonzeros of A are
+  // bucketed by output row, which gives a CSR view of A, and each output row is
+  // accumulated by a single thread.  Within a row the nonzeros keep their order
+  // in a_indices, so that the result is the same as the single-threaded one.
+  // a_indices are read only once, and only the indices validated then are
+  // used, since the input may be changed concurrently.
+  static Status ComputeByRows(const CPUDevice& d,
+                              typename TTypes<T>::Matrix out,
+                              typename TTypes<Tindices>::ConstMatrix a_indices,
+                              typename TTypes<T>::ConstVec a_values,
+                              typename TTypes<T>::ConstMatrix b) {
+    const std::size_t nnz = a_values.size();
+    const std::size_t rhs_right = (ADJ_B ? b.dimension(0) : b.dimension(1));
+    const std::size_t lhs_right = (ADJ_B ? b.dimension(1) : b.dimension(0));
+    const int lhs_index_a = ADJ_A ? 1 : 0;
+    const int rhs_index_a = ADJ_A ? 0 : 1;
+    const int64 out_rows = out.dimension(0);
+
+    // row_nonzeros[row_starts[m]:row_starts[m + 1]] are the nonzeros of row m
+    // of the output.
+    std::vector<int64> row_starts(out_rows + 1, 0);
+    std::vector<int64> rows(nnz);
+    std::vector<int64> cols(nnz);
+    for (std::size_t i = 0; i < nnz; ++i) {
+      const Tindices m = internal::SubtleMustCopy(a_indices(i, lhs_index_a));
+      const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
+      if (!FastBoundsCheck(k, lhs_right)) {
+        return KOutOfBoundsError(k, i, rhs_index_a, lhs_right);
+      }
+      if (!FastBoundsCheck(m, out_rows)) {
+        return MOutOfBoundsError(m, i, lhs_index_a, out_rows);
+      }
+      rows[i] = m;
+      cols[i] = k;
+      ++row_starts[m + 1];
+    }
+    for (int64 m = 0; m < out_rows; ++m) {
+      row_starts[m + 1] += row_starts[m];
+    }
+    std::vector<RowNonzero> row_nonzeros(nnz);
+    {
+      std::vector<int64> next(row_starts.begin(), row_starts.end() - 1);
+      for (std::size_t i = 0; i < nnz; ++i) {
+        row_nonzeros[next[rows[i]]++] = {static_cast<int64>(i), cols[i]};
+      }
+    }
+    rows = std::vector<int64>();
+    cols = std::vector<int64>();
+
+    const double nnz_per_row = static_cast<double>(nnz) / out_rows;
+    const Eigen::TensorOpCost cost(
+        nnz_per_row * rhs_right * sizeof(T),  // ld bytes
+        rhs_right * sizeof(T),                // st bytes
+        nnz_per_row * rhs_right * 2);         // compute cycles
+    if (rhs_right < kNumVectorize) {
+      auto maybe_adjoint_b = MaybeAdjoint<decltype(b), ADJ_B>(b);
+      d.parallelFor(out_rows, cost, [&](int64 first, int64 last) {
+        for (int64 m = first; m < last; ++m) {
+          for (std::size_t n = 0; n < rhs_right; ++n) out(m, n) = T(0);
+          for (int64 p = row_starts[m]; p < row_starts[m + 1]; ++p) {
+            const int64 i = row_nonzeros[p].i;
+            const int64 k = row_nonzeros[p].k;
+            const T a_value = ADJ_A ? MaybeConj(a_values(i)) : a_values(i);
+            for (std::size_t n = 0; n < rhs_right; ++n) {
+              out(m, n) += a_value * maybe_adjoint_b(k, n);
+            }
+          }
+        }
+      });
+    } else if (ADJ_B) {
+      // Perform transpose and conjugation on B once, since we chip out B's
+      // columns in the nnz loop.
+      Eigen::array<int, 2> shuffle(1, 0);  // preserve dimension order
+      Eigen::Tensor<T, 2, Eigen::ColMajor> col_major_conj_b(b.dimension(0),
+                                                            b.dimension(1));
+      col_major_conj_b.device(d) = b.swap_layout().shuffle(shuffle).conjugate();
+      d.parallelFor(out_rows, cost, [&](int64 first, int64 last) {
+        AccumulateRows(first, last, row_starts, row_nonzeros, a_values,
+                       col_major_conj_b, out);
+      });
+    } else {
+      d.parallelFor(out_rows, cost, [&](int64 first, int64 last) {
+        AccumulateRows(first, last, row_starts, row_nonzeros, a_values, b,
+                       out);
+      });
+    }
+    return Status::OK();
+  }
+
+  // Computes the rows [first, last) of the output, with the vectorized
+  // accumulation of the rows (or the columns of the adjoint) of B.
+  template <typename BMatrix>
+  static void AccumulateRows(int64 first, int64 last,
+                             const std::vector<int64>& row_starts,
+                             const std::vector<RowNonzero>& row_nonzeros,
+                             typename TTypes<T>::ConstVec a_values,
+                             const BMatrix& b_passed,
+                             typename TTypes<T>::Matrix out) {
+    for (int64 m = first; m < last; ++m) {
+      auto out_row = out.template chip<0>(m);
+      out_row.setZero();
+      for (int64 p = row_starts[m]; p < row_starts[m + 1]; ++p) {
+        const int64 i = row_nonzeros[p].i;
+        const int64 k = row_nonzeros[p].k;
+        const T a_value = ADJ_A ? MaybeConj(a_values(i)) : a_values(i);
+        out_row += b_passed.template chip<ADJ_B ? 1 : 0>(k) * a_value;
+      }
+    }
+  }
 };
 
 }  // namespace functor
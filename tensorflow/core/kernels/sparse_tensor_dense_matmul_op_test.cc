@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/graph/node_builder.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
 
 namespace tensorflow {
 
@@ -117,4 +118,32 @@ BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, false, true);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, false);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, true);
 
+// Multiplies a 4096 x 4096 matrix with 64k nonzeros by a dense 4096 x `n`
+// matrix, with `num_threads` intra-op threads.
+static void BM_SparseTensorDenseMatmulThreads(int iters, int n,
+                                              int num_threads) {
+  const int kNnz = 64 * 1024;
+  const int kDim = 4096;
+  const int64 items_per_iter = static_cast<int64>(kNnz) * n;
+  testing::ItemsProcessed(static_cast<int64>(iters) * items_per_iter);
+  testing::BytesProcessed(static_cast<int64>(iters) * items_per_iter *
+                          sizeof(float));
+  SessionOptions opts;
+  opts.config.set_intra_op_parallelism_threads(num_threads);
+  opts.config.set_inter_op_parallelism_threads(1);
+  testing::UseRealTime();
+  test::Benchmark("cpu",
+                  SparseTensorDenseMatmul(kNnz, kDim, kDim, n, false, false),
+                  &opts)
+      .Run(iters);
+}
+
+BENCHMARK(BM_SparseTensorDenseMatmulThreads)
+    ->ArgPair(16, 1)
+    ->ArgPair(16, 4)
+    ->ArgPair(16, 16)
+    ->ArgPair(256, 1)
+    ->ArgPair(256, 4)
+    ->ArgPair(256, 16);
+
 }  // end namespace tensorflow
@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_STRING_TO_HASH_BUCKET_OP_H_
 #define TENSORFLOW_CORE_KERNELS_STRING_TO_HASH_BUCKET_OP_H_
 
+#include <algorithm>
 #include <string>
 
 #include "tensorflow/core/framework/op_kernel.h"
@@ -23,6 +24,8 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/prefetch.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -44,18 +47,41 @@ class StringToHashBucketOp : public OpKernel {
                                             &output_tensor));
     auto output_flat = output_tensor->flat<int64>();
 
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = hash(input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64>(bucket_id);
-    }
+    const string* input = input_flat.data();
+    int64* output = output_flat.data();
+    const uint64 num_buckets = num_buckets_;
+    // The strings are hashed in place, a batch at a time: the bytes of the
+    // next batch are prefetched, since longer strings live on the heap, and
+    // the hashes of a batch do not depend on each other, so that their
+    // computations and the divisions below overlap.
+    auto hash_range = [input, output, num_buckets](int64 start, int64 limit) {
+      uint64 hashes[kBatchSize];
+      for (int64 begin = start; begin < limit; begin += kBatchSize) {
+        const int64 end = std::min(limit, begin + kBatchSize);
+        const int64 prefetch_end = std::min(limit, end + kBatchSize);
+        for (int64 i = end; i < prefetch_end; ++i) {
+          port::prefetch<port::PREFETCH_HINT_T0>(input[i].data());
+        }
+        for (int64 i = begin; i < end; ++i) {
+          hashes[i - begin] = hash(input[i]);
+        }
+        for (int64 i = begin; i < end; ++i) {
+          // The number of buckets is always in the positive range of int64 so
+          // is the resulting bucket_id. Casting the bucket_id from uint64 to
+          // int64 is safe.
+          output[i] = static_cast<int64>(hashes[i - begin] % num_buckets);
+        }
+      }
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          input_flat.size(), kCostPerString, hash_range);
   }
 
  private:
+  static constexpr int64 kBatchSize = 8;
+  static constexpr int64 kCostPerString = 250;
+
   int64 num_buckets_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(StringToHashBucketOp);
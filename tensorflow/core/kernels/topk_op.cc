@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/topk_op.h"
 
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 #include <vector>
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
@@ -87,16 +88,166 @@ class TopK : public OpKernel {
 
     auto values = values_out->flat_inner_dims<T>();
     auto indices = indices_out->flat_inner_dims<int32>();
-    Status s = functor::TopKFunctor<Device, T>::Compute(
-        context, sorted_, k, input, num_rows, num_cols, values, indices);
+    Status s =
+        ComputeTopK(context, k, input, num_rows, num_cols, values, indices);
     OP_REQUIRES_OK(context, s);
   }
 
- private:
+ protected:
+  virtual Status ComputeTopK(OpKernelContext* context, int k,
+                             const typename TTypes<T, 2>::ConstTensor& input,
+                             const int64 num_rows, const int64 num_cols,
+                             typename TTypes<T, 2>::Tensor values,
+                             typename TTypes<int, 2>::Tensor indices) {
+    return functor::TopKFunctor<Device, T>::Compute(
+        context, sorted_, k, input, num_rows, num_cols, values, indices);
+  }
+
   int k_;
   bool sorted_;
 };
 
+namespace {
+
+// Number of consecutive columns that the threshold filter of BucketedTopK
+// tests at once.
+const int kFilterBlockSize = 16;
+
+// Rows are only split into buckets of at least this many columns.
+const int64 kMinBucketColumns = 16 * 1024;
+
+// ApproxTopK splits rows into buckets of at least this many times k columns.
+const int64 kApproxBucketColumnsPerK = 16;
+
+// Orders the columns of a row by decreasing value, and equal values by
+// increasing column.
+template <typename T>
+struct StableGreater {
+  explicit StableGreater(const T* input_data) : input_data(input_data) {}
+
+  bool operator()(const int32 a, const int32 b) const {
+    if (input_data[b] < input_data[a]) {
+      return true;
+    } else if (input_data[b] > input_data[a]) {
+      return false;
+    } else {
+      return a < b;
+    }
+  }
+
+  const T* input_data;
+};
+
+// Finds the top `k` columns of each row by splitting the rows into
+// `num_buckets` buckets of consecutive columns, finding the top `bucket_k`
+// columns of all buckets in parallel, and merging these candidates.  This
+// keeps all threads busy on few long rows, e.g. on the single row of scores of
+// a retrieval query.  The result is the same as that of TopKFunctor if
+// `bucket_k` == `k`, and approximate otherwise.
+//
+// Each bucket only pushes to its heap the values greater than the current
+// k-th largest one, which blocks of columns are tested against without
+// branches, so that the test vectorizes; in long rows, most blocks have no
+// such value.
+template <typename T>
+void BucketedTopK(OpKernelContext* context, bool sorted, int k, int bucket_k,
+                  int64 num_buckets,
+                  const typename TTypes<T, 2>::ConstTensor& input,
+                  const int64 num_rows, const int64 num_cols,
+                  typename TTypes<T, 2>::Tensor values,
+                  typename TTypes<int, 2>::Tensor indices) {
+  std::vector<int32> candidates(num_rows * num_buckets * bucket_k);
+  std::vector<int32> num_candidates(num_rows * num_buckets);
+  auto FindCandidates = [&](int64 start, int64 limit) {
+    for (int64 i = start; i < limit; ++i) {
+      const T* input_data = &input(i / num_buckets, 0);
+      const int64 bucket = i % num_buckets;
+      const int32 begin = num_cols * bucket / num_buckets;
+      const int32 end = num_cols * (bucket + 1) / num_buckets;
+      gtl::TopN<int32, StableGreater<T>> filter(
+          bucket_k, StableGreater<T>(input_data));
+      filter.reserve(bucket_k + 1);
+      int32 c = begin;
+      for (; c < end && c < begin + bucket_k; ++c) {
+        filter.push(c);
+      }
+      if (c < end) {
+        // Later columns lose ties, so only greater values enter the heap.
+        T threshold = input_data[filter.peek_bottom()];
+        auto push_greater = [&](int32 col) {
+          if (input_data[col] > threshold) {
+            filter.push(col);
+            threshold = input_data[filter.peek_bottom()];
+          }
+        };
+        for (; c + kFilterBlockSize <= end; c += kFilterBlockSize) {
+          bool any_greater = false;
+          for (int j = 0; j < kFilterBlockSize; ++j) {
+            any_greater |= input_data[c + j] > threshold;
+          }
+          if (!any_greater) continue;
+          for (int j = 0; j < kFilterBlockSize; ++j) {
+            push_greater(c + j);
+          }
+        }
+        for (; c < end; ++c) {
+          push_greater(c);
+        }
+      }
+      num_candidates[i] = filter.size();
+      std::copy(filter.unsorted_begin(), filter.unsorted_end(),
+                candidates.begin() + i * bucket_k);
+    }
+  };
+
+  auto MergeCandidates = [&](int64 start, int64 limit) {
+    for (int64 r = start; r < limit; ++r) {
+      const T* input_data = &input(r, 0);
+      gtl::TopN<int32, StableGreater<T>> filter(k,
+                                               StableGreater<T>(input_data));
+      filter.reserve(k + 1);
+      for (int64 i = r * num_buckets; i < (r + 1) * num_buckets; ++i) {
+        for (int32 j = 0; j < num_candidates[i]; ++j) {
+          filter.push(candidates[i * bucket_k + j]);
+        }
+      }
+      int32 j = 0;
+      if (sorted) {
+        std::unique_ptr<std::vector<int32>> top_k(filter.Extract());
+        for (auto top_k_it = top_k->begin(); top_k_it != top_k->end();
+             ++top_k_it, ++j) {
+          indices(r, j) = *top_k_it;
+        }
+      } else {
+        for (auto top_k_it = filter.unsorted_begin();
+             top_k_it != filter.unsorted_end(); ++top_k_it, ++j) {
+          indices(r, j) = *top_k_it;
+        }
+      }
+      std::transform(&indices(r, 0), &indices(r, k), &values(r, 0),
+                     [input_data](const int32 loc) { return input_data[loc]; });
+    }
+  };
+
+  const double cmp_cost = 3 * Eigen::TensorOpCost::AddCost<int32>() +
+                          Eigen::TensorOpCost::AddCost<T>();
+  const int64 bucket_cost =
+      num_cols / num_buckets * Eigen::TensorOpCost::AddCost<T>() +
+      static_cast<int64>(
+          cmp_cost * bucket_k *
+          Eigen::numext::log2(static_cast<float>(bucket_k + 1)));
+  const int64 merge_cost = static_cast<int64>(
+      cmp_cost * num_buckets * bucket_k *
+      Eigen::numext::log2(static_cast<float>(k + 1)));
+  auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+  Shard(worker_threads.num_threads, worker_threads.workers,
+        num_rows * num_buckets, bucket_cost, FindCandidates);
+  Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
+        merge_cost, MergeCandidates);
+}
+
+}  // namespace
+
 namespace functor {
 
 template <typename T>
@@ -134,6 +285,20 @@ struct TopKFunctor<CPUDevice, T> {
       return Status::OK();
     }
 
+    // Sharding by rows leaves threads idle on fewer rows than threads, so
+    // long rows are also split into buckets of columns.
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    if (k < num_cols && num_rows < worker_threads.num_threads) {
+      const int64 num_buckets = std::min<int64>(
+          (worker_threads.num_threads + num_rows - 1) / num_rows,
+          num_cols / std::max<int64>(kMinBucketColumns, 4 * k));
+      if (num_buckets > 1) {
+        BucketedTopK<T>(context, sorted, k, k, num_buckets, input, num_rows,
+                        num_cols, values, indices);
+        return Status::OK();
+      }
+    }
+
     auto SortIndices = [&, context](int start_batch, int limit_batch) {
       for (int32 b = start_batch; b < limit_batch; ++b) {
         const T* input_data = &input(b, 0);
@@ -219,7 +384,6 @@ struct TopKFunctor<CPUDevice, T> {
     const int64 final_cost = (total_cost >= static_cast<double>(kint64max))
                                  ? kint64max
                                  : static_cast<int64>(total_cost);
-    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
     Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
           final_cost, SortIndices);
 
@@ -229,14 +393,83 @@ struct TopKFunctor<CPUDevice, T> {
 
 }  // namespace functor
 
+namespace {
+
+// Returns the smallest number of candidates per bucket for which the expected
+// recall of the top k over `num_buckets` buckets reaches `recall_target`, if
+// each of the top k falls into a uniformly random bucket.  The number X of
+// them in a bucket is then binomial, and a bucket keeping m candidates finds
+// min(X, m) of them, so that the expected recall is
+// num_buckets / k * sum_{j = 1..m} P(X >= j).
+int ApproxBucketK(int k, int64 num_buckets, float recall_target) {
+  const double log_p = -std::log(static_cast<double>(num_buckets));
+  const double log_q = std::log1p(-1.0 / num_buckets);
+  // tail[x] = P(X >= x).
+  std::vector<double> tail(k + 2, 0.0);
+  for (int x = k; x >= 0; --x) {
+    const double log_pmf = std::lgamma(k + 1.0) - std::lgamma(x + 1.0) -
+                           std::lgamma(k - x + 1.0) + x * log_p +
+                           (k - x) * log_q;
+    tail[x] = tail[x + 1] + std::exp(log_pmf);
+  }
+  // Enough candidates to have k of them in total.
+  const int min_bucket_k = (k + num_buckets - 1) / num_buckets;
+  double recall = 0;
+  for (int m = 1; m < k; ++m) {
+    recall += num_buckets * tail[m] / k;
+    if (m >= min_bucket_k && recall >= recall_target) return m;
+  }
+  return k;
+}
+
+}  // namespace
+
+template <typename T>
+class ApproxTopK : public TopK<CPUDevice, T> {
+ public:
+  explicit ApproxTopK(OpKernelConstruction* context)
+      : TopK<CPUDevice, T>(context) {
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("recall_target", &recall_target_));
+    OP_REQUIRES(context, recall_target_ > 0,
+                errors::InvalidArgument("Need recall_target > 0, got ",
+                                        recall_target_));
+  }
+
+ protected:
+  Status ComputeTopK(OpKernelContext* context, int k,
+                     const typename TTypes<T, 2>::ConstTensor& input,
+                     const int64 num_rows, const int64 num_cols,
+                     typename TTypes<T, 2>::Tensor values,
+                     typename TTypes<int, 2>::Tensor indices) override {
+    // The buckets only depend on the shape, so that results do not depend on
+    // the number of threads.
+    const int64 num_buckets = num_cols / (kApproxBucketColumnsPerK * k);
+    if (recall_target_ >= 1 || num_buckets <= 1) {
+      return TopK<CPUDevice, T>::ComputeTopK(context, k, input, num_rows,
+                                             num_cols, values, indices);
+    }
+    BucketedTopK<T>(context, this->sorted_, k,
+                    ApproxBucketK(k, num_buckets, recall_target_),
+                    num_buckets, input, num_rows, num_cols, values, indices);
+    return Status::OK();
+  }
+
+ private:
+  float recall_target_;
+};
+
 #define REGISTER_KERNELS_NAME(name, type)                       \
   REGISTER_KERNEL_BUILDER(                                      \
       Name(#name).Device(DEVICE_CPU).TypeConstraint<type>("T"), \
       TopK<CPUDevice, type>)
 
-#define REGISTER_KERNELS(type)       \
-  REGISTER_KERNELS_NAME(TopK, type); \
-  REGISTER_KERNELS_NAME(TopKV2, type)
+#define REGISTER_KERNELS(type)                                         \
+  REGISTER_KERNELS_NAME(TopK, type);                                   \
+  REGISTER_KERNELS_NAME(TopKV2, type);                                 \
+  REGISTER_KERNEL_BUILDER(                                             \
+      Name("ApproxTopK").Device(DEVICE_CPU).TypeConstraint<type>("T"), \
+      ApproxTopK<type>)
 
 TF_CALL_REAL_NUMBER_TYPES(REGISTER_KERNELS);
 #undef REGISTER_KERNELS_NAME
@@ -17,6 +17,8 @@ limitations under the License.
 #include "tensorflow/core/lib/bfloat16/bfloat16.h"
 
 #include <algorithm>
+#include <functional>
+#include <vector>
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -24,6 +26,8 @@ limitations under the License.
 #include "tensorflow/core/kernels/training_op_helpers.h"
 #include "tensorflow/core/kernels/training_ops.h"
 #include "tensorflow/core/kernels/variable_ops.h"
+#include "tensorflow/core/lib/gtl/flatmap.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 #ifdef TENSORFLOW_USE_SYCL
 #include "tensorflow/core/common_runtime/sycl/sycl_util.h"
@@ -42,6 +46,113 @@ inline T sgn(const T x) {
   T one(1);
   return (x == zero ? zero : (x < zero ? -one : one));
 }
+
+// Returns whether `rows`, all in [0, first_dim_size), are known to be unique
+// without building a map of them: when they are increasing, as after a sort,
+// or when a bitmap of the rows of the variable is small next to such a map.
+template <typename Tindex>
+bool RowsAreKnownUnique(const std::vector<Tindex>& rows,
+                        Tindex first_dim_size) {
+  if (std::adjacent_find(rows.begin(), rows.end(),
+                         std::greater_equal<Tindex>()) == rows.end()) {
+    return true;
+  }
+  if (first_dim_size / 64 > static_cast<int64>(rows.size())) {
+    return false;
+  }
+  std::vector<bool> seen(first_dim_size);
+  for (const Tindex row : rows) {
+    if (seen[row]) return false;
+    seen[row] = true;
+  }
+  return true;
+}
+
+// Validates that `indices` are in [0, first_dim_size), and sums the rows of
+// `grad` with the same index, in order of occurrence, so that each row of the
+// variable is updated once and the result does not depend on how the update
+// is sharded.  On return, row i of `unique_grad` is the update to row
+// `(*unique_rows)[i]` of the variable, and the unique rows are in order of
+// first occurrence.  `unique_grad` shares the buffer of `grad` when the
+// indices have no duplicates.
+template <typename T, typename Tindex>
+Status UniqueSparseRows(OpKernelContext* ctx, const Tensor& indices,
+                        const Tensor& grad, Tindex first_dim_size,
+                        std::vector<Tindex>* unique_rows, Tensor* unique_grad) {
+  auto indices_vec = indices.vec<Tindex>();
+  const Tindex N = indices.dim_size(0);
+  // The indices are read once, and the validated copy is used from then on.
+  std::vector<Tindex> rows(N);
+  for (Tindex i = 0; i < N; i++) {
+    rows[i] = internal::SubtleMustCopy(indices_vec(i));
+    if (!FastBoundsCheck(rows[i], first_dim_size)) {
+      return errors::InvalidArgument(strings::StrCat(
+          "Index ", rows[i], " at offset ", i, " in indices is out of range"));
+    }
+  }
+  if (RowsAreKnownUnique(rows, first_dim_size)) {
+    *unique_rows = std::move(rows);
+    *unique_grad = grad;
+    return Status::OK();
+  }
+
+  std::vector<Tindex> slots(N);
+  gtl::FlatMap<Tindex, Tindex> slot_of_row(N);
+  unique_rows->clear();
+  unique_rows->reserve(N);
+  for (Tindex i = 0; i < N; i++) {
+    const Tindex index = rows[i];
+    auto inserted =
+        slot_of_row.insert({index, static_cast<Tindex>(unique_rows->size())});
+    if (inserted.second) unique_rows->push_back(index);
+    slots[i] = inserted.first->second;
+  }
+  const Tindex num_rows = unique_rows->size();
+  if (num_rows == N) {
+    *unique_grad = grad;
+    return Status::OK();
+  }
+
+  // Lists the occurrences of each unique row, in order.
+  std::vector<Tindex> offsets(num_rows + 1, 0);
+  for (Tindex i = 0; i < N; i++) ++offsets[slots[i] + 1];
+  for (Tindex r = 0; r < num_rows; r++) offsets[r + 1] += offsets[r];
+  std::vector<Tindex> occurrences(N);
+  {
+    std::vector<Tindex> next(offsets.begin(), offsets.end() - 1);
+    for (Tindex i = 0; i < N; i++) occurrences[next[slots[i]]++] = i;
+  }
+
+  TensorShape unique_shape = grad.shape();
+  unique_shape.set_dim(0, num_rows);
+  TF_RETURN_IF_ERROR(
+      ctx->allocate_temp(grad.dtype(), unique_shape, unique_grad));
+  auto grad_flat = grad.flat_outer_dims<T>();
+  auto unique_flat = unique_grad->flat_outer_dims<T>();
+  const int64 inner_dim = grad_flat.dimension(1);
+  auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads->num_threads, worker_threads->workers, num_rows,
+        inner_dim * (N / num_rows), [&](int64 start, int64 limit) {
+          for (int64 r = start; r < limit; r++) {
+            auto g = unique_flat.template chip<0>(r);
+            g = grad_flat.template chip<0>(occurrences[offsets[r]]);
+            for (Tindex k = offsets[r] + 1; k < offsets[r + 1]; k++) {
+              g += grad_flat.template chip<0>(occurrences[k]);
+            }
+          }
+        });
+  return Status::OK();
+}
+
+// Calls `fn(start, limit)` on the intra-op threads of `ctx`, for subranges
+// covering [0, num_rows), where updating a row costs about `cost_per_row`.
+inline void ShardSparseRows(OpKernelContext* ctx, int64 num_rows,
+                            int64 cost_per_row,
+                            const std::function<void(int64, int64)>& fn) {
+  auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads->num_threads, worker_threads->workers, num_rows,
+        cost_per_row, fn);
+}
 }  // namespace
 
 namespace functor {
@@ -792,41 +903,41 @@ class SparseApplyAdadeltaOp : public OpKernel {
 
     if (N > 0) {
       const Tindex first_dim_size = var.dim_size(0);
-      // Validate all the indices are in range
-      auto indices_vec = indices.vec<Tindex>();
-      for (Tindex i = 0; i < N; i++) {
-        const Tindex index = indices_vec(i);
-        OP_REQUIRES(ctx, index >= 0 && index < first_dim_size,
-                    errors::InvalidArgument(
-                        strings::StrCat("Index ", index, " at offset ", i,
-                                        " in indices is out of range")));
-      }
+      std::vector<Tindex> unique_rows;
+      Tensor unique_grad;
+      OP_REQUIRES_OK(
+          ctx, UniqueSparseRows<T, Tindex>(ctx, indices, grad, first_dim_size,
+                                           &unique_rows, &unique_grad));
 
       auto var_flat = var.flat_outer_dims<T>();
       auto accum_grad_flat = accum_grad.flat_outer_dims<T>();
       auto accum_update_flat = accum_update.flat_outer_dims<T>();
-      auto grad_flat = grad.flat_outer_dims<T>();
+      auto grad_flat = unique_grad.flat_outer_dims<T>();
       const T lr_scalar = lr.scalar<T>()();
       const T rho_scalar = rho.scalar<T>()();
       const T epsilon_scalar = epsilon.scalar<T>()();
 
-      for (Tindex i = 0; i < N; i++) {
-        const Tindex index = indices_vec(i);
-        auto accum_ = accum_grad_flat.template chip<0>(index);
-        auto accum_update_ = accum_update_flat.template chip<0>(index);
-        auto grad_ = grad_flat.template chip<0>(i);
-
-        accum_ = accum_ * accum_.constant(rho_scalar) +
-                 grad_.square() * grad_.constant(T(1) - rho_scalar);
-        const auto update =
-            (accum_update_ + accum_update_.constant(epsilon_scalar)).sqrt() *
-            (accum_ + accum_.constant(epsilon_scalar)).rsqrt() * grad_;
-        auto v = var_flat.template chip<0>(index);
-        v -= update * update.constant(lr_scalar);
-        accum_update_ =
-            accum_update_ * accum_update_.constant(rho_scalar) +
-            update.square() * update.constant(static_cast<T>(1) - rho_scalar);
-      }
+      auto update_rows = [&](int64 start, int64 limit) {
+        for (int64 i = start; i < limit; i++) {
+          const Tindex index = unique_rows[i];
+          auto accum_ = accum_grad_flat.template chip<0>(index);
+          auto accum_update_ = accum_update_flat.template chip<0>(index);
+          auto grad_ = grad_flat.template chip<0>(i);
+
+          accum_ = accum_ * accum_.constant(rho_scalar) +
+                   grad_.square() * grad_.constant(T(1) - rho_scalar);
+          const auto update =
+              (accum_update_ + accum_update_.constant(epsilon_scalar)).sqrt() *
+              (accum_ + accum_.constant(epsilon_scalar)).rsqrt() * grad_;
+          auto v = var_flat.template chip<0>(index);
+          v -= update * update.constant(lr_scalar);
+          accum_update_ =
+              accum_update_ * accum_update_.constant(rho_scalar) +
+              update.square() * update.constant(static_cast<T>(1) - rho_scalar);
+        }
+      };
+      ShardSparseRows(ctx, unique_rows.size(), 30 * grad_flat.dimension(1),
+                      update_rows);
     }
 
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
@@ -983,69 +1094,69 @@ class SparseApplyProximalGradientDescentOp : public OpKernel {
                     "Inner dimension should be greater than zero."));
 
     if (N > 0) {
+      const Tindex first_dim_size = var.dim_size(0);
+      std::vector<Tindex> unique_rows;
+      Tensor unique_grad;
+      OP_REQUIRES_OK(
+          ctx, UniqueSparseRows<T, Tindex>(ctx, indices, grad, first_dim_size,
+                                           &unique_rows, &unique_grad));
       if (inner_dim > 1) {
-        const Tindex first_dim_size = var.dim_size(0);
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat_outer_dims<T>();
-        auto grad_flat = grad.flat_outer_dims<T>();
+        auto grad_flat = unique_grad.flat_outer_dims<T>();
         T lr_scalar = lr.scalar<T>()();
         T l1_scalar = l1.scalar<T>()();
         T l2_scalar = l2.scalar<T>()();
 
         // TODO(xbing): extract the common logic for the Fobos update.
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          auto g = grad_flat.template chip<0>(i);
-          auto v = var_flat.template chip<0>(index);
-          // compute learning_rate for current step.
-          auto learning_rate = v.constant(lr_scalar);
-          auto prox_v = v;
-          // v = w - g * learning_rate.
-          prox_v -= g * learning_rate;
-          if (l1_scalar > 0) {
-            // compute sign(v) * max(|v|, 0)
-            v = prox_v.sign() *
-                (prox_v.abs() - learning_rate * prox_v.constant(l1_scalar))
-                    .cwiseMax(static_cast<T>(0.0)) /
-                (v.constant(1.0) + v.constant(l2_scalar) * learning_rate);
-          } else {
-            v = prox_v /
-                (v.constant(1.0) + v.constant(l2_scalar) * learning_rate);
+        auto update_rows = [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; i++) {
+            const Tindex index = unique_rows[i];
+            auto g = grad_flat.template chip<0>(i);
+            auto v = var_flat.template chip<0>(index);
+            // compute learning_rate for current step.
+            auto learning_rate = v.constant(lr_scalar);
+            auto prox_v = v;
+            // v = w - g * learning_rate.
+            prox_v -= g * learning_rate;
+            if (l1_scalar > 0) {
+              // compute sign(v) * max(|v|, 0)
+              v = prox_v.sign() *
+                  (prox_v.abs() - learning_rate * prox_v.constant(l1_scalar))
+                      .cwiseMax(static_cast<T>(0.0)) /
+                  (v.constant(1.0) + v.constant(l2_scalar) * learning_rate);
+            } else {
+              v = prox_v /
+                  (v.constant(1.0) + v.constant(l2_scalar) * learning_rate);
+            }
           }
-        }
+        };
+        ShardSparseRows(ctx, unique_rows.size(), 10 * inner_dim, update_rows);
       } else {
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat<T>();
-        auto grad_flat = grad.flat<T>();
+        auto grad_flat = unique_grad.flat<T>();
         T lr_scalar = lr.scalar<T>()();
         T l1_scalar = l1.scalar<T>()();
         T l2_scalar = l2.scalar<T>()();
-        const Tindex first_dim_size = var_flat.size();
-
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          const T& g = grad_flat(i);
-          auto learning_rate = lr_scalar;
-          auto prox_v = var_flat(index);
-          prox_v -= learning_rate * g;
-          if (l1_scalar > 0) {
-            var_flat(index) =
-                sgn(prox_v) *
-                std::max(std::abs(prox_v) - learning_rate * l1_scalar,
-                         static_cast<T>(0.0)) /
-                (1.0 + l2_scalar * learning_rate);
-          } else {
-            var_flat(index) = prox_v / (1.0 + l2_scalar * learning_rate);
+
+        auto update_rows = [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; i++) {
+            const Tindex index = unique_rows[i];
+            const T& g = grad_flat(i);
+            auto learning_rate = lr_scalar;
+            auto prox_v = var_flat(index);
+            prox_v -= learning_rate * g;
+            if (l1_scalar > 0) {
+              var_flat(index) =
+                  sgn(prox_v) *
+                  std::max(std::abs(prox_v) - learning_rate * l1_scalar,
+                           static_cast<T>(0.0)) /
+                  (1.0 + l2_scalar * learning_rate);
+            } else {
+              var_flat(index) = prox_v / (1.0 + l2_scalar * learning_rate);
+            }
           }
-        }
+        };
+        ShardSparseRows(ctx, unique_rows.size(), 10 * inner_dim, update_rows);
       }
     }
 
@@ -1329,51 +1440,49 @@ class SparseApplyAdagradOp : public OpKernel {
                     "Inner dimension should be greater than zero."));
 
     if (N > 0) {
+      const Tindex first_dim_size = var.dim_size(0);
+      std::vector<Tindex> unique_rows;
+      Tensor unique_grad;
+      OP_REQUIRES_OK(
+          ctx, UniqueSparseRows<T, Tindex>(ctx, indices, grad, first_dim_size,
+                                           &unique_rows, &unique_grad));
       if (inner_dim > 1) {
-        const Tindex first_dim_size = var.dim_size(0);
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat_outer_dims<T>();
         auto accum_flat = accum.flat_outer_dims<T>();
-        auto grad_flat = grad.flat_outer_dims<T>();
+        auto grad_flat = unique_grad.flat_outer_dims<T>();
         T lr_scalar = lr.scalar<T>()();
 
-        // Note(yonghui): It might be worth multi-threading square() and
-        // rsqrt().
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          auto a = accum_flat.template chip<0>(index);
-          auto g = grad_flat.template chip<0>(i);
-          auto v = var_flat.template chip<0>(index);
-          if (update_slots_) {
-            a += g.square();
+        auto update_rows = [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; i++) {
+            const Tindex index = unique_rows[i];
+            auto a = accum_flat.template chip<0>(index);
+            auto g = grad_flat.template chip<0>(i);
+            auto v = var_flat.template chip<0>(index);
+            if (update_slots_) {
+              a += g.square();
+            }
+            v -= g.constant(lr_scalar) * g * a.rsqrt();
           }
-          v -= g.constant(lr_scalar) * g * a.rsqrt();
-        }
+        };
+        ShardSparseRows(ctx, unique_rows.size(), 10 * inner_dim, update_rows);
       } else {
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat<T>();
         auto accum_flat = accum.flat<T>();
-        auto grad_flat = grad.flat<T>();
+        auto grad_flat = unique_grad.flat<T>();
         T lr_scalar = lr.scalar<T>()();
-        const Tindex first_dim_size = accum_flat.size();
-
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          T& a = accum_flat(index);
-          const T& g = grad_flat(i);
-          if (update_slots_) {
-            a += g * g;
+
+        auto update_rows = [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; i++) {
+            const Tindex index = unique_rows[i];
+            T& a = accum_flat(index);
+            const T& g = grad_flat(i);
+            if (update_slots_) {
+              a += g * g;
+            }
+            var_flat(index) -= lr_scalar * g / Eigen::numext::sqrt(a);
           }
-          var_flat(index) -= lr_scalar * g / Eigen::numext::sqrt(a);
-        }
+        };
+        ShardSparseRows(ctx, unique_rows.size(), 10 * inner_dim, update_rows);
       }
     }
 
@@ -1486,74 +1595,74 @@ class SparseApplyProximalAdagradOp : public OpKernel {
                     "Inner dimension should be greater than zero."));
 
     if (N > 0) {
+      const Tindex first_dim_size = var.dim_size(0);
+      std::vector<Tindex> unique_rows;
+      Tensor unique_grad;
+      OP_REQUIRES_OK(
+          ctx, UniqueSparseRows<T, Tindex>(ctx, indices, grad, first_dim_size,
+                                           &unique_rows, &unique_grad));
       if (inner_dim > 1) {
-        const Tindex first_dim_size = var.dim_size(0);
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat_outer_dims<T>();
         auto accum_flat = accum.flat_outer_dims<T>();
-        auto grad_flat = grad.flat_outer_dims<T>();
+        auto grad_flat = unique_grad.flat_outer_dims<T>();
         T lr_scalar = lr.scalar<T>()();
         T l1_scalar = l1.scalar<T>()();
         T l2_scalar = l2.scalar<T>()();
 
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          auto a = accum_flat.template chip<0>(index);
-          auto g = grad_flat.template chip<0>(i);
-          auto v = var_flat.template chip<0>(index);
-          a += g.square();
-          // compute learning_rate for current step.
-          auto learning_rate = a.constant(lr_scalar) * a.rsqrt();
-          auto prox_v = v;
-          // v = w - g * learning_rate.
-          prox_v -= g * learning_rate;
-          if (l1_scalar > 0) {
-            // compute sign(v) * max(|v|, 0)
-            v = prox_v.sign() *
-                (prox_v.abs() - learning_rate * prox_v.constant(l1_scalar))
-                    .cwiseMax(static_cast<T>(0.0)) /
-                (v.constant(1.0) + v.constant(l2_scalar) * learning_rate);
-          } else {
-            v = prox_v /
-                (v.constant(1.0) + v.constant(l2_scalar) * learning_rate);
+        auto update_rows = [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; i++) {
+            const Tindex index = unique_rows[i];
+            auto a = accum_flat.template chip<0>(index);
+            auto g = grad_flat.template chip<0>(i);
+            auto v = var_flat.template chip<0>(index);
+            a += g.square();
+            // compute learning_rate for current step.
+            auto learning_rate = a.constant(lr_scalar) * a.rsqrt();
+            auto prox_v = v;
+            // v = w - g * learning_rate.
+            prox_v -= g * learning_rate;
+            if (l1_scalar > 0) {
+              // compute sign(v) * max(|v|, 0)
+              v = prox_v.sign() *
+                  (prox_v.abs() - learning_rate * prox_v.constant(l1_scalar))
+                      .cwiseMax(static_cast<T>(0.0)) /
+                  (v.constant(1.0) + v.constant(l2_scalar) * learning_rate);
+            } else {
+              v = prox_v /
+                  (v.constant(1.0) + v.constant(l2_scalar) * learning_rate);
+            }
           }
-        }
+        };
+        ShardSparseRows(ctx, unique_rows.size(), 20 * inner_dim, update_rows);
       } else {
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat<T>();
         auto accum_flat = accum.flat<T>();
-        auto grad_flat = grad.flat<T>();
+        auto grad_flat = unique_grad.flat<T>();
         T lr_scalar = lr.scalar<T>()();
         T l1_scalar = l1.scalar<T>()();
         T l2_scalar = l2.scalar<T>()();
-        const Tindex first_dim_size = accum_flat.size();
-
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          T& a = accum_flat(index);
-          const T& g = grad_flat(i);
-          a += g * g;
-          auto learning_rate = lr_scalar / std::sqrt(a);
-          auto prox_v = var_flat(index);
-          prox_v -= learning_rate * g;
-          if (l1_scalar > 0) {
-            var_flat(index) =
-                sgn(prox_v) *
-                std::max(std::abs(prox_v) - learning_rate * l1_scalar,
-                         static_cast<T>(0.0)) /
-                (1.0 + l2_scalar * learning_rate);
-          } else {
-            var_flat(index) = prox_v / (1.0 + l2_scalar * learning_rate);
+
+        auto update_rows = [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; i++) {
+            const Tindex index = unique_rows[i];
+            T& a = accum_flat(index);
+            const T& g = grad_flat(i);
+            a += g * g;
+            auto learning_rate = lr_scalar / std::sqrt(a);
+            auto prox_v = var_flat(index);
+            prox_v -= learning_rate * g;
+            if (l1_scalar > 0) {
+              var_flat(index) =
+                  sgn(prox_v) *
+                  std::max(std::abs(prox_v) - learning_rate * l1_scalar,
+                           static_cast<T>(0.0)) /
+                  (1.0 + l2_scalar * learning_rate);
+            } else {
+              var_flat(index) = prox_v / (1.0 + l2_scalar * learning_rate);
+            }
           }
-        }
+        };
+        ShardSparseRows(ctx, unique_rows.size(), 20 * inner_dim, update_rows);
       }
     }
 
@@ -1780,76 +1889,76 @@ class SparseApplyAdagradDAOp : public OpKernel {
     // gradient squared accumulator value.
     // w = \dfrac{sign(-g)*lr*|g - l1*T|_{+}}{l2*T*lr + \sqrt{k+gg})}
     if (N > 0) {
+      const Tindex first_dim_size = var.dim_size(0);
+      std::vector<Tindex> unique_rows;
+      Tensor unique_grad;
+      OP_REQUIRES_OK(
+          ctx, UniqueSparseRows<T, Tindex>(ctx, indices, grad, first_dim_size,
+                                           &unique_rows, &unique_grad));
       if (inner_dim > 1) {
-        const Tindex first_dim_size = var.dim_size(0);
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat_outer_dims<T>();
         auto gradient_accum_flat = gradient_accum.flat_outer_dims<T>();
         auto gradient_squared_accum_flat =
             gradient_squared_accum.flat_outer_dims<T>();
-        auto grad_flat = grad.flat_outer_dims<T>();
+        auto grad_flat = unique_grad.flat_outer_dims<T>();
         T lr_scalar = lr.scalar<T>()();
         T global_step_scalar = global_step.scalar<int64>()();
         T l1_scalar = l1.scalar<T>()();
         T l2_scalar = l2.scalar<T>()();
         const double gs_lr = global_step_scalar * lr_scalar;
 
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          auto ga = gradient_accum_flat.template chip<0>(index);
-          auto da = gradient_squared_accum_flat.template chip<0>(index);
-          auto g = grad_flat.template chip<0>(i);
-          auto v = var_flat.template chip<0>(index);
-          ga += g;
-          da += g.square();
-          if (l1_scalar > 0) {
-            v = ga.constant(-1.0) * ga.sign() *
-                ((ga.abs() / ga.constant(global_step_scalar)) -
-                 ga.constant(l1_scalar))
-                    .cwiseMax(static_cast<T>(0.0)) /
-                (v.constant(l2_scalar) + da.sqrt() / v.constant(gs_lr));
-          } else {
-            v = ga.constant(-1.0) * (ga / ga.constant(global_step_scalar)) /
-                (v.constant(l2_scalar) + da.sqrt() / v.constant(gs_lr));
+        auto update_rows = [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; i++) {
+            const Tindex index = unique_rows[i];
+            auto ga = gradient_accum_flat.template chip<0>(index);
+            auto da = gradient_squared_accum_flat.template chip<0>(index);
+            auto g = grad_flat.template chip<0>(i);
+            auto v = var_flat.template chip<0>(index);
+            ga += g;
+            da += g.square();
+            if (l1_scalar > 0) {
+              v = ga.constant(-1.0) * ga.sign() *
+                  ((ga.abs() / ga.constant(global_step_scalar)) -
+                   ga.constant(l1_scalar))
+                      .cwiseMax(static_cast<T>(0.0)) /
+                  (v.constant(l2_scalar) + da.sqrt() / v.constant(gs_lr));
+            } else {
+              v = ga.constant(-1.0) * (ga / ga.constant(global_step_scalar)) /
+                  (v.constant(l2_scalar) + da.sqrt() / v.constant(gs_lr));
+            }
           }
-        }
+        };
+        ShardSparseRows(ctx, unique_rows.size(), 20 * inner_dim, update_rows);
       } else {
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat<T>();
         auto gradient_accum_flat = gradient_accum.flat<T>();
         auto gradient_squared_accum_flat = gradient_squared_accum.flat<T>();
-        auto grad_flat = grad.flat<T>();
+        auto grad_flat = unique_grad.flat<T>();
         const double lr_scalar = lr.scalar<T>()();
         const int64 global_step_scalar = global_step.scalar<int64>()();
         const double l1_scalar = l1.scalar<T>()();
         const double l2_scalar = l2.scalar<T>()();
-        const Tindex first_dim_size = var_flat.size();
         const double gs_l1 = global_step_scalar * l1_scalar;
         const double gs_l2_lr = global_step_scalar * l2_scalar * lr_scalar;
 
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          T& ga = gradient_accum_flat(index);
-          T& da = gradient_squared_accum_flat(index);
-          const double g = grad_flat(i);
-          ga += g;
-          da += g * g;
-          if (l1_scalar > 0) {
-            var_flat(index) = sgn(-ga) * lr_scalar *
-                              std::max((std::abs(ga) - gs_l1), 0.0) /
-                              (gs_l2_lr + std::sqrt(da));
-          } else {
-            var_flat(index) = (-ga * lr_scalar) / (gs_l2_lr + std::sqrt(da));
+        auto update_rows = [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; i++) {
+            const Tindex index = unique_rows[i];
+            T& ga = gradient_accum_flat(index);
+            T& da = gradient_squared_accum_flat(index);
+            const double g = grad_flat(i);
+            ga += g;
+            da += g * g;
+            if (l1_scalar > 0) {
+              var_flat(index) = sgn(-ga) * lr_scalar *
+                                std::max((std::abs(ga) - gs_l1), 0.0) /
+                                (gs_l2_lr + std::sqrt(da));
+            } else {
+              var_flat(index) = (-ga * lr_scalar) / (gs_l2_lr + std::sqrt(da));
+            }
           }
-        }
+        };
+        ShardSparseRows(ctx, unique_rows.size(), 20 * inner_dim, update_rows);
       }
     }
 
@@ -2141,13 +2250,17 @@ class SparseApplyFtrlOp : public OpKernel {
     }
 
     if (N > 0) {
+      const Tindex first_dim_size = var.dim_size(0);
+      std::vector<Tindex> unique_rows;
+      Tensor unique_grad;
+      OP_REQUIRES_OK(
+          ctx, UniqueSparseRows<T, Tindex>(ctx, indices, grad, first_dim_size,
+                                           &unique_rows, &unique_grad));
       if (inner_dim > 1) {
-        const Tindex first_dim_size = var.dim_size(0);
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat_outer_dims<T>();
         auto accum_flat = accum.flat_outer_dims<T>();
         auto linear_flat = linear.flat_outer_dims<T>();
-        auto grad_flat = grad.flat_outer_dims<T>();
+        auto grad_flat = unique_grad.flat_outer_dims<T>();
         T lr_scalar = lr.scalar<T>()();
         T l1_scalar = l1.scalar<T>()();
         T l2_scalar = l2.scalar<T>()();
@@ -2157,16 +2270,13 @@ class SparseApplyFtrlOp : public OpKernel {
         }
         T lr_power_scalar = lr_power.scalar<T>()();
 
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          auto accum = accum_flat.template chip<0>(index);
-          auto linear = linear_flat.template chip<0>(index);
-          auto grad = grad_flat.template chip<0>(i);
-          auto var = var_flat.template chip<0>(index);
+        auto update_rows = [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; i++) {
+            const Tindex index = unique_rows[i];
+            auto accum = accum_flat.template chip<0>(index);
+            auto linear = linear_flat.template chip<0>(index);
+            auto grad = grad_flat.template chip<0>(i);
+            auto var = var_flat.template chip<0>(index);
 
 // Use a macro to implement the computation here due to the templating of the
 // eigen tensor library.
@@ -2193,14 +2303,16 @@ class SparseApplyFtrlOp : public OpKernel {
   }                                                                            \
   accum += grad.square();
 
-          if (has_l2_shrinkage) {
-            auto grad_with_shrinkage =
-                grad + static_cast<T>(2) * l2_shrinkage_scalar * var;
-            COMPUTE_FTRL(grad, grad_with_shrinkage);
-          } else {
-            COMPUTE_FTRL(grad, grad);
+            if (has_l2_shrinkage) {
+              auto grad_with_shrinkage =
+                  grad + static_cast<T>(2) * l2_shrinkage_scalar * var;
+              COMPUTE_FTRL(grad, grad_with_shrinkage);
+            } else {
+              COMPUTE_FTRL(grad, grad);
+            }
           }
-        }
+        };
+        ShardSparseRows(ctx, unique_rows.size(), 40 * inner_dim, update_rows);
 #undef COMPUTE_FTRL
       } else {
         T lr_scalar = lr.scalar<T>()();
@@ -2212,40 +2324,38 @@ class SparseApplyFtrlOp : public OpKernel {
           l2_shrinkage_scalar = l2_shrinkage->scalar<T>()();
         }
 
-        auto indices_vec = indices.vec<Tindex>();
         auto var_flat = var.flat<T>();
         auto accum_flat = accum.flat<T>();
         auto linear_flat = linear.flat<T>();
-        auto grad_flat = grad.flat<T>();
-        const Tindex first_dim_size = accum_flat.size();
-
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          T& a = accum_flat(index);
-          T& l = linear_flat(index);
-          T& v = var_flat(index);
-          T g;
-          if (has_l2_shrinkage) {
-            g = grad_flat(i) +
-                (static_cast<T>(2) * l2_shrinkage_scalar * var_flat(index));
-          } else {
-            g = grad_flat(i);
+        auto grad_flat = unique_grad.flat<T>();
+
+        auto update_rows = [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; i++) {
+            const Tindex index = unique_rows[i];
+            T& a = accum_flat(index);
+            T& l = linear_flat(index);
+            T& v = var_flat(index);
+            T g;
+            if (has_l2_shrinkage) {
+              g = grad_flat(i) +
+                  (static_cast<T>(2) * l2_shrinkage_scalar * var_flat(index));
+            } else {
+              g = grad_flat(i);
+            }
+
+            T updated_a = a + grad_flat(i) * grad_flat(i);
+            using Eigen::numext::pow;
+            T sigma =
+                pow(updated_a, -lr_power_scalar) - pow(a, -lr_power_scalar);
+            sigma /= lr_scalar;
+            T updated_l = l + g - sigma * v;
+            v = FtrlCompute(updated_a, updated_l, lr_scalar, l1_scalar,
+                            l2_scalar, lr_power_scalar);
+            a = updated_a;
+            l = updated_l;
           }
-
-          T updated_a = a + grad_flat(i) * grad_flat(i);
-          using Eigen::numext::pow;
-          T sigma = pow(updated_a, -lr_power_scalar) - pow(a, -lr_power_scalar);
-          sigma /= lr_scalar;
-          T updated_l = l + g - sigma * v;
-          v = FtrlCompute(updated_a, updated_l, lr_scalar, l1_scalar, l2_scalar,
-                          lr_power_scalar);
-          a = updated_a;
-          l = updated_l;
-        }
+        };
+        ShardSparseRows(ctx, unique_rows.size(), 40 * inner_dim, update_rows);
       }
     }
 
@@ -2468,30 +2578,34 @@ class SparseApplyMomentumOp : public OpKernel {
 
     if (N > 0) {
       const Tindex first_dim_size = var.dim_size(0);
-      auto indices_vec = indices.vec<Tindex>();
+      std::vector<Tindex> unique_rows;
+      Tensor unique_grad;
+      OP_REQUIRES_OK(
+          ctx, UniqueSparseRows<T, Tindex>(ctx, indices, grad, first_dim_size,
+                                           &unique_rows, &unique_grad));
       auto var_flat = var.flat_outer_dims<T>();
       auto accum_flat = accum.flat_outer_dims<T>();
-      auto grad_flat = grad.flat_outer_dims<T>();
+      auto grad_flat = unique_grad.flat_outer_dims<T>();
       T lr_scalar = lr.scalar<T>()();
       T momentum_scalar = momentum.scalar<T>()();
 
-      for (Tindex i = 0; i < N; i++) {
-        const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-        OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                    errors::InvalidArgument(
-                        strings::StrCat("Index ", index, " at offset ", i,
-                                        " in indices is out of range")));
-        auto a = accum_flat.template chip<0>(index);
-        auto g = grad_flat.template chip<0>(i);
-        auto v = var_flat.template chip<0>(index);
-        a = a * a.constant(momentum_scalar) + g;
-        if (use_nesterov_) {
-          v -= g.constant(lr_scalar) * g +
-               a.constant(lr_scalar) * a.constant(momentum_scalar) * a;
-        } else {
-          v -= a.constant(lr_scalar) * a;
+      auto update_rows = [&](int64 start, int64 limit) {
+        for (int64 i = start; i < limit; i++) {
+          const Tindex index = unique_rows[i];
+          auto a = accum_flat.template chip<0>(index);
+          auto g = grad_flat.template chip<0>(i);
+          auto v = var_flat.template chip<0>(index);
+          a = a * a.constant(momentum_scalar) + g;
+          if (use_nesterov_) {
+            v -= g.constant(lr_scalar) * g +
+                 a.constant(lr_scalar) * a.constant(momentum_scalar) * a;
+          } else {
+            v -= a.constant(lr_scalar) * a;
+          }
         }
-      }
+      };
+      ShardSparseRows(ctx, unique_rows.size(), 5 * grad_flat.dimension(1),
+                      update_rows);
     }
 
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
@@ -3238,41 +3352,41 @@ class SparseApplyRMSPropOp : public OpKernel {
 
     if (N > 0) {
       const Tindex first_dim_size = var.dim_size(0);
-      // Validate all the indices are in range
-      auto indices_vec = indices.vec<Tindex>();
-      for (Tindex i = 0; i < N; i++) {
-        const Tindex index = indices_vec(i);
-        OP_REQUIRES(ctx, index >= 0 && index < first_dim_size,
-                    errors::InvalidArgument(
-                        strings::StrCat("Index ", index, " at offset ", i,
-                                        " in indices is out of range")));
-      }
+      std::vector<Tindex> unique_rows;
+      Tensor unique_grad;
+      OP_REQUIRES_OK(
+          ctx, UniqueSparseRows<T, Tindex>(ctx, indices, grad, first_dim_size,
+                                           &unique_rows, &unique_grad));
 
       auto var_flat = var.flat_outer_dims<T>();
       auto ms_flat = ms.flat_outer_dims<T>();
       auto mom_flat = mom.flat_outer_dims<T>();
-      auto grad_flat = grad.flat_outer_dims<T>();
+      auto grad_flat = unique_grad.flat_outer_dims<T>();
       const T lr_scalar = lr.scalar<T>()();
       const T rho_scalar = rho.scalar<T>()();
       const T epsilon_scalar = epsilon.scalar<T>()();
       const T momentum_scalar = momentum.scalar<T>()();
 
-      for (Tindex i = 0; i < N; i++) {
-        const Tindex index = indices_vec(i);
+      auto update_rows = [&](int64 start, int64 limit) {
+        for (int64 i = start; i < limit; i++) {
+          const Tindex index = unique_rows[i];
 
-        auto ms_ = ms_flat.template chip<0>(index);
-        auto mom_ = mom_flat.template chip<0>(index);
-        auto grad_ = grad_flat.template chip<0>(i);
+          auto ms_ = ms_flat.template chip<0>(index);
+          auto mom_ = mom_flat.template chip<0>(index);
+          auto grad_ = grad_flat.template chip<0>(i);
 
-        ms_ = ms_ * ms_.constant(rho_scalar) +
-              grad_.square() * grad_.constant(T(1) - rho_scalar);
-        mom_ = mom_ * mom_.constant(momentum_scalar) +
-               (ms_ + ms_.constant(epsilon_scalar)).rsqrt() *
-                   ms_.constant(lr_scalar) * grad_;
+          ms_ = ms_ * ms_.constant(rho_scalar) +
+                grad_.square() * grad_.constant(T(1) - rho_scalar);
+          mom_ = mom_ * mom_.constant(momentum_scalar) +
+                 (ms_ + ms_.constant(epsilon_scalar)).rsqrt() *
+                     ms_.constant(lr_scalar) * grad_;
 
-        auto v = var_flat.template chip<0>(index);
-        v -= mom_;
-      }
+          auto v = var_flat.template chip<0>(index);
+          v -= mom_;
+        }
+      };
+      ShardSparseRows(ctx, unique_rows.size(), 20 * grad_flat.dimension(1),
+                      update_rows);
     }
 
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
@@ -3375,45 +3489,45 @@ class SparseApplyCenteredRMSPropOp : public OpKernel {
 
     if (N > 0) {
       const Tindex first_dim_size = var.dim_size(0);
-      // Validate all the indices are in range
-      auto indices_vec = indices.vec<Tindex>();
-      for (Tindex i = 0; i < N; i++) {
-        const Tindex index = indices_vec(i);
-        OP_REQUIRES(ctx, index >= 0 && index < first_dim_size,
-                    errors::InvalidArgument(
-                        strings::StrCat("Index ", index, " at offset ", i,
-                                        " in indices is out of range")));
-      }
+      std::vector<Tindex> unique_rows;
+      Tensor unique_grad;
+      OP_REQUIRES_OK(
+          ctx, UniqueSparseRows<T, Tindex>(ctx, indices, grad, first_dim_size,
+                                           &unique_rows, &unique_grad));
 
       auto var_flat = var.flat_outer_dims<T>();
       auto ms_flat = ms.flat_outer_dims<T>();
       auto mg_flat = mg.flat_outer_dims<T>();
       auto mom_flat = mom.flat_outer_dims<T>();
-      auto grad_flat = grad.flat_outer_dims<T>();
+      auto grad_flat = unique_grad.flat_outer_dims<T>();
       const T lr_scalar = lr.scalar<T>()();
       const T rho_scalar = rho.scalar<T>()();
       const T epsilon_scalar = epsilon.scalar<T>()();
       const T momentum_scalar = momentum.scalar<T>()();
 
-      for (Tindex i = 0; i < N; i++) {
-        const Tindex index = indices_vec(i);
+      auto update_rows = [&](int64 start, int64 limit) {
+        for (int64 i = start; i < limit; i++) {
+          const Tindex index = unique_rows[i];
 
-        auto ms_ = ms_flat.template chip<0>(index);
-        auto mom_ = mom_flat.template chip<0>(index);
-        auto grad_ = grad_flat.template chip<0>(i);
+          auto ms_ = ms_flat.template chip<0>(index);
+          auto mom_ = mom_flat.template chip<0>(index);
+          auto grad_ = grad_flat.template chip<0>(i);
 
-        ms_ = ms_ * ms_.constant(rho_scalar) +
-              grad_.square() * grad_.constant(T(1) - rho_scalar);
+          ms_ = ms_ * ms_.constant(rho_scalar) +
+                grad_.square() * grad_.constant(T(1) - rho_scalar);
 
-        auto mg_ = mg_flat.template chip<0>(index);
-        mg_ = mg_ * mg_.constant(rho_scalar) +
-              grad_ * grad_.constant(T(1) - rho_scalar);
-        auto denom_ = ms_ + ms_.constant(epsilon_scalar) - mg_.square();
-        mom_ = mom_ * mom_.constant(momentum_scalar) +
-               denom_.rsqrt() * ms_.constant(lr_scalar) * grad_;
-        auto v = var_flat.template chip<0>(index);
-        v -= mom_;
-      }
+          auto mg_ = mg_flat.template chip<0>(index);
+          mg_ = mg_ * mg_.constant(rho_scalar) +
+                grad_ * grad_.constant(T(1) - rho_scalar);
+          auto denom_ = ms_ + ms_.constant(epsilon_scalar) - mg_.square();
+          mom_ = mom_ * mom_.constant(momentum_scalar) +
+                 denom_.rsqrt() * ms_.constant(lr_scalar) * grad_;
+          auto v = var_flat.template chip<0>(index);
+          v -= mom_;
+        }
+      };
+      ShardSparseRows(ctx, unique_rows.size(), 30 * grad_flat.dimension(1),
+                      update_rows);
     }
 
     MaybeForwardRefInputToRefOutput(ctx, 0, 0);
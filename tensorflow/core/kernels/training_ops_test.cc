@@ -13,9 +13,13 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <cmath>
+
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/public/session_options.h"
@@ -308,4 +312,129 @@ static void BM_PowerSign(int iters, int params) {
 }
 BENCHMARK(BM_PowerSign)->Arg(128 << 10)->Arg(256 << 10);
 
+// The sparse training ops update an embedding of kSparseRows rows, with
+// kSparseIndices indices per step.  The indices are skewed towards the first
+// rows, so that a step has duplicate indices as in real embeddings.
+static const int kSparseRows = 256 << 10;
+static const int kSparseIndices = 100000;
+
+static Node* Var(Graph* g, int rows, int dim) {
+  return test::graph::Var(g, DT_FLOAT, TensorShape({rows, dim}));
+}
+
+static Node* Zeros(Graph* g, int rows, int dim) {
+  Tensor data(DT_FLOAT, TensorShape({rows, dim}));
+  data.flat<float>().setZero();
+  return test::graph::Constant(g, data);
+}
+
+static Node* Random(Graph* g, int rows, int dim) {
+  Tensor data(DT_FLOAT, TensorShape({rows, dim}));
+  data.flat<float>().setRandom();
+  return test::graph::Constant(g, data);
+}
+
+static Node* SkewedIndices(Graph* g, int n, int rows) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor data(DT_INT32, TensorShape({n}));
+  auto indices = data.flat<int32>();
+  for (int i = 0; i < n; ++i) {
+    indices(i) = static_cast<int32>(rows * std::pow(rnd.RandDouble(), 4));
+  }
+  return test::graph::Constant(g, data);
+}
+
+static SessionOptions MultiThreadedOptions(int num_threads) {
+  SessionOptions opts;
+  opts.config.set_intra_op_parallelism_threads(num_threads);
+  opts.config.set_inter_op_parallelism_threads(1);
+  return opts;
+}
+
+// Adds the initialization of `num_slots` variables of shape [rows, dim] to a
+// new graph.
+static Graph* InitSparse(int num_slots, int rows, int dim) {
+  Graph* g = new Graph(OpRegistry::Global());
+  std::vector<Node*> vars;
+  for (int i = 0; i < num_slots; ++i) {
+    vars.push_back(Var(g, rows, dim));
+  }
+  auto zero = Zeros(g, rows, dim);
+  for (Node* var : vars) {
+    test::graph::Assign(g, var, zero);
+  }
+  return g;
+}
+
+static void RunSparse(int iters, int dim, int num_threads, Graph* init,
+                      Graph* train) {
+  const int64 tot = static_cast<int64>(iters) * kSparseIndices * dim;
+  testing::ItemsProcessed(tot);
+  testing::BytesProcessed(tot * sizeof(float));
+  SessionOptions opts = MultiThreadedOptions(num_threads);
+  test::Benchmark("cpu", train, &opts, init).Run(iters);
+}
+
+static void BM_SparseAdagrad(int iters, int dim, int num_threads) {
+  Graph* init = InitSparse(2, kSparseRows, dim);
+  Graph* g = new Graph(OpRegistry::Global());
+  auto var = Var(g, kSparseRows, dim);
+  auto accum = Var(g, kSparseRows, dim);
+  auto lr = Scalar(g, 0.01);
+  auto grad = Random(g, kSparseIndices, dim);
+  auto indices = SkewedIndices(g, kSparseIndices, kSparseRows);
+  test::graph::Multi(g, "SparseApplyAdagrad", {var, accum, lr, grad, indices});
+  RunSparse(iters, dim, num_threads, init, g);
+}
+BENCHMARK(BM_SparseAdagrad)
+    ->ArgPair(16, 1)
+    ->ArgPair(16, 4)
+    ->ArgPair(64, 1)
+    ->ArgPair(64, 4)
+    ->ArgPair(64, 16);
+
+static void BM_SparseFtrl(int iters, int dim, int num_threads) {
+  Graph* init = InitSparse(3, kSparseRows, dim);
+  Graph* g = new Graph(OpRegistry::Global());
+  auto var = Var(g, kSparseRows, dim);
+  auto accum = Var(g, kSparseRows, dim);
+  auto linear = Var(g, kSparseRows, dim);
+  auto grad = Random(g, kSparseIndices, dim);
+  auto indices = SkewedIndices(g, kSparseIndices, kSparseRows);
+  auto lr = Scalar(g, 0.01);
+  auto l1 = Scalar(g, 0.001);
+  auto l2 = Scalar(g, 0.001);
+  auto lr_power = Scalar(g, -0.5);
+  test::graph::Multi(g, "SparseApplyFtrl",
+                     {var, accum, linear, grad, indices, lr, l1, l2, lr_power});
+  RunSparse(iters, dim, num_threads, init, g);
+}
+BENCHMARK(BM_SparseFtrl)
+    ->ArgPair(16, 1)
+    ->ArgPair(16, 4)
+    ->ArgPair(64, 1)
+    ->ArgPair(64, 4)
+    ->ArgPair(64, 16);
+
+static void BM_SparseMomentum(int iters, int dim, int num_threads) {
+  Graph* init = InitSparse(2, kSparseRows, dim);
+  Graph* g = new Graph(OpRegistry::Global());
+  auto var = Var(g, kSparseRows, dim);
+  auto accum = Var(g, kSparseRows, dim);
+  auto lr = Scalar(g, 0.01);
+  auto grad = Random(g, kSparseIndices, dim);
+  auto indices = SkewedIndices(g, kSparseIndices, kSparseRows);
+  auto mom = Scalar(g, 0.01);
+  test::graph::Multi(g, "SparseApplyMomentum",
+                     {var, accum, lr, grad, indices, mom});
+  RunSparse(iters, dim, num_threads, init, g);
+}
+BENCHMARK(BM_SparseMomentum)
+    ->ArgPair(16, 1)
+    ->ArgPair(16, 4)
+    ->ArgPair(64, 1)
+    ->ArgPair(64, 4)
+    ->ArgPair(64, 16);
+
 }  // end namespace tensorflow
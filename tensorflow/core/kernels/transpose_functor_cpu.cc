@@ -15,7 +15,10 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <complex>
+#include <cstring>
+#include <type_traits>
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/attr_value.pb.h"
@@ -65,45 +68,250 @@ void TransposeSimple(const CPUDevice& device, const Tensor& in,
   device.parallelFor(in.NumElements(), cost, std::move(transpose_fn));
 }
 
+// The tiled transpose below moves elements in square tiles of kTileBytes per
+// row, so that a tile reads and writes whole cache lines, and the tiles are
+// grouped into blocks of about kBlockBytes squared that are distributed over
+// the intra-op threads.
+constexpr int64 kTileBytes = 64;
+constexpr int64 kBlockBytes = 256;
+
+// Transposes the rows x cols matrix at src, whose rows are src_stride
+// elements apart, into the cols x rows matrix at dst, whose rows are
+// dst_stride elements apart.
+template <typename T>
+void TransposeBlock(const T* src, int64 src_stride, T* dst, int64 dst_stride,
+                    int64 rows, int64 cols) {
+  constexpr int64 kTile = kTileBytes / sizeof(T) > 4 ? kTileBytes / sizeof(T)
+                                                     : 4;
+  for (int64 r0 = 0; r0 < rows; r0 += kTile) {
+    for (int64 c0 = 0; c0 < cols; c0 += kTile) {
+      const T* s = src + r0 * src_stride + c0;
+      T* d = dst + c0 * dst_stride + r0;
+      if (r0 + kTile <= rows && c0 + kTile <= cols) {
+        // Full tiles have constant trip counts, which lets the compiler unroll
+        // and vectorize them.
+        for (int64 c = 0; c < kTile; ++c) {
+          for (int64 r = 0; r < kTile; ++r) {
+            d[c * dst_stride + r] = s[r * src_stride + c];
+          }
+        }
+      } else {
+        const int64 tile_rows = std::min(kTile, rows - r0);
+        const int64 tile_cols = std::min(kTile, cols - c0);
+        for (int64 c = 0; c < tile_cols; ++c) {
+          for (int64 r = 0; r < tile_rows; ++r) {
+            d[c * dst_stride + r] = s[r * src_stride + c];
+          }
+        }
+      }
+    }
+  }
+}
+
+// Transposes element types that can be copied bit for bit. The dimensions
+// that stay adjacent are merged first, which turns e.g. NHWC <-> NCHW into a
+// batch of matrix transposes. Then either
+//  - the innermost dimension stays innermost, and the output is a gather of
+//    contiguous rows, or
+//  - the innermost input dimension y and the input dimension x that becomes
+//    innermost in the output span a strided matrix for every position in the
+//    other dimensions, which is transposed block by block.
+template <typename T>
+void TransposeTiled(const CPUDevice& device, const Tensor& in,
+                    const gtl::ArraySlice<int32> perm, Tensor* out) {
+  internal::TransposePermsVec positions;
+  internal::TransposeDimsVec dims(in.dims());
+  internal::ReduceTransposeDimensions(in.shape(), perm, &positions, &dims);
+  const int ndims = positions.size();
+  // ReduceTransposeDimensions gives the output position of every input
+  // dimension, while p maps output dimensions to input dimensions like perm.
+  internal::TransposePermsVec p(ndims);
+  for (int k = 0; k < ndims; ++k) p[positions[k]] = k;
+
+  const T* src = reinterpret_cast<const T*>(in.tensor_data().data());
+  T* dst = reinterpret_cast<T*>(const_cast<char*>(out->tensor_data().data()));
+  const int64 num_elements = in.NumElements();
+  if (num_elements == 0) return;
+
+  // Strides of the input dimensions in the input and in the output.
+  gtl::InlinedVector<int64, 8> in_strides(ndims);
+  gtl::InlinedVector<int64, 8> out_strides(ndims);
+  int64 stride = 1;
+  for (int k = ndims - 1; k >= 0; --k) {
+    in_strides[k] = stride;
+    stride *= dims[k];
+  }
+  stride = 1;
+  for (int i = ndims - 1; i >= 0; --i) {
+    out_strides[p[i]] = stride;
+    stride *= dims[p[i]];
+  }
+
+  const int64 inner = dims[ndims - 1];
+  if (p[ndims - 1] == ndims - 1) {
+    // Copies rows of the innermost dimension, walking the output in order.
+    // This also covers the identity permutation, as a single row.
+    const int64 num_rows = num_elements / inner;
+    auto copy_rows = [=, &p, &dims, &in_strides](int64 begin, int64 end) {
+      // The input offset of the output row is found from its coordinates in
+      // the outer output dimensions, which are then advanced odometer-style.
+      gtl::InlinedVector<int64, 8> coords(ndims - 1);
+      int64 in_offset = 0;
+      int64 t = begin;
+      for (int i = ndims - 2; i >= 0; --i) {
+        coords[i] = t % dims[p[i]];
+        t /= dims[p[i]];
+        in_offset += coords[i] * in_strides[p[i]];
+      }
+      for (int64 row = begin; row < end; ++row) {
+        memcpy(dst + row * inner, src + in_offset, inner * sizeof(T));
+        for (int i = ndims - 2; i >= 0; --i) {
+          in_offset += in_strides[p[i]];
+          if (++coords[i] < dims[p[i]]) break;
+          in_offset -= coords[i] * in_strides[p[i]];
+          coords[i] = 0;
+        }
+      }
+    };
+    const Eigen::TensorOpCost cost(/*bytes_loaded=*/inner * sizeof(T),
+                                   /*bytes_stored=*/inner * sizeof(T),
+                                   /*compute_cycles=*/ndims);
+    device.parallelFor(num_rows, cost, std::move(copy_rows));
+    return;
+  }
+
+  // x is the input dimension that becomes innermost in the output, and y the
+  // innermost input dimension.
+  const int x = p[ndims - 1];
+  const int y = ndims - 1;
+  const int64 x_size = dims[x];
+  const int64 y_size = dims[y];
+  // The other dimensions, in output order.
+  gtl::InlinedVector<int, 8> others;
+  for (int i = 0; i < ndims; ++i) {
+    if (p[i] != x && p[i] != y) others.push_back(p[i]);
+  }
+
+  // Blocks are about kBlock x kBlock, but stretched along one dimension when
+  // the other one is short, so that a block always moves a good amount of
+  // data.
+  constexpr int64 kBlock = kBlockBytes / sizeof(T) > 16
+                               ? kBlockBytes / sizeof(T)
+                               : 16;
+  int64 block_x = std::min(x_size, kBlock);
+  int64 block_y = std::min(y_size, kBlock);
+  if (block_y < kBlock) {
+    block_x = std::min(x_size, kBlock * kBlock / block_y);
+  } else if (block_x < kBlock) {
+    block_y = std::min(y_size, kBlock * kBlock / block_x);
+  }
+  const int64 blocks_x = (x_size + block_x - 1) / block_x;
+  const int64 blocks_y = (y_size + block_y - 1) / block_y;
+  const int64 num_matrices = num_elements / (x_size * y_size);
+
+  const int64 src_stride = in_strides[x];
+  const int64 dst_stride = out_strides[y];
+  auto transpose_blocks = [=, &dims, &in_strides, &out_strides, &others](
+                              int64 begin, int64 end) {
+    for (int64 unit = begin; unit < end; ++unit) {
+      const int64 bx = unit % blocks_x;
+      const int64 by = (unit / blocks_x) % blocks_y;
+      int64 t = unit / (blocks_x * blocks_y);
+      int64 in_offset = 0;
+      int64 out_offset = 0;
+      for (int j = static_cast<int>(others.size()) - 1; j >= 0; --j) {
+        const int k = others[j];
+        const int64 coord = t % dims[k];
+        t /= dims[k];
+        in_offset += coord * in_strides[k];
+        out_offset += coord * out_strides[k];
+      }
+      const int64 x0 = bx * block_x;
+      const int64 y0 = by * block_y;
+      TransposeBlock<T>(src + in_offset + x0 * src_stride + y0, src_stride,
+                        dst + out_offset + y0 * dst_stride + x0, dst_stride,
+                        std::min(block_x, x_size - x0),
+                        std::min(block_y, y_size - y0));
+    }
+  };
+  const Eigen::TensorOpCost cost(
+      /*bytes_loaded=*/block_x * block_y * sizeof(T),
+      /*bytes_stored=*/block_x * block_y * sizeof(T),
+      /*compute_cycles=*/block_x * block_y + 4 * ndims);
+  device.parallelFor(num_matrices * blocks_y * blocks_x, cost,
+                     std::move(transpose_blocks));
+}
+
+// Strings need their copy assignment, and conjugation is not a plain copy;
+// everything else goes through the tiled transpose.
+template <typename T, bool conjugate>
+struct UseTiledTranspose {
+  static constexpr bool value = !conjugate && !std::is_same<T, string>::value;
+};
+
+template <typename T, bool conjugate>
+void TransposeUsingEigenOrSimple(const CPUDevice& d, const Tensor& in,
+                                 const gtl::ArraySlice<int32> perm,
+                                 Tensor* out) {
+  switch (in.dims()) {
+    case 2:
+      internal::TransposeUsingEigen<CPUDevice, T, 2>(d, in, perm, conjugate,
+                                                     out);
+      break;
+    case 3:
+      internal::TransposeUsingEigen<CPUDevice, T, 3>(d, in, perm, conjugate,
+                                                     out);
+      break;
+    case 4:
+      internal::TransposeUsingEigen<CPUDevice, T, 4>(d, in, perm, conjugate,
+                                                     out);
+      break;
+    case 5:
+      internal::TransposeUsingEigen<CPUDevice, T, 5>(d, in, perm, conjugate,
+                                                     out);
+      break;
+    case 6:
+      internal::TransposeUsingEigen<CPUDevice, T, 6>(d, in, perm, conjugate,
+                                                     out);
+      break;
+    case 7:
+      internal::TransposeUsingEigen<CPUDevice, T, 7>(d, in, perm, conjugate,
+                                                     out);
+      break;
+    case 8:
+      internal::TransposeUsingEigen<CPUDevice, T, 8>(d, in, perm, conjugate,
+                                                     out);
+      break;
+    default:
+      TransposeSimple<T, conjugate>(d, in, perm, out);
+      break;
+  }
+}
+
+template <typename T, bool conjugate>
+void TransposeCPU(const CPUDevice& d, const Tensor& in,
+                  const gtl::ArraySlice<int32> perm, Tensor* out,
+                  std::true_type use_tiled) {
+  TransposeTiled<T>(d, in, perm, out);
+}
+
+template <typename T, bool conjugate>
+void TransposeCPU(const CPUDevice& d, const Tensor& in,
+                  const gtl::ArraySlice<int32> perm, Tensor* out,
+                  std::false_type use_tiled) {
+  TransposeUsingEigenOrSimple<T, conjugate>(d, in, perm, out);
+}
+
 }  // namespace
 
 template <typename T, bool conjugate>
 struct Transpose<CPUDevice, T, conjugate> {
   static void run(const CPUDevice& d, const Tensor& in,
                   const gtl::ArraySlice<int32> perm, Tensor* out) {
-    switch (in.dims()) {
-      case 2:
-        internal::TransposeUsingEigen<CPUDevice, T, 2>(d, in, perm, conjugate,
-                                                       out);
-        break;
-      case 3:
-        internal::TransposeUsingEigen<CPUDevice, T, 3>(d, in, perm, conjugate,
-                                                       out);
-        break;
-      case 4:
-        internal::TransposeUsingEigen<CPUDevice, T, 4>(d, in, perm, conjugate,
-                                                       out);
-        break;
-      case 5:
-        internal::TransposeUsingEigen<CPUDevice, T, 5>(d, in, perm, conjugate,
-                                                       out);
-        break;
-      case 6:
-        internal::TransposeUsingEigen<CPUDevice, T, 6>(d, in, perm, conjugate,
-                                                       out);
-        break;
-      case 7:
-        internal::TransposeUsingEigen<CPUDevice, T, 7>(d, in, perm, conjugate,
-                                                       out);
-        break;
-      case 8:
-        internal::TransposeUsingEigen<CPUDevice, T, 8>(d, in, perm, conjugate,
-                                                       out);
-        break;
-      default:
-        TransposeSimple<T, conjugate>(d, in, perm, out);
-        break;
-    }
+    TransposeCPU<T, conjugate>(
+        d, in, perm, out,
+        std::integral_constant<bool,
+                               UseTiledTranspose<T, conjugate>::value>());
   }
 };
 
@@ -0,0 +1,145 @@
+/* Copyright 2015 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/transpose_functor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+template <typename T>
+T MakeValue(int64 i) {
+  return static_cast<T>(i);
+}
+
+template <>
+string MakeValue<string>(int64 i) {
+  return strings::StrCat(i);
+}
+
+template <>
+complex128 MakeValue<complex128>(int64 i) {
+  return complex128(i, -i);
+}
+
+// Compares DoTranspose on a thread pool with a transpose that computes the
+// input index of every output element.
+template <typename T>
+void CheckTranspose(const TensorShape& shape, const std::vector<int32>& perm) {
+  Tensor in(DataTypeToEnum<T>::value, shape);
+  auto in_flat = in.flat<T>();
+  for (int64 i = 0; i < in.NumElements(); ++i) in_flat(i) = MakeValue<T>(i);
+
+  TensorShape out_shape;
+  for (int32 d : perm) out_shape.AddDim(shape.dim_size(d));
+  Tensor expected(DataTypeToEnum<T>::value, out_shape);
+  auto expected_flat = expected.flat<T>();
+  std::vector<int64> in_strides(shape.dims(), 1);
+  for (int i = shape.dims() - 2; i >= 0; --i) {
+    in_strides[i] = in_strides[i + 1] * shape.dim_size(i + 1);
+  }
+  for (int64 o = 0; o < expected.NumElements(); ++o) {
+    int64 t = o;
+    int64 i_idx = 0;
+    for (int i = shape.dims() - 1; i >= 0; --i) {
+      i_idx += (t % out_shape.dim_size(i)) * in_strides[perm[i]];
+      t /= out_shape.dim_size(i);
+    }
+    expected_flat(o) = in_flat(i_idx);
+  }
+
+  Eigen::ThreadPool pool(4);
+  CPUDevice device(&pool, 4);
+  Tensor out(DataTypeToEnum<T>::value, out_shape);
+  TF_ASSERT_OK(DoTranspose(device, in, perm, &out));
+  test::ExpectTensorEqual<T>(expected, out);
+}
+
+template <typename T>
+void CheckAllPermutations(const TensorShape& shape) {
+  std::vector<int32> perm(shape.dims());
+  std::iota(perm.begin(), perm.end(), 0);
+  do {
+    CheckTranspose<T>(shape, perm);
+  } while (std::next_permutation(perm.begin(), perm.end()));
+}
+
+TEST(TransposeFunctorTest, AllPermutations4D) {
+  // Sizes that are not multiples of the tiles, and a short innermost
+  // dimension.
+  CheckAllPermutations<uint8>({3, 17, 67, 5});
+  CheckAllPermutations<uint16>({3, 17, 67, 5});
+  CheckAllPermutations<float>({3, 17, 67, 5});
+  CheckAllPermutations<double>({3, 17, 67, 5});
+  CheckAllPermutations<complex128>({3, 17, 19, 5});
+  CheckAllPermutations<string>({2, 3, 5, 7});
+}
+
+TEST(TransposeFunctorTest, LayoutConversions) {
+  // NHWC <-> NCHW and NDHWC <-> NCDHW.
+  CheckTranspose<float>({2, 33, 35, 3}, {0, 3, 1, 2});
+  CheckTranspose<float>({2, 3, 33, 35}, {0, 2, 3, 1});
+  CheckTranspose<uint8>({2, 33, 35, 64}, {0, 3, 1, 2});
+  CheckTranspose<uint8>({2, 64, 33, 35}, {0, 2, 3, 1});
+  CheckTranspose<uint16>({2, 5, 9, 11, 24}, {0, 4, 1, 2, 3});
+  CheckTranspose<double>({2, 24, 5, 9, 11}, {0, 2, 3, 4, 1});
+}
+
+TEST(TransposeFunctorTest, LongAndShortDimensions) {
+  // Blocks are stretched along the long dimension.
+  CheckTranspose<float>({2, 10000, 3}, {0, 2, 1});
+  CheckTranspose<float>({2, 3, 10000}, {0, 2, 1});
+  CheckTranspose<uint8>({1000, 1}, {1, 0});
+  CheckTranspose<double>({300, 700}, {1, 0});
+}
+
+TEST(TransposeFunctorTest, ManyDimensions) {
+  CheckTranspose<float>({2, 3, 2, 3, 2, 3, 2, 3, 2},
+                        {8, 6, 4, 2, 0, 1, 3, 5, 7});
+  CheckTranspose<uint8>({2, 3, 2, 3, 2, 3, 2, 3, 2},
+                        {0, 1, 2, 3, 4, 5, 6, 8, 7});
+}
+
+TEST(TransposeFunctorTest, ConjugateTranspose) {
+  Tensor in(DT_COMPLEX128, TensorShape({2, 3}));
+  auto in_flat = in.flat<complex128>();
+  for (int64 i = 0; i < 6; ++i) in_flat(i) = complex128(i, i + 1);
+  Eigen::ThreadPool pool(2);
+  CPUDevice device(&pool, 2);
+  Tensor out(DT_COMPLEX128, TensorShape({3, 2}));
+  TF_ASSERT_OK(DoConjugateTranspose(device, in, {1, 0}, &out));
+  test::ExpectTensorEqual<complex128>(
+      test::AsTensor<complex128>({{0, -1}, {3, -4}, {1, -2}, {4, -5}, {2, -3},
+                                  {5, -6}},
+                                 TensorShape({3, 2})),
+      out);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -13,9 +13,12 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -24,11 +27,199 @@ limitations under the License.
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
 
+namespace {
+
+// Minimum number of elements per partition, and per block of the parallel
+// scans over the input, of UniqueIntegers.
+constexpr int64 kMinPartitionSize = 16 * 1024;
+constexpr int64 kMinBlockSize = 4 * 1024;
+constexpr int kMaxPartitions = 64;
+
+// Vectors of integers are deduplicated in parallel.  The elements are
+// partitioned on a hash of their value, and each partition is deduplicated by
+// one thread with an open addressing hash table, which maps each element to
+// the position of its first occurrence.  The unique elements are then numbered
+// in order of first occurrence, as in the serial implementation.
+template <typename T, typename TIndex,
+          bool kIsInteger = std::is_integral<T>::value>
+struct UniqueIntegers {
+  // Returns false when `T` is not an integer type, in which case the serial
+  // implementation is used.
+  static bool Compute(OpKernelContext* context, const Tensor& input,
+                      int64 axis, bool with_counts, Tensor* idx) {
+    return false;
+  }
+};
+
+template <typename T, typename TIndex>
+struct UniqueIntegers<T, TIndex, true> {
+  static uint64 Mix(T value) {
+    // The finalizer of MurmurHash3, so that both the high bits, which select
+    // the partition, and the low bits, which select the slot in the hash
+    // table of the partition, depend on all the bits of the value.
+    uint64 h = static_cast<uint64>(value);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  static bool Compute(OpKernelContext* context, const Tensor& input,
+                      int64 axis, bool with_counts, Tensor* idx) {
+    const T* x = input.flat<T>().data();
+    const int64 N = input.NumElements();
+    auto idx_vec = idx->vec<TIndex>();
+    const DeviceBase::CpuWorkerThreads& workers =
+        *context->device()->tensorflow_cpu_worker_threads();
+
+    int partition_bits = 0;
+    while ((1 << partition_bits) < std::min(workers.num_threads,
+                                            kMaxPartitions) &&
+           (N >> (partition_bits + 1)) >= kMinPartitionSize) {
+      ++partition_bits;
+    }
+    const int num_partitions = 1 << partition_bits;
+    const int64 num_blocks =
+        num_partitions == 1
+            ? 1
+            : std::min<int64>(4 * num_partitions, N / kMinBlockSize);
+    const int64 block_size = (N + num_blocks - 1) / num_blocks;
+    auto for_each_block = [&](int64 cost_per_element,
+                              const std::function<void(int64, int64, int64)>&
+                                  fn) {
+      Shard(workers.num_threads, workers.workers, num_blocks,
+            cost_per_element * block_size, [&](int64 start, int64 limit) {
+              for (int64 b = start; b < limit; ++b) {
+                fn(b, b * block_size, std::min(N, (b + 1) * block_size));
+              }
+            });
+    };
+
+    // Hashes the elements, and lists the elements of each partition, in
+    // order, with a counting sort on the partition.
+    std::vector<uint64> hashes(N);
+    std::vector<int64> offsets(num_blocks * num_partitions, 0);
+    for_each_block(5, [&](int64 block, int64 start, int64 limit) {
+      int64* counts = &offsets[block * num_partitions];
+      for (int64 i = start; i < limit; ++i) {
+        hashes[i] = Mix(x[i]);
+        if (partition_bits > 0) ++counts[hashes[i] >> (64 - partition_bits)];
+      }
+      if (partition_bits == 0) counts[0] = limit - start;
+    });
+    // partition_starts[p] is the position in `order` of the elements of
+    // partition p, and offsets[b * num_partitions + p] that of the elements of
+    // partition p in block b.
+    std::vector<int64> partition_starts(num_partitions + 1, 0);
+    for (int p = 0; p < num_partitions; ++p) {
+      int64 offset = partition_starts[p];
+      for (int64 b = 0; b < num_blocks; ++b) {
+        const int64 count = offsets[b * num_partitions + p];
+        offsets[b * num_partitions + p] = offset;
+        offset += count;
+      }
+      partition_starts[p + 1] = offset;
+    }
+    std::vector<int64> order(N);
+    if (partition_bits == 0) {
+      for (int64 i = 0; i < N; ++i) order[i] = i;
+    } else {
+      for_each_block(2, [&](int64 block, int64 start, int64 limit) {
+        int64* next = &offsets[block * num_partitions];
+        for (int64 i = start; i < limit; ++i) {
+          order[next[hashes[i] >> (64 - partition_bits)]++] = i;
+        }
+      });
+    }
+
+    // Deduplicates each partition.  Elements equal to each other are in the
+    // same partition, so first[i] and occurrences[first[i]] are only written
+    // by the thread of the partition of element i.
+    std::vector<int64> first(N);
+    std::vector<int64> occurrences(with_counts ? N : 0, 0);
+    Shard(workers.num_threads, workers.workers, num_partitions,
+          20 * (N / num_partitions), [&](int64 start, int64 limit) {
+            std::vector<int64> table;
+            for (int64 p = start; p < limit; ++p) {
+              const int64 size = partition_starts[p + 1] - partition_starts[p];
+              uint64 capacity = 1;
+              while (capacity < 2 * static_cast<uint64>(size)) capacity <<= 1;
+              const uint64 mask = capacity - 1;
+              table.assign(capacity, -1);
+              for (int64 k = partition_starts[p]; k < partition_starts[p + 1];
+                   ++k) {
+                const int64 i = order[k];
+                uint64 slot = hashes[i] & mask;
+                while (table[slot] >= 0 && x[table[slot]] != x[i]) {
+                  slot = (slot + 1) & mask;
+                }
+                if (table[slot] < 0) table[slot] = i;
+                first[i] = table[slot];
+                if (with_counts) ++occurrences[first[i]];
+              }
+            }
+          });
+
+    // Numbers the unique elements in order of first occurrence.
+    std::vector<int64> block_ids(num_blocks + 1, 0);
+    for_each_block(1, [&](int64 block, int64 start, int64 limit) {
+      int64 num_unique = 0;
+      for (int64 i = start; i < limit; ++i) num_unique += first[i] == i;
+      block_ids[block + 1] = num_unique;
+    });
+    for (int64 b = 0; b < num_blocks; ++b) block_ids[b + 1] += block_ids[b];
+    const int64 uniq_size = block_ids[num_blocks];
+
+    TensorShape output_shape(input.shape());
+    output_shape.set_dim(axis, uniq_size);
+    Tensor* output = nullptr;
+    Status s = context->allocate_output(0, output_shape, &output);
+    if (s.ok() && with_counts) {
+      Tensor* count_output = nullptr;
+      s = context->allocate_output(2, TensorShape({uniq_size}), &count_output);
+      if (s.ok()) {
+        auto count_output_vec = count_output->vec<TIndex>();
+        for_each_block(1, [&](int64 block, int64 start, int64 limit) {
+          int64 id = block_ids[block];
+          for (int64 i = start; i < limit; ++i) {
+            if (first[i] == i) count_output_vec(id++) = occurrences[i];
+          }
+        });
+      }
+    }
+    if (!s.ok()) {
+      context->SetStatus(s);
+      return true;
+    }
+    T* y = output->flat<T>().data();
+    for_each_block(1, [&](int64 block, int64 start, int64 limit) {
+      int64 id = block_ids[block];
+      for (int64 i = start; i < limit; ++i) {
+        if (first[i] == i) {
+          y[id] = x[i];
+          idx_vec(i) = id++;
+        }
+      }
+    });
+    for_each_block(1, [&](int64 block, int64 start, int64 limit) {
+      for (int64 i = start; i < limit; ++i) {
+        if (first[i] != i) idx_vec(i) = idx_vec(first[i]);
+      }
+    });
+    return true;
+  }
+};
+
+}  // namespace
+
 template <typename T, typename TIndex>
 class UniqueOp : public OpKernel {
  public:
@@ -98,6 +289,12 @@ class UniqueOp : public OpKernel {
                                 1, TensorShape({new_sizes[1]}), &idx));
     auto idx_vec = idx->template vec<TIndex>();
 
+    if (new_sizes[0] == 1 && new_sizes[2] == 1 && new_sizes[1] > 0 &&
+        UniqueIntegers<T, TIndex>::Compute(context, input, axis,
+                                           num_outputs() > 2, idx)) {
+      return;
+    }
+
     int64 uniq_size;
     if (new_sizes[0] == 1 && new_sizes[2] == 1) {
       // Specialized and faster implementation when unique is run over single
@@ -28,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
 
 namespace tensorflow {
 
@@ -102,6 +103,34 @@ static void BM_Unique_INT32_Repeat(int iters, int dim, int max_int) {
   test::Benchmark("cpu", g).Run(iters);
 }
 
+// Feature ids of a batch of CTR training examples: `dim` int64 ids, 1/8th of
+// which are distinct.
+static void BM_Unique_INT64_Threads(int iters, int dim, int num_threads) {
+  testing::StopTiming();
+  Graph* g = new Graph(OpRegistry::Global());
+
+  Tensor input(DT_INT64, TensorShape({dim}));
+  auto input_vec = input.vec<int64>();
+  for (int i = 0; i < dim; ++i) {
+    input_vec(i) = (static_cast<int64>(std::rand()) << 31 | std::rand()) %
+                   (dim / 8) * 7919;
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Unique")
+                  .Input(test::graph::Constant(g, input))
+                  .Attr("T", DT_INT64)
+                  .Finalize(g, &node));
+
+  SessionOptions opts;
+  opts.config.set_intra_op_parallelism_threads(num_threads);
+  opts.config.set_inter_op_parallelism_threads(1);
+  testing::BytesProcessed(static_cast<int64>(iters) * dim * sizeof(int64));
+  testing::UseRealTime();
+  testing::StartTiming();
+  test::Benchmark("cpu", g, &opts).Run(iters);
+}
+
 TensorProto GetRandomStringsTensorProto(int dim, int max_str_len) {
   TensorProto tensor_proto;
   tensor_proto.set_dtype(DT_STRING);
@@ -180,6 +209,14 @@ BENCHMARK(BM_Unique_INT32_Repeat)
     ->ArgPair(64 * 1024, 64 * 1024 * 1024)
     ->ArgPair(1024 * 1024, 64 * 1024 * 1024);
 
+BENCHMARK(BM_Unique_INT64_Threads)
+    ->ArgPair(64 * 1024, 1)
+    ->ArgPair(64 * 1024, 4)
+    ->ArgPair(1024 * 1024, 1)
+    ->ArgPair(1024 * 1024, 4)
+    ->ArgPair(1024 * 1024, 16)
+    ->ArgPair(4 * 1024 * 1024, 16);
+
 BENCHMARK(BM_Unique_STRING)
     ->Arg(32)
     ->Arg(256)
@@ -0,0 +1,44 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_LIB_MONITORING_CELL_SHARDS_H_
+#define TENSORFLOW_CORE_LIB_MONITORING_CELL_SHARDS_H_
+
+#include <atomic>
+
+namespace tensorflow {
+namespace monitoring {
+namespace internal {
+
+// Number of shards of the counter and sampler cells.  Updates from different
+// threads go to different shards, so that they do not contend on a lock or a
+// cache line, and the shards are merged when the cell value is read.
+constexpr int kNumCellShards = 16;
+
+// Returns the cell shard of the calling thread.  Threads are assigned shards
+// round-robin on first use, so that up to kNumCellShards threads never share
+// one.
+inline int ThreadCellShard() {
+  static std::atomic<unsigned int> next_shard(0);
+  static thread_local const int shard =
+      next_shard.fetch_add(1, std::memory_order_relaxed) % kNumCellShards;
+  return shard;
+}
+
+}  // namespace internal
+}  // namespace monitoring
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_LIB_MONITORING_CELL_SHARDS_H_
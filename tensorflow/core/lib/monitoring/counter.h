@@ -26,11 +26,14 @@ limitations under the License.
 #include <array>
 #include <atomic>
 #include <map>
+#include <memory>
 
+#include "tensorflow/core/lib/monitoring/cell_shards.h"
 #include "tensorflow/core/lib/monitoring/collection_registry.h"
 #include "tensorflow/core/lib/monitoring/metric_def.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mem.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/thread_annotations.h"
 
@@ -45,10 +48,14 @@ namespace monitoring {
 // to which both cells belong) and performance (since map indexing and
 // associated locking are both avoided).
 //
+// The value is sharded by thread, so that threads incrementing the same cell
+// do not contend on its cache line; the shards are summed by value(). Each
+// shard takes a cache line of its own, so a cell takes 1KB.
+//
 // This class is thread-safe.
 class CounterCell {
  public:
-  CounterCell(int64 value) : value_(value) {}
+  CounterCell(int64 value) { shards_[0].value = value; }
   ~CounterCell() {}
 
   // Atomically increments the value by step.
@@ -58,8 +65,19 @@ class CounterCell {
   // Retrieves the current value.
   int64 value() const;
 
+  // Cells are over-aligned, which plain operator new only honors from C++17.
+  static void* operator new(size_t size) {
+    return port::AlignedMalloc(size, alignof(CounterCell));
+  }
+  static void operator delete(void* ptr) { port::AlignedFree(ptr); }
+
  private:
-  std::atomic<int64> value_;
+  // Aligned and padded to a cache line.
+  struct alignas(64) Shard {
+    std::atomic<int64> value{0};
+  };
+
+  Shard shards_[internal::kNumCellShards];
 
   TF_DISALLOW_COPY_AND_ASSIGN(CounterCell);
 };
@@ -73,7 +91,8 @@ class CounterCell {
 // Counter allocates storage and maintains a cell for each value. You can
 // retrieve an individual cell using a label-tuple and update it separately.
 // This improves performance since operations related to retrieval, like
-// map-indexing and locking, are avoided.
+// map-indexing and locking, are avoided. As each cell takes about 1KB (see
+// CounterCell), so does each combination of label values used.
 //
 // This class is thread-safe.
 template <int NumLabels>
@@ -107,7 +126,8 @@ class Counter {
 
               mutex_lock l(mu_);
               for (const auto& cell : cells_) {
-                metric_collector.CollectValue(cell.first, cell.second.value());
+                metric_collector.CollectValue(cell.first,
+                                              cell.second->value());
               }
             })) {}
 
@@ -120,7 +140,8 @@ class Counter {
   std::unique_ptr<CollectionRegistry::RegistrationHandle> registration_handle_;
 
   using LabelArray = std::array<string, NumLabels>;
-  std::map<LabelArray, CounterCell> cells_ GUARDED_BY(mu_);
+  // Held by pointer, as map nodes may not honor the alignment of the cells.
+  std::map<LabelArray, std::unique_ptr<CounterCell>> cells_ GUARDED_BY(mu_);
 
   TF_DISALLOW_COPY_AND_ASSIGN(Counter);
 };
@@ -131,10 +152,17 @@ class Counter {
 
 inline void CounterCell::IncrementBy(const int64 step) {
   DCHECK_LE(0, step) << "Must not decrement cumulative metrics.";
-  value_ += step;
+  shards_[internal::ThreadCellShard()].value.fetch_add(
+      step, std::memory_order_relaxed);
 }
 
-inline int64 CounterCell::value() const { return value_; }
+inline int64 CounterCell::value() const {
+  int64 value = 0;
+  for (const Shard& shard : shards_) {
+    value += shard.value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
 
 template <int NumLabels>
 template <typename... MetricDefArgs>
@@ -159,13 +187,11 @@ CounterCell* Counter<NumLabels>::GetCell(const Labels&... labels)
   mutex_lock l(mu_);
   const auto found_it = cells_.find(label_array);
   if (found_it != cells_.end()) {
-    return &(found_it->second);
+    return found_it->second.get();
   }
-  return &(cells_
-               .emplace(std::piecewise_construct,
-                        std::forward_as_tuple(label_array),
-                        std::forward_as_tuple(0))
-               .first->second);
+  CounterCell* cell = new CounterCell(0);
+  cells_.emplace(label_array, std::unique_ptr<CounterCell>(cell));
+  return cell;
 }
 
 }  // namespace monitoring
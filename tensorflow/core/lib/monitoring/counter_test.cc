@@ -15,7 +15,14 @@ limitations under the License.
 
 #include "tensorflow/core/lib/monitoring/counter.h"
 
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace monitoring {
@@ -50,6 +57,15 @@ TEST(LabeledCounterDeathTest, DiesOnDecrement) {
       "decrement");
 }
 
+TEST(LabeledCounterTest, CellsAreCacheLineAligned) {
+  for (const char* label : {"Aligned0", "Aligned1", "Aligned2"}) {
+    const CounterCell* cell = counter_with_labels->GetCell(label);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(cell) % 64);
+  }
+  std::unique_ptr<CounterCell> cell(new CounterCell(0));
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(cell.get()) % 64);
+}
+
 auto* init_counter_without_labels = Counter<0>::New(
     "/tensorflow/test/init_counter_without_labels",
     "Counter without any labels to check if it is initialized as 0.");
@@ -86,6 +102,48 @@ TEST(UnlabeledCounterDeathTest, DiesOnDecrement) {
       "decrement");
 }
 
+auto* concurrent_counter = Counter<0>::New(
+    "/tensorflow/test/concurrent_counter",
+    "Counter incremented from many threads.");
+
+TEST(UnlabeledCounterTest, ConcurrentIncrements) {
+  auto* cell = concurrent_counter->GetCell();
+  constexpr int kNumThreads = 40;
+  constexpr int kNumIncrements = 1000;
+  {
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int t = 0; t < kNumThreads; ++t) {
+      threads.emplace_back(Env::Default()->StartThread({}, "increment", [cell] {
+        for (int i = 0; i < kNumIncrements; ++i) {
+          cell->IncrementBy(2);
+        }
+      }));
+    }
+  }
+  EXPECT_EQ(2 * kNumThreads * kNumIncrements, cell->value());
+}
+
+auto* benchmark_counter = Counter<0>::New(
+    "/tensorflow/test/benchmark_counter", "Counter for benchmarks.");
+
+// Increments one cell `iters` times in total, from `num_threads` threads.
+void BM_CounterIncrement(int iters, int num_threads) {
+  auto* cell = benchmark_counter->GetCell();
+  const int iters_per_thread = iters / num_threads;
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back(Env::Default()->StartThread(
+        {}, "increment", [cell, iters_per_thread] {
+          for (int i = 0; i < iters_per_thread; ++i) {
+            cell->IncrementBy(1);
+          }
+        }));
+  }
+  threads.clear();
+  testing::ItemsProcessed(static_cast<int64>(iters_per_thread) * num_threads);
+}
+BENCHMARK(BM_CounterIncrement)->Arg(1)->Arg(4)->Arg(16);
+
 }  // namespace
 }  // namespace monitoring
 }  // namespace tensorflow
@@ -0,0 +1,494 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/monitoring/prometheus_exporter.h"
+
+#include <float.h>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/platform.h"
+
+#if !defined(IS_MOBILE_PLATFORM) && !defined(PLATFORM_WINDOWS)
+#define TF_PROMETHEUS_EXPORTER_SOCKETS 1
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace tensorflow {
+namespace monitoring {
+namespace {
+
+// Largest HTTP request accepted.
+constexpr size_t kMaxRequestBytes = 8192;
+
+// Connections that have not been served within this time are closed, so that
+// slow or idle clients cannot hold on to resources.
+constexpr int64 kConnectionTimeoutMicros = 2 * 1000 * 1000;
+
+// Most connections served at the same time. Further clients wait in the listen
+// backlog.
+constexpr size_t kMaxConnections = 64;
+
+// How often the serving thread checks whether the exporter is stopping.
+constexpr int kPollIntervalMillis = 100;
+
+// Metric names may contain colons, label names may not.
+bool IsNameChar(char c, bool first, bool allow_colon) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ||
+         (allow_colon && c == ':') || (!first && c >= '0' && c <= '9');
+}
+
+string SanitizeName(StringPiece raw_name, bool allow_colon) {
+  string name;
+  name.reserve(raw_name.size());
+  for (char c : raw_name) {
+    // Path separators only delimit, and are not kept at the start.
+    if (name.empty() && c == '/') continue;
+    name.push_back(IsNameChar(c, /*first=*/false, allow_colon) ? c : '_');
+  }
+  if (name.empty() || !IsNameChar(name[0], /*first=*/true, allow_colon)) {
+    name.insert(0, "_");
+  }
+  return name;
+}
+
+// Escapes `value` for a label value, or for a HELP line if `help`.
+void AppendEscaped(StringPiece value, bool help, string* out) {
+  for (char c : value) {
+    switch (c) {
+      case '\\':
+        out->append("\\\\");
+        break;
+      case '\n':
+        out->append("\\n");
+        break;
+      case '"':
+        out->append(help ? "\"" : "\\\"");
+        break;
+      default:
+        out->push_back(c);
+    }
+  }
+}
+
+// Appends the labels of `point`, followed by `extra_name`=`extra_value` if
+// `extra_name` is not empty.
+void AppendLabels(const Point& point, StringPiece extra_name,
+                  StringPiece extra_value, string* out) {
+  if (point.labels.empty() && extra_name.empty()) return;
+  out->push_back('{');
+  bool first = true;
+  for (const Point::Label& label : point.labels) {
+    if (!first) out->push_back(',');
+    first = false;
+    strings::StrAppend(out, PrometheusLabelName(label.name), "=\"");
+    AppendEscaped(label.value, /*help=*/false, out);
+    out->push_back('"');
+  }
+  if (!extra_name.empty()) {
+    if (!first) out->push_back(',');
+    strings::StrAppend(out, extra_name, "=\"");
+    AppendEscaped(extra_value, /*help=*/false, out);
+    out->push_back('"');
+  }
+  out->push_back('}');
+}
+
+string FormatDouble(double value) {
+  if (value >= DBL_MAX) return "+Inf";
+  if (value <= -DBL_MAX) return "-Inf";
+  return strings::StrCat(value);
+}
+
+void AppendHistogram(const string& name, const Point& point, string* out) {
+  const HistogramProto& histogram = point.histogram_value;
+  double cumulative_count = 0;
+  bool has_inf_bucket = false;
+  for (int i = 0; i < histogram.bucket_limit_size(); ++i) {
+    cumulative_count += histogram.bucket(i);
+    const string le = FormatDouble(histogram.bucket_limit(i));
+    has_inf_bucket = le == "+Inf";
+    strings::StrAppend(out, name, "_bucket");
+    AppendLabels(point, "le", le, out);
+    strings::StrAppend(out, " ", cumulative_count, "\n");
+  }
+  if (!has_inf_bucket) {
+    strings::StrAppend(out, name, "_bucket");
+    AppendLabels(point, "le", "+Inf", out);
+    strings::StrAppend(out, " ", histogram.num(), "\n");
+  }
+  strings::StrAppend(out, name, "_sum");
+  AppendLabels(point, "", "", out);
+  strings::StrAppend(out, " ", histogram.sum(), "\n");
+  strings::StrAppend(out, name, "_count");
+  AppendLabels(point, "", "", out);
+  strings::StrAppend(out, " ", histogram.num(), "\n");
+}
+
+#ifdef TF_PROMETHEUS_EXPORTER_SOCKETS
+
+bool SetNonBlocking(int fd) {
+  const int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+bool WouldBlock(int error) {
+  return error == EAGAIN || error == EWOULDBLOCK;
+}
+
+#endif  // TF_PROMETHEUS_EXPORTER_SOCKETS
+
+}  // namespace
+
+string PrometheusMetricName(const string& metric_name) {
+  return SanitizeName(metric_name, /*allow_colon=*/true);
+}
+
+string PrometheusLabelName(const string& label_name) {
+  return SanitizeName(label_name, /*allow_colon=*/false);
+}
+
+void AppendPrometheusText(const MetricDescriptor& descriptor,
+                          const PointSet& point_set, string* out) {
+  string name = PrometheusMetricName(descriptor.name);
+  const char* type = "gauge";
+  if (descriptor.value_type == ValueType::kHistogram) {
+    type = "histogram";
+  } else if (descriptor.value_type == ValueType::kInt64 &&
+             descriptor.metric_kind == MetricKind::kCumulative) {
+    type = "counter";
+    // Prometheus expects the names of counters to end in "_total".
+    if (!str_util::EndsWith(name, "_total")) name.append("_total");
+  }
+  strings::StrAppend(out, "# HELP ", name, " ");
+  AppendEscaped(descriptor.description, /*help=*/true, out);
+  strings::StrAppend(out, "\n# TYPE ", name, " ", type, "\n");
+  for (const auto& point : point_set.points) {
+    switch (point->value_type) {
+      case ValueType::kInt64:
+        out->append(name);
+        AppendLabels(*point, "", "", out);
+        strings::StrAppend(out, " ", point->int64_value, "\n");
+        break;
+      case ValueType::kBool:
+        out->append(name);
+        AppendLabels(*point, "", "", out);
+        strings::StrAppend(out, point->bool_value ? " 1\n" : " 0\n");
+        break;
+      case ValueType::kString:
+        out->append(name);
+        AppendLabels(*point, "value", point->string_value, out);
+        strings::StrAppend(out, " 1\n");
+        break;
+      case ValueType::kHistogram:
+        AppendHistogram(name, *point, out);
+        break;
+    }
+  }
+}
+
+string ExportPrometheusText(const CollectedMetrics& metrics) {
+  string out;
+  for (const auto& point_set : metrics.point_set_map) {
+    const auto descriptor =
+        metrics.metric_descriptor_map.find(point_set.first);
+    if (descriptor == metrics.metric_descriptor_map.end()) continue;
+    AppendPrometheusText(*descriptor->second, *point_set.second, &out);
+  }
+  return out;
+}
+
+/* static */
+Status PrometheusExporter::Start(
+    const Options& options, std::unique_ptr<PrometheusExporter>* exporter) {
+#ifdef TF_PROMETHEUS_EXPORTER_SOCKETS
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return errors::Internal("Failed to create socket: ", strerror(errno));
+  }
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr =
+      htonl(options.listen_on_all_interfaces ? INADDR_ANY : INADDR_LOOPBACK);
+  addr.sin_port = htons(options.port);
+  if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0 ||
+      listen(fd, SOMAXCONN) < 0 || !SetNonBlocking(fd)) {
+    const int error = errno;
+    close(fd);
+    return errors::Unavailable("Failed to listen on port ", options.port, ": ",
+                               strerror(error));
+  }
+  socklen_t addr_len = sizeof(addr);
+  if (getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &addr_len) <
+      0) {
+    const int error = errno;
+    close(fd);
+    return errors::Internal("Failed to get the listening port: ",
+                            strerror(error));
+  }
+  exporter->reset(new PrometheusExporter(options, fd, ntohs(addr.sin_port)));
+  return Status::OK();
+#else
+  return errors::Unimplemented(
+      "PrometheusExporter is not supported on this platform.");
+#endif  // TF_PROMETHEUS_EXPORTER_SOCKETS
+}
+
+PrometheusExporter::PrometheusExporter(const Options& options, int listen_fd,
+                                       int port)
+    : options_(options),
+      registry_(options.registry != nullptr ? options.registry
+                                            : CollectionRegistry::Default()),
+      listen_fd_(listen_fd),
+      port_(port),
+      rendered_(std::make_shared<const string>()) {
+  Collect();
+  collection_thread_.reset(options_.env->StartThread(
+      ThreadOptions(), "prometheus_exporter_collect",
+      [this]() { CollectionLoop(); }));
+  serve_thread_.reset(options_.env->StartThread(
+      ThreadOptions(), "prometheus_exporter_serve", [this]() { ServeLoop(); }));
+}
+
+PrometheusExporter::~PrometheusExporter() {
+  {
+    mutex_lock l(stop_mu_);
+    stopping_ = true;
+    stop_cv_.notify_all();
+  }
+  // Joins the threads.
+  collection_thread_.reset();
+  serve_thread_.reset();
+#ifdef TF_PROMETHEUS_EXPORTER_SOCKETS
+  close(listen_fd_);
+#endif
+}
+
+void PrometheusExporter::Collect() {
+  mutex_lock l(collect_mu_);
+  CollectionRegistry::CollectMetricsOptions collect_options;
+  collect_options.collect_metric_descriptors = false;
+  std::unique_ptr<CollectedMetrics> metrics =
+      registry_->CollectMetrics(collect_options);
+  for (const auto& point_set : metrics->point_set_map) {
+    if (descriptors_.find(point_set.first) == descriptors_.end()) {
+      // Descriptors do not change, so they are only collected again when new
+      // metrics appear.
+      collect_options.collect_metric_descriptors = true;
+      metrics = registry_->CollectMetrics(collect_options);
+      for (auto& descriptor : metrics->metric_descriptor_map) {
+        descriptors_[descriptor.first] = std::move(descriptor.second);
+      }
+      break;
+    }
+  }
+
+  std::shared_ptr<string> rendered = std::make_shared<string>();
+  rendered->reserve(RenderedMetrics()->size());
+  for (const auto& point_set : metrics->point_set_map) {
+    const auto descriptor = descriptors_.find(point_set.first);
+    if (descriptor == descriptors_.end()) continue;
+    AppendPrometheusText(*descriptor->second, *point_set.second,
+                         rendered.get());
+  }
+  mutex_lock rendered_lock(rendered_mu_);
+  rendered_ = std::move(rendered);
+}
+
+std::shared_ptr<const string> PrometheusExporter::RenderedMetrics() const {
+  mutex_lock l(rendered_mu_);
+  return rendered_;
+}
+
+void PrometheusExporter::CollectionLoop() {
+  while (true) {
+    {
+      mutex_lock l(stop_mu_);
+      if (!stopping_) {
+        stop_cv_.wait_for(
+            l, std::chrono::milliseconds(options_.collection_interval_ms));
+      }
+      if (stopping_) return;
+    }
+    Collect();
+  }
+}
+
+// An HTTP connection being served.
+struct PrometheusExporter::Connection {
+  Connection(int fd, int64 deadline_micros)
+      : fd(fd), deadline_micros(deadline_micros) {}
+
+  const int fd;
+  // The connection is closed if not served by then.
+  const int64 deadline_micros;
+
+  string request;
+
+  // Whether `request` is complete and the response is being written.
+  bool responding = false;
+  string header;
+  std::shared_ptr<const string> body;
+  // Bytes of `header` and `body` written so far.
+  size_t written = 0;
+};
+
+void PrometheusExporter::ServeLoop() {
+#ifdef TF_PROMETHEUS_EXPORTER_SOCKETS
+  // All connections are served from this thread with non-blocking I/O, so a
+  // slow client only ever delays its own response.
+  std::vector<std::unique_ptr<Connection>> connections;
+  std::vector<struct pollfd> pfds;
+  while (!stopping_) {
+    pfds.clear();
+    for (const auto& connection : connections) {
+      struct pollfd pfd;
+      pfd.fd = connection->fd;
+      pfd.events = connection->responding ? POLLOUT : POLLIN;
+      pfd.revents = 0;
+      pfds.push_back(pfd);
+    }
+    const bool accepting = connections.size() < kMaxConnections;
+    if (accepting) {
+      struct pollfd pfd;
+      pfd.fd = listen_fd_;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+      pfds.push_back(pfd);
+    }
+    // On EINTR no events are reported and the loop just goes around again.
+    poll(pfds.data(), pfds.size(), kPollIntervalMillis);
+
+    const int64 now = options_.env->NowMicros();
+    std::vector<std::unique_ptr<Connection>> open_connections;
+    open_connections.reserve(connections.size());
+    for (size_t i = 0; i < connections.size(); ++i) {
+      bool keep = now < connections[i]->deadline_micros;
+      if (keep && pfds[i].revents != 0) {
+        keep = Serve(connections[i].get());
+      }
+      if (keep) {
+        open_connections.push_back(std::move(connections[i]));
+      } else {
+        close(connections[i]->fd);
+      }
+    }
+    connections.swap(open_connections);
+
+    if (accepting && (pfds.back().revents & POLLIN)) {
+      while (connections.size() < kMaxConnections) {
+        const int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) break;
+        if (!SetNonBlocking(fd)) {
+          close(fd);
+          continue;
+        }
+#ifdef SO_NOSIGPIPE
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+        connections.emplace_back(
+            new Connection(fd, now + kConnectionTimeoutMicros));
+      }
+    }
+  }
+  for (const auto& connection : connections) {
+    close(connection->fd);
+  }
+#endif  // TF_PROMETHEUS_EXPORTER_SOCKETS
+}
+
+bool PrometheusExporter::Serve(Connection* connection) {
+#ifdef TF_PROMETHEUS_EXPORTER_SOCKETS
+  if (!connection->responding) {
+    char buffer[1024];
+    while (connection->request.find("\r\n\r\n") == string::npos) {
+      if (connection->request.size() >= kMaxRequestBytes) return false;
+      const ssize_t n = recv(connection->fd, buffer, sizeof(buffer), 0);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0 && WouldBlock(errno)) return true;
+      if (n <= 0) return false;
+      connection->request.append(buffer, n);
+    }
+    BuildResponse(connection->request, &connection->header,
+                  &connection->body);
+    connection->responding = true;
+  }
+
+  const size_t header_size = connection->header.size();
+  const size_t body_size =
+      connection->body != nullptr ? connection->body->size() : 0;
+  while (connection->written < header_size + body_size) {
+    StringPiece data =
+        connection->written < header_size
+            ? StringPiece(connection->header).substr(connection->written)
+            : StringPiece(*connection->body)
+                  .substr(connection->written - header_size);
+#ifdef MSG_NOSIGNAL
+    const ssize_t n = send(connection->fd, data.data(), data.size(),
+                           MSG_NOSIGNAL);
+#else
+    const ssize_t n = send(connection->fd, data.data(), data.size(), 0);
+#endif
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0 && WouldBlock(errno)) return true;
+    if (n < 0) return false;
+    connection->written += n;
+  }
+  // The response is complete, and sent with "Connection: close".
+  return false;
+#else
+  return false;
+#endif  // TF_PROMETHEUS_EXPORTER_SOCKETS
+}
+
+void PrometheusExporter::BuildResponse(
+    const string& request, string* header,
+    std::shared_ptr<const string>* body) const {
+  const StringPiece request_line(request.data(), request.find("\r\n"));
+  const std::vector<string> parts = str_util::Split(request_line, ' ');
+  string status = "200 OK";
+  if (parts.size() != 3) {
+    status = "400 Bad Request";
+  } else if (parts[0] != "GET") {
+    status = "405 Method Not Allowed";
+  } else if (parts[1] != "/metrics" &&
+             !str_util::StartsWith(parts[1], "/metrics?")) {
+    status = "404 Not Found";
+  } else {
+    *body = RenderedMetrics();
+  }
+  const size_t body_size = *body != nullptr ? (*body)->size() : 0;
+  *header = strings::StrCat(
+      "HTTP/1.1 ", status,
+      "\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8"
+      "\r\nContent-Length: ",
+      body_size, "\r\nConnection: close\r\n\r\n");
+}
+
+}  // namespace monitoring
+}  // namespace tensorflow
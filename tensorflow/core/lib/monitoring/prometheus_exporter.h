@@ -0,0 +1,151 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_LIB_MONITORING_PROMETHEUS_EXPORTER_H_
+#define TENSORFLOW_CORE_LIB_MONITORING_PROMETHEUS_EXPORTER_H_
+
+#include <atomic>
+#include <map>
+#include <memory>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/monitoring/collected_metrics.h"
+#include "tensorflow/core/lib/monitoring/collection_registry.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace monitoring {
+
+// Returns the Prometheus name of the metric named `metric_name`, e.g.
+// "tensorflow_core_graph_runs" for "/tensorflow/core/graph_runs".
+string PrometheusMetricName(const string& metric_name);
+
+// Returns the Prometheus name of the label named `label_name`, which matches
+// [a-zA-Z_][a-zA-Z0-9_]*.
+string PrometheusLabelName(const string& label_name);
+
+// Renders the points of `point_set`, described by `descriptor`, in the
+// Prometheus text exposition format, and appends them to `out`.
+//
+// Cumulative int64 metrics are counters, whose names get a "_total" suffix,
+// and other int64 and bool metrics gauges.  String metrics are gauges of value
+// 1, with the string in a "value" label.  Histograms have cumulative "_bucket"
+// series, with "le" labels, followed by "_sum" and "_count" series.
+void AppendPrometheusText(const MetricDescriptor& descriptor,
+                          const PointSet& point_set, string* out);
+
+// Renders all of `metrics` in the Prometheus text exposition format.
+string ExportPrometheusText(const CollectedMetrics& metrics);
+
+// Serves the metrics of a CollectionRegistry over HTTP, in the Prometheus text
+// exposition format, at "/metrics".
+//
+// A background thread collects and renders the metrics every
+// collection_interval_ms; metric descriptors are only collected when new
+// metrics appear.  Scrapes are served from the last rendered buffer, so that
+// they never wait for a collection nor block the metrics being updated.
+// Another thread serves all connections with non-blocking I/O, and closes
+// those that are not done within a short timeout, so that slow clients do not
+// delay other scrapes.
+//
+// Only supported on POSIX platforms.
+class PrometheusExporter {
+ public:
+  struct Options {
+    // Port to listen on.  If 0, an unused port is picked.
+    int port = 0;
+
+    // By default, only connections from the local host are accepted.  If true,
+    // listens on all network interfaces instead, exposing the metrics to any
+    // host that can reach this one.
+    bool listen_on_all_interfaces = false;
+
+    int64 collection_interval_ms = 1000;
+
+    // Registry to export the metrics of.  If null, the default registry.
+    CollectionRegistry* registry = nullptr;
+
+    Env* env = Env::Default();
+  };
+
+  // Starts serving the metrics.
+  static Status Start(const Options& options,
+                      std::unique_ptr<PrometheusExporter>* exporter);
+
+  // Stops serving the metrics.
+  ~PrometheusExporter();
+
+  // The port the exporter listens on.
+  int port() const { return port_; }
+
+  // Collects and renders the metrics now, instead of at the next collection
+  // interval.
+  void Collect() LOCKS_EXCLUDED(collect_mu_, rendered_mu_);
+
+  // Returns the last rendered metrics.
+  std::shared_ptr<const string> RenderedMetrics() const
+      LOCKS_EXCLUDED(rendered_mu_);
+
+ private:
+  PrometheusExporter(const Options& options, int listen_fd, int port);
+
+  struct Connection;
+
+  void CollectionLoop();
+  void ServeLoop();
+
+  // Reads the request of `connection` and writes its response, as far as
+  // possible without blocking.  Returns false once the connection should be
+  // closed.
+  bool Serve(Connection* connection);
+
+  // Returns the response to the HTTP `request` in `header` and `body`; `body`
+  // is null if the response has none.
+  void BuildResponse(const string& request, string* header,
+                     std::shared_ptr<const string>* body) const;
+
+  const Options options_;
+  CollectionRegistry* const registry_;
+  const int listen_fd_;
+  const int port_;
+  std::atomic<bool> stopping_{false};
+
+  // Serializes collections, and guards the descriptors of the metrics
+  // collected so far.
+  mutex collect_mu_;
+  std::map<string, std::unique_ptr<MetricDescriptor>> descriptors_
+      GUARDED_BY(collect_mu_);
+
+  mutable mutex rendered_mu_;
+  std::shared_ptr<const string> rendered_ GUARDED_BY(rendered_mu_);
+
+  // Wakes up the collection thread when stopping.
+  mutex stop_mu_;
+  condition_variable stop_cv_;
+
+  std::unique_ptr<Thread> collection_thread_;
+  std::unique_ptr<Thread> serve_thread_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PrometheusExporter);
+};
+
+}  // namespace monitoring
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_LIB_MONITORING_PROMETHEUS_EXPORTER_H_
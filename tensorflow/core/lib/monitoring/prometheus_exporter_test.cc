@@ -0,0 +1,224 @@
+/* Copyright 2018 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/monitoring/prometheus_exporter.h"
+
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/platform.h"
+#include "tensorflow/core/platform/test.h"
+
+#if !defined(IS_MOBILE_PLATFORM) && !defined(PLATFORM_WINDOWS)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace tensorflow {
+namespace monitoring {
+namespace {
+
+auto* test_counter =
+    Counter<1>::New("/tensorflow/test/prometheus/counter",
+                    "Counter \"exported\"\nto Prometheus.", "my_label");
+
+auto* test_total_counter = Counter<1>::New(
+    "/tensorflow/test/prometheus/requests_total", "Counter.", "my:label");
+
+auto* test_string_gauge = Gauge<string, 0>::New(
+    "/tensorflow/test/prometheus/string_gauge", "String gauge.");
+
+auto* test_bool_gauge = Gauge<bool, 0>::New(
+    "/tensorflow/test/prometheus/bool_gauge", "Bool gauge.");
+
+auto* test_sampler =
+    Sampler<0>::New({"/tensorflow/test/prometheus/sampler", "Sampler."},
+                    Buckets::Explicit({10.0, 20.0}));
+
+TEST(PrometheusMetricNameTest, Sanitizes) {
+  EXPECT_EQ("tensorflow_core_graph_runs",
+            PrometheusMetricName("/tensorflow/core/graph_runs"));
+  EXPECT_EQ("tf_data_bytes_read",
+            PrometheusMetricName("/tf/data-bytes.read"));
+  EXPECT_EQ("_0_metric", PrometheusMetricName("/0/metric"));
+  EXPECT_EQ("ns:metric", PrometheusMetricName("ns:metric"));
+}
+
+TEST(PrometheusLabelNameTest, Sanitizes) {
+  EXPECT_EQ("my_label", PrometheusLabelName("my_label"));
+  EXPECT_EQ("my_label_x", PrometheusLabelName("my-label:x"));
+  EXPECT_EQ("_0label", PrometheusLabelName("0label"));
+  EXPECT_EQ("_", PrometheusLabelName(""));
+}
+
+TEST(PrometheusTextTest, Metrics) {
+  test_counter->GetCell("with \"quotes\"")->IncrementBy(3);
+  test_counter->GetCell("plain")->IncrementBy(5);
+  test_string_gauge->GetCell()->Set("running");
+  test_bool_gauge->GetCell()->Set(true);
+  test_total_counter->GetCell("value")->IncrementBy(2);
+  for (double sample : {5.0, 15.0, 15.0, 100.0}) {
+    test_sampler->GetCell()->Add(sample);
+  }
+
+  const string text = ExportPrometheusText(
+      *CollectionRegistry::Default()->CollectMetrics({}));
+  for (const string& expected : std::vector<string>({
+           "# HELP tensorflow_test_prometheus_counter_total "
+           "Counter \"exported\"\\nto Prometheus.\n"
+           "# TYPE tensorflow_test_prometheus_counter_total counter\n",
+           "tensorflow_test_prometheus_counter_total{my_label=\"plain\"} 5\n",
+           "tensorflow_test_prometheus_counter_total"
+           "{my_label=\"with \\\"quotes\\\"\"} 3\n",
+           "# TYPE tensorflow_test_prometheus_requests_total counter\n"
+           "tensorflow_test_prometheus_requests_total{my_label=\"value\"} 2\n",
+           "# TYPE tensorflow_test_prometheus_string_gauge gauge\n"
+           "tensorflow_test_prometheus_string_gauge{value=\"running\"} 1\n",
+           "# TYPE tensorflow_test_prometheus_bool_gauge gauge\n"
+           "tensorflow_test_prometheus_bool_gauge 1\n",
+           "# TYPE tensorflow_test_prometheus_sampler histogram\n"
+           "tensorflow_test_prometheus_sampler_bucket{le=\"10\"} 1\n"
+           "tensorflow_test_prometheus_sampler_bucket{le=\"20\"} 3\n"
+           "tensorflow_test_prometheus_sampler_bucket{le=\"+Inf\"} 4\n"
+           "tensorflow_test_prometheus_sampler_sum 135\n"
+           "tensorflow_test_prometheus_sampler_count 4\n",
+       })) {
+    EXPECT_NE(string::npos, text.find(expected)) << expected << "\n" << text;
+  }
+}
+
+#if !defined(IS_MOBILE_PLATFORM) && !defined(PLATFORM_WINDOWS)
+
+// Connects to the exporter listening on `port` of the local host.
+int Connect(int port) {
+  const int fd = socket(AF_INET, SOCK_STREAM, 0);
+  CHECK_GE(fd, 0);
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(port);
+  CHECK_EQ(0, connect(fd, reinterpret_cast<struct sockaddr*>(&addr),
+                      sizeof(addr)));
+  return fd;
+}
+
+// Sends `request` to the exporter listening on `port` of the local host, and
+// returns the response.
+string HttpRequest(int port, const string& request) {
+  const int fd = Connect(port);
+  CHECK_EQ(request.size(), send(fd, request.data(), request.size(), 0));
+  string response;
+  char buffer[4096];
+  ssize_t n;
+  while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+    response.append(buffer, n);
+  }
+  close(fd);
+  return response;
+}
+
+TEST(PrometheusExporterTest, ServesMetrics) {
+  PrometheusExporter::Options options;
+  // Only collected on demand below.
+  options.collection_interval_ms = 3600 * 1000;
+  std::unique_ptr<PrometheusExporter> exporter;
+  TF_ASSERT_OK(PrometheusExporter::Start(options, &exporter));
+  EXPECT_GT(exporter->port(), 0);
+
+  test_counter->GetCell("served")->IncrementBy(7);
+  exporter->Collect();
+  const string response =
+      HttpRequest(exporter->port(), "GET /metrics HTTP/1.1\r\n\r\n");
+  EXPECT_EQ(0, response.find("HTTP/1.1 200 OK\r\n")) << response;
+  EXPECT_NE(string::npos,
+            response.find(strings::StrCat("Content-Length: ",
+                                          exporter->RenderedMetrics()->size(),
+                                          "\r\n")));
+  EXPECT_NE(string::npos,
+            response.find(
+                "\r\n\r\n# HELP tensorflow_test_prometheus_bool_gauge"));
+  EXPECT_NE(string::npos,
+            response.find("tensorflow_test_prometheus_counter_total"
+                          "{my_label=\"served\"} 7\n"));
+
+  // Scrapes return the last collected values.
+  test_counter->GetCell("served")->IncrementBy(1);
+  EXPECT_NE(string::npos,
+            HttpRequest(exporter->port(), "GET /metrics HTTP/1.1\r\n\r\n")
+                .find("{my_label=\"served\"} 7\n"));
+  exporter->Collect();
+  EXPECT_NE(string::npos,
+            HttpRequest(exporter->port(), "GET /metrics HTTP/1.1\r\n\r\n")
+                .find("{my_label=\"served\"} 8\n"));
+}
+
+TEST(PrometheusExporterTest, RejectsOtherRequests) {
+  PrometheusExporter::Options options;
+  std::unique_ptr<PrometheusExporter> exporter;
+  TF_ASSERT_OK(PrometheusExporter::Start(options, &exporter));
+  EXPECT_EQ(0, HttpRequest(exporter->port(), "GET /other HTTP/1.1\r\n\r\n")
+                   .find("HTTP/1.1 404 Not Found\r\n"));
+  EXPECT_EQ(0, HttpRequest(exporter->port(), "POST /metrics HTTP/1.1\r\n\r\n")
+                   .find("HTTP/1.1 405 Method Not Allowed\r\n"));
+  EXPECT_EQ(0, HttpRequest(exporter->port(), "garbage\r\n\r\n")
+                   .find("HTTP/1.1 400 Bad Request\r\n"));
+}
+
+TEST(PrometheusExporterTest, SlowClientsDoNotBlockScrapes) {
+  PrometheusExporter::Options options;
+  std::unique_ptr<PrometheusExporter> exporter;
+  TF_ASSERT_OK(PrometheusExporter::Start(options, &exporter));
+
+  // One client sends nothing, another an incomplete request.
+  const int idle_fd = Connect(exporter->port());
+  const int partial_fd = Connect(exporter->port());
+  const string partial_request = "GET /metr";
+  CHECK_EQ(partial_request.size(), send(partial_fd, partial_request.data(),
+                                        partial_request.size(), 0));
+
+  const uint64 start_micros = Env::Default()->NowMicros();
+  EXPECT_EQ(0, HttpRequest(exporter->port(), "GET /metrics HTTP/1.1\r\n\r\n")
+                   .find("HTTP/1.1 200 OK\r\n"));
+  EXPECT_LT(Env::Default()->NowMicros() - start_micros, 1000 * 1000);
+
+  // The slow connections are closed once they time out.
+  char buffer[16];
+  EXPECT_EQ(0, recv(idle_fd, buffer, sizeof(buffer), 0));
+  EXPECT_EQ(0, recv(partial_fd, buffer, sizeof(buffer), 0));
+  close(idle_fd);
+  close(partial_fd);
+}
+
+TEST(PrometheusExporterTest, PortInUse) {
+  PrometheusExporter::Options options;
+  std::unique_ptr<PrometheusExporter> exporter;
+  TF_ASSERT_OK(PrometheusExporter::Start(options, &exporter));
+  options.port = exporter->port();
+  std::unique_ptr<PrometheusExporter> other_exporter;
+  EXPECT_TRUE(errors::IsUnavailable(
+      PrometheusExporter::Start(options, &other_exporter)));
+}
+
+#endif
+
+}  // namespace
+}  // namespace monitoring
+}  // namespace tensorflow
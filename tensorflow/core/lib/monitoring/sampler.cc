@@ -22,6 +22,8 @@ limitations under the License.
 // Do nothing.
 #else
 
+#include <algorithm>
+
 namespace tensorflow {
 namespace monitoring {
 namespace {
@@ -106,6 +108,58 @@ std::unique_ptr<Buckets> Buckets::Exponential(double scale,
       new ExponentialBuckets(scale, growth_factor, bucket_count));
 }
 
+SamplerCell::SamplerCell(const std::vector<double>& bucket_limits)
+    : bucket_limits_(bucket_limits) {
+  for (auto& shard : shards_) {
+    shard.store(nullptr, std::memory_order_relaxed);
+  }
+  // The first shard always exists, to hold the value of an empty cell.
+  CreateShard(0);
+}
+
+SamplerCell::~SamplerCell() {
+  for (auto& shard : shards_) {
+    delete shard.load(std::memory_order_relaxed);
+  }
+}
+
+histogram::ThreadSafeHistogram* SamplerCell::CreateShard(int index) {
+  histogram::ThreadSafeHistogram* shard =
+      new histogram::ThreadSafeHistogram(bucket_limits_);
+  histogram::ThreadSafeHistogram* expected = nullptr;
+  if (!shards_[index].compare_exchange_strong(expected, shard,
+                                              std::memory_order_acq_rel)) {
+    // Another thread created the shard first.
+    delete shard;
+    return expected;
+  }
+  return shard;
+}
+
+HistogramProto SamplerCell::value() const {
+  HistogramProto pb;
+  shards_[0].load(std::memory_order_acquire)
+      ->EncodeToProto(&pb, true /* preserve_zero_buckets */);
+  for (int i = 1; i < internal::kNumCellShards; ++i) {
+    const histogram::ThreadSafeHistogram* shard =
+        shards_[i].load(std::memory_order_acquire);
+    if (shard == nullptr) continue;
+    HistogramProto shard_pb;
+    shard->EncodeToProto(&shard_pb, true /* preserve_zero_buckets */);
+    // All shards have the same buckets.
+    DCHECK_EQ(pb.bucket_size(), shard_pb.bucket_size());
+    pb.set_min(std::min(pb.min(), shard_pb.min()));
+    pb.set_max(std::max(pb.max(), shard_pb.max()));
+    pb.set_num(pb.num() + shard_pb.num());
+    pb.set_sum(pb.sum() + shard_pb.sum());
+    pb.set_sum_squares(pb.sum_squares() + shard_pb.sum_squares());
+    for (int b = 0; b < pb.bucket_size(); ++b) {
+      pb.set_bucket(b, pb.bucket(b) + shard_pb.bucket(b));
+    }
+  }
+  return pb;
+}
+
 }  // namespace monitoring
 }  // namespace tensorflow
 
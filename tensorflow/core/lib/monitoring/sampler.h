@@ -24,10 +24,12 @@ limitations under the License.
 #else
 
 #include <float.h>
+#include <atomic>
 #include <map>
 
 #include "tensorflow/core/framework/summary.pb.h"
 #include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/lib/monitoring/cell_shards.h"
 #include "tensorflow/core/lib/monitoring/collection_registry.h"
 #include "tensorflow/core/lib/monitoring/metric_def.h"
 #include "tensorflow/core/platform/macros.h"
@@ -45,13 +47,16 @@ namespace monitoring {
 // to which both cells belong) and performance (since map indexing and
 // associated locking are both avoided).
 //
+// The histogram is sharded by thread, so that threads adding samples to the
+// same cell rarely contend on a lock; the shards are created on first use,
+// and merged by value().
+//
 // This class is thread-safe.
 class SamplerCell {
  public:
-  SamplerCell(const std::vector<double>& bucket_limits)
-      : histogram_(bucket_limits) {}
+  SamplerCell(const std::vector<double>& bucket_limits);
 
-  ~SamplerCell() {}
+  ~SamplerCell();
 
   // Atomically adds a sample.
   void Add(double sample);
@@ -60,7 +65,13 @@ class SamplerCell {
   HistogramProto value() const;
 
  private:
-  histogram::ThreadSafeHistogram histogram_;
+  // Returns the shard at `index`, creating it if needed.
+  histogram::ThreadSafeHistogram* GetShard(int index);
+  histogram::ThreadSafeHistogram* CreateShard(int index);
+
+  const std::vector<double> bucket_limits_;
+  std::atomic<histogram::ThreadSafeHistogram*>
+      shards_[internal::kNumCellShards];
 
   TF_DISALLOW_COPY_AND_ASSIGN(SamplerCell);
 };
@@ -172,12 +183,15 @@ class Sampler {
 //  Implementation details follow. API readers may skip.
 ////
 
-inline void SamplerCell::Add(const double sample) { histogram_.Add(sample); }
+inline void SamplerCell::Add(const double sample) {
+  GetShard(internal::ThreadCellShard())->Add(sample);
+}
 
-inline HistogramProto SamplerCell::value() const {
-  HistogramProto pb;
-  histogram_.EncodeToProto(&pb, true /* preserve_zero_buckets */);
-  return pb;
+inline histogram::ThreadSafeHistogram* SamplerCell::GetShard(int index) {
+  histogram::ThreadSafeHistogram* shard =
+      shards_[index].load(std::memory_order_acquire);
+  if (TF_PREDICT_TRUE(shard != nullptr)) return shard;
+  return CreateShard(index);
 }
 
 template <int NumLabels>
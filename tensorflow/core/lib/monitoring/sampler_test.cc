@@ -15,7 +15,12 @@ limitations under the License.
 
 #include "tensorflow/core/lib/monitoring/sampler.h"
 
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace monitoring {
@@ -112,6 +117,59 @@ TEST(ExponentialSamplerTest, ExponentialBucketBoundaries) {
   EqHistograms(expected, cell->value());
 }
 
+auto* concurrent_sampler =
+    Sampler<0>::New({"/tensorflow/test/concurrent_sampler",
+                     "Sampler with samples added from many threads."},
+                    Buckets::Explicit({10.0, 20.0}));
+
+TEST(UnlabeledSamplerTest, ConcurrentAdds) {
+  // Integral samples, so that the sums do not depend on the order of the
+  // adds.
+  Histogram expected({10.0, 20.0, DBL_MAX});
+  auto* cell = concurrent_sampler->GetCell();
+  constexpr int kNumThreads = 40;
+  constexpr int kNumSamples = 100;
+  for (int t = 0; t < kNumThreads; ++t) {
+    for (int i = 0; i < kNumSamples; ++i) {
+      expected.Add(t + i);
+    }
+  }
+  {
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int t = 0; t < kNumThreads; ++t) {
+      threads.emplace_back(Env::Default()->StartThread({}, "add", [cell, t] {
+        for (int i = 0; i < kNumSamples; ++i) {
+          cell->Add(t + i);
+        }
+      }));
+    }
+  }
+  EqHistograms(expected, cell->value());
+}
+
+auto* benchmark_sampler =
+    Sampler<0>::New({"/tensorflow/test/benchmark_sampler",
+                     "Sampler for benchmarks."},
+                    Buckets::Exponential(1, 2, 30));
+
+// Adds `iters` samples in total to one cell, from `num_threads` threads.
+void BM_SamplerAdd(int iters, int num_threads) {
+  auto* cell = benchmark_sampler->GetCell();
+  const int iters_per_thread = iters / num_threads;
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back(
+        Env::Default()->StartThread({}, "add", [cell, iters_per_thread] {
+          for (int i = 0; i < iters_per_thread; ++i) {
+            cell->Add(i & 1023);
+          }
+        }));
+  }
+  threads.clear();
+  testing::ItemsProcessed(static_cast<int64>(iters_per_thread) * num_threads);
+}
+BENCHMARK(BM_SamplerAdd)->Arg(1)->Arg(4)->Arg(16);
+
 }  // namespace
 }  // namespace monitoring
 }  // namespace tensorflow
@@ -28,6 +28,10 @@ REGISTER_OP("CollectiveReduce")
     .Attr("merge_op: {'Min', 'Max', 'Mul', 'Add'}")
     .Attr("final_op: {'Id', 'Div'}")
     .Attr("subdiv_offsets: list(int)")
+    .Attr("bidirectional: bool = false")
+    .Attr("compression: {'none', 'fp16', 'bf16', 'topk'} = 'none'")
+    .Attr("topk_fraction: float = 0.01")
+    .Attr("hierarchical: bool = false")
     .SetIsStateful()
     .SetShapeFn(shape_inference::UnchangedShape);
 
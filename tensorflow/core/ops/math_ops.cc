@@ -989,6 +989,29 @@ Status SparseSegmentReductionGradShapeFn(InferenceContext* c) {
   return Status::OK();
 }
 
+Status FusedEmbeddingSparseSegmentReductionShapeFn(InferenceContext* c) {
+  ShapeHandle params_shape;
+  TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &params_shape));
+
+  ShapeHandle unused;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &unused));
+
+  ShapeHandle indices_shape;
+  TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &indices_shape));
+
+  // indices and segment_ids should merge cleanly.
+  TF_RETURN_IF_ERROR(c->Merge(c->input(3), indices_shape, &unused));
+
+  ShapeHandle subshape;
+  TF_RETURN_IF_ERROR(c->Subshape(params_shape, 1, &subshape));
+
+  ShapeHandle out;
+  TF_RETURN_IF_ERROR(
+      c->Concatenate(c->Vector(InferenceContext::kUnknownDim), subshape, &out));
+  c->set_output(0, out);
+  return Status::OK();
+}
+
 Status SparseSegmentReductionWithNumSegmentsShapeFn(InferenceContext* c) {
   ShapeHandle data_shape;
   TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &data_shape));
@@ -1220,6 +1243,51 @@ REGISTER_OP("SparseSegmentSqrtNGrad")
     .Attr("Tidx: {int32, int64} = DT_INT32")
     .SetShapeFn(SparseSegmentReductionGradShapeFn);
 
+REGISTER_OP("FusedEmbeddingSparseSegmentReduction")
+    .Input("params: T")
+    .Input("ids: Tids")
+    .Input("indices: Tidx")
+    .Input("segment_ids: int32")
+    .Output("output: T")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'}")
+    .Attr("T: {float, double}")
+    .Attr("Tids: {int32, int64}")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .SetShapeFn(FusedEmbeddingSparseSegmentReductionShapeFn);
+
+REGISTER_OP("FusedEmbeddingSparseSegmentReductionGrad")
+    .Input("grad: T")
+    .Input("ids: Tids")
+    .Input("indices: Tidx")
+    .Input("segment_ids: int32")
+    .Output("values: T")
+    .Output("row_ids: Tids")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'}")
+    .Attr("T: {float, double}")
+    .Attr("Tids: {int32, int64}")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle grad_shape;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 1, &grad_shape));
+
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &unused));
+
+      ShapeHandle indices_shape;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &indices_shape));
+      TF_RETURN_IF_ERROR(c->Merge(c->input(3), indices_shape, &indices_shape));
+
+      ShapeHandle subshape;
+      TF_RETURN_IF_ERROR(c->Subshape(grad_shape, 1, &subshape));
+
+      ShapeHandle values_shape;
+      TF_RETURN_IF_ERROR(
+          c->Concatenate(indices_shape, subshape, &values_shape));
+      c->set_output(0, values_shape);
+      c->set_output(1, indices_shape);
+      return Status::OK();
+    });
+
 REGISTER_OP("All")
     .Input("input: bool")
     .Input("reduction_indices: Tidx")
@@ -1224,6 +1224,16 @@ REGISTER_OP("TopKV2")
     .Attr("T: realnumbertype")
     .SetShapeFn(TopKShapeFn);
 
+REGISTER_OP("ApproxTopK")
+    .Input("input: T")
+    .Input("k: int32")
+    .Output("values: T")
+    .Output("indices: int32")
+    .Attr("sorted: bool = true")
+    .Attr("recall_target: float = 0.95")
+    .Attr("T: realnumbertype")
+    .SetShapeFn(TopKShapeFn);
+
 // --------------------------------------------------------------------------
 
 REGISTER_OP("NthElement")
@@ -257,6 +257,38 @@ REGISTER_OP("ResourceGather")
       return Status::OK();
     });
 
+REGISTER_OP("ResourceFusedEmbeddingSparseSegmentReduction")
+    .Input("resource: resource")
+    .Input("ids: Tids")
+    .Input("indices: Tidx")
+    .Input("segment_ids: int32")
+    .Output("output: dtype")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'}")
+    .Attr("dtype: {float, double}")
+    .Attr("Tids: {int32, int64}")
+    .Attr("Tidx: {int32, int64} = DT_INT32")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeAndType handle_shape_and_type;
+      TF_RETURN_IF_ERROR(
+          ValidateVariableResourceHandle(c, &handle_shape_and_type));
+
+      ShapeHandle unused;
+      TF_RETURN_IF_ERROR(
+          c->WithRankAtLeast(handle_shape_and_type.shape, 1, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &unused));
+      ShapeHandle indices_shape;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &indices_shape));
+      TF_RETURN_IF_ERROR(c->Merge(c->input(3), indices_shape, &unused));
+      ShapeHandle params_subshape;
+      TF_RETURN_IF_ERROR(
+          c->Subshape(handle_shape_and_type.shape, 1, &params_subshape));
+      ShapeHandle out;
+      TF_RETURN_IF_ERROR(c->Concatenate(
+          c->Vector(InferenceContext::kUnknownDim), params_subshape, &out));
+      c->set_output(0, out);
+      return Status::OK();
+    });
+
 namespace {
 
 Status ResourceScatterUpdateShape(InferenceContext* c) {
@@ -228,9 +228,9 @@ class MicroBenchmarks(test.Benchmark):
     func = lambda: a * a
     self._run(func, num_iters)
 
-  def _benchmark_tf_multiply(self, m, num_iters):
+  def _benchmark_tf_multiply(self, m, num_iters, execution_mode=None):
     func = lambda: m * m
-    self._run(func, num_iters)
+    self._run(func, num_iters, execution_mode=execution_mode)
 
   def _benchmark_tf_multiply_op(self, m, num_iters):
     func = lambda: math_ops.multiply(m, m)
@@ -244,6 +244,11 @@ class MicroBenchmarks(test.Benchmark):
       m = self._m_2.cpu()
       self._benchmark_tf_multiply(m, 30000)
 
+  def benchmark_tf_multiply_CPU_async(self):
+    with context.device(CPU):
+      m = self._m_2.cpu()
+      self._benchmark_tf_multiply(m, 30000, execution_mode=context.ASYNC)
+
   def benchmark_tf_multiply_GPU(self):
     if not context.num_gpus():
       return
@@ -31,11 +31,15 @@ from tensorflow.python.framework import sparse_tensor
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import data_flow_ops
 from tensorflow.python.ops import embedding_ops
+from tensorflow.python.ops import gen_math_ops
+from tensorflow.python.ops import gen_resource_variable_ops
 from tensorflow.python.ops import gradient_checker
+from tensorflow.python.ops import gradients_impl
 from tensorflow.python.ops import init_ops
 from tensorflow.python.ops import linalg_ops
 from tensorflow.python.ops import math_ops
 from tensorflow.python.ops import partitioned_variables
+from tensorflow.python.ops import resource_variable_ops
 from tensorflow.python.ops import state_ops
 from tensorflow.python.ops import variable_scope
 from tensorflow.python.ops import variables
@@ -750,6 +754,66 @@ class EmbeddingLookupSparseTest(test.TestCase):
             x, sp_ids, sp_weights, combiner="mean")
 
 
+class FusedEmbeddingSparseSegmentReductionTest(test.TestCase):
+
+  _SPARSE_SEGMENT_OPS = {
+      "sum": math_ops.sparse_segment_sum,
+      "mean": math_ops.sparse_segment_mean,
+      "sqrtn": math_ops.sparse_segment_sqrt_n,
+  }
+
+  def _Inputs(self):
+    np.random.seed(17)
+    params = np.random.rand(10, 3)
+    ids = np.array([7, 2, 9, 0], dtype=np.int64)
+    indices = np.array([0, 1, 1, 3, 2, 0], dtype=np.int32)
+    # Segment 2 is empty.
+    segment_ids = np.array([0, 0, 1, 1, 3, 3], dtype=np.int32)
+    return params, ids, indices, segment_ids
+
+  def testMatchesGatherAndSparseSegmentReduction(self):
+    params, ids, indices, segment_ids = self._Inputs()
+    for combiner, dtype in itertools.product(
+        ["sum", "mean", "sqrtn"], [dtypes.float32, dtypes.float64]):
+      with self.cached_session(use_gpu=False):
+        p = constant_op.constant(params, dtype=dtype)
+        fused = gen_math_ops.fused_embedding_sparse_segment_reduction(
+            p, ids, indices, segment_ids, combiner=combiner)
+        expected = self._SPARSE_SEGMENT_OPS[combiner](
+            array_ops.gather(p, ids), indices, segment_ids)
+        self.assertAllClose(expected.eval(), fused.eval())
+
+  def testResourceVariable(self):
+    params, ids, indices, segment_ids = self._Inputs()
+    with self.cached_session(use_gpu=False):
+      v = resource_variable_ops.ResourceVariable(params)
+      variables.global_variables_initializer().run()
+      fused = (gen_resource_variable_ops.
+               resource_fused_embedding_sparse_segment_reduction(
+                   v.handle, ids, indices, segment_ids, combiner="mean"))
+      expected = math_ops.sparse_segment_mean(
+          array_ops.gather(v, ids), indices, segment_ids)
+      self.assertAllClose(expected.eval(), fused.eval())
+      grad = ops.convert_to_tensor(
+          gradients_impl.gradients(math_ops.reduce_sum(fused), [v])[0])
+      expected_grad = ops.convert_to_tensor(
+          gradients_impl.gradients(math_ops.reduce_sum(expected), [v])[0])
+      self.assertAllClose(expected_grad.eval(), grad.eval())
+
+  def testGradients(self):
+    params, ids, indices, segment_ids = self._Inputs()
+    for combiner in ["sum", "mean", "sqrtn"]:
+      with self.cached_session(use_gpu=False):
+        p = constant_op.constant(params)
+        fused = gen_math_ops.fused_embedding_sparse_segment_reduction(
+            p, ids, indices, segment_ids, combiner=combiner)
+        self.assertIsInstance(
+            gradients_impl.gradients(fused, [p])[0], ops.IndexedSlices)
+        err = gradient_checker.compute_gradient_error(
+            p, params.shape, fused, [4, 3], x_init_value=params)
+      self.assertLess(err, 1e-10)
+
+
 class SafeEmbeddingLookupSparseTest(test.TestCase):
 
   def _random_weights(self, vocab_size=4, embed_dim=4, num_shards=1):
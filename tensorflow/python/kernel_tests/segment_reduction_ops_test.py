@@ -425,6 +425,31 @@ class UnsortedSegmentTest(SegmentReductionHelper):
           unsorted = math_ops.unsorted_segment_sum(data, segment_ids, 2)
           self.assertAllEqual(unsorted.eval(), np.zeros((2, 0), dtype=dtype))
 
+  def testLargeInputs(self):
+    # Large enough for the rows to be reduced in parallel chunks.
+    num_segments = 100
+    data = np.random.randint(-100, 100, size=(20000, 4)).astype(np.float64)
+    segment_ids = np.random.randint(-1, num_segments, size=20000)
+    expected_sum = np.zeros((num_segments, 4))
+    expected_max = np.full((num_segments, 4), np.finfo(np.float64).min)
+    for i, j in enumerate(segment_ids):
+      if j >= 0:
+        expected_sum[j] += data[i]
+        expected_max[j] = np.maximum(expected_max[j], data[i])
+    with self.session(use_gpu=False):
+      self.assertAllEqual(
+          expected_sum,
+          math_ops.unsorted_segment_sum(data, segment_ids,
+                                        num_segments).eval())
+      self.assertAllEqual(
+          expected_max,
+          math_ops.unsorted_segment_max(data, segment_ids,
+                                        num_segments).eval())
+      segment_ids[12345] = num_segments
+      with self.assertRaisesOpError(
+          r"segment_ids\[12345\] = 100 is out of range \[0, 100\)"):
+        math_ops.unsorted_segment_sum(data, segment_ids, num_segments).eval()
+
   def testDropNegatives(self):
     # Note: the test is done by replacing segment_ids with 8 to -1
     # for index  and replace values generated by numpy with 0.
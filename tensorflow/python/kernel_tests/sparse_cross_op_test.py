@@ -352,6 +352,31 @@ class SparseCrossOpTest(test.TestCase):
       all_values_are_different = len(out.values) == len(set(out.values))
       self.assertTrue(all_values_are_different)
 
+  def test_hashed_matches_crosses_of_single_features(self):
+    """Tests that crosses sharing a prefix hash like crosses built alone."""
+    columns = [['a1', 'a2', 'a3'], [11, 12], ['c1', 'c2', 'c3', 'c4']]
+    combinations = [[f1, f2, f3]
+                     for f1 in columns[0]
+                     for f2 in columns[1]
+                     for f3 in columns[2]]
+    op = sparse_ops.sparse_cross_hashed(
+        [self._sparse_tensor([column]) for column in columns],
+        num_buckets=0,
+        hash_key=sparse_ops._DEFAULT_HASH_KEY + 1)
+    # One batch per combination, so that every cross is hashed from scratch.
+    single_op = sparse_ops.sparse_cross_hashed(
+        [
+            self._sparse_tensor([[combination[i]]
+                                 for combination in combinations])
+            for i in range(len(columns))
+        ],
+        num_buckets=0,
+        hash_key=sparse_ops._DEFAULT_HASH_KEY + 1)
+    with self.cached_session() as sess:
+      out, single_out = sess.run([op, single_op])
+      self.assertEqual(len(combinations), len(out.values))
+      self.assertAllEqual(single_out.values, out.values)
+
   def _assert_sparse_tensor_empty(self, sp):
     self.assertEquals(0, sp.indices.size)
     self.assertEquals(0, sp.values.size)
@@ -228,6 +228,30 @@ class SparseTensorDenseMatMulTest(test.TestCase):
     self._testLarge(np.complex64)
     self._testLarge(np.complex128)
 
+  # Tests products large enough for the CPU kernel to compute the rows of the
+  # output in parallel.
+  def testLargeMultiThreaded(self):
+    np.random.seed(127)  # Repeatable results
+    config = config_pb2.ConfigProto(intra_op_parallelism_threads=4)
+    for np_dtype in [np.float32, np.complex64]:
+      for n in [8, 64]:
+        for adjoint_a in [True, False]:
+          for adjoint_b in [True, False]:
+            x = _maybe_complex(np.random.rand(512, 256).astype(np_dtype))
+            x[np.abs(x) < 0.8] = 0
+            y = _maybe_complex(np.random.randn(256, n).astype(np_dtype))
+            x = x.transpose() if adjoint_a else x
+            y = y.transpose() if adjoint_b else y
+            x_mat = np.matrix(x).H if adjoint_a else np.matrix(x)
+            y_mat = np.matrix(y).H if adjoint_b else np.matrix(y)
+            x_indices = np.vstack(np.where(x)).astype(np.int64).T
+            with self.session(use_gpu=False, config=config):
+              sp_x = sparse_tensor.SparseTensorValue(
+                  indices=x_indices, values=x[np.where(x)], dense_shape=x.shape)
+              out = sparse_ops.sparse_tensor_dense_matmul(
+                  sp_x, y, adjoint_a=adjoint_a, adjoint_b=adjoint_b).eval()
+            self.assertAllClose(x_mat * y_mat, out, rtol=1e-4, atol=1e-4)
+
   # Tests random sized matrices.
   def testFloatRandom(self):
     np.random.seed(127)  # Repeatable results
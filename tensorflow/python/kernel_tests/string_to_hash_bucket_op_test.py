@@ -46,6 +46,19 @@ class StringToHashBucketOpTest(test.TestCase):
       # Fingerprint64('d') -> 4470636696479570465 -> mod 10 -> 5
       self.assertAllEqual([9, 2, 2, 5], result)
 
+  def testStringToHashBucketsFastLargeInput(self):
+    # Strings long enough to live on the heap, and more of them than fit in a
+    # batch, each hashed the same as when it is hashed alone.
+    strings = ['%d-%s' % (i, 'x' * (i % 40)) for i in range(1000)]
+    with self.cached_session() as sess:
+      input_string = array_ops.placeholder(dtypes.string)
+      output = string_ops.string_to_hash_bucket_fast(input_string, 1000003)
+      result = sess.run(output, feed_dict={input_string: strings})
+      for i in [0, 1, 7, 8, 9, 500, 999]:
+        self.assertEqual(
+            sess.run(output, feed_dict={input_string: [strings[i]]})[0],
+            result[i])
+
   def testStringToOneHashBucketLegacyHash(self):
     with self.cached_session():
       input_string = array_ops.placeholder(dtypes.string)
@@ -23,11 +23,13 @@ import sys
 
 import numpy as np
 
+from tensorflow.core.protobuf import config_pb2
 from tensorflow.python.client import session
 from tensorflow.python.framework import constant_op
 from tensorflow.python.framework import dtypes
 from tensorflow.python.framework import ops
 from tensorflow.python.ops import array_ops
+from tensorflow.python.ops import gen_nn_ops
 from tensorflow.python.ops import gradients_impl
 from tensorflow.python.ops import nn_ops
 from tensorflow.python.ops import random_ops
@@ -165,6 +167,38 @@ class TopKTest(test.TestCase):
     self._validateTopK(inputs, 4, [[0.4, 0.3, 0.2, 0.1], [0.3, 0.3, 0.2, 0.1]],
                        [[3, 1, 2, 0], [1, 2, 3, 0]])
 
+  def testLargeVectorMultiThreaded(self):
+    # Few long rows are split into buckets of columns across threads.
+    n = 1 << 17
+    k = 500
+    # Lots of repeated integers, so that ties cross buckets.
+    inputs = np.random.randint(0, 1000, size=[2, n]).astype(np.float32)
+    indices = np.argsort(-inputs, axis=1, kind="mergesort")[:, :k]
+    values = -np.sort(-inputs, axis=1)[:, :k]
+    config = config_pb2.ConfigProto(intra_op_parallelism_threads=8)
+    with self.session(use_gpu=False, config=config):
+      for x, expected_values, expected_indices in [
+          (inputs[0], values[0], indices[0]), (inputs, values, indices)]:
+        values_op, indices_op = nn_ops.top_k(x, k)
+        self.assertAllEqual(expected_values, values_op.eval())
+        self.assertAllEqual(expected_indices, indices_op.eval())
+
+  def testApproxTopK(self):
+    n = 1 << 18
+    k = 100
+    inputs = np.random.permutation(np.arange(n, dtype=np.float32))
+    expected = np.argsort(-inputs)[:k]
+    with self.session(use_gpu=False):
+      values, indices = self.evaluate(
+          gen_nn_ops.approx_top_k(inputs, k, recall_target=0.9))
+      self.assertAllEqual(inputs[indices], values)
+      self.assertTrue(np.all(np.diff(values) < 0))
+      self.assertGreaterEqual(len(np.intersect1d(indices, expected)), 80)
+      # Exact with a recall target of 1.
+      _, indices = self.evaluate(
+          gen_nn_ops.approx_top_k(inputs, k, recall_target=1.0))
+      self.assertAllEqual(expected, indices)
+
   def testTop3Unsorted(self):
     inputs = [[0.1, 0.3, 0.2, 0.4], [0.1, 0.4, 0.3, 0.2]]
     self._validateTopK(
@@ -235,6 +269,27 @@ class TopKBenchmark(test.Benchmark):
                 "Throughput: %0.03g GB/s" % (name, r["wall_time"], throughput))
           sys.stdout.flush()
 
+  def benchmarkTopKSingleRow(self):
+    # Retrieval over one row of scores.
+    n = 1 << 20
+    k = 500
+    for num_threads, approx in itertools.product([1, 4, 16], [False, True]):
+      name = "n_%d_k_%d_threads_%d_approx_%s" % (n, k, num_threads, approx)
+      with ops.Graph().as_default():
+        x = random_ops.random_uniform((n,))
+        v = resource_variable_ops.ResourceVariable(x)
+        if approx:
+          op = gen_nn_ops.approx_top_k(v, k)
+        else:
+          op = nn_ops.top_k(v, k)
+        config = config_pb2.ConfigProto(
+            intra_op_parallelism_threads=num_threads)
+        with session.Session(config=config) as sess:
+          v.initializer.run()
+          r = self.run_op_benchmark(sess, op, min_iters=100, name=name)
+          print("Benchmark: %s \t wall_time: %0.03g s" % (name, r["wall_time"]))
+          sys.stdout.flush()
+
 
 if __name__ == "__main__":
   test.main()
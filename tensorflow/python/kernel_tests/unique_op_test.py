@@ -75,6 +75,18 @@ class UniqueTest(test.TestCase):
       self.assertAllEqual(tf_y1, np.array([[1, 0], [1, 0], [2, 0]]))
       self.assertAllEqual(tf_idx1, np.array([0, 1, 1]))
 
+  def testLargeInt64FirstOccurrenceOrder(self):
+    # Large enough for the elements to be deduplicated in several partitions.
+    x = np.random.randint(-2**40, high=2**40, size=1000)
+    x = np.random.choice(x, size=200000).astype(np.int64)
+    with self.cached_session() as sess:
+      y, idx = array_ops.unique(x)
+      tf_y, tf_idx = sess.run([y, idx])
+
+    _, first_indices = np.unique(x, return_index=True)
+    self.assertAllEqual(x[np.sort(first_indices)], tf_y)
+    self.assertAllEqual(x, tf_y[tf_idx])
+
   def testInt32V2(self):
     # This test is only temporary, once V2 is used
     # by default, the axis will be wrapped to allow `axis=None`.
@@ -150,6 +162,21 @@ class UniqueWithCountsTest(test.TestCase):
       self.assertAllEqual(tf_idx1, np.array([0, 1, 1]))
       self.assertAllEqual(tf_count1, np.array([1, 2]))
 
+  def testLargeInt64FirstOccurrenceOrder(self):
+    # Large enough for the elements to be deduplicated in several partitions.
+    x = np.random.randint(-2**40, high=2**40, size=1000)
+    x = np.random.choice(x, size=200000).astype(np.int64)
+    with self.cached_session() as sess:
+      y, idx, count = array_ops.unique_with_counts(x)
+      tf_y, tf_idx, tf_count = sess.run([y, idx, count])
+
+    _, first_indices, counts = np.unique(
+        x, return_index=True, return_counts=True)
+    order = np.argsort(first_indices)
+    self.assertAllEqual(x[first_indices[order]], tf_y)
+    self.assertAllEqual(x, tf_y[tf_idx])
+    self.assertAllEqual(counts[order], tf_count)
+
   def testInt32V2(self):
     # This test is only temporary, once V2 is used
     # by default, the axis will be wrapped to allow `axis=None`.
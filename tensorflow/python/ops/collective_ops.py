@@ -22,7 +22,8 @@ from tensorflow.python.ops import gen_collective_ops
 
 
 def all_reduce(t, group_size, group_key, instance_key, merge_op, final_op,
-               subdiv_offsets=(0,)):
+               subdiv_offsets=(0,), bidirectional=False, compression='none',
+               topk_fraction=0.01, hierarchical=False):
   """Reduces tensors collectively, across devices.
 
   Args:
@@ -38,6 +39,20 @@ def all_reduce(t, group_size, group_key, instance_key, merge_op, final_op,
     subdiv_offsets: a list of integer offsets into the tensor at which each
       independent subdivision should begin.  Use [0] if no subdivision should
       be done.
+    bidirectional: if True, every other subdivision runs its ring in the
+      reverse direction, so that both directions of each link carry data.  An
+      odd number of `subdiv_offsets` is mirrored, each offset starting two
+      subdivisions that run in opposite directions.
+    compression: lossy compression of the values exchanged between devices,
+      for float tensors on CPU: 'none', 'fp16' or 'bf16' (values sent as
+      half or bfloat16; with 'fp16', partial sums beyond +/-65504 saturate),
+      or 'topk' (only the `topk_fraction` values of largest magnitude of each
+      chunk are sent in the reduction phase, the others being added back on
+      the next execution).
+    topk_fraction: the fraction of values sent with 'topk' compression.
+    hierarchical: if True, the reduction runs in two levels on CPU devices:
+      within each group of devices sharing a task and NUMA node, and then
+      across one leader device per group.
 
   Returns:
     An Op implementing the distributed reduction.
@@ -55,7 +70,11 @@ def all_reduce(t, group_size, group_key, instance_key, merge_op, final_op,
                                               instance_key=instance_key,
                                               merge_op=merge_op,
                                               final_op=final_op,
-                                              subdiv_offsets=subdiv_offsets)
+                                              subdiv_offsets=subdiv_offsets,
+                                              bidirectional=bidirectional,
+                                              compression=compression,
+                                              topk_fraction=topk_fraction,
+                                              hierarchical=hierarchical)
 
 
 def broadcast_send(t, shape, dtype, group_size, group_key, instance_key):
@@ -250,6 +250,16 @@ def _SparseSegmentSqrtNWithNumSegmentsGrad(op, grad):
                                               dim0), None, None, None)
 
 
+@ops.RegisterGradient("FusedEmbeddingSparseSegmentReduction")
+def _FusedEmbeddingSparseSegmentReductionGrad(op, grad):
+  """Gradient for FusedEmbeddingSparseSegmentReduction."""
+  values, row_ids = gen_math_ops.fused_embedding_sparse_segment_reduction_grad(
+      grad, op.inputs[1], op.inputs[2], op.inputs[3],
+      combiner=op.get_attr("combiner"))
+  params_shape = array_ops.shape(op.inputs[0])
+  return (ops.IndexedSlices(values, row_ids, params_shape), None, None, None)
+
+
 def _SegmentMinOrMaxGrad(op, grad):
   """ Gradient for SegmentMin and SegmentMax. """
   zeros = array_ops.zeros_like(op.inputs[0], dtype=op.inputs[0].dtype)
@@ -975,6 +975,7 @@ def _L2LossGrad(op, grad):
   return op.inputs[0] * grad
 
 
+@ops.RegisterGradient("ApproxTopK")
 @ops.RegisterGradient("TopK")
 @ops.RegisterGradient("TopKV2")
 def _TopKGrad(op, grad, _):
@@ -32,6 +32,7 @@ from tensorflow.python.framework import ops
 from tensorflow.python.framework import tensor_shape
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import gen_array_ops
+from tensorflow.python.ops import gen_math_ops
 from tensorflow.python.ops import gen_resource_variable_ops
 from tensorflow.python.ops import gen_state_ops
 from tensorflow.python.ops import math_ops
@@ -1456,6 +1457,16 @@ def _GatherGrad(op, grad):
   return (ops.IndexedSlices(values, indices, params_shape), None)
 
 
+@ops.RegisterGradient("ResourceFusedEmbeddingSparseSegmentReduction")
+def _ResourceFusedEmbeddingSparseSegmentReductionGrad(op, grad):
+  """Gradient for ResourceFusedEmbeddingSparseSegmentReduction."""
+  values, row_ids = gen_math_ops.fused_embedding_sparse_segment_reduction_grad(
+      grad, op.inputs[1], op.inputs[2], op.inputs[3],
+      combiner=op.get_attr("combiner"))
+  params_shape = gen_resource_variable_ops.variable_shape(op.inputs[0])
+  return (ops.IndexedSlices(values, row_ids, params_shape), None, None, None)
+
+
 def _to_proto_fn(v, export_scope=None):
   """Converts Variable and ResourceVariable to VariableDef for collections."""
   return v.to_proto(export_scope=export_scope)
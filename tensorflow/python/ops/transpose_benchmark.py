@@ -154,5 +154,25 @@ class TransposeBenchmark(test.Benchmark):
         self._run_graph("gpu", ishape, perm, num_iters, datatype)
 
 
+  def benchmark_transpose_cpu(self):
+    print("transpose cpu benchmark:")
+
+    datatypes = [np.float64, np.float32, np.float16, np.int8]
+
+    # Layout conversions between NHWC/NCHW and NDHWC/NCDHW, a matrix
+    # transpose and full reversals.
+    shapes = [[32, 56, 56, 64], [32, 64, 56, 56]] + [[32, 56, 56, 64]]
+    shapes += [[8, 16, 28, 28, 64], [8, 64, 16, 28, 28]]
+    shapes += [[4096, 4096], [2, 100000, 32]]
+    perms = [[0, 3, 1, 2], [0, 2, 3, 1], [3, 2, 1, 0]]
+    perms += [[0, 4, 1, 2, 3], [0, 2, 3, 4, 1]]
+    perms += [[1, 0], [0, 2, 1]]
+
+    num_iters = 10
+    for datatype in datatypes:
+      for ishape, perm in zip(shapes, perms):
+        self._run_graph("cpu", ishape, perm, num_iters, datatype)
+
+
 if __name__ == "__main__":
   test.main()
@@ -245,6 +245,62 @@ class TrainingOpsTest(TensorFlowTestCase):
       indices = np.array([0, 2]).astype(index_type)
       self._testTypesForSparseFtrl(x, y, z, lr, grad, indices)
 
+  def testSparseApplyAdagradDuplicateIndices(self):
+    for (dtype, index_type) in itertools.product(
+        [np.float32, np.float64], [np.int32, np.int64]):
+      x = np.array([[1.0, 2.0], [3.0, 4.0], [5.0, 6.0]]).astype(dtype)
+      y = np.array([[1.0, 1.0], [2.0, 2.0], [3.0, 3.0]]).astype(dtype)
+      lr = np.array(2.0).astype(dtype)
+      grad = np.array([[1.0, 2.0], [3.0, 4.0], [5.0, 6.0]]).astype(dtype)
+      indices = np.array([2, 0, 2]).astype(index_type)
+      self.setUp()
+      with self.session(use_gpu=False):
+        var = variables.VariableV1(x)
+        accum = variables.VariableV1(y)
+        variables.global_variables_initializer().run()
+        training_ops.sparse_apply_adagrad(
+            var, accum, lr, grad,
+            constant_op.constant(indices, self._toType(indices.dtype))).eval()
+
+        # The gradients of duplicate indices are summed, and each row is
+        # updated once.
+        expected_x = x.copy()
+        expected_y = y.copy()
+        for (index, g) in [(0, grad[1]), (2, grad[0] + grad[2])]:
+          expected_y[index] += g * g
+          expected_x[index] -= lr * g * expected_y[index]**(-0.5)
+        self.assertAllCloseAccordingToType(expected_x, var.eval())
+        self.assertAllCloseAccordingToType(expected_y, accum.eval())
+
+  def testSparseApplyAdagradIndexOrders(self):
+    # The kernel tells unique indices apart without a map when they are
+    # increasing, or when the variable has few rows next to them; these cover
+    # both, and the map, with and without duplicates.
+    for (num_rows, index_list) in [(3, [0, 2]), (3, [2, 0]), (3, [2, 1, 2]),
+                                   (512, [400, 3, 7]), (512, [400, 3, 400])]:
+      x = np.arange(2 * num_rows).reshape([num_rows, 2]).astype(np.float32)
+      y = np.ones([num_rows, 2]).astype(np.float32)
+      lr = np.array(0.5).astype(np.float32)
+      grad = np.arange(1, 2 * len(index_list) + 1).reshape(
+          [len(index_list), 2]).astype(np.float32)
+      indices = np.array(index_list).astype(np.int64)
+      self.setUp()
+      with self.session(use_gpu=False):
+        var = variables.VariableV1(x)
+        accum = variables.VariableV1(y)
+        variables.global_variables_initializer().run()
+        training_ops.sparse_apply_adagrad(
+            var, accum, lr, grad, constant_op.constant(indices)).eval()
+
+        expected_x = x.copy()
+        expected_y = y.copy()
+        for index in set(index_list):
+          g = grad[indices == index].sum(axis=0)
+          expected_y[index] += g * g
+          expected_x[index] -= lr * g * expected_y[index]**(-0.5)
+        self.assertAllCloseAccordingToType(expected_x, var.eval())
+        self.assertAllCloseAccordingToType(expected_y, accum.eval())
+
   def testApplyAdam(self):
     for dtype, use_gpu in itertools.product(
         [np.float16, np.float32, np.float64], [False, True]):